@@ -1435,6 +1435,14 @@ static int confdb_get_domain_internal(struct confdb_ctx *cdb,
         goto done;
     }
 
+    ret = get_entry_as_bool(res->msgs[0], &domain->cache_shards,
+                            CONFDB_DOMAIN_CACHE_SHARDS, 0);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Invalid value for %s\n", CONFDB_DOMAIN_CACHE_SHARDS);
+        goto done;
+    }
+
     domain->has_views = false;
     domain->view_name = NULL;
 
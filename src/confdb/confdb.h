@@ -57,9 +57,12 @@
 #define CONFDB_SERVICE_DEBUG_TIMESTAMPS "debug_timestamps"
 #define CONFDB_SERVICE_DEBUG_MICROSECONDS "debug_microseconds"
 #define CONFDB_SERVICE_DEBUG_TO_FILES "debug_to_files"
+#define CONFDB_SERVICE_DEBUG_BUFFERED "debug_buffered"
+#define CONFDB_SERVICE_DEBUG_FLIGHT_RECORDER "debug_flight_recorder"
 #define CONFDB_SERVICE_RECON_RETRIES "reconnection_retries"
 #define CONFDB_SERVICE_FD_LIMIT "fd_limit"
 #define CONFDB_SERVICE_ALLOWED_UIDS "allowed_uids"
+#define CONFDB_SERVICE_REQUEST_POOL_SIZE "request_pool_size"
 
 /* Monitor */
 #define CONFDB_MONITOR_CONF_ENTRY "config/sssd"
@@ -211,6 +214,7 @@
 #define CONFDB_DOMAIN_OFFLINE_TIMEOUT "offline_timeout"
 #define CONFDB_DOMAIN_SUBDOMAIN_INHERIT "subdomain_inherit"
 #define CONFDB_DOMAIN_CACHED_AUTH_TIMEOUT "cached_auth_timeout"
+#define CONFDB_DOMAIN_CACHE_SHARDS "cache_shards"
 #define CONFDB_DOMAIN_TYPE "domain_type"
 #define CONFDB_DOMAIN_TYPE_POSIX "posix"
 #define CONFDB_DOMAIN_TYPE_APP "application"
@@ -231,6 +235,7 @@
 #define CONFDB_PROXY_PAM_TARGET "proxy_pam_target"
 #define CONFDB_PROXY_FAST_ALIAS "proxy_fast_alias"
 #define CONFDB_PROXY_MAX_CHILDREN "proxy_max_children"
+#define CONFDB_PROXY_MAX_ID_CHILDREN "proxy_max_id_children"
 
 /* Secrets Service */
 #define CONFDB_SEC_CONF_ENTRY "config/secrets"
@@ -323,6 +328,9 @@ struct sss_domain_info {
     uint32_t subdomain_refresh_interval;
     uint32_t cached_auth_timeout;
 
+    /* keep sudo rules, autofs maps and SSH hosts in their own cache files */
+    bool cache_shards;
+
     int pwd_expiration_warning;
 
     struct sysdb_ctx *sysdb;
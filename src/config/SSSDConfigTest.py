@@ -359,6 +359,8 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'debug_level',
             'debug_timestamps',
             'debug_microseconds',
+            'debug_buffered',
+            'debug_flight_recorder',
             'debug_to_files',
             'command',
             'reconnection_retries',
@@ -366,6 +368,7 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'client_idle_timeout',
             'responder_idle_timeout',
             'cache_first',
+            'request_pool_size',
             'description',
             'certificate_verification',
             'override_space',
@@ -562,6 +565,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'debug',
             'debug_level',
             'debug_timestamps',
+            'debug_buffered',
+            'debug_flight_recorder',
             'domain_type',
             'min_id',
             'max_id',
@@ -622,7 +627,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'subdomain_homedir',
             'full_name_format',
             're_expression',
-            'cached_auth_timeout']
+            'cached_auth_timeout',
+            'cache_shards',
+            'request_pool_size']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
@@ -932,6 +939,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'debug',
             'debug_level',
             'debug_timestamps',
+            'debug_buffered',
+            'debug_flight_recorder',
             'domain_type',
             'min_id',
             'max_id',
@@ -992,7 +1001,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'subdomain_homedir',
             'full_name_format',
             're_expression',
-            'cached_auth_timeout']
+            'cached_auth_timeout',
+            'cache_shards',
+            'request_pool_size']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
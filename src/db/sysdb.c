@@ -23,8 +23,12 @@
 #include "util/util.h"
 #include "util/strtonum.h"
 #include "util/sss_utf8.h"
+#include "util/sss_attr_index.h"
 #include "util/crypto/sss_crypto.h"
 #include "db/sysdb_private.h"
+#include "db/sysdb_sudo.h"
+#include "db/sysdb_autofs.h"
+#include "db/sysdb_ssh.h"
 #include "confdb/confdb.h"
 #include "util/probes.h"
 #include <time.h>
@@ -275,20 +279,238 @@ struct ldb_context *sysdb_ctx_get_ldb(struct sysdb_ctx *sysdb)
     return sysdb->ldb;
 }
 
+const struct sysdb_shard_subtree sysdb_shard_subtrees[] = {
+    { SUDORULE_SUBDIR, SYSDB_SHARD_SUDO },
+    { AUTOFS_MAP_SUBDIR, SYSDB_SHARD_MISC },
+    { SSH_HOSTS_SUBDIR, SYSDB_SHARD_MISC },
+    { NULL, SYSDB_SHARD_NUM }
+};
+
+static bool sysdb_has_shards(struct sysdb_ctx *sysdb)
+{
+    int i;
+
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        if (sysdb->ldb_shards[i] != NULL) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool sysdb_dn_val_equal(const struct ldb_val *val, const char *str)
+{
+    size_t len = strlen(str);
+
+    return val != NULL && val->length == len
+           && strncasecmp((const char *) val->data, str, len) == 0;
+}
+
+struct ldb_context *sysdb_ldb_for_dn(struct sysdb_ctx *sysdb,
+                                     struct ldb_dn *dn)
+{
+    const struct ldb_val *val;
+    const char *name;
+    int num;
+    int i;
+
+    if (dn == NULL || !sysdb_has_shards(sysdb)) {
+        return sysdb->ldb;
+    }
+
+    /* Custom subtrees look like cn=$subtree,cn=custom,cn=$domain,cn=sysdb */
+    num = ldb_dn_get_comp_num(dn);
+    if (num < 4) {
+        return sysdb->ldb;
+    }
+
+    name = ldb_dn_get_component_name(dn, num - 3);
+    val = ldb_dn_get_component_val(dn, num - 3);
+    if (name == NULL || strcasecmp(name, "cn") != 0
+            || !sysdb_dn_val_equal(val, "custom")) {
+        return sysdb->ldb;
+    }
+
+    val = ldb_dn_get_component_val(dn, num - 4);
+    for (i = 0; sysdb_shard_subtrees[i].subtree != NULL; i++) {
+        if (sysdb_dn_val_equal(val, sysdb_shard_subtrees[i].subtree)) {
+            if (sysdb->ldb_shards[sysdb_shard_subtrees[i].shard] != NULL) {
+                return sysdb->ldb_shards[sysdb_shard_subtrees[i].shard];
+            }
+            break;
+        }
+    }
+
+    return sysdb->ldb;
+}
+
+static errno_t sysdb_ldb_sequence_number(struct ldb_context *ldb,
+                                         uint64_t *_seq)
+{
+    uint64_t seq;
+    int lret;
+
+    lret = ldb_sequence_number(ldb, LDB_SEQ_HIGHEST_SEQ, &seq);
+    if (lret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "ldb_sequence_number failed [%d]: %s\n",
+              lret, ldb_errstring(ldb));
+        return sysdb_error_to_errno(lret);
+    }
+
+    *_seq = seq;
+    return EOK;
+}
+
+errno_t sysdb_get_shard_generation(struct sysdb_ctx *sysdb, uint64_t *_gen)
+{
+    const char *attrs[] = { SYSDB_SHARD_GENERATION, NULL };
+    struct ldb_result *res;
+    struct ldb_dn *dn;
+    int lret;
+
+    dn = ldb_dn_new(NULL, sysdb->ldb, SYSDB_BASE);
+    if (dn == NULL) {
+        return ENOMEM;
+    }
+
+    lret = ldb_search(sysdb->ldb, dn, &res, dn, LDB_SCOPE_BASE, attrs, NULL);
+    if (lret != LDB_SUCCESS) {
+        talloc_free(dn);
+        return sysdb_error_to_errno(lret);
+    }
+
+    *_gen = res->count == 0 ? 0 : ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                                  SYSDB_SHARD_GENERATION, 0);
+    talloc_free(dn);
+    return EOK;
+}
+
+errno_t sysdb_get_sequence_number(struct sysdb_ctx *sysdb, uint64_t *_seq)
+{
+    struct ldb_context *ldb;
+    uint64_t total = 0;
+    uint64_t seq;
+    errno_t ret;
+    int i;
+
+    /* The sequence number of a file only grows while the file is kept. A
+     * shard file starts over when it is recreated, which bumps the shard
+     * generation in the main cache, so the sum stays monotonic as long as
+     * no single shard reaches 2^32 changes. */
+    ret = sysdb_get_shard_generation(sysdb, &seq);
+    if (ret != EOK) {
+        return ret;
+    }
+    total = seq << 32;
+
+    for (i = -1; i < SYSDB_SHARD_NUM; i++) {
+        ldb = (i < 0) ? sysdb->ldb : sysdb->ldb_shards[i];
+        if (ldb == NULL) {
+            continue;
+        }
+
+        ret = sysdb_ldb_sequence_number(ldb, &seq);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        total += seq;
+    }
+
+    *_seq = total;
+    return EOK;
+}
+
+errno_t sysdb_get_subtree_sequence_number(struct sss_domain_info *domain,
+                                          const char *subtree_name,
+                                          uint64_t *_seq)
+{
+    struct ldb_dn *dn;
+    errno_t ret;
+
+    dn = sysdb_custom_subtree_dn(NULL, domain, subtree_name);
+    if (dn == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_ldb_sequence_number(sysdb_ldb_for_dn(domain->sysdb, dn), _seq);
+    talloc_free(dn);
+    return ret;
+}
+
 struct sysdb_attrs *sysdb_new_attrs(TALLOC_CTX *mem_ctx)
 {
     return talloc_zero(mem_ctx, struct sysdb_attrs);
 }
 
+/* Attribute sets with fewer elements are searched by a plain scan, the
+ * name index is only built for the larger ones (e.g. parsed LDAP entries). */
+#define SYSDB_ATTRS_INDEX_MIN 16
+
+static void sysdb_attrs_index_drop(struct sysdb_attrs *attrs)
+{
+    talloc_zfree(attrs->name_index);
+    attrs->name_index_a = NULL;
+}
+
+static struct sss_attr_index *sysdb_attrs_index_get(struct sysdb_attrs *attrs)
+{
+    struct sss_attr_index *idx;
+    errno_t ret;
+    int i;
+
+    if (attrs->num < SYSDB_ATTRS_INDEX_MIN) {
+        return NULL;
+    }
+
+    if (attrs->name_index != NULL
+            && attrs->name_index_a == attrs->a
+            && sss_attr_index_count(attrs->name_index) == attrs->num) {
+        return attrs->name_index;
+    }
+
+    /* The elements were changed behind our back, start over. */
+    sysdb_attrs_index_drop(attrs);
+
+    idx = sss_attr_index_new(attrs, attrs->num);
+    if (idx == NULL) {
+        /* Not fatal, the caller falls back to scanning */
+        return NULL;
+    }
+
+    for (i = 0; i < attrs->num; i++) {
+        ret = sss_attr_index_add(idx, attrs->a[i].name, i);
+        if (ret != EOK) {
+            talloc_free(idx);
+            return NULL;
+        }
+    }
+
+    attrs->name_index = idx;
+    attrs->name_index_a = attrs->a;
+
+    return idx;
+}
+
 int sysdb_attrs_get_el_ext(struct sysdb_attrs *attrs, const char *name,
                            bool alloc, struct ldb_message_element **el)
 {
     struct ldb_message_element *e = NULL;
+    struct sss_attr_index *idx;
+    size_t pos;
     int i;
 
-    for (i = 0; i < attrs->num; i++) {
-        if (strcasecmp(name, attrs->a[i].name) == 0)
-            e = &(attrs->a[i]);
+    idx = sysdb_attrs_index_get(attrs);
+    if (idx != NULL) {
+        if (sss_attr_index_last(idx, name, &pos)) {
+            e = &(attrs->a[pos]);
+        }
+    } else {
+        for (i = 0; i < attrs->num; i++) {
+            if (strcasecmp(name, attrs->a[i].name) == 0)
+                e = &(attrs->a[i]);
+        }
     }
 
     if (!e && alloc) {
@@ -306,6 +528,14 @@ int sysdb_attrs_get_el_ext(struct sysdb_attrs *attrs, const char *name,
 
         e = &(attrs->a[attrs->num]);
         attrs->num++;
+
+        if (idx != NULL) {
+            if (sss_attr_index_add(idx, e->name, attrs->num - 1) == EOK) {
+                attrs->name_index_a = attrs->a;
+            } else {
+                sysdb_attrs_index_drop(attrs);
+            }
+        }
     }
 
     if (!e) {
@@ -898,12 +1128,50 @@ int sysdb_error_to_errno(int ldberr)
 
 /* =Transactions========================================================== */
 
+/* Transactions span the main cache and all open shard caches, so that
+ * callers can keep using a single sysdb transaction regardless of where
+ * the entries they modify are stored.
+ */
+static void sysdb_shards_transaction_cancel(struct sysdb_ctx *sysdb, int num)
+{
+    int ret;
+    int i;
+
+    for (i = 0; i < num; i++) {
+        if (sysdb->ldb_shards[i] == NULL) {
+            continue;
+        }
+
+        ret = ldb_transaction_cancel(sysdb->ldb_shards[i]);
+        if (ret != LDB_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Failed to cancel shard ldb transaction! (%d)\n", ret);
+        }
+    }
+}
+
 int sysdb_transaction_start(struct sysdb_ctx *sysdb)
 {
     int ret;
+    int i;
 
     ret = ldb_transaction_start(sysdb->ldb);
     if (ret == LDB_SUCCESS) {
+        for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+            if (sysdb->ldb_shards[i] == NULL) {
+                continue;
+            }
+
+            ret = ldb_transaction_start(sysdb->ldb_shards[i]);
+            if (ret != LDB_SUCCESS) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "Failed to start shard ldb transaction! (%d)\n", ret);
+                sysdb_shards_transaction_cancel(sysdb, i);
+                ldb_transaction_cancel(sysdb->ldb);
+                return sysdb_error_to_errno(ret);
+            }
+        }
+
         PROBE(SYSDB_TRANSACTION_START, sysdb->transaction_nesting);
         sysdb->transaction_nesting++;
     } else {
@@ -916,26 +1184,73 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb)
 int sysdb_transaction_commit(struct sysdb_ctx *sysdb)
 {
     int ret;
+    int i;
 #ifdef HAVE_SYSTEMTAP
     int commit_nesting = sysdb->transaction_nesting-1;
 #endif
 
     PROBE(SYSDB_TRANSACTION_COMMIT_BEFORE, commit_nesting);
+
+    /* All files are prepared first, this is where a commit fails in
+     * practice. Nothing is written until every file is prepared, so on
+     * error the caller cancels the transaction in all of them. */
+    ret = ldb_transaction_prepare_commit(sysdb->ldb);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to prepare ldb transaction commit! (%d)\n", ret);
+        return sysdb_error_to_errno(ret);
+    }
+
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        if (sysdb->ldb_shards[i] == NULL) {
+            continue;
+        }
+
+        ret = ldb_transaction_prepare_commit(sysdb->ldb_shards[i]);
+        if (ret != LDB_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Failed to prepare shard ldb transaction commit! (%d)\n",
+                  ret);
+            return sysdb_error_to_errno(ret);
+        }
+    }
+
+    /* The shards go before the main cache. If one still fails here, the
+     * shards committed so far keep their changes, the rest is cancelled by
+     * the caller and the failure is reported, so the data is fetched and
+     * stored again. Nothing in the main cache refers to shard entries. */
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        if (sysdb->ldb_shards[i] == NULL) {
+            continue;
+        }
+
+        ret = ldb_transaction_commit(sysdb->ldb_shards[i]);
+        if (ret != LDB_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Failed to commit shard ldb transaction! (%d)\n", ret);
+            return sysdb_error_to_errno(ret);
+        }
+    }
+
     ret = ldb_transaction_commit(sysdb->ldb);
-    if (ret == LDB_SUCCESS) {
-        sysdb->transaction_nesting--;
-        PROBE(SYSDB_TRANSACTION_COMMIT_AFTER, sysdb->transaction_nesting);
-    } else {
+    if (ret != LDB_SUCCESS) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Failed to commit ldb transaction! (%d)\n", ret);
+        return sysdb_error_to_errno(ret);
     }
-    return sysdb_error_to_errno(ret);
+
+    sysdb->transaction_nesting--;
+    PROBE(SYSDB_TRANSACTION_COMMIT_AFTER, sysdb->transaction_nesting);
+
+    return EOK;
 }
 
 int sysdb_transaction_cancel(struct sysdb_ctx *sysdb)
 {
     int ret;
 
+    sysdb_shards_transaction_cancel(sysdb, SYSDB_SHARD_NUM);
+
     ret = ldb_transaction_cancel(sysdb->ldb);
     if (ret == LDB_SUCCESS) {
         sysdb->transaction_nesting--;
@@ -984,6 +1299,9 @@ int sysdb_attrs_replace_name(struct sysdb_attrs *attrs, const char *oldname,
             return ENOMEM;
         }
 
+        /* The index keeps pointers to the names */
+        sysdb_attrs_index_drop(attrs);
+
         talloc_free(discard_const(e->name));
         e->name = dummy;
     }
@@ -1562,7 +1880,7 @@ errno_t sysdb_msg2attrs(TALLOC_CTX *mem_ctx, size_t count,
     }
 
     for (i = 0; i < count; i++) {
-        a[i] = talloc(a, struct sysdb_attrs);
+        a[i] = talloc_zero(a, struct sysdb_attrs);
         if (a[i] == NULL) {
             DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
             talloc_free(a);
@@ -1773,33 +2091,65 @@ int sysdb_delete_ulong(struct ldb_message *msg,
     return sysdb_ldb_msg_ulong_helper(msg, LDB_FLAG_MOD_DELETE, attr, value);
 }
 
+/* Containers right below the domain whose entries keep their timestamps in
+ * the timestamp cache, e.g. name=$name,cn=users,cn=$domain,cn=sysdb */
+static const char *sysdb_ts_containers[] = {
+    "users",
+    "groups",
+    "Netgroups",
+    "services",
+    NULL
+};
+
+/* Custom subtrees whose entries keep their timestamps in the timestamp cache,
+ * e.g. name=$name,cn=sudorules,cn=custom,cn=$domain,cn=sysdb. Entries nested
+ * deeper, such as autofs map entries, are not tracked. */
+static const char *sysdb_ts_custom_subtrees[] = {
+    SUDORULE_SUBDIR,
+    AUTOFS_MAP_SUBDIR,
+    NULL
+};
+
 bool is_ts_ldb_dn(struct ldb_dn *dn)
 {
+    const char **containers;
     const char *sysdb_comp_name = NULL;
     const struct ldb_val *sysdb_comp_val = NULL;
+    int i;
 
     if (dn == NULL) {
         return false;
     }
 
-    sysdb_comp_name = ldb_dn_get_component_name(dn, 1);
-    if (strcasecmp("cn", sysdb_comp_name) != 0) {
-        /* The second component name is not "cn" */
+    switch (ldb_dn_get_comp_num(dn)) {
+    case 4:
+        containers = sysdb_ts_containers;
+        break;
+    case 5:
+        sysdb_comp_name = ldb_dn_get_component_name(dn, 2);
+        sysdb_comp_val = ldb_dn_get_component_val(dn, 2);
+        if (sysdb_comp_name == NULL
+                || strcasecmp("cn", sysdb_comp_name) != 0
+                || !sysdb_dn_val_equal(sysdb_comp_val, "custom")) {
+            return false;
+        }
+        containers = sysdb_ts_custom_subtrees;
+        break;
+    default:
         return false;
     }
 
-    sysdb_comp_val = ldb_dn_get_component_val(dn, 1);
-    if (strncasecmp("users",
-                    (const char *) sysdb_comp_val->data,
-                    sysdb_comp_val->length) == 0) {
-        return true;
+    sysdb_comp_name = ldb_dn_get_component_name(dn, 1);
+    if (sysdb_comp_name == NULL || strcasecmp("cn", sysdb_comp_name) != 0) {
+        /* The second component name is not "cn" */
+        return false;
     }
 
     sysdb_comp_val = ldb_dn_get_component_val(dn, 1);
-    if (strncasecmp("groups",
-                    (const char *) sysdb_comp_val->data,
-                    sysdb_comp_val->length) == 0) {
-        return true;
+    for (i = 0; containers[i] != NULL; i++) {
+        if (sysdb_dn_val_equal(sysdb_comp_val, containers[i])) {
+            return true;
+        }
     }
 
     return false;
@@ -1845,9 +2195,9 @@ bool sysdb_msg_attrs_modts_differs(struct ldb_message *old_entry,
     return true;
 }
 
-static bool sysdb_ldb_msg_difference(struct ldb_dn *entry_dn,
-                                     struct ldb_message *db_msg,
-                                     struct ldb_message *mod_msg)
+bool sysdb_ldb_msg_difference(struct ldb_dn *entry_dn,
+                              struct ldb_message *db_msg,
+                              struct ldb_message *mod_msg)
 {
     struct ldb_message_element *mod_msg_el;
     struct ldb_message_element *db_msg_el;
@@ -1912,50 +2262,29 @@ static bool sysdb_ldb_msg_difference(struct ldb_dn *entry_dn,
     return false;
 }
 
-bool sysdb_entry_attrs_diff(struct sysdb_ctx *sysdb,
-                            struct ldb_dn *entry_dn,
-                            struct sysdb_attrs *attrs,
-                            int mod_op)
+bool sysdb_entry_msg_diff(struct sysdb_ctx *sysdb,
+                          struct ldb_message *mod_msg)
 {
-    struct ldb_message *new_entry_msg = NULL;
+    struct ldb_context *ldb;
     TALLOC_CTX *tmp_ctx;
     bool differs = true;
     int lret;
     errno_t ret;
     struct ldb_result *res;
-    const char *attrnames[attrs->num+1];
-
-    if (sysdb->ldb_ts == NULL) {
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Entry [%s] differs, reason: there is no ts_cache yet.\n",
-              ldb_dn_get_linearized(entry_dn));
-        return true;
-    }
-
-    if (is_ts_ldb_dn(entry_dn) == false) {
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Entry [%s] differs, reason: ts_cache doesn't trace this type of entry.\n",
-              ldb_dn_get_linearized(entry_dn));
-        return true;
-    }
+    const char *attrnames[mod_msg->num_elements + 1];
 
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
-        goto done;
-    }
-
-    new_entry_msg = sysdb_attrs2msg(tmp_ctx, entry_dn,
-                                    attrs, mod_op);
-    if (new_entry_msg == NULL) {
-        goto done;
+        return true;
     }
 
-    for (int i = 0; i < attrs->num; i++) {
-        attrnames[i] = attrs->a[i].name;
+    for (int i = 0; i < mod_msg->num_elements; i++) {
+        attrnames[i] = mod_msg->elements[i].name;
     }
-    attrnames[attrs->num] = NULL;
+    attrnames[mod_msg->num_elements] = NULL;
 
-    lret = ldb_search(sysdb->ldb, tmp_ctx, &res, entry_dn, LDB_SCOPE_BASE,
+    ldb = sysdb_ldb_for_dn(sysdb, mod_msg->dn);
+    lret = ldb_search(ldb, tmp_ctx, &res, mod_msg->dn, LDB_SCOPE_BASE,
                       attrnames, NULL);
     if (lret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(lret);
@@ -1963,15 +2292,44 @@ bool sysdb_entry_attrs_diff(struct sysdb_ctx *sysdb,
         goto done;
     }
 
-    if (res->count == 0) {
-        return true;
-    } else if (res->count != 1) {
-        ret = EIO;
+    if (res->count != 1) {
         goto done;
     }
 
-    differs = sysdb_ldb_msg_difference(entry_dn, res->msgs[0], new_entry_msg);
+    differs = sysdb_ldb_msg_difference(mod_msg->dn, res->msgs[0], mod_msg);
 done:
     talloc_free(tmp_ctx);
     return differs;
 }
+
+bool sysdb_entry_attrs_diff(struct sysdb_ctx *sysdb,
+                            struct ldb_dn *entry_dn,
+                            struct sysdb_attrs *attrs,
+                            int mod_op)
+{
+    struct ldb_message *new_entry_msg = NULL;
+    bool differs;
+
+    if (sysdb->ldb_ts == NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Entry [%s] differs, reason: there is no ts_cache yet.\n",
+              ldb_dn_get_linearized(entry_dn));
+        return true;
+    }
+
+    if (is_ts_ldb_dn(entry_dn) == false) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Entry [%s] differs, reason: ts_cache doesn't trace this type of entry.\n",
+              ldb_dn_get_linearized(entry_dn));
+        return true;
+    }
+
+    new_entry_msg = sysdb_attrs2msg(NULL, entry_dn, attrs, mod_op);
+    if (new_entry_msg == NULL) {
+        return true;
+    }
+
+    differs = sysdb_entry_msg_diff(sysdb, new_entry_msg);
+    talloc_free(new_entry_msg);
+    return differs;
+}
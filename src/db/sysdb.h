@@ -29,6 +29,8 @@
 
 #define CACHE_SYSDB_FILE "cache_%s.ldb"
 #define CACHE_TIMESTAMPS_FILE "timestamps_%s.ldb"
+#define CACHE_SUDO_FILE "cache_%s_sudo.ldb"
+#define CACHE_MISC_FILE "cache_%s_misc.ldb"
 #define LOCAL_SYSDB_FILE "sssd.ldb"
 
 #define SYSDB_BASE "cn=sysdb"
@@ -314,9 +316,17 @@
 struct confdb_ctx;
 struct sysdb_ctx;
 
+struct sss_attr_index;
+
 struct sysdb_attrs {
     int num;
     struct ldb_message_element *a;
+
+    /* Private index of element names used by sysdb_attrs_get_el_ext() on
+     * large sets of attributes. It is only trusted while it was built for
+     * the current @a and @num. */
+    struct sss_attr_index *name_index;
+    struct ldb_message_element *name_index_a;
 };
 
 /* sysdb_attrs helper functions */
@@ -479,6 +489,18 @@ char *sysdb_group_strdn(TALLOC_CTX *mem_ctx,
 
 struct ldb_context *sysdb_ctx_get_ldb(struct sysdb_ctx *sysdb);
 
+/* Returns the sequence number of the cache which is increased on every
+ * modification. It can be used to cheaply validate data derived from the
+ * cache. */
+errno_t sysdb_get_sequence_number(struct sysdb_ctx *sysdb, uint64_t *_seq);
+
+/* Same as sysdb_get_sequence_number() but only covers the cache file that
+ * stores the custom subtree, so writes of unrelated objects do not change
+ * it when the subtree is kept in a separate cache file. */
+errno_t sysdb_get_subtree_sequence_number(struct sss_domain_info *domain,
+                                          const char *subtree_name,
+                                          uint64_t *_seq);
+
 int compare_ldb_dn_comp_num(const void *m1, const void *m2);
 
 /* functions to start and finish transactions */
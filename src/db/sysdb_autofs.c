@@ -323,7 +323,7 @@ sysdb_save_autofsentry(struct sss_domain_info *domain,
     msg->elements = attrs->a;
     msg->num_elements = attrs->num;
 
-    ret = ldb_add(domain->sysdb->ldb, msg);
+    ret = ldb_add(sysdb_ldb_for_dn(domain->sysdb, dn), msg);
     ret = sysdb_error_to_errno(ret);
 done:
     talloc_free(tmp_ctx);
@@ -104,6 +104,7 @@ static errno_t sysdb_chown_db_files(struct sysdb_ctx *sysdb,
                                     uid_t uid, gid_t gid)
 {
     errno_t ret;
+    int i;
 
     ret = chown(sysdb->ldb_file, uid, gid);
     if (ret != 0) {
@@ -120,7 +121,22 @@ static errno_t sysdb_chown_db_files(struct sysdb_ctx *sysdb,
             ret = errno;
             DEBUG(SSSDBG_CRIT_FAILURE,
                   "Cannot set sysdb ownership of %s to %"SPRIuid":%"SPRIgid"\n",
-                  sysdb->ldb_ts_file, uid, gid);
+                        sysdb->ldb_ts_file, uid, gid);
+            return ret;
+        }
+    }
+
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        if (sysdb->ldb_shards[i] == NULL) {
+            continue;
+        }
+
+        ret = chown(sysdb->ldb_shard_files[i], uid, gid);
+        if (ret != 0) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Cannot set sysdb ownership of %s to %"SPRIuid":%"SPRIgid"\n",
+                  sysdb->ldb_shard_files[i], uid, gid);
             return ret;
         }
     }
@@ -527,6 +543,31 @@ static errno_t remove_ts_cache(struct sysdb_ctx *sysdb)
     return EOK;
 }
 
+static errno_t remove_shard_caches(struct sysdb_ctx *sysdb, bool *_removed)
+{
+    bool removed = false;
+    errno_t ret;
+    int i;
+
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        if (sysdb->ldb_shard_files[i] == NULL) {
+            continue;
+        }
+
+        ret = unlink(sysdb->ldb_shard_files[i]);
+        if (ret != EOK && errno != ENOENT) {
+            return errno;
+        }
+        removed |= (ret == EOK);
+    }
+
+    if (_removed != NULL) {
+        *_removed = removed;
+    }
+
+    return EOK;
+}
+
 static errno_t sysdb_cache_connect_helper(TALLOC_CTX *mem_ctx,
                                           struct sysdb_ctx *sysdb,
                                           struct sss_domain_info *domain,
@@ -666,6 +707,13 @@ static errno_t sysdb_cache_connect(TALLOC_CTX *mem_ctx,
                   "Could not delete the timestamp ldb file (%d) (%s)\n",
                   ret, sss_strerror(ret));
         }
+
+        ret = remove_shard_caches(sysdb, NULL);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Could not delete the shard ldb files (%d) (%s)\n",
+                  ret, sss_strerror(ret));
+        }
     }
 
     return ret;
@@ -724,6 +772,13 @@ static int sysdb_domain_cache_connect(struct sysdb_ctx *sysdb,
             return ret;
         }
 
+        ret = remove_shard_caches(sysdb, NULL);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Could not delete the shard ldb files (%d) (%s)\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
 
         /* The version should now match SYSDB_VERSION.
          * If not, it means we didn't match any of the
@@ -859,6 +914,216 @@ static int sysdb_timestamp_cache_connect(struct sysdb_ctx *sysdb,
     return ret;
 }
 
+static errno_t sysdb_get_shard_files(struct sysdb_ctx *sysdb,
+                                     struct sss_domain_info *domain,
+                                     const char *db_path)
+{
+    /* The local domain keeps everything in a single file */
+    if (strcasecmp(domain->provider, "local") == 0) {
+        return EOK;
+    }
+
+    /* The file names are known even if sharding is disabled, so that
+     * leftover shards can be removed.
+     */
+    sysdb->ldb_shard_files[SYSDB_SHARD_SUDO] = talloc_asprintf(sysdb,
+                                                   "%s/"CACHE_SUDO_FILE,
+                                                   db_path, domain->name);
+    if (sysdb->ldb_shard_files[SYSDB_SHARD_SUDO] == NULL) {
+        return ENOMEM;
+    }
+
+    sysdb->ldb_shard_files[SYSDB_SHARD_MISC] = talloc_asprintf(sysdb,
+                                                   "%s/"CACHE_MISC_FILE,
+                                                   db_path, domain->name);
+    if (sysdb->ldb_shard_files[SYSDB_SHARD_MISC] == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+/* Removes the subtrees now stored in a freshly created shard from the main
+ * cache file. They would never be read or refreshed there again.
+ */
+static errno_t sysdb_shard_purge_main(struct sysdb_ctx *sysdb,
+                                      struct sss_domain_info *domain,
+                                      enum sysdb_shard shard)
+{
+    struct ldb_dn *dn;
+    errno_t ret;
+    int i;
+
+    for (i = 0; sysdb_shard_subtrees[i].subtree != NULL; i++) {
+        if (sysdb_shard_subtrees[i].shard != shard) {
+            continue;
+        }
+
+        dn = ldb_dn_new_fmt(NULL, sysdb->ldb, SYSDB_TMPL_CUSTOM_SUBTREE,
+                            sysdb_shard_subtrees[i].subtree, domain->name);
+        if (dn == NULL) {
+            return ENOMEM;
+        }
+
+        ret = sysdb_delete_recursive(sysdb, dn, true);
+        talloc_free(dn);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+/* A shard file that starts over resets its sequence number, the generation
+ * keeps sysdb_get_sequence_number() from going back.
+ */
+static errno_t sysdb_shard_generation_bump(struct sysdb_ctx *sysdb)
+{
+    struct ldb_message *msg;
+    uint64_t gen;
+    errno_t ret;
+    int lret;
+
+    ret = sysdb_get_shard_generation(sysdb, &gen);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    msg = ldb_msg_new(NULL);
+    if (msg == NULL) {
+        return ENOMEM;
+    }
+
+    msg->dn = ldb_dn_new(msg, sysdb->ldb, SYSDB_BASE);
+    if (msg->dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    lret = ldb_msg_add_empty(msg, SYSDB_SHARD_GENERATION,
+                             LDB_FLAG_MOD_REPLACE, NULL);
+    if (lret == LDB_SUCCESS) {
+        lret = ldb_msg_add_fmt(msg, SYSDB_SHARD_GENERATION, "%"PRIu64,
+                               gen + 1);
+    }
+    if (lret == LDB_SUCCESS) {
+        lret = ldb_modify(sysdb->ldb, msg);
+    }
+    ret = sysdb_error_to_errno(lret);
+
+done:
+    talloc_free(msg);
+    return ret;
+}
+
+static int sysdb_shard_caches_connect(struct sysdb_ctx *sysdb,
+                                      struct sss_domain_info *domain)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_context *ldb;
+    const char *version;
+    bool newly_created;
+    bool removed;
+    errno_t ret;
+    int i;
+
+    if (sysdb->ldb_shard_files[0] == NULL) {
+        return EOK;
+    }
+
+    if (!domain->cache_shards) {
+        ret = remove_shard_caches(sysdb, &removed);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Could not delete the shard ldb files (%d) (%s)\n",
+                  ret, sss_strerror(ret));
+        }
+
+        if (removed) {
+            ret = sysdb_shard_generation_bump(sysdb);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        DEBUG(SSSDBG_FUNC_DATA, "Shard file for %s: %s\n",
+              domain->name, sysdb->ldb_shard_files[i]);
+
+        ret = sysdb_cache_connect_helper(tmp_ctx, sysdb, domain,
+                                         sysdb->ldb_shard_files[i], 0,
+                                         SYSDB_SHARD_VERSION,
+                                         SYSDB_SHARD_BASE_LDIF,
+                                         &newly_created, &ldb, &version);
+        if (ret == ERR_SYSDB_VERSION_TOO_OLD
+                || ret == ERR_SYSDB_VERSION_TOO_NEW) {
+            /* The shards only hold cached data that can be fetched again,
+             * so there is no upgrade path, just start over. */
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Shard version [%s] does not match [%s], "
+                  "throwing away %s\n", version, SYSDB_SHARD_VERSION,
+                  sysdb->ldb_shard_files[i]);
+
+            talloc_zfree(ldb);
+            ret = unlink(sysdb->ldb_shard_files[i]);
+            if (ret != EOK && errno != ENOENT) {
+                ret = errno;
+                goto done;
+            }
+
+            ret = sysdb_cache_connect_helper(tmp_ctx, sysdb, domain,
+                                             sysdb->ldb_shard_files[i], 0,
+                                             SYSDB_SHARD_VERSION,
+                                             SYSDB_SHARD_BASE_LDIF,
+                                             &newly_created, &ldb, &version);
+        }
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not open %s (%d) (%s)\n",
+                  sysdb->ldb_shard_files[i], ret, sss_strerror(ret));
+            goto done;
+        }
+
+        if (newly_created) {
+            ret = sysdb_shard_generation_bump(sysdb);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "Could not update the shard generation (%d) (%s)\n",
+                      ret, sss_strerror(ret));
+                goto done;
+            }
+
+            ret = sysdb_shard_purge_main(sysdb, domain, i);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Could not purge sharded entries from the main "
+                      "cache (%d) (%s)\n", ret, sss_strerror(ret));
+                /* Not fatal, the entries just stay unused */
+            }
+        }
+
+        sysdb->ldb_shards[i] = talloc_steal(sysdb, ldb);
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+            talloc_zfree(sysdb->ldb_shards[i]);
+        }
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
                                struct sss_domain_info *domain,
                                const char *db_path,
@@ -892,6 +1157,11 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
              "Timestamp file for %s: %s\n", domain->name, sysdb->ldb_ts_file);
     }
 
+    ret = sysdb_get_shard_files(sysdb, domain, db_path);
+    if (ret != EOK) {
+        goto done;
+    }
+
     ret = sysdb_domain_cache_connect(sysdb, domain, upgrade_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -908,6 +1178,14 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = sysdb_shard_caches_connect(sysdb, domain);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Could not open the shard caches [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
 done:
     if (ret == EOK) {
         *_ctx = talloc_steal(mem_ctx, sysdb);
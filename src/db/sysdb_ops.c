@@ -141,7 +141,8 @@ int sysdb_delete_entry(struct sysdb_ctx *sysdb,
     errno_t ret;
     errno_t tret;
 
-    ret = sysdb_delete_cache_entry(sysdb->ldb, dn, ignore_not_found);
+    ret = sysdb_delete_cache_entry(sysdb_ldb_for_dn(sysdb, dn), dn,
+                                   ignore_not_found);
     if (ret == EOK) {
         tret = sysdb_delete_ts_entry(sysdb, dn);
         if (tret != EOK) {
@@ -159,6 +160,69 @@ int sysdb_delete_entry(struct sysdb_ctx *sysdb,
 
 /* =Remove-Subentries-From-Sysdb=========================================== */
 
+/* Removes the entries below 'dn' that live in shard caches. Only needed
+ * when 'dn' itself is stored in the main cache, e.g. when a whole domain
+ * is removed, otherwise the regular search already covers the shard. */
+static int sysdb_delete_recursive_shards(struct sysdb_ctx *sysdb,
+                                         struct ldb_dn *dn)
+{
+    const char *no_attrs[] = { NULL };
+    struct ldb_result *res;
+    TALLOC_CTX *tmp_ctx;
+    int ret;
+    int i;
+    int j;
+
+    if (sysdb_ldb_for_dn(sysdb, dn) != sysdb->ldb) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < SYSDB_SHARD_NUM; i++) {
+        if (sysdb->ldb_shards[i] == NULL) {
+            continue;
+        }
+
+        ret = ldb_search(sysdb->ldb_shards[i], tmp_ctx, &res, dn,
+                         LDB_SCOPE_SUBTREE, no_attrs,
+                         "(distinguishedName=*)");
+        if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+            continue;
+        } else if (ret != LDB_SUCCESS) {
+            ret = sysdb_error_to_errno(ret);
+            goto done;
+        }
+
+        qsort(res->msgs, res->count,
+              sizeof(struct ldb_message *), compare_ldb_dn_comp_num);
+
+        for (j = 0; j < res->count; j++) {
+            ret = sysdb_delete_cache_entry(sysdb->ldb_shards[i],
+                                           res->msgs[j]->dn, true);
+            if (ret != EOK) {
+                goto done;
+            }
+
+            ret = sysdb_delete_ts_entry(sysdb, res->msgs[j]->dn);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "sysdb_delete_ts_entry failed: %d\n", ret);
+                /* Not fatal */
+            }
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 int sysdb_delete_recursive(struct sysdb_ctx *sysdb,
                            struct ldb_dn *dn,
                            bool ignore_not_found)
@@ -175,9 +239,14 @@ int sysdb_delete_recursive(struct sysdb_ctx *sysdb,
         return ENOMEM;
     }
 
-    ret = ldb_transaction_start(sysdb->ldb);
+    ret = sysdb_transaction_start(sysdb);
+    if (ret) {
+        talloc_free(tmp_ctx);
+        return ret;
+    }
+
+    ret = sysdb_delete_recursive_shards(sysdb, dn);
     if (ret) {
-        ret = sysdb_error_to_errno(ret);
         goto done;
     }
 
@@ -212,10 +281,9 @@ int sysdb_delete_recursive(struct sysdb_ctx *sysdb,
 
 done:
     if (ret == EOK) {
-        ret = ldb_transaction_commit(sysdb->ldb);
-        ret = sysdb_error_to_errno(ret);
+        ret = sysdb_transaction_commit(sysdb);
     } else {
-        ldb_transaction_cancel(sysdb->ldb);
+        sysdb_transaction_cancel(sysdb);
     }
     talloc_free(tmp_ctx);
     return ret;
@@ -275,8 +343,9 @@ int sysdb_search_entry(TALLOC_CTX *mem_ctx,
 {
     errno_t ret;
 
-    ret = sysdb_cache_search_entry(mem_ctx, sysdb->ldb, base_dn, scope,
-                                   filter, attrs, _msgs_count, _msgs);
+    ret = sysdb_cache_search_entry(mem_ctx, sysdb_ldb_for_dn(sysdb, base_dn),
+                                   base_dn, scope, filter, attrs,
+                                   _msgs_count, _msgs);
     if (ret != EOK) {
         return ret;
     }
@@ -909,7 +978,7 @@ static errno_t sysdb_create_ts_entry(struct sysdb_ctx *sysdb,
     }
 
     lret = ldb_add(sysdb->ldb_ts, msg);
-    if (lret != LDB_SUCCESS) {
+    if (lret != LDB_SUCCESS && lret != LDB_ERR_ENTRY_ALREADY_EXISTS) {
         DEBUG(SSSDBG_OP_FAILURE,
               "ldb_add failed: [%s](%d)[%s]\n",
               ldb_strerror(lret), lret, ldb_errstring(sysdb->ldb_ts));
@@ -919,6 +988,8 @@ static errno_t sysdb_create_ts_entry(struct sysdb_ctx *sysdb,
 done:
     if (ret == ENOENT) {
         DEBUG(SSSDBG_TRACE_FUNC, "No such entry\n");
+    } else if (ret == EEXIST) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Timestamps entry already exists\n");
     } else if (ret) {
         DEBUG(SSSDBG_OP_FAILURE, "Error: %d (%s)\n", ret, strerror(ret));
     }
@@ -1271,7 +1342,8 @@ int sysdb_set_entry_attr(struct sysdb_ctx *sysdb,
 
     sysdb_write = sysdb_entry_attrs_diff(sysdb, entry_dn, attrs, mod_op);
     if (sysdb_write == true) {
-        ret = sysdb_set_cache_entry_attr(sysdb->ldb, entry_dn, attrs, mod_op);
+        ret = sysdb_set_cache_entry_attr(sysdb_ldb_for_dn(sysdb, entry_dn),
+                                         entry_dn, attrs, mod_op);
         if (ret != EOK) {
             DEBUG(SSSDBG_MINOR_FAILURE,
                   "Cannot set attrs for %s, %d [%s]\n",
@@ -1314,6 +1386,63 @@ static int sysdb_rep_ts_entry_attr(struct sysdb_ctx *sysdb,
                                       attrs, SYSDB_MOD_REP);
 }
 
+/* Creates the timestamps entry of an object that is already stored in the
+ * sysdb cache but has no timestamps entry yet, typically because it was
+ * cached before the timestamps cache handled its object class. */
+static errno_t sysdb_create_ts_entry_from_cache(struct sysdb_ctx *sysdb,
+                                                struct ldb_dn *entry_dn,
+                                                struct sysdb_attrs *ts_attrs)
+{
+    const char *attrs[] = { SYSDB_OBJECTCLASS, NULL };
+    struct ldb_message_element *el;
+    struct ldb_result *res;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int lret;
+
+    ret = sysdb_attrs_get_el_ext(ts_attrs, SYSDB_OBJECTCLASS, false, &el);
+    if (ret == EOK) {
+        return sysdb_create_ts_entry(sysdb, entry_dn, ts_attrs);
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    lret = ldb_search(sysdb_ldb_for_dn(sysdb, entry_dn), tmp_ctx, &res,
+                      entry_dn, LDB_SCOPE_BASE, attrs, NULL);
+    if (lret != LDB_SUCCESS) {
+        ret = sysdb_error_to_errno(lret);
+        goto done;
+    }
+
+    if (res->count != 1) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    el = ldb_msg_find_element(res->msgs[0], SYSDB_OBJECTCLASS);
+    if (el == NULL) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < el->num_values; i++) {
+        ret = sysdb_attrs_add_val(ts_attrs, SYSDB_OBJECTCLASS,
+                                  &el->values[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = sysdb_create_ts_entry(sysdb, entry_dn, ts_attrs);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 static int sysdb_set_ts_entry_attr(struct sysdb_ctx *sysdb,
                                    struct ldb_dn *entry_dn,
                                    struct sysdb_attrs *attrs,
@@ -1341,9 +1470,15 @@ static int sysdb_set_ts_entry_attr(struct sysdb_ctx *sysdb,
     switch (mod_op) {
     case SYSDB_MOD_REP:
         ret = sysdb_rep_ts_entry_attr(sysdb, entry_dn, ts_attrs);
+        if (ret == ENOENT) {
+            ret = sysdb_create_ts_entry_from_cache(sysdb, entry_dn, ts_attrs);
+        }
         break;
     case SYSDB_MOD_ADD:
         ret = sysdb_create_ts_entry(sysdb, entry_dn, ts_attrs);
+        if (ret == EEXIST) {
+            ret = sysdb_rep_ts_entry_attr(sysdb, entry_dn, ts_attrs);
+        }
         break;
     default:
         ret = EINVAL;
@@ -3250,7 +3385,10 @@ int sysdb_store_custom(struct sss_domain_info *domain,
     struct ldb_message **resp;
     struct ldb_message *msg;
     struct ldb_message_element *el;
+    struct ldb_context *ldb;
     bool add_object = false;
+    bool ts_object;
+    errno_t tret;
     int ret;
     int i;
 
@@ -3258,9 +3396,9 @@ int sysdb_store_custom(struct sss_domain_info *domain,
         return EINVAL;
     }
 
-    ret = ldb_transaction_start(domain->sysdb->ldb);
+    ret = sysdb_transaction_start(domain->sysdb);
     if (ret) {
-        return sysdb_error_to_errno(ret);
+        return ret;
     }
 
     tmp_ctx = talloc_new(NULL);
@@ -3314,24 +3452,45 @@ int sysdb_store_custom(struct sss_domain_info *domain,
     }
     msg->num_elements = attrs->num;
 
+    ldb = sysdb_ldb_for_dn(domain->sysdb, msg->dn);
+    ts_object = domain->sysdb->ldb_ts != NULL && is_ts_ldb_dn(msg->dn);
     if (add_object) {
-        ret = ldb_add(domain->sysdb->ldb, msg);
+        ret = ldb_add(ldb, msg);
+    } else if (ts_object
+                && !sysdb_ldb_msg_difference(msg->dn, resp[0], msg)) {
+        /* Only the timestamps changed, they are written below */
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "Custom entry [%s] did not change\n",
+              ldb_dn_get_linearized(msg->dn));
+        ret = LDB_SUCCESS;
     } else {
-        ret = ldb_modify(domain->sysdb->ldb, msg);
+        ret = ldb_modify(ldb, msg);
     }
     if (ret != LDB_SUCCESS) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to store custom entry: %s(%d)[%s]\n",
-                  ldb_strerror(ret), ret, ldb_errstring(domain->sysdb->ldb));
+                  ldb_strerror(ret), ret, ldb_errstring(ldb));
         ret = sysdb_error_to_errno(ret);
+        goto done;
+    }
+
+    if (ts_object) {
+        tret = sysdb_set_ts_entry_attr(domain->sysdb, msg->dn, attrs,
+                                       add_object ? SYSDB_MOD_ADD
+                                                  : SYSDB_MOD_REP);
+        if (tret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot set ts attrs for %s\n",
+                  ldb_dn_get_linearized(msg->dn));
+            /* Not fatal */
+        }
     }
 
 done:
     if (ret) {
         DEBUG(SSSDBG_TRACE_FUNC, "Error: %d (%s)\n", ret, strerror(ret));
-        ldb_transaction_cancel(domain->sysdb->ldb);
+        sysdb_transaction_cancel(domain->sysdb);
     } else {
-        ret = ldb_transaction_commit(domain->sysdb->ldb);
-        ret = sysdb_error_to_errno(ret);
+        ret = sysdb_transaction_commit(domain->sysdb);
     }
     talloc_zfree(tmp_ctx);
     return ret;
@@ -3344,6 +3503,7 @@ int sysdb_delete_custom(struct sss_domain_info *domain,
                         const char *subtree_name)
 {
     TALLOC_CTX *tmp_ctx;
+    struct ldb_context *ldb;
     struct ldb_dn *dn;
     int ret;
 
@@ -3363,17 +3523,24 @@ int sysdb_delete_custom(struct sss_domain_info *domain,
         goto done;
     }
 
-    ret = ldb_delete(domain->sysdb->ldb, dn);
+    ldb = sysdb_ldb_for_dn(domain->sysdb, dn);
+    ret = ldb_delete(ldb, dn);
 
     switch (ret) {
     case LDB_SUCCESS:
     case LDB_ERR_NO_SUCH_OBJECT:
+        ret = sysdb_delete_ts_entry(domain->sysdb, dn);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "sysdb_delete_ts_entry failed: %d\n", ret);
+            /* Not fatal */
+        }
         ret = EOK;
         break;
 
     default:
         DEBUG(SSSDBG_CRIT_FAILURE, "LDB Error: %s(%d)\nError Message: [%s]\n",
-                  ldb_strerror(ret), ret, ldb_errstring(domain->sysdb->ldb));
+                  ldb_strerror(ret), ret, ldb_errstring(ldb));
         ret = sysdb_error_to_errno(ret);
         break;
     }
@@ -5237,7 +5404,7 @@ errno_t sysdb_mark_entry_as_expired_ldb_dn(struct sss_domain_info *dom,
         goto done;
     }
 
-    ret = ldb_modify(dom->sysdb->ldb, msg);
+    ret = ldb_modify(sysdb_ldb_for_dn(dom->sysdb, ldbdn), msg);
     if (ret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(ret);
         goto done;
@@ -105,8 +105,60 @@
      "description: base object\n" \
      "\n" \
 
+/* The shard caches have their own versioning as well */
+#define SYSDB_SHARD_VERSION_0_1 "0.1"
+
+#define SYSDB_SHARD_VERSION SYSDB_SHARD_VERSION_0_1
+
+#define SYSDB_SHARD_BASE_LDIF \
+     "dn: @ATTRIBUTES\n" \
+     "cn: CASE_INSENSITIVE\n" \
+     "dc: CASE_INSENSITIVE\n" \
+     "dn: CASE_INSENSITIVE\n" \
+     "originalDN: CASE_INSENSITIVE\n" \
+     "objectclass: CASE_INSENSITIVE\n" \
+     "\n" \
+     "dn: @INDEXLIST\n" \
+     "@IDXATTR: cn\n" \
+     "@IDXATTR: objectclass\n" \
+     "@IDXATTR: name\n" \
+     "@IDXATTR: lastUpdate\n" \
+     "@IDXATTR: dataExpireTimestamp\n" \
+     "@IDXATTR: originalDN\n" \
+     "@IDXATTR: sudoUser\n" \
+     "@IDXATTR: sshKnownHostsExpire\n" \
+     "@IDXONE: 1\n" \
+     "\n" \
+     "dn: cn=sysdb\n" \
+     "cn: sysdb\n" \
+     "version: " SYSDB_SHARD_VERSION "\n" \
+     "description: base object\n" \
+     "\n" \
+
 #include "db/sysdb.h"
 
+/* Custom subtrees that can be moved out of the main cache file into
+ * a shard cache of their own with the cache_shards domain option
+ */
+enum sysdb_shard {
+    SYSDB_SHARD_SUDO,
+    SYSDB_SHARD_MISC,
+
+    SYSDB_SHARD_NUM /* must be last */
+};
+
+struct sysdb_shard_subtree {
+    const char *subtree;
+    enum sysdb_shard shard;
+};
+
+/* NULL-terminated list of the custom subtrees living in shard caches */
+extern const struct sysdb_shard_subtree sysdb_shard_subtrees[];
+
+/* Counter in the base entry of the main cache, incremented whenever a shard
+ * file is created or removed */
+#define SYSDB_SHARD_GENERATION "shardGeneration"
+
 struct sysdb_ctx {
     struct ldb_context *ldb;
     char *ldb_file;
@@ -114,6 +166,9 @@ struct sysdb_ctx {
     struct ldb_context *ldb_ts;
     char *ldb_ts_file;
 
+    struct ldb_context *ldb_shards[SYSDB_SHARD_NUM];
+    char *ldb_shard_files[SYSDB_SHARD_NUM];
+
     int transaction_nesting;
 };
 
@@ -199,9 +254,9 @@ struct sss_domain_info *new_subdomain(TALLOC_CTX *mem_ctx,
  * opaque to the sysdb consumers
  */
 
-/* Returns true if the 'dn' parameter is a user or a group DN, because
- * at the moment, the timestamps cache only handles users and groups.
- * Returns false otherwise.
+/* Returns true if the 'dn' parameter is a DN of an object whose timestamps
+ * are kept in the timestamps cache: users, groups, netgroups, services,
+ * sudo rules and autofs maps. Returns false otherwise.
  */
 bool is_ts_ldb_dn(struct ldb_dn *dn);
 
@@ -291,4 +346,27 @@ bool sysdb_entry_attrs_diff(struct sysdb_ctx *sysdb,
                             struct sysdb_attrs *attrs,
                             int mod_op);
 
+/* Same as sysdb_entry_attrs_diff() for a modification message that is
+ * already built, the entry is the one named by mod_msg->dn. Does not check
+ * whether the entry is handled by the timestamps cache.
+ */
+bool sysdb_entry_msg_diff(struct sysdb_ctx *sysdb,
+                          struct ldb_message *mod_msg);
+
+/* Returns true if applying mod_msg to db_msg, the current content of
+ * entry_dn, would change anything else than the timestamp attributes.
+ */
+bool sysdb_ldb_msg_difference(struct ldb_dn *entry_dn,
+                              struct ldb_message *db_msg,
+                              struct ldb_message *mod_msg);
+
+/* Returns the ldb context that stores the entry 'dn'. This is the shard
+ * cache if the DN belongs to a sharded custom subtree and the shard is
+ * enabled, the main cache otherwise.
+ */
+struct ldb_context *sysdb_ldb_for_dn(struct sysdb_ctx *sysdb,
+                                     struct ldb_dn *dn);
+
+errno_t sysdb_get_shard_generation(struct sysdb_ctx *sysdb, uint64_t *_gen);
+
 #endif /* __INT_SYS_DB_H__ */
@@ -38,7 +38,8 @@ static errno_t merge_ts_attr(struct ldb_message *ts_msg,
 
     if (want_attrs != NULL) {
         /* Otherwise merge all ts attrs */
-        include = string_in_list(ts_attr, discard_const(want_attrs), true);
+        include = string_in_list(ts_attr, discard_const(want_attrs), true)
+                  || string_in_list("*", discard_const(want_attrs), true);
     }
     if (include == false) {
         return EOK;
@@ -133,13 +134,31 @@ done:
     return ret;
 }
 
+/* Returns false if none of the attributes merge_msg_ts_attrs() would merge
+ * was requested, so the timestamp cache does not need to be searched */
+static bool ts_attrs_requested(const char *attrs[])
+{
+    if (attrs == NULL || string_in_list("*", discard_const(attrs), true)) {
+        return true;
+    }
+
+    for (size_t c = 1; sysdb_ts_cache_attrs[c]; c++) {
+        if (string_in_list(sysdb_ts_cache_attrs[c],
+                           discard_const(attrs), true)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 errno_t sysdb_merge_res_ts_attrs(struct sysdb_ctx *ctx,
                                  struct ldb_result *res,
                                  const char *attrs[])
 {
     errno_t ret;
 
-    if (res == NULL || ctx->ldb_ts == NULL) {
+    if (res == NULL || ctx->ldb_ts == NULL || !ts_attrs_requested(attrs)) {
         return EOK;
     }
 
@@ -1971,6 +1990,17 @@ errno_t sysdb_getnetgr(TALLOC_CTX *mem_ctx,
                    sanitized_netgroup, sanitized_netgroup,
                    netgroup_dn);
 
+    if (ret == EOK) {
+        /* Merge in the timestamps from the fast ts db */
+        ret = sysdb_merge_res_ts_attrs(domain->sysdb, result, attrs);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot merge timestamp cache values\n");
+            /* non-fatal */
+            ret = EOK;
+        }
+    }
+
     if (ret == EOK || ret == ENOENT) {
         *res = talloc_steal(mem_ctx, result);
     }
@@ -2023,7 +2053,15 @@ int sysdb_get_netgroup_attr(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    /* Merge in the timestamps from the fast ts db */
+    ret = sysdb_merge_res_ts_attrs(domain->sysdb, result, attributes);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Cannot merge timestamp cache values\n");
+        /* non-fatal */
+    }
+
     *res = talloc_steal(mem_ctx, result);
+    ret = EOK;
 done:
     talloc_zfree(tmp_ctx);
     return ret;
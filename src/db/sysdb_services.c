@@ -584,6 +584,14 @@ sysdb_svc_update(struct sysdb_ctx *sysdb,
         }
     }
 
+    if (sysdb->ldb_ts != NULL && is_ts_ldb_dn(dn)
+            && !sysdb_entry_msg_diff(sysdb, msg)) {
+        /* The service did not change, the caller only bumps its
+         * timestamps */
+        ret = EOK;
+        goto done;
+    }
+
     lret = ldb_modify(sysdb->ldb, msg);
     if (lret != LDB_SUCCESS) {
         DEBUG(SSSDBG_MINOR_FAILURE,
@@ -26,6 +26,7 @@
 #include "db/sysdb.h"
 #include "db/sysdb_private.h"
 #include "db/sysdb_sudo.h"
+#include "util/murmurhash3.h"
 
 #define SUDO_ALL_FILTER "(" SYSDB_OBJECTCLASS "=" SYSDB_SUDO_CACHE_OC ")"
 
@@ -485,6 +486,7 @@ static errno_t sysdb_sudo_set_refresh_time(struct sss_domain_info *domain,
                                            time_t value)
 {
     TALLOC_CTX *tmp_ctx;
+    struct ldb_context *ldb;
     struct ldb_dn *dn;
     struct ldb_message *msg = NULL;
     struct ldb_result *res = NULL;
@@ -505,7 +507,9 @@ static errno_t sysdb_sudo_set_refresh_time(struct sss_domain_info *domain,
         goto done;
     }
 
-    lret = ldb_search(domain->sysdb->ldb, tmp_ctx, &res, dn, LDB_SCOPE_BASE,
+    ldb = sysdb_ldb_for_dn(domain->sysdb, dn);
+
+    lret = ldb_search(ldb, tmp_ctx, &res, dn, LDB_SCOPE_BASE,
                       NULL, NULL);
     if (lret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(lret);
@@ -545,15 +549,15 @@ static errno_t sysdb_sudo_set_refresh_time(struct sss_domain_info *domain,
     }
 
     if (res->count) {
-        lret = ldb_modify(domain->sysdb->ldb, msg);
+        lret = ldb_modify(ldb, msg);
     } else {
-        lret = ldb_add(domain->sysdb->ldb, msg);
+        lret = ldb_add(ldb, msg);
     }
 
     if (lret != LDB_SUCCESS) {
         DEBUG(SSSDBG_MINOR_FAILURE,
               "ldb operation failed: [%s](%d)[%s]\n",
-              ldb_strerror(lret), lret, ldb_errstring(domain->sysdb->ldb));
+              ldb_strerror(lret), lret, ldb_errstring(ldb));
     }
     ret = sysdb_error_to_errno(lret);
 
@@ -585,8 +589,8 @@ static errno_t sysdb_sudo_get_refresh_time(struct sss_domain_info *domain,
         goto done;
     }
 
-    lret = ldb_search(domain->sysdb->ldb, tmp_ctx, &res, dn, LDB_SCOPE_BASE,
-                      attrs, NULL);
+    lret = ldb_search(sysdb_ldb_for_dn(domain->sysdb, dn), tmp_ctx, &res, dn,
+                      LDB_SCOPE_BASE, attrs, NULL);
     if (lret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(lret);
         goto done;
@@ -719,9 +723,72 @@ sysdb_sudo_purge_byrules(struct sss_domain_info *dom,
     return EOK;
 }
 
+static int sysdb_sudo_name_cmp(const void *a, const void *b)
+{
+    return strcasecmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+/* Removes the rules that are about to be stored again from the list of rules
+ * to purge, sysdb_sudo_store() replaces them in place. */
+static errno_t
+sysdb_sudo_skip_stored_rules(struct sysdb_attrs **rules,
+                             size_t *_count,
+                             struct sysdb_attrs **stored_rules,
+                             size_t num_stored_rules)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char **names;
+    const char *name;
+    size_t num_names;
+    size_t count;
+    size_t i;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    names = talloc_array(tmp_ctx, const char *, num_stored_rules);
+    if (names == NULL) {
+        talloc_free(tmp_ctx);
+        return ENOMEM;
+    }
+
+    num_names = 0;
+    for (i = 0; i < num_stored_rules; i++) {
+        name = sysdb_sudo_get_rule_name(stored_rules[i]);
+        if (name != NULL) {
+            names[num_names++] = name;
+        }
+    }
+
+    qsort(names, num_names, sizeof(const char *), sysdb_sudo_name_cmp);
+
+    count = 0;
+    for (i = 0; i < *_count; i++) {
+        name = sysdb_sudo_get_rule_name(rules[i]);
+        if (name != NULL
+                && bsearch(&name, names, num_names, sizeof(const char *),
+                           sysdb_sudo_name_cmp) != NULL) {
+            continue;
+        }
+
+        rules[count++] = rules[i];
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "%zu rules are going to be replaced in place\n",
+          *_count - count);
+
+    *_count = count;
+    talloc_free(tmp_ctx);
+    return EOK;
+}
+
 static errno_t
 sysdb_sudo_purge_byfilter(struct sss_domain_info *domain,
-                          const char *filter)
+                          const char *filter,
+                          struct sysdb_attrs **stored_rules,
+                          size_t num_stored_rules)
 {
     TALLOC_CTX *tmp_ctx;
     struct sysdb_attrs **rules;
@@ -733,7 +800,11 @@ sysdb_sudo_purge_byfilter(struct sss_domain_info *domain,
                             SYSDB_SUDO_CACHE_AT_CN,
                             NULL };
 
-    if (filter == NULL || strcmp(filter, SUDO_ALL_FILTER) == 0) {
+    if (filter == NULL) {
+        filter = SUDO_ALL_FILTER;
+    }
+
+    if (strcmp(filter, SUDO_ALL_FILTER) == 0 && num_stored_rules == 0) {
         return sysdb_sudo_purge_all(domain);
     }
 
@@ -762,6 +833,14 @@ sysdb_sudo_purge_byfilter(struct sss_domain_info *domain,
         goto done;
     }
 
+    if (num_stored_rules > 0) {
+        ret = sysdb_sudo_skip_stored_rules(rules, &count,
+                                           stored_rules, num_stored_rules);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
     ret = sysdb_sudo_purge_byrules(domain, rules, count);
 
 done:
@@ -786,7 +865,8 @@ errno_t sysdb_sudo_purge(struct sss_domain_info *domain,
     in_transaction = true;
 
     if (delete_filter) {
-        ret = sysdb_sudo_purge_byfilter(domain, delete_filter);
+        ret = sysdb_sudo_purge_byfilter(domain, delete_filter,
+                                        rules, num_rules);
     } else {
         ret = sysdb_sudo_purge_byrules(domain, rules, num_rules);
     }
@@ -852,6 +932,39 @@ sysdb_sudo_add_sss_attrs(struct sysdb_attrs *rule,
     return EOK;
 }
 
+/* Must be called before the expiration is added to the rule. */
+static errno_t
+sysdb_sudo_add_hash(struct sysdb_attrs *rule)
+{
+    struct ldb_message_element *el;
+    uint32_t hash = 0;
+    unsigned int j;
+    int i;
+    errno_t ret;
+
+    for (i = 0; i < rule->num; i++) {
+        el = &rule->a[i];
+        if (strcasecmp(el->name, SYSDB_SUDO_CACHE_AT_HASH) == 0) {
+            continue;
+        }
+
+        hash = murmurhash3(el->name, strlen(el->name), hash);
+        for (j = 0; j < el->num_values; j++) {
+            hash = murmurhash3((const char *)el->values[j].data,
+                               el->values[j].length, hash);
+        }
+    }
+
+    ret = sysdb_attrs_add_uint32(rule, SYSDB_SUDO_CACHE_AT_HASH, hash);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to add %s attribute [%d]: %s\n",
+              SYSDB_SUDO_CACHE_AT_HASH, ret, strerror(ret));
+        return ret;
+    }
+
+    return EOK;
+}
+
 static errno_t sysdb_sudo_add_lowered_users(struct sss_domain_info *domain,
                                             struct sysdb_attrs *rule)
 {
@@ -901,6 +1014,60 @@ done:
     return ret;
 }
 
+/* Adds an empty value for every attribute the cached rule has and the new
+ * one does not, so that storing the rule replaces the cached one completely
+ * and the rule does not need to be deleted first. */
+static errno_t
+sysdb_sudo_add_stale_attrs(struct sss_domain_info *domain,
+                           const char *name,
+                           struct sysdb_attrs *rule)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { "*", NULL };
+    struct ldb_message_element *el;
+    struct ldb_message_element *rule_el;
+    struct ldb_message **msgs;
+    size_t count;
+    unsigned int i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_search_custom_by_name(tmp_ctx, domain, name, SUDORULE_SUBDIR,
+                                      attrs, &count, &msgs);
+    if (ret == ENOENT) {
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < msgs[0]->num_elements; i++) {
+        el = &msgs[0]->elements[i];
+        if (is_ts_cache_attr(el->name)
+                || strcasecmp(el->name, "distinguishedName") == 0) {
+            continue;
+        }
+
+        ret = sysdb_attrs_get_el_ext(rule, el->name, false, &rule_el);
+        if (ret == ENOENT) {
+            ret = sysdb_attrs_get_el(rule, el->name, &rule_el);
+        }
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 static errno_t
 sysdb_sudo_store_rule(struct sss_domain_info *domain,
                       struct sysdb_attrs *rule,
@@ -908,6 +1075,7 @@ sysdb_sudo_store_rule(struct sss_domain_info *domain,
                       time_t now)
 {
     const char *name;
+    errno_t sret;
     errno_t ret;
 
     name = sysdb_sudo_get_rule_name(rule);
@@ -918,6 +1086,19 @@ sysdb_sudo_store_rule(struct sss_domain_info *domain,
     DEBUG(SSSDBG_TRACE_FUNC, "Adding sudo rule %s\n", name);
 
     ret = sysdb_sudo_add_lowered_users(domain, rule);
+    if (ret == ERR_MALFORMED_ENTRY) {
+        /* The rule is replaced in place, so its previous version would
+         * stay in the cache if it was not deleted here */
+        sret = sysdb_sudo_purge_byname(domain, name);
+        if (sret != EOK) {
+            return sret;
+        }
+        return ret;
+    } else if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sysdb_sudo_add_hash(rule);
     if (ret != EOK) {
         return ret;
     }
@@ -927,6 +1108,13 @@ sysdb_sudo_store_rule(struct sss_domain_info *domain,
         return ret;
     }
 
+    ret = sysdb_sudo_add_stale_attrs(domain, name, rule);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to check cached rule %s [%d]: %s\n",
+              name, ret, sss_strerror(ret));
+        return ret;
+    }
+
     ret = sysdb_store_custom(domain, name, SUDORULE_SUBDIR, rule);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "Unable to store rule %s [%d]: %s\n",
@@ -1078,8 +1266,13 @@ sysdb_set_sudo_rule_attr(struct sss_domain_info *domain,
                          int mod_op)
 {
     errno_t ret;
+    errno_t sret;
     struct ldb_dn *dn;
+    struct sysdb_attrs *stale;
+    struct ldb_message_element *el;
+    bool in_transaction = false;
     TALLOC_CTX *tmp_ctx;
+    int i;
 
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
@@ -1089,9 +1282,59 @@ sysdb_set_sudo_rule_attr(struct sss_domain_info *domain,
     dn = sysdb_sudo_rule_dn(tmp_ctx, domain, name);
     NULL_CHECK(dn, ret, done);
 
+    for (i = 0; i < attrs->num; i++) {
+        if (!is_ts_cache_attr(attrs->a[i].name)) {
+            break;
+        }
+    }
+
+    if (i == attrs->num) {
+        /* Only timestamps, the content hash stays valid */
+        ret = sysdb_set_entry_attr(domain->sysdb, dn, attrs, mod_op);
+        goto done;
+    }
+
+    ret = sysdb_transaction_start(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+        goto done;
+    }
+    in_transaction = true;
+
     ret = sysdb_set_entry_attr(domain->sysdb, dn, attrs, mod_op);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* The hash no longer describes the content of the rule, remove it so
+     * that the rule is read again from the cache */
+    stale = sysdb_new_attrs(tmp_ctx);
+    NULL_CHECK(stale, ret, done);
+
+    ret = sysdb_attrs_get_el(stale, SYSDB_SUDO_CACHE_AT_HASH, &el);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_set_entry_attr(domain->sysdb, dn, stale, SYSDB_MOD_REP);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_transaction_commit(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
 
 done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(domain->sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Could not cancel transaction\n");
+        }
+    }
     talloc_free(tmp_ctx);
     return ret;
 }
@@ -46,6 +46,10 @@
 #define SYSDB_SUDO_CACHE_AT_NOTAFTER   "sudoNotAfter"
 #define SYSDB_SUDO_CACHE_AT_ORDER      "sudoOrder"
 
+/* Hash of the rule attributes, computed when the rule is stored. Unlike the
+ * expiration, it only changes when the content of the rule does. */
+#define SYSDB_SUDO_CACHE_AT_HASH       "sudoContentHash"
+
 /* sysdb ipa attributes */
 #define SYSDB_IPA_SUDORULE_OC                 "ipasudorule"
 #define SYSDB_IPA_SUDORULE_ENABLED            "ipaEnabledFlag"
@@ -96,6 +100,9 @@ errno_t sysdb_sudo_filter_rules_by_time(TALLOC_CTX *mem_ctx,
                                         uint32_t *_num_rules,
                                         struct sysdb_attrs ***_rules);
 
+/* The sudo responder matches rules in its in-memory index instead of
+ * searching the cache. These filters describe the same matching and are
+ * what the index is tested against. */
 char *
 sysdb_sudo_filter_expired(TALLOC_CTX *mem_ctx,
                           const char *username,
@@ -128,6 +135,9 @@ errno_t sysdb_sudo_set_last_full_refresh(struct sss_domain_info *domain,
 errno_t sysdb_sudo_get_last_full_refresh(struct sss_domain_info *domain,
                                          time_t *value);
 
+/* Deletes the cached rules that match delete_filter, except for those in
+ * rules which are replaced in place by a subsequent sysdb_sudo_store(). If
+ * delete_filter is NULL, the rules themselves are deleted. */
 errno_t sysdb_sudo_purge(struct sss_domain_info *domain,
                          const char *delete_filter,
                          struct sysdb_attrs **rules,
@@ -23,6 +23,7 @@
 */
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <inttypes.h>
@@ -89,6 +90,234 @@ static char *idmap_strdup(struct sss_idmap_ctx *ctx, const char *str)
     return new;
 }
 
+/* Domain SIDs always have the form S-1-5-21-x-y-z, the three 32-bit
+ * sub-authorities x, y and z are used as binary key of the domain. */
+#define IDMAP_SID_KEY_AUTHS 3
+
+struct idmap_sid_key {
+    uint32_t auths[IDMAP_SID_KEY_AUTHS];
+};
+
+struct idmap_sid_index_entry {
+    struct idmap_sid_key key;
+    /* Position of the domain in the list of domains */
+    size_t pos;
+    struct idmap_domain_info *dom;
+};
+
+/* Domains sorted by their SID key and by their position in the list of
+ * domains, so domains sharing a SID are visited in the same order as
+ * when walking the list. */
+struct idmap_sid_index {
+    /* false if a domain SID is not in canonical form, the list of domains
+     * must be walked then */
+    bool usable;
+
+    struct idmap_sid_index_entry *entries;
+    size_t count;
+};
+
+static const char *parse_canonical_uint32(const char *p, uint32_t *_val)
+{
+    uint64_t val = 0;
+
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    /* Leading zeros are not canonical */
+    if (*p == '0' && p[1] >= '0' && p[1] <= '9') {
+        return NULL;
+    }
+
+    while (*p >= '0' && *p <= '9') {
+        val = val * 10 + (*p - '0');
+        if (val > UINT32_MAX) {
+            return NULL;
+        }
+        p++;
+    }
+
+    *_val = val;
+    return p;
+}
+
+/* Split a SID string of the form S-1-5-21-x-y-z, followed by -rid if _rid
+ * is not NULL, into the domain key and the RID. Returns false for SIDs in
+ * any other form. */
+static bool sid_str_to_key(const char *sid, struct idmap_sid_key *key,
+                           uint32_t *_rid)
+{
+    const char *p;
+    size_t i;
+
+    if (strncmp(sid, DOM_SID_PREFIX, DOM_SID_PREFIX_LEN) != 0) {
+        return false;
+    }
+    p = sid + DOM_SID_PREFIX_LEN;
+
+    for (i = 0; i < IDMAP_SID_KEY_AUTHS; i++) {
+        if (i > 0) {
+            if (*p != '-') {
+                return false;
+            }
+            p++;
+        }
+
+        p = parse_canonical_uint32(p, &key->auths[i]);
+        if (p == NULL) {
+            return false;
+        }
+    }
+
+    if (_rid != NULL) {
+        if (*p != '-') {
+            return false;
+        }
+
+        p = parse_canonical_uint32(p + 1, _rid);
+        if (p == NULL) {
+            return false;
+        }
+    }
+
+    return *p == '\0';
+}
+
+/* Binary SIDs are stored as revision, number of sub-authorities, 48-bit
+ * big-endian identifier authority and little-endian 32-bit
+ * sub-authorities. Returns false for anything else than a SID of the form
+ * S-1-5-21-x-y-z-rid. */
+static bool bin_sid_to_key(const uint8_t *bin_sid, size_t length,
+                           struct idmap_sid_key *key, uint32_t *_rid)
+{
+    static const uint8_t prefix[] = { 1, 2 + IDMAP_SID_KEY_AUTHS,
+                                      0, 0, 0, 0, 0, 5,
+                                      21, 0, 0, 0 };
+    const uint8_t *p;
+    uint32_t val[IDMAP_SID_KEY_AUTHS + 1];
+    size_t i;
+
+    if (bin_sid == NULL
+            || length != sizeof(prefix) + sizeof(val)
+            || memcmp(bin_sid, prefix, sizeof(prefix)) != 0) {
+        return false;
+    }
+
+    for (i = 0, p = bin_sid + sizeof(prefix);
+         i < IDMAP_SID_KEY_AUTHS + 1;
+         i++, p += 4) {
+        val[i] = (uint32_t) p[0]
+                 | ((uint32_t) p[1] << 8)
+                 | ((uint32_t) p[2] << 16)
+                 | ((uint32_t) p[3] << 24);
+    }
+
+    memcpy(key->auths, val, sizeof(key->auths));
+    *_rid = val[IDMAP_SID_KEY_AUTHS];
+
+    return true;
+}
+
+static int sid_key_cmp(const struct idmap_sid_key *a,
+                       const struct idmap_sid_key *b)
+{
+    size_t i;
+
+    for (i = 0; i < IDMAP_SID_KEY_AUTHS; i++) {
+        if (a->auths[i] != b->auths[i]) {
+            return a->auths[i] < b->auths[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+static int sid_index_entry_cmp(const void *a, const void *b)
+{
+    const struct idmap_sid_index_entry *entry_a = a;
+    const struct idmap_sid_index_entry *entry_b = b;
+    int ret;
+
+    ret = sid_key_cmp(&entry_a->key, &entry_b->key);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (entry_a->pos != entry_b->pos) {
+        return entry_a->pos < entry_b->pos ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static void sid_index_free(struct sss_idmap_ctx *ctx)
+{
+    if (ctx->sid_index == NULL) {
+        return;
+    }
+
+    ctx->free_func(ctx->sid_index->entries, ctx->alloc_pvt);
+    ctx->free_func(ctx->sid_index, ctx->alloc_pvt);
+    ctx->sid_index = NULL;
+}
+
+static enum idmap_error_code sid_index_build(struct sss_idmap_ctx *ctx)
+{
+    struct idmap_sid_index *index;
+    struct idmap_domain_info *dom;
+    size_t num_doms = 0;
+    size_t pos;
+
+    for (dom = ctx->idmap_domain_info; dom != NULL; dom = dom->next) {
+        num_doms++;
+    }
+
+    index = ctx->alloc_func(sizeof(struct idmap_sid_index), ctx->alloc_pvt);
+    if (index == NULL) {
+        return IDMAP_OUT_OF_MEMORY;
+    }
+    memset(index, 0, sizeof(struct idmap_sid_index));
+    index->usable = true;
+
+    if (num_doms > 0) {
+        index->entries = ctx->alloc_func(
+                            num_doms * sizeof(struct idmap_sid_index_entry),
+                            ctx->alloc_pvt);
+        if (index->entries == NULL) {
+            ctx->free_func(index, ctx->alloc_pvt);
+            return IDMAP_OUT_OF_MEMORY;
+        }
+    }
+
+    for (dom = ctx->idmap_domain_info, pos = 0;
+         dom != NULL;
+         dom = dom->next, pos++) {
+        if (dom->sid == NULL) {
+            continue;
+        }
+
+        if (!sid_str_to_key(dom->sid, &index->entries[index->count].key,
+                            NULL)) {
+            index->usable = false;
+            continue;
+        }
+
+        index->entries[index->count].pos = pos;
+        index->entries[index->count].dom = dom;
+        index->count++;
+    }
+
+    if (index->count > 1) {
+        qsort(index->entries, index->count,
+              sizeof(struct idmap_sid_index_entry), sid_index_entry_cmp);
+    }
+
+    ctx->sid_index = index;
+
+    return IDMAP_SUCCESS;
+}
+
 static bool ranges_eq(const struct idmap_range_params *a,
                       const struct idmap_range_params *b)
 {
@@ -319,6 +548,7 @@ enum idmap_error_code sss_idmap_free(struct sss_idmap_ctx *ctx)
         sss_idmap_free_domain(ctx, dom);
     }
 
+    sid_index_free(ctx);
     ctx->free_func(ctx, ctx->alloc_pvt);
 
     return IDMAP_SUCCESS;
@@ -769,6 +999,7 @@ enum idmap_error_code sss_idmap_add_domain_ex(struct sss_idmap_ctx *ctx,
 
     dom->next = ctx->idmap_domain_info;
     ctx->idmap_domain_info = dom;
+    sid_index_free(ctx);
 
     return IDMAP_SUCCESS;
 
@@ -1052,27 +1283,110 @@ done:
     return err;
 }
 
-enum idmap_error_code sss_idmap_sid_to_unix(struct sss_idmap_ctx *ctx,
-                                            const char *sid,
-                                            uint32_t *_id)
+/* Returns the position of the first index entry with the given key or
+ * index->count if there is none. */
+static size_t sid_index_find(struct idmap_sid_index *index,
+                             const struct idmap_sid_key *key)
 {
-    struct idmap_domain_info *idmap_domain_info;
+    size_t lo = 0;
+    size_t hi = index->count;
+    size_t mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (sid_key_cmp(&index->entries[mid].key, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < index->count && sid_key_cmp(&index->entries[lo].key, key) == 0) {
+        return lo;
+    }
+
+    return index->count;
+}
+
+/* Map a RID of the domain with the given key using the index, the result
+ * is the same as when walking the list of domains in
+ * sss_idmap_sid_to_unix(). Returns false if the index cannot be used or if
+ * a new range has to be added for the SID, the caller must walk the list
+ * of domains then. If _first is not NULL it is used as a hint where the
+ * domains with this key start and is updated with the actual position. */
+static bool sid_index_map(struct sss_idmap_ctx *ctx,
+                          const struct idmap_sid_key *key,
+                          uint32_t rid,
+                          size_t *_first,
+                          uint32_t *_id,
+                          enum idmap_error_code *_err)
+{
+    struct idmap_sid_index *index;
     struct idmap_domain_info *matched_dom = NULL;
-    size_t dom_len;
-    long long rid;
+    size_t first;
+    size_t i;
 
-    if (sid == NULL || _id == NULL) {
-        return IDMAP_ERROR;
+    if (ctx->sid_index == NULL) {
+        if (sid_index_build(ctx) != IDMAP_SUCCESS) {
+            return false;
+        }
     }
+    index = ctx->sid_index;
 
-    CHECK_IDMAP_CTX(ctx, IDMAP_CONTEXT_INVALID);
+    if (!index->usable) {
+        return false;
+    }
 
-    idmap_domain_info = ctx->idmap_domain_info;
+    if (_first != NULL && *_first < index->count
+            && sid_key_cmp(&index->entries[*_first].key, key) == 0) {
+        first = *_first;
+    } else {
+        first = sid_index_find(index, key);
+        if (_first != NULL) {
+            *_first = first;
+        }
+    }
 
-    if (sss_idmap_sid_is_builtin(sid)) {
-        return IDMAP_BUILTIN_SID;
+    for (i = first;
+         i < index->count && sid_key_cmp(&index->entries[i].key, key) == 0;
+         i++) {
+        if (index->entries[i].dom->external_mapping == true) {
+            *_err = IDMAP_EXTERNAL;
+            return true;
+        }
+
+        if (comp_id(&index->entries[i].dom->range_params, rid, _id)) {
+            *_err = IDMAP_SUCCESS;
+            return true;
+        }
+
+        matched_dom = index->entries[i].dom;
+    }
+
+    if (matched_dom == NULL) {
+        *_err = IDMAP_NO_DOMAIN;
+        return true;
+    }
+
+    if (matched_dom->auto_add_ranges) {
+        return false;
     }
 
+    *_err = IDMAP_NO_RANGE;
+    return true;
+}
+
+static enum idmap_error_code sid_to_unix_slow(struct sss_idmap_ctx *ctx,
+                                              const char *sid,
+                                              uint32_t *_id)
+{
+    struct idmap_domain_info *idmap_domain_info;
+    struct idmap_domain_info *matched_dom = NULL;
+    size_t dom_len;
+    long long rid;
+
+    idmap_domain_info = ctx->idmap_domain_info;
+
     /* Try primary slices */
     while (idmap_domain_info != NULL) {
 
@@ -1103,6 +1417,71 @@ enum idmap_error_code sss_idmap_sid_to_unix(struct sss_idmap_ctx *ctx,
     return matched_dom ? IDMAP_NO_RANGE : IDMAP_NO_DOMAIN;
 }
 
+enum idmap_error_code sss_idmap_sid_to_unix(struct sss_idmap_ctx *ctx,
+                                            const char *sid,
+                                            uint32_t *_id)
+{
+    struct idmap_sid_key key;
+    uint32_t rid;
+    enum idmap_error_code err;
+
+    if (sid == NULL || _id == NULL) {
+        return IDMAP_ERROR;
+    }
+
+    CHECK_IDMAP_CTX(ctx, IDMAP_CONTEXT_INVALID);
+
+    if (sss_idmap_sid_is_builtin(sid)) {
+        return IDMAP_BUILTIN_SID;
+    }
+
+    if (sid_str_to_key(sid, &key, &rid)
+            && sid_index_map(ctx, &key, rid, NULL, _id, &err)) {
+        return err;
+    }
+
+    return sid_to_unix_slow(ctx, sid, _id);
+}
+
+enum idmap_error_code sss_idmap_sids_to_unix(struct sss_idmap_ctx *ctx,
+                                             const char **sids,
+                                             size_t count,
+                                             uint32_t *ids,
+                                             enum idmap_error_code *errs)
+{
+    enum idmap_error_code ret = IDMAP_SUCCESS;
+    struct idmap_sid_key key;
+    uint32_t rid;
+    size_t first = SIZE_MAX;
+    size_t i;
+
+    if (sids == NULL || ids == NULL || errs == NULL) {
+        return IDMAP_ERROR;
+    }
+
+    CHECK_IDMAP_CTX(ctx, IDMAP_CONTEXT_INVALID);
+
+    for (i = 0; i < count; i++) {
+        if (sids[i] == NULL) {
+            errs[i] = IDMAP_ERROR;
+        } else if (sss_idmap_sid_is_builtin(sids[i])) {
+            errs[i] = IDMAP_BUILTIN_SID;
+        } else if (!sid_str_to_key(sids[i], &key, &rid)
+                || !sid_index_map(ctx, &key, rid, &first,
+                                  &ids[i], &errs[i])) {
+            /* SIDs of the same domain usually come in a row, first is
+             * kept as hint for the next SID */
+            errs[i] = sid_to_unix_slow(ctx, sids[i], &ids[i]);
+        }
+
+        if (errs[i] != IDMAP_SUCCESS && ret == IDMAP_SUCCESS) {
+            ret = errs[i];
+        }
+    }
+
+    return ret;
+}
+
 enum idmap_error_code sss_idmap_check_sid_unix(struct sss_idmap_ctx *ctx,
                                                const char *sid,
                                                uint32_t id)
@@ -1266,10 +1645,17 @@ enum idmap_error_code sss_idmap_bin_sid_to_unix(struct sss_idmap_ctx *ctx,
                                                 uint32_t *id)
 {
     enum idmap_error_code err;
+    struct idmap_sid_key key;
+    uint32_t rid;
     char *sid;
 
     CHECK_IDMAP_CTX(ctx, IDMAP_CONTEXT_INVALID);
 
+    if (id != NULL && bin_sid_to_key(bin_sid, length, &key, &rid)
+            && sid_index_map(ctx, &key, rid, NULL, id, &err)) {
+        return err;
+    }
+
     err = sss_idmap_bin_sid_to_sid(ctx, bin_sid, length, &sid);
     if (err != IDMAP_SUCCESS) {
         goto done;
@@ -437,6 +437,33 @@ enum idmap_error_code sss_idmap_sid_to_unix(struct sss_idmap_ctx *ctx,
                                             const char *sid,
                                             uint32_t *id);
 
+/**
+ * @brief Translate a list of SIDs to unix UIDs or GIDs
+ *
+ * The result for each SID is the same as with sss_idmap_sid_to_unix(), but
+ * the lookups are faster if SIDs of the same domain follow each other.
+ *
+ * @param[in] ctx   Idmap context
+ * @param[in] sids  Array of zero-terminated string representations of the
+ *                  SIDs
+ * @param[in] count Number of elements in sids
+ * @param[out] ids  Array with at least count elements for the returned unix
+ *                  UIDs or GIDs, only valid if the matching element of errs
+ *                  is #IDMAP_SUCCESS
+ * @param[out] errs Array with at least count elements for the result of
+ *                  the translation of each SID
+ *
+ * @return
+ *  - #IDMAP_SUCCESS:       All SIDs were translated
+ *  - #IDMAP_ERROR:         Invalid parameters
+ *  - Otherwise the error code of the first SID which could not be translated
+ */
+enum idmap_error_code sss_idmap_sids_to_unix(struct sss_idmap_ctx *ctx,
+                                             const char **sids,
+                                             size_t count,
+                                             uint32_t *ids,
+                                             enum idmap_error_code *errs);
+
 /**
  * @brief Translate a SID stucture to a unix UID or GID
  *
@@ -54,12 +54,18 @@ struct sss_idmap_opts {
     int extra_slice_init;
 };
 
+struct idmap_sid_index;
+
 struct sss_idmap_ctx {
     idmap_alloc_func *alloc_func;
     void *alloc_pvt;
     idmap_free_func *free_func;
     struct sss_idmap_opts idmap_opts;
     struct idmap_domain_info *idmap_domain_info;
+
+    /* Lookup index of the domain SIDs, built on demand and dropped
+     * whenever a domain is added */
+    struct idmap_sid_index *sid_index;
 };
 
 /* This is a copy of the definition in the samba gen_ndr/security.h header
@@ -356,6 +356,699 @@ static errno_t hbac_evaluate_element(struct hbac_rule_element *rule_el,
     return EOK;
 }
 
+/* Compiled rulesets */
+
+#define HBAC_NO_ID ((uint32_t) -1)
+
+struct hbac_compiled_element {
+    uint32_t category;
+
+    /* Sorted ids into hbac_ruleset.strings */
+    uint32_t *names;
+    size_t num_names;
+    uint32_t *groups;
+    size_t num_groups;
+};
+
+struct hbac_compiled_rule {
+    char *name;
+
+    /* Some of the elements are missing, evaluating this rule is an error */
+    bool unparseable;
+
+    struct hbac_compiled_element users;
+    struct hbac_compiled_element services;
+    struct hbac_compiled_element targethosts;
+    struct hbac_compiled_element srchosts;
+};
+
+struct hbac_service_ref {
+    uint32_t service;
+    uint32_t rule;
+};
+
+struct hbac_ruleset {
+    /* Sorted and unique case folded names of all elements */
+    char **strings;
+    size_t num_strings;
+
+    /* Enabled rules in their original order */
+    struct hbac_compiled_rule *rules;
+    size_t num_rules;
+
+    /* Rules which must be evaluated for any service, in rule order */
+    uint32_t *generic;
+    size_t num_generic;
+
+    /* Rules listing services by name, sorted by service and rule */
+    struct hbac_service_ref *service_refs;
+    size_t num_service_refs;
+};
+
+/* Ids of the names of a request element known to the ruleset */
+struct hbac_request_ids {
+    uint32_t name;
+    uint32_t *groups;
+    size_t num_groups;
+};
+
+static int hbac_strp_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static int hbac_id_cmp(const void *a, const void *b)
+{
+    uint32_t id_a = *(const uint32_t *) a;
+    uint32_t id_b = *(const uint32_t *) b;
+
+    if (id_a < id_b) return -1;
+    if (id_a > id_b) return 1;
+    return 0;
+}
+
+static int hbac_service_ref_cmp(const void *a, const void *b)
+{
+    const struct hbac_service_ref *ref_a = a;
+    const struct hbac_service_ref *ref_b = b;
+
+    if (ref_a->service != ref_b->service) {
+        return ref_a->service < ref_b->service ? -1 : 1;
+    }
+    if (ref_a->rule != ref_b->rule) {
+        return ref_a->rule < ref_b->rule ? -1 : 1;
+    }
+    return 0;
+}
+
+static char *hbac_casefold(const char *name)
+{
+    return (char *) sss_utf8_casefold((const uint8_t *) name,
+                                      strlen(name), NULL);
+}
+
+static size_t hbac_string_list_len(const char **list)
+{
+    size_t n = 0;
+
+    if (list != NULL) {
+        for (n = 0; list[n] != NULL; n++);
+    }
+    return n;
+}
+
+static size_t hbac_rule_element_len(struct hbac_rule_element *el)
+{
+    if (el == NULL) return 0;
+
+    return hbac_string_list_len(el->names)
+           + hbac_string_list_len(el->groups);
+}
+
+static errno_t hbac_collect_strings(const char **list,
+                                    char **strings, size_t *_count)
+{
+    size_t i;
+
+    if (list == NULL) return EOK;
+
+    for (i = 0; list[i] != NULL; i++) {
+        strings[*_count] = hbac_casefold(list[i]);
+        if (strings[*_count] == NULL) {
+            return errno == ENOMEM ? ENOMEM : EINVAL;
+        }
+        (*_count)++;
+    }
+
+    return EOK;
+}
+
+static errno_t hbac_collect_element(struct hbac_rule_element *el,
+                                    char **strings, size_t *_count)
+{
+    errno_t ret;
+
+    if (el == NULL) return EOK;
+
+    ret = hbac_collect_strings(el->names, strings, _count);
+    if (ret != EOK) return ret;
+
+    return hbac_collect_strings(el->groups, strings, _count);
+}
+
+static uint32_t hbac_ruleset_lookup(struct hbac_ruleset *ruleset,
+                                    const char *folded)
+{
+    char **found;
+
+    found = bsearch(&folded, ruleset->strings, ruleset->num_strings,
+                    sizeof(char *), hbac_strp_cmp);
+    if (found == NULL) {
+        return HBAC_NO_ID;
+    }
+
+    return (uint32_t) (found - ruleset->strings);
+}
+
+static errno_t hbac_compile_list(struct hbac_ruleset *ruleset,
+                                 const char **list,
+                                 uint32_t **_ids, size_t *_num_ids)
+{
+    uint32_t *ids;
+    size_t num;
+    size_t i;
+    char *folded;
+
+    *_ids = NULL;
+    *_num_ids = 0;
+
+    num = hbac_string_list_len(list);
+    if (num == 0) return EOK;
+
+    ids = malloc(num * sizeof(uint32_t));
+    if (ids == NULL) return ENOMEM;
+
+    for (i = 0; i < num; i++) {
+        folded = hbac_casefold(list[i]);
+        if (folded == NULL) {
+            free(ids);
+            return errno == ENOMEM ? ENOMEM : EINVAL;
+        }
+        /* Every name was interned before, the lookup cannot fail */
+        ids[i] = hbac_ruleset_lookup(ruleset, folded);
+        sss_utf8_free(folded);
+    }
+
+    qsort(ids, num, sizeof(uint32_t), hbac_id_cmp);
+
+    *_ids = ids;
+    *_num_ids = num;
+    return EOK;
+}
+
+static errno_t hbac_compile_element(struct hbac_ruleset *ruleset,
+                                    struct hbac_rule_element *el,
+                                    struct hbac_compiled_element *cel)
+{
+    errno_t ret;
+
+    cel->category = el->category;
+
+    ret = hbac_compile_list(ruleset, el->names,
+                            &cel->names, &cel->num_names);
+    if (ret != EOK) return ret;
+
+    return hbac_compile_list(ruleset, el->groups,
+                             &cel->groups, &cel->num_groups);
+}
+
+static errno_t hbac_compile_rule(struct hbac_ruleset *ruleset,
+                                 struct hbac_rule *rule,
+                                 struct hbac_compiled_rule *crule)
+{
+    errno_t ret;
+
+    if (rule->name != NULL) {
+        crule->name = strdup(rule->name);
+        if (crule->name == NULL) return ENOMEM;
+    }
+
+    if (!rule->users
+     || !rule->services
+     || !rule->targethosts
+     || !rule->srchosts) {
+        crule->unparseable = true;
+        return EOK;
+    }
+
+    ret = hbac_compile_element(ruleset, rule->users, &crule->users);
+    if (ret != EOK) return ret;
+
+    ret = hbac_compile_element(ruleset, rule->services, &crule->services);
+    if (ret != EOK) return ret;
+
+    ret = hbac_compile_element(ruleset, rule->targethosts,
+                               &crule->targethosts);
+    if (ret != EOK) return ret;
+
+    return hbac_compile_element(ruleset, rule->srchosts, &crule->srchosts);
+}
+
+static errno_t hbac_ruleset_intern(struct hbac_ruleset *ruleset,
+                                   struct hbac_rule **rules)
+{
+    size_t total = 0;
+    size_t count = 0;
+    size_t i, j;
+    errno_t ret;
+
+    for (i = 0; rules[i]; i++) {
+        if (!rules[i]->enabled) continue;
+
+        total += hbac_rule_element_len(rules[i]->users)
+                 + hbac_rule_element_len(rules[i]->services)
+                 + hbac_rule_element_len(rules[i]->targethosts)
+                 + hbac_rule_element_len(rules[i]->srchosts);
+    }
+
+    if (total == 0) return EOK;
+
+    ruleset->strings = malloc(total * sizeof(char *));
+    if (ruleset->strings == NULL) return ENOMEM;
+
+    for (i = 0; rules[i]; i++) {
+        if (!rules[i]->enabled) continue;
+
+        ret = hbac_collect_element(rules[i]->users, ruleset->strings, &count);
+        if (ret == EOK) {
+            ret = hbac_collect_element(rules[i]->services,
+                                       ruleset->strings, &count);
+        }
+        if (ret == EOK) {
+            ret = hbac_collect_element(rules[i]->targethosts,
+                                       ruleset->strings, &count);
+        }
+        if (ret == EOK) {
+            ret = hbac_collect_element(rules[i]->srchosts,
+                                       ruleset->strings, &count);
+        }
+        if (ret != EOK) {
+            ruleset->num_strings = count;
+            return ret;
+        }
+    }
+
+    qsort(ruleset->strings, count, sizeof(char *), hbac_strp_cmp);
+
+    /* Drop duplicates */
+    for (i = 0, j = 0; i < count; i++) {
+        if (j > 0 && strcmp(ruleset->strings[j - 1],
+                            ruleset->strings[i]) == 0) {
+            sss_utf8_free(ruleset->strings[i]);
+            continue;
+        }
+        ruleset->strings[j++] = ruleset->strings[i];
+    }
+    ruleset->num_strings = j;
+
+    return EOK;
+}
+
+static errno_t hbac_ruleset_index(struct hbac_ruleset *ruleset)
+{
+    struct hbac_compiled_rule *crule;
+    size_t num_refs = 0;
+    size_t i, j;
+
+    ruleset->generic = malloc((ruleset->num_rules + 1) * sizeof(uint32_t));
+    if (ruleset->generic == NULL) return ENOMEM;
+
+    for (i = 0; i < ruleset->num_rules; i++) {
+        crule = &ruleset->rules[i];
+        if (crule->unparseable
+                || (crule->services.category & HBAC_CATEGORY_ALL)
+                || crule->services.num_groups > 0) {
+            ruleset->generic[ruleset->num_generic++] = i;
+        } else {
+            num_refs += crule->services.num_names;
+        }
+    }
+
+    if (num_refs == 0) return EOK;
+
+    ruleset->service_refs = malloc(num_refs * sizeof(struct hbac_service_ref));
+    if (ruleset->service_refs == NULL) return ENOMEM;
+
+    for (i = 0; i < ruleset->num_rules; i++) {
+        crule = &ruleset->rules[i];
+        if (crule->unparseable
+                || (crule->services.category & HBAC_CATEGORY_ALL)
+                || crule->services.num_groups > 0) {
+            continue;
+        }
+
+        for (j = 0; j < crule->services.num_names; j++) {
+            ruleset->service_refs[ruleset->num_service_refs].service =
+                                                crule->services.names[j];
+            ruleset->service_refs[ruleset->num_service_refs].rule = i;
+            ruleset->num_service_refs++;
+        }
+    }
+
+    qsort(ruleset->service_refs, ruleset->num_service_refs,
+          sizeof(struct hbac_service_ref), hbac_service_ref_cmp);
+
+    return EOK;
+}
+
+enum hbac_error_code hbac_ruleset_compile(struct hbac_rule **rules,
+                                          struct hbac_ruleset **_ruleset)
+{
+    struct hbac_ruleset *ruleset;
+    size_t num_enabled = 0;
+    size_t i;
+    errno_t ret;
+
+    HBAC_DEBUG(HBAC_DBG_INFO, "[< hbac_ruleset_compile()\n");
+
+    ruleset = calloc(1, sizeof(struct hbac_ruleset));
+    if (ruleset == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; rules[i]; i++) {
+        if (rules[i]->enabled) num_enabled++;
+    }
+
+    ret = hbac_ruleset_intern(ruleset, rules);
+    if (ret != EOK) goto done;
+
+    if (num_enabled > 0) {
+        ruleset->rules = calloc(num_enabled,
+                                sizeof(struct hbac_compiled_rule));
+        if (ruleset->rules == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    for (i = 0; rules[i]; i++) {
+        if (!rules[i]->enabled) {
+            HBAC_DEBUG(HBAC_DBG_TRACE, "Rule [%s] is not enabled\n",
+                       rules[i]->name);
+            continue;
+        }
+
+        ret = hbac_compile_rule(ruleset, rules[i],
+                                &ruleset->rules[ruleset->num_rules]);
+        ruleset->num_rules++;
+        if (ret != EOK) goto done;
+    }
+
+    ret = hbac_ruleset_index(ruleset);
+    if (ret != EOK) goto done;
+
+    HBAC_DEBUG(HBAC_DBG_INFO,
+               "Compiled %lu rules with %lu distinct names, "
+               "%lu rules apply to any service\n",
+               (unsigned long) ruleset->num_rules,
+               (unsigned long) ruleset->num_strings,
+               (unsigned long) ruleset->num_generic);
+
+    *_ruleset = ruleset;
+    ret = EOK;
+
+done:
+    HBAC_DEBUG(HBAC_DBG_INFO, "hbac_ruleset_compile() >]\n");
+    if (ret != EOK) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Cannot compile rules [%d]\n", ret);
+        hbac_ruleset_free(ruleset);
+        return ret == ENOMEM ? HBAC_ERROR_OUT_OF_MEMORY : HBAC_ERROR_UNKNOWN;
+    }
+    return HBAC_SUCCESS;
+}
+
+static void hbac_compiled_element_free(struct hbac_compiled_element *cel)
+{
+    free(cel->names);
+    free(cel->groups);
+}
+
+void hbac_ruleset_free(struct hbac_ruleset *ruleset)
+{
+    size_t i;
+
+    if (ruleset == NULL) return;
+
+    for (i = 0; i < ruleset->num_strings; i++) {
+        sss_utf8_free(ruleset->strings[i]);
+    }
+    free(ruleset->strings);
+
+    for (i = 0; i < ruleset->num_rules; i++) {
+        free(ruleset->rules[i].name);
+        hbac_compiled_element_free(&ruleset->rules[i].users);
+        hbac_compiled_element_free(&ruleset->rules[i].services);
+        hbac_compiled_element_free(&ruleset->rules[i].targethosts);
+        hbac_compiled_element_free(&ruleset->rules[i].srchosts);
+    }
+    free(ruleset->rules);
+
+    free(ruleset->generic);
+    free(ruleset->service_refs);
+    free(ruleset);
+}
+
+static uint32_t hbac_request_name_id(struct hbac_ruleset *ruleset,
+                                     const char *name, errno_t *_ret)
+{
+    char *folded;
+    uint32_t id;
+
+    folded = hbac_casefold(name);
+    if (folded == NULL) {
+        *_ret = errno == ENOMEM ? ENOMEM : EINVAL;
+        return HBAC_NO_ID;
+    }
+
+    id = hbac_ruleset_lookup(ruleset, folded);
+    sss_utf8_free(folded);
+
+    *_ret = EOK;
+    return id;
+}
+
+static errno_t hbac_request_to_ids(struct hbac_ruleset *ruleset,
+                                   struct hbac_request_element *el,
+                                   struct hbac_request_ids *ids)
+{
+    size_t num;
+    size_t i;
+    uint32_t id;
+    errno_t ret;
+
+    ids->name = HBAC_NO_ID;
+    ids->groups = NULL;
+    ids->num_groups = 0;
+
+    if (el == NULL) return EOK;
+
+    if (el->name != NULL) {
+        ids->name = hbac_request_name_id(ruleset, el->name, &ret);
+        if (ret != EOK) return ret;
+    }
+
+    num = hbac_string_list_len(el->groups);
+    if (num == 0) return EOK;
+
+    ids->groups = malloc(num * sizeof(uint32_t));
+    if (ids->groups == NULL) return ENOMEM;
+
+    /* Groups no rule refers to can never match, skip them */
+    for (i = 0; i < num; i++) {
+        id = hbac_request_name_id(ruleset, el->groups[i], &ret);
+        if (ret != EOK) return ret;
+
+        if (id != HBAC_NO_ID) {
+            ids->groups[ids->num_groups++] = id;
+        }
+    }
+
+    return EOK;
+}
+
+static bool hbac_id_in_set(uint32_t id, uint32_t *set, size_t num)
+{
+    if (id == HBAC_NO_ID || num == 0) return false;
+
+    return bsearch(&id, set, num, sizeof(uint32_t), hbac_id_cmp) != NULL;
+}
+
+static bool hbac_compiled_element_match(struct hbac_compiled_element *cel,
+                                        struct hbac_request_ids *ids)
+{
+    size_t i;
+
+    if (cel->category & HBAC_CATEGORY_ALL) {
+        return true;
+    }
+
+    if (hbac_id_in_set(ids->name, cel->names, cel->num_names)) {
+        return true;
+    }
+
+    for (i = 0; i < ids->num_groups; i++) {
+        if (hbac_id_in_set(ids->groups[i], cel->groups, cel->num_groups)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static enum hbac_eval_result_int
+hbac_evaluate_compiled_rule(struct hbac_compiled_rule *crule,
+                            struct hbac_request_ids *user,
+                            struct hbac_request_ids *service,
+                            struct hbac_request_ids *targethost,
+                            struct hbac_request_ids *srchost)
+{
+    if (crule->unparseable) {
+        HBAC_DEBUG(HBAC_DBG_INFO,
+                   "Rule [%s] cannot be parsed, some elements are empty\n",
+                   crule->name);
+        return HBAC_EVAL_MATCH_ERROR;
+    }
+
+    if (!hbac_compiled_element_match(&crule->users, user)
+            || !hbac_compiled_element_match(&crule->services, service)
+            || !hbac_compiled_element_match(&crule->targethosts, targethost)
+            || !hbac_compiled_element_match(&crule->srchosts, srchost)) {
+        return HBAC_EVAL_UNMATCHED;
+    }
+
+    return HBAC_EVAL_MATCHED;
+}
+
+enum hbac_eval_result hbac_ruleset_evaluate(struct hbac_ruleset *ruleset,
+                                            struct hbac_eval_req *hbac_req,
+                                            struct hbac_info **info)
+{
+    struct hbac_request_ids user;
+    struct hbac_request_ids service;
+    struct hbac_request_ids targethost;
+    struct hbac_request_ids srchost;
+    struct hbac_compiled_rule *crule = NULL;
+    enum hbac_eval_result result = HBAC_EVAL_DENY;
+    enum hbac_eval_result_int intermediate_result;
+    size_t gen_pos = 0;
+    size_t ref_pos;
+    size_t ref_end;
+    size_t lo, hi, mid;
+    uint32_t idx;
+    errno_t ret;
+
+    HBAC_DEBUG(HBAC_DBG_INFO, "[< hbac_ruleset_evaluate()\n");
+    hbac_req_debug_print(hbac_req);
+
+    memset(&user, 0, sizeof(user));
+    memset(&service, 0, sizeof(service));
+    memset(&targethost, 0, sizeof(targethost));
+    memset(&srchost, 0, sizeof(srchost));
+
+    if (info) {
+        *info = malloc(sizeof(struct hbac_info));
+        if (!*info) {
+            HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+            return HBAC_EVAL_OOM;
+        }
+        (*info)->code = HBAC_ERROR_UNKNOWN;
+        (*info)->rule_name = NULL;
+    }
+
+    ret = hbac_request_to_ids(ruleset, hbac_req->user, &user);
+    if (ret == EOK) {
+        ret = hbac_request_to_ids(ruleset, hbac_req->service, &service);
+    }
+    if (ret == EOK) {
+        ret = hbac_request_to_ids(ruleset, hbac_req->targethost, &targethost);
+    }
+    if (ret == EOK) {
+        ret = hbac_request_to_ids(ruleset, hbac_req->srchost, &srchost);
+    }
+    if (ret != EOK) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Cannot process request [%d].\n", ret);
+        result = HBAC_EVAL_ERROR;
+        if (info) {
+            (*info)->code = ret == ENOMEM ? HBAC_ERROR_OUT_OF_MEMORY
+                                          : HBAC_ERROR_UNKNOWN;
+        }
+        goto done;
+    }
+
+    /* Find the rules that list the requested service by name */
+    lo = 0;
+    hi = ruleset->num_service_refs;
+    if (service.name != HBAC_NO_ID) {
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (ruleset->service_refs[mid].service < service.name) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+    } else {
+        lo = hi;
+    }
+    ref_pos = lo;
+    for (ref_end = ref_pos; ref_end < ruleset->num_service_refs
+            && ruleset->service_refs[ref_end].service == service.name;
+            ref_end++);
+
+    /* Merge them with the generic rules so the rules are still
+     * evaluated in their original order */
+    while (gen_pos < ruleset->num_generic || ref_pos < ref_end) {
+        if (ref_pos == ref_end
+                || (gen_pos < ruleset->num_generic
+                    && ruleset->generic[gen_pos]
+                            < ruleset->service_refs[ref_pos].rule)) {
+            idx = ruleset->generic[gen_pos++];
+        } else {
+            idx = ruleset->service_refs[ref_pos++].rule;
+        }
+        crule = &ruleset->rules[idx];
+
+        intermediate_result = hbac_evaluate_compiled_rule(crule, &user,
+                                                          &service,
+                                                          &targethost,
+                                                          &srchost);
+        if (intermediate_result == HBAC_EVAL_UNMATCHED) {
+            HBAC_DEBUG(HBAC_DBG_TRACE, "The rule [%s] did not match.\n",
+                       crule->name);
+            continue;
+        } else if (intermediate_result == HBAC_EVAL_MATCHED) {
+            HBAC_DEBUG(HBAC_DBG_INFO, "ALLOWED by rule [%s].\n", crule->name);
+            result = HBAC_EVAL_ALLOW;
+            if (info) {
+                (*info)->code = HBAC_SUCCESS;
+                if (crule->name != NULL) {
+                    (*info)->rule_name = strdup(crule->name);
+                    if (!(*info)->rule_name) {
+                        HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+                        result = HBAC_EVAL_ERROR;
+                        (*info)->code = HBAC_ERROR_OUT_OF_MEMORY;
+                    }
+                }
+            }
+            break;
+        } else {
+            HBAC_DEBUG(HBAC_DBG_ERROR,
+                       "Error occurred during evaluating of rule [%s].\n",
+                       crule->name);
+            result = HBAC_EVAL_ERROR;
+            if (info) {
+                (*info)->code = HBAC_ERROR_UNPARSEABLE_RULE;
+                if (crule->name != NULL) {
+                    /* Explicitly not checking the result of strdup() */
+                    (*info)->rule_name = strdup(crule->name);
+                }
+            }
+            break;
+        }
+    }
+
+done:
+    free(user.groups);
+    free(service.groups);
+    free(targethost.groups);
+    free(srchost.groups);
+
+    HBAC_DEBUG(HBAC_DBG_INFO, "hbac_ruleset_evaluate() >]\n");
+    return result;
+}
+
 const char *hbac_result_string(enum hbac_eval_result result)
 {
     switch (result) {
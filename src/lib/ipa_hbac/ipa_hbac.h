@@ -338,6 +338,56 @@ void hbac_free_info(struct hbac_info *info);
  */
 bool hbac_rule_is_complete(struct hbac_rule *rule, uint32_t *missing_attrs);
 
+/**
+ * Opaque type contained in hbac_evaluator.c
+ */
+struct hbac_ruleset;
+
+/**
+ * @brief Compile a set of HBAC rules for repeated evaluation
+ *
+ * All names are case folded and interned once, each rule element is
+ * turned into a sorted set and rules are indexed by the PAM service they
+ * apply to, so evaluating a request only visits rules that can match its
+ * service. The compiled ruleset does not reference the input rules, they
+ * can be freed once this function returns.
+ *
+ * @param[in] rules     A NULL-terminated list of rules to compile
+ * @param[out] ruleset  The compiled ruleset, free with #hbac_ruleset_free
+ * @return
+ *  - #HBAC_SUCCESS:              The rules were compiled
+ *  - #HBAC_ERROR_OUT_OF_MEMORY:  Insufficient memory
+ *  - #HBAC_ERROR_UNKNOWN:        A name could not be processed
+ */
+enum hbac_error_code hbac_ruleset_compile(struct hbac_rule **rules,
+                                          struct hbac_ruleset **ruleset);
+
+/**
+ * @brief Evaluate an authorization request against a compiled ruleset
+ *
+ * The result is the same as the one of #hbac_evaluate called with the
+ * rules the ruleset was compiled from.
+ *
+ * @param[in] ruleset  A ruleset created by #hbac_ruleset_compile
+ * @param[in] hbac_req A user authorization request
+ * @param[out] info    Extended information (including the name of the
+ *                     rule that allowed access (or caused a parse error)
+ * @return
+ *  - #HBAC_EVAL_ERROR: An error occurred
+ *  - #HBAC_EVAL_ALLOW: Access is granted
+ *  - #HBAC_EVAL_DENY:  Access is denied
+ *  - #HBAC_EVAL_OOM:   Insufficient memory to complete the evaluation
+ */
+enum hbac_eval_result hbac_ruleset_evaluate(struct hbac_ruleset *ruleset,
+                                            struct hbac_eval_req *hbac_req,
+                                            struct hbac_info **info);
+
+/**
+ * @brief Function to safely free #hbac_ruleset
+ * @param ruleset #hbac_ruleset returned by #hbac_ruleset_compile
+ */
+void hbac_ruleset_free(struct hbac_ruleset *ruleset);
+
 /**
  * @}
  */
@@ -0,0 +1,55 @@
+/*
+    SSSD
+
+    Helper child to commmunicate with SmartCard - protocol definitions
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __P11_CHILD_H__
+#define __P11_CHILD_H__
+
+/*
+ * When started with --persistent the p11_child keeps the NSS database and
+ * the PKCS#11 modules loaded and serves requests until stdin is closed or
+ * no request arrived for P11_CHILD_IDLE_TIMEOUT seconds.
+ *
+ * Request:
+ *   uint32_t length of the rest of the request
+ *   uint32_t operation, P11_CHILD_OP_*
+ *   uint32_t PIN mode, P11_CHILD_PIN_*
+ *   the PIN without trailing '\0' if the mode is P11_CHILD_PIN_VALUE
+ *
+ * Response:
+ *   uint32_t length of the rest of the response
+ *   uint32_t result, an errno value
+ *   the output of the one-shot mode: token name, module name, key id and
+ *   certificate, each terminated by a new-line, or nothing if no
+ *   certificate was found
+ */
+
+#define P11_CHILD_OP_PREAUTH 1
+#define P11_CHILD_OP_AUTH 2
+
+#define P11_CHILD_PIN_NONE 0
+#define P11_CHILD_PIN_VALUE 1
+#define P11_CHILD_PIN_KEYPAD 2
+
+#define P11_CHILD_IDLE_TIMEOUT 300
+#define P11_CHILD_MAX_REQUEST_SIZE 4096
+#define P11_CHILD_MAX_RESPONSE_SIZE (1024 * 1024)
+
+#endif /* __P11_CHILD_H__ */
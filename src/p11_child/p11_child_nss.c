@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include <popt.h>
 
 #include "util/util.h"
@@ -37,6 +38,7 @@
 #include <cert.h>
 #include <keyhi.h>
 #include <pk11pub.h>
+#include <hasht.h>
 #include <prerror.h>
 #include <ocsp.h>
 
@@ -44,6 +46,7 @@
 #include "providers/backend.h"
 #include "util/crypto/sss_crypto.h"
 #include "util/cert.h"
+#include "p11_child/p11_child.h"
 
 enum op_mode {
     OP_NONE,
@@ -68,21 +71,71 @@ static char *password_passthrough(PK11SlotInfo *slot, PRBool retry, void *arg)
 }
 
 
+/* With the cache_verification option a persistent child reuses positive
+ * certificate validation results for P11_VERIFY_CACHE_TIMEOUT seconds,
+ * e.g. between pre-auth and auth. */
+#define P11_VERIFY_CACHE_TIMEOUT 60
+#define P11_VERIFY_CACHE_MAX 16
 
-int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
-            enum op_mode mode, const char *pin,
-            struct cert_verify_opts *cert_verify_opts,
-            char **cert, char **token_name_out, char **module_name_out,
-            char **key_id_out)
+struct p11c_verified_cert {
+    unsigned char fingerprint[SHA256_LENGTH];
+    time_t valid_until;
+};
+
+static struct p11c_verified_cert verified_certs[P11_VERIFY_CACHE_MAX];
+
+static SECStatus p11c_verify_cert(CERTCertDBHandle *handle,
+                                  CERTCertificate *cert,
+                                  bool use_cache)
 {
-    int ret;
+    unsigned char fingerprint[SHA256_LENGTH];
+    struct p11c_verified_cert *oldest = &verified_certs[0];
+    time_t now = time(NULL);
     SECStatus rv;
+    size_t c;
+
+    if (!use_cache) {
+        return CERT_VerifyCertificateNow(handle, cert, PR_TRUE,
+                                         certificateUsageSSLClient,
+                                         NULL, NULL);
+    }
+
+    rv = PK11_HashBuf(SEC_OID_SHA256, fingerprint, cert->derCert.data,
+                      cert->derCert.len);
+    if (rv != SECSuccess) {
+        return CERT_VerifyCertificateNow(handle, cert, PR_TRUE,
+                                         certificateUsageSSLClient,
+                                         NULL, NULL);
+    }
+
+    for (c = 0; c < P11_VERIFY_CACHE_MAX; c++) {
+        if (verified_certs[c].valid_until >= now
+                && memcmp(verified_certs[c].fingerprint, fingerprint,
+                          SHA256_LENGTH) == 0) {
+            DEBUG(SSSDBG_TRACE_ALL, "Certificate was validated recently.\n");
+            return SECSuccess;
+        }
+
+        if (verified_certs[c].valid_until < oldest->valid_until) {
+            oldest = &verified_certs[c];
+        }
+    }
+
+    rv = CERT_VerifyCertificateNow(handle, cert, PR_TRUE,
+                                   certificateUsageSSLClient, NULL, NULL);
+    if (rv == SECSuccess) {
+        memcpy(oldest->fingerprint, fingerprint, SHA256_LENGTH);
+        oldest->valid_until = now + P11_VERIFY_CACHE_TIMEOUT;
+    }
+
+    return rv;
+}
+
+static errno_t p11c_init_nss(const char *nss_db, NSSInitContext **_nss_ctx)
+{
     NSSInitContext *nss_ctx;
     SECMODModuleList *mod_list;
     SECMODModuleList *mod_list_item;
-    SECMODModule *module;
-    const char *slot_name;
-    const char *token_name;
     uint32_t flags = NSS_INIT_READONLY
                                    | NSS_INIT_FORCEOPEN
                                    | NSS_INIT_NOROOTINIT
@@ -90,27 +143,6 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
                                    | NSS_INIT_PK11RELOAD;
     NSSInitParameters parameters = { 0 };
     parameters.length =  sizeof (parameters);
-    PK11SlotInfo *slot = NULL;
-    CK_SLOT_ID slot_id;
-    SECMODModuleID module_id;
-    const char *module_name;
-    CERTCertList *cert_list = NULL;
-    CERTCertListNode *cert_list_node;
-    const PK11DefaultArrayEntry friendly_attr = { "Publicly-readable certs",
-                                                  SECMOD_FRIENDLY_FLAG,
-                                                  CKM_INVALID_MECHANISM };
-    CERTCertDBHandle *handle;
-    unsigned char random_value[128];
-    SECKEYPrivateKey *priv_key;
-    SECOidTag algtag;
-    SECItem signed_random_value = {0};
-    SECKEYPublicKey *pub_key;
-    CERTCertificate *found_cert = NULL;
-    PK11SlotList *list = NULL;
-    PK11SlotListElement *le;
-    SECItem *key_id = NULL;
-    char *key_id_str = NULL;
-
 
     nss_ctx = NSS_InitContext(nss_db, "", "", SECMOD_DB, &parameters, flags);
     if (nss_ctx == NULL) {
@@ -151,12 +183,51 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
                                 mod_list_item->module->dllName);
     }
 
+    *_nss_ctx = nss_ctx;
+    return EOK;
+}
+
+/* Handles a single request with an initialized NSS context */
+static int do_request(TALLOC_CTX *mem_ctx, const char *slot_name_in,
+                      enum op_mode mode, const char *pin,
+                      struct cert_verify_opts *cert_verify_opts,
+                      char **cert, char **token_name_out,
+                      char **module_name_out, char **key_id_out)
+{
+    int ret;
+    SECStatus rv;
+    SECMODModule *module;
+    const char *slot_name;
+    const char *token_name;
+    PK11SlotInfo *slot = NULL;
+    CK_SLOT_ID slot_id;
+    SECMODModuleID module_id;
+    const char *module_name;
+    CERTCertList *cert_list = NULL;
+    CERTCertListNode *cert_list_node;
+    const PK11DefaultArrayEntry friendly_attr = { "Publicly-readable certs",
+                                                  SECMOD_FRIENDLY_FLAG,
+                                                  CKM_INVALID_MECHANISM };
+    CERTCertDBHandle *handle;
+    unsigned char random_value[128];
+    SECKEYPrivateKey *priv_key;
+    SECOidTag algtag;
+    SECItem signed_random_value = {0};
+    SECKEYPublicKey *pub_key;
+    CERTCertificate *found_cert = NULL;
+    PK11SlotList *list = NULL;
+    PK11SlotListElement *le;
+    SECItem *key_id = NULL;
+    char *key_id_str = NULL;
+    bool logged_in = false;
+
     if (slot_name_in != NULL) {
         slot = PK11_FindSlotByName(slot_name_in);
         if (slot == NULL) {
             DEBUG(SSSDBG_OP_FAILURE, "PK11_FindSlotByName failed for [%s]: [%d].\n",
                                      slot_name_in, PR_GetError());
-            return EIO;
+            ret = EIO;
+            goto done;
         }
     } else {
 
@@ -164,7 +235,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
                                  NULL);
         if (list == NULL) {
             DEBUG(SSSDBG_OP_FAILURE, "PK11_GetAllTokens failed.\n");
-            return EIO;
+            ret = EIO;
+            goto done;
         }
 
         for (le = list->head; le; le = le->next) {
@@ -183,7 +255,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
         PK11_FreeSlotList(list);
         if (slot == NULL) {
             DEBUG(SSSDBG_OP_FAILURE, "No removable slots found.\n");
-            return EIO;
+            ret = EIO;
+            goto done;
         }
     }
 
@@ -221,8 +294,10 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
             if (rv !=  SECSuccess) {
                 DEBUG(SSSDBG_OP_FAILURE, "PK11_Authenticate failed: [%d].\n",
                                          PR_GetError());
-                return EIO;
+                ret = EIO;
+                goto done;
             }
+            logged_in = true;
         } else {
             DEBUG(SSSDBG_CRIT_FAILURE,
                   "Login required but no pin available, continue.\n");
@@ -235,7 +310,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
     if (cert_list == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "PK11_ListCertsInSlot failed: [%d].\n",
                                  PR_GetError());
-        return EIO;
+        ret = EIO;
+        goto done;
     }
 
     for (cert_list_node = CERT_LIST_HEAD(cert_list);
@@ -254,14 +330,16 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
     if (rv != SECSuccess) {
         DEBUG(SSSDBG_OP_FAILURE, "CERT_FilterCertListByUsage failed: [%d].\n",
                                  PR_GetError());
-        return EIO;
+        ret = EIO;
+        goto done;
     }
 
     rv = CERT_FilterCertListForUserCerts(cert_list);
     if (rv != SECSuccess) {
         DEBUG(SSSDBG_OP_FAILURE, "CERT_FilterCertListForUserCerts failed: [%d].\n",
                                  PR_GetError());
-        return EIO;
+        ret = EIO;
+        goto done;
     }
 
 
@@ -269,7 +347,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
     if (handle == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "CERT_GetDefaultCertDB failed: [%d].\n",
                                  PR_GetError());
-        return EIO;
+        ret = EIO;
+        goto done;
     }
 
     if (cert_verify_opts->do_ocsp) {
@@ -277,7 +356,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
         if (rv != SECSuccess) {
             DEBUG(SSSDBG_OP_FAILURE, "CERT_EnableOCSPChecking failed: [%d].\n",
                                      PR_GetError());
-            return EIO;
+            ret = EIO;
+            goto done;
         }
 
         if (cert_verify_opts->ocsp_default_responder != NULL
@@ -289,7 +369,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
                 DEBUG(SSSDBG_OP_FAILURE,
                       "CERT_SetOCSPDefaultResponder failed: [%d].\n",
                       PR_GetError());
-                return EIO;
+                ret = EIO;
+                goto done;
             }
 
             rv = CERT_EnableOCSPDefaultResponder(handle);
@@ -297,7 +378,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
                 DEBUG(SSSDBG_OP_FAILURE,
                       "CERT_EnableOCSPDefaultResponder failed: [%d].\n",
                       PR_GetError());
-                return EIO;
+                ret = EIO;
+                goto done;
             }
         }
     }
@@ -313,10 +395,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
                              cert_list_node->cert->subjectName);
 
             if (cert_verify_opts->do_verification) {
-                rv = CERT_VerifyCertificateNow(handle, cert_list_node->cert,
-                                               PR_TRUE,
-                                               certificateUsageSSLClient,
-                                               NULL, NULL);
+                rv = p11c_verify_cert(handle, cert_list_node->cert,
+                                      cert_verify_opts->cache_verification);
                 if (rv != SECSuccess) {
                     DEBUG(SSSDBG_OP_FAILURE,
                           "Certificate [%s][%s] not valid [%d], skipping.\n",
@@ -364,7 +444,8 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
         if (rv != SECSuccess) {
             DEBUG(SSSDBG_OP_FAILURE,
                   "PK11_GenerateRandom failed [%d].\n", PR_GetError());
-            return EIO;
+            ret = EIO;
+            goto done;
         }
 
         priv_key = PK11_FindPrivateKeyFromCert(slot, found_cert, NULL);
@@ -470,19 +551,49 @@ int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
     ret = EOK;
 
 done:
-    if (slot != NULL) {
-        PK11_FreeSlot(slot);
-    }
-
     if (cert_list != NULL) {
         CERT_DestroyCertList(cert_list);
     }
 
+    if (slot != NULL) {
+        /* A persistent child must not keep the token unlocked for the
+         * next request. */
+        if (logged_in) {
+            rv = PK11_Logout(slot);
+            if (rv != SECSuccess) {
+                DEBUG(SSSDBG_OP_FAILURE, "PK11_Logout failed [%d].\n",
+                                         PR_GetError());
+            }
+        }
+        PK11_FreeSlot(slot);
+    }
+
     SECITEM_FreeItem(key_id, PR_TRUE);
     PORT_Free(key_id_str);
 
     PORT_Free(signed_random_value.data);
 
+    return ret;
+}
+
+int do_work(TALLOC_CTX *mem_ctx, const char *nss_db, const char *slot_name_in,
+            enum op_mode mode, const char *pin,
+            struct cert_verify_opts *cert_verify_opts,
+            char **cert, char **token_name_out, char **module_name_out,
+            char **key_id_out)
+{
+    int ret;
+    SECStatus rv;
+    NSSInitContext *nss_ctx;
+
+    ret = p11c_init_nss(nss_db, &nss_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = do_request(mem_ctx, slot_name_in, mode, pin, cert_verify_opts,
+                     cert, token_name_out, module_name_out, key_id_out);
+
     rv = NSS_ShutdownContext(nss_ctx);
     if (rv != SECSuccess) {
         DEBUG(SSSDBG_OP_FAILURE, "NSS_ShutdownContext failed [%d].\n",
@@ -532,6 +643,272 @@ static errno_t p11c_recv_data(TALLOC_CTX *mem_ctx, int fd, char **pin)
     return EOK;
 }
 
+/*
+ * This function waits (at most P11_CHILD_IDLE_TIMEOUT seconds) for the next
+ * request of the PAM responder and returns ENOENT if the responder closed
+ * the pipe or the child was idle for too long.
+ */
+static errno_t p11c_read_request(TALLOC_CTX *mem_ctx, enum op_mode *_mode,
+                                 char **_pin)
+{
+    struct pollfd pfd;
+    uint8_t buf[P11_CHILD_MAX_REQUEST_SIZE];
+    uint32_t len;
+    uint32_t op;
+    uint32_t pin_mode;
+    size_t p = 0;
+    ssize_t nread;
+    char *pin = NULL;
+    errno_t ret;
+
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    do {
+        ret = poll(&pfd, 1, P11_CHILD_IDLE_TIMEOUT * 1000);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "poll failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (ret == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "No request received, exiting.\n");
+        return ENOENT;
+    }
+
+    errno = 0;
+    nread = sss_atomic_read_s(STDIN_FILENO, buf, sizeof(uint32_t));
+    if (nread == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (nread == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Responder closed the pipe, exiting.\n");
+        return ENOENT;
+    } else if (nread != sizeof(uint32_t)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request length.\n");
+        return EINVAL;
+    }
+
+    SAFEALIGN_COPY_UINT32(&len, buf, NULL);
+    if (len < 2 * sizeof(uint32_t) || len > sizeof(buf)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid request length [%"PRIu32"].\n",
+              len);
+        return EINVAL;
+    }
+
+    errno = 0;
+    nread = sss_atomic_read_s(STDIN_FILENO, buf, len);
+    if (nread == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        goto done;
+    } else if (nread != len) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request.\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    SAFEALIGN_COPY_UINT32(&op, buf + p, &p);
+    SAFEALIGN_COPY_UINT32(&pin_mode, buf + p, &p);
+
+    switch (op) {
+    case P11_CHILD_OP_PREAUTH:
+        *_mode = OP_PREAUTH;
+        break;
+    case P11_CHILD_OP_AUTH:
+        *_mode = OP_AUTH;
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unknown operation [%"PRIu32"].\n", op);
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (pin_mode == P11_CHILD_PIN_VALUE) {
+        if (p == len || memchr(buf + p, '\0', len - p) != NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Missing or invalid PIN.\n");
+            ret = EINVAL;
+            goto done;
+        }
+
+        pin = talloc_strndup(mem_ctx, (char *) buf + p, len - p);
+        if (pin == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "talloc_strndup failed.\n");
+            ret = ENOMEM;
+            goto done;
+        }
+    } else if (p != len) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unexpected data in request.\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    *_pin = pin;
+    ret = EOK;
+
+done:
+    safezero(buf, sizeof(buf));
+    return ret;
+}
+
+static errno_t p11c_send_response(TALLOC_CTX *mem_ctx, errno_t result,
+                                  const char *cert, const char *token_name,
+                                  const char *module_name, const char *key_id)
+{
+    const char *data = "";
+    uint8_t *buf;
+    size_t len;
+    size_t p = 0;
+    ssize_t written;
+    errno_t ret;
+
+    if (result == EOK && cert != NULL) {
+        data = talloc_asprintf(mem_ctx, "%s\n%s\n%s\n%s\n", token_name,
+                               module_name, key_id, cert);
+        if (data == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "talloc_asprintf failed.\n");
+            return ENOMEM;
+        }
+    }
+
+    len = 2 * sizeof(uint32_t) + strlen(data);
+    buf = talloc_size(mem_ctx, len);
+    if (buf == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "talloc_size failed.\n");
+        return ENOMEM;
+    }
+
+    SAFEALIGN_SET_UINT32(buf + p, len - sizeof(uint32_t), &p);
+    SAFEALIGN_SET_UINT32(buf + p, result, &p);
+    safealign_memcpy(buf + p, data, strlen(data), &p);
+
+    errno = 0;
+    written = sss_atomic_write_s(STDOUT_FILENO, buf, len);
+    if (written == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (written != len) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Short write.\n");
+        return EIO;
+    }
+
+    return EOK;
+}
+
+/* Lets the already loaded PKCS#11 modules pick up readers and tokens which
+ * were added or removed since the previous request. */
+static void p11c_refresh_slots(void)
+{
+    SECMODListLock *lock;
+    SECMODModuleList *mod_list_item;
+    SECStatus rv;
+    int s;
+
+    lock = SECMOD_GetDefaultModuleListLock();
+    SECMOD_GetReadLock(lock);
+
+    for (mod_list_item = SECMOD_GetDefaultModuleList();
+                mod_list_item != NULL;
+                mod_list_item = mod_list_item->next) {
+        if (mod_list_item->module->internal) {
+            continue;
+        }
+
+        rv = SECMOD_UpdateSlotList(mod_list_item->module);
+        if (rv != SECSuccess) {
+            DEBUG(SSSDBG_TRACE_ALL,
+                  "SECMOD_UpdateSlotList failed for [%s] [%d].\n",
+                  mod_list_item->module->commonName, PR_GetError());
+        }
+
+        /* PK11_IsPresent() refreshes the cached token state of a slot */
+        for (s = 0; s < mod_list_item->module->slotCount; s++) {
+            (void) PK11_IsPresent(mod_list_item->module->slots[s]);
+        }
+    }
+
+    SECMOD_ReleaseReadLock(lock);
+}
+
+/* Serves requests of the PAM responder with a single NSS context, so the
+ * PKCS#11 modules are only loaded once. */
+static errno_t p11c_serve(TALLOC_CTX *mem_ctx, const char *nss_db,
+                          struct cert_verify_opts *cert_verify_opts)
+{
+    NSSInitContext *nss_ctx;
+    TALLOC_CTX *req_ctx;
+    enum op_mode mode;
+    char *pin;
+    char *cert;
+    char *token_name;
+    char *module_name;
+    char *key_id;
+    SECStatus rv;
+    errno_t result;
+    errno_t ret;
+
+    ret = p11c_init_nss(nss_db, &nss_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    while (true) {
+        req_ctx = talloc_new(mem_ctx);
+        if (req_ctx == NULL) {
+            ret = ENOMEM;
+            break;
+        }
+
+        pin = NULL;
+        ret = p11c_read_request(req_ctx, &mode, &pin);
+        if (ret != EOK) {
+            talloc_free(req_ctx);
+            ret = (ret == ENOENT) ? EOK : ret;
+            break;
+        }
+
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Request in [%s] mode.\n",
+              mode == OP_AUTH ? "auth" : "pre-auth");
+
+        p11c_refresh_slots();
+
+        cert = NULL;
+        token_name = NULL;
+        module_name = NULL;
+        key_id = NULL;
+        result = do_request(req_ctx, NULL, mode, pin, cert_verify_opts,
+                            &cert, &token_name, &module_name, &key_id);
+        if (pin != NULL) {
+            safezero(pin, strlen(pin));
+        }
+        if (result != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "do_request failed [%d].\n", result);
+        }
+
+        ret = p11c_send_response(req_ctx, result, cert, token_name,
+                                 module_name, key_id);
+        talloc_free(req_ctx);
+        if (ret != EOK) {
+            break;
+        }
+    }
+
+    rv = NSS_ShutdownContext(nss_ctx);
+    if (rv != SECSuccess) {
+        DEBUG(SSSDBG_OP_FAILURE, "NSS_ShutdownContext failed [%d].\n",
+                                 PR_GetError());
+    }
+
+    return ret;
+}
+
 int main(int argc, const char *argv[])
 {
     int opt;
@@ -550,6 +927,7 @@ int main(int argc, const char *argv[])
     char *nss_db = NULL;
     struct cert_verify_opts *cert_verify_opts;
     char *verify_opts = NULL;
+    int persistent = 0;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
@@ -573,6 +951,8 @@ int main(int argc, const char *argv[])
          NULL},
         {"nssdb", 0, POPT_ARG_STRING, &nss_db, 0, _("NSS DB to use"),
          NULL},
+        {"persistent", 0, POPT_ARG_NONE, &persistent, 0,
+         _("Serve requests from stdin until it is closed"), NULL},
         POPT_TABLEEND
     };
 
@@ -644,7 +1024,14 @@ int main(int argc, const char *argv[])
         _exit(-1);
     }
 
-    if (mode == OP_NONE) {
+    if (persistent && (mode != OP_NONE || pin_mode != PIN_NONE)) {
+        fprintf(stderr, "\n--persistent cannot be used together with an " \
+                        "operation or pin mode.\n\n");
+        poptPrintUsage(pc, stderr, 0);
+        _exit(-1);
+    } else if (persistent) {
+        /* operation and pin mode are part of each request */
+    } else if (mode == OP_NONE) {
         fprintf(stderr, "\nMissing operation mode, " \
                         "either --auth or --pre must be specified.\n\n");
         poptPrintUsage(pc, stderr, 0);
@@ -676,8 +1063,10 @@ int main(int argc, const char *argv[])
     DEBUG(SSSDBG_TRACE_FUNC, "p11_child started.\n");
 
     DEBUG(SSSDBG_TRACE_INTERNAL, "Running in [%s] mode.\n",
-          mode == OP_AUTH ? "auth"
-                          : (mode == OP_PREAUTH ? "pre-auth" : "unknown"));
+          persistent ? "persistent"
+                     : (mode == OP_AUTH ? "auth"
+                                        : (mode == OP_PREAUTH ? "pre-auth"
+                                                              : "unknown")));
 
     DEBUG(SSSDBG_TRACE_INTERNAL,
           "Running with effective IDs: [%"SPRIuid"][%"SPRIgid"].\n",
@@ -701,6 +1090,17 @@ int main(int argc, const char *argv[])
         goto fail;
     }
 
+    if (persistent) {
+        ret = p11c_serve(main_ctx, nss_db, cert_verify_opts);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "p11c_serve failed.\n");
+            goto fail;
+        }
+
+        talloc_free(main_ctx);
+        return EXIT_SUCCESS;
+    }
+
     if (mode == OP_AUTH && pin_mode == PIN_STDIN) {
         ret = p11c_recv_data(main_ctx, STDIN_FILENO, &pin);
         if (ret != EOK) {
@@ -47,6 +47,14 @@ struct ad_access_ctx {
     } gpo_map_type;
     hash_table_t *gpo_map_options_table;
     enum gpo_map_type gpo_default_right;
+    /* idle gpo_child processes, see ad_gpo.c */
+    struct ad_gpo_child *gpo_children;
+    /* parsed policy files, keyed by GPO GUID */
+    hash_table_t *gpo_policy_cache;
+    /* memoized access decisions */
+    hash_table_t *gpo_decision_cache;
+    /* GPOs and versions the GPO Result object in sysdb was written for */
+    char *gpo_result_fingerprint;
 };
 
 struct tevent_req *
@@ -34,6 +34,7 @@
 #include <security/pam_modules.h>
 #include <syslog.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <ini_configobj.h>
 #include "util/util.h"
 #include "util/strtonum.h"
@@ -170,6 +171,7 @@ int ad_gpo_process_gpo_recv(struct tevent_req *req,
 
 struct tevent_req *ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
                                            struct tevent_context *ev,
+                                           struct ad_access_ctx *access_ctx,
                                            bool send_to_child,
                                            struct sss_domain_info *domain,
                                            const char *gpo_guid,
@@ -180,7 +182,7 @@ struct tevent_req *ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
                                            int cached_gpt_version,
                                            int gpo_timeout_option);
 
-int ad_gpo_process_cse_recv(struct tevent_req *req);
+int ad_gpo_process_cse_recv(struct tevent_req *req, int *_gpt_version);
 
 /* == ad_gpo_parse_map_options and helpers ==================================*/
 
@@ -1116,27 +1118,71 @@ ad_gpo_extract_policy_setting(TALLOC_CTX *mem_ctx,
     return ret;
 }
 
+/* Maximum number of parsed policy files kept in memory */
+#define GPO_POLICY_CACHE_MAX 256
+
+struct gpo_policy_setting {
+    bool present;
+    char *value;
+};
+
+/*
+ * The supported settings of a cse-specific (GP_EXT_GUID_SECURITY) policy
+ * file. A setting which is not present in the file does not override the
+ * value set by a GPO processed earlier.
+ */
+struct gpo_policy_settings {
+    int gpt_version;
+    struct gpo_policy_setting allow[GPO_MAP_NUM_OPTS];
+    struct gpo_policy_setting deny[GPO_MAP_NUM_OPTS];
+};
+
+static errno_t
+ad_gpo_extract_policy_settings(TALLOC_CTX *mem_ctx,
+                               struct ini_cfgobj *ini_config,
+                               const char *key,
+                               struct gpo_policy_setting *setting)
+{
+    errno_t ret;
+
+    if (key == NULL) {
+        return EOK;
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "key = %s\n", key);
+    ret = ad_gpo_extract_policy_setting(mem_ctx, ini_config, key,
+                                        &setting->value);
+    if (ret == ENOENT) {
+        return EOK;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "ad_gpo_extract_policy_setting failed for %s [%d][%s]\n",
+              key, ret, sss_strerror(ret));
+        return ret;
+    }
+
+    setting->present = true;
+    return EOK;
+}
+
 /*
  * This function parses the cse-specific (GP_EXT_GUID_SECURITY) filename,
- * and stores the allow_key and deny_key of all of the gpo_map_types present
- * in the file (as part of the GPO Result object in the sysdb cache).
+ * and returns the allow_key and deny_key values of all of the gpo_map_types
+ * present in the file.
  */
 static errno_t
-ad_gpo_store_policy_settings(struct sss_domain_info *domain,
-                             const char *filename)
+ad_gpo_parse_policy_settings(TALLOC_CTX *mem_ctx,
+                             const char *filename,
+                             struct gpo_policy_settings **_settings)
 {
     struct ini_cfgfile *file_ctx = NULL;
     struct ini_cfgobj *ini_config = NULL;
+    struct gpo_policy_settings *settings;
     int ret;
     int i;
-    char *allow_value = NULL;
-    char *deny_value = NULL;
-    const char *allow_key = NULL;
-    const char *deny_key = NULL;
-    TALLOC_CTX *tmp_ctx = NULL;
 
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
+    settings = talloc_zero(mem_ctx, struct gpo_policy_settings);
+    if (settings == NULL) {
         ret = ENOMEM;
         goto done;
     }
@@ -1238,72 +1284,277 @@ ad_gpo_store_policy_settings(struct sss_domain_info *domain,
 
         struct gpo_map_option_entry entry = gpo_map_option_entries[i];
 
-        allow_key = entry.allow_key;
-        if (allow_key != NULL) {
-            DEBUG(SSSDBG_TRACE_ALL, "allow_key = %s\n", allow_key);
-            ret = ad_gpo_extract_policy_setting(tmp_ctx,
-                                                ini_config,
-                                                allow_key,
-                                                &allow_value);
-            if (ret != EOK && ret != ENOENT) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "ad_gpo_extract_policy_setting failed for %s [%d][%s]\n",
-                      allow_key, ret, sss_strerror(ret));
-                goto done;
-            } else if (ret != ENOENT) {
-                ret = sysdb_gpo_store_gpo_result_setting(domain,
-                                                         allow_key,
-                                                         allow_value);
-                if (ret != EOK) {
-                    DEBUG(SSSDBG_CRIT_FAILURE,
-                          "sysdb_gpo_store_gpo_result_setting failed for key:"
-                          "'%s' value:'%s' [%d][%s]\n", allow_key, allow_value,
-                          ret, sss_strerror(ret));
-                    goto done;
-                }
-            }
+        ret = ad_gpo_extract_policy_settings(settings, ini_config,
+                                             entry.allow_key,
+                                             &settings->allow[i]);
+        if (ret != EOK) {
+            goto done;
         }
 
-        deny_key = entry.deny_key;
-        if (deny_key != NULL) {
-            DEBUG(SSSDBG_TRACE_ALL, "deny_key = %s\n", deny_key);
-            ret = ad_gpo_extract_policy_setting(tmp_ctx,
-                                                ini_config,
-                                                deny_key,
-                                                &deny_value);
-            if (ret != EOK && ret != ENOENT) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "ad_gpo_extract_policy_setting failed for %s [%d][%s]\n",
-                      deny_key, ret, sss_strerror(ret));
-                goto done;
-            } else if (ret != ENOENT) {
-                ret = sysdb_gpo_store_gpo_result_setting(domain,
-                                                         deny_key,
-                                                         deny_value);
-                if (ret != EOK) {
-                    DEBUG(SSSDBG_CRIT_FAILURE,
-                          "sysdb_gpo_store_gpo_result_setting failed for key:"
-                          "'%s' value:'%s' [%d][%s]\n", deny_key, deny_value,
-                          ret, sss_strerror(ret));
-                    goto done;
-                }
-            }
+        ret = ad_gpo_extract_policy_settings(settings, ini_config,
+                                             entry.deny_key,
+                                             &settings->deny[i]);
+        if (ret != EOK) {
+            goto done;
         }
     }
 
+    *_settings = settings;
     ret = EOK;
 
  done:
 
     if (ret != EOK) {
       DEBUG(SSSDBG_CRIT_FAILURE, "Error encountered: %d.\n", ret);
+      talloc_free(settings);
     }
     ini_config_file_destroy(file_ctx);
     ini_config_destroy(ini_config);
+    return ret;
+}
+
+/*
+ * This function returns the parsed settings of the policy file of the
+ * given GPO. Policy files are only parsed again when the GPT version of
+ * the GPO changed since they were parsed the last time.
+ */
+static errno_t
+ad_gpo_get_policy_settings(struct ad_access_ctx *access_ctx,
+                           const char *gpo_guid,
+                           int gpt_version,
+                           const char *filename,
+                           struct gpo_policy_settings **_settings)
+{
+    struct gpo_policy_settings *settings;
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+    errno_t ret;
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(gpo_guid);
+
+    if (access_ctx->gpo_policy_cache != NULL) {
+        hret = hash_lookup(access_ctx->gpo_policy_cache, &hkey, &hvalue);
+        if (hret == HASH_SUCCESS) {
+            settings = talloc_get_type(hvalue.ptr, struct gpo_policy_settings);
+            if (settings->gpt_version == gpt_version) {
+                DEBUG(SSSDBG_TRACE_FUNC,
+                      "Using parsed policy of [%s] version [%d]\n",
+                      gpo_guid, gpt_version);
+                *_settings = settings;
+                return EOK;
+            }
+
+            hash_delete(access_ctx->gpo_policy_cache, &hkey);
+            talloc_free(settings);
+        }
+    }
+
+    if (access_ctx->gpo_policy_cache == NULL
+            || hash_count(access_ctx->gpo_policy_cache) >= GPO_POLICY_CACHE_MAX) {
+        talloc_zfree(access_ctx->gpo_policy_cache);
+        ret = sss_hash_create(access_ctx, 0, &access_ctx->gpo_policy_cache);
+        if (ret != EOK) {
+            access_ctx->gpo_policy_cache = NULL;
+            return ret;
+        }
+    }
+
+    /* Entries are freed together with the table */
+    ret = ad_gpo_parse_policy_settings(access_ctx->gpo_policy_cache,
+                                       filename, &settings);
+    if (ret != EOK) {
+        return ret;
+    }
+    settings->gpt_version = gpt_version;
+
+    hvalue.type = HASH_VALUE_PTR;
+    hvalue.ptr = settings;
+
+    hret = hash_enter(access_ctx->gpo_policy_cache, &hkey, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to remember policy of [%s]\n",
+              gpo_guid);
+        /* The settings are still valid for the caller */
+    }
+
+    *_settings = settings;
+    return EOK;
+}
+
+/*
+ * This function merges the settings of a GPO into the resultant settings,
+ * the settings of a GPO processed later take precedence.
+ */
+static errno_t
+ad_gpo_merge_policy_settings(struct gpo_policy_settings *result,
+                             struct gpo_policy_settings *settings)
+{
+    struct gpo_policy_setting *dst;
+    struct gpo_policy_setting *src;
+    int i;
+
+    for (i = 0; i < 2 * GPO_MAP_NUM_OPTS; i++) {
+        if (i < GPO_MAP_NUM_OPTS) {
+            dst = &result->allow[i];
+            src = &settings->allow[i];
+        } else {
+            dst = &result->deny[i - GPO_MAP_NUM_OPTS];
+            src = &settings->deny[i - GPO_MAP_NUM_OPTS];
+        }
+
+        if (!src->present) {
+            continue;
+        }
+
+        talloc_zfree(dst->value);
+        if (src->value != NULL) {
+            dst->value = talloc_strdup(result, src->value);
+            if (dst->value == NULL) {
+                return ENOMEM;
+            }
+        }
+        dst->present = true;
+    }
+
+    return EOK;
+}
+
+static errno_t
+ad_gpo_store_policy_setting(struct sss_domain_info *domain,
+                            const char *key,
+                            struct gpo_policy_setting *setting)
+{
+    errno_t ret;
+
+    if (key == NULL || !setting->present) {
+        return EOK;
+    }
+
+    ret = sysdb_gpo_store_gpo_result_setting(domain, key, setting->value);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "sysdb_gpo_store_gpo_result_setting failed for key:"
+              "'%s' value:'%s' [%d][%s]\n", key, setting->value,
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    return EOK;
+}
+
+/*
+ * This function replaces the GPO Result object in the sysdb cache with the
+ * resultant settings of all applicable GPOs. The fingerprint identifies the
+ * GPOs and their versions; if the GPO Result object was already written for
+ * the same fingerprint it is left untouched.
+ */
+static errno_t
+ad_gpo_store_policy_settings(struct ad_access_ctx *access_ctx,
+                             struct sss_domain_info *domain,
+                             const char *fingerprint,
+                             struct gpo_policy_settings *result)
+{
+    TALLOC_CTX *tmp_ctx;
+    bool in_transaction = false;
+    errno_t ret;
+    errno_t sret;
+    int i;
+
+    if (access_ctx->gpo_result_fingerprint != NULL
+            && strcmp(access_ctx->gpo_result_fingerprint, fingerprint) == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "GPO Result is up to date\n");
+        return EOK;
+    }
+    talloc_zfree(access_ctx->gpo_result_fingerprint);
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_transaction_start(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
+        goto done;
+    }
+    in_transaction = true;
+
+    /* clear the policy settings of the previous policy application */
+    ret = sysdb_gpo_delete_gpo_result_object(tmp_ctx, domain);
+    if (ret != EOK && ret != ENOENT) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Could not delete GPO Result from cache: [%s]\n",
+              sss_strerror(ret));
+        goto done;
+    }
+
+    for (i = 0; i < GPO_MAP_NUM_OPTS; i++) {
+        ret = ad_gpo_store_policy_setting(domain,
+                                          gpo_map_option_entries[i].allow_key,
+                                          &result->allow[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        ret = ad_gpo_store_policy_setting(domain,
+                                          gpo_map_option_entries[i].deny_key,
+                                          &result->deny[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = sysdb_transaction_commit(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
+        goto done;
+    }
+    in_transaction = false;
+
+    access_ctx->gpo_result_fingerprint = talloc_strdup(access_ctx,
+                                                       fingerprint);
+    /* On failure the GPO Result is just written again next time */
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(domain->sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+
     talloc_free(tmp_ctx);
     return ret;
 }
 
+/*
+ * This function applies the gpo_mode to the policy decision.
+ */
+static errno_t
+ad_gpo_access_decision(enum gpo_access_control_mode gpo_mode,
+                       bool access_allowed)
+{
+    if (access_allowed) {
+        return EOK;
+    }
+
+    switch (gpo_mode) {
+    case GPO_ACCESS_CONTROL_ENFORCING:
+        return ERR_ACCESS_DENIED;
+    case GPO_ACCESS_CONTROL_PERMISSIVE:
+        DEBUG(SSSDBG_TRACE_FUNC, "access denied: permissive mode\n");
+        sss_log_ext(SSS_LOG_WARNING, LOG_AUTHPRIV, "Warning: user would " \
+                    "have been denied GPO-based logon access if the " \
+                    "ad_gpo_access_control option were set to enforcing " \
+                    "mode.");
+        return EOK;
+    default:
+        return EINVAL;
+    }
+}
+
 /*
  * This cse-specific function (GP_EXT_GUID_SECURITY) performs the access
  * check for determining whether logon access is granted or denied for
@@ -1327,6 +1578,9 @@ ad_gpo_store_policy_settings(struct sss_domain_info *domain,
  * Note that if a principal_sid appears in both allowed_sids and denied_sids,
  * the "allowed_sids_condition" is met, but the "denied_sids_condition" is not.
  * In other words, Deny takes precedence over Allow.
+ *
+ * If _access_allowed is not NULL, it is set to the policy decision before
+ * the gpo_mode is applied.
  */
 static errno_t
 ad_gpo_access_check(TALLOC_CTX *mem_ctx,
@@ -1337,7 +1591,8 @@ ad_gpo_access_check(TALLOC_CTX *mem_ctx,
                     char **allowed_sids,
                     int allowed_size,
                     char **denied_sids,
-                    int denied_size)
+                    int denied_size,
+                    bool *_access_allowed)
 {
     const char *user_sid;
     const char **group_sids;
@@ -1392,24 +1647,12 @@ ad_gpo_access_check(TALLOC_CTX *mem_ctx,
                                  group_sids, group_size);
     DEBUG(SSSDBG_TRACE_FUNC, "  access_denied = %d\n", access_denied);
 
-    if (access_granted && !access_denied) {
-        return EOK;
-    } else {
-        switch (gpo_mode) {
-        case GPO_ACCESS_CONTROL_ENFORCING:
-            return ERR_ACCESS_DENIED;
-        case GPO_ACCESS_CONTROL_PERMISSIVE:
-            DEBUG(SSSDBG_TRACE_FUNC, "access denied: permissive mode\n");
-            sss_log_ext(SSS_LOG_WARNING, LOG_AUTHPRIV, "Warning: user would " \
-                        "have been denied GPO-based logon access if the " \
-                        "ad_gpo_access_control option were set to enforcing " \
-                        "mode.");
-            return EOK;
-        default:
-            return EINVAL;
-        }
+    if (_access_allowed != NULL) {
+        *_access_allowed = access_granted && !access_denied;
     }
 
+    return ad_gpo_access_decision(gpo_mode, access_granted && !access_denied);
+
  done:
 
     if (ret) {
@@ -1504,7 +1747,8 @@ ad_gpo_perform_hbac_processing(TALLOC_CTX *mem_ctx,
                                enum gpo_map_type gpo_map_type,
                                const char *user,
                                struct sss_domain_info *user_domain,
-                               struct sss_domain_info *host_domain)
+                               struct sss_domain_info *host_domain,
+                               bool *_access_allowed)
 {
     int ret;
     const char *allow_key = NULL;
@@ -1542,7 +1786,7 @@ ad_gpo_perform_hbac_processing(TALLOC_CTX *mem_ctx,
     /* perform access check with the final resultant allow_sids and deny_sids */
     ret = ad_gpo_access_check(mem_ctx, gpo_mode, gpo_map_type, user,
                               user_domain, allow_sids, allow_size, deny_sids,
-                              deny_size);
+                              deny_size, _access_allowed);
 
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
@@ -1555,6 +1799,121 @@ ad_gpo_perform_hbac_processing(TALLOC_CTX *mem_ctx,
     return ret;
 }
 
+/* Maximum number of memoized access decisions */
+#define GPO_DECISION_CACHE_MAX 4096
+
+static int
+ad_gpo_sid_cmp(const void *a, const void *b)
+{
+    return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+/*
+ * This function returns the key of a memoized access decision. The decision
+ * only depends on the resultant policy, identified by the fingerprint of the
+ * applied GPOs and their versions, on the gpo_map_type and on the SIDs of
+ * the user, so the order and duplicates of the group_sids do not matter.
+ */
+static char *
+ad_gpo_decision_key(TALLOC_CTX *mem_ctx,
+                    const char *fingerprint,
+                    enum gpo_map_type gpo_map_type,
+                    const char *user_sid,
+                    const char **group_sids,
+                    int group_size)
+{
+    const char **sorted_sids = NULL;
+    char *key;
+    int i;
+
+    key = talloc_asprintf(mem_ctx, "%s|%d|%s",
+                          fingerprint, gpo_map_type, user_sid);
+    if (key == NULL || group_size <= 0) {
+        return key;
+    }
+
+    sorted_sids = talloc_memdup(key, group_sids,
+                                group_size * sizeof(const char *));
+    if (sorted_sids == NULL) {
+        talloc_free(key);
+        return NULL;
+    }
+    qsort(sorted_sids, group_size, sizeof(const char *), ad_gpo_sid_cmp);
+
+    for (i = 0; i < group_size; i++) {
+        if (i > 0 && strcmp(sorted_sids[i], sorted_sids[i - 1]) == 0) {
+            continue;
+        }
+
+        key = talloc_asprintf_append_buffer(key, "|%s", sorted_sids[i]);
+        if (key == NULL) {
+            return NULL;
+        }
+    }
+
+    talloc_free(sorted_sids);
+    return key;
+}
+
+static bool
+ad_gpo_decision_cache_lookup(struct ad_access_ctx *access_ctx,
+                             const char *key,
+                             bool *_access_allowed)
+{
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+
+    if (access_ctx->gpo_decision_cache == NULL) {
+        return false;
+    }
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(key);
+
+    hret = hash_lookup(access_ctx->gpo_decision_cache, &hkey, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        return false;
+    }
+
+    *_access_allowed = hvalue.i != 0;
+    return true;
+}
+
+static void
+ad_gpo_decision_cache_store(struct ad_access_ctx *access_ctx,
+                            const char *key,
+                            bool access_allowed)
+{
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+    errno_t ret;
+
+    /* Decisions for outdated policies are dropped together with the rest */
+    if (access_ctx->gpo_decision_cache == NULL
+            || hash_count(access_ctx->gpo_decision_cache)
+                    >= GPO_DECISION_CACHE_MAX) {
+        talloc_zfree(access_ctx->gpo_decision_cache);
+        ret = sss_hash_create(access_ctx, 0, &access_ctx->gpo_decision_cache);
+        if (ret != EOK) {
+            /* Continue without memoizing decisions */
+            access_ctx->gpo_decision_cache = NULL;
+            return;
+        }
+    }
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(key);
+    hvalue.type = HASH_VALUE_INT;
+    hvalue.i = access_allowed ? 1 : 0;
+
+    hret = hash_enter(access_ctx->gpo_decision_cache, &hkey, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to memoize access decision\n");
+    }
+}
+
 /* == ad_gpo_access_send/recv implementation ================================*/
 
 struct ad_gpo_access_state {
@@ -1579,6 +1938,8 @@ struct ad_gpo_access_state {
     struct gp_gpo **cse_filtered_gpos;
     int num_cse_filtered_gpos;
     int cse_gpo_index;
+    struct gpo_policy_settings *policy_settings;
+    char *gpo_fingerprint;
 };
 
 static void ad_gpo_connect_done(struct tevent_req *subreq);
@@ -1588,6 +1949,7 @@ static void ad_gpo_process_gpo_done(struct tevent_req *subreq);
 
 static errno_t ad_gpo_cse_step(struct tevent_req *req);
 static void ad_gpo_cse_done(struct tevent_req *subreq);
+static errno_t ad_gpo_cse_finish(struct ad_gpo_access_state *state);
 
 struct tevent_req *
 ad_gpo_access_send(TALLOC_CTX *mem_ctx,
@@ -1730,7 +2092,8 @@ process_offline_gpos(TALLOC_CTX *mem_ctx,
                                          gpo_map_type,
                                          user,
                                          user_domain,
-                                         host_domain);
+                                         host_domain,
+                                         NULL);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "HBAC processing failed: [%d](%s}\n",
               ret, sss_strerror(ret));
@@ -2085,6 +2448,7 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
          * Delete the result object list, since there are no
          * GPOs to include in it.
          */
+        talloc_zfree(state->access_ctx->gpo_result_fingerprint);
         ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
         if (ret != EOK) {
             switch (ret) {
@@ -2124,6 +2488,7 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
          * Delete the result object list, since there are no
          * GPOs to include in it.
          */
+        talloc_zfree(state->access_ctx->gpo_result_fingerprint);
         ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
         if (ret != EOK) {
             switch (ret) {
@@ -2192,23 +2557,15 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
           state->num_cse_filtered_gpos);
 
     /*
-     * before we start processing each gpo, we delete the GPO Result object
-     * from the sysdb cache so that any previous policy settings are cleared;
-     * subsequent functions will add the GPO Result object (and populate it
-     * with resultant policy settings) for this policy application
+     * the resultant policy settings of all gpos are collected here and
+     * replace the GPO Result object in the sysdb cache once all gpos have
+     * been processed (see ad_gpo_cse_finish)
      */
-    ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
-    if (ret != EOK) {
-        switch (ret) {
-        case ENOENT:
-            DEBUG(SSSDBG_TRACE_FUNC, "No GPO Result available in cache\n");
-            break;
-        default:
-            DEBUG(SSSDBG_FATAL_FAILURE,
-                  "Could not delete GPO Result from cache: [%s]\n",
-                  sss_strerror(ret));
-            goto done;
-        }
+    state->policy_settings = talloc_zero(state, struct gpo_policy_settings);
+    state->gpo_fingerprint = talloc_strdup(state, "");
+    if (state->policy_settings == NULL || state->gpo_fingerprint == NULL) {
+        ret = ENOMEM;
+        goto done;
     }
 
     ret = ad_gpo_cse_step(req);
@@ -2309,6 +2666,7 @@ ad_gpo_cse_step(struct tevent_req *req)
 
     subreq = ad_gpo_process_cse_send(state,
                                      state->ev,
+                                     state->access_ctx,
                                      send_to_child,
                                      state->host_domain,
                                      cse_filtered_gpo->gpo_guid,
@@ -2318,6 +2676,9 @@ ad_gpo_cse_step(struct tevent_req *req)
                                      GP_EXT_GUID_SECURITY_SUFFIX,
                                      cached_gpt_version,
                                      state->gpo_timeout_option);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
 
     tevent_req_set_callback(subreq, ad_gpo_cse_done, req);
     return EAGAIN;
@@ -2326,16 +2687,16 @@ ad_gpo_cse_step(struct tevent_req *req)
 /*
  * This cse-specific function (GP_EXT_GUID_SECURITY) increments the
  * cse_gpo_index until the policy settings for all applicable GPOs have been
- * stored as part of the GPO Result object in the sysdb cache. Once all
- * GPOs have been processed, this functions performs HBAC processing by
- * comparing the resultant policy setting values in the GPO Result object
- * with the user_sid/group_sids of interest.
+ * collected. Once all GPOs have been processed, this functions performs
+ * HBAC processing (see ad_gpo_cse_finish).
  */
 static void
 ad_gpo_cse_done(struct tevent_req *subreq)
 {
     struct tevent_req *req;
     struct ad_gpo_access_state *state;
+    struct gpo_policy_settings *settings;
+    int gpt_version;
     int ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
@@ -2348,7 +2709,7 @@ ad_gpo_cse_done(struct tevent_req *subreq)
 
     DEBUG(SSSDBG_TRACE_FUNC, "gpo_guid: %s\n", gpo_guid);
 
-    ret = ad_gpo_process_cse_recv(subreq);
+    ret = ad_gpo_process_cse_recv(subreq, &gpt_version);
 
     talloc_zfree(subreq);
 
@@ -2360,35 +2721,39 @@ ad_gpo_cse_done(struct tevent_req *subreq)
 
     /*
      * now that the policy file for this gpo have been downloaded to the
-     * GPO CACHE, we store all of the supported keys present in the file
-     * (as part of the GPO Result object in the sysdb cache).
+     * GPO CACHE, we collect all of the supported keys present in the file;
+     * the file is only parsed again if its version changed.
      */
-    ret = ad_gpo_store_policy_settings(state->host_domain,
-                                       cse_filtered_gpo->policy_filename);
+    ret = ad_gpo_get_policy_settings(state->access_ctx, gpo_guid, gpt_version,
+                                     cse_filtered_gpo->policy_filename,
+                                     &settings);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
-              "ad_gpo_store_policy_settings failed: [%d](%s)\n",
+              "ad_gpo_get_policy_settings failed: [%d](%s)\n",
               ret, sss_strerror(ret));
         goto done;
     }
 
+    ret = ad_gpo_merge_policy_settings(state->policy_settings, settings);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    state->gpo_fingerprint = talloc_asprintf_append_buffer(
+                                                        state->gpo_fingerprint,
+                                                        "%s:%d;", gpo_guid,
+                                                        gpt_version);
+    if (state->gpo_fingerprint == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
     state->cse_gpo_index++;
     ret = ad_gpo_cse_step(req);
 
     if (ret == EOK) {
         /* ret is EOK only after all GPO policy files have been downloaded */
-        ret = ad_gpo_perform_hbac_processing(state,
-                                             state->gpo_mode,
-                                             state->gpo_map_type,
-                                             state->user,
-                                             state->user_domain,
-                                             state->host_domain);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE, "HBAC processing failed: [%d](%s}\n",
-                  ret, sss_strerror(ret));
-            goto done;
-        }
-
+        ret = ad_gpo_cse_finish(state);
     }
 
  done:
@@ -2400,8 +2765,79 @@ ad_gpo_cse_done(struct tevent_req *subreq)
     }
 }
 
-errno_t
-ad_gpo_access_recv(struct tevent_req *req)
+/*
+ * This function stores the resultant policy settings as the GPO Result object
+ * in the sysdb cache and performs HBAC processing by comparing the resultant
+ * policy setting values with the user_sid/group_sids of interest. Decisions
+ * are memoized until the applicable GPOs or their versions change.
+ */
+static errno_t
+ad_gpo_cse_finish(struct ad_gpo_access_state *state)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *user_sid;
+    const char **group_sids;
+    int group_size = 0;
+    char *key = NULL;
+    bool access_allowed = false;
+    errno_t ret;
+
+    ret = ad_gpo_store_policy_settings(state->access_ctx, state->host_domain,
+                                       state->gpo_fingerprint,
+                                       state->policy_settings);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "ad_gpo_store_policy_settings failed: [%d](%s)\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    /* If the SIDs are not available HBAC processing reports the error */
+    ret = ad_gpo_get_sids(tmp_ctx, state->user, state->user_domain, &user_sid,
+                          &group_sids, &group_size);
+    if (ret == EOK) {
+        key = ad_gpo_decision_key(tmp_ctx, state->gpo_fingerprint,
+                                  state->gpo_map_type, user_sid,
+                                  group_sids, group_size);
+    }
+
+    if (key != NULL && ad_gpo_decision_cache_lookup(state->access_ctx, key,
+                                                    &access_allowed)) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Using memoized access decision [%d]\n",
+              access_allowed);
+        ret = ad_gpo_access_decision(state->gpo_mode, access_allowed);
+        goto done;
+    }
+
+    ret = ad_gpo_perform_hbac_processing(state,
+                                         state->gpo_mode,
+                                         state->gpo_map_type,
+                                         state->user,
+                                         state->user_domain,
+                                         state->host_domain,
+                                         &access_allowed);
+    if (key != NULL && (ret == EOK || ret == ERR_ACCESS_DENIED)) {
+        ad_gpo_decision_cache_store(state->access_ctx, key, access_allowed);
+    }
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "HBAC processing failed: [%d](%s}\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t
+ad_gpo_access_recv(struct tevent_req *req)
 {
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
@@ -3993,7 +4429,7 @@ create_cse_send_buffer(TALLOC_CTX *mem_ctx,
         return ENOMEM;
     }
 
-    buf->size = 5 * sizeof(uint32_t);
+    buf->size = 6 * sizeof(uint32_t);
     buf->size += smb_server_length + smb_share_length + smb_path_length +
         smb_cse_suffix_length;
 
@@ -4007,6 +4443,9 @@ create_cse_send_buffer(TALLOC_CTX *mem_ctx,
     }
 
     rp = 0;
+    /* length of the request (the gpo_child serves several requests) */
+    SAFEALIGN_SET_UINT32(&buf->data[rp], buf->size - sizeof(uint32_t), &rp);
+
     /* cached_gpt_version */
     SAFEALIGN_SET_UINT32(&buf->data[rp], cached_gpt_version, &rp);
 
@@ -4055,28 +4494,346 @@ ad_gpo_parse_gpo_child_response(uint8_t *buf,
     return ret;
 }
 
+/* == long-lived gpo_child processes ======================================== */
+
+/*
+ * The gpo_child serves requests until its stdin is closed, which allows it
+ * to reuse its SMB session to the SYSVOL share. Each child processes only
+ * one request at a time; idle children are kept in access_ctx->gpo_children
+ * and concurrent requests simply start an additional child.
+ */
+
+/* Maximum number of idle gpo_child processes */
+#define GPO_CHILD_MAX_IDLE 2
+
+struct ad_gpo_child {
+    struct ad_gpo_child *prev;
+    struct ad_gpo_child *next;
+
+    struct ad_access_ctx *access_ctx;
+    pid_t pid;
+    struct child_io_fds *io;
+    struct sss_child_ctx_old *child_ctx;
+    bool idle;
+    bool exited;
+    int num_requests;
+};
+
+static int ad_gpo_child_destructor(struct ad_gpo_child *child)
+{
+    if (child->idle) {
+        DLIST_REMOVE(child->access_ctx->gpo_children, child);
+        child->idle = false;
+    }
+
+    if (child->child_ctx != NULL) {
+        /* the child is still running, make sure it terminates */
+        child_handler_destroy(child->child_ctx);
+        child->child_ctx = NULL;
+    }
+
+    return 0;
+}
+
+static void ad_gpo_child_exited(int child_status,
+                                struct tevent_signal *sige,
+                                void *pvt)
+{
+    struct ad_gpo_child *child = talloc_get_type(pvt, struct ad_gpo_child);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "gpo_child [%d] exited\n", child->pid);
+
+    /* the signal handler context is freed by the caller */
+    child->child_ctx = NULL;
+    child->exited = true;
+
+    /* a busy child is freed by the request using it, which will see the
+     * closed pipe */
+    if (child->idle) {
+        talloc_free(child);
+    }
+}
+
+static errno_t
+ad_gpo_child_fork(struct tevent_context *ev,
+                  struct ad_access_ctx *access_ctx,
+                  struct ad_gpo_child **_child)
+{
+    int pipefd_to_child[2] = PIPE_INIT;
+    int pipefd_from_child[2] = PIPE_INIT;
+    struct ad_gpo_child *child;
+    pid_t pid;
+    errno_t ret;
+
+    child = talloc_zero(access_ctx, struct ad_gpo_child);
+    if (child == NULL) {
+        return ENOMEM;
+    }
+    child->access_ctx = access_ctx;
+
+    child->io = talloc(child, struct child_io_fds);
+    if (child->io == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
+        ret = ENOMEM;
+        goto fail;
+    }
+    child->io->write_to_child_fd = -1;
+    child->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) child->io, child_io_destructor);
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", errno, strerror(errno));
+        goto fail;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", errno, strerror(errno));
+        goto fail;
+    }
+
+    pid = fork();
+
+    if (pid == 0) { /* child */
+        exec_child_ex(child,
+                      pipefd_to_child, pipefd_from_child,
+                      GPO_CHILD, gpo_child_debug_fd, NULL, false,
+                      STDIN_FILENO, AD_GPO_CHILD_OUT_FILENO);
+
+        /* We should never get here */
+        DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec gpo_child:\n");
+    } else if (pid > 0) { /* parent */
+        child->pid = pid;
+        child->io->read_from_child_fd = pipefd_from_child[0];
+        PIPE_FD_CLOSE(pipefd_from_child[1]);
+        child->io->write_to_child_fd = pipefd_to_child[1];
+        PIPE_FD_CLOSE(pipefd_to_child[0]);
+        sss_fd_nonblocking(child->io->read_from_child_fd);
+        sss_fd_nonblocking(child->io->write_to_child_fd);
+
+        ret = child_handler_setup(ev, pid, ad_gpo_child_exited, child,
+                                  &child->child_ctx);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Could not set up child signal handler\n");
+            /* the pipes are closed by the io destructor */
+            kill(pid, SIGKILL);
+            talloc_free(child);
+            return ret;
+        }
+        talloc_set_destructor(child, ad_gpo_child_destructor);
+    } else { /* error */
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", errno, strerror(errno));
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started gpo_child [%d]\n", child->pid);
+    *_child = child;
+    return EOK;
+
+fail:
+    PIPE_CLOSE(pipefd_from_child);
+    PIPE_CLOSE(pipefd_to_child);
+    talloc_free(child);
+    return ret;
+}
+
+/*
+ * This function returns an idle gpo_child or starts a new one.
+ */
+static errno_t
+ad_gpo_child_get(struct tevent_context *ev,
+                 struct ad_access_ctx *access_ctx,
+                 struct ad_gpo_child **_child)
+{
+    struct ad_gpo_child *child;
+
+    child = access_ctx->gpo_children;
+    if (child == NULL) {
+        return ad_gpo_child_fork(ev, access_ctx, _child);
+    }
+
+    DLIST_REMOVE(access_ctx->gpo_children, child);
+    child->idle = false;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Reusing gpo_child [%d]\n", child->pid);
+    *_child = child;
+    return EOK;
+}
+
+/*
+ * This function returns a gpo_child after a request. Children which failed
+ * or which are not needed any longer are terminated.
+ */
+static void
+ad_gpo_child_put(struct ad_gpo_child *child, bool reusable)
+{
+    struct ad_gpo_child *c;
+    int num_idle = 0;
+
+    DLIST_FOR_EACH(c, child->access_ctx->gpo_children) {
+        num_idle++;
+    }
+
+    if (!reusable || child->exited || num_idle >= GPO_CHILD_MAX_IDLE) {
+        talloc_free(child);
+        return;
+    }
+
+    child->idle = true;
+    DLIST_ADD(child->access_ctx->gpo_children, child);
+}
+
+/* Read a response of fixed size from the gpo_child */
+
+struct gpo_child_read_state {
+    int fd;
+    uint8_t *buf;
+    size_t size;
+    size_t nread;
+};
+
+static void gpo_child_read_handler(struct tevent_context *ev,
+                                   struct tevent_fd *fde,
+                                   uint16_t flags, void *pvt);
+
+static struct tevent_req *
+gpo_child_read_send(TALLOC_CTX *mem_ctx,
+                    struct tevent_context *ev,
+                    int fd,
+                    size_t size)
+{
+    struct tevent_req *req;
+    struct gpo_child_read_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state, struct gpo_child_read_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->fd = fd;
+    state->size = size;
+    state->nread = 0;
+    state->buf = talloc_size(state, size);
+    if (state->buf == NULL) {
+        goto fail;
+    }
+
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        gpo_child_read_handler, req);
+    if (fde == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_fd failed.\n");
+        goto fail;
+    }
+
+    return req;
+
+fail:
+    talloc_zfree(req);
+    return NULL;
+}
+
+static void gpo_child_read_handler(struct tevent_context *ev,
+                                   struct tevent_fd *fde,
+                                   uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct gpo_child_read_state *state =
+            tevent_req_data(req, struct gpo_child_read_state);
+    ssize_t size;
+    errno_t ret;
+
+    if (flags & TEVENT_FD_WRITE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "gpo_child_read_handler called with "
+              "TEVENT_FD_WRITE, this should not happen.\n");
+        tevent_req_error(req, EINVAL);
+        return;
+    }
+
+    errno = 0;
+    size = read(state->fd, state->buf + state->nread,
+                state->size - state->nread);
+    if (size == -1) {
+        ret = errno;
+        if (ret == EAGAIN || ret == EINTR) {
+            return;
+        }
+
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    } else if (size == 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "gpo_child closed the pipe.\n");
+        tevent_req_error(req, EPIPE);
+        return;
+    }
+
+    state->nread += size;
+    if (state->nread == state->size) {
+        tevent_req_done(req);
+    }
+}
+
+static errno_t gpo_child_read_recv(struct tevent_req *req,
+                                   TALLOC_CTX *mem_ctx,
+                                   uint8_t **_buf,
+                                   size_t *_len)
+{
+    struct gpo_child_read_state *state =
+            tevent_req_data(req, struct gpo_child_read_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_buf = talloc_steal(mem_ctx, state->buf);
+    *_len = state->nread;
+    return EOK;
+}
+
 /* == ad_gpo_process_cse_send/recv implementation ========================== */
 
 struct ad_gpo_process_cse_state {
     struct tevent_context *ev;
+    struct ad_access_ctx *access_ctx;
     struct sss_domain_info *domain;
     int gpo_timeout_option;
     const char *gpo_guid;
     const char *smb_path;
     const char *smb_cse_suffix;
-    pid_t child_pid;
+    int gpt_version;
+    struct io_buffer *send_buf;
+    struct ad_gpo_child *child;
+    bool retried;
     uint8_t *buf;
-    ssize_t len;
-    struct child_io_fds *io;
+    size_t len;
 };
 
-static errno_t gpo_fork_child(struct tevent_req *req);
+static errno_t gpo_cse_send_request(struct tevent_req *req);
 static void gpo_cse_step(struct tevent_req *subreq);
 static void gpo_cse_done(struct tevent_req *subreq);
+static void gpo_cse_child_failed(struct tevent_req *req, errno_t ret);
+
+static int ad_gpo_process_cse_state_destructor(struct ad_gpo_process_cse_state *state)
+{
+    /* the request was interrupted, the state of the child is unknown */
+    if (state->child != NULL) {
+        ad_gpo_child_put(state->child, false);
+        state->child = NULL;
+    }
+
+    return 0;
+}
 
 /*
  * This cse-specific function (GP_EXT_GUID_SECURITY) sends the input smb uri
- * components and cached_gpt_version to the gpo child, which, in turn,
+ * components and cached_gpt_version to a gpo child, which, in turn,
  * will download the GPT.INI file and policy files (as needed) and store
  * them in the GPO_CACHE directory. Note that if the send_to_child input is
  * false, this function simply completes the request.
@@ -4084,6 +4841,7 @@ static void gpo_cse_done(struct tevent_req *subreq);
 struct tevent_req *
 ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
                         struct tevent_context *ev,
+                        struct ad_access_ctx *access_ctx,
                         bool send_to_child,
                         struct sss_domain_info *domain,
                         const char *gpo_guid,
@@ -4095,9 +4853,7 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
                         int gpo_timeout_option)
 {
     struct tevent_req *req;
-    struct tevent_req *subreq;
     struct ad_gpo_process_cse_state *state;
-    struct io_buffer *buf = NULL;
     errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state, struct ad_gpo_process_cse_state);
@@ -4106,6 +4862,8 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
+    state->gpt_version = cached_gpt_version;
+
     if (!send_to_child) {
         /*
          * if we don't need to talk to child (b/c cache timeout is still valid),
@@ -4116,6 +4874,7 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
     }
 
     state->ev = ev;
+    state->access_ctx = access_ctx;
     state->buf = NULL;
     state->len = 0;
     state->domain = domain;
@@ -4123,39 +4882,22 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
     state->gpo_guid = gpo_guid;
     state->smb_path = smb_path;
     state->smb_cse_suffix = smb_cse_suffix;
-    state->io = talloc(state, struct child_io_fds);
-    if (state->io == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
-        ret = ENOMEM;
-        goto immediately;
-    }
-
-    state->io->write_to_child_fd = -1;
-    state->io->read_from_child_fd = -1;
-    talloc_set_destructor((void *) state->io, child_io_destructor);
+    talloc_set_destructor(state, ad_gpo_process_cse_state_destructor);
 
     /* prepare the data to pass to child */
     ret = create_cse_send_buffer(state, smb_server, smb_share, smb_path,
-                                 smb_cse_suffix, cached_gpt_version, &buf);
+                                 smb_cse_suffix, cached_gpt_version,
+                                 &state->send_buf);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "create_cse_send_buffer failed.\n");
         goto immediately;
     }
 
-    ret = gpo_fork_child(req);
+    ret = gpo_cse_send_request(req);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "gpo_fork_child failed.\n");
         goto immediately;
     }
 
-    subreq = write_pipe_send(state, ev, buf->data, buf->size,
-                             state->io->write_to_child_fd);
-    if (subreq == NULL) {
-        ret = ENOMEM;
-        goto immediately;
-    }
-    tevent_req_set_callback(subreq, gpo_cse_step, req);
-
     return req;
 
 immediately:
@@ -4171,6 +4913,32 @@ immediately:
     return req;
 }
 
+static errno_t gpo_cse_send_request(struct tevent_req *req)
+{
+    struct tevent_req *subreq;
+    struct ad_gpo_process_cse_state *state;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct ad_gpo_process_cse_state);
+
+    ret = ad_gpo_child_get(state->ev, state->access_ctx, &state->child);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to start gpo_child.\n");
+        return ret;
+    }
+    state->child->num_requests++;
+
+    subreq = write_pipe_send(state, state->ev, state->send_buf->data,
+                             state->send_buf->size,
+                             state->child->io->write_to_child_fd);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, gpo_cse_step, req);
+
+    return EOK;
+}
+
 static void gpo_cse_step(struct tevent_req *subreq)
 {
     struct tevent_req *req;
@@ -4183,21 +4951,53 @@ static void gpo_cse_step(struct tevent_req *subreq)
     ret = write_pipe_recv(subreq);
     talloc_zfree(subreq);
     if (ret != EOK) {
-        tevent_req_error(req, ret);
+        gpo_cse_child_failed(req, ret);
         return;
     }
 
-    PIPE_FD_CLOSE(state->io->write_to_child_fd);
-
-    subreq = read_pipe_send(state, state->ev, state->io->read_from_child_fd);
-
+    subreq = gpo_child_read_send(state, state->ev,
+                                 state->child->io->read_from_child_fd,
+                                 AD_GPO_CHILD_RESPONSE_SIZE);
     if (subreq == NULL) {
-        tevent_req_error(req, ENOMEM);
+        gpo_cse_child_failed(req, ENOMEM);
         return;
     }
     tevent_req_set_callback(subreq, gpo_cse_done, req);
 }
 
+/*
+ * A child which was already used before might have exited because it was
+ * idle for too long, in this case the request is sent once more to a new
+ * child.
+ */
+static void gpo_cse_child_failed(struct tevent_req *req, errno_t ret)
+{
+    struct ad_gpo_process_cse_state *state;
+    bool reused;
+    errno_t sret;
+
+    state = tevent_req_data(req, struct ad_gpo_process_cse_state);
+
+    reused = state->child->num_requests > 1;
+    ad_gpo_child_put(state->child, false);
+    state->child = NULL;
+
+    if (reused && !state->retried && ret != ENOMEM) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Communication with gpo_child failed [%d][%s], retrying.\n",
+              ret, sss_strerror(ret));
+        state->retried = true;
+
+        sret = gpo_cse_send_request(req);
+        if (sret == EOK) {
+            return;
+        }
+        ret = sret;
+    }
+
+    tevent_req_error(req, ret);
+}
+
 static void gpo_cse_done(struct tevent_req *subreq)
 {
     struct tevent_req *req;
@@ -4210,14 +5010,16 @@ static void gpo_cse_done(struct tevent_req *subreq)
     state = tevent_req_data(req, struct ad_gpo_process_cse_state);
     int ret;
 
-    ret = read_pipe_recv(subreq, state, &state->buf, &state->len);
+    ret = gpo_child_read_recv(subreq, state, &state->buf, &state->len);
     talloc_zfree(subreq);
     if (ret != EOK) {
-        tevent_req_error(req, ret);
+        gpo_cse_child_failed(req, ret);
         return;
     }
 
-    PIPE_FD_CLOSE(state->io->read_from_child_fd);
+    /* the child is ready for the next request */
+    ad_gpo_child_put(state->child, true);
+    state->child = NULL;
 
     ret = ad_gpo_parse_gpo_child_response(state->buf, state->len,
                                           &sysvol_gpt_version, &child_result);
@@ -4245,81 +5047,25 @@ static void gpo_cse_done(struct tevent_req *subreq)
         tevent_req_error(req, ret);
         return;
     }
+    state->gpt_version = sysvol_gpt_version;
 
     tevent_req_done(req);
     return;
 }
 
-int ad_gpo_process_cse_recv(struct tevent_req *req)
-{
-    TEVENT_REQ_RETURN_ON_ERROR(req);
-    return EOK;
-}
-
-static errno_t
-gpo_fork_child(struct tevent_req *req)
+/*
+ * The returned gpt_version is the version of the policy file in the
+ * GPO_CACHE directory.
+ */
+int ad_gpo_process_cse_recv(struct tevent_req *req, int *_gpt_version)
 {
-    int pipefd_to_child[2] = PIPE_INIT;
-    int pipefd_from_child[2] = PIPE_INIT;
-    pid_t pid;
-    errno_t ret;
-    struct ad_gpo_process_cse_state *state;
-
-    state = tevent_req_data(req, struct ad_gpo_process_cse_state);
-
-    ret = pipe(pipefd_from_child);
-    if (ret == -1) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "pipe failed [%d][%s].\n", errno, strerror(errno));
-        goto fail;
-    }
-    ret = pipe(pipefd_to_child);
-    if (ret == -1) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "pipe failed [%d][%s].\n", errno, strerror(errno));
-        goto fail;
-    }
+    struct ad_gpo_process_cse_state *state =
+            tevent_req_data(req, struct ad_gpo_process_cse_state);
 
-    pid = fork();
-
-    if (pid == 0) { /* child */
-        exec_child_ex(state,
-                      pipefd_to_child, pipefd_from_child,
-                      GPO_CHILD, gpo_child_debug_fd, NULL, false,
-                      STDIN_FILENO, AD_GPO_CHILD_OUT_FILENO);
-
-        /* We should never get here */
-        DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec gpo_child:\n");
-    } else if (pid > 0) { /* parent */
-        state->child_pid = pid;
-        state->io->read_from_child_fd = pipefd_from_child[0];
-        PIPE_FD_CLOSE(pipefd_from_child[1]);
-        state->io->write_to_child_fd = pipefd_to_child[1];
-        PIPE_FD_CLOSE(pipefd_to_child[0]);
-        sss_fd_nonblocking(state->io->read_from_child_fd);
-        sss_fd_nonblocking(state->io->write_to_child_fd);
-
-        ret = child_handler_setup(state->ev, pid, NULL, NULL, NULL);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_CRIT_FAILURE,
-                  "Could not set up child signal handler\n");
-            goto fail;
-        }
-    } else { /* error */
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "fork failed [%d][%s].\n", errno, strerror(errno));
-        goto fail;
-    }
+    TEVENT_REQ_RETURN_ON_ERROR(req);
 
+    *_gpt_version = state->gpt_version;
     return EOK;
-
-fail:
-    PIPE_CLOSE(pipefd_from_child);
-    PIPE_CLOSE(pipefd_to_child);
-    return ret;
 }
 
 struct ad_gpo_get_sd_referral_state {
@@ -26,6 +26,8 @@
 #include "providers/ad/ad_access.h"
 
 #define AD_GPO_CHILD_OUT_FILENO 3
+/* uint32_t sysvol_gpt_version and uint32_t result */
+#define AD_GPO_CHILD_RESPONSE_SIZE (2 * sizeof(uint32_t))
 
 #define AD_GPO_ATTRS {AD_AT_NT_SEC_DESC, \
                       AD_AT_CN, AD_AT_FILE_SYS_PATH, \
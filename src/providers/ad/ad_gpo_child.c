@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <poll.h>
 #include <popt.h>
 #include <libsmbclient.h>
 #include <ini_configobj.h>
@@ -41,6 +42,11 @@
 #define INI_GENERAL_SECTION "General"
 #define GPT_INI_VERSION "Version"
 
+/* The child serves requests until stdin is closed by the backend or until
+ * no request arrived for GPO_CHILD_IDLE_TIMEOUT seconds. */
+#define GPO_CHILD_IDLE_TIMEOUT 300
+#define GPO_CHILD_MAX_REQUEST_SIZE 65536
+
 struct input_buffer {
     int cached_gpt_version;
     const char *smb_server;
@@ -592,6 +598,41 @@ copy_smb_file_to_gpo_cache(SMBCCTX *smbc_ctx,
 }
 
 
+/*
+ * This function returns a libsmbclient context which is kept for the whole
+ * lifetime of the child so that the SMB session (and the Kerberos service
+ * ticket) to the SYSVOL share is reused by subsequent requests.
+ */
+static errno_t
+get_smbc_context(SMBCCTX **_smbc_ctx)
+{
+    SMBCCTX *smbc_ctx;
+
+    if (*_smbc_ctx != NULL) {
+        return EOK;
+    }
+
+    smbc_ctx = smbc_new_context();
+    if (smbc_ctx == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not allocate new smbc context\n");
+        return ENOMEM;
+    }
+
+    smbc_setOptionDebugToStderr(smbc_ctx, 1);
+    smbc_setFunctionAuthData(smbc_ctx, sssd_krb_get_auth_data_fn);
+    smbc_setOptionUseKerberos(smbc_ctx, 1);
+
+    /* Initialize the context using the previously specified options */
+    if (smbc_init_context(smbc_ctx) == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not initialize smbc context\n");
+        smbc_free_context(smbc_ctx, 0);
+        return ENOMEM;
+    }
+
+    *_smbc_ctx = smbc_ctx;
+    return EOK;
+}
+
 /*
  * Using its smb_uri components and cached_gpt_version inputs, this function
  * does several things:
@@ -614,7 +655,8 @@ copy_smb_file_to_gpo_cache(SMBCCTX *smbc_ctx,
  * - backend will read the policy file from the GPO_CACHE
  */
 static errno_t
-perform_smb_operations(int cached_gpt_version,
+perform_smb_operations(SMBCCTX **_smbc_ctx,
+                       int cached_gpt_version,
                        const char *smb_server,
                        const char *smb_share,
                        const char *smb_path,
@@ -625,23 +667,11 @@ perform_smb_operations(int cached_gpt_version,
     int ret;
     int sysvol_gpt_version;
 
-    smbc_ctx = smbc_new_context();
-    if (smbc_ctx == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not allocate new smbc context\n");
-        ret = ENOMEM;
-        goto done;
-    }
-
-    smbc_setOptionDebugToStderr(smbc_ctx, 1);
-    smbc_setFunctionAuthData(smbc_ctx, sssd_krb_get_auth_data_fn);
-    smbc_setOptionUseKerberos(smbc_ctx, 1);
-
-    /* Initialize the context using the previously specified options */
-    if (smbc_init_context(smbc_ctx) == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not initialize smbc context\n");
-        ret = ENOMEM;
-        goto done;
+    ret = get_smbc_context(_smbc_ctx);
+    if (ret != EOK) {
+        return ret;
     }
+    smbc_ctx = *_smbc_ctx;
 
     /* download ini file */
     ret = copy_smb_file_to_gpo_cache(smbc_ctx, smb_server, smb_share, smb_path,
@@ -677,10 +707,94 @@ perform_smb_operations(int cached_gpt_version,
     *_sysvol_gpt_version = sysvol_gpt_version;
 
  done:
-    smbc_free_context(smbc_ctx, 0);
+    if (ret != EOK) {
+        /* Do not reuse a session which might be broken */
+        smbc_free_context(smbc_ctx, 1);
+        *_smbc_ctx = NULL;
+    }
     return ret;
 }
 
+/*
+ * Each request sent by the backend is prefixed by its length. This function
+ * waits (at most GPO_CHILD_IDLE_TIMEOUT seconds) for the next request and
+ * returns ENOENT if the backend closed the pipe or the child was idle for
+ * too long.
+ */
+static errno_t
+read_request(TALLOC_CTX *mem_ctx, uint8_t **_buf, size_t *_len)
+{
+    struct pollfd pfd;
+    uint8_t len_buf[sizeof(uint32_t)];
+    uint32_t len;
+    uint8_t *buf;
+    ssize_t nread;
+    errno_t ret;
+
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    do {
+        ret = poll(&pfd, 1, GPO_CHILD_IDLE_TIMEOUT * 1000);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "poll failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (ret == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "No request received, exiting.\n");
+        return ENOENT;
+    }
+
+    errno = 0;
+    nread = sss_atomic_read_s(STDIN_FILENO, len_buf, sizeof(len_buf));
+    if (nread == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (nread == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Backend closed the pipe, exiting.\n");
+        return ENOENT;
+    } else if (nread != sizeof(len_buf)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request length.\n");
+        return EINVAL;
+    }
+
+    SAFEALIGN_COPY_UINT32(&len, len_buf, NULL);
+    if (len == 0 || len > GPO_CHILD_MAX_REQUEST_SIZE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid request length [%"PRIu32"].\n",
+              len);
+        return EINVAL;
+    }
+
+    buf = talloc_size(mem_ctx, len);
+    if (buf == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_size failed.\n");
+        return ENOMEM;
+    }
+
+    errno = 0;
+    nread = sss_atomic_read_s(STDIN_FILENO, buf, len);
+    if (nread == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        talloc_free(buf);
+        return ret;
+    } else if (nread != len) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request.\n");
+        talloc_free(buf);
+        return EINVAL;
+    }
+
+    *_buf = buf;
+    *_len = len;
+    return EOK;
+}
+
 int
 main(int argc, const char *argv[])
 {
@@ -691,11 +805,13 @@ main(int argc, const char *argv[])
     int sysvol_gpt_version;
     int result;
     TALLOC_CTX *main_ctx = NULL;
+    TALLOC_CTX *req_ctx = NULL;
     uint8_t *buf = NULL;
-    ssize_t len = 0;
+    size_t len = 0;
     struct input_buffer *ibuf = NULL;
     struct response *resp = NULL;
     ssize_t written;
+    SMBCCTX *smbc_ctx = NULL;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
@@ -754,82 +870,94 @@ main(int argc, const char *argv[])
     }
     talloc_steal(main_ctx, debug_prg_name);
 
-    buf = talloc_size(main_ctx, sizeof(uint8_t)*IN_BUF_SIZE);
-    if (buf == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_size failed.\n");
-        goto fail;
-    }
-
-    ibuf = talloc_zero(main_ctx, struct input_buffer);
-    if (ibuf == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
-        goto fail;
-    }
-
     DEBUG(SSSDBG_TRACE_FUNC, "context initialized\n");
 
-    errno = 0;
-    len = sss_atomic_read_s(STDIN_FILENO, buf, IN_BUF_SIZE);
-    if (len == -1) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n", ret, strerror(ret));
-        goto fail;
-    }
+    while (true) {
+        req_ctx = talloc_new(main_ctx);
+        if (req_ctx == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "talloc_new failed.\n");
+            goto fail;
+        }
 
-    close(STDIN_FILENO);
+        ret = read_request(req_ctx, &buf, &len);
+        if (ret == ENOENT) {
+            break;
+        } else if (ret != EOK) {
+            goto fail;
+        }
 
-    ret = unpack_buffer(buf, len, ibuf);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "unpack_buffer failed.[%d][%s].\n", ret, strerror(ret));
-        goto fail;
-    }
+        ibuf = talloc_zero(req_ctx, struct input_buffer);
+        if (ibuf == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
+            goto fail;
+        }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "performing smb operations\n");
+        ret = unpack_buffer(buf, len, ibuf);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "unpack_buffer failed.[%d][%s].\n", ret, strerror(ret));
+            goto fail;
+        }
 
-    result = perform_smb_operations(ibuf->cached_gpt_version,
-                                    ibuf->smb_server,
-                                    ibuf->smb_share,
-                                    ibuf->smb_path,
-                                    ibuf->smb_cse_suffix,
-                                    &sysvol_gpt_version);
-    if (result != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "perform_smb_operations failed.[%d][%s].\n",
-              result, strerror(result));
-        goto fail;
-    }
+        DEBUG(SSSDBG_TRACE_FUNC, "performing smb operations\n");
+
+        sysvol_gpt_version = 0;
+        result = perform_smb_operations(&smbc_ctx,
+                                        ibuf->cached_gpt_version,
+                                        ibuf->smb_server,
+                                        ibuf->smb_share,
+                                        ibuf->smb_path,
+                                        ibuf->smb_cse_suffix,
+                                        &sysvol_gpt_version);
+        if (result != EOK) {
+            /* The failure is reported to the backend, which keeps the child
+             * running for the next request. */
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "perform_smb_operations failed.[%d][%s].\n",
+                  result, strerror(result));
+        }
 
-    ret = prepare_response(main_ctx, sysvol_gpt_version, result, &resp);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "prepare_response failed. [%d][%s].\n",
-                    ret, strerror(ret));
-        goto fail;
-    }
+        ret = prepare_response(req_ctx, sysvol_gpt_version, result, &resp);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "prepare_response failed. [%d][%s].\n",
+                        ret, strerror(ret));
+            goto fail;
+        }
 
-    errno = 0;
+        errno = 0;
 
-    written = sss_atomic_write_s(AD_GPO_CHILD_OUT_FILENO, resp->buf, resp->size);
-    if (written == -1) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%d][%s].\n", ret,
-                    strerror(ret));
-        goto fail;
-    }
+        written = sss_atomic_write_s(AD_GPO_CHILD_OUT_FILENO, resp->buf,
+                                     resp->size);
+        if (written == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%d][%s].\n", ret,
+                        strerror(ret));
+            goto fail;
+        }
 
-    if (written != resp->size) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Expected to write %zu bytes, wrote %zu\n",
-              resp->size, written);
-        goto fail;
+        if (written != resp->size) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Expected to write %zu bytes, wrote %zu\n",
+                  resp->size, written);
+            goto fail;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "request completed\n");
+        talloc_zfree(req_ctx);
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "gpo_child completed successfully\n");
+    if (smbc_ctx != NULL) {
+        smbc_free_context(smbc_ctx, 1);
+    }
     close(AD_GPO_CHILD_OUT_FILENO);
     talloc_free(main_ctx);
     return EXIT_SUCCESS;
 
 fail:
     DEBUG(SSSDBG_CRIT_FAILURE, "gpo_child failed!\n");
+    if (smbc_ctx != NULL) {
+        smbc_free_context(smbc_ctx, 1);
+    }
     close(AD_GPO_CHILD_OUT_FILENO);
     talloc_free(main_ctx);
     return EXIT_FAILURE;
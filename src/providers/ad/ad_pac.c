@@ -445,6 +445,209 @@ struct ad_handle_pac_initgr_state {
 
 static void ad_handle_pac_initgr_lookup_sids_done(struct tevent_req *subreq);
 
+/* Update the group memberships of the user once the missing group SIDs were
+ * looked up. SIDs which still cannot be found are ignored. */
+static errno_t ad_handle_pac_update_members(TALLOC_CTX *mem_ctx,
+                                            const char *username,
+                                            struct sss_domain_info *user_dom,
+                                            size_t num_missing_sids,
+                                            char **missing_sids,
+                                            size_t num_cached_groups,
+                                            char **cached_groups)
+{
+    TALLOC_CTX *tmp_ctx;
+    char **groups;
+    size_t num_groups;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    if (num_missing_sids != 0) {
+        ret = sdap_ad_tokengroups_get_posix_members(tmp_ctx, user_dom,
+                                                    num_missing_sids,
+                                                    missing_sids,
+                                                    NULL, NULL,
+                                                    &num_groups,
+                                                    &groups);
+        if (ret != EOK){
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "sdap_ad_tokengroups_get_posix_members failed [%d]: %s\n",
+                  ret, strerror(ret));
+            goto done;
+        }
+
+        /* the array of the caller is left untouched */
+        cached_groups = talloc_memdup(tmp_ctx, cached_groups,
+                                      (num_cached_groups + 1) * sizeof(char *));
+        if (cached_groups == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        cached_groups = concatenate_string_array(tmp_ctx,
+                                                 cached_groups,
+                                                 num_cached_groups,
+                                                 groups,
+                                                 num_groups);
+        if (cached_groups == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    /* update membership of existing groups */
+    ret = sdap_ad_tokengroups_update_members(username,
+                                             user_dom->sysdb,
+                                             user_dom,
+                                             cached_groups);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Membership update failed [%d]: %s\n",
+                                     ret, strerror(ret));
+        goto done;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Group SIDs from the PAC which are resolved after the initgroups request
+ * already finished. */
+struct ad_handle_pac_bg_ctx {
+    struct sdap_id_ctx *id_ctx;
+    char *username;
+    struct sss_domain_info *user_dom;
+    size_t num_missing_sids;
+    char **missing_sids;
+    size_t num_cached_groups;
+    char **cached_groups;
+};
+
+/* The memberships stored so far lack the groups which are not resolved.
+ * Expire the initgroups data of the user, so that the next initgroups
+ * request does not return them from the cache but looks them up again. */
+static errno_t ad_handle_pac_expire_initgr(struct sss_domain_info *user_dom,
+                                           const char *username)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(NULL);
+    if (attrs == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_INITGR_EXPIRE, 1);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not set up attrs\n");
+        goto done;
+    }
+
+    ret = sysdb_set_user_attr(user_dom, username, attrs, SYSDB_MOD_REP);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to expire initgroups data of [%s] [%d]: %s\n",
+              username, ret, sss_strerror(ret));
+        goto done;
+    }
+
+done:
+    talloc_free(attrs);
+    return ret;
+}
+
+static int ad_handle_pac_bg_ctx_destructor(struct ad_handle_pac_bg_ctx *bg)
+{
+    bg->id_ctx->pac_bg_lookups--;
+    return 0;
+}
+
+static void ad_handle_pac_initgr_bg_done(struct tevent_req *subreq);
+
+static errno_t
+ad_handle_pac_initgr_resolve_in_bg(struct ad_handle_pac_initgr_state *state,
+                                   struct tevent_context *ev,
+                                   struct sdap_id_ctx *id_ctx,
+                                   struct sdap_id_conn_ctx *conn)
+{
+    struct ad_handle_pac_bg_ctx *bg;
+    struct tevent_req *subreq;
+
+    /* Each lookup holds an LDAP connection, a burst of logins must not start
+     * an unbounded number of them. */
+    if (id_ctx->pac_bg_lookups >= AD_PAC_BG_LOOKUPS_MAX) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Too many background lookups running, "
+              "missing groups of [%s] will be looked up by the next "
+              "initgroups request.\n", state->username);
+        return ad_handle_pac_expire_initgr(state->user_dom, state->username);
+    }
+
+    bg = talloc_zero(id_ctx, struct ad_handle_pac_bg_ctx);
+    if (bg == NULL) {
+        ad_handle_pac_expire_initgr(state->user_dom, state->username);
+        return ENOMEM;
+    }
+
+    bg->id_ctx = id_ctx;
+    bg->username = talloc_steal(bg, state->username);
+    bg->user_dom = state->user_dom;
+    bg->num_missing_sids = state->num_missing_sids;
+    bg->missing_sids = talloc_steal(bg, state->missing_sids);
+    bg->num_cached_groups = state->num_cached_groups;
+    bg->cached_groups = talloc_steal(bg, state->cached_groups);
+
+    id_ctx->pac_bg_lookups++;
+    talloc_set_destructor(bg, ad_handle_pac_bg_ctx_destructor);
+
+    subreq = sdap_ad_resolve_sids_send(bg, ev, id_ctx, conn, id_ctx->opts,
+                                       bg->user_dom, bg->missing_sids);
+    if (subreq == NULL) {
+        ad_handle_pac_expire_initgr(bg->user_dom, bg->username);
+        talloc_free(bg);
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, ad_handle_pac_initgr_bg_done, bg);
+
+    return EOK;
+}
+
+static void ad_handle_pac_initgr_bg_done(struct tevent_req *subreq)
+{
+    struct ad_handle_pac_bg_ctx *bg;
+    errno_t ret;
+
+    bg = tevent_req_callback_data(subreq, struct ad_handle_pac_bg_ctx);
+
+    ret = sdap_ad_resolve_sids_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to resolve missing SIDs of [%s] "
+                                    "[%d]: %s\n", bg->username,
+                                    ret, strerror(ret));
+        goto done;
+    }
+
+    ret = ad_handle_pac_update_members(bg, bg->username, bg->user_dom,
+                                       bg->num_missing_sids, bg->missing_sids,
+                                       bg->num_cached_groups,
+                                       bg->cached_groups);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Missing groups of [%s] were resolved.\n",
+          bg->username);
+
+done:
+    if (ret != EOK) {
+        ad_handle_pac_expire_initgr(bg->user_dom, bg->username);
+    }
+    talloc_free(bg);
+}
+
 struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
                                              struct be_ctx *be_ctx,
                                              struct dp_id_data *ar,
@@ -541,6 +744,40 @@ struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
             goto done;
         }
 
+        if (state->num_missing_sids == 0) {
+            /* every group is known, no LDAP lookup is needed */
+            ret = ad_handle_pac_update_members(state, state->username,
+                                               state->user_dom, 0, NULL,
+                                               state->num_cached_groups,
+                                               state->cached_groups);
+            goto done;
+        }
+
+        if (state->num_cached_groups != 0) {
+            /* Store the memberships of the known groups right away and
+             * resolve only the missing groups after the request finished,
+             * so that the login does not wait for LDAP. If no group is known
+             * yet (e.g. first login) the lookup is done before returning. */
+            ret = ad_handle_pac_update_members(state, state->username,
+                                               state->user_dom, 0, NULL,
+                                               state->num_cached_groups,
+                                               state->cached_groups);
+            if (ret != EOK) {
+                goto done;
+            }
+
+            ret = ad_handle_pac_initgr_resolve_in_bg(state, be_ctx->ev,
+                                                     id_ctx, conn);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE, "Unable to resolve missing "
+                      "groups in the background [%d]: %s\n",
+                      ret, sss_strerror(ret));
+            }
+
+            ret = EOK;
+            goto done;
+        }
+
         /* download missing SIDs */
         subreq = sdap_ad_resolve_sids_send(state, be_ctx->ev, id_ctx,
                                            conn,
@@ -575,8 +812,6 @@ static void ad_handle_pac_initgr_lookup_sids_done(struct tevent_req *subreq)
     struct ad_handle_pac_initgr_state *state;
     struct tevent_req *req = NULL;
     errno_t ret;
-    char **cached_groups;
-    size_t num_cached_groups;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_handle_pac_initgr_state);
@@ -589,37 +824,13 @@ static void ad_handle_pac_initgr_lookup_sids_done(struct tevent_req *subreq)
         goto done;
     }
 
-    ret = sdap_ad_tokengroups_get_posix_members(state, state->user_dom,
-                                                state->num_missing_sids,
-                                                state->missing_sids,
-                                                NULL, NULL,
-                                                &num_cached_groups,
-                                                &cached_groups);
-    if (ret != EOK){
-        DEBUG(SSSDBG_MINOR_FAILURE,
-              "sdap_ad_tokengroups_get_posix_members failed [%d]: %s\n",
-              ret, strerror(ret));
-        goto done;
-    }
-
-    state->cached_groups = concatenate_string_array(state,
-                                                    state->cached_groups,
-                                                    state->num_cached_groups,
-                                                    cached_groups,
-                                                    num_cached_groups);
-    if (state->cached_groups == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    /* update membership of existing groups */
-    ret = sdap_ad_tokengroups_update_members(state->username,
-                                             state->user_dom->sysdb,
-                                             state->user_dom,
-                                             state->cached_groups);
+    ret = ad_handle_pac_update_members(state, state->username,
+                                       state->user_dom,
+                                       state->num_missing_sids,
+                                       state->missing_sids,
+                                       state->num_cached_groups,
+                                       state->cached_groups);
     if (ret != EOK) {
-        DEBUG(SSSDBG_MINOR_FAILURE, "Membership update failed [%d]: %s\n",
-                                     ret, strerror(ret));
         goto done;
     }
 
@@ -40,6 +40,10 @@
 #include "util/util.h"
 #include "providers/ldap/ldap_common.h"
 
+/* Upper limit of PAC group lookups running in the background at the same
+ * time, see ad_handle_pac_initgr_send() */
+#define AD_PAC_BG_LOOKUPS_MAX 10
+
 errno_t check_if_pac_is_available(TALLOC_CTX *mem_ctx,
                                   struct sss_domain_info *dom,
                                   struct dp_id_data *ar,
@@ -34,6 +34,7 @@
 #include "providers/fail_over_srv.h"
 #include "providers/ldap/sdap.h"
 #include "providers/ldap/sdap_async.h"
+#include "db/sysdb.h"
 
 #define AD_SITE_DOMAIN_FMT "%s._sites.%s"
 
@@ -230,118 +231,90 @@ static int ad_get_dc_servers_recv(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
-struct ad_get_client_site_state {
+/* Number of domain controllers that are pinged at the same time. */
+#define AD_CLDAP_PING_PARALLEL 5
+
+#define AD_DC_LATENCY_UNKNOWN UINT32_MAX
+#define AD_DC_LATENCY_UNREACHABLE (UINT32_MAX - 1)
+
+/* The result of the last site discovery is stored as a custom sysdb object
+ * named after the discovery domain. */
+#define AD_SITE_SUBTREE "ad_site"
+#define AD_SITE_ATTR_SITE "adSite"
+#define AD_SITE_ATTR_FOREST "adForest"
+#define AD_SITE_ATTR_DC_LATENCY "adDcLatency"
+#define AD_SITE_MAX_AGE (7 * 24 * 60 * 60)
+
+struct ad_dc_latency {
+    const char *host;
+    uint32_t msecs;
+};
+
+struct ad_cldap_ping_state {
     struct tevent_context *ev;
-    struct be_resolv_ctx *be_res;
-    enum host_database *host_db;
     struct sdap_options *opts;
     const char *ad_domain;
-    struct fo_server_info *dcs;
-    size_t num_dcs;
-    size_t dc_index;
-    struct fo_server_info dc;
+    const char *host;
+    int port;
+    struct timeval start;
 
     struct sdap_handle *sh;
     char *site;
     char *forest;
+    uint32_t msecs;
 };
 
-static errno_t ad_get_client_site_next_dc(struct tevent_req *req);
-static void ad_get_client_site_connect_done(struct tevent_req *subreq);
-static void ad_get_client_site_done(struct tevent_req *subreq);
+static void ad_cldap_ping_connect_done(struct tevent_req *subreq);
+static void ad_cldap_ping_done(struct tevent_req *subreq);
 
-struct tevent_req *ad_get_client_site_send(TALLOC_CTX *mem_ctx,
-                                           struct tevent_context *ev,
-                                           struct be_resolv_ctx *be_res,
-                                           enum host_database *host_db,
-                                           struct sdap_options *opts,
-                                           const char *ad_domain,
-                                           struct fo_server_info *dcs,
-                                           size_t num_dcs)
+static struct tevent_req *ad_cldap_ping_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct be_resolv_ctx *be_res,
+                                             enum host_database *host_db,
+                                             struct sdap_options *opts,
+                                             const char *ad_domain,
+                                             struct fo_server_info *dc)
 {
-    struct ad_get_client_site_state *state = NULL;
+    struct ad_cldap_ping_state *state = NULL;
     struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
     errno_t ret;
 
-    req = tevent_req_create(mem_ctx, &state,
-                            struct ad_get_client_site_state);
+    req = tevent_req_create(mem_ctx, &state, struct ad_cldap_ping_state);
     if (req == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
         return NULL;
     }
 
-    if (be_res == NULL || host_db == NULL || opts == NULL) {
-        ret = EINVAL;
-        goto immediately;
-    }
-
     state->ev = ev;
-    state->be_res = be_res;
-    state->host_db = host_db;
     state->opts = opts;
     state->ad_domain = ad_domain;
-    state->dcs = dcs;
-    state->num_dcs = num_dcs;
+    state->host = dc->host;
+    state->port = dc->port;
+    state->start = tevent_timeval_current();
 
-    state->dc_index = 0;
-    ret = ad_get_client_site_next_dc(req);
-    if (ret == EOK) {
-        ret = ENOENT;
-        goto immediately;
-    } else if (ret != EAGAIN) {
+    subreq = sdap_connect_host_send(state, ev, opts, be_res->resolv,
+                                    be_res->family_order, host_db, "ldap",
+                                    dc->host, dc->port, false);
+    if (subreq == NULL) {
+        ret = ENOMEM;
         goto immediately;
     }
 
+    tevent_req_set_callback(subreq, ad_cldap_ping_connect_done, req);
+
     return req;
 
 immediately:
-    if (ret == EOK) {
-        tevent_req_done(req);
-    } else {
-        tevent_req_error(req, ret);
-    }
+    tevent_req_error(req, ret);
     tevent_req_post(req, ev);
 
     return req;
 }
 
-static errno_t ad_get_client_site_next_dc(struct tevent_req *req)
+static void ad_cldap_ping_connect_done(struct tevent_req *subreq)
 {
-    struct ad_get_client_site_state *state = NULL;
-    struct tevent_req *subreq = NULL;
-    errno_t ret;
-
-    state = tevent_req_data(req, struct ad_get_client_site_state);
-
-    if (state->dc_index >= state->num_dcs) {
-        ret = EOK;
-        goto done;
-    }
-
-    state->dc = state->dcs[state->dc_index];
-
-    subreq = sdap_connect_host_send(state, state->ev, state->opts,
-                                    state->be_res->resolv,
-                                    state->be_res->family_order,
-                                    state->host_db, "ldap", state->dc.host,
-                                    state->dc.port, false);
-    if (subreq == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    tevent_req_set_callback(subreq, ad_get_client_site_connect_done, req);
-
-    state->dc_index++;
-    ret = EAGAIN;
-
-done:
-    return ret;
-}
-
-static void ad_get_client_site_connect_done(struct tevent_req *subreq)
-{
-    struct ad_get_client_site_state *state = NULL;
+    struct ad_cldap_ping_state *state = NULL;
     struct tevent_req *req = NULL;
     static const char *attrs[] = {AD_AT_NETLOGON, NULL};
     char *filter = NULL;
@@ -349,19 +322,13 @@ static void ad_get_client_site_connect_done(struct tevent_req *subreq)
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
-    state = tevent_req_data(req, struct ad_get_client_site_state);
+    state = tevent_req_data(req, struct ad_cldap_ping_state);
 
     ret = sdap_connect_host_recv(state, subreq, &state->sh);
     talloc_zfree(subreq);
     if (ret != EOK) {
         DEBUG(SSSDBG_MINOR_FAILURE, "Unable to connect to domain controller "
-              "[%s:%d]\n", state->dc.host, state->dc.port);
-
-        ret = ad_get_client_site_next_dc(req);
-        if (ret == EOK) {
-            ret = ENOENT;
-        }
-
+              "[%s:%d]\n", state->host, state->port);
         goto done;
     }
 
@@ -391,7 +358,7 @@ static void ad_get_client_site_connect_done(struct tevent_req *subreq)
         goto done;
     }
 
-    tevent_req_set_callback(subreq, ad_get_client_site_done, req);
+    tevent_req_set_callback(subreq, ad_cldap_ping_done, req);
 
     ret = EAGAIN;
 
@@ -405,16 +372,18 @@ done:
     return;
 }
 
-static void ad_get_client_site_done(struct tevent_req *subreq)
+static void ad_cldap_ping_done(struct tevent_req *subreq)
 {
-    struct ad_get_client_site_state *state = NULL;
+    struct ad_cldap_ping_state *state = NULL;
     struct tevent_req *req = NULL;
     struct sysdb_attrs **reply = NULL;
+    struct timeval elapsed;
+    struct timeval now;
     size_t reply_count;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
-    state = tevent_req_data(req, struct ad_get_client_site_state);
+    state = tevent_req_data(req, struct ad_cldap_ping_state);
 
     ret = sdap_get_generic_recv(subreq, state, &reply_count, &reply);
     talloc_zfree(subreq);
@@ -422,17 +391,14 @@ static void ad_get_client_site_done(struct tevent_req *subreq)
     /* we're done with this LDAP, close connection */
     talloc_zfree(state->sh);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Unable to get netlogon information\n");
-
-        ret = ad_get_client_site_next_dc(req);
-        if (ret == EOK) {
-            ret = ENOENT;
-        }
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to get netlogon information from "
+              "[%s:%d]\n", state->host, state->port);
         goto done;
     }
 
     if (reply_count == 0) {
-        DEBUG(SSSDBG_OP_FAILURE, "No netlogon information retrieved\n");
+        DEBUG(SSSDBG_OP_FAILURE, "No netlogon information retrieved from "
+              "[%s:%d]\n", state->host, state->port);
         ret = ENOENT;
         goto done;
     }
@@ -446,8 +412,9 @@ static void ad_get_client_site_done(struct tevent_req *subreq)
         goto done;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "Found site: %s\n", state->site);
-    DEBUG(SSSDBG_TRACE_FUNC, "Found forest: %s\n", state->forest);
+    now = tevent_timeval_current();
+    elapsed = tevent_timeval_until(&state->start, &now);
+    state->msecs = elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000;
 
 done:
     if (ret != EOK) {
@@ -458,10 +425,222 @@ done:
     tevent_req_done(req);
 }
 
-int ad_get_client_site_recv(TALLOC_CTX *mem_ctx,
-                            struct tevent_req *req,
-                            const char **_site,
-                            const char **_forest)
+static errno_t ad_cldap_ping_recv(TALLOC_CTX *mem_ctx,
+                                  struct tevent_req *req,
+                                  char **_site,
+                                  char **_forest,
+                                  uint32_t *_msecs)
+{
+    struct ad_cldap_ping_state *state = NULL;
+    state = tevent_req_data(req, struct ad_cldap_ping_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_site = talloc_steal(mem_ctx, state->site);
+    *_forest = talloc_steal(mem_ctx, state->forest);
+    *_msecs = state->msecs;
+
+    return EOK;
+}
+
+struct ad_get_client_site_state {
+    struct tevent_context *ev;
+    struct be_resolv_ctx *be_res;
+    enum host_database *host_db;
+    struct sdap_options *opts;
+    const char *ad_domain;
+    struct fo_server_info *dcs;
+    size_t num_dcs;
+    size_t dc_index;
+    struct tevent_req **pings;
+    size_t num_pending;
+    struct ad_dc_latency *latency;
+
+    char *site;
+    char *forest;
+};
+
+static errno_t ad_get_client_site_next_dc(struct tevent_req *req);
+static void ad_get_client_site_done(struct tevent_req *subreq);
+
+/* Pings the domain controllers in the given order, up to
+ * AD_CLDAP_PING_PARALLEL of them at a time, and uses the first valid
+ * netlogon reply. */
+static struct tevent_req *
+ad_get_client_site_send(TALLOC_CTX *mem_ctx,
+                        struct tevent_context *ev,
+                        struct be_resolv_ctx *be_res,
+                        enum host_database *host_db,
+                        struct sdap_options *opts,
+                        const char *ad_domain,
+                        struct fo_server_info *dcs,
+                        size_t num_dcs)
+{
+    struct ad_get_client_site_state *state = NULL;
+    struct tevent_req *req = NULL;
+    size_t i;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct ad_get_client_site_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    if (be_res == NULL || host_db == NULL || opts == NULL) {
+        ret = EINVAL;
+        goto immediately;
+    }
+
+    if (num_dcs == 0) {
+        ret = ENOENT;
+        goto immediately;
+    }
+
+    state->ev = ev;
+    state->be_res = be_res;
+    state->host_db = host_db;
+    state->opts = opts;
+    state->ad_domain = ad_domain;
+    state->dcs = dcs;
+    state->num_dcs = num_dcs;
+
+    state->pings = talloc_zero_array(state, struct tevent_req *, num_dcs);
+    state->latency = talloc_zero_array(state, struct ad_dc_latency, num_dcs);
+    if (state->pings == NULL || state->latency == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    for (i = 0; i < num_dcs; i++) {
+        state->latency[i].host = dcs[i].host;
+        state->latency[i].msecs = AD_DC_LATENCY_UNKNOWN;
+    }
+
+    state->dc_index = 0;
+    ret = ad_get_client_site_next_dc(req);
+    if (ret == EOK) {
+        ret = ENOENT;
+        goto immediately;
+    } else if (ret != EAGAIN) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+/* Returns EAGAIN while there are pings in progress and EOK when all
+ * domain controllers were tried. */
+static errno_t ad_get_client_site_next_dc(struct tevent_req *req)
+{
+    struct ad_get_client_site_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct ad_get_client_site_state);
+
+    while (state->num_pending < AD_CLDAP_PING_PARALLEL
+            && state->dc_index < state->num_dcs) {
+        subreq = ad_cldap_ping_send(state, state->ev, state->be_res,
+                                    state->host_db, state->opts,
+                                    state->ad_domain,
+                                    &state->dcs[state->dc_index]);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+
+        tevent_req_set_callback(subreq, ad_get_client_site_done, req);
+
+        state->pings[state->dc_index] = subreq;
+        state->dc_index++;
+        state->num_pending++;
+    }
+
+    return state->num_pending > 0 ? EAGAIN : EOK;
+}
+
+static void ad_get_client_site_done(struct tevent_req *subreq)
+{
+    struct ad_get_client_site_state *state = NULL;
+    struct tevent_req *req = NULL;
+    uint32_t msecs;
+    size_t i;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct ad_get_client_site_state);
+
+    for (i = 0; i < state->dc_index; i++) {
+        if (state->pings[i] == subreq) {
+            break;
+        }
+    }
+
+    if (i == state->dc_index) {
+        /* should never happen */
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unknown CLDAP ping finished\n");
+        talloc_zfree(subreq);
+        ret = EINVAL;
+        goto done;
+    }
+
+    state->pings[i] = NULL;
+    state->num_pending--;
+
+    ret = ad_cldap_ping_recv(state, subreq, &state->site, &state->forest,
+                             &msecs);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        state->latency[i].msecs = AD_DC_LATENCY_UNREACHABLE;
+
+        ret = ad_get_client_site_next_dc(req);
+        if (ret == EOK) {
+            ret = ENOENT;
+        }
+        goto done;
+    }
+
+    state->latency[i].msecs = msecs;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Domain controller [%s:%d] replied in %"PRIu32
+          " ms\n", state->dcs[i].host, state->dcs[i].port, msecs);
+    DEBUG(SSSDBG_TRACE_FUNC, "Found site: %s\n", state->site);
+    DEBUG(SSSDBG_TRACE_FUNC, "Found forest: %s\n", state->forest);
+
+    /* We have the answer, cancel the remaining pings. */
+    for (i = 0; i < state->dc_index; i++) {
+        talloc_zfree(state->pings[i]);
+    }
+    state->num_pending = 0;
+
+    ret = EOK;
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+
+    return;
+}
+
+static int ad_get_client_site_recv(TALLOC_CTX *mem_ctx,
+                                   struct tevent_req *req,
+                                   const char **_site,
+                                   const char **_forest,
+                                   struct ad_dc_latency **_latency,
+                                   size_t *_num_latency)
 {
     struct ad_get_client_site_state *state = NULL;
     state = tevent_req_data(req, struct ad_get_client_site_state);
@@ -470,22 +649,31 @@ int ad_get_client_site_recv(TALLOC_CTX *mem_ctx,
 
     *_site = talloc_steal(mem_ctx, state->site);
     *_forest = talloc_steal(mem_ctx, state->forest);
+    *_latency = talloc_steal(mem_ctx, state->latency);
+    *_num_latency = state->num_dcs;
 
     return EOK;
 }
 
 struct ad_srv_plugin_ctx {
     struct be_resolv_ctx *be_res;
+    struct sss_domain_info *dom;
     enum host_database *host_dbs;
     struct sdap_options *opts;
     const char *hostname;
     const char *ad_domain;
     const char *ad_site_override;
+
+    /* the persisted site was already used after start */
+    bool site_loaded;
+    struct ad_dc_latency *latency;
+    size_t num_latency;
 };
 
 struct ad_srv_plugin_ctx *
 ad_srv_plugin_ctx_init(TALLOC_CTX *mem_ctx,
                        struct be_resolv_ctx *be_res,
+                       struct sss_domain_info *dom,
                        enum host_database *host_dbs,
                        struct sdap_options *opts,
                        const char *hostname,
@@ -500,6 +688,7 @@ ad_srv_plugin_ctx_init(TALLOC_CTX *mem_ctx,
     }
 
     ctx->be_res = be_res;
+    ctx->dom = dom;
     ctx->host_dbs = host_dbs;
     ctx->opts = opts;
 
@@ -527,6 +716,316 @@ fail:
     return NULL;
 }
 
+static uint32_t ad_srv_dc_latency(struct ad_srv_plugin_ctx *ctx,
+                                  const char *host)
+{
+    size_t i;
+
+    for (i = 0; i < ctx->num_latency; i++) {
+        if (strcasecmp(ctx->latency[i].host, host) == 0) {
+            return ctx->latency[i].msecs;
+        }
+    }
+
+    return AD_DC_LATENCY_UNKNOWN;
+}
+
+struct ad_dc_rank {
+    size_t index;
+    int class;
+    uint32_t msecs;
+};
+
+static int ad_dc_rank_cmp(const void *a, const void *b)
+{
+    const struct ad_dc_rank *ra = a;
+    const struct ad_dc_rank *rb = b;
+
+    if (ra->class != rb->class) {
+        return ra->class < rb->class ? -1 : 1;
+    }
+
+    if (ra->msecs != rb->msecs) {
+        return ra->msecs < rb->msecs ? -1 : 1;
+    }
+
+    /* keep DNS order otherwise */
+    return ra->index < rb->index ? -1 : 1;
+}
+
+/* Domain controllers that replied before are pinged first, fastest first,
+ * then the ones we know nothing about, in DNS order, and the ones that
+ * did not reply last time at the end. */
+static void ad_srv_rank_dcs(struct ad_srv_plugin_ctx *ctx,
+                            struct fo_server_info *dcs,
+                            size_t num_dcs)
+{
+    struct fo_server_info sorted[num_dcs];
+    struct ad_dc_rank rank[num_dcs];
+    size_t i;
+
+    if (ctx->num_latency == 0 || num_dcs <= 1) {
+        return;
+    }
+
+    for (i = 0; i < num_dcs; i++) {
+        rank[i].index = i;
+        rank[i].msecs = ad_srv_dc_latency(ctx, dcs[i].host);
+        switch (rank[i].msecs) {
+        case AD_DC_LATENCY_UNKNOWN:
+            rank[i].class = 1;
+            break;
+        case AD_DC_LATENCY_UNREACHABLE:
+            rank[i].class = 2;
+            break;
+        default:
+            rank[i].class = 0;
+            break;
+        }
+    }
+
+    qsort(rank, num_dcs, sizeof(struct ad_dc_rank), ad_dc_rank_cmp);
+
+    for (i = 0; i < num_dcs; i++) {
+        sorted[i] = dcs[rank[i].index];
+    }
+
+    memcpy(dcs, sorted, sizeof(struct fo_server_info) * num_dcs);
+}
+
+/* Remembers the latencies of the domain controllers that are currently
+ * published in DNS. */
+static errno_t ad_srv_update_latency(struct ad_srv_plugin_ctx *ctx,
+                                     struct ad_dc_latency *latency,
+                                     size_t num_latency)
+{
+    struct ad_dc_latency *merged;
+    size_t num_merged = 0;
+    uint32_t msecs;
+    size_t i;
+
+    merged = talloc_zero_array(ctx, struct ad_dc_latency, num_latency);
+    if (merged == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_latency; i++) {
+        msecs = latency[i].msecs;
+        if (msecs == AD_DC_LATENCY_UNKNOWN) {
+            msecs = ad_srv_dc_latency(ctx, latency[i].host);
+            if (msecs == AD_DC_LATENCY_UNKNOWN) {
+                continue;
+            }
+        }
+
+        merged[num_merged].host = talloc_strdup(merged, latency[i].host);
+        if (merged[num_merged].host == NULL) {
+            talloc_free(merged);
+            return ENOMEM;
+        }
+        merged[num_merged].msecs = msecs;
+        num_merged++;
+    }
+
+    talloc_free(ctx->latency);
+    ctx->latency = merged;
+    ctx->num_latency = num_merged;
+
+    return EOK;
+}
+
+static errno_t ad_srv_parse_latency(struct ad_srv_plugin_ctx *ctx,
+                                    struct ldb_message_element *el)
+{
+    struct ad_dc_latency *latency;
+    size_t num_latency = 0;
+    const char *value;
+    char *endptr;
+    uint32_t msecs;
+    unsigned int i;
+
+    talloc_zfree(ctx->latency);
+    ctx->num_latency = 0;
+
+    if (el == NULL || el->num_values == 0) {
+        return EOK;
+    }
+
+    latency = talloc_zero_array(ctx, struct ad_dc_latency, el->num_values);
+    if (latency == NULL) {
+        return ENOMEM;
+    }
+
+    /* values are stored as "msecs host" */
+    for (i = 0; i < el->num_values; i++) {
+        value = (const char *)el->values[i].data;
+
+        errno = 0;
+        msecs = strtouint32(value, &endptr, 10);
+        if (errno != 0 || *endptr != ' ' || endptr[1] == '\0') {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Ignoring malformed latency [%s]\n",
+                  value);
+            continue;
+        }
+
+        latency[num_latency].host = talloc_strdup(latency, endptr + 1);
+        if (latency[num_latency].host == NULL) {
+            talloc_free(latency);
+            return ENOMEM;
+        }
+        latency[num_latency].msecs = msecs;
+        num_latency++;
+    }
+
+    ctx->latency = latency;
+    ctx->num_latency = num_latency;
+
+    return EOK;
+}
+
+/* Loads the result of the last site discovery. Returns ENOENT if there is
+ * none or if it is too old to be trusted. */
+static errno_t ad_srv_load_site(TALLOC_CTX *mem_ctx,
+                                struct ad_srv_plugin_ctx *ctx,
+                                const char *discovery_domain,
+                                const char **_site,
+                                const char **_forest)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { AD_SITE_ATTR_SITE,
+                            AD_SITE_ATTR_FOREST,
+                            AD_SITE_ATTR_DC_LATENCY,
+                            SYSDB_LAST_UPDATE,
+                            NULL };
+    struct ldb_message **msgs;
+    const char *site;
+    const char *forest;
+    uint64_t last_update;
+    size_t count;
+    errno_t ret;
+
+    if (ctx->dom == NULL) {
+        return ENOENT;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_search_custom_by_name(tmp_ctx, ctx->dom, discovery_domain,
+                                      AD_SITE_SUBTREE, attrs, &count, &msgs);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (count != 1) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = ad_srv_parse_latency(ctx, ldb_msg_find_element(msgs[0],
+                                                AD_SITE_ATTR_DC_LATENCY));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    site = ldb_msg_find_attr_as_string(msgs[0], AD_SITE_ATTR_SITE, NULL);
+    forest = ldb_msg_find_attr_as_string(msgs[0], AD_SITE_ATTR_FOREST, NULL);
+    last_update = ldb_msg_find_attr_as_uint64(msgs[0], SYSDB_LAST_UPDATE, 0);
+    if (site == NULL
+            || (time_t)last_update + AD_SITE_MAX_AGE < time(NULL)) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    *_site = talloc_strdup(mem_ctx, site);
+    if (*_site == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    *_forest = NULL;
+    if (forest != NULL) {
+        *_forest = talloc_strdup(mem_ctx, forest);
+        if (*_forest == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t ad_srv_store_site(struct ad_srv_plugin_ctx *ctx,
+                                 const char *discovery_domain,
+                                 const char *site,
+                                 const char *forest)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    char *value;
+    size_t i;
+    errno_t ret;
+
+    if (ctx->dom == NULL || site == NULL) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    attrs = sysdb_new_attrs(tmp_ctx);
+    if (attrs == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_attrs_add_string(attrs, AD_SITE_ATTR_SITE, site);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (forest != NULL) {
+        ret = sysdb_attrs_add_string(attrs, AD_SITE_ATTR_FOREST, forest);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    for (i = 0; i < ctx->num_latency; i++) {
+        value = talloc_asprintf(attrs, "%"PRIu32" %s",
+                                ctx->latency[i].msecs, ctx->latency[i].host);
+        if (value == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sysdb_attrs_add_string(attrs, AD_SITE_ATTR_DC_LATENCY, value);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_LAST_UPDATE, time(NULL));
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_store_custom(ctx->dom, discovery_domain, AD_SITE_SUBTREE,
+                             attrs);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 struct ad_srv_plugin_state {
     struct tevent_context *ev;
     struct ad_srv_plugin_ctx *ctx;
@@ -546,17 +1045,21 @@ struct ad_srv_plugin_state {
 
 static void ad_srv_plugin_dcs_done(struct tevent_req *subreq);
 static void ad_srv_plugin_site_done(struct tevent_req *subreq);
+static errno_t ad_srv_plugin_discover_servers(struct tevent_req *req);
 static void ad_srv_plugin_servers_done(struct tevent_req *subreq);
 
 /* 1. Do a DNS lookup to find any DC in domain
  *    _ldap._tcp.domain.name
- * 2. Send a CLDAP ping to the found DC to get the desirable site
+ * 2. Send a CLDAP ping to the found DCs to get the desirable site
  * 3. Do a DNS lookup to find SRV in the site (a)
  *    _service._protocol.site-name._sites.domain.name
  * 4. Do a DNS lookup to find global SRV records (b)
  *    _service._protocol.domain.name
  * 5. If the site is found, use (a) as primary and (b) as backup servers,
  *    otherwise use (b) as primary servers
+ *
+ * The first lookup after start uses the site found by the previous run
+ * instead of steps 1 and 2, if it is known.
  */
 struct tevent_req *ad_srv_plugin_send(TALLOC_CTX *mem_ctx,
                                        struct tevent_context *ev,
@@ -609,6 +1112,30 @@ struct tevent_req *ad_srv_plugin_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
+    if (!ctx->site_loaded) {
+        ctx->site_loaded = true;
+
+        ret = ad_srv_load_site(state, ctx, state->discovery_domain,
+                               &state->site, &state->forest);
+        if (ret == EOK && ctx->ad_site_override == NULL) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Using previously discovered site %s\n",
+                  state->site);
+
+            ret = ad_srv_plugin_discover_servers(req);
+            if (ret != EAGAIN) {
+                goto immediately;
+            }
+
+            return req;
+        } else if (ret != EOK && ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to load previously "
+                  "discovered site [%d]: %s\n", ret, sss_strerror(ret));
+        }
+
+        state->site = NULL;
+        state->forest = NULL;
+    }
+
     DEBUG(SSSDBG_TRACE_FUNC, "About to find domain controllers\n");
 
     subreq = ad_get_dc_servers_send(state, ev, ctx->be_res->resolv,
@@ -647,6 +1174,8 @@ static void ad_srv_plugin_dcs_done(struct tevent_req *subreq)
         goto done;
     }
 
+    ad_srv_rank_dcs(state->ctx, dcs, num_dcs);
+
     DEBUG(SSSDBG_TRACE_FUNC, "About to locate suitable site\n");
 
     subreq = ad_get_client_site_send(state, state->ev,
@@ -678,15 +1207,30 @@ static void ad_srv_plugin_site_done(struct tevent_req *subreq)
 {
     struct ad_srv_plugin_state *state = NULL;
     struct tevent_req *req = NULL;
-    const char *primary_domain = NULL;
-    const char *backup_domain = NULL;
+    struct ad_dc_latency *latency = NULL;
+    size_t num_latency = 0;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_srv_plugin_state);
 
-    ret = ad_get_client_site_recv(state, subreq, &state->site, &state->forest);
+    ret = ad_get_client_site_recv(state, subreq, &state->site, &state->forest,
+                                  &latency, &num_latency);
     talloc_zfree(subreq);
+    if (ret == EOK) {
+        ret = ad_srv_update_latency(state->ctx, latency, num_latency);
+        if (ret == EOK) {
+            ret = ad_srv_store_site(state->ctx, state->discovery_domain,
+                                    state->site, state->forest);
+        }
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to store discovered site "
+                  "[%d]: %s\n", ret, sss_strerror(ret));
+            /* continue */
+        }
+        ret = EOK;
+    }
+
     /* Ignore AD site found by dns discovery if specific site is set in
      * configuration file. */
     if (state->ctx->ad_site_override != NULL) {
@@ -705,42 +1249,61 @@ static void ad_srv_plugin_site_done(struct tevent_req *subreq)
         ret = EOK;
     }
 
+    if (ret != ENOENT && ret != EOK) {
+        goto done;
+    }
+
+    ret = ad_srv_plugin_discover_servers(req);
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+
+    return;
+}
+
+static errno_t ad_srv_plugin_discover_servers(struct tevent_req *req)
+{
+    struct ad_srv_plugin_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+    const char *primary_domain = NULL;
+    const char *backup_domain = NULL;
+
+    state = tevent_req_data(req, struct ad_srv_plugin_state);
+
     primary_domain = state->discovery_domain;
     backup_domain = NULL;
 
-    if (ret == EOK) {
-        if (strcmp(state->service, "gc") == 0) {
-            if (state->forest != NULL) {
-                if (state->site != NULL) {
-                    primary_domain = talloc_asprintf(state, AD_SITE_DOMAIN_FMT,
-                                                     state->site,
-                                                     state->forest);
-                    if (primary_domain == NULL) {
-                        ret = ENOMEM;
-                        goto done;
-                    }
-
-                    backup_domain = state->forest;
-                } else {
-                    primary_domain = state->forest;
-                    backup_domain = NULL;
-                }
-            }
-        } else {
+    if (strcmp(state->service, "gc") == 0) {
+        if (state->forest != NULL) {
             if (state->site != NULL) {
                 primary_domain = talloc_asprintf(state, AD_SITE_DOMAIN_FMT,
                                                  state->site,
-                                                 state->discovery_domain);
+                                                 state->forest);
                 if (primary_domain == NULL) {
-                    ret = ENOMEM;
-                    goto done;
+                    return ENOMEM;
                 }
 
-                backup_domain = state->discovery_domain;
+                backup_domain = state->forest;
+            } else {
+                primary_domain = state->forest;
+                backup_domain = NULL;
             }
         }
-    } else if (ret != ENOENT && ret != EOK) {
-        goto done;
+    } else {
+        if (state->site != NULL) {
+            primary_domain = talloc_asprintf(state, AD_SITE_DOMAIN_FMT,
+                                             state->site,
+                                             state->discovery_domain);
+            if (primary_domain == NULL) {
+                return ENOMEM;
+            }
+
+            backup_domain = state->discovery_domain;
+        }
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "About to discover primary and "
@@ -751,22 +1314,12 @@ static void ad_srv_plugin_site_done(struct tevent_req *subreq)
                                       state->service, state->protocol,
                                       primary_domain, backup_domain);
     if (subreq == NULL) {
-        ret = ENOMEM;
-        goto done;
+        return ENOMEM;
     }
 
     tevent_req_set_callback(subreq, ad_srv_plugin_servers_done, req);
 
-    ret = EAGAIN;
-
-done:
-    if (ret == EOK) {
-        tevent_req_done(req);
-    } else if (ret != EAGAIN) {
-        tevent_req_error(req, ret);
-    }
-
-    return;
+    return EAGAIN;
 }
 
 static void ad_srv_plugin_servers_done(struct tevent_req *subreq)
@@ -26,6 +26,7 @@ struct ad_srv_plugin_ctx;
 struct ad_srv_plugin_ctx *
 ad_srv_plugin_ctx_init(TALLOC_CTX *mem_ctx,
                        struct be_resolv_ctx *be_res,
+                       struct sss_domain_info *dom,
                        enum host_database *host_dbs,
                        struct sdap_options *opts,
                        const char *hostname,
@@ -246,6 +246,7 @@ ad_subdom_ad_ctx_new(struct be_ctx *be_ctx,
 
     /* use AD plugin */
     srv_ctx = ad_srv_plugin_ctx_init(be_ctx, be_ctx->be_res,
+                                     be_ctx->domain,
                                      default_host_dbs,
                                      ad_id_ctx->ad_options->id,
                                      hostname,
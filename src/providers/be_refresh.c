@@ -38,12 +38,14 @@ static errno_t be_refresh_get_values_ex(TALLOC_CTX *mem_ctx,
                                         char ***_values)
 {
     TALLOC_CTX *tmp_ctx = NULL;
-    const char *attrs[] = {attr, NULL};
+    const char *attrs[] = {attr, SYSDB_CACHE_EXPIRE, NULL};
     const char *filter = NULL;
     char **values = NULL;
     struct ldb_message **msgs = NULL;
     struct sysdb_attrs **records = NULL;
     size_t count;
+    size_t i;
+    size_t j;
     time_t now = time(NULL);
     errno_t ret;
 
@@ -68,6 +70,18 @@ static errno_t be_refresh_get_values_ex(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    /* The filter matched the expiration stored in the main cache. Objects
+     * handled by the timestamp cache are only rewritten there when they
+     * change, so check the merged expiration again. */
+    for (i = 0, j = 0; i < count; i++) {
+        if (ldb_msg_find_attr_as_int64(msgs[i], SYSDB_CACHE_EXPIRE, 0)
+                > (long long) now + period) {
+            continue;
+        }
+        msgs[j++] = msgs[i];
+    }
+    count = j;
+
     ret = sysdb_msg2attrs(tmp_ctx, count, msgs, &records);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -289,6 +289,7 @@ struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
     const char *request_name;
     struct tevent_req *req;
     struct dp_req *dp_req;
+    TALLOC_CTX *pool;
     errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state, struct dp_req_state);
@@ -297,7 +298,11 @@ struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    ret = file_dp_request(state, provider, dp_cli, domain, name, target,
+    /* The whole request hierarchy is allocated from the request pool,
+     * if enabled. */
+    pool = sss_req_pool_new(state, SSS_REQ_POOL_DP_REQ);
+
+    ret = file_dp_request(pool, provider, dp_cli, domain, name, target,
                           method, dp_flags, request_data, req, &dp_req);
 
     if (dp_req == NULL) {
@@ -397,6 +397,11 @@ errno_t be_process_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = sss_req_pool_init(cdb, be_ctx->conf_path);
+    if (ret != EOK) {
+        goto done;
+    }
+
     ret = be_init_failover(be_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Unable to initialize failover\n");
@@ -25,6 +25,7 @@
 #include <security/pam_modules.h>
 
 #include "util/util.h"
+#include "util/murmurhash3.h"
 #include "providers/ldap/sdap_async.h"
 #include "providers/ldap/sdap_access.h"
 #include "providers/ipa/ipa_common.h"
@@ -71,6 +72,25 @@ void hbac_debug_messages(const char *file, int line,
     }
 }
 
+/* Maximum number of cached access decisions */
+#define IPA_HBAC_DECISIONS_MAX 1024
+
+/* Compiled HBAC rules and recent access decisions based on them. The whole
+ * structure is dropped when the HBAC rules are refreshed. */
+struct ipa_hbac_cache {
+    struct hbac_ruleset *ruleset;
+    bool deny_rules;
+
+    hash_table_t *decisions;
+};
+
+struct ipa_hbac_decision {
+    time_t expire;
+    errno_t result;
+};
+
+static void ipa_hbac_cache_invalidate(struct ipa_access_ctx *access_ctx);
+
 enum hbac_result {
     HBAC_ALLOW = 1,
     HBAC_DENY,
@@ -442,6 +462,7 @@ static void ipa_fetch_hbac_rules_done(struct tevent_req *subreq)
             DEBUG(SSSDBG_CRIT_FAILURE, "Unable to remove HBAC rules\n");
             goto done;
         }
+        ipa_hbac_cache_invalidate(state->access_ctx);
 
         ret = ENOENT;
         goto done;
@@ -556,6 +577,7 @@ static errno_t ipa_save_hbac(struct sss_domain_info *domain,
     in_transaction = false;
 
     state->access_ctx->last_update = time(NULL);
+    ipa_hbac_cache_invalidate(state->access_ctx);
 
     ret = EOK;
 
@@ -570,16 +592,267 @@ done:
     return ret;
 }
 
-errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
-                                struct dp_option *ipa_options,
-                                struct pam_data *pd)
+static int ipa_hbac_cache_destructor(struct ipa_hbac_cache *cache)
+{
+    hbac_ruleset_free(cache->ruleset);
+    return 0;
+}
+
+/* Must only be called after the rules in the cache were replaced */
+static void ipa_hbac_cache_invalidate(struct ipa_access_ctx *access_ctx)
+{
+    access_ctx->hbac_generation++;
+
+    if (access_ctx->hbac_cache == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "HBAC rules were refreshed, "
+          "dropping compiled rules and cached decisions\n");
+    talloc_zfree(access_ctx->hbac_cache);
+}
+
+static errno_t ipa_hbac_cache_get(struct ipa_access_ctx *access_ctx,
+                                  struct hbac_ctx *hbac_ctx,
+                                  struct ipa_hbac_cache **_cache)
 {
     TALLOC_CTX *tmp_ctx;
-    struct hbac_ctx hbac_ctx;
+    struct ipa_hbac_cache *cache;
     struct hbac_rule **hbac_rules;
+    enum hbac_error_code code;
+    errno_t ret;
+
+    if (access_ctx->hbac_cache != NULL) {
+        *_cache = access_ctx->hbac_cache;
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    cache = talloc_zero(tmp_ctx, struct ipa_hbac_cache);
+    if (cache == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    talloc_set_destructor(cache, ipa_hbac_cache_destructor);
+
+    ret = sss_hash_create(cache, 0, &cache->decisions);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* Get HBAC rules from the sysdb */
+    ret = hbac_get_cached_rules(tmp_ctx, hbac_ctx->be_ctx->domain,
+                                &hbac_ctx->rule_count, &hbac_ctx->rules);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not retrieve rules from the cache\n");
+        goto done;
+    }
+
+    ret = hbac_ctx_to_rules(tmp_ctx, hbac_ctx, &hbac_rules, NULL);
+    if (ret == EPERM) {
+        cache->deny_rules = true;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct HBAC rules\n");
+        goto done;
+    } else {
+        hbac_enable_debug(hbac_debug_messages);
+
+        code = hbac_ruleset_compile(hbac_rules, &cache->ruleset);
+        if (code != HBAC_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not compile HBAC rules [%s]\n",
+                  hbac_error_string(code));
+            ret = code == HBAC_ERROR_OUT_OF_MEMORY ? ENOMEM : EIO;
+            goto done;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Compiled %zu HBAC rules\n", hbac_ctx->rule_count);
+
+    access_ctx->hbac_cache = talloc_steal(access_ctx, cache);
+    *_cache = cache;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* The decision also depends on the group memberships of the user which are
+ * refreshed independently of the HBAC rules. Besides the generation of the
+ * rules, the key contains a hash of the memberOf values of the user and its
+ * original modification timestamp, so a decision is not used anymore after
+ * the memberships of the user changed. Writes of other objects do not
+ * affect it. */
+static errno_t ipa_hbac_decision_key(TALLOC_CTX *mem_ctx,
+                                     struct sss_domain_info *domain,
+                                     uint64_t generation,
+                                     struct pam_data *pd,
+                                     char **_key)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_MEMBEROF, SYSDB_ORIG_MODSTAMP, NULL };
+    struct sss_domain_info *user_dom = domain;
+    struct ldb_message_element *el;
+    struct ldb_result *res;
+    const char *modstamp;
+    uint32_t hash = 0;
+    unsigned int i;
+    char *key;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    /* The same lookup as in hbac_ctx_to_eval_request() */
+    if (strcasecmp(pd->domain, domain->name) != 0) {
+        user_dom = find_domain_by_name(domain, pd->domain, true);
+        if (user_dom == NULL) {
+            ret = ENOENT;
+            goto done;
+        }
+    }
+
+    ret = sysdb_get_user_attr(tmp_ctx, user_dom, pd->user, attrs, &res);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (res->count != 1) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    el = ldb_msg_find_element(res->msgs[0], SYSDB_MEMBEROF);
+    if (el != NULL) {
+        for (i = 0; i < el->num_values; i++) {
+            hash = murmurhash3((const char *)el->values[i].data,
+                               el->values[i].length, hash);
+        }
+    }
+
+    modstamp = ldb_msg_find_attr_as_string(res->msgs[0], SYSDB_ORIG_MODSTAMP,
+                                           "");
+
+    key = talloc_asprintf(mem_ctx, "%"PRIu64":%s@%s:%s:%s:%s:%08"PRIx32,
+                          generation, pd->user, pd->domain, pd->service,
+                          pd->rhost != NULL ? pd->rhost : "",
+                          modstamp, hash);
+    if (key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    *_key = key;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static bool ipa_hbac_decision_lookup(struct ipa_hbac_cache *cache,
+                                     char *key,
+                                     errno_t *_result)
+{
+    struct ipa_hbac_decision *decision;
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+
+    if (cache->decisions == NULL) {
+        return false;
+    }
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = key;
+
+    hret = hash_lookup(cache->decisions, &hkey, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        return false;
+    }
+
+    decision = talloc_get_type(hvalue.ptr, struct ipa_hbac_decision);
+    if (decision->expire <= time(NULL)) {
+        return false;
+    }
+
+    *_result = decision->result;
+    return true;
+}
+
+static void ipa_hbac_decision_store(struct ipa_hbac_cache *cache,
+                                    char *key,
+                                    errno_t result,
+                                    int ttl)
+{
+    struct ipa_hbac_decision *decision;
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+    errno_t ret;
+
+    if (cache->decisions == NULL) {
+        return;
+    }
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = key;
+
+    hret = hash_lookup(cache->decisions, &hkey, &hvalue);
+    if (hret == HASH_SUCCESS) {
+        decision = talloc_get_type(hvalue.ptr, struct ipa_hbac_decision);
+    } else {
+        if (hash_count(cache->decisions) >= IPA_HBAC_DECISIONS_MAX) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Too many cached HBAC decisions, "
+                  "dropping them\n");
+            talloc_zfree(cache->decisions);
+            ret = sss_hash_create(cache, 0, &cache->decisions);
+            if (ret != EOK) {
+                /* Continue without caching decisions */
+                cache->decisions = NULL;
+                return;
+            }
+        }
+
+        /* Decisions are freed together with the table */
+        decision = talloc_zero(cache->decisions, struct ipa_hbac_decision);
+        if (decision == NULL) {
+            return;
+        }
+
+        hvalue.type = HASH_VALUE_PTR;
+        hvalue.ptr = decision;
+
+        hret = hash_enter(cache->decisions, &hkey, &hvalue);
+        if (hret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to cache HBAC decision\n");
+            talloc_free(decision);
+            return;
+        }
+    }
+
+    decision->expire = time(NULL) + ttl;
+    decision->result = result;
+}
+
+static errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
+                                       struct ipa_access_ctx *access_ctx,
+                                       struct pam_data *pd)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct hbac_ctx hbac_ctx;
+    struct ipa_hbac_cache *cache;
     struct hbac_eval_req *eval_req;
     enum hbac_eval_result result;
     struct hbac_info *info = NULL;
+    char *key = NULL;
+    int ttl;
     errno_t ret;
 
     tmp_ctx = talloc_new(NULL);
@@ -587,37 +860,48 @@ errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
         return ENOMEM;
     }
 
+    memset(&hbac_ctx, 0, sizeof(hbac_ctx));
     hbac_ctx.be_ctx = be_ctx;
-    hbac_ctx.ipa_options = ipa_options;
+    hbac_ctx.ipa_options = access_ctx->ipa_options;
     hbac_ctx.pd = pd;
 
-    /* Get HBAC rules from the sysdb */
-    ret = hbac_get_cached_rules(tmp_ctx, be_ctx->domain,
-                                &hbac_ctx.rule_count, &hbac_ctx.rules);
+    ret = ipa_hbac_cache_get(access_ctx, &hbac_ctx, &cache);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not retrieve rules from the cache\n");
         goto done;
     }
 
-    ret = hbac_ctx_to_rules(tmp_ctx, &hbac_ctx, &hbac_rules, &eval_req);
-    if (ret == EPERM) {
+    if (cache->deny_rules) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "DENY rules detected. Denying access to all users\n");
         ret = ERR_ACCESS_DENIED;
         goto done;
-    } else if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct HBAC rules\n");
+    }
+
+    ret = ipa_hbac_decision_key(tmp_ctx, be_ctx->domain,
+                                access_ctx->hbac_generation, pd, &key);
+    if (ret != EOK) {
+        /* Evaluate the rules without the cached decisions */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to read the memberships of "
+              "[%s] [%d]: %s\n", pd->user, ret, sss_strerror(ret));
+        key = NULL;
+    } else if (ipa_hbac_decision_lookup(cache, key, &ret)) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Using cached HBAC decision for [%s]\n", key);
+        goto done;
+    }
+
+    ret = hbac_ctx_to_eval_request(tmp_ctx, &hbac_ctx, &eval_req);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct eval request\n");
         goto done;
     }
 
     hbac_enable_debug(hbac_debug_messages);
 
-    result = hbac_evaluate(hbac_rules, eval_req, &info);
+    result = hbac_ruleset_evaluate(cache->ruleset, eval_req, &info);
     if (result == HBAC_EVAL_ALLOW) {
         DEBUG(SSSDBG_MINOR_FAILURE, "Access granted by HBAC rule [%s]\n",
               info->rule_name);
         ret = EOK;
-        goto done;
     } else if (result == HBAC_EVAL_ERROR) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Error [%s] occurred in rule [%s]\n",
               hbac_error_string(info->code), info->rule_name);
@@ -627,10 +911,16 @@ errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
         DEBUG(SSSDBG_CRIT_FAILURE, "Insufficient memory\n");
         ret = ENOMEM;
         goto done;
+    } else {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Access denied by HBAC rules\n");
+        ret = ERR_ACCESS_DENIED;
     }
 
-    DEBUG(SSSDBG_MINOR_FAILURE, "Access denied by HBAC rules\n");
-    ret = ERR_ACCESS_DENIED;
+    /* The decision is valid until the rules are refreshed again */
+    ttl = dp_opt_get_int(access_ctx->ipa_options, IPA_HBAC_REFRESH);
+    if (ttl > 0 && key != NULL) {
+        ipa_hbac_decision_store(cache, key, ret, ttl);
+    }
 
 done:
     hbac_free_info(info);
@@ -821,8 +1111,8 @@ static void ipa_pam_access_handler_done(struct tevent_req *subreq)
         goto done;
     }
 
-    ret = ipa_hbac_evaluate_rules(state->be_ctx,
-                                  state->access_ctx->ipa_options, state->pd);
+    ret = ipa_hbac_evaluate_rules(state->be_ctx, state->access_ctx,
+                                  state->pd);
     if (ret == EOK) {
         state->pd->pam_status = PAM_SUCCESS;
     } else if (ret == ERR_ACCESS_DENIED) {
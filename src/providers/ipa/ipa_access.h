@@ -27,6 +27,8 @@
 
 #include "providers/ldap/ldap_common.h"
 
+struct ipa_hbac_cache;
+
 enum ipa_access_mode {
     IPA_ACCESS_DENY = 0,
     IPA_ACCESS_ALLOW
@@ -43,6 +45,11 @@ struct ipa_access_ctx {
     struct sdap_attr_map *hostgroup_map;
     struct sdap_search_base **host_search_bases;
     struct sdap_search_base **hbac_search_bases;
+
+    /* Compiled HBAC rules and cached decisions */
+    struct ipa_hbac_cache *hbac_cache;
+    /* Increased after every successful refresh of the HBAC rules */
+    uint64_t hbac_generation;
 };
 
 struct hbac_ctx {
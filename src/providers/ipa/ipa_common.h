@@ -200,6 +200,9 @@ struct ipa_id_ctx {
     char *view_name;
     /* Only used with server mode */
     struct ipa_server_mode_ctx *server_mode;
+
+    /* SIDs recently saved by extdom list lookups */
+    hash_table_t *s2n_sid_cache;
 };
 
 struct ipa_options {
@@ -197,11 +197,6 @@ hbac_attrs_to_rule(TALLOC_CTX *mem_ctx,
                    size_t index,
                    struct hbac_rule **rule);
 
-static errno_t
-hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
-                         struct hbac_ctx *hbac_ctx,
-                         struct hbac_eval_req **request);
-
 errno_t
 hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
                   struct hbac_ctx *hbac_ctx,
@@ -214,7 +209,7 @@ hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
     size_t i;
     TALLOC_CTX *tmp_ctx = NULL;
 
-    if (!rules || !request) return EINVAL;
+    if (!rules) return EINVAL;
 
     tmp_ctx = talloc_new(mem_ctx);
     if (tmp_ctx == NULL) return ENOMEM;
@@ -240,14 +235,16 @@ hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
     new_rules[i] = NULL;
 
     /* Create the eval request */
-    ret = hbac_ctx_to_eval_request(tmp_ctx, hbac_ctx, &new_request);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct eval request\n");
-        goto done;
+    if (request != NULL) {
+        ret = hbac_ctx_to_eval_request(tmp_ctx, hbac_ctx, &new_request);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct eval request\n");
+            goto done;
+        }
+        *request = talloc_steal(mem_ctx, new_request);
     }
 
     *rules = talloc_steal(mem_ctx, new_rules);
-    *request = talloc_steal(mem_ctx, new_request);
     ret = EOK;
 
 done:
@@ -415,7 +412,7 @@ hbac_eval_host_element(TALLOC_CTX *mem_ctx,
                        const char *hostname,
                        struct hbac_request_element **host_element);
 
-static errno_t
+errno_t
 hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
                          struct hbac_ctx *hbac_ctx,
                          struct hbac_eval_req **request)
@@ -77,11 +77,17 @@ replace_attribute_name(const char *old_name,
                        const char *new_name, const size_t count,
                        struct sysdb_attrs **list);
 
+/* request may be NULL if only the rules are needed */
 errno_t hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
                           struct hbac_ctx *hbac_ctx,
                           struct hbac_rule ***rules,
                           struct hbac_eval_req **request);
 
+errno_t
+hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
+                         struct hbac_ctx *hbac_ctx,
+                         struct hbac_eval_req **request);
+
 errno_t
 hbac_get_category(struct sysdb_attrs *attrs,
                   const char *category_attr,
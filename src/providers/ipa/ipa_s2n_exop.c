@@ -1090,94 +1090,164 @@ static const char *ipa_s2n_reqinp2str(TALLOC_CTX *mem_ctx,
     return str;
 }
 
-struct ipa_s2n_get_list_state {
-    struct tevent_context *ev;
-    struct ipa_id_ctx *ipa_ctx;
-    struct sss_domain_info *dom;
-    struct sdap_handle *sh;
-    struct req_input req_input;
-    char **list;
-    size_t list_idx;
-    int exop_timeout;
-    int entry_type;
-    enum request_types request_type;
-    struct resp_attrs *attrs;
-    struct sss_domain_info *obj_domain;
-    struct sysdb_attrs *override_attrs;
-    struct sysdb_attrs *mapped_attrs;
-};
+/* Maximum number of extdom requests of a list running at the same time */
+#define IPA_S2N_LIST_MAX_REQS 8
+/* Maximum number of list objects saved in a single sysdb transaction */
+#define IPA_S2N_LIST_SAVE_BATCH 16
 
-static errno_t ipa_s2n_get_list_step(struct tevent_req *req);
-static void ipa_s2n_get_list_get_override_done(struct tevent_req *subreq);
-static void ipa_s2n_get_list_next(struct tevent_req *subreq);
-static errno_t ipa_s2n_get_list_save_step(struct tevent_req *req);
+/* Maximum number of remembered SIDs */
+#define IPA_S2N_SID_CACHE_MAX 4096
+/* Time in seconds a saved SID is not looked up again */
+#define IPA_S2N_SID_CACHE_TIMEOUT 30
 
-static struct tevent_req *ipa_s2n_get_list_send(TALLOC_CTX *mem_ctx,
-                                                struct tevent_context *ev,
-                                                struct ipa_id_ctx *ipa_ctx,
-                                                struct sss_domain_info *dom,
-                                                struct sdap_handle *sh,
-                                                int exop_timeout,
-                                                int entry_type,
-                                                enum request_types request_type,
-                                                enum req_input_type list_type,
-                                                char **list,
-                                                struct sysdb_attrs *mapped_attrs)
+struct ipa_s2n_sid_cache_entry {
+    char *name;
+    time_t expire;
+};
+
+/* Check if the object with the given SID was recently saved by another list
+ * lookup and is still in the cache. */
+static bool ipa_s2n_sid_cache_lookup(struct ipa_id_ctx *ipa_ctx,
+                                     struct sss_domain_info *dom,
+                                     const char *sid)
 {
-    int ret;
-    struct ipa_s2n_get_list_state *state;
-    struct tevent_req *req;
+    TALLOC_CTX *tmp_ctx;
+    struct ipa_s2n_sid_cache_entry *entry;
+    struct sss_domain_info *obj_domain;
+    struct ldb_result *res;
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    bool found = false;
+    int hret;
+    errno_t ret;
 
-    req = tevent_req_create(mem_ctx, &state, struct ipa_s2n_get_list_state);
-    if (req == NULL) {
-        return NULL;
+    if (ipa_ctx->s2n_sid_cache == NULL) {
+        return false;
     }
 
-    if ((entry_type == BE_REQ_BY_SECID && list_type != REQ_INP_SECID)
-           || (entry_type != BE_REQ_BY_SECID && list_type == REQ_INP_SECID)) {
-        DEBUG(SSSDBG_OP_FAILURE, "Invalid parameter combination [%d][%d].\n",
-                                 request_type, list_type);
-        ret = EINVAL;
-        goto done;
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(sid);
+
+    hret = hash_lookup(ipa_ctx->s2n_sid_cache, &hkey, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        return false;
     }
 
-    state->ev = ev;
-    state->ipa_ctx = ipa_ctx;
-    state->dom = dom;
-    state->sh = sh;
-    state->list = list;
-    state->list_idx = 0;
-    state->req_input.type = list_type;
-    state->req_input.inp.name = NULL;
-    state->exop_timeout = exop_timeout;
-    state->entry_type = entry_type;
-    state->request_type = request_type;
-    state->attrs = NULL;
-    state->override_attrs = NULL;
-    state->mapped_attrs = mapped_attrs;
+    entry = talloc_get_type(hvalue.ptr, struct ipa_s2n_sid_cache_entry);
+    if (entry->expire <= time(NULL)) {
+        return false;
+    }
 
-    ret = ipa_s2n_get_list_step(req);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
-        goto done;
+    obj_domain = find_domain_by_sid(get_domains_head(dom), sid);
+    if (obj_domain == NULL) {
+        return false;
     }
 
-done:
-    if (ret != EOK) {
-        tevent_req_error(req, ret);
-        tevent_req_post(req, ev);
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return false;
     }
 
-    return req;
+    /* The object might have been removed from the cache meanwhile */
+    ret = sysdb_search_object_by_sid(tmp_ctx, obj_domain, sid, attrs, &res);
+    if (ret == EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC, "SID [%s] of [%s] was resolved recently, "
+                                 "skipping.\n", sid, entry->name);
+        found = true;
+    }
+
+    talloc_free(tmp_ctx);
+    return found;
 }
 
-static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
+static void ipa_s2n_sid_cache_store(struct ipa_id_ctx *ipa_ctx,
+                                    const char *sid,
+                                    const char *name)
+{
+    struct ipa_s2n_sid_cache_entry *entry;
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+    errno_t ret;
+
+    if (ipa_ctx->s2n_sid_cache == NULL
+            || hash_count(ipa_ctx->s2n_sid_cache) >= IPA_S2N_SID_CACHE_MAX) {
+        talloc_zfree(ipa_ctx->s2n_sid_cache);
+        ret = sss_hash_create(ipa_ctx, 0, &ipa_ctx->s2n_sid_cache);
+        if (ret != EOK) {
+            /* Continue without remembering SIDs */
+            ipa_ctx->s2n_sid_cache = NULL;
+            return;
+        }
+    }
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(sid);
+
+    hret = hash_lookup(ipa_ctx->s2n_sid_cache, &hkey, &hvalue);
+    if (hret == HASH_SUCCESS) {
+        entry = talloc_get_type(hvalue.ptr, struct ipa_s2n_sid_cache_entry);
+        talloc_zfree(entry->name);
+    } else {
+        /* Entries are freed together with the table */
+        entry = talloc_zero(ipa_ctx->s2n_sid_cache,
+                            struct ipa_s2n_sid_cache_entry);
+        if (entry == NULL) {
+            return;
+        }
+
+        hvalue.type = HASH_VALUE_PTR;
+        hvalue.ptr = entry;
+
+        hret = hash_enter(ipa_ctx->s2n_sid_cache, &hkey, &hvalue);
+        if (hret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to remember SID [%s]\n", sid);
+            talloc_free(entry);
+            return;
+        }
+    }
+
+    entry->name = talloc_strdup(entry, name != NULL ? name : "");
+    entry->expire = time(NULL) + IPA_S2N_SID_CACHE_TIMEOUT;
+}
+
+/* A single object of a list lookup, kept until it is saved */
+struct ipa_s2n_list_obj {
+    struct req_input req_input;
+    struct sss_domain_info *obj_domain;
+    struct resp_attrs *attrs;
+    struct sysdb_attrs *override_attrs;
+};
+
+struct ipa_s2n_get_list_obj_state {
+    struct tevent_context *ev;
+    struct ipa_id_ctx *ipa_ctx;
+    struct sss_domain_info *dom;
+    struct ipa_s2n_list_obj *obj;
+};
+
+static void ipa_s2n_get_list_obj_exop_done(struct tevent_req *subreq);
+static void ipa_s2n_get_list_obj_override_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+ipa_s2n_get_list_obj_send(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          struct ipa_id_ctx *ipa_ctx,
+                          struct sss_domain_info *dom,
+                          struct sdap_handle *sh,
+                          int exop_timeout,
+                          int entry_type,
+                          enum request_types request_type,
+                          enum req_input_type list_type,
+                          char *list_elem)
 {
     int ret;
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
-                                               struct ipa_s2n_get_list_state);
-    struct berval *bv_req;
+    struct ipa_s2n_get_list_obj_state *state;
+    struct ipa_s2n_list_obj *obj;
+    struct tevent_req *req;
     struct tevent_req *subreq;
+    struct berval *bv_req;
     struct sss_domain_info *parent_domain;
     char *short_name = NULL;
     char *domain_name = NULL;
@@ -1185,101 +1255,124 @@ static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
     char *endptr;
     bool need_v1 = false;
 
-    parent_domain = get_domains_head(state->dom);
-    switch (state->req_input.type) {
+    req = tevent_req_create(mem_ctx, &state,
+                            struct ipa_s2n_get_list_obj_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->ipa_ctx = ipa_ctx;
+    state->dom = dom;
+
+    state->obj = talloc_zero(state, struct ipa_s2n_list_obj);
+    if (state->obj == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    obj = state->obj;
+    obj->req_input.type = list_type;
+
+    parent_domain = get_domains_head(dom);
+    switch (list_type) {
     case REQ_INP_NAME:
 
-        ret = sss_parse_name(state, state->dom->names, state->list[state->list_idx],
+        ret = sss_parse_name(obj, dom->names, list_elem,
                              &domain_name, &short_name);
         if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Unable to parse name '%s' [%d]: %s\n",
-                                        state->list[state->list_idx],
-                                        ret, sss_strerror(ret));
-            return ret;
+                                        list_elem, ret, sss_strerror(ret));
+            goto done;
         }
 
         if (domain_name) {
-            state->obj_domain = find_domain_by_name(parent_domain,
-                                                    domain_name, true);
-            if (state->obj_domain == NULL) {
+            obj->obj_domain = find_domain_by_name(parent_domain,
+                                                  domain_name, true);
+            if (obj->obj_domain == NULL) {
                 DEBUG(SSSDBG_OP_FAILURE, "find_domain_by_name failed.\n");
-                return ENOMEM;
+                ret = ENOMEM;
+                goto done;
             }
         } else {
-            state->obj_domain = parent_domain;
+            obj->obj_domain = parent_domain;
         }
 
-        state->req_input.inp.name = short_name;
+        obj->req_input.inp.name = short_name;
 
         break;
     case REQ_INP_ID:
         errno = 0;
-        id = strtouint32(state->list[state->list_idx], &endptr, 10);
-        if (errno != 0 || *endptr != '\0'
-                || (state->list[state->list_idx] == endptr)) {
+        id = strtouint32(list_elem, &endptr, 10);
+        if (errno != 0 || *endptr != '\0' || (list_elem == endptr)) {
             DEBUG(SSSDBG_OP_FAILURE, "strtouint32 failed.\n");
-            return EINVAL;
+            ret = EINVAL;
+            goto done;
         }
-        state->req_input.inp.id = id;
-        state->obj_domain = state->dom;
+        obj->req_input.inp.id = id;
+        obj->obj_domain = dom;
 
         break;
     case REQ_INP_SECID:
-        state->req_input.inp.secid = state->list[state->list_idx];
-        state->obj_domain = find_domain_by_sid(parent_domain,
-                                               state->req_input.inp.secid);
-        if (state->obj_domain == NULL) {
+        obj->req_input.inp.secid = list_elem;
+        obj->obj_domain = find_domain_by_sid(parent_domain,
+                                             obj->req_input.inp.secid);
+        if (obj->obj_domain == NULL) {
             DEBUG(SSSDBG_OP_FAILURE,
                   "find_domain_by_sid failed for SID [%s].\n",
-                  state->req_input.inp.secid);
-            return EINVAL;
+                  obj->req_input.inp.secid);
+            ret = EINVAL;
+            goto done;
         }
 
         break;
     default:
-        DEBUG(SSSDBG_OP_FAILURE, "Unexpected input type [%d].\n",
-                                 state->req_input.type);
-        return EINVAL;
+        DEBUG(SSSDBG_OP_FAILURE, "Unexpected input type [%d].\n", list_type);
+        ret = EINVAL;
+        goto done;
     }
 
-    ret = s2n_encode_request(state, state->obj_domain->name, state->entry_type,
-                             state->request_type,
-                             &state->req_input, &bv_req);
+    ret = s2n_encode_request(state, obj->obj_domain->name, entry_type,
+                             request_type, &obj->req_input, &bv_req);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "s2n_encode_request failed.\n");
-        return ret;
+        goto done;
     }
 
-    if (state->request_type == REQ_FULL_WITH_MEMBERS) {
+    if (request_type == REQ_FULL_WITH_MEMBERS) {
         need_v1 = true;
     }
 
-    if (state->req_input.type == REQ_INP_NAME
-            && state->req_input.inp.name != NULL) {
+    if (obj->req_input.type == REQ_INP_NAME
+            && obj->req_input.inp.name != NULL) {
         DEBUG(SSSDBG_TRACE_FUNC,
               "Sending request_type: [%s] for object [%s].\n",
-              ipa_s2n_reqtype2str(state->request_type),
-              state->list[state->list_idx]);
+              ipa_s2n_reqtype2str(request_type), list_elem);
     }
 
-    subreq = ipa_s2n_exop_send(state, state->ev, state->sh, need_v1,
-                               state->exop_timeout, bv_req);
+    subreq = ipa_s2n_exop_send(state, ev, sh, need_v1, exop_timeout, bv_req);
     if (subreq == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_exop_send failed.\n");
-        return ENOMEM;
+        ret = ENOMEM;
+        goto done;
     }
-    tevent_req_set_callback(subreq, ipa_s2n_get_list_next, req);
+    tevent_req_set_callback(subreq, ipa_s2n_get_list_obj_exop_done, req);
 
-    return EOK;
+    return req;
+
+done:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
 }
 
-static void ipa_s2n_get_list_next(struct tevent_req *subreq)
+static void ipa_s2n_get_list_obj_exop_done(struct tevent_req *subreq)
 {
     int ret;
     struct tevent_req *req = tevent_req_callback_data(subreq,
                                                       struct tevent_req);
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
-                                               struct ipa_s2n_get_list_state);
+    struct ipa_s2n_get_list_obj_state *state = tevent_req_data(req,
+                                           struct ipa_s2n_get_list_obj_state);
     char *retoid = NULL;
     struct berval *retdata = NULL;
     const char *sid_str;
@@ -1292,40 +1385,33 @@ static void ipa_s2n_get_list_next(struct tevent_req *subreq)
         goto fail;
     }
 
-    talloc_zfree(state->attrs);
-    ret = s2n_response_to_attrs(state, state->dom, retoid, retdata,
-                                &state->attrs);
+    ret = s2n_response_to_attrs(state->obj, state->dom, retoid, retdata,
+                                &state->obj->attrs);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "s2n_response_to_attrs failed.\n");
         goto fail;
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "Received [%s] attributes from IPA server.\n",
-                             state->attrs->a.name);
+                             state->obj->attrs->a.name);
 
     if (is_default_view(state->ipa_ctx->view_name)) {
-        ret = ipa_s2n_get_list_save_step(req);
-        if (ret == EOK) {
-            tevent_req_done(req);
-        } else if (ret != EAGAIN) {
-            DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_save_step failed.\n");
-            goto fail;
-        }
-
+        tevent_req_done(req);
         return;
     }
 
-    ret = sysdb_attrs_get_string(state->attrs->sysdb_attrs, SYSDB_SID_STR,
-                                 &sid_str);
+    ret = sysdb_attrs_get_string(state->obj->attrs->sysdb_attrs,
+                                 SYSDB_SID_STR, &sid_str);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Object [%s] has no SID, please check the "
               "ipaNTSecurityIdentifier attribute on the server-side",
-              state->attrs->a.name);
+              state->obj->attrs->a.name);
         goto fail;
     }
 
-    ret = get_dp_id_data_for_sid(state, sid_str, state->obj_domain->name, &ar);
+    ret = get_dp_id_data_for_sid(state, sid_str,
+                                 state->obj->obj_domain->name, &ar);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "get_dp_id_data_for_sid failed.\n");
         goto fail;
@@ -1343,35 +1429,212 @@ static void ipa_s2n_get_list_next(struct tevent_req *subreq)
         ret = ENOMEM;
         goto fail;
     }
-    tevent_req_set_callback(subreq, ipa_s2n_get_list_get_override_done, req);
+    tevent_req_set_callback(subreq, ipa_s2n_get_list_obj_override_done, req);
 
     return;
 
 fail:
-    tevent_req_error(req,ret);
+    tevent_req_error(req, ret);
     return;
 }
 
-static void ipa_s2n_get_list_get_override_done(struct tevent_req *subreq)
+static void ipa_s2n_get_list_obj_override_done(struct tevent_req *subreq)
+{
+    int ret;
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct ipa_s2n_get_list_obj_state *state = tevent_req_data(req,
+                                           struct ipa_s2n_get_list_obj_state);
+
+    ret = ipa_get_ad_override_recv(subreq, NULL, state->obj,
+                                   &state->obj->override_attrs);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "IPA override lookup failed: %d\n", ret);
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static int ipa_s2n_get_list_obj_recv(struct tevent_req *req,
+                                     TALLOC_CTX *mem_ctx,
+                                     struct ipa_s2n_list_obj **_obj)
+{
+    struct ipa_s2n_get_list_obj_state *state = tevent_req_data(req,
+                                           struct ipa_s2n_get_list_obj_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_obj = talloc_steal(mem_ctx, state->obj);
+
+    return EOK;
+}
+
+struct ipa_s2n_get_list_state {
+    struct tevent_context *ev;
+    struct ipa_id_ctx *ipa_ctx;
+    struct sss_domain_info *dom;
+    struct sdap_handle *sh;
+    enum req_input_type list_type;
+    char **list;
+    size_t list_idx;
+    int exop_timeout;
+    int entry_type;
+    enum request_types request_type;
+    struct sysdb_attrs *mapped_attrs;
+
+    /* Number of objects currently looked up */
+    size_t num_reqs;
+
+    /* Received objects which are not saved yet */
+    struct ipa_s2n_list_obj *objs[IPA_S2N_LIST_SAVE_BATCH];
+    size_t num_objs;
+};
+
+static errno_t ipa_s2n_get_list_step(struct tevent_req *req);
+static void ipa_s2n_get_list_next(struct tevent_req *subreq);
+static errno_t ipa_s2n_get_list_save(struct ipa_s2n_get_list_state *state);
+
+static struct tevent_req *ipa_s2n_get_list_send(TALLOC_CTX *mem_ctx,
+                                                struct tevent_context *ev,
+                                                struct ipa_id_ctx *ipa_ctx,
+                                                struct sss_domain_info *dom,
+                                                struct sdap_handle *sh,
+                                                int exop_timeout,
+                                                int entry_type,
+                                                enum request_types request_type,
+                                                enum req_input_type list_type,
+                                                char **list,
+                                                struct sysdb_attrs *mapped_attrs)
+{
+    int ret;
+    struct ipa_s2n_get_list_state *state;
+    struct tevent_req *req;
+
+    req = tevent_req_create(mem_ctx, &state, struct ipa_s2n_get_list_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    if ((entry_type == BE_REQ_BY_SECID && list_type != REQ_INP_SECID)
+           || (entry_type != BE_REQ_BY_SECID && list_type == REQ_INP_SECID)) {
+        DEBUG(SSSDBG_OP_FAILURE, "Invalid parameter combination [%d][%d].\n",
+                                 request_type, list_type);
+        ret = EINVAL;
+        goto done;
+    }
+
+    state->ev = ev;
+    state->ipa_ctx = ipa_ctx;
+    state->dom = dom;
+    state->sh = sh;
+    state->list_type = list_type;
+    state->list = list;
+    state->list_idx = 0;
+    state->exop_timeout = exop_timeout;
+    state->entry_type = entry_type;
+    state->request_type = request_type;
+    state->mapped_attrs = mapped_attrs;
+
+    ret = ipa_s2n_get_list_step(req);
+    if (ret == EAGAIN) {
+        return req;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
+    }
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+/* Start lookups of the next list elements until IPA_S2N_LIST_MAX_REQS are
+ * running. Returns EAGAIN while lookups are running and EOK when the whole
+ * list is processed and saved. */
+static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
+{
+    int ret;
+    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
+                                               struct ipa_s2n_get_list_state);
+    struct tevent_req *subreq;
+    char *list_elem;
+
+    while (state->num_reqs < IPA_S2N_LIST_MAX_REQS
+            && state->list[state->list_idx] != NULL) {
+        list_elem = state->list[state->list_idx];
+        state->list_idx++;
+
+        if (state->list_type == REQ_INP_SECID
+                && ipa_s2n_sid_cache_lookup(state->ipa_ctx, state->dom,
+                                            list_elem)) {
+            continue;
+        }
+
+        subreq = ipa_s2n_get_list_obj_send(state, state->ev, state->ipa_ctx,
+                                           state->dom, state->sh,
+                                           state->exop_timeout,
+                                           state->entry_type,
+                                           state->request_type,
+                                           state->list_type, list_elem);
+        if (subreq == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_obj_send failed.\n");
+            return ENOMEM;
+        }
+        tevent_req_set_callback(subreq, ipa_s2n_get_list_next, req);
+        state->num_reqs++;
+    }
+
+    if (state->num_reqs > 0) {
+        return EAGAIN;
+    }
+
+    ret = ipa_s2n_get_list_save(state);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    return EOK;
+}
+
+static void ipa_s2n_get_list_next(struct tevent_req *subreq)
 {
     int ret;
     struct tevent_req *req = tevent_req_callback_data(subreq,
                                                       struct tevent_req);
     struct ipa_s2n_get_list_state *state = tevent_req_data(req,
                                                struct ipa_s2n_get_list_state);
+    struct ipa_s2n_list_obj *obj;
 
-    ret = ipa_get_ad_override_recv(subreq, NULL, state, &state->override_attrs);
+    ret = ipa_s2n_get_list_obj_recv(subreq, state, &obj);
     talloc_zfree(subreq);
+    state->num_reqs--;
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "IPA override lookup failed: %d\n", ret);
         goto fail;
     }
 
-    ret = ipa_s2n_get_list_save_step(req);
+    state->objs[state->num_objs] = obj;
+    state->num_objs++;
+
+    if (state->num_objs == IPA_S2N_LIST_SAVE_BATCH) {
+        ret = ipa_s2n_get_list_save(state);
+        if (ret != EOK) {
+            goto fail;
+        }
+    }
+
+    ret = ipa_s2n_get_list_step(req);
     if (ret == EOK) {
         tevent_req_done(req);
     } else if (ret != EAGAIN) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_save_step failed.\n");
+        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
         goto fail;
     }
 
@@ -1382,33 +1645,80 @@ fail:
     return;
 }
 
-static errno_t ipa_s2n_get_list_save_step(struct tevent_req *req)
+static errno_t ipa_s2n_get_list_save(struct ipa_s2n_get_list_state *state)
 {
     int ret;
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
-                                               struct ipa_s2n_get_list_state);
+    errno_t sret;
+    bool in_transaction = false;
+    struct ipa_s2n_list_obj *obj;
+    const char *sid_str;
+    size_t c;
 
-    ret = ipa_s2n_save_objects(state->dom, &state->req_input, state->attrs,
-                               NULL, state->ipa_ctx->view_name,
-                               state->override_attrs, state->mapped_attrs,
-                               false);
+    if (state->num_objs == 0) {
+        return EOK;
+    }
+
+    ret = sysdb_transaction_start(state->dom->sysdb);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_save_objects failed.\n");
-        return ret;
+        DEBUG(SSSDBG_OP_FAILURE, "sysdb_transaction_start failed.\n");
+        goto done;
     }
+    in_transaction = true;
 
-    state->list_idx++;
-    if (state->list[state->list_idx] == NULL) {
-        return EOK;
+    for (c = 0; c < state->num_objs; c++) {
+        obj = state->objs[c];
+
+        ret = ipa_s2n_save_objects(state->dom, &obj->req_input, obj->attrs,
+                                   NULL, state->ipa_ctx->view_name,
+                                   obj->override_attrs, state->mapped_attrs,
+                                   false);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_save_objects failed.\n");
+            goto done;
+        }
     }
 
-    ret = ipa_s2n_get_list_step(req);
+    ret = sysdb_transaction_commit(state->dom->sysdb);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
-        return ret;
+        DEBUG(SSSDBG_OP_FAILURE, "sysdb_transaction_commit failed.\n");
+        goto done;
     }
+    in_transaction = false;
 
-    return EAGAIN;
+    DEBUG(SSSDBG_TRACE_FUNC, "Saved [%zu] objects.\n", state->num_objs);
+
+    for (c = 0; c < state->num_objs; c++) {
+        obj = state->objs[c];
+
+        if (obj->req_input.type == REQ_INP_SECID) {
+            sid_str = obj->req_input.inp.secid;
+        } else {
+            ret = sysdb_attrs_get_string(obj->attrs->sysdb_attrs,
+                                         SYSDB_SID_STR, &sid_str);
+            if (ret != EOK) {
+                continue;
+            }
+        }
+
+        ipa_s2n_sid_cache_store(state->ipa_ctx, sid_str, obj->attrs->a.name);
+    }
+
+    ret = EOK;
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(state->dom->sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+
+    for (c = 0; c < state->num_objs; c++) {
+        talloc_zfree(state->objs[c]);
+    }
+    state->num_objs = 0;
+
+    return ret;
 }
 
 static int ipa_s2n_get_list_recv(struct tevent_req *req)
@@ -306,6 +306,7 @@ ipa_ad_ctx_new(struct be_ctx *be_ctx,
 
     /* use AD plugin */
     srv_ctx = ad_srv_plugin_ctx_init(be_ctx, be_ctx->be_res,
+                                     be_ctx->domain,
                                      default_host_dbs,
                                      ad_id_ctx->ad_options->id,
                                      id_ctx->server_mode->hostname,
@@ -1072,10 +1072,13 @@ ipa_sudo_refresh_done(struct tevent_req *subreq)
     }
     in_transaction = true;
 
-    ret = sysdb_sudo_purge(state->domain, state->delete_filter,
-                           state->rules, state->num_rules);
-    if (ret != EOK) {
-        goto done;
+    /* The received rules are replaced in place when stored */
+    if (state->delete_filter != NULL) {
+        ret = sysdb_sudo_purge(state->domain, state->delete_filter,
+                               state->rules, state->num_rules);
+        if (ret != EOK) {
+            goto done;
+        }
     }
 
     ret = sysdb_sudo_store(state->domain, state->rules, state->num_rules);
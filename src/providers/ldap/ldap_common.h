@@ -46,6 +46,7 @@
 extern int ldap_child_debug_fd;
 
 struct sdap_id_ctx;
+struct users_batch;
 
 struct sdap_id_conn_ctx {
     struct sdap_id_ctx *id_ctx;
@@ -69,6 +70,12 @@ struct sdap_id_ctx {
     struct sdap_id_conn_ctx *conn;
 
     struct sdap_server_opts *srv_opts;
+
+    /* lookups of users by UID that are being collected into one search */
+    struct users_batch *users_batch;
+
+    /* PAC group lookups running after initgroups finished, see ad_pac.c */
+    unsigned int pac_bg_lookups;
 };
 
 struct sdap_auth_ctx {
@@ -33,6 +33,7 @@
 #include "db/sysdb.h"
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap_async.h"
+#include "providers/ldap/sdap_async_private.h"
 #include "providers/ldap/sdap_idmap.h"
 #include "providers/ldap/sdap_users.h"
 #include "providers/ad/ad_common.h"
@@ -667,6 +668,634 @@ int users_get_recv(struct tevent_req *req, int *dp_error_out, int *sdap_ret)
     return EOK;
 }
 
+/* =Users-Related-Functions-(batched-by-uid)============================== */
+
+/* Lookups of users by UID that arrive within ldap_uid_batch_window are
+ * collected and resolved with a single LDAP search per search base. */
+#define USERS_BATCH_MAX_SIZE 50
+
+struct users_batch_state;
+
+struct users_batch {
+    struct tevent_context *ev;
+    struct sdap_id_ctx *ctx;
+    struct sdap_domain *sdom;
+    struct sdap_id_conn_ctx *conn;
+    struct sdap_id_op *op;
+    struct tevent_timer *te;
+
+    struct users_batch_state *waiters;
+    size_t num_waiters;
+    int base_iter;
+    struct sdap_search_base *search_base[2];
+    char *filter;
+    const char **attrs;
+};
+
+struct users_batch_state {
+    struct users_batch_state *prev, *next;
+    struct users_batch *batch;
+    struct tevent_req *req;
+
+    uid_t uid;
+    int dp_error;
+    int sdap_ret;
+};
+
+static void users_batch_flush(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv,
+                              void *pvt);
+static errno_t users_batch_retry(struct users_batch *batch);
+static void users_batch_connect_done(struct tevent_req *subreq);
+static errno_t users_batch_next_base(struct users_batch *batch);
+static void users_batch_search_done(struct tevent_req *subreq);
+
+/* Only plain POSIX lookups by UID can be merged into one search, everything
+ * that needs per-request treatment goes through users_get_send(). */
+static bool users_batch_eligible(struct sdap_id_ctx *ctx,
+                                 struct sdap_domain *sdom,
+                                 struct dp_id_data *ar)
+{
+    if (dp_opt_get_int(ctx->opts->basic, SDAP_UID_BATCH_WINDOW) <= 0) {
+        return false;
+    }
+
+    if ((ar->entry_type & BE_REQ_TYPE_MASK) != BE_REQ_USER
+            || ar->filter_type != BE_FILTER_IDNUM) {
+        return false;
+    }
+
+    if (sdom->dom->type == DOM_TYPE_APPLICATION) {
+        return false;
+    }
+
+    if (sdap_idmap_domain_has_algorithmic_mapping(ctx->opts->idmap_ctx,
+                                                  sdom->dom->name,
+                                                  sdom->dom->domain_id)) {
+        return false;
+    }
+
+    if (ctx->opts->schema_type == SDAP_SCHEMA_RFC2307
+            && dp_opt_get_bool(ctx->opts->basic,
+                               SDAP_RFC2307_FALLBACK_TO_LOCAL_USERS)) {
+        return false;
+    }
+
+    /* Let a single lookup run the POSIX attributes check first */
+    if (ctx->opts->schema_type == SDAP_SCHEMA_AD
+            && (ctx->srv_opts == NULL || !ctx->srv_opts->posix_checked)) {
+        return false;
+    }
+
+    return true;
+}
+
+static int users_batch_state_destructor(struct users_batch_state *state)
+{
+    if (state->batch != NULL) {
+        DLIST_REMOVE(state->batch->waiters, state);
+        state->batch->num_waiters--;
+        state->batch = NULL;
+    }
+
+    return 0;
+}
+
+static int users_batch_destructor(struct users_batch *batch)
+{
+    struct users_batch_state *state;
+
+    if (batch->ctx->users_batch == batch) {
+        batch->ctx->users_batch = NULL;
+    }
+
+    /* Waiters that were not finished yet must not point to us anymore. */
+    while ((state = batch->waiters) != NULL) {
+        DLIST_REMOVE(batch->waiters, state);
+        state->batch = NULL;
+    }
+
+    return 0;
+}
+
+static struct users_batch *users_batch_new(struct tevent_context *ev,
+                                           struct sdap_id_ctx *ctx,
+                                           struct sdap_domain *sdom,
+                                           struct sdap_id_conn_ctx *conn)
+{
+    struct users_batch *batch;
+    struct timeval tv;
+    int window;
+
+    batch = talloc_zero(ctx, struct users_batch);
+    if (batch == NULL) {
+        return NULL;
+    }
+
+    batch->ev = ev;
+    batch->ctx = ctx;
+    batch->sdom = sdom;
+    batch->conn = conn;
+
+    /* in milliseconds */
+    window = dp_opt_get_int(ctx->opts->basic, SDAP_UID_BATCH_WINDOW);
+    tv = tevent_timeval_current_ofs(window / 1000, (window % 1000) * 1000);
+    batch->te = tevent_add_timer(ev, batch, tv, users_batch_flush, batch);
+    if (batch->te == NULL) {
+        talloc_free(batch);
+        return NULL;
+    }
+
+    talloc_set_destructor(batch, users_batch_destructor);
+
+    return batch;
+}
+
+/* Stop collecting lookups into @batch and run its search right away. */
+static errno_t users_batch_close(struct users_batch *batch)
+{
+    struct tevent_timer *te;
+
+    te = tevent_add_timer(batch->ev, batch, tevent_timeval_zero(),
+                          users_batch_flush, batch);
+    if (te == NULL) {
+        return ENOMEM;
+    }
+
+    talloc_free(batch->te);
+    batch->te = te;
+
+    if (batch->ctx->users_batch == batch) {
+        batch->ctx->users_batch = NULL;
+    }
+
+    return EOK;
+}
+
+static struct tevent_req *users_batch_send(TALLOC_CTX *mem_ctx,
+                                           struct tevent_context *ev,
+                                           struct sdap_id_ctx *ctx,
+                                           struct sdap_domain *sdom,
+                                           struct sdap_id_conn_ctx *conn,
+                                           const char *filter_value)
+{
+    struct users_batch_state *state;
+    struct users_batch *batch;
+    struct tevent_req *req;
+    char *endptr;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct users_batch_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->req = req;
+    state->dp_error = DP_ERR_FATAL;
+
+    state->uid = strtouint32(filter_value, &endptr, 10);
+    if (errno != EOK || *endptr != '\0' || filter_value == endptr) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    batch = ctx->users_batch;
+    if (batch != NULL && (batch->sdom != sdom || batch->conn != conn)) {
+        /* Do not mix different domains or connections in one search */
+        ret = users_batch_close(batch);
+        if (ret != EOK) {
+            goto done;
+        }
+        batch = NULL;
+    }
+
+    if (batch == NULL) {
+        batch = users_batch_new(ev, ctx, sdom, conn);
+        if (batch == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        ctx->users_batch = batch;
+    }
+
+    state->batch = batch;
+    DLIST_ADD_END(batch->waiters, state, struct users_batch_state *);
+    batch->num_waiters++;
+    talloc_set_destructor(state, users_batch_state_destructor);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Adding UID %"SPRIuid" to a batch of %zu "
+          "lookups\n", state->uid, batch->num_waiters);
+
+    if (batch->num_waiters >= USERS_BATCH_MAX_SIZE) {
+        /* The batch is full, do not wait for the rest of the window */
+        ret = users_batch_close(batch);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    return req;
+
+done:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+static bool users_batch_has_uid(struct sysdb_attrs **users,
+                                size_t count,
+                                uid_t uid)
+{
+    uint32_t found_uid;
+    size_t i;
+    errno_t ret;
+
+    for (i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_uint32_t(users[i], SYSDB_UIDNUM, &found_uid);
+        if (ret == EOK && found_uid == uid) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Returns the entries of @users which a single lookup would have returned to
+ * one of the waiters: the UID was asked for and the entry belongs to the
+ * domain of the batch. The entries are not copied. */
+static errno_t users_batch_match(TALLOC_CTX *mem_ctx,
+                                 struct users_batch *batch,
+                                 struct sysdb_attrs **users,
+                                 size_t count,
+                                 struct sysdb_attrs ***_matched,
+                                 size_t *_num_matched)
+{
+    struct users_batch_state *state;
+    struct sysdb_attrs **matched;
+    size_t num_matched = 0;
+    uint32_t uid;
+    size_t i;
+    errno_t ret;
+
+    matched = talloc_zero_array(mem_ctx, struct sysdb_attrs *, count + 1);
+    if (matched == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_uint32_t(users[i], SYSDB_UIDNUM, &uid);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Skipping user without UID\n");
+            continue;
+        }
+
+        if (!sdap_object_in_domain(batch->ctx->opts, users[i],
+                                   batch->sdom->dom)) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Skipping UID %"PRIu32" from another "
+                  "domain\n", uid);
+            continue;
+        }
+
+        DLIST_FOR_EACH(state, batch->waiters) {
+            if (state->uid == uid) {
+                matched[num_matched] = users[i];
+                num_matched++;
+                break;
+            }
+        }
+    }
+
+    *_matched = matched;
+    *_num_matched = num_matched;
+    return EOK;
+}
+
+/* Finish the waiters whose user is in @users, the others continue with the
+ * next search base. */
+static void users_batch_found(struct users_batch *batch,
+                              struct sysdb_attrs **users,
+                              size_t count)
+{
+    struct users_batch_state *state;
+
+    /* a finished request may free other waiters, start over each time */
+    do {
+        DLIST_FOR_EACH(state, batch->waiters) {
+            if (users_batch_has_uid(users, count, state->uid)) {
+                break;
+            }
+        }
+
+        if (state != NULL) {
+            DLIST_REMOVE(batch->waiters, state);
+            batch->num_waiters--;
+            state->batch = NULL;
+
+            state->dp_error = DP_ERR_OK;
+            state->sdap_ret = EOK;
+            tevent_req_done(state->req);
+        }
+    } while (state != NULL);
+}
+
+/* Finish all lookups that are still waiting for @batch and free it. Without
+ * an error their users do not exist. */
+static void users_batch_finish(struct users_batch *batch,
+                               errno_t error,
+                               int dp_error)
+{
+    struct users_batch_state *state;
+    errno_t ret;
+
+    while ((state = batch->waiters) != NULL) {
+        DLIST_REMOVE(batch->waiters, state);
+        batch->num_waiters--;
+        state->batch = NULL;
+
+        if (error != EOK) {
+            state->dp_error = dp_error;
+            tevent_req_error(state->req, error);
+            continue;
+        }
+
+        state->dp_error = DP_ERR_OK;
+        state->sdap_ret = ENOENT;
+        ret = sysdb_delete_user(batch->sdom->dom, NULL, state->uid);
+        if (ret != EOK && ret != ENOENT) {
+            tevent_req_error(state->req, ret);
+            continue;
+        }
+
+        tevent_req_done(state->req);
+    }
+
+    talloc_free(batch);
+}
+
+/* Only the UIDs which were not found in a previous search base are looked up,
+ * the same as a single lookup stops at the first base with a result. */
+static errno_t users_batch_build_filter(struct users_batch *batch)
+{
+    struct sdap_attr_map *map = batch->ctx->opts->user_map;
+    struct users_batch_state *state;
+    char *uid_filter;
+
+    talloc_zfree(batch->filter);
+
+    uid_filter = talloc_strdup(batch, "");
+    if (uid_filter == NULL) {
+        return ENOMEM;
+    }
+
+    DLIST_FOR_EACH(state, batch->waiters) {
+        uid_filter = talloc_asprintf_append_buffer(uid_filter,
+                                                   "(%s=%"SPRIuid")",
+                                                   map[SDAP_AT_USER_UID].name,
+                                                   state->uid);
+        if (uid_filter == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    /* Same restrictions as the single POSIX lookup in users_get_send() */
+    batch->filter = talloc_asprintf(batch,
+                                    "(&(|%s)(objectclass=%s)(%s=*)(&(%s=*)(!(%s=0))))",
+                                    uid_filter,
+                                    map[SDAP_OC_USER].name,
+                                    map[SDAP_AT_USER_NAME].name,
+                                    map[SDAP_AT_USER_UID].name,
+                                    map[SDAP_AT_USER_UID].name);
+    talloc_free(uid_filter);
+    if (batch->filter == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static void users_batch_flush(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv,
+                              void *pvt)
+{
+    struct users_batch *batch;
+    errno_t ret;
+
+    batch = talloc_get_type(pvt, struct users_batch);
+    batch->te = NULL;
+
+    if (batch->ctx->users_batch == batch) {
+        batch->ctx->users_batch = NULL;
+    }
+
+    if (batch->num_waiters == 0) {
+        /* All lookups were cancelled in the meantime */
+        talloc_free(batch);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Looking up a batch of %zu users by UID\n",
+          batch->num_waiters);
+
+    if (batch->sdom->user_search_bases == NULL
+            || batch->sdom->user_search_bases[0] == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "User lookup request without a search base\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    ret = build_attrs_from_map(batch, batch->ctx->opts->user_map,
+                               batch->ctx->opts->user_map_cnt,
+                               NULL, &batch->attrs, NULL);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    batch->op = sdap_id_op_create(batch, batch->conn->conn_cache);
+    if (batch->op == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = users_batch_retry(batch);
+
+done:
+    if (ret != EOK) {
+        users_batch_finish(batch, ret, DP_ERR_FATAL);
+    }
+}
+
+static errno_t users_batch_retry(struct users_batch *batch)
+{
+    struct tevent_req *subreq;
+    int ret = EOK;
+
+    subreq = sdap_id_op_connect_send(batch->op, batch, &ret);
+    if (subreq == NULL) {
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, users_batch_connect_done, batch);
+    return EOK;
+}
+
+static void users_batch_connect_done(struct tevent_req *subreq)
+{
+    struct users_batch *batch;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    batch = tevent_req_callback_data(subreq, struct users_batch);
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        users_batch_finish(batch, ret, dp_error);
+        return;
+    }
+
+    ret = users_batch_next_base(batch);
+    if (ret != EOK) {
+        users_batch_finish(batch, ret, DP_ERR_FATAL);
+    }
+}
+
+static errno_t users_batch_next_base(struct users_batch *batch)
+{
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    ret = users_batch_build_filter(batch);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    batch->search_base[0] = batch->sdom->user_search_bases[batch->base_iter];
+    batch->search_base[1] = NULL;
+
+    /* Without the wildcard size limit, a truncated result would make us
+     * delete existing users from the cache. */
+    subreq = sdap_search_user_send(batch, batch->ev, batch->sdom->dom,
+                                   batch->ctx->opts, batch->search_base,
+                                   sdap_id_op_handle(batch->op),
+                                   batch->attrs, batch->filter,
+                                   dp_opt_get_int(batch->ctx->opts->basic,
+                                                  SDAP_SEARCH_TIMEOUT),
+                                   SDAP_LOOKUP_ENUMERATE);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, users_batch_search_done, batch);
+    return EOK;
+}
+
+static void users_batch_search_done(struct tevent_req *subreq)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct users_batch *batch;
+    struct sysdb_attrs **users = NULL;
+    struct sysdb_attrs **matched;
+    size_t num_matched;
+    size_t count = 0;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    batch = tevent_req_callback_data(subreq, struct users_batch);
+
+    tmp_ctx = talloc_new(batch);
+    if (tmp_ctx == NULL) {
+        talloc_zfree(subreq);
+        users_batch_finish(batch, ENOMEM, DP_ERR_FATAL);
+        return;
+    }
+
+    ret = sdap_search_user_recv(tmp_ctx, subreq, NULL, &users, &count);
+    talloc_zfree(subreq);
+
+    ret = sdap_id_op_done(batch->op, ret, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* retry the current search base */
+        talloc_free(tmp_ctx);
+        ret = users_batch_retry(batch);
+        if (ret != EOK) {
+            users_batch_finish(batch, ret, DP_ERR_FATAL);
+        }
+        return;
+    }
+
+    if (ret == ENOENT) {
+        /* None of the users exist in this search base */
+        count = 0;
+        ret = EOK;
+    }
+
+    if (ret != EOK) {
+        talloc_free(tmp_ctx);
+        users_batch_finish(batch, ret, dp_error);
+        return;
+    }
+
+    ret = users_batch_match(tmp_ctx, batch, users, count,
+                            &matched, &num_matched);
+    if (ret != EOK) {
+        talloc_free(tmp_ctx);
+        users_batch_finish(batch, ret, DP_ERR_FATAL);
+        return;
+    }
+
+    if (num_matched > 0) {
+        ret = sdap_save_users(tmp_ctx, batch->sdom->dom->sysdb,
+                              batch->sdom->dom, batch->ctx->opts,
+                              matched, num_matched, NULL, NULL);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to store users [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            talloc_free(tmp_ctx);
+            users_batch_finish(batch, ret, DP_ERR_FATAL);
+            return;
+        }
+    }
+
+    users_batch_found(batch, matched, num_matched);
+    talloc_free(tmp_ctx);
+
+    batch->base_iter++;
+    if (batch->waiters == NULL
+            || batch->sdom->user_search_bases[batch->base_iter] == NULL) {
+        users_batch_finish(batch, EOK, DP_ERR_OK);
+        return;
+    }
+
+    ret = users_batch_next_base(batch);
+    if (ret != EOK) {
+        users_batch_finish(batch, ret, DP_ERR_FATAL);
+    }
+}
+
+static int users_batch_recv(struct tevent_req *req,
+                            int *dp_error_out,
+                            int *sdap_ret)
+{
+    struct users_batch_state *state = tevent_req_data(req,
+                                                   struct users_batch_state);
+
+    if (dp_error_out) {
+        *dp_error_out = state->dp_error;
+    }
+
+    if (sdap_ret) {
+        *sdap_ret = state->sdap_ret;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 /* =Groups-Related-Functions-(by-name,by-uid)============================= */
 
 struct groups_get_state {
@@ -1907,6 +2536,7 @@ struct sdap_account_info_handler_state {
 };
 
 static void sdap_account_info_handler_done(struct tevent_req *subreq);
+static void sdap_account_info_handler_batch_done(struct tevent_req *subreq);
 
 struct tevent_req *
 sdap_account_info_handler_send(TALLOC_CTX *mem_ctx,
@@ -1932,6 +2562,20 @@ sdap_account_info_handler_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
+    if (users_batch_eligible(id_ctx, id_ctx->opts->sdom, data)) {
+        subreq = users_batch_send(state, params->ev, id_ctx,
+                                  id_ctx->opts->sdom, id_ctx->conn,
+                                  data->filter_value);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        tevent_req_set_callback(subreq, sdap_account_info_handler_batch_done,
+                                req);
+        return req;
+    }
+
     subreq = sdap_handle_acct_req_send(state, params->be_ctx, data, id_ctx,
                                        id_ctx->opts->sdom, id_ctx->conn, true);
     if (subreq == NULL) {
@@ -1972,6 +2616,25 @@ static void sdap_account_info_handler_done(struct tevent_req *subreq)
     tevent_req_done(req);
 }
 
+static void sdap_account_info_handler_batch_done(struct tevent_req *subreq)
+{
+    struct sdap_account_info_handler_state *state;
+    struct tevent_req *req;
+    int dp_error;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_account_info_handler_state);
+
+    ret = users_batch_recv(subreq, &dp_error, NULL);
+    talloc_zfree(subreq);
+
+    /* TODO For backward compatibility we always return EOK to DP now. */
+    dp_reply_std_set(&state->reply, dp_error, ret,
+                     ret == EOK ? "Success" : "User lookup failed");
+    tevent_req_done(req);
+}
+
 errno_t sdap_account_info_handler_recv(TALLOC_CTX *mem_ctx,
                                        struct tevent_req *req,
                                        struct dp_reply_std *data)
@@ -21,6 +21,7 @@
 
 #include "util/util.h"
 #include "util/crypto/sss_crypto.h"
+#include "util/sss_attr_index.h"
 #include "confdb/confdb.h"
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap.h"
@@ -390,6 +391,66 @@ int sdap_get_map(TALLOC_CTX *memctx,
 
 static bool objectclass_matched(struct sdap_attr_map *map,
                                 const char *objcl, int len);
+
+/* Index of the LDAP attribute names of a map. The objectClass entry is left
+ * out, the same as when the map is scanned. */
+static struct sss_attr_index *sdap_map_index_new(TALLOC_CTX *mem_ctx,
+                                                 struct sdap_attr_map *map,
+                                                 int attrs_num)
+{
+    struct sss_attr_index *map_index;
+    errno_t ret;
+    int i;
+
+    map_index = sss_attr_index_new(mem_ctx, attrs_num);
+    if (map_index == NULL) {
+        return NULL;
+    }
+
+    for (i = 1; i < attrs_num; i++) {
+        /* check if this attr is valid with the chosen schema */
+        if (!map[i].name) continue;
+
+        ret = sss_attr_index_add(map_index, map[i].name, i);
+        if (ret != EOK) {
+            talloc_free(map_index);
+            return NULL;
+        }
+    }
+
+    return map_index;
+}
+
+/* Return the first map entry after @prev that maps LDAP attribute @attr or
+ * @attrs_num if there is none. Use @prev = 0 to start the search. */
+static int sdap_map_find_next(struct sdap_attr_map *map, int attrs_num,
+                              struct sss_attr_index *map_index,
+                              const char *attr, int prev)
+{
+    size_t pos;
+    int i;
+
+    if (map_index != NULL) {
+        if (prev == 0) {
+            if (!sss_attr_index_first(map_index, attr, &pos)) {
+                return attrs_num;
+            }
+        } else if (!sss_attr_index_next(map_index, prev, &pos)) {
+            return attrs_num;
+        }
+
+        return pos;
+    }
+
+    for (i = prev + 1; i < attrs_num; i++) {
+        /* check if this attr is valid with the chosen schema */
+        if (!map[i].name) continue;
+        /* check if it is an attr we are interested in */
+        if (strcasecmp(attr, map[i].name) == 0) break;
+    }
+
+    return i;
+}
 int sdap_parse_entry(TALLOC_CTX *memctx,
                      struct sdap_handle *sh, struct sdap_msg *sm,
                      struct sdap_attr_map *map, int attrs_num,
@@ -397,6 +458,7 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
                      bool disable_range_retrieval)
 {
     struct sysdb_attrs *attrs;
+    struct sss_attr_index *map_index = NULL;
     BerElement *ber = NULL;
     struct berval **vals;
     struct ldb_val v;
@@ -477,6 +539,14 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
             goto done;
         }
     }
+
+    if (map && str) {
+        /* Entries may have many attributes and each of them would be looked
+         * up in the map for every value. Failing to build the index is not
+         * fatal, the map is scanned then. */
+        map_index = sdap_map_index_new(tmp_ctx, map, attrs_num);
+    }
+
     while (str) {
         base64 = false;
 
@@ -502,12 +572,7 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
         }
 
         if (map) {
-            for (i = 1; i < attrs_num; i++) {
-                /* check if this attr is valid with the chosen schema */
-                if (!map[i].name) continue;
-                /* check if it is an attr we are interested in */
-                if (strcasecmp(base_attr, map[i].name) == 0) break;
-            }
+            i = sdap_map_find_next(map, attrs_num, map_index, base_attr, 0);
             /* interesting attr */
             if (i < attrs_num) {
                 store = true;
@@ -578,20 +643,16 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
                          * attrs in case there is a map. Find all that match
                          * and copy the value
                          */
-                        for (ai = base_attr_idx; ai < attrs_num; ai++) {
-                            /* check if this attr is valid with the chosen
-                             * schema */
-                            if (!map[ai].name) continue;
-
-                            /* check if it is an attr we are interested in */
-                            if (strcasecmp(base_attr, map[ai].name) == 0) {
-                                ret = sysdb_attrs_add_val(attrs,
-                                                          map[ai].sys_name,
-                                                          &v);
-                                if (ret) {
-                                    ldap_value_free_len(vals);
-                                    goto done;
-                                }
+                        for (ai = base_attr_idx; ai < attrs_num;
+                             ai = sdap_map_find_next(map, attrs_num,
+                                                     map_index, base_attr,
+                                                     ai)) {
+                            ret = sysdb_attrs_add_val(attrs,
+                                                      map[ai].sys_name,
+                                                      &v);
+                            if (ret) {
+                                ldap_value_free_len(vals);
+                                goto done;
                             }
                         }
                     } else {
@@ -234,6 +234,7 @@ enum sdap_basic_opt {
     SDAP_MAX_ID,
     SDAP_PWDLOCKOUT_DN,
     SDAP_WILDCARD_LIMIT,
+    SDAP_UID_BATCH_WINDOW,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
@@ -404,6 +404,7 @@ static int sdap_op_destructor(void *mem)
     struct sdap_op *op = (struct sdap_op *)mem;
 
     DLIST_REMOVE(op->sh->ops, op);
+    sss_req_pool_account(op, SSS_REQ_POOL_SDAP_OP);
 
     if (op->done) {
         DEBUG(SSSDBG_TRACE_INTERNAL, "Operation %d finished\n", op->msgid);
@@ -442,7 +443,11 @@ int sdap_op_add(TALLOC_CTX *memctx, struct tevent_context *ev,
 {
     struct sdap_op *op;
 
-    op = talloc_zero(memctx, struct sdap_op);
+    /* If request pools are enabled, the sdap_msg wrappers of the replies
+     * are carved from op's pool. The LDAPMessage itself is allocated by
+     * libldap. talloc does not reuse the space of a freed pool child, so
+     * once the pool is used up, later replies fall back to the heap. */
+    op = sss_req_pool_zero(memctx, struct sdap_op);
     if (!op) return ENOMEM;
 
     op->sh = sh;
@@ -1814,6 +1819,206 @@ int sdap_get_and_parse_generic_recv(struct tevent_req *req,
 }
 
 
+/* ==Generic Search streaming parsed entries in chunks================== */
+struct sdap_get_and_stream_generic_state {
+    struct sdap_attr_map *map;
+    int map_num_attrs;
+    struct sdap_options *opts;
+
+    size_t chunk_size;
+    sdap_stream_entries_cb entries_cb;
+    void *cb_pvt;
+
+    TALLOC_CTX *chunk_ctx;
+    struct sysdb_attrs **chunk;
+    size_t chunk_count;
+    size_t total_count;
+};
+
+static void sdap_get_and_stream_generic_done(struct tevent_req *subreq);
+static errno_t sdap_get_and_stream_generic_parse_entry(struct sdap_handle *sh,
+                                                       struct sdap_msg *msg,
+                                                       void *pvt);
+
+/* Unlike sdap_get_and_parse_generic_send() the entries are not kept until the
+ * search is finished. They are handed over to @entries_cb in chunks of
+ * @chunk_size entries (the LDAP page size if 0) and freed once the callback
+ * returns, so memory usage does not grow with the size of the result. */
+struct tevent_req *
+sdap_get_and_stream_generic_send(TALLOC_CTX *memctx,
+                                 struct tevent_context *ev,
+                                 struct sdap_options *opts,
+                                 struct sdap_handle *sh,
+                                 const char *search_base,
+                                 int scope,
+                                 const char *filter,
+                                 const char **attrs,
+                                 struct sdap_attr_map *map,
+                                 int map_num_attrs,
+                                 int sizelimit,
+                                 int timeout,
+                                 bool allow_paging,
+                                 size_t chunk_size,
+                                 sdap_stream_entries_cb entries_cb,
+                                 void *cb_pvt)
+{
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct sdap_get_and_stream_generic_state *state = NULL;
+    unsigned int flags = 0;
+
+    req = tevent_req_create(memctx, &state,
+                            struct sdap_get_and_stream_generic_state);
+    if (!req) return NULL;
+
+    state->map = map;
+    state->map_num_attrs = map_num_attrs;
+    state->opts = opts;
+    state->entries_cb = entries_cb;
+    state->cb_pvt = cb_pvt;
+
+    state->chunk_size = chunk_size;
+    if (state->chunk_size == 0) {
+        state->chunk_size = sh->page_size > 0 ? sh->page_size : 1000;
+    }
+
+    if (allow_paging) {
+        flags |= SDAP_SRCH_FLG_PAGING;
+    }
+
+    subreq = sdap_get_generic_ext_send(state, ev, opts, sh, search_base,
+                                       scope, filter, attrs, NULL, NULL,
+                                       sizelimit, timeout,
+                                       sdap_get_and_stream_generic_parse_entry,
+                                       state, flags);
+    if (!subreq) {
+        talloc_zfree(req);
+        return NULL;
+    }
+    tevent_req_set_callback(subreq, sdap_get_and_stream_generic_done, req);
+
+    return req;
+}
+
+static errno_t
+sdap_get_and_stream_generic_flush(struct sdap_get_and_stream_generic_state *state)
+{
+    errno_t ret;
+
+    if (state->chunk_count == 0) {
+        return EOK;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Passing a chunk of %zu entries\n",
+          state->chunk_count);
+
+    state->chunk[state->chunk_count] = NULL;
+    ret = state->entries_cb(state->chunk, state->chunk_count, state->cb_pvt);
+
+    state->total_count += state->chunk_count;
+    state->chunk_count = 0;
+    state->chunk = NULL;
+    talloc_zfree(state->chunk_ctx);
+
+    return ret;
+}
+
+static errno_t sdap_get_and_stream_generic_parse_entry(struct sdap_handle *sh,
+                                                       struct sdap_msg *msg,
+                                                       void *pvt)
+{
+    errno_t ret;
+    struct sysdb_attrs *attrs;
+    struct sdap_get_and_stream_generic_state *state =
+            talloc_get_type(pvt, struct sdap_get_and_stream_generic_state);
+
+    bool disable_range_rtrvl = dp_opt_get_bool(state->opts->basic,
+                                               SDAP_DISABLE_RANGE_RETRIEVAL);
+
+    if (state->chunk_ctx == NULL) {
+        state->chunk_ctx = talloc_new(state);
+        if (state->chunk_ctx == NULL) {
+            return ENOMEM;
+        }
+
+        state->chunk = talloc_array(state->chunk_ctx, struct sysdb_attrs *,
+                                    state->chunk_size + 1);
+        if (state->chunk == NULL) {
+            talloc_zfree(state->chunk_ctx);
+            return ENOMEM;
+        }
+    }
+
+    ret = sdap_parse_entry(state->chunk_ctx, sh, msg,
+                           state->map, state->map_num_attrs,
+                           &attrs, disable_range_rtrvl);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "sdap_parse_entry failed [%d]: %s\n", ret, strerror(ret));
+        return ret;
+    }
+
+    state->chunk[state->chunk_count] = attrs;
+    state->chunk_count++;
+
+    if (state->chunk_count >= state->chunk_size) {
+        ret = sdap_get_and_stream_generic_flush(state);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Unable to process entries [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+static void sdap_get_and_stream_generic_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_and_stream_generic_state *state =
+            tevent_req_data(req, struct sdap_get_and_stream_generic_state);
+    errno_t ret;
+
+    /* Referrals are ignored the same way as in the generic handler */
+    ret = sdap_get_generic_ext_recv(subreq, state, NULL, NULL);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "sdap_get_generic_ext_recv failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    /* Pass the last incomplete chunk */
+    ret = sdap_get_and_stream_generic_flush(state);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to process entries [%d]: %s\n",
+              ret, sss_strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+int sdap_get_and_stream_generic_recv(struct tevent_req *req,
+                                     size_t *_total_count)
+{
+    struct sdap_get_and_stream_generic_state *state = tevent_req_data(req,
+                                    struct sdap_get_and_stream_generic_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (_total_count != NULL) {
+        *_total_count = state->total_count;
+    }
+
+    return EOK;
+}
+
 /* ==Simple generic search============================================== */
 struct sdap_get_generic_state {
     size_t reply_count;
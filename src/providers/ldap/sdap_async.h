@@ -210,6 +210,34 @@ int sdap_get_and_parse_generic_recv(struct tevent_req *req,
                                     size_t *reply_count,
                                     struct sysdb_attrs ***reply);
 
+/* Called with parsed entries of a streamed search. The entries are freed
+ * when the callback returns unless they are stolen. */
+typedef errno_t (*sdap_stream_entries_cb)(struct sysdb_attrs **entries,
+                                          size_t count,
+                                          void *pvt);
+
+/* Like sdap_get_and_parse_generic_send() but passes the entries to
+ * @entries_cb in chunks instead of collecting the whole result */
+struct tevent_req *
+sdap_get_and_stream_generic_send(TALLOC_CTX *memctx,
+                                 struct tevent_context *ev,
+                                 struct sdap_options *opts,
+                                 struct sdap_handle *sh,
+                                 const char *search_base,
+                                 int scope,
+                                 const char *filter,
+                                 const char **attrs,
+                                 struct sdap_attr_map *map,
+                                 int map_num_attrs,
+                                 int sizelimit,
+                                 int timeout,
+                                 bool allow_paging,
+                                 size_t chunk_size,
+                                 sdap_stream_entries_cb entries_cb,
+                                 void *cb_pvt);
+int sdap_get_and_stream_generic_recv(struct tevent_req *req,
+                                     size_t *_total_count);
+
 struct tevent_req *sdap_get_generic_send(TALLOC_CTX *memctx,
                                          struct tevent_context *ev,
                                          struct sdap_options *opts,
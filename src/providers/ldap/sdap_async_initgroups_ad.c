@@ -531,18 +531,350 @@ done:
     return ret;
 }
 
+/* Maximum number of SIDs looked up with a single search */
+#define SDAP_AD_RESOLVE_SIDS_BATCH_SIZE 50
+/* Maximum number of searches running at the same time */
+#define SDAP_AD_RESOLVE_SIDS_MAX_REQS 4
+
+struct sdap_ad_resolve_sids_batch_state {
+    struct tevent_context *ev;
+    struct sdap_options *opts;
+    struct sdap_domain *sdom;
+    struct sdap_id_op *op;
+    const char **attrs;
+    char *base_filter;
+    char *filter;
+    int timeout;
+    size_t num_sids;
+
+    size_t base_iter;
+    struct sysdb_attrs **groups;
+    size_t count;
+};
+
+static errno_t sdap_ad_resolve_sids_batch_retry(struct tevent_req *req);
+static void sdap_ad_resolve_sids_batch_connect_done(struct tevent_req *subreq);
+static errno_t sdap_ad_resolve_sids_batch_next_base(struct tevent_req *req);
+static void sdap_ad_resolve_sids_batch_done(struct tevent_req *subreq);
+
+/* Search for the groups of the given SIDs with a single OR-ed filter and
+ * save the groups which are found without their members, like
+ * groups_get_send() does with BE_FILTER_SECID for a single SID. */
+static struct tevent_req *
+sdap_ad_resolve_sids_batch_send(TALLOC_CTX *mem_ctx,
+                                struct tevent_context *ev,
+                                struct sdap_id_conn_ctx *conn,
+                                struct sdap_options *opts,
+                                struct sdap_domain *sdom,
+                                const char **sids,
+                                size_t num_sids)
+{
+    struct sdap_ad_resolve_sids_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    const char *member_filter[2];
+    char *sid_filter = NULL;
+    char *clean_sid = NULL;
+    char *oc_list = NULL;
+    size_t i;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_ad_resolve_sids_batch_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->opts = opts;
+    state->sdom = sdom;
+    state->num_sids = num_sids;
+    state->timeout = dp_opt_get_int(opts->basic, SDAP_SEARCH_TIMEOUT);
+
+    state->op = sdap_id_op_create(state, conn->conn_cache);
+    if (state->op == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed\n");
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    sid_filter = talloc_strdup(state, "");
+    if (sid_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    for (i = 0; i < num_sids; i++) {
+        ret = sss_filter_sanitize(state, sids[i], &clean_sid);
+        if (ret != EOK) {
+            goto immediately;
+        }
+
+        sid_filter = talloc_asprintf_append_buffer(sid_filter, "(%s=%s)",
+                            opts->group_map[SDAP_AT_GROUP_OBJECTSID].name,
+                            clean_sid);
+        talloc_zfree(clean_sid);
+        if (sid_filter == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+    }
+
+    oc_list = sdap_make_oc_list(state, opts->group_map);
+    if (oc_list == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create objectClass list.\n");
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    state->base_filter = talloc_asprintf(state, "(&(|%s)(%s)(%s=*))",
+                                sid_filter, oc_list,
+                                opts->group_map[SDAP_AT_GROUP_NAME].name);
+    talloc_zfree(sid_filter);
+    talloc_zfree(oc_list);
+    if (state->base_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    member_filter[0] = opts->group_map[SDAP_AT_GROUP_MEMBER].name;
+    member_filter[1] = NULL;
+
+    ret = build_attrs_from_map(state, opts->group_map, SDAP_OPTS_GROUP,
+                               member_filter, &state->attrs, NULL);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    ret = sdap_ad_resolve_sids_batch_retry(req);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t sdap_ad_resolve_sids_batch_retry(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_batch_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+    errno_t ret = EOK;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    state->base_iter = 0;
+    state->count = 0;
+    talloc_zfree(state->groups);
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (subreq == NULL) {
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_batch_connect_done,
+                            req);
+
+    return EOK;
+}
+
+static void sdap_ad_resolve_sids_batch_connect_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = NULL;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = sdap_ad_resolve_sids_batch_next_base(req);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+}
+
+static errno_t sdap_ad_resolve_sids_batch_next_base(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_batch_state *state = NULL;
+    struct sdap_search_base *base = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    base = state->sdom->group_search_bases[state->base_iter];
+
+    talloc_zfree(state->filter);
+    state->filter = sdap_combine_filters(state, state->base_filter,
+                                         base->filter);
+    if (state->filter == NULL) {
+        return ENOMEM;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Searching for %zu SIDs with base [%s]\n",
+                             state->num_sids, base->basedn);
+
+    subreq = sdap_get_generic_send(state, state->ev, state->opts,
+                                   sdap_id_op_handle(state->op),
+                                   base->basedn, base->scope,
+                                   state->filter, state->attrs,
+                                   state->opts->group_map, SDAP_OPTS_GROUP,
+                                   state->timeout, false);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_batch_done, req);
+
+    return EOK;
+}
+
+static errno_t
+sdap_ad_resolve_sids_batch_save(struct sdap_ad_resolve_sids_batch_state *state)
+{
+    char **groupnames = NULL;
+    errno_t ret;
+
+    if (state->count == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "None of the %zu SIDs was found\n",
+                                 state->num_sids);
+        return EOK;
+    }
+
+    ret = sysdb_attrs_primary_fqdn_list(state->sdom->dom, state,
+                              state->groups, state->count,
+                              state->opts->group_map[SDAP_AT_GROUP_NAME].name,
+                              &groupnames);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sysdb_attrs_primary_fqdn_list failed.\n");
+        return ret;
+    }
+
+    /* All groups of the batch are written in a single transaction */
+    ret = sdap_add_incomplete_groups(state->sdom->dom->sysdb,
+                                     state->sdom->dom, state->opts,
+                                     groupnames, state->groups, state->count);
+    talloc_free(groupnames);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_add_incomplete_groups failed.\n");
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Resolved %zu of %zu SIDs\n",
+                             state->count, state->num_sids);
+
+    return EOK;
+}
+
+static void sdap_ad_resolve_sids_batch_done(struct tevent_req *subreq)
+{
+    struct sdap_ad_resolve_sids_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    struct sysdb_attrs **groups = NULL;
+    size_t count = 0;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    ret = sdap_get_generic_recv(subreq, state, &count, &groups);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        ret = sdap_id_op_done(state->op, ret, &dp_error);
+        if (dp_error == DP_ERR_OK && ret != EOK) {
+            /* retry */
+            ret = sdap_ad_resolve_sids_batch_retry(req);
+            if (ret == EOK) {
+                return;
+            }
+        }
+
+        tevent_req_error(req, ret != EOK ? ret : EIO);
+        return;
+    }
+
+    if (count > 0) {
+        state->groups = talloc_realloc(state, state->groups,
+                                       struct sysdb_attrs *,
+                                       state->count + count + 1);
+        if (state->groups == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+
+        state->count += sdap_steal_objects_in_dom(state->opts, state->groups,
+                                                  state->count,
+                                                  state->sdom->dom,
+                                                  groups, count, true);
+        state->groups[state->count] = NULL;
+    }
+    talloc_free(groups);
+
+    /* The groups may be spread over several search bases */
+    state->base_iter++;
+    if (state->count < state->num_sids
+            && state->sdom->group_search_bases[state->base_iter] != NULL) {
+        ret = sdap_ad_resolve_sids_batch_next_base(req);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    ret = sdap_id_op_done(state->op, EOK, &dp_error);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = sdap_ad_resolve_sids_batch_save(state);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t sdap_ad_resolve_sids_batch_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+struct sdap_ad_resolve_sids_batch {
+    struct sdap_domain *sdom;
+    const char *sids[SDAP_AD_RESOLVE_SIDS_BATCH_SIZE];
+    size_t num_sids;
+};
+
 struct sdap_ad_resolve_sids_state {
     struct tevent_context *ev;
-    struct sdap_id_ctx *id_ctx;
     struct sdap_id_conn_ctx *conn;
     struct sdap_options *opts;
     struct sss_domain_info *domain;
-    char **sids;
 
-    const char *current_sid;
-    int index;
+    struct sdap_ad_resolve_sids_batch *batches;
+    size_t num_batches;
+    size_t next_batch;
+    size_t num_reqs;
 };
 
+static errno_t sdap_ad_resolve_sids_group(struct tevent_req *req,
+                                          char **sids);
 static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req);
 static void sdap_ad_resolve_sids_done(struct tevent_req *subreq);
 
@@ -567,18 +899,20 @@ sdap_ad_resolve_sids_send(TALLOC_CTX *mem_ctx,
     }
 
     state->ev = ev;
-    state->id_ctx = id_ctx;
     state->conn = conn;
     state->opts = opts;
     state->domain = get_domains_head(domain);
-    state->sids = sids;
-    state->index = 0;
 
-    if (state->sids == NULL || state->sids[0] == NULL) {
+    if (sids == NULL || sids[0] == NULL) {
         ret = EOK;
         goto immediately;
     }
 
+    ret = sdap_ad_resolve_sids_group(req, sids);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
     ret = sdap_ad_resolve_sids_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -597,80 +931,119 @@ immediately:
     return req;
 }
 
-static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req)
+/* Split the SIDs into batches of SIDs from the same domain */
+static errno_t sdap_ad_resolve_sids_group(struct tevent_req *req,
+                                          char **sids)
 {
     struct sdap_ad_resolve_sids_state *state = NULL;
-    struct tevent_req *subreq = NULL;
-    struct sdap_domain *sdap_domain = NULL;
+    struct sdap_ad_resolve_sids_batch *batch = NULL;
+    struct sdap_domain *sdom = NULL;
     struct sss_domain_info *domain = NULL;
+    size_t num_sids;
+    size_t i;
+    size_t j;
 
     state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
 
-    do {
-        state->current_sid = state->sids[state->index];
-        if (state->current_sid == NULL) {
-            return EOK;
-        }
-        state->index++;
+    for (num_sids = 0; sids[num_sids] != NULL; num_sids++);
 
-        domain = sss_get_domain_by_sid_ldap_fallback(state->domain,
-                                                     state->current_sid);
+    /* Each SID needs at most one batch */
+    state->batches = talloc_zero_array(state,
+                                       struct sdap_ad_resolve_sids_batch,
+                                       num_sids);
+    if (state->batches == NULL) {
+        return ENOMEM;
+    }
 
+    for (i = 0; i < num_sids; i++) {
+        domain = sss_get_domain_by_sid_ldap_fallback(state->domain, sids[i]);
         if (domain == NULL) {
             DEBUG(SSSDBG_MINOR_FAILURE, "SID %s does not belong to any known "
-                                         "domain\n", state->current_sid);
+                                         "domain\n", sids[i]);
+            continue;
         }
-    } while (domain == NULL);
 
-    sdap_domain = sdap_domain_get(state->opts, domain);
-    if (sdap_domain == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
-        return ERR_INTERNAL;
-    }
+        sdom = sdap_domain_get(state->opts, domain);
+        if (sdom == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
+            return ERR_INTERNAL;
+        }
 
-    subreq = groups_get_send(state, state->ev, state->id_ctx, sdap_domain,
-                             state->conn, state->current_sid,
-                             BE_FILTER_SECID, false, true);
-    if (subreq == NULL) {
-        return ENOMEM;
+        /* Only the last batch of a domain can have free slots */
+        batch = NULL;
+        for (j = state->num_batches; j > 0; j--) {
+            if (state->batches[j - 1].sdom == sdom) {
+                batch = &state->batches[j - 1];
+                break;
+            }
+        }
+
+        if (batch == NULL
+                || batch->num_sids == SDAP_AD_RESOLVE_SIDS_BATCH_SIZE) {
+            batch = &state->batches[state->num_batches];
+            batch->sdom = sdom;
+            state->num_batches++;
+        }
+
+        batch->sids[batch->num_sids] = sids[i];
+        batch->num_sids++;
     }
 
-    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_done, req);
+    DEBUG(SSSDBG_TRACE_FUNC, "Resolving %zu SIDs in %zu batches\n",
+                             num_sids, state->num_batches);
 
-    return EAGAIN;
+    return EOK;
+}
+
+static errno_t sdap_ad_resolve_sids_step(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_state *state = NULL;
+    struct sdap_ad_resolve_sids_batch *batch = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
+
+    while (state->next_batch < state->num_batches
+            && state->num_reqs < SDAP_AD_RESOLVE_SIDS_MAX_REQS) {
+        batch = &state->batches[state->next_batch];
+        state->next_batch++;
+
+        subreq = sdap_ad_resolve_sids_batch_send(state, state->ev,
+                                                 state->conn, state->opts,
+                                                 batch->sdom, batch->sids,
+                                                 batch->num_sids);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+
+        tevent_req_set_callback(subreq, sdap_ad_resolve_sids_done, req);
+        state->num_reqs++;
+    }
+
+    return state->num_reqs == 0 ? EOK : EAGAIN;
 }
 
 static void sdap_ad_resolve_sids_done(struct tevent_req *subreq)
 {
     struct sdap_ad_resolve_sids_state *state = NULL;
     struct tevent_req *req = NULL;
-    int dp_error;
-    int sdap_error;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
 
-    ret = groups_get_recv(subreq, &dp_error, &sdap_error);
+    ret = sdap_ad_resolve_sids_batch_recv(subreq);
     talloc_zfree(subreq);
-
-    if (ret == EOK && sdap_error == ENOENT && dp_error == DP_ERR_OK) {
-        /* Group was not found, we will ignore the error and continue with
-         * next group. This may happen for example if the group is built-in,
-         * but a custom search base is provided. */
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "Unable to resolve SID %s - will try next sid.\n",
-              state->current_sid);
-    } else if (ret != EOK || sdap_error != EOK || dp_error != DP_ERR_OK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to resolve SID %s [dp_error: %d, "
-              "sdap_error: %d, ret: %d]: %s\n", state->current_sid, dp_error,
-              sdap_error, ret, strerror(ret));
+    state->num_reqs--;
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to resolve SIDs [%d]: %s\n",
+                                   ret, sss_strerror(ret));
         goto done;
     }
 
     ret = sdap_ad_resolve_sids_step(req);
     if (ret == EAGAIN) {
-        /* continue with next SID */
+        /* continue with next batch */
         return;
     }
 
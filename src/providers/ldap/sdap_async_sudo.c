@@ -595,11 +595,13 @@ static void sdap_sudo_refresh_done(struct tevent_req *subreq)
     }
     in_transaction = true;
 
-    /* purge cache */
-    ret = sysdb_sudo_purge(state->domain, state->delete_filter,
-                           rules, rules_count);
-    if (ret != EOK) {
-        goto done;
+    /* purge cache, the received rules are replaced in place when stored */
+    if (state->delete_filter != NULL) {
+        ret = sysdb_sudo_purge(state->domain, state->delete_filter,
+                               rules, rules_count);
+        if (ret != EOK) {
+            goto done;
+        }
     }
 
     /* store rules */
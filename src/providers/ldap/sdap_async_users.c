@@ -919,6 +919,214 @@ int sdap_search_user_recv(TALLOC_CTX *memctx, struct tevent_req *req,
     return EOK;
 }
 
+/* ==Search-And-Save-Users-in-chunks===================================== */
+
+/* Used for enumeration where the whole result would not fit in memory. The
+ * users are saved chunk by chunk as they are received from the server. */
+struct sdap_stream_users_state {
+    struct tevent_context *ev;
+    struct sdap_options *opts;
+    struct sdap_handle *sh;
+    struct sss_domain_info *dom;
+    struct sysdb_ctx *sysdb;
+    struct sysdb_attrs *mapped_attrs;
+
+    const char **attrs;
+    const char *base_filter;
+    char *filter;
+    int timeout;
+
+    char *higher_usn;
+    size_t count;
+
+    size_t base_iter;
+    struct sdap_search_base **search_bases;
+};
+
+static errno_t sdap_stream_users_next_base(struct tevent_req *req);
+static errno_t sdap_stream_users_save(struct sysdb_attrs **users,
+                                      size_t count,
+                                      void *pvt);
+static void sdap_stream_users_process(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_stream_users_send(TALLOC_CTX *memctx,
+                       struct tevent_context *ev,
+                       struct sss_domain_info *dom,
+                       struct sysdb_ctx *sysdb,
+                       struct sdap_options *opts,
+                       struct sdap_search_base **search_bases,
+                       struct sdap_handle *sh,
+                       const char **attrs,
+                       const char *filter,
+                       int timeout,
+                       struct sysdb_attrs *mapped_attrs)
+{
+    errno_t ret;
+    struct tevent_req *req;
+    struct sdap_stream_users_state *state;
+
+    req = tevent_req_create(memctx, &state, struct sdap_stream_users_state);
+    if (req == NULL) return NULL;
+
+    state->ev = ev;
+    state->opts = opts;
+    state->dom = dom;
+    state->sysdb = sysdb;
+    state->sh = sh;
+    state->attrs = attrs;
+    state->base_filter = filter;
+    state->timeout = timeout;
+    state->mapped_attrs = mapped_attrs;
+    state->search_bases = search_bases;
+
+    if (!state->search_bases) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "User lookup request without a search base\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    ret = sdap_stream_users_next_base(req);
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        tevent_req_post(req, state->ev);
+    }
+
+    return req;
+}
+
+static errno_t sdap_stream_users_next_base(struct tevent_req *req)
+{
+    struct tevent_req *subreq;
+    struct sdap_stream_users_state *state;
+
+    state = tevent_req_data(req, struct sdap_stream_users_state);
+
+    talloc_zfree(state->filter);
+    state->filter = sdap_combine_filters(state, state->base_filter,
+                        state->search_bases[state->base_iter]->filter);
+    if (state->filter == NULL) {
+        return ENOMEM;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Streaming users with base [%s]\n",
+           state->search_bases[state->base_iter]->basedn);
+
+    subreq = sdap_get_and_stream_generic_send(
+            state, state->ev, state->opts, state->sh,
+            state->search_bases[state->base_iter]->basedn,
+            state->search_bases[state->base_iter]->scope,
+            state->filter, state->attrs,
+            state->opts->user_map, state->opts->user_map_cnt,
+            0, state->timeout, true, 0,
+            sdap_stream_users_save, state);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(subreq, sdap_stream_users_process, req);
+
+    return EOK;
+}
+
+static errno_t sdap_stream_users_save(struct sysdb_attrs **users,
+                                      size_t count,
+                                      void *pvt)
+{
+    struct sdap_stream_users_state *state;
+    char *usn_value = NULL;
+    errno_t ret;
+
+    state = talloc_get_type(pvt, struct sdap_stream_users_state);
+
+    ret = sdap_save_users(state, state->sysdb, state->dom, state->opts,
+                          users, count, state->mapped_attrs, &usn_value);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to store users [%d][%s].\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    state->count += count;
+
+    if (usn_value != NULL) {
+        if (state->higher_usn == NULL
+                || (strlen(usn_value) > strlen(state->higher_usn))
+                || (strcmp(usn_value, state->higher_usn) > 0)) {
+            talloc_zfree(state->higher_usn);
+            state->higher_usn = usn_value;
+        } else {
+            talloc_zfree(usn_value);
+        }
+    }
+
+    return EOK;
+}
+
+static void sdap_stream_users_process(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_stream_users_state *state = tevent_req_data(req,
+                                            struct sdap_stream_users_state);
+    size_t count;
+    int ret;
+
+    ret = sdap_get_and_stream_generic_recv(subreq, &count);
+    talloc_zfree(subreq);
+    if (ret) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Search for users, returned %zu results.\n", count);
+
+    state->base_iter++;
+    if (state->search_bases[state->base_iter]) {
+        /* There are more search bases to try */
+        ret = sdap_stream_users_next_base(req);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Retrieved total %zu users\n", state->count);
+
+    /* Return ENOENT if no users were found */
+    if (state->count == 0) {
+        tevent_req_error(req, ENOENT);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static int sdap_stream_users_recv(TALLOC_CTX *memctx,
+                                  struct tevent_req *req,
+                                  char **higher_usn,
+                                  size_t *count)
+{
+    struct sdap_stream_users_state *state = tevent_req_data(req,
+                                            struct sdap_stream_users_state);
+
+    if (higher_usn) {
+        *higher_usn = talloc_steal(memctx, state->higher_usn);
+    }
+
+    if (count) {
+        *count = state->count;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 /* ==Search-And-Save-Users-with-filter============================================= */
 struct sdap_get_users_state {
     struct sysdb_ctx *sysdb;
@@ -933,6 +1141,7 @@ struct sdap_get_users_state {
 };
 
 static void sdap_get_users_done(struct tevent_req *subreq);
+static void sdap_get_users_stream_done(struct tevent_req *subreq);
 
 struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
                                        struct tevent_context *ev,
@@ -979,6 +1188,22 @@ struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
         }
     }
 
+    if (lookup_type == SDAP_LOOKUP_ENUMERATE) {
+        /* Save the users as they arrive instead of holding the whole
+         * enumeration result in memory */
+        subreq = sdap_stream_users_send(state, ev, dom, sysdb, opts,
+                                        search_bases, sh, attrs, filter,
+                                        timeout, state->mapped_attrs);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        tevent_req_set_callback(subreq, sdap_get_users_stream_done, req);
+
+        ret = EOK;
+        goto done;
+    }
+
     subreq = sdap_search_user_send(state, ev, dom, opts, search_bases,
                                    sh, attrs, filter, timeout, lookup_type);
     if (subreq == NULL) {
@@ -1036,6 +1261,31 @@ static void sdap_get_users_done(struct tevent_req *subreq)
     tevent_req_done(req);
 }
 
+static void sdap_get_users_stream_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_users_state *state = tevent_req_data(req,
+                                            struct sdap_get_users_state);
+    int ret;
+
+    ret = sdap_stream_users_recv(state, subreq, &state->higher_usn,
+                                 &state->count);
+    talloc_zfree(subreq);
+    if (ret) {
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to retrieve users [%d][%s].\n",
+                  ret, sss_strerror(ret));
+        }
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Saving %zu Users - Done\n", state->count);
+
+    tevent_req_done(req);
+}
+
 int sdap_get_users_recv(struct tevent_req *req,
                         TALLOC_CTX *mem_ctx, char **usn_value)
 {
@@ -96,11 +96,15 @@ struct authtok_conv {
     bool sent_old;
 };
 
+struct proxy_id_workers;
+
 struct proxy_id_ctx {
     struct be_ctx *be;
     bool fast_alias;
     struct proxy_nss_ops ops;
     void *handle;
+    /* pool of proxy_id_child processes, NULL if lookups run in-process */
+    struct proxy_id_workers *workers;
 };
 
 struct proxy_auth_ctx {
@@ -145,6 +149,42 @@ struct pc_init_ctx {
 #define DEFAULT_BUFSIZE 4096
 #define MAX_BUF_SIZE 1024*1024 /* max 1MiB */
 
+/* proxy_id_child protocol
+ *
+ * Request: uint32_t length of the rest, uint32_t operation, uint32_t id and
+ * a NUL-terminated name (empty for lookups by id).
+ *
+ * Response: uint32_t length of the rest, uint32_t number of records and the
+ * records. Each record describes one call of the NSS module: uint32_t call,
+ * uint32_t id, NUL-terminated name, int32_t nss_status, uint32_t errno and,
+ * if the call succeeded, the result:
+ *  - passwd: uid, gid, name, passwd, gecos, dir, shell
+ *  - group: gid, number of members, name, passwd, members
+ *  - initgroups: number of groups, gids
+ * A call which is retried with a larger buffer is recorded each time, the
+ * last record is the final result.
+ */
+#define PROXY_ID_CHILD_OUT_FILENO 3
+#define PROXY_ID_CHILD_IDLE_TIMEOUT 300
+#define PROXY_ID_CHILD_MAX_REQUEST_SIZE 4096
+#define PROXY_ID_CHILD_MAX_RESPONSE_SIZE (64 * 1024 * 1024)
+
+enum proxy_id_child_op {
+    PROXY_ID_CHILD_USER_BY_NAME = 1,
+    PROXY_ID_CHILD_USER_BY_ID,
+    PROXY_ID_CHILD_GROUP_BY_NAME,
+    PROXY_ID_CHILD_GROUP_BY_ID,
+    PROXY_ID_CHILD_INITGROUPS,
+};
+
+enum proxy_id_child_call {
+    PROXY_ID_CHILD_GETPWNAM = 1,
+    PROXY_ID_CHILD_GETPWUID,
+    PROXY_ID_CHILD_GETGRNAM,
+    PROXY_ID_CHILD_GETGRGID,
+    PROXY_ID_CHILD_INITGROUPS_DYN,
+};
+
 /* From proxy_id.c */
 struct tevent_req *
 proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
@@ -156,6 +196,98 @@ errno_t proxy_account_info_handler_recv(TALLOC_CTX *mem_ctx,
                                        struct tevent_req *req,
                                        struct dp_reply_std *data);
 
+struct dp_reply_std
+proxy_account_info(TALLOC_CTX *mem_ctx,
+                   struct proxy_id_ctx *ctx,
+                   struct dp_id_data *data,
+                   struct be_ctx *be_ctx,
+                   struct sss_domain_info *domain);
+
+/* From proxy_id_nss.c */
+
+/* Returns the name of the cached entry with the given ID, or NULL if it is
+ * not cached, to canonicalize aliases without another lookup. */
+typedef const char *(*proxy_nss_cached_name_fn)(TALLOC_CTX *mem_ctx,
+                                                struct sss_domain_info *dom,
+                                                uint32_t id);
+
+struct proxy_nss_user {
+    /* result of getpwnam_r(), NULL for lookups by ID */
+    struct passwd *pwnam;
+    /* the user to save, the result of getpwuid_r() unless the canonical
+     * name was found in the cache */
+    struct passwd *pwd;
+    const char *cached_name;
+    /* ID of the user to delete, 0 if getpwnam_r() did not find it */
+    uid_t uid;
+    bool del_user;
+};
+
+struct proxy_nss_group {
+    struct group *grp;
+    const char *cached_name;
+    /* ID of the group to delete, 0 if getgrnam_r() did not find it */
+    gid_t gid;
+    bool del_group;
+};
+
+errno_t proxy_nss_user_by_name(TALLOC_CTX *mem_ctx,
+                               struct proxy_nss_ops *ops,
+                               struct sss_domain_info *dom,
+                               const char *name,
+                               proxy_nss_cached_name_fn cached_name,
+                               struct proxy_nss_user **_user);
+
+errno_t proxy_nss_user_by_uid(TALLOC_CTX *mem_ctx,
+                              struct proxy_nss_ops *ops,
+                              struct sss_domain_info *dom,
+                              uid_t uid,
+                              struct proxy_nss_user **_user);
+
+errno_t proxy_nss_group_by_name(TALLOC_CTX *mem_ctx,
+                                struct proxy_nss_ops *ops,
+                                struct sss_domain_info *dom,
+                                const char *name,
+                                proxy_nss_cached_name_fn cached_name,
+                                struct proxy_nss_group **_group);
+
+errno_t proxy_nss_group_by_gid(TALLOC_CTX *mem_ctx,
+                               struct proxy_nss_ops *ops,
+                               struct sss_domain_info *dom,
+                               gid_t gid,
+                               struct proxy_nss_group **_group);
+
+errno_t proxy_nss_initgroups(TALLOC_CTX *mem_ctx,
+                             struct proxy_nss_ops *ops,
+                             struct passwd *pwd,
+                             gid_t **_gids,
+                             long int *_num_gids);
+
+/* From proxy_id_record.c, req is the request without its length */
+errno_t proxy_id_record(TALLOC_CTX *mem_ctx,
+                        struct proxy_nss_ops *ops,
+                        uint8_t *req, size_t req_len,
+                        uint8_t **_resp, size_t *_resp_len);
+
+/* From proxy_id_workers.c */
+errno_t proxy_id_workers_init(TALLOC_CTX *mem_ctx,
+                              struct proxy_id_ctx *id_ctx,
+                              const char *libname,
+                              int max_children,
+                              struct proxy_id_workers **_workers);
+
+bool proxy_id_workers_supported(struct proxy_id_ctx *id_ctx,
+                                struct dp_id_data *data);
+
+struct tevent_req *
+proxy_id_workers_lookup_send(TALLOC_CTX *mem_ctx,
+                             struct tevent_context *ev,
+                             struct proxy_id_workers *workers,
+                             struct dp_id_data *data);
+
+errno_t proxy_id_workers_lookup_recv(struct tevent_req *req,
+                                     struct dp_reply_std *_reply);
+
 /* From proxy_auth.c */
 struct tevent_req *
 proxy_pam_handler_send(TALLOC_CTX *mem_ctx,
@@ -35,28 +35,45 @@ static int save_user(struct sss_domain_info *domain,
                      struct passwd *pwd, const char *real_name,
                      const char *alias);
 
-static int
-handle_getpw_result(enum nss_status status, struct passwd *pwd,
-                    struct sss_domain_info *dom, bool *del_user);
-
 static int
 delete_user(struct sss_domain_info *domain,
             const char *name, uid_t uid);
 
+static const char *cached_user_name(TALLOC_CTX *mem_ctx,
+                                    struct sss_domain_info *dom,
+                                    uint32_t uid)
+{
+    struct ldb_result *cached_pwd = NULL;
+    const char *real_name = NULL;
+    errno_t ret;
+
+    ret = sysdb_getpwuid(mem_ctx, dom, uid, &cached_pwd);
+    if (ret != EOK) {
+        /* Non-fatal, attempt to canonicalize online */
+        DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
+              ret, strerror(ret));
+        return NULL;
+    }
+
+    if (cached_pwd->count == 1) {
+        real_name = ldb_msg_find_attr_as_string(cached_pwd->msgs[0],
+                                                SYSDB_NAME, NULL);
+        if (!real_name) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Cached user has no name?\n");
+        }
+    }
+
+    return real_name;
+}
+
 static int get_pw_name(struct proxy_id_ctx *ctx,
                        struct sss_domain_info *dom,
                        const char *i_name)
 {
     TALLOC_CTX *tmpctx;
-    struct passwd *pwd;
-    enum nss_status status;
-    char *buffer;
-    size_t buflen;
+    struct proxy_nss_user *user;
     int ret;
-    uid_t uid;
-    bool del_user;
-    struct ldb_result *cached_pwd = NULL;
-    const char *real_name = NULL;
+    const char *real_name;
     char *shortname_or_alias;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Searching user by name (%s)\n", i_name);
@@ -71,80 +88,31 @@ static int get_pw_name(struct proxy_id_ctx *ctx,
         goto done;
     }
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    /* FIXME: should we move this call outside the transaction to keep the
-     * transaction as short as possible ? */
-    status = ctx->ops.getpwnam_r(shortname_or_alias, pwd, buffer, buflen, &ret);
-    ret = handle_getpw_result(status, pwd, dom, &del_user);
+    /* Canonicalize the username in case it was actually an alias */
+    ret = proxy_nss_user_by_name(tmpctx, &ctx->ops, dom, shortname_or_alias,
+                                 ctx->fast_alias ? cached_user_name : NULL,
+                                 &user);
     if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "getpwnam failed [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    if (del_user) {
-        ret = delete_user(dom, i_name, 0);
+    if (user->del_user) {
+        ret = delete_user(dom, i_name, user->uid);
         goto done;
     }
 
-    uid = pwd->pw_uid;
-
-    /* Canonicalize the username in case it was actually an alias */
-
-    if (ctx->fast_alias == true) {
-        ret = sysdb_getpwuid(tmpctx, dom, uid, &cached_pwd);
-        if (ret != EOK) {
-            /* Non-fatal, attempt to canonicalize online */
-            DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
-                  ret, strerror(ret));
-        }
-
-        if (ret == EOK && cached_pwd->count == 1) {
-            real_name = ldb_msg_find_attr_as_string(cached_pwd->msgs[0],
-                                                    SYSDB_NAME, NULL);
-            if (!real_name) {
-                DEBUG(SSSDBG_MINOR_FAILURE, "Cached user has no name?\n");
-            }
-        }
-    }
-
+    real_name = user->cached_name;
     if (real_name == NULL) {
-        memset(buffer, 0, buflen);
-
-        status = ctx->ops.getpwuid_r(uid, pwd, buffer, buflen, &ret);
-        ret = handle_getpw_result(status, pwd, dom, &del_user);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                "getpwuid failed [%d]: %s\n", ret, strerror(ret));
-            goto done;
-        }
-
-        real_name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
+        real_name = sss_create_internal_fqname(tmpctx, user->pwd->pw_name,
+                                               dom->name);
         if (real_name == NULL) {
             ret = ENOMEM;
             goto done;
         }
     }
 
-    if (del_user) {
-        ret = delete_user(dom, i_name, uid);
-        goto done;
-    }
-
     /* Both lookups went fine, we can save the user now */
-    ret = save_user(dom, pwd, real_name, i_name);
+    ret = save_user(dom, user->pwd, real_name, i_name);
 
 done:
     talloc_zfree(tmpctx);
@@ -156,56 +124,6 @@ done:
     return ret;
 }
 
-static int
-handle_getpw_result(enum nss_status status, struct passwd *pwd,
-                    struct sss_domain_info *dom, bool *del_user)
-{
-    int ret = EOK;
-
-    if (!del_user) {
-        return EINVAL;
-    }
-    *del_user = false;
-
-    switch (status) {
-    case NSS_STATUS_NOTFOUND:
-
-        DEBUG(SSSDBG_MINOR_FAILURE, "User not found.\n");
-        *del_user = true;
-        break;
-
-    case NSS_STATUS_SUCCESS:
-
-        DEBUG(SSSDBG_TRACE_FUNC, "User found: (%s, %"SPRIuid", %"SPRIgid")\n",
-              pwd->pw_name, pwd->pw_uid, pwd->pw_gid);
-
-        /* uid=0 or gid=0 are invalid values */
-        /* also check that the id is in the valid range for this domain */
-        if (OUT_OF_ID_RANGE(pwd->pw_uid, dom->id_min, dom->id_max) ||
-            OUT_OF_ID_RANGE(pwd->pw_gid, dom->id_min, dom->id_max)) {
-
-            DEBUG(SSSDBG_MINOR_FAILURE,
-                  "User filtered out! (id out of range)\n");
-            *del_user = true;
-            break;
-        }
-        break;
-
-    case NSS_STATUS_UNAVAIL:
-        DEBUG(SSSDBG_MINOR_FAILURE,
-              "Remote back end is not available. Entering offline mode\n");
-        ret = ENXIO;
-        break;
-
-    default:
-        DEBUG(SSSDBG_OP_FAILURE, "Unknown return code %d\n", status);
-        ret = EIO;
-        break;
-    }
-
-    return ret;
-}
-
 static int
 delete_user(struct sss_domain_info *domain,
             const char *name, uid_t uid)
@@ -343,11 +261,7 @@ static int get_pw_uid(struct proxy_id_ctx *ctx,
                       uid_t uid)
 {
     TALLOC_CTX *tmpctx;
-    struct passwd *pwd;
-    enum nss_status status;
-    char *buffer;
-    size_t buflen;
-    bool del_user = false;
+    struct proxy_nss_user *user;
     int ret;
     char *name;
 
@@ -358,39 +272,23 @@ static int get_pw_uid(struct proxy_id_ctx *ctx,
         return ENOMEM;
     }
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    status = ctx->ops.getpwuid_r(uid, pwd, buffer, buflen, &ret);
-    ret = handle_getpw_result(status, pwd, dom, &del_user);
+    ret = proxy_nss_user_by_uid(tmpctx, &ctx->ops, dom, uid, &user);
     if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "getpwuid failed [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    if (del_user) {
+    if (user->del_user) {
         ret = delete_user(dom, NULL, uid);
         goto done;
     }
 
-    name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
+    name = sss_create_internal_fqname(tmpctx, user->pwd->pw_name, dom->name);
     if (name == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "failed to qualify name '%s'\n",
-              pwd->pw_name);
+              user->pwd->pw_name);
         goto done;
     }
-    ret = save_user(dom, pwd, name, NULL);
+    ret = save_user(dom, user->pwd, name, NULL);
 
 done:
     talloc_zfree(tmpctx);
@@ -876,71 +774,31 @@ done:
 }
 
 /* =Getgrnam-wrapper======================================================*/
-static char *
-grow_group_buffer(TALLOC_CTX *mem_ctx,
-                  char **buffer, size_t *buflen)
+static const char *cached_group_name(TALLOC_CTX *mem_ctx,
+                                     struct sss_domain_info *dom,
+                                     uint32_t gid)
 {
-    char *newbuf;
-
-    if (*buflen == 0) {
-        *buflen = DEFAULT_BUFSIZE;
-    }
-    if (*buflen < MAX_BUF_SIZE) {
-        *buflen *= 2;
-    }
-    if (*buflen > MAX_BUF_SIZE) {
-        *buflen = MAX_BUF_SIZE;
-    }
+    struct ldb_result *cached_grp = NULL;
+    const char *real_name = NULL;
+    errno_t ret;
 
-    newbuf = talloc_realloc_size(mem_ctx, *buffer, *buflen);
-    if (!newbuf) {
+    ret = sysdb_getgrgid(mem_ctx, dom, gid, &cached_grp);
+    if (ret != EOK) {
+        /* Non-fatal, attempt to canonicalize online */
+        DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
+              ret, strerror(ret));
         return NULL;
     }
-    *buffer = newbuf;
-
-    return *buffer;
-}
 
-static errno_t
-handle_getgr_result(enum nss_status status, struct group *grp,
-                    struct sss_domain_info *dom,
-                    bool *delete_group)
-{
-    switch (status) {
-    case NSS_STATUS_TRYAGAIN:
-        DEBUG(SSSDBG_MINOR_FAILURE, "Buffer too small\n");
-        return EAGAIN;
-
-    case NSS_STATUS_NOTFOUND:
-        DEBUG(SSSDBG_MINOR_FAILURE, "Group not found.\n");
-        *delete_group = true;
-        break;
-
-    case NSS_STATUS_SUCCESS:
-        DEBUG(SSSDBG_FUNC_DATA, "Group found: (%s, %"SPRIgid")\n",
-              grp->gr_name, grp->gr_gid);
-
-        /* gid=0 is an invalid value */
-        /* also check that the id is in the valid range for this domain */
-        if (OUT_OF_ID_RANGE(grp->gr_gid, dom->id_min, dom->id_max)) {
-            DEBUG(SSSDBG_MINOR_FAILURE,
-                  "Group filtered out! (id out of range)\n");
-            *delete_group = true;
-            break;
+    if (cached_grp->count == 1) {
+        real_name = ldb_msg_find_attr_as_string(cached_grp->msgs[0],
+                                                SYSDB_NAME, NULL);
+        if (!real_name) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Cached group has no name?\n");
         }
-        break;
-
-    case NSS_STATUS_UNAVAIL:
-        DEBUG(SSSDBG_MINOR_FAILURE,
-              "Remote back end is not available. Entering offline mode\n");
-        return ENXIO;
-
-    default:
-        DEBUG(SSSDBG_OP_FAILURE, "Unknown return code %d\n", status);
-        return EIO;
     }
 
-    return EOK;
+    return real_name;
 }
 
 static int get_gr_name(struct proxy_id_ctx *ctx,
@@ -949,15 +807,9 @@ static int get_gr_name(struct proxy_id_ctx *ctx,
                        const char *i_name)
 {
     TALLOC_CTX *tmpctx;
-    struct group *grp;
-    enum nss_status status;
-    char *buffer = 0;
-    size_t buflen = 0;
-    bool delete_group = false;
+    struct proxy_nss_group *group;
     int ret;
-    gid_t gid;
-    struct ldb_result *cached_grp = NULL;
-    const char *real_name = NULL;
+    const char *real_name;
     char *shortname_or_alias;
 
     DEBUG(SSSDBG_FUNC_DATA, "Searching group by name (%s)\n", i_name);
@@ -972,112 +824,39 @@ static int get_gr_name(struct proxy_id_ctx *ctx,
         goto done;
     }
 
-    grp = talloc(tmpctx, struct group);
-    if (!grp) {
-        ret = ENOMEM;
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "proxy -> getgrnam_r failed for '%s': [%d] %s\n",
-              i_name, ret, strerror(ret));
-        goto done;
-    }
-
-    do {
-        /* always zero out the grp structure */
-        memset(grp, 0, sizeof(struct group));
-        buffer = grow_group_buffer(tmpctx, &buffer, &buflen);
-        if (!buffer) {
-            ret = ENOMEM;
-            goto done;
-        }
-
-        status = ctx->ops.getgrnam_r(shortname_or_alias, grp, buffer,
-                                     buflen, &ret);
-        ret = handle_getgr_result(status, grp, dom, &delete_group);
-    } while (ret == EAGAIN);
-
+    /* Canonicalize the group name in case it was actually an alias */
+    ret = proxy_nss_group_by_name(tmpctx, &ctx->ops, dom, shortname_or_alias,
+                                  ctx->fast_alias ? cached_group_name : NULL,
+                                  &group);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "getgrnam failed [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    if (delete_group) {
+    if (group->del_group) {
         DEBUG(SSSDBG_TRACE_FUNC,
               "Group %s does not exist (or is invalid) on remote server,"
                " deleting!\n", i_name);
 
-        ret = sysdb_delete_group(dom, i_name, 0);
+        ret = sysdb_delete_group(dom, i_name, group->gid);
         if (ret == ENOENT) {
             ret = EOK;
         }
         goto done;
     }
 
-    gid = grp->gr_gid;
-
-    /* Canonicalize the group name in case it was actually an alias */
-    if (ctx->fast_alias == true) {
-        ret = sysdb_getgrgid(tmpctx, dom, gid, &cached_grp);
-        if (ret != EOK) {
-            /* Non-fatal, attempt to canonicalize online */
-            DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
-                  ret, strerror(ret));
-        }
-
-        if (ret == EOK && cached_grp->count == 1) {
-            real_name = ldb_msg_find_attr_as_string(cached_grp->msgs[0],
-                                                    SYSDB_NAME, NULL);
-            if (!real_name) {
-                DEBUG(SSSDBG_MINOR_FAILURE, "Cached group has no name?\n");
-            }
-        }
-    }
-
+    real_name = group->cached_name;
     if (real_name == NULL) {
-        talloc_zfree(buffer);
-        buflen = 0;
-
-        do {
-            memset(grp, 0, sizeof(struct group));
-            buffer = grow_group_buffer(tmpctx, &buffer, &buflen);
-            if (!buffer) {
-                ret = ENOMEM;
-                goto done;
-            }
-
-            status = ctx->ops.getgrgid_r(gid, grp, buffer, buflen, &ret);
-
-            ret = handle_getgr_result(status, grp, dom, &delete_group);
-        } while (ret == EAGAIN);
-
-        if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                "getgrgid failed [%d]: %s\n", ret, strerror(ret));
-            goto done;
-        }
-
-        real_name = sss_create_internal_fqname(tmpctx, grp->gr_name, dom->name);
+        real_name = sss_create_internal_fqname(tmpctx, group->grp->gr_name,
+                                               dom->name);
         if (real_name == NULL) {
             DEBUG(SSSDBG_OP_FAILURE, "Failed to create fqdn '%s'\n",
-                  grp->gr_name);
+                  group->grp->gr_name);
             ret = ENOMEM;
             goto done;
         }
     }
 
-    if (delete_group) {
-        DEBUG(SSSDBG_TRACE_FUNC,
-              "Group %s does not exist (or is invalid) on remote server,"
-               " deleting!\n", i_name);
-
-        ret = sysdb_delete_group(dom, i_name, gid);
-        if (ret == ENOENT) {
-            ret = EOK;
-        }
-        goto done;
-    }
-
-    ret = save_group(sysdb, dom, grp, real_name, i_name);
+    ret = save_group(sysdb, dom, group->grp, real_name, i_name);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
               "Cannot save group [%d]: %s\n", ret, strerror(ret));
@@ -1103,11 +882,7 @@ static int get_gr_gid(TALLOC_CTX *mem_ctx,
                       time_t now)
 {
     TALLOC_CTX *tmpctx;
-    struct group *grp;
-    enum nss_status status;
-    char *buffer = NULL;
-    size_t buflen = 0;
-    bool delete_group = false;
+    struct proxy_nss_group *group;
     int ret;
     char *name;
 
@@ -1118,33 +893,12 @@ static int get_gr_gid(TALLOC_CTX *mem_ctx,
         return ENOMEM;
     }
 
-    grp = talloc(tmpctx, struct group);
-    if (!grp) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    do {
-        /* always zero out the grp structure */
-        memset(grp, 0, sizeof(struct group));
-        buffer = grow_group_buffer(tmpctx, &buffer, &buflen);
-        if (!buffer) {
-            ret = ENOMEM;
-            goto done;
-        }
-
-        status = ctx->ops.getgrgid_r(gid, grp, buffer, buflen, &ret);
-
-        ret = handle_getgr_result(status, grp, dom, &delete_group);
-    } while (ret == EAGAIN);
-
+    ret = proxy_nss_group_by_gid(tmpctx, &ctx->ops, dom, gid, &group);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "getgrgid failed [%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    if (delete_group) {
+    if (group->del_group) {
         DEBUG(SSSDBG_TRACE_FUNC,
               "Group %"SPRIgid" does not exist (or is invalid) on remote "
                "server, deleting!\n", gid);
@@ -1156,13 +910,13 @@ static int get_gr_gid(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    name = sss_create_internal_fqname(tmpctx, grp->gr_name, dom->name);
+    name = sss_create_internal_fqname(tmpctx, group->grp->gr_name, dom->name);
     if (name == NULL) {
         ret = ENOMEM;
         goto done;
     }
 
-    ret = save_group(sysdb, dom, grp, name, NULL);
+    ret = save_group(sysdb, dom, group->grp, name, NULL);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE,
               "Cannot save user [%d]: %s\n", ret, strerror(ret));
@@ -1347,16 +1101,10 @@ static int get_initgr(TALLOC_CTX *mem_ctx,
 {
     TALLOC_CTX *tmpctx;
     bool in_transaction = false;
-    struct passwd *pwd;
-    enum nss_status status;
-    char *buffer;
-    size_t buflen;
+    struct proxy_nss_user *user;
     int ret;
     errno_t sret;
-    bool del_user;
-    uid_t uid;
-    struct ldb_result *cached_pwd = NULL;
-    const char *real_name = NULL;
+    const char *real_name;
     char *shortname_or_alias;
 
     tmpctx = talloc_new(mem_ctx);
@@ -1369,19 +1117,6 @@ static int get_initgr(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    pwd = talloc_zero(tmpctx, struct passwd);
-    if (!pwd) {
-        ret = ENOMEM;
-        goto fail;
-    }
-
-    buflen = DEFAULT_BUFSIZE;
-    buffer = talloc_size(tmpctx, buflen);
-    if (!buffer) {
-        ret = ENOMEM;
-        goto fail;
-    }
-
     ret = sysdb_transaction_start(sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to start transaction\n");
@@ -1391,17 +1126,15 @@ static int get_initgr(TALLOC_CTX *mem_ctx,
 
     /* FIXME: should we move this call outside the transaction to keep the
      * transaction as short as possible ? */
-    status = ctx->ops.getpwnam_r(shortname_or_alias, pwd,
-                                 buffer, buflen, &ret);
-    ret = handle_getpw_result(status, pwd, dom, &del_user);
+    ret = proxy_nss_user_by_name(tmpctx, &ctx->ops, dom, shortname_or_alias,
+                                 ctx->fast_alias ? cached_user_name : NULL,
+                                 &user);
     if (ret) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "getpwnam failed [%d]: %s\n", ret, strerror(ret));
         goto fail;
     }
 
-    if (del_user) {
-        ret = delete_user(dom, i_name, 0);
+    if (user->del_user) {
+        ret = delete_user(dom, i_name, user->uid);
         if (ret) {
             DEBUG(SSSDBG_OP_FAILURE, "Could not delete user\n");
             goto fail;
@@ -1409,61 +1142,23 @@ static int get_initgr(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    uid = pwd->pw_uid;
-    memset(buffer, 0, buflen);
-
-    /* Canonicalize the username in case it was actually an alias */
-    if (ctx->fast_alias == true) {
-        ret = sysdb_getpwuid(tmpctx, dom, uid, &cached_pwd);
-        if (ret != EOK) {
-            /* Non-fatal, attempt to canonicalize online */
-            DEBUG(SSSDBG_TRACE_FUNC, "Request to cache failed [%d]: %s\n",
-                  ret, strerror(ret));
-        }
-
-        if (ret == EOK && cached_pwd->count == 1) {
-            real_name = ldb_msg_find_attr_as_string(cached_pwd->msgs[0],
-                                                    SYSDB_NAME, NULL);
-            if (!real_name) {
-                DEBUG(SSSDBG_MINOR_FAILURE, "Cached user has no name?\n");
-            }
-        }
-    }
-
+    real_name = user->cached_name;
     if (real_name == NULL) {
-        memset(buffer, 0, buflen);
-
-        status = ctx->ops.getpwuid_r(uid, pwd, buffer, buflen, &ret);
-        ret = handle_getpw_result(status, pwd, dom, &del_user);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                "getpwuid failed [%d]: %s\n", ret, strerror(ret));
-            goto done;
-        }
-
-        real_name = sss_create_internal_fqname(tmpctx, pwd->pw_name, dom->name);
+        real_name = sss_create_internal_fqname(tmpctx, user->pwd->pw_name,
+                                               dom->name);
         if (real_name == NULL) {
             ret = ENOMEM;
-            goto done;
-        }
-    }
-
-    if (del_user) {
-        ret = delete_user(dom, i_name, uid);
-        if (ret) {
-            DEBUG(SSSDBG_OP_FAILURE, "Could not delete user\n");
             goto fail;
         }
-        goto done;
     }
 
-    ret = save_user(dom, pwd, real_name, i_name);
+    ret = save_user(dom, user->pwd, real_name, i_name);
     if (ret) {
         DEBUG(SSSDBG_OP_FAILURE, "Could not save user\n");
         goto fail;
     }
 
-    ret = get_initgr_groups_process(tmpctx, ctx, sysdb, dom, pwd);
+    ret = get_initgr_groups_process(tmpctx, ctx, sysdb, dom, user->pwd);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "Could not process initgroups\n");
         goto fail;
@@ -1494,89 +1189,33 @@ static int get_initgr_groups_process(TALLOC_CTX *memctx,
                                      struct sss_domain_info *dom,
                                      struct passwd *pwd)
 {
-    enum nss_status status;
-    long int limit;
-    long int size;
-    long int num;
     long int num_gids;
     gid_t *gids;
     int ret;
     int i;
     time_t now;
 
-    num_gids = 0;
-    limit = 4096;
-    num = 4096;
-    size = num*sizeof(gid_t);
-    gids = talloc_size(memctx, size);
-    if (!gids) {
-        return ENOMEM;
-    }
-
-    /* nss modules may skip the primary group when we pass it in so always add
-     * it in advance */
-    gids[0] = pwd->pw_gid;
-    num_gids++;
-
     /* FIXME: should we move this call outside the transaction to keep the
      * transaction as short as possible ? */
-    do {
-        status = ctx->ops.initgroups_dyn(pwd->pw_name, pwd->pw_gid, &num_gids,
-                &num, &gids, limit, &ret);
-
-        if (status == NSS_STATUS_TRYAGAIN) {
-            /* buffer too small ? */
-            if (size < MAX_BUF_SIZE) {
-                num *= 2;
-                size = num*sizeof(gid_t);
-            }
-            if (size > MAX_BUF_SIZE) {
-                size = MAX_BUF_SIZE;
-                num = size/sizeof(gid_t);
-            }
-            limit = num;
-            gids = talloc_realloc_size(memctx, gids, size);
-            if (!gids) {
-                return ENOMEM;
-            }
-        }
-    } while(status == NSS_STATUS_TRYAGAIN);
-
-    switch (status) {
-    case NSS_STATUS_NOTFOUND:
-        DEBUG(SSSDBG_FUNC_DATA, "The initgroups call returned 'NOTFOUND'. "
-                                 "Assume the user is only member of its "
-                                 "primary group (%"SPRIgid")\n", pwd->pw_gid);
-        /* fall through */
-        SSS_ATTRIBUTE_FALLTHROUGH;
-    case NSS_STATUS_SUCCESS:
-        DEBUG(SSSDBG_CONF_SETTINGS, "User [%s] appears to be member of %lu "
-              "groups\n", pwd->pw_name, num_gids);
-
-        now = time(NULL);
-        for (i = 0; i < num_gids; i++) {
-            ret = get_gr_gid(memctx, ctx, sysdb, dom, gids[i], now);
-            if (ret) {
-                return ret;
-            }
-        }
-        ret = EOK;
-
-        break;
+    ret = proxy_nss_initgroups(memctx, &ctx->ops, pwd, &gids, &num_gids);
+    if (ret != EOK) {
+        return ret;
+    }
 
-    default:
-        DEBUG(SSSDBG_OP_FAILURE, "proxy -> initgroups_dyn failed (%d)[%s]\n",
-                  ret, strerror(ret));
-        ret = EIO;
-        break;
+    now = time(NULL);
+    for (i = 0; i < num_gids; i++) {
+        ret = get_gr_gid(memctx, ctx, sysdb, dom, gids[i], now);
+        if (ret) {
+            return ret;
+        }
     }
 
-    return ret;
+    return EOK;
 }
 
 /* =Proxy_Id-Functions====================================================*/
 
-static struct dp_reply_std
+struct dp_reply_std
 proxy_account_info(TALLOC_CTX *mem_ctx,
                    struct proxy_id_ctx *ctx,
                    struct dp_id_data *data,
@@ -1744,6 +1383,8 @@ struct proxy_account_info_handler_state {
     struct dp_reply_std reply;
 };
 
+static void proxy_account_info_handler_done(struct tevent_req *subreq);
+
 struct tevent_req *
 proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
                                struct proxy_id_ctx *id_ctx,
@@ -1751,6 +1392,7 @@ proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
                                struct dp_req_params *params)
 {
     struct proxy_account_info_handler_state *state;
+    struct tevent_req *subreq;
     struct tevent_req *req;
 
     req = tevent_req_create(mem_ctx, &state,
@@ -1760,6 +1402,21 @@ proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
+    if (id_ctx->workers != NULL
+            && proxy_id_workers_supported(id_ctx, data)) {
+        subreq = proxy_id_workers_lookup_send(state, params->ev,
+                                              id_ctx->workers, data);
+        if (subreq == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "proxy_id_workers_lookup_send() failed\n");
+            talloc_zfree(req);
+            return NULL;
+        }
+
+        tevent_req_set_callback(subreq, proxy_account_info_handler_done, req);
+        return req;
+    }
+
     state->reply = proxy_account_info(state, id_ctx, data, params->be_ctx,
                                       params->be_ctx->domain);
 
@@ -1770,6 +1427,25 @@ proxy_account_info_handler_send(TALLOC_CTX *mem_ctx,
     return req;
 }
 
+static void proxy_account_info_handler_done(struct tevent_req *subreq)
+{
+    struct proxy_account_info_handler_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct proxy_account_info_handler_state);
+
+    ret = proxy_id_workers_lookup_recv(subreq, &state->reply);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        dp_reply_std_set(&state->reply, DP_ERR_FATAL, ret, NULL);
+    }
+
+    /* TODO For backward compatibility we always return EOK to DP now. */
+    tevent_req_done(req);
+}
+
 errno_t proxy_account_info_handler_recv(TALLOC_CTX *mem_ctx,
                                        struct tevent_req *req,
                                        struct dp_reply_std *data)
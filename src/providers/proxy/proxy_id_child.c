@@ -0,0 +1,302 @@
+/*
+    SSSD
+
+    proxy_id_child.c - runs lookups of the proxy provider in a separate
+                       process
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <popt.h>
+
+#include "util/util.h"
+#include "util/atomic_io.h"
+#include "providers/proxy/proxy.h"
+
+#define NSS_FN_NAME "_nss_%s_%s"
+
+static errno_t load_symbols(struct proxy_nss_ops *ops, const char *libname)
+{
+    char *libpath;
+    char *funcname;
+    void *handle;
+    int i;
+    struct {void **dest;
+            const char *name;
+            bool is_fatal;
+    } symbols[] = {
+        {(void**)&ops->getpwnam_r, "getpwnam_r", true},
+        {(void**)&ops->getpwuid_r, "getpwuid_r", true},
+        {(void**)&ops->getgrnam_r, "getgrnam_r", true},
+        {(void**)&ops->getgrgid_r, "getgrgid_r", true},
+        {(void**)&ops->initgroups_dyn, "initgroups_dyn", false},
+        {NULL, NULL, false}
+    };
+
+    libpath = talloc_asprintf(NULL, "libnss_%s.so.2", libname);
+    if (libpath == NULL) {
+        return ENOMEM;
+    }
+
+    handle = dlopen(libpath, RTLD_NOW);
+    if (handle == NULL) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Unable to load %s module, "
+              "error: %s\n", libpath, dlerror());
+        talloc_free(libpath);
+        return ELIBACC;
+    }
+    talloc_free(libpath);
+
+    for (i = 0; symbols[i].dest != NULL; i++) {
+        funcname = talloc_asprintf(NULL, NSS_FN_NAME, libname,
+                                   symbols[i].name);
+        if (funcname == NULL) {
+            return ENOMEM;
+        }
+
+        *symbols[i].dest = dlsym(handle, funcname);
+        talloc_free(funcname);
+        if (*symbols[i].dest == NULL && symbols[i].is_fatal) {
+            DEBUG(SSSDBG_FATAL_FAILURE, "Failed to load _nss_%s_%s, "
+                  "error: %s.\n", libname, symbols[i].name, dlerror());
+            return ELIBBAD;
+        }
+    }
+
+    return EOK;
+}
+
+static errno_t read_request(TALLOC_CTX *mem_ctx, uint8_t **_buf, size_t *_len)
+{
+    struct pollfd pfd;
+    uint8_t len_buf[sizeof(uint32_t)];
+    uint32_t len;
+    uint8_t *buf;
+    ssize_t nread;
+    errno_t ret;
+
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    do {
+        ret = poll(&pfd, 1, PROXY_ID_CHILD_IDLE_TIMEOUT * 1000);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "poll failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (ret == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "No request received, exiting.\n");
+        return ENOENT;
+    }
+
+    errno = 0;
+    nread = sss_atomic_read_s(STDIN_FILENO, len_buf, sizeof(len_buf));
+    if (nread == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        return ret;
+    } else if (nread == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Backend closed the pipe, exiting.\n");
+        return ENOENT;
+    } else if (nread != sizeof(len_buf)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request length.\n");
+        return EINVAL;
+    }
+
+    SAFEALIGN_COPY_UINT32(&len, len_buf, NULL);
+    if (len < 2 * sizeof(uint32_t) + 1
+            || len > PROXY_ID_CHILD_MAX_REQUEST_SIZE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid request length [%"PRIu32"].\n",
+              len);
+        return EINVAL;
+    }
+
+    buf = talloc_size(mem_ctx, len);
+    if (buf == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_size failed.\n");
+        return ENOMEM;
+    }
+
+    errno = 0;
+    nread = sss_atomic_read_s(STDIN_FILENO, buf, len);
+    if (nread == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        talloc_free(buf);
+        return ret;
+    } else if (nread != len) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Truncated request.\n");
+        talloc_free(buf);
+        return EINVAL;
+    }
+
+    *_buf = buf;
+    *_len = len;
+    return EOK;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int debug_fd = -1;
+    char *libname = NULL;
+    errno_t ret;
+    TALLOC_CTX *main_ctx = NULL;
+    TALLOC_CTX *req_ctx = NULL;
+    struct proxy_nss_ops ops;
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    uint8_t *resp = NULL;
+    size_t resp_len = 0;
+    ssize_t written;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        {"debug-level", 'd', POPT_ARG_INT, &debug_level, 0,
+         _("Debug level"), NULL},
+        {"debug-timestamps", 0, POPT_ARG_INT, &debug_timestamps, 0,
+         _("Add debug timestamps"), NULL},
+        {"debug-microseconds", 0, POPT_ARG_INT, &debug_microseconds, 0,
+         _("Show timestamps with microseconds"), NULL},
+        {"debug-fd", 0, POPT_ARG_INT, &debug_fd, 0,
+         _("An open file descriptor for the debug logs"), NULL},
+        {"debug-to-stderr", 0, POPT_ARG_NONE | POPT_ARGFLAG_DOC_HIDDEN,
+         &debug_to_stderr, 0,
+         _("Send the debug output to stderr directly."), NULL },
+        {"libname", 0, POPT_ARG_STRING, &libname, 0,
+         _("Name of the NSS library (mandatory)"), NULL },
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                  poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            _exit(-1);
+        }
+    }
+
+    if (libname == NULL) {
+        fprintf(stderr, "\nMissing option, "
+                        "--libname is a mandatory option.\n\n");
+        poptPrintUsage(pc, stderr, 0);
+        _exit(-1);
+    }
+
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    debug_prg_name = talloc_asprintf(NULL, "[sssd[proxy_id_child[%d]]]",
+                                     getpid());
+    if (debug_prg_name == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_asprintf failed.\n");
+        goto fail;
+    }
+
+    if (debug_fd != -1) {
+        ret = set_debug_file_from_fd(debug_fd);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "set_debug_file_from_fd failed.\n");
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "proxy_id_child started.\n");
+
+    main_ctx = talloc_new(NULL);
+    if (main_ctx == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_new failed.\n");
+        talloc_free(discard_const(debug_prg_name));
+        goto fail;
+    }
+    talloc_steal(main_ctx, debug_prg_name);
+
+    memset(&ops, 0, sizeof(ops));
+    ret = load_symbols(&ops, libname);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Unable to load NSS symbols [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto fail;
+    }
+
+    while (true) {
+        req_ctx = talloc_new(main_ctx);
+        if (req_ctx == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "talloc_new failed.\n");
+            goto fail;
+        }
+
+        ret = read_request(req_ctx, &buf, &len);
+        if (ret == ENOENT) {
+            break;
+        } else if (ret != EOK) {
+            goto fail;
+        }
+
+        ret = proxy_id_record(req_ctx, &ops, buf, len, &resp, &resp_len);
+        if (ret != EOK) {
+            /* the backend sees the closed pipe and fails the request */
+            DEBUG(SSSDBG_CRIT_FAILURE, "proxy_id_record failed [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            goto fail;
+        }
+
+        errno = 0;
+        written = sss_atomic_write_s(PROXY_ID_CHILD_OUT_FILENO, resp,
+                                     resp_len);
+        if (written == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%d][%s].\n", ret,
+                        strerror(ret));
+            goto fail;
+        }
+
+        if (written != resp_len) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Expected to write %zu bytes, "
+                  "wrote %zu\n", resp_len, written);
+            goto fail;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "request completed\n");
+        talloc_zfree(req_ctx);
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "proxy_id_child completed successfully\n");
+    close(PROXY_ID_CHILD_OUT_FILENO);
+    talloc_free(main_ctx);
+    return EXIT_SUCCESS;
+
+fail:
+    DEBUG(SSSDBG_CRIT_FAILURE, "proxy_id_child failed!\n");
+    close(PROXY_ID_CHILD_OUT_FILENO);
+    talloc_free(main_ctx);
+    return EXIT_FAILURE;
+}
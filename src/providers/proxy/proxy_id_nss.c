@@ -0,0 +1,476 @@
+/*
+    SSSD
+
+    proxy_id_nss.c - NSS calls of the lookups of the proxy provider
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/sss_format.h"
+#include "providers/proxy/proxy.h"
+
+/*
+ * These functions call the NSS module in the order the lookups of
+ * proxy_id.c need. They are also used by proxy_id_child, which records the
+ * calls, so the backend always finds the results it asks for when it
+ * replays them.
+ *
+ * The domain is NULL in proxy_id_child, the ID range is then checked by the
+ * backend only.
+ */
+
+static errno_t
+handle_getpw_result(enum nss_status status, struct passwd *pwd,
+                    struct sss_domain_info *dom, bool *del_user)
+{
+    int ret = EOK;
+
+    if (!del_user) {
+        return EINVAL;
+    }
+    *del_user = false;
+
+    switch (status) {
+    case NSS_STATUS_NOTFOUND:
+
+        DEBUG(SSSDBG_MINOR_FAILURE, "User not found.\n");
+        *del_user = true;
+        break;
+
+    case NSS_STATUS_SUCCESS:
+
+        DEBUG(SSSDBG_TRACE_FUNC, "User found: (%s, %"SPRIuid", %"SPRIgid")\n",
+              pwd->pw_name, pwd->pw_uid, pwd->pw_gid);
+
+        /* uid=0 or gid=0 are invalid values */
+        /* also check that the id is in the valid range for this domain */
+        if (dom != NULL
+                && (OUT_OF_ID_RANGE(pwd->pw_uid, dom->id_min, dom->id_max) ||
+                    OUT_OF_ID_RANGE(pwd->pw_gid, dom->id_min, dom->id_max))) {
+
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "User filtered out! (id out of range)\n");
+            *del_user = true;
+            break;
+        }
+        break;
+
+    case NSS_STATUS_UNAVAIL:
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Remote back end is not available. Entering offline mode\n");
+        ret = ENXIO;
+        break;
+
+    default:
+        DEBUG(SSSDBG_OP_FAILURE, "Unknown return code %d\n", status);
+        ret = EIO;
+        break;
+    }
+
+    return ret;
+}
+
+static char *
+grow_group_buffer(TALLOC_CTX *mem_ctx,
+                  char **buffer, size_t *buflen)
+{
+    char *newbuf;
+
+    if (*buflen == 0) {
+        *buflen = DEFAULT_BUFSIZE;
+    }
+    if (*buflen < MAX_BUF_SIZE) {
+        *buflen *= 2;
+    }
+    if (*buflen > MAX_BUF_SIZE) {
+        *buflen = MAX_BUF_SIZE;
+    }
+
+    newbuf = talloc_realloc_size(mem_ctx, *buffer, *buflen);
+    if (!newbuf) {
+        return NULL;
+    }
+    *buffer = newbuf;
+
+    return *buffer;
+}
+
+static errno_t
+handle_getgr_result(enum nss_status status, struct group *grp,
+                    struct sss_domain_info *dom,
+                    bool *delete_group)
+{
+    switch (status) {
+    case NSS_STATUS_TRYAGAIN:
+        DEBUG(SSSDBG_MINOR_FAILURE, "Buffer too small\n");
+        return EAGAIN;
+
+    case NSS_STATUS_NOTFOUND:
+        DEBUG(SSSDBG_MINOR_FAILURE, "Group not found.\n");
+        *delete_group = true;
+        break;
+
+    case NSS_STATUS_SUCCESS:
+        DEBUG(SSSDBG_FUNC_DATA, "Group found: (%s, %"SPRIgid")\n",
+              grp->gr_name, grp->gr_gid);
+
+        /* gid=0 is an invalid value */
+        /* also check that the id is in the valid range for this domain */
+        if (dom != NULL
+                && OUT_OF_ID_RANGE(grp->gr_gid, dom->id_min, dom->id_max)) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Group filtered out! (id out of range)\n");
+            *delete_group = true;
+            break;
+        }
+        break;
+
+    case NSS_STATUS_UNAVAIL:
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Remote back end is not available. Entering offline mode\n");
+        return ENXIO;
+
+    default:
+        DEBUG(SSSDBG_OP_FAILURE, "Unknown return code %d\n", status);
+        return EIO;
+    }
+
+    return EOK;
+}
+
+/* Calls getpwnam_r() if name is set, getpwuid_r() otherwise */
+static errno_t proxy_nss_getpw(TALLOC_CTX *mem_ctx,
+                               struct proxy_nss_ops *ops,
+                               struct sss_domain_info *dom,
+                               const char *name,
+                               uid_t uid,
+                               struct passwd **_pwd,
+                               bool *_del_user)
+{
+    struct passwd *pwd;
+    enum nss_status status;
+    char *buffer;
+    size_t buflen;
+    int err = 0;
+
+    pwd = talloc_zero(mem_ctx, struct passwd);
+    if (pwd == NULL) {
+        return ENOMEM;
+    }
+
+    buflen = DEFAULT_BUFSIZE;
+    buffer = talloc_zero_size(pwd, buflen);
+    if (buffer == NULL) {
+        talloc_free(pwd);
+        return ENOMEM;
+    }
+
+    if (name != NULL) {
+        status = ops->getpwnam_r(name, pwd, buffer, buflen, &err);
+    } else {
+        status = ops->getpwuid_r(uid, pwd, buffer, buflen, &err);
+    }
+
+    *_pwd = pwd;
+    return handle_getpw_result(status, pwd, dom, _del_user);
+}
+
+/* Calls getgrnam_r() if name is set, getgrgid_r() otherwise */
+static errno_t proxy_nss_getgr(TALLOC_CTX *mem_ctx,
+                               struct proxy_nss_ops *ops,
+                               struct sss_domain_info *dom,
+                               const char *name,
+                               gid_t gid,
+                               struct group **_grp,
+                               bool *_del_group)
+{
+    struct group *grp;
+    enum nss_status status;
+    char *buffer = NULL;
+    size_t buflen = 0;
+    int err = 0;
+    errno_t ret;
+
+    grp = talloc(mem_ctx, struct group);
+    if (grp == NULL) {
+        return ENOMEM;
+    }
+
+    do {
+        /* always zero out the grp structure */
+        memset(grp, 0, sizeof(struct group));
+        buffer = grow_group_buffer(grp, &buffer, &buflen);
+        if (!buffer) {
+            talloc_free(grp);
+            return ENOMEM;
+        }
+
+        if (name != NULL) {
+            status = ops->getgrnam_r(name, grp, buffer, buflen, &err);
+        } else {
+            status = ops->getgrgid_r(gid, grp, buffer, buflen, &err);
+        }
+
+        ret = handle_getgr_result(status, grp, dom, _del_group);
+    } while (ret == EAGAIN);
+
+    *_grp = grp;
+    return ret;
+}
+
+errno_t proxy_nss_user_by_name(TALLOC_CTX *mem_ctx,
+                               struct proxy_nss_ops *ops,
+                               struct sss_domain_info *dom,
+                               const char *name,
+                               proxy_nss_cached_name_fn cached_name,
+                               struct proxy_nss_user **_user)
+{
+    struct proxy_nss_user *user;
+    errno_t ret;
+
+    user = talloc_zero(mem_ctx, struct proxy_nss_user);
+    if (user == NULL) {
+        return ENOMEM;
+    }
+
+    ret = proxy_nss_getpw(user, ops, dom, name, 0,
+                          &user->pwnam, &user->del_user);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "getpwnam failed [%d]: %s\n", ret, strerror(ret));
+        goto done;
+    }
+
+    if (user->del_user) {
+        goto done;
+    }
+
+    user->uid = user->pwnam->pw_uid;
+    user->pwd = user->pwnam;
+
+    /* Canonicalize the username in case it was actually an alias */
+    if (cached_name != NULL) {
+        user->cached_name = cached_name(user, dom, user->uid);
+    }
+
+    if (user->cached_name == NULL) {
+        ret = proxy_nss_getpw(user, ops, dom, NULL, user->uid,
+                              &user->pwd, &user->del_user);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "getpwuid failed [%d]: %s\n", ret, strerror(ret));
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    if (ret == EOK) {
+        *_user = user;
+    } else {
+        talloc_free(user);
+    }
+
+    return ret;
+}
+
+errno_t proxy_nss_user_by_uid(TALLOC_CTX *mem_ctx,
+                              struct proxy_nss_ops *ops,
+                              struct sss_domain_info *dom,
+                              uid_t uid,
+                              struct proxy_nss_user **_user)
+{
+    struct proxy_nss_user *user;
+    errno_t ret;
+
+    user = talloc_zero(mem_ctx, struct proxy_nss_user);
+    if (user == NULL) {
+        return ENOMEM;
+    }
+    user->uid = uid;
+
+    ret = proxy_nss_getpw(user, ops, dom, NULL, uid,
+                          &user->pwd, &user->del_user);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "getpwuid failed [%d]: %s\n", ret, strerror(ret));
+        talloc_free(user);
+        return ret;
+    }
+
+    *_user = user;
+    return EOK;
+}
+
+errno_t proxy_nss_group_by_name(TALLOC_CTX *mem_ctx,
+                                struct proxy_nss_ops *ops,
+                                struct sss_domain_info *dom,
+                                const char *name,
+                                proxy_nss_cached_name_fn cached_name,
+                                struct proxy_nss_group **_group)
+{
+    struct proxy_nss_group *group;
+    errno_t ret;
+
+    group = talloc_zero(mem_ctx, struct proxy_nss_group);
+    if (group == NULL) {
+        return ENOMEM;
+    }
+
+    ret = proxy_nss_getgr(group, ops, dom, name, 0,
+                          &group->grp, &group->del_group);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "getgrnam failed [%d]: %s\n", ret, strerror(ret));
+        goto done;
+    }
+
+    if (group->del_group) {
+        goto done;
+    }
+
+    group->gid = group->grp->gr_gid;
+
+    /* Canonicalize the group name in case it was actually an alias */
+    if (cached_name != NULL) {
+        group->cached_name = cached_name(group, dom, group->gid);
+    }
+
+    if (group->cached_name == NULL) {
+        ret = proxy_nss_getgr(group, ops, dom, NULL, group->gid,
+                              &group->grp, &group->del_group);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "getgrgid failed [%d]: %s\n", ret, strerror(ret));
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    if (ret == EOK) {
+        *_group = group;
+    } else {
+        talloc_free(group);
+    }
+
+    return ret;
+}
+
+errno_t proxy_nss_group_by_gid(TALLOC_CTX *mem_ctx,
+                               struct proxy_nss_ops *ops,
+                               struct sss_domain_info *dom,
+                               gid_t gid,
+                               struct proxy_nss_group **_group)
+{
+    struct proxy_nss_group *group;
+    errno_t ret;
+
+    group = talloc_zero(mem_ctx, struct proxy_nss_group);
+    if (group == NULL) {
+        return ENOMEM;
+    }
+    group->gid = gid;
+
+    ret = proxy_nss_getgr(group, ops, dom, NULL, gid,
+                          &group->grp, &group->del_group);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "getgrgid failed [%d]: %s\n", ret, strerror(ret));
+        talloc_free(group);
+        return ret;
+    }
+
+    *_group = group;
+    return EOK;
+}
+
+errno_t proxy_nss_initgroups(TALLOC_CTX *mem_ctx,
+                             struct proxy_nss_ops *ops,
+                             struct passwd *pwd,
+                             gid_t **_gids,
+                             long int *_num_gids)
+{
+    enum nss_status status;
+    long int limit;
+    long int size;
+    long int num;
+    long int num_gids;
+    gid_t *gids;
+    int err = 0;
+
+    num_gids = 0;
+    limit = 4096;
+    num = 4096;
+    size = num*sizeof(gid_t);
+    gids = talloc_size(mem_ctx, size);
+    if (!gids) {
+        return ENOMEM;
+    }
+
+    /* nss modules may skip the primary group when we pass it in so always add
+     * it in advance */
+    gids[0] = pwd->pw_gid;
+    num_gids++;
+
+    do {
+        status = ops->initgroups_dyn(pwd->pw_name, pwd->pw_gid, &num_gids,
+                                     &num, &gids, limit, &err);
+
+        if (status == NSS_STATUS_TRYAGAIN) {
+            /* buffer too small ? */
+            if (size < MAX_BUF_SIZE) {
+                num *= 2;
+                size = num*sizeof(gid_t);
+            }
+            if (size > MAX_BUF_SIZE) {
+                size = MAX_BUF_SIZE;
+                num = size/sizeof(gid_t);
+            }
+            limit = num;
+            gids = talloc_realloc_size(mem_ctx, gids, size);
+            if (!gids) {
+                return ENOMEM;
+            }
+        }
+    } while(status == NSS_STATUS_TRYAGAIN);
+
+    switch (status) {
+    case NSS_STATUS_NOTFOUND:
+        DEBUG(SSSDBG_FUNC_DATA, "The initgroups call returned 'NOTFOUND'. "
+                                 "Assume the user is only member of its "
+                                 "primary group (%"SPRIgid")\n", pwd->pw_gid);
+        /* fall through */
+        SSS_ATTRIBUTE_FALLTHROUGH;
+    case NSS_STATUS_SUCCESS:
+        DEBUG(SSSDBG_CONF_SETTINGS, "User [%s] appears to be member of %lu "
+              "groups\n", pwd->pw_name, num_gids);
+        break;
+
+    default:
+        DEBUG(SSSDBG_OP_FAILURE, "proxy -> initgroups_dyn failed (%d)[%s]\n",
+                  err, strerror(err));
+        talloc_free(gids);
+        return EIO;
+    }
+
+    *_gids = gids;
+    *_num_gids = num_gids;
+    return EOK;
+}
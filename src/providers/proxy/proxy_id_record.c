@@ -0,0 +1,454 @@
+/*
+    SSSD
+
+    proxy_id_record.c - record the NSS calls of a lookup for the backend
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "providers/proxy/proxy.h"
+
+/*
+ * proxy_id_child runs the lookups of proxy_id_nss.c with NSS operations
+ * which call the module and append each result to the response. The
+ * backend replays the response when it runs the same lookups.
+ */
+
+struct response {
+    uint8_t *buf;
+    size_t size;
+    size_t used;
+    uint32_t num_records;
+};
+
+/* Set only while proxy_id_record() runs. */
+static struct response *rec_resp;
+static struct proxy_nss_ops *rec_module;
+static errno_t rec_ret;
+
+static errno_t resp_reserve(struct response *resp, size_t len)
+{
+    uint8_t *buf;
+    size_t size;
+
+    if (resp->used + len <= resp->size) {
+        return EOK;
+    }
+
+    size = resp->size;
+    while (resp->used + len > size) {
+        size *= 2;
+    }
+
+    if (size > PROXY_ID_CHILD_MAX_RESPONSE_SIZE + sizeof(uint32_t)) {
+        DEBUG(SSSDBG_OP_FAILURE, "Response is too large.\n");
+        return EMSGSIZE;
+    }
+
+    buf = talloc_realloc(resp, resp->buf, uint8_t, size);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    resp->buf = buf;
+    resp->size = size;
+    return EOK;
+}
+
+static errno_t resp_add_uint32(struct response *resp, uint32_t val)
+{
+    errno_t ret;
+
+    ret = resp_reserve(resp, sizeof(uint32_t));
+    if (ret != EOK) {
+        return ret;
+    }
+
+    SAFEALIGN_SET_UINT32(resp->buf + resp->used, val, &resp->used);
+    return EOK;
+}
+
+static errno_t resp_add_string(struct response *resp, const char *str)
+{
+    size_t len;
+    errno_t ret;
+
+    if (str == NULL) {
+        str = "";
+    }
+
+    len = strlen(str) + 1;
+    ret = resp_reserve(resp, len);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    safealign_memcpy(resp->buf + resp->used, str, len, &resp->used);
+    return EOK;
+}
+
+static errno_t resp_add_header(struct response *resp,
+                               enum proxy_id_child_call call,
+                               uint32_t id,
+                               const char *name,
+                               enum nss_status status,
+                               int err)
+{
+    errno_t ret;
+
+    resp->num_records++;
+
+    ret = resp_add_uint32(resp, call);
+    if (ret == EOK) {
+        ret = resp_add_uint32(resp, id);
+    }
+    if (ret == EOK) {
+        ret = resp_add_string(resp, name);
+    }
+    if (ret == EOK) {
+        ret = resp_add_uint32(resp, (uint32_t) status);
+    }
+    if (ret == EOK) {
+        ret = resp_add_uint32(resp, (uint32_t) err);
+    }
+
+    return ret;
+}
+
+/* The first error is kept, the NSS result is still returned to the lookup,
+ * which fails the request at the end. */
+static void rec_pwd(enum proxy_id_child_call call, uint32_t id,
+                    const char *name, enum nss_status status, int err,
+                    struct passwd *pwd)
+{
+    errno_t ret;
+
+    if (rec_ret != EOK) {
+        return;
+    }
+
+    ret = resp_add_header(rec_resp, call, id, name, status, err);
+    if (ret == EOK && status == NSS_STATUS_SUCCESS) {
+        ret = resp_add_uint32(rec_resp, pwd->pw_uid);
+        if (ret == EOK) {
+            ret = resp_add_uint32(rec_resp, pwd->pw_gid);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, pwd->pw_name);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, pwd->pw_passwd);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, pwd->pw_gecos);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, pwd->pw_dir);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, pwd->pw_shell);
+        }
+    }
+
+    rec_ret = ret;
+}
+
+static void rec_grp(enum proxy_id_child_call call, uint32_t id,
+                    const char *name, enum nss_status status, int err,
+                    struct group *grp)
+{
+    uint32_t num_mem;
+    errno_t ret;
+
+    if (rec_ret != EOK) {
+        return;
+    }
+
+    ret = resp_add_header(rec_resp, call, id, name, status, err);
+    if (ret == EOK && status == NSS_STATUS_SUCCESS) {
+        for (num_mem = 0;
+             grp->gr_mem != NULL && grp->gr_mem[num_mem] != NULL;
+             num_mem++);
+
+        ret = resp_add_uint32(rec_resp, grp->gr_gid);
+        if (ret == EOK) {
+            ret = resp_add_uint32(rec_resp, num_mem);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, grp->gr_name);
+        }
+        if (ret == EOK) {
+            ret = resp_add_string(rec_resp, grp->gr_passwd);
+        }
+        for (uint32_t i = 0; ret == EOK && i < num_mem; i++) {
+            ret = resp_add_string(rec_resp, grp->gr_mem[i]);
+        }
+    }
+
+    rec_ret = ret;
+}
+
+static enum nss_status
+rec_getpwnam_r(const char *name, struct passwd *result,
+               char *buffer, size_t buflen, int *errnop)
+{
+    enum nss_status status;
+
+    status = rec_module->getpwnam_r(name, result, buffer, buflen, errnop);
+    rec_pwd(PROXY_ID_CHILD_GETPWNAM, 0, name, status, *errnop, result);
+    return status;
+}
+
+static enum nss_status
+rec_getpwuid_r(uid_t uid, struct passwd *result,
+               char *buffer, size_t buflen, int *errnop)
+{
+    enum nss_status status;
+
+    status = rec_module->getpwuid_r(uid, result, buffer, buflen, errnop);
+    rec_pwd(PROXY_ID_CHILD_GETPWUID, uid, NULL, status, *errnop, result);
+    return status;
+}
+
+static enum nss_status
+rec_getgrnam_r(const char *name, struct group *result,
+               char *buffer, size_t buflen, int *errnop)
+{
+    enum nss_status status;
+
+    status = rec_module->getgrnam_r(name, result, buffer, buflen, errnop);
+    rec_grp(PROXY_ID_CHILD_GETGRNAM, 0, name, status, *errnop, result);
+    return status;
+}
+
+static enum nss_status
+rec_getgrgid_r(gid_t gid, struct group *result,
+               char *buffer, size_t buflen, int *errnop)
+{
+    enum nss_status status;
+
+    status = rec_module->getgrgid_r(gid, result, buffer, buflen, errnop);
+    rec_grp(PROXY_ID_CHILD_GETGRGID, gid, NULL, status, *errnop, result);
+    return status;
+}
+
+static enum nss_status
+rec_initgroups_dyn(const char *user, gid_t group,
+                   long int *start, long int *size,
+                   gid_t **groups, long int limit,
+                   int *errnop)
+{
+    enum nss_status status;
+    errno_t ret;
+
+    status = rec_module->initgroups_dyn(user, group, start, size, groups,
+                                        limit, errnop);
+    if (rec_ret != EOK) {
+        return status;
+    }
+
+    /* the whole list is recorded, including the primary group the caller
+     * put in advance */
+    ret = resp_add_header(rec_resp, PROXY_ID_CHILD_INITGROUPS_DYN, group,
+                          user, status, *errnop);
+    if (ret == EOK && status == NSS_STATUS_SUCCESS) {
+        ret = resp_add_uint32(rec_resp, *start);
+        for (long int i = 0; ret == EOK && i < *start; i++) {
+            ret = resp_add_uint32(rec_resp, (*groups)[i]);
+        }
+    }
+
+    rec_ret = ret;
+    return status;
+}
+
+/* Looks up the groups the same way get_initgr() does. The backend uses the
+ * result of getpwnam_r() instead of getpwuid_r() if it finds the name in the
+ * cache with proxy_fast_alias, both are recorded if they differ. */
+static errno_t rec_initgroups(TALLOC_CTX *mem_ctx,
+                              struct proxy_nss_ops *ops,
+                              const char *name)
+{
+    struct proxy_nss_user *user;
+    struct proxy_nss_group *group;
+    struct passwd *pwds[2];
+    hash_table_t *seen;
+    hash_key_t key;
+    hash_value_t value;
+    long int num_gids;
+    gid_t *gids;
+    errno_t ret;
+    int hret;
+
+    ret = proxy_nss_user_by_name(mem_ctx, ops, NULL, name, NULL, &user);
+    if (ret != EOK || user->del_user) {
+        return ret;
+    }
+
+    pwds[0] = user->pwd;
+    pwds[1] = NULL;
+    if (strcmp(user->pwnam->pw_name, user->pwd->pw_name) != 0
+            || user->pwnam->pw_gid != user->pwd->pw_gid) {
+        pwds[1] = user->pwnam;
+    }
+
+    ret = sss_hash_create(mem_ctx, 0, &seen);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    key.type = HASH_KEY_ULONG;
+    value.type = HASH_VALUE_UNDEF;
+    for (int l = 0; l < 2 && pwds[l] != NULL; l++) {
+        ret = proxy_nss_initgroups(mem_ctx, ops, pwds[l], &gids, &num_gids);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        for (long int i = 0; i < num_gids; i++) {
+            key.ul = gids[i];
+            if (hash_has_key(seen, &key)) {
+                continue;
+            }
+
+            hret = hash_enter(seen, &key, &value);
+            if (hret != HASH_SUCCESS) {
+                return EIO;
+            }
+
+            ret = proxy_nss_group_by_gid(mem_ctx, ops, NULL, gids[i], &group);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    return EOK;
+}
+
+errno_t proxy_id_record(TALLOC_CTX *mem_ctx,
+                        struct proxy_nss_ops *ops,
+                        uint8_t *req, size_t req_len,
+                        uint8_t **_resp, size_t *_resp_len)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct proxy_nss_ops rec_ops;
+    struct proxy_nss_user *user;
+    struct proxy_nss_group *group;
+    struct response *resp;
+    uint32_t op;
+    uint32_t id;
+    const char *name;
+    size_t p = 0;
+    errno_t ret;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&op, req + p, req_len, &p);
+    SAFEALIGN_COPY_UINT32_CHECK(&id, req + p, req_len, &p);
+    name = (const char *) req + p;
+    if (p >= req_len || req[req_len - 1] != '\0'
+            || strlen(name) != req_len - p - 1) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Malformed request.\n");
+        return EINVAL;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    resp = talloc_zero(tmp_ctx, struct response);
+    if (resp == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    resp->size = DEFAULT_BUFSIZE;
+    resp->buf = talloc_size(resp, resp->size);
+    if (resp->buf == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    /* length and number of records are filled in at the end */
+    resp->used = 2 * sizeof(uint32_t);
+
+    rec_ops = *ops;
+    rec_ops.getpwnam_r = rec_getpwnam_r;
+    rec_ops.getpwuid_r = rec_getpwuid_r;
+    rec_ops.getgrnam_r = rec_getgrnam_r;
+    rec_ops.getgrgid_r = rec_getgrgid_r;
+    if (ops->initgroups_dyn != NULL) {
+        rec_ops.initgroups_dyn = rec_initgroups_dyn;
+    }
+
+    rec_resp = resp;
+    rec_module = ops;
+    rec_ret = EOK;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Processing request [%"PRIu32"] for [%s][%"
+          PRIu32"]\n", op, name, id);
+
+    switch (op) {
+    case PROXY_ID_CHILD_USER_BY_NAME:
+        ret = proxy_nss_user_by_name(tmp_ctx, &rec_ops, NULL, name, NULL,
+                                     &user);
+        break;
+    case PROXY_ID_CHILD_USER_BY_ID:
+        ret = proxy_nss_user_by_uid(tmp_ctx, &rec_ops, NULL, id, &user);
+        break;
+    case PROXY_ID_CHILD_GROUP_BY_NAME:
+        ret = proxy_nss_group_by_name(tmp_ctx, &rec_ops, NULL, name, NULL,
+                                      &group);
+        break;
+    case PROXY_ID_CHILD_GROUP_BY_ID:
+        ret = proxy_nss_group_by_gid(tmp_ctx, &rec_ops, NULL, id, &group);
+        break;
+    case PROXY_ID_CHILD_INITGROUPS:
+        if (ops->initgroups_dyn == NULL) {
+            ret = ENODEV;
+            goto done;
+        }
+        ret = rec_initgroups(tmp_ctx, &rec_ops, name);
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unknown operation [%"PRIu32"].\n", op);
+        ret = EINVAL;
+        goto done;
+    }
+
+    /* Failed lookups are part of the response, only errors of the child
+     * itself fail the request. */
+    if (rec_ret != EOK) {
+        ret = rec_ret;
+        goto done;
+    } else if (ret == ENOMEM) {
+        goto done;
+    }
+
+    p = 0;
+    SAFEALIGN_SET_UINT32(resp->buf, resp->used - sizeof(uint32_t), &p);
+    SAFEALIGN_SET_UINT32(resp->buf + p, resp->num_records, &p);
+
+    *_resp = talloc_steal(mem_ctx, resp->buf);
+    *_resp_len = resp->used;
+    ret = EOK;
+
+done:
+    rec_resp = NULL;
+    rec_module = NULL;
+    talloc_free(tmp_ctx);
+    return ret;
+}
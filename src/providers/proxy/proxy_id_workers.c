@@ -0,0 +1,1391 @@
+/*
+    SSSD
+
+    proxy_id_workers.c - run lookups of the proxy provider in a pool of
+                         proxy_id_child processes
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <signal.h>
+
+#include "util/util.h"
+#include "util/strtonum.h"
+#include "util/child_common.h"
+#include "providers/proxy/proxy.h"
+
+/*
+ * The functions of the wrapped NSS module are blocking, so a slow module
+ * stalls the whole backend while it runs in-process. Lookups of single
+ * users and groups and initgroups requests are therefore sent to a pool of
+ * proxy_id_child processes. The child runs the NSS calls of the lookup in
+ * proxy_id_nss.c and returns their results. The backend then runs the usual
+ * code of proxy_id.c, which calls the same functions, with NSS operations
+ * which replay these results, so the cache is updated exactly as before
+ * without calling the module again.
+ *
+ * Requests are queued when all children are busy. Identical requests which
+ * are queued or running are merged and share the reply.
+ */
+
+#define PROXY_ID_CHILD SSSD_LIBEXEC_PATH"/proxy_id_child"
+#define PROXY_ID_CHILD_LOG_FILE "proxy_id_child"
+
+/* Lookups which take longer are treated as hung and the child is killed */
+#define PROXY_ID_CHILD_TIMEOUT 60
+
+static int proxy_id_child_debug_fd = -1;
+
+struct proxy_id_child {
+    struct proxy_id_child *prev;
+    struct proxy_id_child *next;
+
+    struct proxy_id_workers *workers;
+    pid_t pid;
+    struct child_io_fds *io;
+    struct sss_child_ctx_old *child_ctx;
+    bool idle;
+    bool exited;
+    int num_requests;
+};
+
+struct proxy_id_lookup_state;
+
+struct proxy_id_job {
+    struct proxy_id_job *prev;
+    struct proxy_id_job *next;
+
+    struct proxy_id_workers *workers;
+    char *key;
+    struct dp_id_data *data;
+    uint8_t *req_buf;
+    size_t req_len;
+
+    struct proxy_id_child *child;
+    struct tevent_req *io_req;
+    struct tevent_timer *timeout;
+    bool retried;
+
+    struct proxy_id_lookup_state *waiters;
+};
+
+struct proxy_id_workers {
+    struct proxy_id_ctx *id_ctx;
+    struct tevent_context *ev;
+    const char *libname;
+    int max_children;
+    int num_children;
+    /* seconds until a running lookup is treated as hung */
+    int timeout;
+
+    struct proxy_id_child *idle;
+    struct proxy_id_job *queue;
+    /* queued and running jobs by their key */
+    hash_table_t *jobs;
+};
+
+/* == recorded results of the NSS calls ===================================== */
+
+struct proxy_id_record {
+    enum proxy_id_child_call call;
+    uint32_t id;
+    const char *name;
+    enum nss_status status;
+    int err;
+
+    struct passwd pwd;
+    struct group grp;
+    gid_t *gids;
+    uint32_t num_gids;
+};
+
+struct proxy_id_recording {
+    struct proxy_id_record *records;
+    uint32_t num_records;
+};
+
+static errno_t proxy_id_parse_string(uint8_t *buf, size_t len, size_t *p,
+                                     char **_str)
+{
+    uint8_t *end;
+
+    if (*p >= len) {
+        return EINVAL;
+    }
+
+    end = memchr(buf + *p, '\0', len - *p);
+    if (end == NULL) {
+        return EINVAL;
+    }
+
+    *_str = (char *) buf + *p;
+    *p = end - buf + 1;
+    return EOK;
+}
+
+static errno_t proxy_id_parse_record(TALLOC_CTX *mem_ctx,
+                                     uint8_t *buf, size_t len, size_t *_p,
+                                     struct proxy_id_record *rec)
+{
+    uint32_t val;
+    uint32_t num_mem;
+    char *name;
+    size_t p = *_p;
+    errno_t ret;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&val, buf + p, len, &p);
+    rec->call = val;
+    SAFEALIGN_COPY_UINT32_CHECK(&rec->id, buf + p, len, &p);
+    ret = proxy_id_parse_string(buf, len, &p, &name);
+    if (ret != EOK) {
+        return ret;
+    }
+    rec->name = name;
+    SAFEALIGN_COPY_UINT32_CHECK(&val, buf + p, len, &p);
+    rec->status = (int32_t) val;
+    SAFEALIGN_COPY_UINT32_CHECK(&val, buf + p, len, &p);
+    rec->err = val;
+
+    if (rec->status != NSS_STATUS_SUCCESS) {
+        *_p = p;
+        return EOK;
+    }
+
+    switch (rec->call) {
+    case PROXY_ID_CHILD_GETPWNAM:
+    case PROXY_ID_CHILD_GETPWUID:
+        SAFEALIGN_COPY_UINT32_CHECK(&rec->pwd.pw_uid, buf + p, len, &p);
+        SAFEALIGN_COPY_UINT32_CHECK(&rec->pwd.pw_gid, buf + p, len, &p);
+        ret = proxy_id_parse_string(buf, len, &p, &rec->pwd.pw_name);
+        if (ret == EOK) {
+            ret = proxy_id_parse_string(buf, len, &p, &rec->pwd.pw_passwd);
+        }
+        if (ret == EOK) {
+            ret = proxy_id_parse_string(buf, len, &p, &rec->pwd.pw_gecos);
+        }
+        if (ret == EOK) {
+            ret = proxy_id_parse_string(buf, len, &p, &rec->pwd.pw_dir);
+        }
+        if (ret == EOK) {
+            ret = proxy_id_parse_string(buf, len, &p, &rec->pwd.pw_shell);
+        }
+        if (ret != EOK) {
+            return ret;
+        }
+        break;
+    case PROXY_ID_CHILD_GETGRNAM:
+    case PROXY_ID_CHILD_GETGRGID:
+        SAFEALIGN_COPY_UINT32_CHECK(&rec->grp.gr_gid, buf + p, len, &p);
+        SAFEALIGN_COPY_UINT32_CHECK(&num_mem, buf + p, len, &p);
+        if (num_mem > len - p) {
+            return EINVAL;
+        }
+        ret = proxy_id_parse_string(buf, len, &p, &rec->grp.gr_name);
+        if (ret == EOK) {
+            ret = proxy_id_parse_string(buf, len, &p, &rec->grp.gr_passwd);
+        }
+        if (ret != EOK) {
+            return ret;
+        }
+
+        rec->grp.gr_mem = talloc_array(mem_ctx, char *, num_mem + 1);
+        if (rec->grp.gr_mem == NULL) {
+            return ENOMEM;
+        }
+        for (uint32_t i = 0; i < num_mem; i++) {
+            ret = proxy_id_parse_string(buf, len, &p, &rec->grp.gr_mem[i]);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+        rec->grp.gr_mem[num_mem] = NULL;
+        break;
+    case PROXY_ID_CHILD_INITGROUPS_DYN:
+        SAFEALIGN_COPY_UINT32_CHECK(&rec->num_gids, buf + p, len, &p);
+        if (rec->num_gids > (len - p) / sizeof(uint32_t)) {
+            return EINVAL;
+        }
+
+        rec->gids = talloc_array(mem_ctx, gid_t, rec->num_gids);
+        if (rec->gids == NULL) {
+            return ENOMEM;
+        }
+        for (uint32_t i = 0; i < rec->num_gids; i++) {
+            SAFEALIGN_COPY_UINT32_CHECK(&rec->gids[i], buf + p, len, &p);
+        }
+        break;
+    default:
+        return EINVAL;
+    }
+
+    *_p = p;
+    return EOK;
+}
+
+/* The strings in the recording point into buf, which must be kept. */
+static errno_t proxy_id_parse_recording(TALLOC_CTX *mem_ctx,
+                                        uint8_t *buf, size_t len,
+                                        struct proxy_id_recording **_rec)
+{
+    struct proxy_id_recording *rec;
+    size_t p = 0;
+    errno_t ret;
+
+    rec = talloc_zero(mem_ctx, struct proxy_id_recording);
+    if (rec == NULL) {
+        return ENOMEM;
+    }
+
+    SAFEALIGN_COPY_UINT32_CHECK(&rec->num_records, buf + p, len, &p);
+    if (rec->num_records > len / (3 * sizeof(uint32_t))) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    rec->records = talloc_zero_array(rec, struct proxy_id_record,
+                                     rec->num_records);
+    if (rec->records == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (uint32_t i = 0; i < rec->num_records; i++) {
+        ret = proxy_id_parse_record(rec, buf, len, &p, &rec->records[i]);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Malformed response of proxy_id_child.\n");
+            goto done;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    if (ret == EOK) {
+        *_rec = rec;
+    } else {
+        talloc_free(rec);
+    }
+
+    return ret;
+}
+
+/* == NSS operations replaying the recorded results ========================= */
+
+/* Set only while proxy_account_info() runs with the replay operations. */
+static struct proxy_id_recording *proxy_id_replay_rec;
+static struct proxy_nss_ops *proxy_id_replay_live;
+
+static struct proxy_id_record *
+proxy_id_replay_find(enum proxy_id_child_call call,
+                     uint32_t id,
+                     const char *name)
+{
+    struct proxy_id_record *rec;
+    struct proxy_id_record *found = NULL;
+
+    /* The last record of a call is the final result if the child retried
+     * it with a larger buffer. The replay needs the same buffer size, so
+     * the lookup retries the same way. */
+    for (uint32_t i = 0; i < proxy_id_replay_rec->num_records; i++) {
+        rec = &proxy_id_replay_rec->records[i];
+        if (rec->call != call) {
+            continue;
+        }
+
+        if (name != NULL) {
+            if (strcmp(rec->name, name) != 0) {
+                continue;
+            }
+            if (call == PROXY_ID_CHILD_INITGROUPS_DYN && rec->id != id) {
+                continue;
+            }
+        } else if (rec->id != id) {
+            continue;
+        }
+
+        found = rec;
+    }
+
+    if (found == NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC, "NSS call [%d] for [%s][%"PRIu32"] was not "
+              "done by proxy_id_child, calling the module directly.\n",
+              call, name == NULL ? "" : name, id);
+    }
+
+    return found;
+}
+
+static char *proxy_id_replay_strcpy(char **_buffer, size_t *_buflen,
+                                    const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *dest = *_buffer;
+
+    if (len > *_buflen) {
+        return NULL;
+    }
+
+    memcpy(dest, str, len);
+    *_buffer += len;
+    *_buflen -= len;
+    return dest;
+}
+
+static enum nss_status proxy_id_replay_pwd(struct proxy_id_record *rec,
+                                           struct passwd *result,
+                                           char *buffer, size_t buflen,
+                                           int *errnop)
+{
+    if (rec->status != NSS_STATUS_SUCCESS) {
+        *errnop = rec->err;
+        return rec->status;
+    }
+
+    result->pw_uid = rec->pwd.pw_uid;
+    result->pw_gid = rec->pwd.pw_gid;
+    result->pw_name = proxy_id_replay_strcpy(&buffer, &buflen,
+                                             rec->pwd.pw_name);
+    result->pw_passwd = proxy_id_replay_strcpy(&buffer, &buflen,
+                                               rec->pwd.pw_passwd);
+    result->pw_gecos = proxy_id_replay_strcpy(&buffer, &buflen,
+                                              rec->pwd.pw_gecos);
+    result->pw_dir = proxy_id_replay_strcpy(&buffer, &buflen,
+                                            rec->pwd.pw_dir);
+    result->pw_shell = proxy_id_replay_strcpy(&buffer, &buflen,
+                                              rec->pwd.pw_shell);
+    if (result->pw_name == NULL || result->pw_passwd == NULL
+            || result->pw_gecos == NULL || result->pw_dir == NULL
+            || result->pw_shell == NULL) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status proxy_id_replay_grp(struct proxy_id_record *rec,
+                                           struct group *result,
+                                           char *buffer, size_t buflen,
+                                           int *errnop)
+{
+    size_t align;
+    size_t num_mem;
+    char **mem;
+
+    if (rec->status != NSS_STATUS_SUCCESS) {
+        *errnop = rec->err;
+        return rec->status;
+    }
+
+    for (num_mem = 0; rec->grp.gr_mem[num_mem] != NULL; num_mem++);
+
+    /* the array of members is stored at the beginning of the buffer */
+    align = (sizeof(char *) - ((uintptr_t) buffer % sizeof(char *)))
+                % sizeof(char *);
+    if (align + (num_mem + 1) * sizeof(char *) > buflen) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+    mem = (char **) (buffer + align);
+    buffer += align + (num_mem + 1) * sizeof(char *);
+    buflen -= align + (num_mem + 1) * sizeof(char *);
+
+    for (size_t i = 0; i < num_mem; i++) {
+        mem[i] = proxy_id_replay_strcpy(&buffer, &buflen,
+                                        rec->grp.gr_mem[i]);
+        if (mem[i] == NULL) {
+            *errnop = ERANGE;
+            return NSS_STATUS_TRYAGAIN;
+        }
+    }
+    mem[num_mem] = NULL;
+
+    result->gr_gid = rec->grp.gr_gid;
+    result->gr_mem = mem;
+    result->gr_name = proxy_id_replay_strcpy(&buffer, &buflen,
+                                             rec->grp.gr_name);
+    result->gr_passwd = proxy_id_replay_strcpy(&buffer, &buflen,
+                                               rec->grp.gr_passwd);
+    if (result->gr_name == NULL || result->gr_passwd == NULL) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status
+proxy_id_replay_getpwnam_r(const char *name, struct passwd *result,
+                           char *buffer, size_t buflen, int *errnop)
+{
+    struct proxy_id_record *rec;
+
+    rec = proxy_id_replay_find(PROXY_ID_CHILD_GETPWNAM, 0, name);
+    if (rec == NULL) {
+        return proxy_id_replay_live->getpwnam_r(name, result, buffer, buflen,
+                                                errnop);
+    }
+
+    return proxy_id_replay_pwd(rec, result, buffer, buflen, errnop);
+}
+
+static enum nss_status
+proxy_id_replay_getpwuid_r(uid_t uid, struct passwd *result,
+                           char *buffer, size_t buflen, int *errnop)
+{
+    struct proxy_id_record *rec;
+
+    rec = proxy_id_replay_find(PROXY_ID_CHILD_GETPWUID, uid, NULL);
+    if (rec == NULL) {
+        return proxy_id_replay_live->getpwuid_r(uid, result, buffer, buflen,
+                                                errnop);
+    }
+
+    return proxy_id_replay_pwd(rec, result, buffer, buflen, errnop);
+}
+
+static enum nss_status
+proxy_id_replay_getgrnam_r(const char *name, struct group *result,
+                           char *buffer, size_t buflen, int *errnop)
+{
+    struct proxy_id_record *rec;
+
+    rec = proxy_id_replay_find(PROXY_ID_CHILD_GETGRNAM, 0, name);
+    if (rec == NULL) {
+        return proxy_id_replay_live->getgrnam_r(name, result, buffer, buflen,
+                                                errnop);
+    }
+
+    return proxy_id_replay_grp(rec, result, buffer, buflen, errnop);
+}
+
+static enum nss_status
+proxy_id_replay_getgrgid_r(gid_t gid, struct group *result,
+                           char *buffer, size_t buflen, int *errnop)
+{
+    struct proxy_id_record *rec;
+
+    rec = proxy_id_replay_find(PROXY_ID_CHILD_GETGRGID, gid, NULL);
+    if (rec == NULL) {
+        return proxy_id_replay_live->getgrgid_r(gid, result, buffer, buflen,
+                                                errnop);
+    }
+
+    return proxy_id_replay_grp(rec, result, buffer, buflen, errnop);
+}
+
+static enum nss_status
+proxy_id_replay_initgroups_dyn(const char *user, gid_t group,
+                               long int *start, long int *size,
+                               gid_t **groups, long int limit,
+                               int *errnop)
+{
+    struct proxy_id_record *rec;
+    long int num;
+
+    rec = proxy_id_replay_find(PROXY_ID_CHILD_INITGROUPS_DYN, group, user);
+    if (rec == NULL) {
+        return proxy_id_replay_live->initgroups_dyn(user, group, start, size,
+                                                    groups, limit, errnop);
+    }
+
+    if (rec->status != NSS_STATUS_SUCCESS) {
+        *errnop = rec->err;
+        return rec->status;
+    }
+
+    /* The recorded list was created with the same initial array as the
+     * caller uses, so it replaces the whole array. */
+    num = rec->num_gids;
+    if (num > *size) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+    if (limit > 0 && num > limit) {
+        num = limit;
+    }
+
+    memcpy(*groups, rec->gids, num * sizeof(gid_t));
+    *start = num;
+
+    return NSS_STATUS_SUCCESS;
+}
+
+static struct dp_reply_std
+proxy_id_replay(TALLOC_CTX *mem_ctx,
+                struct proxy_id_workers *workers,
+                struct dp_id_data *data,
+                struct proxy_id_recording *rec)
+{
+    struct proxy_id_ctx replay_ctx;
+    struct dp_reply_std reply;
+    struct be_ctx *be_ctx = workers->id_ctx->be;
+
+    replay_ctx = *workers->id_ctx;
+    replay_ctx.ops.getpwnam_r = proxy_id_replay_getpwnam_r;
+    replay_ctx.ops.getpwuid_r = proxy_id_replay_getpwuid_r;
+    replay_ctx.ops.getgrnam_r = proxy_id_replay_getgrnam_r;
+    replay_ctx.ops.getgrgid_r = proxy_id_replay_getgrgid_r;
+    if (replay_ctx.ops.initgroups_dyn != NULL) {
+        replay_ctx.ops.initgroups_dyn = proxy_id_replay_initgroups_dyn;
+    }
+
+    proxy_id_replay_rec = rec;
+    proxy_id_replay_live = &workers->id_ctx->ops;
+
+    reply = proxy_account_info(mem_ctx, &replay_ctx, data, be_ctx,
+                               be_ctx->domain);
+
+    proxy_id_replay_rec = NULL;
+    proxy_id_replay_live = NULL;
+
+    return reply;
+}
+
+/* == long-lived proxy_id_child processes =================================== */
+
+static int proxy_id_child_destructor(struct proxy_id_child *child)
+{
+    if (child->idle) {
+        DLIST_REMOVE(child->workers->idle, child);
+        child->idle = false;
+    }
+
+    if (child->child_ctx != NULL) {
+        /* the child is still running, make sure it terminates */
+        child_handler_destroy(child->child_ctx);
+        child->child_ctx = NULL;
+    }
+
+    child->workers->num_children--;
+
+    return 0;
+}
+
+static void proxy_id_child_exited(int child_status,
+                                  struct tevent_signal *sige,
+                                  void *pvt)
+{
+    struct proxy_id_child *child = talloc_get_type(pvt,
+                                                   struct proxy_id_child);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "proxy_id_child [%d] exited\n", child->pid);
+
+    /* the signal handler context is freed by the caller */
+    child->child_ctx = NULL;
+    child->exited = true;
+
+    /* a busy child is freed by the job using it, which will see the
+     * closed pipe */
+    if (child->idle) {
+        talloc_free(child);
+    }
+}
+
+static errno_t proxy_id_child_fork(struct proxy_id_workers *workers,
+                                   struct proxy_id_child **_child)
+{
+    int pipefd_to_child[2] = PIPE_INIT;
+    int pipefd_from_child[2] = PIPE_INIT;
+    const char *extra_args[3] = { NULL };
+    struct proxy_id_child *child;
+    pid_t pid;
+    errno_t ret;
+
+    child = talloc_zero(workers, struct proxy_id_child);
+    if (child == NULL) {
+        return ENOMEM;
+    }
+    child->workers = workers;
+
+    /* extra_args are added in reverse order */
+    extra_args[0] = workers->libname;
+    extra_args[1] = "--libname";
+
+    child->io = talloc(child, struct child_io_fds);
+    if (child->io == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
+        ret = ENOMEM;
+        goto fail;
+    }
+    child->io->write_to_child_fd = -1;
+    child->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) child->io, child_io_destructor);
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    pid = fork();
+
+    if (pid == 0) { /* child */
+        exec_child_ex(child,
+                      pipefd_to_child, pipefd_from_child,
+                      PROXY_ID_CHILD, proxy_id_child_debug_fd, extra_args,
+                      false, STDIN_FILENO, PROXY_ID_CHILD_OUT_FILENO);
+
+        /* We should never get here */
+        DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec proxy_id_child\n");
+    } else if (pid > 0) { /* parent */
+        child->pid = pid;
+        child->io->read_from_child_fd = pipefd_from_child[0];
+        PIPE_FD_CLOSE(pipefd_from_child[1]);
+        child->io->write_to_child_fd = pipefd_to_child[1];
+        PIPE_FD_CLOSE(pipefd_to_child[0]);
+        sss_fd_nonblocking(child->io->read_from_child_fd);
+        sss_fd_nonblocking(child->io->write_to_child_fd);
+
+        ret = child_handler_setup(workers->ev, pid, proxy_id_child_exited,
+                                  child, &child->child_ctx);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Could not set up child signal handler\n");
+            /* the pipes are closed by the io destructor */
+            kill(pid, SIGKILL);
+            talloc_free(child);
+            return ret;
+        }
+        workers->num_children++;
+        talloc_set_destructor(child, proxy_id_child_destructor);
+    } else { /* error */
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started proxy_id_child [%d]\n", child->pid);
+    *_child = child;
+    return EOK;
+
+fail:
+    PIPE_CLOSE(pipefd_from_child);
+    PIPE_CLOSE(pipefd_to_child);
+    talloc_free(child);
+    return ret;
+}
+
+/*
+ * This function returns an idle proxy_id_child or starts a new one if the
+ * limit is not reached yet. EAGAIN is returned if all children are busy.
+ */
+static errno_t proxy_id_child_get(struct proxy_id_workers *workers,
+                                  struct proxy_id_child **_child)
+{
+    struct proxy_id_child *child;
+
+    child = workers->idle;
+    if (child == NULL) {
+        if (workers->num_children >= workers->max_children) {
+            return EAGAIN;
+        }
+        return proxy_id_child_fork(workers, _child);
+    }
+
+    DLIST_REMOVE(workers->idle, child);
+    child->idle = false;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Reusing proxy_id_child [%d]\n", child->pid);
+    *_child = child;
+    return EOK;
+}
+
+/*
+ * This function returns a proxy_id_child after a request. Children which
+ * failed are terminated.
+ */
+static void proxy_id_child_put(struct proxy_id_child *child, bool reusable)
+{
+    if (!reusable || child->exited) {
+        talloc_free(child);
+        return;
+    }
+
+    child->idle = true;
+    DLIST_ADD(child->workers->idle, child);
+}
+
+/* Read a length-prefixed response from the proxy_id_child */
+
+struct proxy_id_child_read_state {
+    int fd;
+    uint8_t hdr[sizeof(uint32_t)];
+    uint8_t *buf;
+    size_t size;
+    size_t nread;
+};
+
+static void proxy_id_child_read_handler(struct tevent_context *ev,
+                                        struct tevent_fd *fde,
+                                        uint16_t flags, void *pvt);
+
+static struct tevent_req *
+proxy_id_child_read_send(TALLOC_CTX *mem_ctx,
+                         struct tevent_context *ev,
+                         int fd)
+{
+    struct tevent_req *req;
+    struct proxy_id_child_read_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct proxy_id_child_read_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->fd = fd;
+    state->buf = NULL;
+    state->size = 0;
+    state->nread = 0;
+
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        proxy_id_child_read_handler, req);
+    if (fde == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_fd failed.\n");
+        talloc_zfree(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+static void proxy_id_child_read_handler(struct tevent_context *ev,
+                                        struct tevent_fd *fde,
+                                        uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct proxy_id_child_read_state *state =
+            tevent_req_data(req, struct proxy_id_child_read_state);
+    uint32_t len;
+    uint8_t *dst;
+    size_t size;
+    ssize_t nread;
+    errno_t ret;
+
+    /* The header is read first, then the announced amount of data. */
+    if (state->buf == NULL) {
+        dst = state->hdr + state->nread;
+        size = sizeof(state->hdr) - state->nread;
+    } else {
+        dst = state->buf + state->nread;
+        size = state->size - state->nread;
+    }
+
+    errno = 0;
+    nread = read(state->fd, dst, size);
+    if (nread == -1) {
+        ret = errno;
+        if (ret == EAGAIN || ret == EINTR) {
+            return;
+        }
+
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    } else if (nread == 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "proxy_id_child closed the pipe.\n");
+        tevent_req_error(req, EPIPE);
+        return;
+    }
+
+    state->nread += nread;
+
+    if (state->buf == NULL) {
+        if (state->nread < sizeof(state->hdr)) {
+            return;
+        }
+
+        SAFEALIGN_COPY_UINT32(&len, state->hdr, NULL);
+        if (len < sizeof(uint32_t)
+                || len > PROXY_ID_CHILD_MAX_RESPONSE_SIZE) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Invalid response length [%"PRIu32"].\n", len);
+            tevent_req_error(req, EINVAL);
+            return;
+        }
+
+        state->buf = talloc_size(state, len);
+        if (state->buf == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+        state->size = len;
+        state->nread = 0;
+        return;
+    }
+
+    if (state->nread == state->size) {
+        tevent_req_done(req);
+    }
+}
+
+static errno_t proxy_id_child_read_recv(struct tevent_req *req,
+                                        TALLOC_CTX *mem_ctx,
+                                        uint8_t **_buf,
+                                        size_t *_len)
+{
+    struct proxy_id_child_read_state *state =
+            tevent_req_data(req, struct proxy_id_child_read_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_buf = talloc_steal(mem_ctx, state->buf);
+    *_len = state->size;
+    return EOK;
+}
+
+/* == queue of lookups ====================================================== */
+
+struct proxy_id_lookup_state {
+    struct proxy_id_lookup_state *prev;
+    struct proxy_id_lookup_state *next;
+
+    struct tevent_req *req;
+    struct proxy_id_job *job;
+    struct dp_reply_std reply;
+};
+
+static void proxy_id_dispatch(struct proxy_id_workers *workers);
+static void proxy_id_job_write_done(struct tevent_req *subreq);
+static void proxy_id_job_done(struct tevent_req *subreq);
+static void proxy_id_job_timeout(struct tevent_context *ev,
+                                 struct tevent_timer *te,
+                                 struct timeval tv, void *pvt);
+
+static int proxy_id_job_destructor(struct proxy_id_job *job)
+{
+    struct proxy_id_lookup_state *state;
+    hash_key_t key;
+
+    /* the job is freed before it finished, e.g. during shutdown */
+    DLIST_FOR_EACH(state, job->waiters) {
+        state->job = NULL;
+    }
+
+    if (job->child != NULL) {
+        talloc_zfree(job->io_req);
+        proxy_id_child_put(job->child, false);
+        job->child = NULL;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = job->key;
+    hash_delete(job->workers->jobs, &key);
+
+    return 0;
+}
+
+static void proxy_id_job_finish(struct proxy_id_job *job,
+                                struct dp_reply_std reply)
+{
+    struct proxy_id_lookup_state *state;
+
+    while ((state = job->waiters) != NULL) {
+        DLIST_REMOVE(job->waiters, state);
+        state->job = NULL;
+        state->reply = reply;
+        tevent_req_done(state->req);
+    }
+
+    talloc_free(job);
+}
+
+static void proxy_id_job_error(struct proxy_id_job *job, errno_t ret)
+{
+    struct dp_reply_std reply;
+
+    dp_reply_std_set(&reply, DP_ERR_DECIDE, ret, NULL);
+    proxy_id_job_finish(job, reply);
+}
+
+static errno_t proxy_id_job_start(struct proxy_id_job *job,
+                                  struct proxy_id_child *child)
+{
+    struct proxy_id_workers *workers = job->workers;
+    struct timeval tv;
+
+    job->child = child;
+    child->num_requests++;
+
+    tv = tevent_timeval_current_ofs(workers->timeout, 0);
+    job->timeout = tevent_add_timer(workers->ev, job, tv,
+                                    proxy_id_job_timeout, job);
+    if (job->timeout == NULL) {
+        return ENOMEM;
+    }
+
+    job->io_req = write_pipe_send(job, workers->ev, job->req_buf,
+                                  job->req_len,
+                                  child->io->write_to_child_fd);
+    if (job->io_req == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "write_pipe_send failed.\n");
+        return ENOMEM;
+    }
+    tevent_req_set_callback(job->io_req, proxy_id_job_write_done, job);
+
+    return EOK;
+}
+
+/*
+ * A child which was already used before might have exited because it was
+ * idle for too long, in this case the job is queued once more to run on
+ * another child.
+ */
+static void proxy_id_job_failed(struct proxy_id_job *job, errno_t ret)
+{
+    struct proxy_id_workers *workers = job->workers;
+    bool reused;
+
+    reused = job->child->num_requests > 1;
+    proxy_id_child_put(job->child, false);
+    job->child = NULL;
+    talloc_zfree(job->timeout);
+
+    if (reused && !job->retried && ret != ENOMEM) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Communication with proxy_id_child failed [%d][%s], "
+              "retrying.\n", ret, sss_strerror(ret));
+        job->retried = true;
+        DLIST_ADD(workers->queue, job);
+    } else {
+        proxy_id_job_error(job, ret);
+    }
+
+    proxy_id_dispatch(workers);
+}
+
+static void proxy_id_job_write_done(struct tevent_req *subreq)
+{
+    struct proxy_id_job *job = tevent_req_callback_data(subreq,
+                                                        struct proxy_id_job);
+    errno_t ret;
+
+    ret = write_pipe_recv(subreq);
+    talloc_zfree(subreq);
+    job->io_req = NULL;
+    if (ret != EOK) {
+        proxy_id_job_failed(job, ret);
+        return;
+    }
+
+    job->io_req = proxy_id_child_read_send(job, job->workers->ev,
+                                           job->child->io->read_from_child_fd);
+    if (job->io_req == NULL) {
+        proxy_id_job_failed(job, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(job->io_req, proxy_id_job_done, job);
+}
+
+static void proxy_id_job_done(struct tevent_req *subreq)
+{
+    struct proxy_id_job *job = tevent_req_callback_data(subreq,
+                                                        struct proxy_id_job);
+    struct proxy_id_workers *workers = job->workers;
+    struct proxy_id_recording *rec;
+    struct dp_reply_std reply;
+    uint8_t *buf;
+    size_t len;
+    errno_t ret;
+
+    ret = proxy_id_child_read_recv(subreq, job, &buf, &len);
+    talloc_zfree(subreq);
+    job->io_req = NULL;
+    if (ret != EOK) {
+        proxy_id_job_failed(job, ret);
+        return;
+    }
+
+    talloc_zfree(job->timeout);
+
+    /* the child is ready for the next request */
+    proxy_id_child_put(job->child, true);
+    job->child = NULL;
+
+    ret = proxy_id_parse_recording(job, buf, len, &rec);
+    if (ret != EOK) {
+        proxy_id_job_error(job, ret);
+    } else {
+        reply = proxy_id_replay(job, workers, job->data, rec);
+        proxy_id_job_finish(job, reply);
+    }
+
+    proxy_id_dispatch(workers);
+}
+
+static void proxy_id_job_timeout(struct tevent_context *ev,
+                                 struct tevent_timer *te,
+                                 struct timeval tv, void *pvt)
+{
+    struct proxy_id_job *job = talloc_get_type(pvt, struct proxy_id_job);
+    struct proxy_id_workers *workers = job->workers;
+
+    DEBUG(SSSDBG_CRIT_FAILURE, "Timeout reached for proxy_id_child [%d].\n",
+          job->child->pid);
+    job->timeout = NULL;
+
+    talloc_zfree(job->io_req);
+    proxy_id_child_put(job->child, false);
+    job->child = NULL;
+
+    proxy_id_job_error(job, ETIMEDOUT);
+    proxy_id_dispatch(workers);
+}
+
+static void proxy_id_dispatch(struct proxy_id_workers *workers)
+{
+    struct proxy_id_child *child;
+    struct proxy_id_job *job;
+    errno_t ret;
+
+    while ((job = workers->queue) != NULL) {
+        ret = proxy_id_child_get(workers, &child);
+        if (ret == EAGAIN) {
+            DEBUG(SSSDBG_TRACE_INTERNAL,
+                  "All proxy_id_child processes are busy.\n");
+            return;
+        }
+
+        DLIST_REMOVE(workers->queue, job);
+
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Unable to start proxy_id_child.\n");
+            proxy_id_job_error(job, ret);
+            continue;
+        }
+
+        ret = proxy_id_job_start(job, child);
+        if (ret != EOK) {
+            proxy_id_job_error(job, ret);
+        }
+    }
+}
+
+static errno_t proxy_id_job_request(TALLOC_CTX *mem_ctx,
+                                    struct dp_id_data *data,
+                                    uint8_t **_buf,
+                                    size_t *_len)
+{
+    TALLOC_CTX *tmp_ctx;
+    uint32_t op;
+    uint32_t id = 0;
+    char *name = NULL;
+    char *endptr;
+    uint8_t *buf;
+    size_t name_len;
+    size_t len;
+    size_t p = 0;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    switch (data->entry_type & BE_REQ_TYPE_MASK) {
+    case BE_REQ_USER:
+        op = data->filter_type == BE_FILTER_NAME ? PROXY_ID_CHILD_USER_BY_NAME
+                                                 : PROXY_ID_CHILD_USER_BY_ID;
+        break;
+    case BE_REQ_GROUP:
+        op = data->filter_type == BE_FILTER_NAME ? PROXY_ID_CHILD_GROUP_BY_NAME
+                                                 : PROXY_ID_CHILD_GROUP_BY_ID;
+        break;
+    case BE_REQ_INITGROUPS:
+        op = PROXY_ID_CHILD_INITGROUPS;
+        break;
+    default:
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (data->filter_type == BE_FILTER_NAME) {
+        ret = sss_parse_internal_fqname(tmp_ctx, data->filter_value,
+                                        &name, NULL);
+        if (ret != EOK) {
+            goto done;
+        }
+    } else {
+        errno = 0;
+        id = strtouint32(data->filter_value, &endptr, 10);
+        if (errno || *endptr || (data->filter_value == endptr)) {
+            ret = EINVAL;
+            goto done;
+        }
+    }
+
+    name_len = name == NULL ? 1 : strlen(name) + 1;
+    len = 3 * sizeof(uint32_t) + name_len;
+    if (len - sizeof(uint32_t) > PROXY_ID_CHILD_MAX_REQUEST_SIZE) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    buf = talloc_size(mem_ctx, len);
+    if (buf == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    SAFEALIGN_SET_UINT32(buf + p, len - sizeof(uint32_t), &p);
+    SAFEALIGN_SET_UINT32(buf + p, op, &p);
+    SAFEALIGN_SET_UINT32(buf + p, id, &p);
+    safealign_memcpy(buf + p, name == NULL ? "" : name, name_len, &p);
+
+    *_buf = buf;
+    *_len = len;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static struct proxy_id_job *
+proxy_id_job_create(struct proxy_id_workers *workers,
+                    struct dp_id_data *data,
+                    const char *key)
+{
+    struct proxy_id_job *job;
+    hash_key_t hkey;
+    hash_value_t value;
+    errno_t ret;
+    int hret;
+
+    job = talloc_zero(workers, struct proxy_id_job);
+    if (job == NULL) {
+        return NULL;
+    }
+    job->workers = workers;
+
+    job->key = talloc_strdup(job, key);
+    job->data = talloc_zero(job, struct dp_id_data);
+    if (job->key == NULL || job->data == NULL) {
+        goto fail;
+    }
+
+    job->data->entry_type = data->entry_type;
+    job->data->filter_type = data->filter_type;
+    job->data->filter_value = talloc_strdup(job->data, data->filter_value);
+    if (job->data->filter_value == NULL) {
+        goto fail;
+    }
+    if (data->domain != NULL) {
+        job->data->domain = talloc_strdup(job->data, data->domain);
+        if (job->data->domain == NULL) {
+            goto fail;
+        }
+    }
+
+    ret = proxy_id_job_request(job, data, &job->req_buf, &job->req_len);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to create request for "
+              "proxy_id_child [%d]: %s\n", ret, sss_strerror(ret));
+        goto fail;
+    }
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = job->key;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = job;
+
+    hret = hash_enter(workers->jobs, &hkey, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to add job: %s\n",
+              hash_error_string(hret));
+        goto fail;
+    }
+    talloc_set_destructor(job, proxy_id_job_destructor);
+
+    return job;
+
+fail:
+    talloc_free(job);
+    return NULL;
+}
+
+static int proxy_id_lookup_state_destructor(struct proxy_id_lookup_state *state)
+{
+    /* the job continues for other waiters or to update the cache */
+    if (state->job != NULL) {
+        DLIST_REMOVE(state->job->waiters, state);
+        state->job = NULL;
+    }
+
+    return 0;
+}
+
+bool proxy_id_workers_supported(struct proxy_id_ctx *id_ctx,
+                                struct dp_id_data *data)
+{
+    switch (data->entry_type & BE_REQ_TYPE_MASK) {
+    case BE_REQ_USER:
+    case BE_REQ_GROUP:
+        return data->filter_type == BE_FILTER_NAME
+                    || data->filter_type == BE_FILTER_IDNUM;
+    case BE_REQ_INITGROUPS:
+        return data->filter_type == BE_FILTER_NAME
+                    && id_ctx->ops.initgroups_dyn != NULL;
+    default:
+        /* Enumerations keep their state in the module and netgroups and
+         * services are rarely used, they are looked up in-process. */
+        return false;
+    }
+}
+
+struct tevent_req *
+proxy_id_workers_lookup_send(TALLOC_CTX *mem_ctx,
+                             struct tevent_context *ev,
+                             struct proxy_id_workers *workers,
+                             struct dp_id_data *data)
+{
+    struct proxy_id_lookup_state *state;
+    struct proxy_id_job *job;
+    struct tevent_req *req;
+    hash_key_t key;
+    hash_value_t value;
+    char *job_key;
+    errno_t ret;
+    int hret;
+
+    req = tevent_req_create(mem_ctx, &state, struct proxy_id_lookup_state);
+    if (req == NULL) {
+        return NULL;
+    }
+    state->req = req;
+    talloc_set_destructor(state, proxy_id_lookup_state_destructor);
+
+    job_key = talloc_asprintf(state, "%u:%u:%s",
+                              data->entry_type & BE_REQ_TYPE_MASK,
+                              data->filter_type, data->filter_value);
+    if (job_key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = job_key;
+
+    hret = hash_lookup(workers->jobs, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Lookup [%s] is already in progress, waiting for it.\n",
+              job_key);
+        job = talloc_get_type(value.ptr, struct proxy_id_job);
+        state->job = job;
+        DLIST_ADD_END(job->waiters, state, struct proxy_id_lookup_state *);
+        return req;
+    }
+
+    job = proxy_id_job_create(workers, data, job_key);
+    if (job == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    state->job = job;
+    DLIST_ADD(job->waiters, state);
+    DLIST_ADD_END(workers->queue, job, struct proxy_id_job *);
+
+    proxy_id_dispatch(workers);
+
+    /* the job may have failed already */
+    if (!tevent_req_is_in_progress(req)) {
+        tevent_req_post(req, ev);
+    }
+
+    return req;
+
+done:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+errno_t proxy_id_workers_lookup_recv(struct tevent_req *req,
+                                     struct dp_reply_std *_reply)
+{
+    struct proxy_id_lookup_state *state;
+
+    state = tevent_req_data(req, struct proxy_id_lookup_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_reply = state->reply;
+    return EOK;
+}
+
+errno_t proxy_id_workers_init(TALLOC_CTX *mem_ctx,
+                              struct proxy_id_ctx *id_ctx,
+                              const char *libname,
+                              int max_children,
+                              struct proxy_id_workers **_workers)
+{
+    struct proxy_id_workers *workers;
+    errno_t ret;
+
+    workers = talloc_zero(mem_ctx, struct proxy_id_workers);
+    if (workers == NULL) {
+        return ENOMEM;
+    }
+
+    workers->id_ctx = id_ctx;
+    workers->ev = id_ctx->be->ev;
+    workers->max_children = max_children;
+    workers->timeout = PROXY_ID_CHILD_TIMEOUT;
+
+    workers->libname = talloc_strdup(workers, libname);
+    if (workers->libname == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_hash_create(workers, 0, &workers->jobs);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = child_debug_init(PROXY_ID_CHILD_LOG_FILE, &proxy_id_child_debug_fd);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Could not set proxy_id_child debugging!\n");
+        goto done;
+    }
+
+    *_workers = workers;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(workers);
+    }
+
+    return ret;
+}
@@ -30,6 +30,7 @@
 #define NSS_FN_NAME "_nss_%s_%s"
 
 #define OPT_MAX_CHILDREN_DEFAULT 10
+#define OPT_MAX_ID_CHILDREN_DEFAULT 0
 
 #define ERROR_INITGR "The '%s' library does not provides the " \
                          "_nss_XXX_initgroups_dyn function!\n" \
@@ -318,6 +319,7 @@ errno_t sssm_proxy_id_init(TALLOC_CTX *mem_ctx,
     struct proxy_id_ctx *ctx;
     char *libname;
     char *libpath;
+    int max_id_children;
     errno_t ret;
 
     ctx = talloc_zero(mem_ctx, struct proxy_id_ctx);
@@ -347,6 +349,28 @@ errno_t sssm_proxy_id_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    ret = confdb_get_int(be_ctx->cdb, be_ctx->conf_path,
+                         CONFDB_PROXY_MAX_ID_CHILDREN,
+                         OPT_MAX_ID_CHILDREN_DEFAULT,
+                         &max_id_children);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Unable to read confdb [%d]: %s\n", ret, sss_strerror(ret));
+        goto done;
+    }
+
+    /* 0 keeps the lookups in the backend process */
+    if (max_id_children > 0) {
+        ret = proxy_id_workers_init(ctx, ctx, libname, max_id_children,
+                                    &ctx->workers);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  "Unable to set up proxy_id_child processes [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            goto done;
+        }
+    }
+
     dp_set_method(dp_methods, DPM_ACCOUNT_HANDLER,
                   proxy_account_info_handler_send, proxy_account_info_handler_recv, ctx,
                   struct proxy_id_ctx, struct dp_id_data, struct dp_reply_std);
@@ -688,6 +688,7 @@ struct cache_req_state {
     const char *domain_name;
 
     /* work data */
+    TALLOC_CTX *pool;
     struct cache_req_result **results;
     size_t num_results;
     bool first_iteration;
@@ -741,7 +742,8 @@ struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
     }
 
     state->ev = ev;
-    state->cr = cr = cache_req_create(state, rctx, data,
+    state->pool = sss_req_pool_new(state, SSS_REQ_POOL_CACHE_REQ);
+    state->cr = cr = cache_req_create(state->pool, rctx, data,
                                       ncache, midpoint, req_dom_type);
     if (state->cr == NULL) {
         ret = ENOMEM;
@@ -761,7 +763,7 @@ struct tevent_req *cache_req_send(TALLOC_CTX *mem_ctx,
     }
 
     state->domain_name = domain;
-    ret = cache_req_process_input(state, req, cr, domain);
+    ret = cache_req_process_input(state->pool, req, cr, domain);
     if (ret != EOK) {
         goto done;
     }
@@ -785,8 +787,11 @@ static errno_t cache_req_process_input(TALLOC_CTX *mem_ctx,
                                        struct cache_req *cr,
                                        const char *domain)
 {
+    struct cache_req_state *state;
     struct tevent_req *subreq;
     const char *default_domain;
+    const char *parsed_domain;
+    const char *name;
     errno_t ret;
 
     if (cr->data->name.input == NULL) {
@@ -814,6 +819,33 @@ static errno_t cache_req_process_input(TALLOC_CTX *mem_ctx,
         default_domain = cr->rctx->default_domain;
     }
 
+    /* Once the list of domains is known, parse the name synchronously and
+     * reuse the result of previous requests for the same input. */
+    if (cr->rctx->get_domains_last_call.tv_sec > 0) {
+        ret = cache_req_name_cache_parse(cr->rctx,
+                                         !cr->plugin->ignore_default_domain,
+                                         cr->data->name.input,
+                                         &name, &parsed_domain);
+        if (ret == EOK) {
+            ret = cache_req_set_name(cr, name);
+            if (ret != EOK) {
+                return ret;
+            }
+
+            if (parsed_domain != NULL) {
+                state = tevent_req_data(req, struct cache_req_state);
+                state->domain_name = talloc_strdup(state, parsed_domain);
+                if (state->domain_name == NULL) {
+                    return ENOMEM;
+                }
+            }
+
+            return EOK;
+        }
+
+        /* Let sss_parse_inp_send() refresh the domains or report the error */
+    }
+
     /* Parse name since it may contain a domain name. */
     CACHE_REQ_DEBUG(SSSDBG_TRACE_FUNC, cr,
                     "Parsing input name [%s]\n", cr->data->name.input);
@@ -990,9 +1022,9 @@ cache_req_search_domains(struct tevent_req *req,
                     bypass_cache ? "bypass" : "check",
                     bypass_dp ? "bypass" : "check");
 
-    subreq = cache_req_search_domains_send(state, state->ev, state->cr,
-                                           cr_domain, check_next,
-                                           bypass_cache, bypass_dp);
+    subreq = cache_req_search_domains_send(state->pool, state->ev, state->cr,
+                                           cr_domain, check_next, bypass_cache,
+                                           bypass_dp);
     if (subreq == NULL) {
         return ENOMEM;
     }
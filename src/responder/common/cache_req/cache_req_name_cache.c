@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <dhash.h>
+
+#include "util/util.h"
+#include "responder/common/responder.h"
+#include "responder/common/cache_req/cache_req_private.h"
+
+/* The cache is simply dropped when it grows over this limit. Clients tend
+ * to ask for the same names over and over, so the working set is refilled
+ * quickly. */
+#define CACHE_REQ_NAME_CACHE_MAX 4096
+
+struct cache_req_name_cache_entry {
+    char *name;
+    char *domain;
+};
+
+/* Input names that were already parsed with the current domain list. There
+ * is one table for names parsed with the default domain and one for names
+ * parsed without it. The whole cache is freed by the responder whenever the
+ * list of domains or their state changes.
+ */
+struct cache_req_name_cache {
+    hash_table_t *table[2];
+};
+
+static struct cache_req_name_cache *
+cache_req_name_cache_get(struct resp_ctx *rctx)
+{
+    struct cache_req_name_cache *cache;
+    errno_t ret;
+    int i;
+
+    if (rctx->cr_name_cache != NULL) {
+        return rctx->cr_name_cache;
+    }
+
+    cache = talloc_zero(rctx, struct cache_req_name_cache);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < 2; i++) {
+        ret = sss_hash_create(cache, 0, &cache->table[i]);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Unable to create name cache [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            talloc_free(cache);
+            return NULL;
+        }
+    }
+
+    rctx->cr_name_cache = cache;
+    return cache;
+}
+
+static errno_t
+cache_req_name_cache_add(struct resp_ctx *rctx,
+                         struct cache_req_name_cache *cache,
+                         int idx,
+                         const char *input,
+                         char *name,
+                         char *domain,
+                         struct cache_req_name_cache_entry **_entry)
+{
+    struct cache_req_name_cache_entry *entry;
+    hash_key_t key;
+    hash_value_t value;
+    errno_t ret;
+    int hret;
+
+    if (hash_count(cache->table[idx]) >= CACHE_REQ_NAME_CACHE_MAX) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Name cache is full, flushing it\n");
+        talloc_zfree(cache->table[idx]);
+
+        ret = sss_hash_create(cache, 0, &cache->table[idx]);
+        if (ret != EOK) {
+            /* Leave the cache to be recreated on the next lookup */
+            talloc_zfree(rctx->cr_name_cache);
+            goto fail;
+        }
+    }
+
+    entry = talloc_zero(cache->table[idx], struct cache_req_name_cache_entry);
+    if (entry == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    entry->name = talloc_steal(entry, name);
+    entry->domain = talloc_steal(entry, domain);
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(input);
+    value.type = HASH_VALUE_PTR;
+    value.ptr = entry;
+
+    hret = hash_enter(cache->table[idx], &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to cache parsed name [%s]: %s\n",
+              input, hash_error_string(hret));
+        talloc_free(entry);
+        return EIO;
+    }
+
+    *_entry = entry;
+    return EOK;
+
+fail:
+    talloc_free(name);
+    talloc_free(domain);
+    return ret;
+}
+
+errno_t
+cache_req_name_cache_parse(struct resp_ctx *rctx,
+                           bool use_default_domain,
+                           const char *input,
+                           const char **_name,
+                           const char **_domain)
+{
+    struct cache_req_name_cache_entry *entry;
+    struct cache_req_name_cache *cache;
+    hash_key_t key;
+    hash_value_t value;
+    char *name = NULL;
+    char *domain = NULL;
+    errno_t ret;
+    int idx;
+    int hret;
+
+    cache = cache_req_name_cache_get(rctx);
+    if (cache == NULL) {
+        return ENOMEM;
+    }
+
+    idx = use_default_domain ? 1 : 0;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(input);
+
+    hret = hash_lookup(cache->table[idx], &key, &value);
+    if (hret == HASH_SUCCESS) {
+        entry = talloc_get_type(value.ptr, struct cache_req_name_cache_entry);
+        goto done;
+    } else if (hret != HASH_ERROR_KEY_NOT_FOUND) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to search name cache: %s\n",
+              hash_error_string(hret));
+    }
+
+    ret = sss_parse_name_for_domains(NULL, rctx->domains,
+                                     use_default_domain ? rctx->default_domain
+                                                        : NULL,
+                                     input, &domain, &name);
+    if (ret != EOK) {
+        /* Unknown domains and invalid input are left to sss_parse_inp_send()
+         * which can refresh the list of domains and reports errors. */
+        talloc_free(domain);
+        talloc_free(name);
+        return ret;
+    }
+
+    ret = cache_req_name_cache_add(rctx, cache, idx, input, name, domain,
+                                   &entry);
+    if (ret != EOK) {
+        return ret;
+    }
+
+done:
+    *_name = entry->name;
+    *_domain = entry->domain;
+    return EOK;
+}
@@ -152,6 +152,18 @@ cache_req_create_result_from_msg(TALLOC_CTX *mem_ctx,
                                  const char *lookup_name,
                                  const char *well_known_domain);
 
+/* Parses the input name with the current list of domains and remembers the
+ * result for the next requests with the same input. The returned strings
+ * are owned by the cache and must be copied before returning to the event
+ * loop. Returns EAGAIN if the input contains an unknown domain.
+ */
+errno_t
+cache_req_name_cache_parse(struct resp_ctx *rctx,
+                           bool use_default_domain,
+                           const char *input,
+                           const char **_name,
+                           const char **_domain);
+
 /* Plug-in common. */
 
 struct cache_req_result *
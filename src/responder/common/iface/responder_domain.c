@@ -47,6 +47,8 @@ static void set_domain_state_by_name(struct resp_ctx *rctx,
 
     if (dom != NULL) {
         sss_domain_set_state(dom, state);
+        /* Names may parse differently now */
+        talloc_zfree(rctx->cr_name_cache);
     }
 }
 
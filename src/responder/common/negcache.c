@@ -42,6 +42,7 @@ struct sss_nc_ctx {
     struct tdb_context *tdb;
     uint32_t timeout;
     uint32_t local_timeout;
+    uint32_t user_generation;
 };
 
 typedef int (*ncache_set_byname_fn_t)(struct sss_nc_ctx *, bool,
@@ -86,6 +87,11 @@ uint32_t sss_ncache_get_timeout(struct sss_nc_ctx *ctx)
     return ctx->timeout;
 }
 
+uint32_t sss_ncache_get_user_generation(struct sss_nc_ctx *ctx)
+{
+    return ctx->user_generation;
+}
+
 static int sss_ncache_check_str(struct sss_nc_ctx *ctx, char *str)
 {
     TDB_DATA key;
@@ -489,6 +495,9 @@ static int sss_ncache_set_user_int(struct sss_nc_ctx *ctx, bool permanent,
         use_local_negative = is_user_local_by_name(name);
     }
     ret = sss_ncache_set_str(ctx, str, permanent, use_local_negative);
+    if (ret == EOK) {
+        ctx->user_generation++;
+    }
 
     talloc_free(str);
     return ret;
@@ -30,6 +30,10 @@ int sss_ncache_init(TALLOC_CTX *memctx, uint32_t timeout,
 
 uint32_t sss_ncache_get_timeout(struct sss_nc_ctx *ctx);
 
+/* Changes whenever a user is added to the negative cache. Results filtered
+ * with sss_ncache_check_user() can be kept as long as it does not change. */
+uint32_t sss_ncache_get_user_generation(struct sss_nc_ctx *ctx);
+
 /* check if the user is expired according to the passed in time to live */
 int sss_ncache_check_user(struct sss_nc_ctx *ctx, struct sss_domain_info *dom,
                           const char *name);
@@ -120,6 +120,8 @@ struct resp_ctx {
 
     struct cache_req_domain *cr_domains;
     const char *domain_resolution_order;
+    /* Parsed input names, freed whenever the domains change */
+    struct cache_req_name_cache *cr_name_cache;
 
     time_t last_request_time;
     int idle_timeout;
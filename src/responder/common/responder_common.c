@@ -1113,6 +1113,11 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
         rctx->client_idle_timeout = 10;
     }
 
+    ret = sss_req_pool_init(rctx->cdb, rctx->confdb_service_path);
+    if (ret != EOK) {
+        goto fail;
+    }
+
     if (rctx->socket_activated || rctx->dbus_activated) {
         ret = responder_setup_idle_timeout_config(rctx);
         if (ret != EOK) {
@@ -1671,6 +1676,7 @@ errno_t sss_resp_populate_cr_domains(struct resp_ctx *rctx)
 done:
     cache_req_domain_list_zfree(&rctx->cr_domains);
     rctx->cr_domains = cr_domains;
+    talloc_zfree(rctx->cr_name_cache);
 
     return ret;
 }
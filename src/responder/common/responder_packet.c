@@ -174,12 +174,28 @@ int sss_packet_set_size(struct sss_packet *packet, size_t size)
     return 0;
 }
 
+static size_t sss_packet_max_recv_size(enum sss_cli_command cmd)
+{
+    switch (cmd) {
+    case SSS_NSS_GETNAMEBYCERT:
+    case SSS_NSS_GETLISTBYCERT:
+        return SSS_CERT_PACKET_MAX_RECV_SIZE;
+    case SSS_NSS_GETIDSBYSIDS:
+    case SSS_NSS_GETSIDSBYIDS:
+    case SSS_NSS_GETNAMESBYSIDS:
+        return SSS_BATCH_PACKET_MAX_RECV_SIZE;
+    default:
+        return SSS_PACKET_MAX_RECV_SIZE;
+    }
+}
+
 int sss_packet_recv(struct sss_packet *packet, int fd)
 {
     size_t rb;
     size_t len;
     void *buf;
     size_t new_len;
+    size_t max_len;
     int ret;
 
     buf = (uint8_t *)packet->buffer + packet->iop;
@@ -207,15 +223,13 @@ int sss_packet_recv(struct sss_packet *packet, int fd)
     }
 
     if (sss_packet_get_len(packet) > packet->memsize) {
-        /* Allow certificate based requests to use larger buffer but not
-         * larger than SSS_CERT_PACKET_MAX_RECV_SIZE. Due to the way
+        /* Allow certificate based and batched requests to use larger buffer
+         * but not larger than the limit of the command. Due to the way
          * sss_packet_grow() works the packet len must be set to '0' first and
          * then grow to the expected size. */
-        if ((sss_packet_get_cmd(packet) == SSS_NSS_GETNAMEBYCERT
-                    || sss_packet_get_cmd(packet) == SSS_NSS_GETLISTBYCERT)
-                && packet->memsize < SSS_CERT_PACKET_MAX_RECV_SIZE
-                && (new_len = sss_packet_get_len(packet))
-                                   < SSS_CERT_PACKET_MAX_RECV_SIZE) {
+        max_len = sss_packet_max_recv_size(sss_packet_get_cmd(packet));
+        if (packet->memsize < max_len
+                && (new_len = sss_packet_get_len(packet)) <= max_len) {
             new_len = sss_packet_get_len(packet);
             sss_packet_set_len(packet, 0);
             ret = sss_packet_grow(packet, new_len);
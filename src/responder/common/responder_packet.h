@@ -26,6 +26,8 @@
 
 #define SSS_PACKET_MAX_RECV_SIZE 1024
 #define SSS_CERT_PACKET_MAX_RECV_SIZE ( 10 * SSS_PACKET_MAX_RECV_SIZE )
+#define SSS_BATCH_PACKET_MAX_RECV_SIZE \
+    ( SSS_NSS_HEADER_SIZE + SSS_NSS_MAX_BATCH_SIZE )
 
 struct sss_packet;
 
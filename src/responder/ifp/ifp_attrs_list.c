@@ -0,0 +1,565 @@
+/*
+    InfoPipe responder: bulk listing of users and groups with attributes
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+
+#include "util/util.h"
+#include "db/sysdb.h"
+#include "sbus/sssd_dbus_errors.h"
+#include "responder/common/responder.h"
+#include "responder/common/cache_req/cache_req.h"
+#include "responder/ifp/ifp_users.h"
+#include "responder/ifp/ifp_groups.h"
+
+/* Pseudo-attributes that are not stored in sysdb but can be requested */
+#define IFP_ATTRS_LIST_DOMAINNAME "domainname"
+#define IFP_ATTRS_LIST_PATH "objectPath"
+
+#define IFP_GROUP_ATTRS {SYSDB_NAME, SYSDB_GIDNUM, SYSDB_UUID, \
+                         IFP_ATTRS_LIST_DOMAINNAME, NULL}
+
+enum ifp_attrs_list_type {
+    IFP_ATTRS_LIST_USERS,
+    IFP_ATTRS_LIST_GROUPS
+};
+
+struct ifp_attrs_list_ctx {
+    struct ifp_req *ireq;
+    enum ifp_attrs_list_type type;
+
+    const char *domname;
+    const char *filter;
+    const char **attrs;
+    char **search_attrs;
+    uint32_t offset;
+    uint32_t limit;
+
+    struct sss_domain_info *dom;
+    uint32_t skipped;
+    uint32_t count;
+
+    DBusMessage *reply;
+    DBusMessageIter iter;
+    DBusMessageIter iter_array;
+};
+
+static int ifp_attrs_list_step(struct ifp_attrs_list_ctx *list_ctx);
+static void ifp_attrs_list_done(struct tevent_req *req);
+static void ifp_attrs_list_reply(struct ifp_attrs_list_ctx *list_ctx);
+
+static int ifp_attrs_list_destructor(struct ifp_attrs_list_ctx *list_ctx)
+{
+    if (list_ctx->reply != NULL) {
+        dbus_message_unref(list_ctx->reply);
+    }
+
+    return 0;
+}
+
+static errno_t
+ifp_attrs_list_unpack_msg(struct ifp_attrs_list_ctx *list_ctx)
+{
+    static const char *group_whitelist[] = IFP_GROUP_ATTRS;
+    const char **whitelist;
+    const char *domname;
+    const char *filter;
+    char **attrs;
+    int nattrs;
+    int i, ai;
+    bool parsed;
+    errno_t ret;
+
+    parsed = sbus_request_parse_or_finish(list_ctx->ireq->dbus_req,
+                                          DBUS_TYPE_STRING, &domname,
+                                          DBUS_TYPE_STRING, &filter,
+                                          DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                                          &attrs, &nattrs,
+                                          DBUS_TYPE_UINT32, &list_ctx->offset,
+                                          DBUS_TYPE_UINT32, &list_ctx->limit,
+                                          DBUS_TYPE_INVALID);
+    if (parsed == false) {
+        DEBUG(SSSDBG_OP_FAILURE, "Could not parse arguments\n");
+        return ERR_SBUS_REQUEST_HANDLED;
+    }
+
+    if (domname[0] != '\0') {
+        list_ctx->domname = talloc_strdup(list_ctx, domname);
+        if (list_ctx->domname == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    list_ctx->filter = talloc_strdup(list_ctx, filter);
+    if (list_ctx->filter == NULL) {
+        return ENOMEM;
+    }
+
+    switch (list_ctx->type) {
+    case IFP_ATTRS_LIST_USERS:
+        whitelist = list_ctx->ireq->ifp_ctx->user_whitelist;
+        break;
+    case IFP_ATTRS_LIST_GROUPS:
+        whitelist = group_whitelist;
+        break;
+    default:
+        return ERR_INTERNAL;
+    }
+
+    list_ctx->attrs = talloc_zero_array(list_ctx, const char *, nattrs + 1);
+    if (list_ctx->attrs == NULL) {
+        return ENOMEM;
+    }
+
+    ai = 0;
+    for (i = 0; i < nattrs; i++) {
+        if (ifp_attr_allowed(whitelist, attrs[i]) == false) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Attribute %s not present in the whitelist, skipping\n",
+                  attrs[i]);
+            continue;
+        }
+
+        list_ctx->attrs[ai] = talloc_strdup(list_ctx->attrs, attrs[i]);
+        if (list_ctx->attrs[ai] == NULL) {
+            return ENOMEM;
+        }
+        ai++;
+    }
+
+    /* Attributes needed to build the object path and output names and to
+     * apply overrides must always be fetched, but are only returned to the
+     * caller if they were requested and allowed. */
+    for (i = 0; list_ctx->attrs[i] != NULL; i++) {
+        ret = add_string_to_list(list_ctx, list_ctx->attrs[i],
+                                 &list_ctx->search_attrs);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    ret = add_string_to_list(list_ctx, SYSDB_NAME,
+                             &list_ctx->search_attrs);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = add_string_to_list(list_ctx, SYSDB_NAME_ALIAS,
+                             &list_ctx->search_attrs);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = add_string_to_list(list_ctx,
+                             list_ctx->type == IFP_ATTRS_LIST_USERS
+                                ? SYSDB_UIDNUM : SYSDB_GIDNUM,
+                             &list_ctx->search_attrs);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    return add_string_to_list(list_ctx, SYSDB_OVERRIDE_DN,
+                              &list_ctx->search_attrs);
+}
+
+static int ifp_attrs_list_by_domain_and_name(struct sbus_request *sbus_req,
+                                             void *data,
+                                             enum ifp_attrs_list_type type)
+{
+    struct ifp_attrs_list_ctx *list_ctx;
+    struct ifp_ctx *ctx;
+    struct ifp_req *ireq;
+    DBusError *error;
+    dbus_bool_t dbret;
+    errno_t ret;
+
+    ctx = talloc_get_type(data, struct ifp_ctx);
+    if (ctx == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid pointer!\n");
+        return sbus_request_return_and_finish(sbus_req, DBUS_TYPE_INVALID);
+    }
+
+    ret = ifp_req_create(sbus_req, ctx, &ireq);
+    if (ret != EOK) {
+        return ifp_req_create_handle_failure(sbus_req, ret);
+    }
+
+    list_ctx = talloc_zero(ireq, struct ifp_attrs_list_ctx);
+    if (list_ctx == NULL) {
+        return ENOMEM;
+    }
+    list_ctx->ireq = ireq;
+    list_ctx->type = type;
+
+    ret = ifp_attrs_list_unpack_msg(list_ctx);
+    if (ret != EOK) {
+        return ret;
+    }
+    list_ctx->limit = ifp_list_limit(ctx, list_ctx->limit);
+
+    if (list_ctx->domname != NULL) {
+        list_ctx->dom = find_domain_by_name(ctx->rctx->domains,
+                                            list_ctx->domname, true);
+        if (list_ctx->dom == NULL) {
+            error = sbus_error_new(sbus_req, SBUS_ERROR_UNKNOWN_DOMAIN,
+                                   "Unknown domain [%s]", list_ctx->domname);
+            return sbus_request_fail_and_finish(sbus_req, error);
+        }
+    } else {
+        list_ctx->dom = ctx->rctx->domains;
+    }
+
+    DEBUG(SSSDBG_FUNC_DATA,
+          "Listing %s matching [%s] in [%s], offset %"PRIu32", "
+          "limit %"PRIu32" on behalf of %"PRIi64"\n",
+          type == IFP_ATTRS_LIST_USERS ? "users" : "groups",
+          list_ctx->filter,
+          list_ctx->domname != NULL ? list_ctx->domname : "all domains",
+          list_ctx->offset, list_ctx->limit, sbus_req->client);
+
+    /* The reply is built incrementally as domains are processed, so that
+     * no intermediate copy of the records is ever kept. */
+    list_ctx->reply = dbus_message_new_method_return(sbus_req->message);
+    if (list_ctx->reply == NULL) {
+        return ENOMEM;
+    }
+    talloc_set_destructor(list_ctx, ifp_attrs_list_destructor);
+
+    dbus_message_iter_init_append(list_ctx->reply, &list_ctx->iter);
+    dbret = dbus_message_iter_open_container(
+                                      &list_ctx->iter, DBUS_TYPE_ARRAY,
+                                      DBUS_TYPE_ARRAY_AS_STRING
+                                      DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                                      DBUS_TYPE_STRING_AS_STRING
+                                      DBUS_TYPE_VARIANT_AS_STRING
+                                      DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+                                      &list_ctx->iter_array);
+    if (!dbret) {
+        return ENOMEM;
+    }
+
+    return ifp_attrs_list_step(list_ctx);
+}
+
+int ifp_users_list_attrs_by_domain_and_name(struct sbus_request *sbus_req,
+                                            void *data)
+{
+    return ifp_attrs_list_by_domain_and_name(sbus_req, data,
+                                             IFP_ATTRS_LIST_USERS);
+}
+
+int ifp_groups_list_attrs_by_domain_and_name(struct sbus_request *sbus_req,
+                                             void *data)
+{
+    return ifp_attrs_list_by_domain_and_name(sbus_req, data,
+                                             IFP_ATTRS_LIST_GROUPS);
+}
+
+static int ifp_attrs_list_step(struct ifp_attrs_list_ctx *list_ctx)
+{
+    struct resp_ctx *rctx = list_ctx->ireq->ifp_ctx->rctx;
+    struct tevent_req *req;
+
+    switch (list_ctx->type) {
+    case IFP_ATTRS_LIST_USERS:
+        req = cache_req_user_by_filter_send(list_ctx, rctx->ev, rctx,
+                                            CACHE_REQ_ANY_DOM,
+                                            list_ctx->dom->name,
+                                            list_ctx->filter);
+        break;
+    case IFP_ATTRS_LIST_GROUPS:
+        req = cache_req_group_by_filter_send(list_ctx, rctx->ev, rctx,
+                                             CACHE_REQ_ANY_DOM,
+                                             list_ctx->dom->name,
+                                             list_ctx->filter);
+        break;
+    default:
+        return ERR_INTERNAL;
+    }
+
+    if (req == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(req, ifp_attrs_list_done, list_ctx);
+
+    return EOK;
+}
+
+static errno_t
+ifp_attrs_list_add_record(struct ifp_attrs_list_ctx *list_ctx,
+                          struct ldb_message *msg)
+{
+    struct ifp_ctx *ifp_ctx = list_ctx->ireq->ifp_ctx;
+    struct ldb_message_element *el;
+    DBusMessageIter iter_dict;
+    const char *path;
+    dbus_bool_t dbret;
+    errno_t ret;
+    int ai;
+
+    switch (list_ctx->type) {
+    case IFP_ATTRS_LIST_USERS:
+        path = ifp_users_build_path_from_msg(msg, list_ctx->dom, msg);
+        break;
+    case IFP_ATTRS_LIST_GROUPS:
+        path = ifp_groups_build_path_from_msg(msg, list_ctx->dom, msg);
+        break;
+    default:
+        return ERR_INTERNAL;
+    }
+
+    if (path == NULL) {
+        return ENOMEM;
+    }
+
+    ret = ifp_ldb_el_output_name(ifp_ctx->rctx, msg, SYSDB_NAME,
+                                 list_ctx->dom);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot convert SYSDB_NAME to output format [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    ret = ifp_ldb_el_output_name(ifp_ctx->rctx, msg, SYSDB_NAME_ALIAS,
+                                 list_ctx->dom);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Cannot convert SYSDB_NAME_ALIAS to output format [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    dbret = dbus_message_iter_open_container(
+                                      &list_ctx->iter_array, DBUS_TYPE_ARRAY,
+                                      DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                                      DBUS_TYPE_STRING_AS_STRING
+                                      DBUS_TYPE_VARIANT_AS_STRING
+                                      DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+                                      &iter_dict);
+    if (!dbret) {
+        return ENOMEM;
+    }
+
+    /* The object path is always returned so that the caller can correlate
+     * the record with the objects returned by the other methods. */
+    ret = ifp_add_value_to_dict(&iter_dict, IFP_ATTRS_LIST_PATH, path);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    for (ai = 0; list_ctx->attrs[ai] != NULL; ai++) {
+        if (strcmp(list_ctx->attrs[ai], IFP_ATTRS_LIST_DOMAINNAME) == 0) {
+            ret = ifp_add_value_to_dict(&iter_dict, IFP_ATTRS_LIST_DOMAINNAME,
+                                        list_ctx->dom->name);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Cannot add attribute domainname to message\n");
+            }
+            continue;
+        }
+
+        el = sss_view_ldb_msg_find_element(list_ctx->dom, msg,
+                                           list_ctx->attrs[ai]);
+        if (el == NULL || el->num_values == 0) {
+            continue;
+        }
+
+        ret = ifp_add_ldb_el_to_dict(&iter_dict, el);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Cannot add attribute %s to message\n",
+                  list_ctx->attrs[ai]);
+            continue;
+        }
+    }
+
+    dbret = dbus_message_iter_close_container(&list_ctx->iter_array,
+                                              &iter_dict);
+    if (!dbret) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+/* Reads the requested attributes of the objects on the current page with a
+ * single sysdb search and appends one record per object to the reply. */
+static errno_t
+ifp_attrs_list_add_page(struct ifp_attrs_list_ctx *list_ctx,
+                        struct ldb_message **page,
+                        size_t page_count)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_message **msgs;
+    size_t count;
+    char *filter;
+    size_t i;
+    errno_t ret;
+
+    if (page_count == 0) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    filter = ifp_dn_filter(tmp_ctx, page, page_count);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    switch (list_ctx->type) {
+    case IFP_ATTRS_LIST_USERS:
+        ret = sysdb_search_users(tmp_ctx, list_ctx->dom, filter,
+                                 (const char **) list_ctx->search_attrs,
+                                 &count, &msgs);
+        break;
+    case IFP_ATTRS_LIST_GROUPS:
+        ret = sysdb_search_groups(tmp_ctx, list_ctx->dom, filter,
+                                  (const char **) list_ctx->search_attrs,
+                                 &count, &msgs);
+        break;
+    default:
+        ret = ERR_INTERNAL;
+        break;
+    }
+
+    if (ret == ENOENT) {
+        /* Objects were removed between the two searches */
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (DOM_HAS_VIEWS(list_ctx->dom)) {
+            ret = sysdb_add_overrides_to_object(list_ctx->dom, msgs[i], NULL,
+                                    (const char **) list_ctx->search_attrs);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      "sysdb_add_overrides_to_object failed [%d]: %s\n",
+                      ret, sss_strerror(ret));
+                goto done;
+            }
+        }
+
+        ret = ifp_attrs_list_add_record(list_ctx, msgs[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        list_ctx->count++;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void ifp_attrs_list_done(struct tevent_req *req)
+{
+    DBusError *error;
+    struct ifp_attrs_list_ctx *list_ctx;
+    struct sbus_request *sbus_req;
+    struct cache_req_result *result = NULL;
+    struct ldb_message **page;
+    size_t page_count;
+    size_t skip;
+    errno_t ret;
+
+    list_ctx = tevent_req_callback_data(req, struct ifp_attrs_list_ctx);
+    sbus_req = list_ctx->ireq->dbus_req;
+
+    ret = cache_req_single_domain_recv(list_ctx, req, &result);
+    talloc_zfree(req);
+    if (ret != EOK && ret != ENOENT) {
+        error = sbus_error_new(sbus_req, DBUS_ERROR_FAILED, "Failed to fetch "
+                               "objects by filter [%d]: %s\n",
+                               ret, sss_strerror(ret));
+        sbus_request_fail_and_finish(sbus_req, error);
+        return;
+    }
+
+    if (ret == EOK) {
+        page = result->msgs;
+        page_count = result->count;
+
+        skip = MIN(page_count, list_ctx->offset - list_ctx->skipped);
+        list_ctx->skipped += skip;
+        page += skip;
+        page_count -= skip;
+
+        if (list_ctx->limit != 0) {
+            page_count = MIN(page_count, list_ctx->limit - list_ctx->count);
+        }
+
+        ret = ifp_attrs_list_add_page(list_ctx, page, page_count);
+        talloc_zfree(result);
+        if (ret != EOK) {
+            error = sbus_error_new(sbus_req, SBUS_ERROR_INTERNAL,
+                                   "Failed to build a reply [%d]: %s\n",
+                                   ret, sss_strerror(ret));
+            sbus_request_fail_and_finish(sbus_req, error);
+            return;
+        }
+    }
+
+    if (list_ctx->domname != NULL
+            || (list_ctx->limit != 0 && list_ctx->count >= list_ctx->limit)) {
+        return ifp_attrs_list_reply(list_ctx);
+    }
+
+    list_ctx->dom = get_next_domain(list_ctx->dom, SSS_GND_DESCEND);
+    if (list_ctx->dom == NULL) {
+        return ifp_attrs_list_reply(list_ctx);
+    }
+
+    ret = ifp_attrs_list_step(list_ctx);
+    if (ret != EOK) {
+        error = sbus_error_new(sbus_req, SBUS_ERROR_INTERNAL,
+                               "Failed to start next-domain search");
+        sbus_request_fail_and_finish(sbus_req, error);
+        return;
+    }
+}
+
+static void ifp_attrs_list_reply(struct ifp_attrs_list_ctx *list_ctx)
+{
+    struct sbus_request *sbus_req = list_ctx->ireq->dbus_req;
+    dbus_bool_t dbret;
+
+    dbret = dbus_message_iter_close_container(&list_ctx->iter,
+                                              &list_ctx->iter_array);
+    if (!dbret) {
+        sbus_request_finish(sbus_req, NULL);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Returning %"PRIu32" records\n", list_ctx->count);
+
+    /* The reply is unreferenced when the request is freed */
+    sbus_request_finish(sbus_req, list_ctx->reply);
+}
@@ -51,6 +51,10 @@ int ifp_groups_list_by_domain_and_name(struct sbus_request *sbus_req,
                                        const char *filter,
                                        uint32_t limit);
 
+/* Raw handler, returns an array of attribute maps (aa{sv}) */
+int ifp_groups_list_attrs_by_domain_and_name(struct sbus_request *sbus_req,
+                                             void *data);
+
 /* org.freedesktop.sssd.infopipe.Groups.Group */
 
 int ifp_groups_group_update_member_list(struct sbus_request *sbus_req,
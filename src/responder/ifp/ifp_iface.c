@@ -90,7 +90,8 @@ struct iface_ifp_users iface_ifp_users = {
     .ListByCertificate = ifp_users_list_by_cert,
     .FindByNameAndCertificate = ifp_users_find_by_name_and_cert,
     .ListByName = ifp_users_list_by_name,
-    .ListByDomainAndName = ifp_users_list_by_domain_and_name
+    .ListByDomainAndName = ifp_users_list_by_domain_and_name,
+    .ListAttrsByDomainAndName = ifp_users_list_attrs_by_domain_and_name
 };
 
 struct iface_ifp_users_user iface_ifp_users_user = {
@@ -114,7 +115,8 @@ struct iface_ifp_groups iface_ifp_groups = {
     .FindByName = ifp_groups_find_by_name,
     .FindByID = ifp_groups_find_by_id,
     .ListByName = ifp_groups_list_by_name,
-    .ListByDomainAndName = ifp_groups_list_by_domain_and_name
+    .ListByDomainAndName = ifp_groups_list_by_domain_and_name,
+    .ListAttrsByDomainAndName = ifp_groups_list_attrs_by_domain_and_name
 };
 
 struct iface_ifp_groups_group iface_ifp_groups_group = {
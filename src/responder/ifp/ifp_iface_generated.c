@@ -829,6 +829,22 @@ int iface_ifp_users_ListByDomainAndName_finish(struct sbus_request *req, const c
                                          DBUS_TYPE_INVALID);
 }
 
+/* arguments for org.freedesktop.sssd.infopipe.Users.ListAttrsByDomainAndName */
+const struct sbus_arg_meta iface_ifp_users_ListAttrsByDomainAndName__in[] = {
+    { "domain_name", "s" },
+    { "name_filter", "s" },
+    { "attrs", "as" },
+    { "offset", "u" },
+    { "limit", "u" },
+    { NULL, }
+};
+
+/* arguments for org.freedesktop.sssd.infopipe.Users.ListAttrsByDomainAndName */
+const struct sbus_arg_meta iface_ifp_users_ListAttrsByDomainAndName__out[] = {
+    { "result", "aa{sv}" },
+    { NULL, }
+};
+
 /* methods for org.freedesktop.sssd.infopipe.Users */
 const struct sbus_method_meta iface_ifp_users__methods[] = {
     {
@@ -880,6 +896,13 @@ const struct sbus_method_meta iface_ifp_users__methods[] = {
         offsetof(struct iface_ifp_users, ListByDomainAndName),
         invoke_ssu_method,
     },
+    {
+        "ListAttrsByDomainAndName", /* name */
+        iface_ifp_users_ListAttrsByDomainAndName__in,
+        iface_ifp_users_ListAttrsByDomainAndName__out,
+        offsetof(struct iface_ifp_users, ListAttrsByDomainAndName),
+        NULL, /* no invoker */
+    },
     { NULL, }
 };
 
@@ -1102,6 +1125,22 @@ int iface_ifp_groups_ListByDomainAndName_finish(struct sbus_request *req, const
                                          DBUS_TYPE_INVALID);
 }
 
+/* arguments for org.freedesktop.sssd.infopipe.Groups.ListAttrsByDomainAndName */
+const struct sbus_arg_meta iface_ifp_groups_ListAttrsByDomainAndName__in[] = {
+    { "domain_name", "s" },
+    { "name_filter", "s" },
+    { "attrs", "as" },
+    { "offset", "u" },
+    { "limit", "u" },
+    { NULL, }
+};
+
+/* arguments for org.freedesktop.sssd.infopipe.Groups.ListAttrsByDomainAndName */
+const struct sbus_arg_meta iface_ifp_groups_ListAttrsByDomainAndName__out[] = {
+    { "result", "aa{sv}" },
+    { NULL, }
+};
+
 /* methods for org.freedesktop.sssd.infopipe.Groups */
 const struct sbus_method_meta iface_ifp_groups__methods[] = {
     {
@@ -1132,6 +1171,13 @@ const struct sbus_method_meta iface_ifp_groups__methods[] = {
         offsetof(struct iface_ifp_groups, ListByDomainAndName),
         invoke_ssu_method,
     },
+    {
+        "ListAttrsByDomainAndName", /* name */
+        iface_ifp_groups_ListAttrsByDomainAndName__in,
+        iface_ifp_groups_ListAttrsByDomainAndName__out,
+        offsetof(struct iface_ifp_groups, ListAttrsByDomainAndName),
+        NULL, /* no invoker */
+    },
     { NULL, }
 };
 
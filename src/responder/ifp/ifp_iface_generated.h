@@ -77,6 +77,7 @@
 #define IFACE_IFP_USERS_FINDBYNAMEANDCERTIFICATE "FindByNameAndCertificate"
 #define IFACE_IFP_USERS_LISTBYNAME "ListByName"
 #define IFACE_IFP_USERS_LISTBYDOMAINANDNAME "ListByDomainAndName"
+#define IFACE_IFP_USERS_LISTATTRSBYDOMAINANDNAME "ListAttrsByDomainAndName"
 
 /* constants for org.freedesktop.sssd.infopipe.Users.User */
 #define IFACE_IFP_USERS_USER "org.freedesktop.sssd.infopipe.Users.User"
@@ -99,6 +100,7 @@
 #define IFACE_IFP_GROUPS_FINDBYID "FindByID"
 #define IFACE_IFP_GROUPS_LISTBYNAME "ListByName"
 #define IFACE_IFP_GROUPS_LISTBYDOMAINANDNAME "ListByDomainAndName"
+#define IFACE_IFP_GROUPS_LISTATTRSBYDOMAINANDNAME "ListAttrsByDomainAndName"
 
 /* constants for org.freedesktop.sssd.infopipe.Groups.Group */
 #define IFACE_IFP_GROUPS_GROUP "org.freedesktop.sssd.infopipe.Groups.Group"
@@ -256,6 +258,7 @@ struct iface_ifp_users {
     int (*FindByNameAndCertificate)(struct sbus_request *req, void *data, const char *arg_name, const char *arg_pem_cert);
     int (*ListByName)(struct sbus_request *req, void *data, const char *arg_name_filter, uint32_t arg_limit);
     int (*ListByDomainAndName)(struct sbus_request *req, void *data, const char *arg_domain_name, const char *arg_name_filter, uint32_t arg_limit);
+    sbus_msg_handler_fn ListAttrsByDomainAndName;
 };
 
 /* finish function for FindByName */
@@ -306,6 +309,7 @@ struct iface_ifp_groups {
     int (*FindByID)(struct sbus_request *req, void *data, uint32_t arg_id);
     int (*ListByName)(struct sbus_request *req, void *data, const char *arg_name_filter, uint32_t arg_limit);
     int (*ListByDomainAndName)(struct sbus_request *req, void *data, const char *arg_domain_name, const char *arg_name_filter, uint32_t arg_limit);
+    sbus_msg_handler_fn ListAttrsByDomainAndName;
 };
 
 /* finish function for FindByName */
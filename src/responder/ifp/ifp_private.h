@@ -98,6 +98,14 @@ struct ifp_list_ctx {
     size_t path_count;
 };
 
+/* Applies the configured wildcard_limit to a client supplied limit */
+uint32_t ifp_list_limit(struct ifp_ctx *ctx, uint32_t limit);
+
+/* Builds a filter that matches exactly the objects in msgs[0..count) */
+char *ifp_dn_filter(TALLOC_CTX *mem_ctx,
+                    struct ldb_message **msgs,
+                    size_t count);
+
 struct ifp_list_ctx *ifp_list_ctx_new(struct sbus_request *sbus_req,
                                       struct ifp_ctx *ctx,
                                       const char *filter,
@@ -65,6 +65,10 @@ int ifp_users_list_by_domain_and_name(struct sbus_request *sbus_req,
                                       const char *filter,
                                       uint32_t limit);
 
+/* Raw handler, returns an array of attribute maps (aa{sv}) */
+int ifp_users_list_attrs_by_domain_and_name(struct sbus_request *sbus_req,
+                                            void *data);
+
 /* org.freedesktop.sssd.infopipe.Users.User */
 
 int ifp_users_user_update_groups_list(struct sbus_request *req,
@@ -344,7 +344,7 @@ ifp_is_user_attr_allowed(struct ifp_ctx *ifp_ctx, const char *attr)
     return ifp_attr_allowed(ifp_ctx->user_whitelist, attr);
 }
 
-static uint32_t ifp_list_limit(struct ifp_ctx *ctx, uint32_t limit)
+uint32_t ifp_list_limit(struct ifp_ctx *ctx, uint32_t limit)
 {
     if (limit == 0) {
         return ctx->wildcard_limit;
@@ -355,6 +355,49 @@ static uint32_t ifp_list_limit(struct ifp_ctx *ctx, uint32_t limit)
     }
 }
 
+char *ifp_dn_filter(TALLOC_CTX *mem_ctx,
+                    struct ldb_message **msgs,
+                    size_t count)
+{
+    TALLOC_CTX *tmp_ctx;
+    char *filter;
+    char *sanitized;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return NULL;
+    }
+
+    filter = talloc_strdup(tmp_ctx, "(|");
+    for (i = 0; i < count && filter != NULL; i++) {
+        /* The linearized DN may contain characters that have a special
+         * meaning in a filter, e.g. parentheses or asterisks in the name */
+        ret = sss_filter_sanitize(tmp_ctx, ldb_dn_get_linearized(msgs[i]->dn),
+                                  &sanitized);
+        if (ret != EOK) {
+            filter = NULL;
+            break;
+        }
+
+        filter = talloc_asprintf_append(filter, "(%s=%s)", SYSDB_DN,
+                                        sanitized);
+        talloc_free(sanitized);
+    }
+
+    if (filter != NULL) {
+        filter = talloc_asprintf_append(filter, ")");
+    }
+
+    if (filter != NULL) {
+        filter = talloc_steal(mem_ctx, filter);
+    }
+
+    talloc_free(tmp_ctx);
+    return filter;
+}
+
 struct ifp_list_ctx *ifp_list_ctx_new(struct sbus_request *sbus_req,
                                       struct ifp_ctx *ctx,
                                       const char *filter,
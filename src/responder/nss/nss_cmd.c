@@ -52,6 +52,7 @@ nss_cmd_ctx_create(TALLOC_CTX *mem_ctx,
 
 static void nss_getby_done(struct tevent_req *subreq);
 static void nss_getlistby_done(struct tevent_req *subreq);
+static void nss_getby_batch_done(struct tevent_req *subreq);
 
 static errno_t nss_getby_name(struct cli_ctx *cli_ctx,
                               enum cache_req_type type,
@@ -385,7 +386,7 @@ static errno_t nss_getby_sid(struct cli_ctx *cli_ctx,
     }
 
     subreq = nss_get_object_send(cmd_ctx, cli_ctx->ev, cli_ctx,
-                                 data, SSS_MC_NONE, NULL, 0);
+                                 data, SSS_MC_SID, sid, 0);
     if (subreq == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Unable to create tevent request!\n");
         ret = ENOMEM;
@@ -427,6 +428,93 @@ done:
     talloc_free(cmd_ctx);
 }
 
+static errno_t nss_getby_batch(struct cli_ctx *cli_ctx,
+                               enum cache_req_type type,
+                               nss_protocol_fill_batch_fn fill_fn)
+{
+    struct nss_cmd_ctx *cmd_ctx;
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    cmd_ctx = nss_cmd_ctx_create(cli_ctx, cli_ctx, type, NULL);
+    if (cmd_ctx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* It will be detected when constructing output packet. */
+    cmd_ctx->sid_id_type = SSS_ID_TYPE_NOT_SPECIFIED;
+    cmd_ctx->batch_fill_fn = fill_fn;
+
+    if (type == CACHE_REQ_OBJECT_BY_SID) {
+        ret = nss_protocol_parse_sid_list(cmd_ctx, cli_ctx, &cmd_ctx->batch,
+                                          &cmd_ctx->batch_num);
+    } else {
+        ret = nss_protocol_parse_id_list(cmd_ctx, cli_ctx, &cmd_ctx->batch,
+                                         &cmd_ctx->batch_num);
+    }
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid request message!\n");
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Input: %zu elements\n", cmd_ctx->batch_num);
+
+    subreq = nss_get_batch_send(cmd_ctx, cli_ctx->ev, cli_ctx, type,
+                                cmd_ctx->batch, cmd_ctx->batch_num);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to create tevent request!\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
+    tevent_req_set_callback(subreq, nss_getby_batch_done, cmd_ctx);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(cmd_ctx);
+        return nss_protocol_done(cli_ctx, ret);
+    }
+
+    return EOK;
+}
+
+static void nss_getby_batch_done(struct tevent_req *subreq)
+{
+    struct nss_cmd_ctx *cmd_ctx;
+    struct cli_protocol *pctx;
+    errno_t ret;
+
+    cmd_ctx = tevent_req_callback_data(subreq, struct nss_cmd_ctx);
+
+    ret = nss_get_batch_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    pctx = talloc_get_type(cmd_ctx->cli_ctx->protocol_ctx, struct cli_protocol);
+
+    ret = sss_packet_new(pctx->creq, 0, sss_packet_get_cmd(pctx->creq->in),
+                         &pctx->creq->out);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = cmd_ctx->batch_fill_fn(cmd_ctx->nss_ctx, cmd_ctx, pctx->creq->out);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    sss_packet_set_error(pctx->creq->out, EOK);
+
+done:
+    nss_protocol_done(cmd_ctx->cli_ctx, ret);
+    talloc_free(cmd_ctx);
+}
+
 static void nss_setent_done(struct tevent_req *subreq);
 
 static errno_t nss_setent(struct cli_ctx *cli_ctx,
@@ -944,7 +1032,7 @@ static errno_t nss_cmd_getsidbyname(struct cli_ctx *cli_ctx)
     const char *attrs[] = { SYSDB_SID_STR, NULL };
 
     return nss_getby_name(cli_ctx, CACHE_REQ_OBJECT_BY_NAME, attrs,
-                          SSS_MC_NONE, nss_protocol_fill_sid);
+                          SSS_MC_SID, nss_protocol_fill_sid);
 }
 
 static errno_t nss_cmd_getsidbyid(struct cli_ctx *cli_ctx)
@@ -952,7 +1040,7 @@ static errno_t nss_cmd_getsidbyid(struct cli_ctx *cli_ctx)
     const char *attrs[] = { SYSDB_SID_STR, NULL };
 
     return nss_getby_id(cli_ctx, CACHE_REQ_OBJECT_BY_ID, attrs,
-                        SSS_MC_NONE, nss_protocol_fill_sid);
+                        SSS_MC_SID, nss_protocol_fill_sid);
 }
 
 static errno_t nss_cmd_getnamebysid(struct cli_ctx *cli_ctx)
@@ -967,6 +1055,24 @@ static errno_t nss_cmd_getidbysid(struct cli_ctx *cli_ctx)
                          nss_protocol_fill_id);
 }
 
+static errno_t nss_cmd_getidsbysids(struct cli_ctx *cli_ctx)
+{
+    return nss_getby_batch(cli_ctx, CACHE_REQ_OBJECT_BY_SID,
+                           nss_protocol_fill_id_batch);
+}
+
+static errno_t nss_cmd_getsidsbyids(struct cli_ctx *cli_ctx)
+{
+    return nss_getby_batch(cli_ctx, CACHE_REQ_OBJECT_BY_ID,
+                           nss_protocol_fill_sid_batch);
+}
+
+static errno_t nss_cmd_getnamesbysids(struct cli_ctx *cli_ctx)
+{
+    return nss_getby_batch(cli_ctx, CACHE_REQ_OBJECT_BY_SID,
+                           nss_protocol_fill_name_batch);
+}
+
 static errno_t nss_cmd_getorigbyname(struct cli_ctx *cli_ctx)
 {
     errno_t ret;
@@ -1051,6 +1157,9 @@ struct sss_cmd_table *get_nss_cmds(void)
         { SSS_NSS_GETORIGBYNAME, nss_cmd_getorigbyname },
         { SSS_NSS_GETNAMEBYCERT, nss_cmd_getnamebycert },
         { SSS_NSS_GETLISTBYCERT, nss_cmd_getlistbycert },
+        { SSS_NSS_GETIDSBYSIDS, nss_cmd_getidsbysids },
+        { SSS_NSS_GETSIDSBYIDS, nss_cmd_getsidsbyids },
+        { SSS_NSS_GETNAMESBYSIDS, nss_cmd_getnamesbysids },
         { SSS_CLI_NULL, NULL }
     };
 
@@ -22,6 +22,7 @@
 #include <talloc.h>
 
 #include "util/util.h"
+#include "util/mmap_cache.h"
 #include "responder/nss/nss_private.h"
 #include "responder/nss/nsssrv_mmap_cache.h"
 
@@ -86,6 +87,70 @@ memcache_delete_entry_by_id(struct nss_ctx *nss_ctx,
     return ret;
 }
 
+static errno_t
+memcache_delete_sid_entry(struct nss_ctx *nss_ctx,
+                          const char *key)
+{
+    struct sized_string sized_key;
+    errno_t ret;
+
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    to_sized_string(&sized_key, key);
+    ret = sss_mmap_cache_sid_invalidate(nss_ctx->sid_mc_ctx, &sized_key);
+    if (ret == EOK || ret == ENOENT) {
+        return EOK;
+    }
+
+    DEBUG(SSSDBG_CRIT_FAILURE,
+          "Internal failure in memory cache code: %d [%s]\n",
+          ret, sss_strerror(ret));
+
+    return ret;
+}
+
+/* SID records are keyed by the input of the request and do not depend on
+ * the domain. Lookups by SID pass the SID as the name, so a name of a
+ * SID lookup is removed under both keys. */
+static errno_t
+memcache_delete_sid_entries(struct nss_ctx *nss_ctx,
+                            const char *name,
+                            uint32_t id,
+                            enum sss_mc_type type)
+{
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+
+    if (nss_ctx->sid_mc_ctx == NULL) {
+        return EOK;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    if (name != NULL) {
+        ret = memcache_delete_sid_entry(nss_ctx,
+                  talloc_asprintf(tmp_ctx, MC_SID_KEY_NAME "%s", name));
+        if (ret == EOK && type == SSS_MC_SID) {
+            ret = memcache_delete_sid_entry(nss_ctx,
+                      talloc_asprintf(tmp_ctx, MC_SID_KEY_SID "%s", name));
+        }
+    } else if (id != 0) {
+        ret = memcache_delete_sid_entry(nss_ctx,
+                  talloc_asprintf(tmp_ctx, MC_SID_KEY_ID "%"PRIu32, id));
+    } else {
+        DEBUG(SSSDBG_OP_FAILURE, "Bug: invalid input!");
+        ret = ERR_INTERNAL;
+    }
+
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 static errno_t
 memcache_delete_entry(struct nss_ctx *nss_ctx,
                       struct resp_ctx *rctx,
@@ -98,6 +163,22 @@ memcache_delete_entry(struct nss_ctx *nss_ctx,
     struct sized_string *sized_name;
     errno_t ret;
 
+    if (domain == NULL) {
+        /* The object does not exist, so whatever the SID cache holds for
+         * the same input is stale as well. */
+        ret = memcache_delete_sid_entries(nss_ctx, name, id, type);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Unable to delete '%s' from SID memory cache!\n",
+                  name != NULL ? name : "<id>");
+        }
+    }
+
+    if (type == SSS_MC_SID) {
+        /* SID records are only removed when the object is not found. */
+        return EOK;
+    }
+
     for (dom = rctx->domains;
          dom != NULL;
          dom = get_next_domain(dom, SSS_GND_DESCEND)) {
@@ -278,3 +359,164 @@ nss_get_object_recv(TALLOC_CTX *mem_ctx,
 
     return EOK;
 }
+
+/* Number of items of a batch that are looked up at the same time. */
+#define NSS_BATCH_PARALLEL 16
+
+struct nss_get_batch_state {
+    struct tevent_context *ev;
+    struct cli_ctx *cli_ctx;
+    enum cache_req_type type;
+    struct nss_batch_item *items;
+    size_t num_items;
+    size_t next;
+    size_t active;
+};
+
+struct nss_get_batch_item_state {
+    struct tevent_req *req;
+    struct nss_batch_item *item;
+};
+
+static errno_t nss_get_batch_next(struct tevent_req *req);
+static void nss_get_batch_done(struct tevent_req *subreq);
+
+struct tevent_req *
+nss_get_batch_send(TALLOC_CTX *mem_ctx,
+                   struct tevent_context *ev,
+                   struct cli_ctx *cli_ctx,
+                   enum cache_req_type type,
+                   struct nss_batch_item *items,
+                   size_t num_items)
+{
+    struct nss_get_batch_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct nss_get_batch_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to create tevent request!\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->cli_ctx = cli_ctx;
+    state->type = type;
+    state->items = items;
+    state->num_items = num_items;
+
+    if (type != CACHE_REQ_OBJECT_BY_SID && type != CACHE_REQ_OBJECT_BY_ID) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    ret = nss_get_batch_next(req);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = state->active == 0 ? EOK : EAGAIN;
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+        tevent_req_post(req, ev);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+        tevent_req_post(req, ev);
+    }
+
+    return req;
+}
+
+static errno_t nss_get_batch_next(struct tevent_req *req)
+{
+    const char *attrs[] = { SYSDB_SID_STR, NULL };
+    struct nss_get_batch_item_state *item_state;
+    struct nss_get_batch_state *state;
+    struct cache_req_data *data;
+    struct nss_batch_item *item;
+    struct tevent_req *subreq;
+
+    state = tevent_req_data(req, struct nss_get_batch_state);
+
+    while (state->active < NSS_BATCH_PARALLEL
+            && state->next < state->num_items) {
+        item = &state->items[state->next];
+        state->next++;
+
+        /* Items rejected while parsing the input are not looked up. */
+        if (item->error != EOK) {
+            continue;
+        }
+
+        if (state->type == CACHE_REQ_OBJECT_BY_SID) {
+            data = cache_req_data_sid(state, state->type, item->sid, NULL);
+        } else {
+            data = cache_req_data_id_attrs(state, state->type, item->id,
+                                           attrs);
+        }
+        if (data == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to set cache request data!\n");
+            return ENOMEM;
+        }
+
+        subreq = nss_get_object_send(state, state->ev, state->cli_ctx, data,
+                                     SSS_MC_SID, item->sid, item->id);
+        if (subreq == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to create tevent request!\n");
+            return ENOMEM;
+        }
+
+        item_state = talloc_zero(subreq, struct nss_get_batch_item_state);
+        if (item_state == NULL) {
+            talloc_free(subreq);
+            return ENOMEM;
+        }
+        item_state->req = req;
+        item_state->item = item;
+
+        tevent_req_set_callback(subreq, nss_get_batch_done, item_state);
+        state->active++;
+    }
+
+    return EOK;
+}
+
+static void nss_get_batch_done(struct tevent_req *subreq)
+{
+    struct nss_get_batch_item_state *item_state;
+    struct nss_get_batch_state *state;
+    struct nss_batch_item *item;
+    struct tevent_req *req;
+    errno_t ret;
+
+    item_state = tevent_req_callback_data(subreq,
+                                          struct nss_get_batch_item_state);
+    req = item_state->req;
+    item = item_state->item;
+    state = tevent_req_data(req, struct nss_get_batch_state);
+
+    item->error = nss_get_object_recv(state->items, subreq, &item->result,
+                                      NULL);
+    talloc_zfree(subreq);
+    state->active--;
+
+    ret = nss_get_batch_next(req);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (state->active == 0) {
+        tevent_req_done(req);
+    }
+}
+
+errno_t
+nss_get_batch_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
@@ -153,6 +153,8 @@ int nss_memorycache_invalidate_users(struct sbus_request *req, void *data)
 
     DEBUG(SSSDBG_TRACE_LIBS, "Invalidating all users in memory cache\n");
     sss_mmap_cache_reset(nctx->pwd_mc_ctx);
+    /* SID mappings of users are kept in the SID table */
+    sss_mmap_cache_reset(nctx->sid_mc_ctx);
 
     return iface_nss_memorycache_InvalidateAllUsers_finish(req);
 }
@@ -164,6 +166,7 @@ int nss_memorycache_invalidate_groups(struct sbus_request *req, void *data)
 
     DEBUG(SSSDBG_TRACE_LIBS, "Invalidating all groups in memory cache\n");
     sss_mmap_cache_reset(nctx->grp_mc_ctx);
+    sss_mmap_cache_reset(nctx->sid_mc_ctx);
 
     return iface_nss_memorycache_InvalidateAllGroups_finish(req);
 }
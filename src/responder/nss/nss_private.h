@@ -33,6 +33,11 @@
 #include "responder/nss/nsssrv_mmap_cache.h"
 #include "lib/idmap/sss_idmap.h"
 
+/* Groups with at least this many members keep their packed member list in
+ * nss_ctx->grent_blobs, at most NSS_GRENT_BLOB_MAX lists are kept. */
+#define NSS_GRENT_BLOB_MIN_MEMBERS 1000
+#define NSS_GRENT_BLOB_MAX 64
+
 struct nss_enum_index {
     unsigned int domain;
     unsigned int result;
@@ -92,6 +97,10 @@ struct nss_ctx {
     struct sss_mc_ctx *pwd_mc_ctx;
     struct sss_mc_ctx *grp_mc_ctx;
     struct sss_mc_ctx *initgr_mc_ctx;
+    struct sss_mc_ctx *sid_mc_ctx;
+
+    /* Packed member lists of large groups, see nss_protocol_grent.c */
+    hash_table_t *grent_blobs;
 };
 
 struct sss_cmd_table *get_nss_cmds(void);
@@ -113,6 +122,28 @@ nss_get_object_recv(TALLOC_CTX *mem_ctx,
                     struct cache_req_result **_result,
                     const char **_rawname);
 
+/* One element of a batched SID request. */
+struct nss_batch_item {
+    const char *sid;        /* input of lookups by SID */
+    uint32_t id;            /* input of lookups by ID */
+
+    errno_t error;
+    struct cache_req_result *result;
+};
+
+/* Items are looked up concurrently, each item gets either a result or
+ * an error, the request itself fails only on internal errors. */
+struct tevent_req *
+nss_get_batch_send(TALLOC_CTX *mem_ctx,
+                   struct tevent_context *ev,
+                   struct cli_ctx *cli_ctx,
+                   enum cache_req_type type,
+                   struct nss_batch_item *items,
+                   size_t num_items);
+
+errno_t
+nss_get_batch_recv(struct tevent_req *req);
+
 struct tevent_req *
 nss_setent_send(TALLOC_CTX *mem_ctx,
                 struct tevent_context *ev,
@@ -351,3 +351,159 @@ nss_protocol_parse_sid(struct cli_ctx *cli_ctx,
 
     return EOK;
 }
+
+static errno_t
+nss_protocol_parse_list_count(struct cli_ctx *cli_ctx,
+                              uint8_t **_body,
+                              size_t *_blen,
+                              uint32_t *_count)
+{
+    struct cli_protocol *pctx;
+    uint32_t count;
+    uint8_t *body;
+    size_t blen;
+
+    pctx = talloc_get_type(cli_ctx->protocol_ctx, struct cli_protocol);
+
+    sss_packet_get_body(pctx->creq->in, &body, &blen);
+
+    if (blen < sizeof(uint32_t)) {
+        return EINVAL;
+    }
+
+    SAFEALIGN_COPY_UINT32(&count, body, NULL);
+    if (count == 0 || count > SSS_NSS_MAX_BATCH) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid number of elements [%u]\n",
+              count);
+        return EINVAL;
+    }
+
+    *_body = body + sizeof(uint32_t);
+    *_blen = blen - sizeof(uint32_t);
+    *_count = count;
+
+    return EOK;
+}
+
+errno_t
+nss_protocol_parse_sid_list(TALLOC_CTX *mem_ctx,
+                            struct cli_ctx *cli_ctx,
+                            struct nss_batch_item **_items,
+                            size_t *_num_items)
+{
+    struct nss_batch_item *items;
+    struct nss_ctx *nss_ctx;
+    enum idmap_error_code err;
+    const char *sid;
+    uint8_t *bin_sid;
+    size_t bin_len;
+    uint8_t *body;
+    size_t blen;
+    size_t rp = 0;
+    size_t len;
+    uint32_t count;
+    uint32_t i;
+    errno_t ret;
+
+    nss_ctx = talloc_get_type(cli_ctx->rctx->pvt_ctx, struct nss_ctx);
+
+    ret = nss_protocol_parse_list_count(cli_ctx, &body, &blen, &count);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    items = talloc_zero_array(mem_ctx, struct nss_batch_item, count);
+    if (items == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (rp >= blen) {
+            ret = EINVAL;
+            goto done;
+        }
+
+        sid = (const char *)body + rp;
+        len = strnlen(sid, blen - rp);
+        if (len == blen - rp) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "SID is not null terminated\n");
+            ret = EINVAL;
+            goto done;
+        }
+
+        items[i].sid = sid;
+        rp += len + 1;
+
+        /* A malformed SID fails only its own element. */
+        err = sss_idmap_sid_to_bin_sid(nss_ctx->idmap_ctx, sid, &bin_sid,
+                                       &bin_len);
+        if (err != IDMAP_SUCCESS) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Unable to convert SID to binary [%s].\n", sid);
+            items[i].error = EINVAL;
+            continue;
+        }
+        sss_idmap_free_bin_sid(nss_ctx->idmap_ctx, bin_sid);
+    }
+
+    if (rp != blen) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unexpected data after the SID list\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Input: %u SIDs\n", count);
+
+    *_items = items;
+    *_num_items = count;
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(items);
+    }
+
+    return ret;
+}
+
+errno_t
+nss_protocol_parse_id_list(TALLOC_CTX *mem_ctx,
+                           struct cli_ctx *cli_ctx,
+                           struct nss_batch_item **_items,
+                           size_t *_num_items)
+{
+    struct nss_batch_item *items;
+    uint8_t *body;
+    size_t blen;
+    size_t rp = 0;
+    uint32_t count;
+    uint32_t i;
+    errno_t ret;
+
+    ret = nss_protocol_parse_list_count(cli_ctx, &body, &blen, &count);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (blen != count * sizeof(uint32_t)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid length of the ID list\n");
+        return EINVAL;
+    }
+
+    items = talloc_zero_array(mem_ctx, struct nss_batch_item, count);
+    if (items == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        SAFEALIGN_COPY_UINT32(&items[i].id, body + rp, &rp);
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Input: %u IDs\n", count);
+
+    *_items = items;
+    *_num_items = count;
+
+    return EOK;
+}
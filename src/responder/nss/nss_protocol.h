@@ -44,6 +44,15 @@ typedef errno_t
                                struct sss_packet *packet,
                                struct cache_req_result *result);
 
+/**
+ * Fill SSSD response packet of a batched request, the results are
+ * available in cmd_ctx->batch.
+ */
+typedef errno_t
+(*nss_protocol_fill_batch_fn)(struct nss_ctx *nss_ctx,
+                              struct nss_cmd_ctx *cmd_ctx,
+                              struct sss_packet *packet);
+
 struct nss_cmd_ctx {
     enum cache_req_type type;
     struct cli_ctx *cli_ctx;
@@ -65,6 +74,11 @@ struct nss_cmd_ctx {
 
     /* For SID lookups. */
     enum sss_id_type sid_id_type;
+
+    /* For batched SID lookups. */
+    struct nss_batch_item *batch;
+    size_t batch_num;
+    nss_protocol_fill_batch_fn batch_fill_fn;
 };
 
 /**
@@ -112,6 +126,18 @@ errno_t
 nss_protocol_parse_sid(struct cli_ctx *cli_ctx,
                        const char **_sid);
 
+errno_t
+nss_protocol_parse_sid_list(TALLOC_CTX *mem_ctx,
+                            struct cli_ctx *cli_ctx,
+                            struct nss_batch_item **_items,
+                            size_t *_num_items);
+
+errno_t
+nss_protocol_parse_id_list(TALLOC_CTX *mem_ctx,
+                           struct cli_ctx *cli_ctx,
+                           struct nss_batch_item **_items,
+                           size_t *_num_items);
+
 /* Create response packet. */
 
 errno_t
@@ -192,4 +218,19 @@ nss_protocol_fill_id(struct nss_ctx *nss_ctx,
                      struct sss_packet *packet,
                      struct cache_req_result *result);
 
+errno_t
+nss_protocol_fill_id_batch(struct nss_ctx *nss_ctx,
+                           struct nss_cmd_ctx *cmd_ctx,
+                           struct sss_packet *packet);
+
+errno_t
+nss_protocol_fill_sid_batch(struct nss_ctx *nss_ctx,
+                            struct nss_cmd_ctx *cmd_ctx,
+                            struct sss_packet *packet);
+
+errno_t
+nss_protocol_fill_name_batch(struct nss_ctx *nss_ctx,
+                             struct nss_cmd_ctx *cmd_ctx,
+                             struct sss_packet *packet);
+
 #endif /* _NSS_PROTOCOL_H_ */
@@ -112,6 +112,122 @@ nss_get_group_ghosts(struct sss_domain_info *domain,
     return el;
 }
 
+/* Formatting the member names of large groups is expensive, so their packed
+ * member list is kept and reused until anything in the domain cache or the
+ * set of filtered users changes. */
+struct nss_grent_blob {
+    uint64_t seq;
+    uint32_t ncache_gen;
+    uint32_t num_members;
+    size_t len;
+    uint8_t *data;
+};
+
+static errno_t
+nss_grent_blob_lookup(struct nss_ctx *nss_ctx,
+                      struct sss_domain_info *domain,
+                      struct ldb_message *msg,
+                      uint64_t *_seq,
+                      struct nss_grent_blob **_blob)
+{
+    struct nss_grent_blob *blob;
+    hash_key_t key;
+    hash_value_t value;
+    uint64_t seq;
+    errno_t ret;
+    int hret;
+
+    ret = sysdb_get_sequence_number(domain->sysdb, &seq);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    *_seq = seq;
+
+    if (nss_ctx->grent_blobs == NULL) {
+        return ENOENT;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_linearized(msg->dn));
+
+    hret = hash_lookup(nss_ctx->grent_blobs, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return ENOENT;
+    }
+
+    blob = talloc_get_type(value.ptr, struct nss_grent_blob);
+    if (blob->seq != seq || (nss_ctx->filter_users_in_groups
+            && blob->ncache_gen
+                    != sss_ncache_get_user_generation(nss_ctx->rctx->ncache))) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Packed members of [%s] are stale\n",
+              key.str);
+        hash_delete(nss_ctx->grent_blobs, &key);
+        talloc_free(blob);
+        return ENOENT;
+    }
+
+    *_blob = blob;
+    return EOK;
+}
+
+static void
+nss_grent_blob_store(struct nss_ctx *nss_ctx,
+                     struct ldb_message *msg,
+                     uint64_t seq,
+                     uint32_t num_members,
+                     uint8_t *data,
+                     size_t len)
+{
+    struct nss_grent_blob *blob;
+    hash_key_t key;
+    hash_value_t value;
+    errno_t ret;
+    int hret;
+
+    if (nss_ctx->grent_blobs != NULL
+            && hash_count(nss_ctx->grent_blobs) >= NSS_GRENT_BLOB_MAX) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, "Too many packed groups, flushing\n");
+        talloc_zfree(nss_ctx->grent_blobs);
+    }
+
+    if (nss_ctx->grent_blobs == NULL) {
+        ret = sss_hash_create(nss_ctx, 0, &nss_ctx->grent_blobs);
+        if (ret != EOK) {
+            return;
+        }
+    }
+
+    blob = talloc_zero(nss_ctx->grent_blobs, struct nss_grent_blob);
+    if (blob == NULL) {
+        return;
+    }
+
+    blob->data = talloc_memdup(blob, data, len);
+    if (blob->data == NULL) {
+        talloc_free(blob);
+        return;
+    }
+
+    blob->seq = seq;
+    blob->ncache_gen = sss_ncache_get_user_generation(nss_ctx->rctx->ncache);
+    blob->num_members = num_members;
+    blob->len = len;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_linearized(msg->dn));
+    value.type = HASH_VALUE_PTR;
+    value.ptr = blob;
+
+    /* A stale entry is removed on lookup so the key is not present. */
+    hret = hash_enter(nss_ctx->grent_blobs, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to keep packed members of [%s]: "
+              "%s\n", key.str, hash_error_string(hret));
+        talloc_free(blob);
+    }
+}
+
 static errno_t
 nss_protocol_fill_members(struct sss_packet *packet,
                           struct nss_ctx *nss_ctx,
@@ -125,24 +241,57 @@ nss_protocol_fill_members(struct sss_packet *packet,
     struct resp_ctx *rctx = nss_ctx->rctx;
     struct ldb_message_element *members[2];
     struct ldb_message_element *el;
+    struct nss_grent_blob *blob;
     struct sized_string *name;
     const char *member_name;
     uint32_t num_members;
+    bool use_blob = false;
+    bool filtered = false;
+    uint64_t seq = 0;
+    size_t rp_start;
     size_t body_len;
     uint8_t *body;
     errno_t ret;
     int i, j;
 
+    members[0] = nss_get_group_members(domain, msg);
+    members[1] = nss_get_group_ghosts(domain, msg, group_name);
+
+    num_members = 0;
+    for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+        if (members[i] != NULL) {
+            num_members += members[i]->num_values;
+        }
+    }
+
+    if (num_members >= NSS_GRENT_BLOB_MIN_MEMBERS) {
+        ret = nss_grent_blob_lookup(nss_ctx, domain, msg, &seq, &blob);
+        if (ret == EOK) {
+            ret = sss_packet_grow(packet, blob->len);
+            if (ret != EOK) {
+                *_num_members = 0;
+                return ret;
+            }
+
+            sss_packet_get_body(packet, &body, &body_len);
+            SAFEALIGN_SET_STRING(&body[*_rp], blob->data, blob->len, _rp);
+
+            *_num_members = blob->num_members;
+            return EOK;
+        }
+
+        use_blob = (ret == ENOENT);
+    }
+
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
+        *_num_members = 0;
         return ENOMEM;
     }
 
-    members[0] = nss_get_group_members(domain, msg);
-    members[1] = nss_get_group_ghosts(domain, msg, group_name);
-
     sss_packet_get_body(packet, &body, &body_len);
 
+    rp_start = *_rp;
     num_members = 0;
     for (i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
         el = members[i];
@@ -159,6 +308,7 @@ nss_protocol_fill_members(struct sss_packet *packet,
                     DEBUG(SSSDBG_TRACE_FUNC,
                           "Group [%s] member [%s] filtered out! "
                           "(negative cache)\n", group_name, member_name);
+                    filtered = true;
                     continue;
                 }
             }
@@ -182,6 +332,14 @@ nss_protocol_fill_members(struct sss_packet *packet,
         }
     }
 
+    /* Lists with filtered members are not kept, the filtered users could
+     * expire from the negative cache at any time. */
+    if (use_blob && !filtered) {
+        sss_packet_get_body(packet, &body, &body_len);
+        nss_grent_blob_store(nss_ctx, msg, seq, num_members,
+                             &body[rp_start], *_rp - rp_start);
+    }
+
     ret = EOK;
 
 done:
@@ -19,6 +19,7 @@
 */
 
 #include "util/crypto/sss_crypto.h"
+#include "util/mmap_cache.h"
 #include "responder/nss/nss_protocol.h"
 
 static errno_t
@@ -85,6 +86,13 @@ nss_get_id_type(struct nss_cmd_ctx *cmd_ctx,
     return EOK;
 }
 
+static void
+nss_sid_mc_store_reply(struct nss_ctx *nss_ctx,
+                       struct nss_cmd_ctx *cmd_ctx,
+                       struct cache_req_result *result,
+                       enum sss_id_type id_type,
+                       const char *sid);
+
 errno_t
 nss_protocol_fill_sid(struct nss_ctx *nss_ctx,
                       struct nss_cmd_ctx *cmd_ctx,
@@ -126,6 +134,8 @@ nss_protocol_fill_sid(struct nss_ctx *nss_ctx,
     SAFEALIGN_SET_UINT32(&body[rp], id_type, &rp);
     SAFEALIGN_SET_STRING(&body[rp], sz_sid.str, sz_sid.len, &rp);
 
+    nss_sid_mc_store_reply(nss_ctx, cmd_ctx, result, id_type, sid);
+
     return EOK;
 }
 
@@ -388,6 +398,135 @@ nss_get_ad_name(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+static uint32_t
+nss_get_posix_id(struct cache_req_result *result, enum sss_id_type id_type)
+{
+    uint64_t id64;
+
+    if (result->ldb_result == NULL) {
+        /* well known SIDs do not have an ID */
+        return 0;
+    }
+
+    if (id_type == SSS_ID_TYPE_GID) {
+        id64 = ldb_msg_find_attr_as_uint64(result->msgs[0], SYSDB_GIDNUM, 0);
+    } else {
+        id64 = ldb_msg_find_attr_as_uint64(result->msgs[0], SYSDB_UIDNUM, 0);
+    }
+
+    if (id64 >= UINT32_MAX) {
+        return 0;
+    }
+
+    return (uint32_t)id64;
+}
+
+/* Store the answer in the SID memory cache under the input of the request
+ * so that clients can find it without asking the responder. Lookups by SID
+ * store both the name and the ID so the same record can be used for
+ * getnamebysid and getidbysid, the input is the SID then. */
+static void
+nss_sid_mc_store(struct nss_ctx *nss_ctx,
+                 enum cache_req_type type,
+                 const char *input,
+                 uint32_t id,
+                 struct cache_req_result *result,
+                 enum sss_id_type id_type,
+                 const char *sid)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sized_string *sz_name = NULL;
+    struct sized_string empty;
+    struct sized_string sz_key;
+    struct sized_string sz_sid;
+    char *key;
+    errno_t ret;
+
+    if (nss_ctx->sid_mc_ctx == NULL) {
+        return;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return;
+    }
+
+    switch (type) {
+    case CACHE_REQ_OBJECT_BY_NAME:
+        key = talloc_asprintf(tmp_ctx, MC_SID_KEY_NAME "%s", input);
+        id = 0;
+        break;
+    case CACHE_REQ_OBJECT_BY_ID:
+        key = talloc_asprintf(tmp_ctx, MC_SID_KEY_ID "%"PRIu32, id);
+        break;
+    case CACHE_REQ_OBJECT_BY_SID:
+        sid = input;
+        ret = nss_get_ad_name(tmp_ctx, nss_ctx->rctx, result, &sz_name);
+        if (ret != EOK) {
+            goto done;
+        }
+        id = nss_get_posix_id(result, id_type);
+        key = talloc_asprintf(tmp_ctx, MC_SID_KEY_SID "%s", sid);
+        break;
+    default:
+        goto done;
+    }
+
+    if (key == NULL) {
+        goto done;
+    }
+
+    to_sized_string(&sz_key, key);
+    to_sized_string(&sz_sid, sid);
+    if (sz_name == NULL) {
+        to_sized_string(&empty, "");
+        sz_name = &empty;
+    }
+
+    ret = sss_mmap_cache_sid_store(&nss_ctx->sid_mc_ctx, &sz_key, &sz_sid,
+                                   sz_name, id, id_type);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Failed to store %s in mmap cache [%d]: %s!\n",
+              key, ret, sss_strerror(ret));
+    }
+
+done:
+    talloc_free(tmp_ctx);
+}
+
+static void
+nss_sid_mc_store_reply(struct nss_ctx *nss_ctx,
+                       struct nss_cmd_ctx *cmd_ctx,
+                       struct cache_req_result *result,
+                       enum sss_id_type id_type,
+                       const char *sid)
+{
+    const char *input = NULL;
+    uint32_t id = 0;
+    errno_t ret;
+
+    switch (cmd_ctx->type) {
+    case CACHE_REQ_OBJECT_BY_NAME:
+        ret = nss_protocol_parse_name(cmd_ctx->cli_ctx, &input);
+        break;
+    case CACHE_REQ_OBJECT_BY_ID:
+        ret = nss_protocol_parse_id(cmd_ctx->cli_ctx, &id);
+        break;
+    case CACHE_REQ_OBJECT_BY_SID:
+        ret = nss_protocol_parse_sid(cmd_ctx->cli_ctx, &input);
+        break;
+    default:
+        return;
+    }
+
+    if (ret != EOK) {
+        return;
+    }
+
+    nss_sid_mc_store(nss_ctx, cmd_ctx->type, input, id, result, id_type, sid);
+}
+
 errno_t
 nss_protocol_fill_single_name(struct nss_ctx *nss_ctx,
                               struct nss_cmd_ctx *cmd_ctx,
@@ -442,6 +581,8 @@ nss_protocol_fill_name(struct nss_ctx *nss_ctx,
 
     talloc_free(sz_name);
 
+    nss_sid_mc_store_reply(nss_ctx, cmd_ctx, result, id_type, NULL);
+
     return EOK;
 }
 
@@ -451,9 +592,7 @@ nss_protocol_fill_id(struct nss_ctx *nss_ctx,
                      struct sss_packet *packet,
                      struct cache_req_result *result)
 {
-    struct ldb_message *msg = result->msgs[0];
     enum sss_id_type id_type;
-    uint64_t id64;
     uint32_t id;
     size_t rp = 0;
     size_t body_len;
@@ -470,19 +609,12 @@ nss_protocol_fill_id(struct nss_ctx *nss_ctx,
         return ret;
     }
 
-    if (id_type == SSS_ID_TYPE_GID) {
-        id64 = ldb_msg_find_attr_as_uint64(msg, SYSDB_GIDNUM, 0);
-    } else {
-        id64 = ldb_msg_find_attr_as_uint64(msg, SYSDB_UIDNUM, 0);
-    }
-
-    if (id64 == 0 || id64 >= UINT32_MAX) {
+    id = nss_get_posix_id(result, id_type);
+    if (id == 0) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Invalid POSIX ID.\n");
         return EINVAL;
     }
 
-    id = (uint32_t)id64;
-
     ret = sss_packet_grow(packet, 4 * sizeof(uint32_t));
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "sss_packet_grow failed.\n");
@@ -496,6 +628,8 @@ nss_protocol_fill_id(struct nss_ctx *nss_ctx,
     SAFEALIGN_SET_UINT32(&body[rp], id_type, &rp);
     SAFEALIGN_SET_UINT32(&body[rp], id, &rp);
 
+    nss_sid_mc_store_reply(nss_ctx, cmd_ctx, result, id_type, NULL);
+
     return EOK;
 }
 
@@ -639,3 +773,169 @@ nss_protocol_fill_name_list_all_domains(struct nss_ctx *nss_ctx,
 
     return EOK;
 }
+
+enum nss_batch_output {
+    NSS_BATCH_ID,
+    NSS_BATCH_SID,
+    NSS_BATCH_NAME,
+};
+
+static errno_t
+nss_batch_item_value(TALLOC_CTX *mem_ctx,
+                     struct nss_ctx *nss_ctx,
+                     struct nss_cmd_ctx *cmd_ctx,
+                     struct nss_batch_item *item,
+                     enum nss_batch_output output,
+                     enum sss_id_type *_id_type,
+                     uint32_t *_id,
+                     struct sized_string *_value)
+{
+    struct sized_string *sz_name;
+    enum sss_id_type id_type;
+    const char *sid = NULL;
+    uint32_t id = 0;
+    errno_t ret;
+
+    if (item->error != EOK) {
+        return item->error;
+    }
+
+    ret = nss_get_id_type(cmd_ctx, item->result, &id_type);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    switch (output) {
+    case NSS_BATCH_ID:
+        id = nss_get_posix_id(item->result, id_type);
+        if (id == 0) {
+            return EINVAL;
+        }
+        break;
+    case NSS_BATCH_SID:
+        sid = ldb_msg_find_attr_as_string(item->result->msgs[0],
+                                          SYSDB_SID_STR, NULL);
+        if (sid == NULL) {
+            return EINVAL;
+        }
+        to_sized_string(_value, sid);
+        break;
+    case NSS_BATCH_NAME:
+        ret = nss_get_ad_name(mem_ctx, nss_ctx->rctx, item->result, &sz_name);
+        if (ret != EOK) {
+            return ret;
+        }
+        *_value = *sz_name;
+        break;
+    }
+
+    nss_sid_mc_store(nss_ctx, cmd_ctx->type, item->sid, item->id,
+                     item->result, id_type, sid);
+
+    *_id_type = id_type;
+    *_id = id;
+
+    return EOK;
+}
+
+static errno_t
+nss_protocol_fill_batch(struct nss_ctx *nss_ctx,
+                        struct nss_cmd_ctx *cmd_ctx,
+                        struct sss_packet *packet,
+                        enum nss_batch_output output)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sized_string *values;
+    enum sss_id_type *id_types;
+    uint32_t *errors;
+    uint32_t *ids;
+    size_t rp = 0;
+    size_t body_len;
+    uint8_t *body;
+    size_t len;
+    size_t c;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    values = talloc_zero_array(tmp_ctx, struct sized_string,
+                               cmd_ctx->batch_num);
+    id_types = talloc_zero_array(tmp_ctx, enum sss_id_type,
+                                 cmd_ctx->batch_num);
+    errors = talloc_zero_array(tmp_ctx, uint32_t, cmd_ctx->batch_num);
+    ids = talloc_zero_array(tmp_ctx, uint32_t, cmd_ctx->batch_num);
+    if (values == NULL || id_types == NULL || errors == NULL || ids == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    len = 2 * sizeof(uint32_t);
+    for (c = 0; c < cmd_ctx->batch_num; c++) {
+        ret = nss_batch_item_value(tmp_ctx, nss_ctx, cmd_ctx,
+                                   &cmd_ctx->batch[c], output,
+                                   &id_types[c], &ids[c], &values[c]);
+        if (ret != EOK) {
+            errors[c] = ret;
+            id_types[c] = SSS_ID_TYPE_NOT_SPECIFIED;
+            ids[c] = 0;
+            to_sized_string(&values[c], "");
+        }
+
+        len += 2 * sizeof(uint32_t);
+        len += output == NSS_BATCH_ID ? sizeof(uint32_t) : values[c].len;
+    }
+
+    ret = sss_packet_grow(packet, len);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "sss_packet_grow failed.\n");
+        goto done;
+    }
+
+    sss_packet_get_body(packet, &body, &body_len);
+
+    SAFEALIGN_SET_UINT32(&body[rp], cmd_ctx->batch_num, &rp); /* Num results */
+    SAFEALIGN_SET_UINT32(&body[rp], 0, &rp); /* Reserved. */
+    for (c = 0; c < cmd_ctx->batch_num; c++) {
+        SAFEALIGN_SET_UINT32(&body[rp], errors[c], &rp);
+        SAFEALIGN_SET_UINT32(&body[rp], id_types[c], &rp);
+        if (output == NSS_BATCH_ID) {
+            SAFEALIGN_SET_UINT32(&body[rp], ids[c], &rp);
+        } else {
+            SAFEALIGN_SET_STRING(&body[rp], values[c].str, values[c].len,
+                                 &rp);
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t
+nss_protocol_fill_id_batch(struct nss_ctx *nss_ctx,
+                           struct nss_cmd_ctx *cmd_ctx,
+                           struct sss_packet *packet)
+{
+    return nss_protocol_fill_batch(nss_ctx, cmd_ctx, packet, NSS_BATCH_ID);
+}
+
+errno_t
+nss_protocol_fill_sid_batch(struct nss_ctx *nss_ctx,
+                            struct nss_cmd_ctx *cmd_ctx,
+                            struct sss_packet *packet)
+{
+    return nss_protocol_fill_batch(nss_ctx, cmd_ctx, packet, NSS_BATCH_SID);
+}
+
+errno_t
+nss_protocol_fill_name_batch(struct nss_ctx *nss_ctx,
+                             struct nss_cmd_ctx *cmd_ctx,
+                             struct sss_packet *packet)
+{
+    return nss_protocol_fill_batch(nss_ctx, cmd_ctx, packet, NSS_BATCH_NAME);
+}
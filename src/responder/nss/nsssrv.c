@@ -131,6 +131,15 @@ static int nss_clear_memcache(struct sbus_request *dbus_req, void *data)
         return ret;
     }
 
+    ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
+                                (time_t)memcache_timeout,
+                                &nctx->sid_mc_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "sid mmap cache invalidation failed\n");
+        return ret;
+    }
+
 done:
     return sbus_request_return_and_finish(dbus_req, DBUS_TYPE_INVALID);
 }
@@ -351,6 +360,34 @@ static void nss_dp_reconnect_init(struct sbus_connection *conn,
     /* nss_shutdown(rctx); */
 }
 
+/* The memory cache files are reused across restarts only if they were
+ * created with the same configuration. sssd.conf is loaded into the confdb
+ * again whenever it changes, so its modification time is a good enough
+ * fingerprint of the domain configuration. */
+static uint32_t nss_mc_fingerprint(TALLOC_CTX *mem_ctx,
+                                   struct confdb_ctx *cdb,
+                                   int memcache_timeout)
+{
+    char *last_update = NULL;
+    uint32_t fingerprint;
+    errno_t ret;
+
+    ret = confdb_get_string(cdb, mem_ctx, "config", "lastUpdate",
+                            NULL, &last_update);
+    if (ret != EOK || last_update == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to read the configuration "
+              "timestamp, memory cache files will not be reused\n");
+        return 0;
+    }
+
+    fingerprint = murmurhash3(last_update, strlen(last_update),
+                              (uint32_t)memcache_timeout);
+    talloc_free(last_update);
+
+    /* 0 means the files must not be reused */
+    return fingerprint == 0 ? 1 : fingerprint;
+}
+
 int nss_process_init(TALLOC_CTX *mem_ctx,
                      struct tevent_context *ev,
                      struct confdb_ctx *cdb)
@@ -360,6 +397,7 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
     struct be_conn *iter;
     struct nss_ctx *nctx;
     int memcache_timeout;
+    uint32_t mc_fingerprint;
     int ret, max_retries;
     enum idmap_error_code err;
     int fd_limit;
@@ -450,28 +488,39 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    mc_fingerprint = nss_mc_fingerprint(nctx, nctx->rctx->cdb,
+                                        memcache_timeout);
+
     /* TODO: read cache sizes from configuration */
-    ret = sss_mmap_cache_init(nctx, "passwd", SSS_MC_PASSWD,
+    ret = sss_mmap_cache_init(nctx, "passwd", mc_fingerprint, SSS_MC_PASSWD,
                               SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
                               &nctx->pwd_mc_ctx);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "passwd mmap cache is DISABLED\n");
     }
 
-    ret = sss_mmap_cache_init(nctx, "group", SSS_MC_GROUP,
+    ret = sss_mmap_cache_init(nctx, "group", mc_fingerprint, SSS_MC_GROUP,
                               SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
                               &nctx->grp_mc_ctx);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "group mmap cache is DISABLED\n");
     }
 
-    ret = sss_mmap_cache_init(nctx, "initgroups", SSS_MC_INITGROUPS,
+    ret = sss_mmap_cache_init(nctx, "initgroups", mc_fingerprint,
+                              SSS_MC_INITGROUPS,
                               SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
                               &nctx->initgr_mc_ctx);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "initgroups mmap cache is DISABLED\n");
     }
 
+    ret = sss_mmap_cache_init(nctx, "sid", mc_fingerprint, SSS_MC_SID,
+                              SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
+                              &nctx->sid_mc_ctx);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "sid mmap cache is DISABLED\n");
+    }
+
     /* Set up file descriptor limits */
     ret = confdb_get_int(nctx->rctx->cdb,
                          CONFDB_NSS_CONF_ENTRY,
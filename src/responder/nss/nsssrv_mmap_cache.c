@@ -33,6 +33,8 @@
 #define SSS_AVG_GROUP_PAYLOAD (MC_SLOT_SIZE * 3)
 /* average place for 40 supplementary groups + 2 names */
 #define SSS_AVG_INITGROUP_PAYLOAD (MC_SLOT_SIZE * 5)
+/* key, domain SID with a RID and a qualified name */
+#define SSS_AVG_SID_PAYLOAD (MC_SLOT_SIZE * 4)
 
 #define MC_NEXT_BARRIER(val) ((((val) + 1) & 0x00ffffff) | 0xf0000000)
 
@@ -58,6 +60,7 @@ struct sss_mc_ctx {
     int fd;                 /* file descriptor */
 
     uint32_t seed;          /* pseudo-random seed to avoid collision attacks */
+    uint32_t fingerprint;   /* fingerprint of the configuration */
     time_t valid_time_slot; /* maximum time the entry is valid in seconds */
 
     void *mmap_base;        /* base address of mmap */
@@ -320,11 +323,41 @@ static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
     MC_LOWER_BARRIER(rec);
 }
 
-static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
+/* Checks that rec is reachable through the chain of the given hash. The
+ * walk never leaves the data table and gives up after visiting as many
+ * records as there are slots, so a corrupted or cyclic chain ends it. */
+static bool sss_mc_rec_in_chain(struct sss_mc_ctx *mcc,
+                                struct sss_mc_rec *rec,
+                                uint32_t hash)
 {
-    struct sss_mc_rec *self;
+    struct sss_mc_rec *cur;
+    uint32_t num_slots;
     uint32_t slot;
+    uint32_t steps;
+
+    if (hash >= MC_HT_ELEMS(mcc->ht_size)) {
+        return false;
+    }
+
+    num_slots = mcc->dt_size / MC_SLOT_SIZE;
+    slot = mcc->hash_table[hash];
+    for (steps = 0; steps < num_slots && slot != MC_INVALID_VAL32; steps++) {
+        if (!MC_SLOT_WITHIN_BOUNDS(slot, mcc->dt_size)) {
+            return false;
+        }
+
+        cur = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
+        if (cur == rec) {
+            return true;
+        }
+        slot = sss_mc_next_slot_with_hash(cur, hash);
+    }
 
+    return false;
+}
+
+static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
+{
     if (((uint8_t *)rec < mcc->data_table) ||
         ((uint8_t *)rec > (mcc->data_table + mcc->dt_size - MC_SLOT_SIZE))) {
         return false;
@@ -344,30 +377,24 @@ static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
     }
 
     /* next record can be invalid if there are no next records */
+    if (rec->next1 != MC_INVALID_VAL32 &&
+        !MC_SLOT_WITHIN_BOUNDS(rec->next1, mcc->dt_size)) {
+        return false;
+    }
+    if (rec->next2 != MC_INVALID_VAL32 &&
+        !MC_SLOT_WITHIN_BOUNDS(rec->next2, mcc->dt_size)) {
+        return false;
+    }
 
     if (rec->hash1 == MC_INVALID_VAL32) {
         return false;
-    } else {
-        self = NULL;
-        slot = mcc->hash_table[rec->hash1];
-        while (slot != MC_INVALID_VAL32 && self != rec) {
-            self = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
-            slot = sss_mc_next_slot_with_hash(self, rec->hash1);
-        }
-        if (self != rec) {
-            return false;
-        }
+    } else if (!sss_mc_rec_in_chain(mcc, rec, rec->hash1)) {
+        return false;
     }
-    if (rec->hash2 != MC_INVALID_VAL32) {
-        self = NULL;
-        slot = mcc->hash_table[rec->hash2];
-        while (slot != MC_INVALID_VAL32 && self != rec) {
-            self = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
-            slot = sss_mc_next_slot_with_hash(self, rec->hash2);
-        }
-        if (self != rec) {
-            return false;
-        }
+
+    if (rec->hash2 != MC_INVALID_VAL32 &&
+        !sss_mc_rec_in_chain(mcc, rec, rec->hash2)) {
+        return false;
     }
 
     /* all tests passed */
@@ -478,6 +505,9 @@ static errno_t sss_mc_get_strs_offset(struct sss_mc_ctx *mcc,
     case SSS_MC_INITGROUPS:
         *_offset = offsetof(struct sss_mc_initgr_data, gids);
         return EOK;
+    case SSS_MC_SID:
+        *_offset = offsetof(struct sss_mc_sid_data, strs);
+        return EOK;
     default:
         DEBUG(SSSDBG_FATAL_FAILURE, "Unknown memory cache type.\n");
         return EINVAL;
@@ -498,6 +528,9 @@ static errno_t sss_mc_get_strs_len(struct sss_mc_ctx *mcc,
     case SSS_MC_INITGROUPS:
         *_len = ((struct sss_mc_initgr_data *)&rec->data)->data_len;
         return EOK;
+    case SSS_MC_SID:
+        *_len = ((struct sss_mc_sid_data *)&rec->data)->strs_len;
+        return EOK;
     default:
         DEBUG(SSSDBG_FATAL_FAILURE, "Unknown memory cache type.\n");
         return EINVAL;
@@ -1036,6 +1069,79 @@ errno_t sss_mmap_cache_initgr_invalidate(struct sss_mc_ctx *mcc,
     return sss_mmap_cache_invalidate(mcc, name);
 }
 
+/***************************************************************************
+ * SID map
+ ***************************************************************************/
+
+errno_t sss_mmap_cache_sid_store(struct sss_mc_ctx **_mcc,
+                                 struct sized_string *key,
+                                 struct sized_string *sid,
+                                 struct sized_string *name,
+                                 uint32_t id, uint32_t type)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_sid_data *data;
+    size_t data_len;
+    size_t rec_len;
+    size_t pos;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    data_len = key->len + sid->len + name->len;
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_sid_data) +
+              data_len;
+    if (rec_len > mcc->dt_size) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, key, &rec);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    data = (struct sss_mc_sid_data *)rec->data;
+    pos = 0;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* There is only one key, use it twice. */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            key->str, key->len, key->str, key->len);
+
+    /* sid struct */
+    data->id = id;
+    data->type = type;
+    data->strs_len = data_len;
+    data->key = MC_PTR_DIFF(&data->strs[pos], data);
+    memcpy(&data->strs[pos], key->str, key->len);
+    pos += key->len;
+    data->sid = MC_PTR_DIFF(&data->strs[pos], data);
+    memcpy(&data->strs[pos], sid->str, sid->len);
+    pos += sid->len;
+    data->name = MC_PTR_DIFF(&data->strs[pos], data);
+    memcpy(&data->strs[pos], name->str, name->len);
+    pos += name->len;
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    return EOK;
+}
+
+errno_t sss_mmap_cache_sid_invalidate(struct sss_mc_ctx *mcc,
+                                      struct sized_string *key)
+{
+    return sss_mmap_cache_invalidate(mcc, key);
+}
+
 /***************************************************************************
  * initialization
  ***************************************************************************/
@@ -1154,6 +1260,196 @@ static errno_t sss_mc_create_file(struct sss_mc_ctx *mc_ctx)
     return ret;
 }
 
+static void sss_mc_set_tables(struct sss_mc_ctx *mc_ctx)
+{
+    mc_ctx->data_table = MC_PTR_ADD(mc_ctx->mmap_base, MC_HEADER_SIZE);
+    mc_ctx->free_table = MC_PTR_ADD(mc_ctx->data_table,
+                                    MC_ALIGN64(mc_ctx->dt_size));
+    mc_ctx->hash_table = MC_PTR_ADD(mc_ctx->free_table,
+                                    MC_ALIGN64(mc_ctx->ft_size));
+}
+
+static bool sss_mc_header_matches(struct sss_mc_ctx *mc_ctx)
+{
+    struct sss_mc_header *h;
+
+    h = (struct sss_mc_header *)mc_ctx->mmap_base;
+
+    return MC_VALID_BARRIER(h->b1)
+        && h->b1 == h->b2
+        && h->major_vno == SSS_MC_MAJOR_VNO
+        && h->minor_vno == SSS_MC_MINOR_VNO
+        && h->status == SSS_MC_HEADER_ALIVE
+        && h->fingerprint == mc_ctx->fingerprint
+        && h->dt_size == mc_ctx->dt_size
+        && h->ft_size == mc_ctx->ft_size
+        && h->ht_size == mc_ctx->ht_size
+        && h->data_table == MC_PTR_DIFF(mc_ctx->data_table,
+                                        mc_ctx->mmap_base)
+        && h->free_table == MC_PTR_DIFF(mc_ctx->free_table,
+                                        mc_ctx->mmap_base)
+        && h->hash_table == MC_PTR_DIFF(mc_ctx->hash_table,
+                                        mc_ctx->mmap_base);
+}
+
+/* Checks that every used slot belongs to a valid record and every hash
+ * table entry points to one, so that a cache left behind by a process
+ * that was killed in the middle of an update is never adopted. */
+static bool sss_mc_tables_consistent(struct sss_mc_ctx *mc_ctx)
+{
+    struct sss_mc_rec *rec;
+    uint32_t num_slots;
+    uint32_t steps;
+    uint32_t slot;
+    uint32_t num;
+    uint32_t i;
+    bool used;
+
+    num_slots = mc_ctx->dt_size / MC_SLOT_SIZE;
+
+    /* Every chain must only go through used slots and must end within as
+     * many steps as there are slots, otherwise it loops. */
+    for (i = 0; i < MC_HT_ELEMS(mc_ctx->ht_size); i++) {
+        slot = mc_ctx->hash_table[i];
+        for (steps = 0; slot != MC_INVALID_VAL32; steps++) {
+            if (steps >= num_slots
+                    || !MC_SLOT_WITHIN_BOUNDS(slot, mc_ctx->dt_size)) {
+                return false;
+            }
+
+            MC_PROBE_BIT(mc_ctx->free_table, slot, used);
+            if (!used) {
+                return false;
+            }
+
+            rec = MC_SLOT_TO_PTR(mc_ctx->data_table, slot, struct sss_mc_rec);
+            if (rec->hash1 != i && rec->hash2 != i) {
+                return false;
+            }
+            slot = sss_mc_next_slot_with_hash(rec, i);
+        }
+    }
+
+    slot = 0;
+    while (slot < num_slots) {
+        MC_PROBE_BIT(mc_ctx->free_table, slot, used);
+        if (!used) {
+            slot++;
+            continue;
+        }
+
+        rec = MC_SLOT_TO_PTR(mc_ctx->data_table, slot, struct sss_mc_rec);
+        if (!sss_mc_is_valid_rec(mc_ctx, rec)) {
+            return false;
+        }
+
+        num = MC_SIZE_TO_SLOTS(rec->len);
+        for (i = 1; i < num; i++) {
+            MC_PROBE_BIT(mc_ctx->free_table, slot + i, used);
+            if (!used) {
+                return false;
+            }
+        }
+
+        slot += num;
+    }
+
+    return true;
+}
+
+/*
+ * Reuse the cache file left behind by the previous sssd_nss instance so
+ * that clients keep using it across restarts. The file is adopted only if
+ * it has the expected layout, was built with the same configuration, was
+ * not recycled in the meantime (e.g. by sss_cache) and is consistent.
+ */
+static errno_t sss_mc_adopt_file(struct sss_mc_ctx *mc_ctx)
+{
+    struct sss_mc_header *h;
+    struct stat st;
+    useconds_t t = 50000;
+    int retries = 3;
+    errno_t ret;
+
+    if (mc_ctx->fingerprint == 0) {
+        return ENOENT;
+    }
+
+    mc_ctx->fd = open(mc_ctx->file, O_RDWR);
+    if (mc_ctx->fd == -1) {
+        ret = errno;
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Failed to open old memory cache file %s: %d(%s).\n",
+                   mc_ctx->file, ret, strerror(ret));
+        }
+        return ret;
+    }
+
+    ret = sss_br_lock_file(mc_ctx->fd, 0, 1, retries, t);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Failed to lock file %s.\n", mc_ctx->file);
+        goto done;
+    }
+
+    ret = fstat(mc_ctx->fd, &st);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    if (st.st_size != mc_ctx->mmap_size) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Memory cache file %s has a different "
+              "size, not reusing it\n", mc_ctx->file);
+        ret = EINVAL;
+        goto done;
+    }
+
+    mc_ctx->mmap_base = mmap(NULL, mc_ctx->mmap_size,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED, mc_ctx->fd, 0);
+    if (mc_ctx->mmap_base == MAP_FAILED) {
+        ret = errno;
+        mc_ctx->mmap_base = NULL;
+        goto done;
+    }
+
+    sss_mc_set_tables(mc_ctx);
+
+    if (!sss_mc_header_matches(mc_ctx)) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Memory cache file %s is outdated, "
+              "not reusing it\n", mc_ctx->file);
+        ret = EINVAL;
+        goto done;
+    }
+
+    h = (struct sss_mc_header *)mc_ctx->mmap_base;
+    mc_ctx->seed = h->seed;
+
+    if (!sss_mc_tables_consistent(mc_ctx)) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Memory cache file %s is inconsistent, "
+              "not reusing it\n", mc_ctx->file);
+        ret = EINVAL;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Reusing memory cache file %s\n", mc_ctx->file);
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        if (mc_ctx->mmap_base != NULL) {
+            munmap(mc_ctx->mmap_base, mc_ctx->mmap_size);
+            mc_ctx->mmap_base = NULL;
+        }
+        close(mc_ctx->fd);
+        mc_ctx->fd = -1;
+    }
+
+    return ret;
+}
+
 static void sss_mc_header_update(struct sss_mc_ctx *mc_ctx, int status)
 {
     struct sss_mc_header *h;
@@ -1173,7 +1469,7 @@ static void sss_mc_header_update(struct sss_mc_ctx *mc_ctx, int status)
         h->major_vno = SSS_MC_MAJOR_VNO;
         h->minor_vno = SSS_MC_MINOR_VNO;
         h->seed = mc_ctx->seed;
-        h->reserved = 0;
+        h->fingerprint = mc_ctx->fingerprint;
     }
     h->status = status;
     MC_LOWER_BARRIER(h);
@@ -1209,9 +1505,10 @@ static int mc_ctx_destructor(struct sss_mc_ctx *mc_ctx)
     return 0;
 }
 
-errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
-                            enum sss_mc_type type, size_t n_elem,
-                            time_t timeout, struct sss_mc_ctx **mcc)
+static errno_t sss_mc_init(TALLOC_CTX *mem_ctx, const char *name,
+                           uint32_t fingerprint, bool adopt,
+                           enum sss_mc_type type, size_t n_elem,
+                           time_t timeout, struct sss_mc_ctx **mcc)
 {
     struct sss_mc_ctx *mc_ctx = NULL;
     unsigned int rseed;
@@ -1228,6 +1525,9 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     case SSS_MC_INITGROUPS:
         payload = SSS_AVG_INITGROUP_PAYLOAD;
         break;
+    case SSS_MC_SID:
+        payload = SSS_AVG_SID_PAYLOAD;
+        break;
     default:
         return EINVAL;
     }
@@ -1246,6 +1546,7 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     }
 
     mc_ctx->type = type;
+    mc_ctx->fingerprint = fingerprint;
 
     mc_ctx->valid_time_slot = timeout;
 
@@ -1272,7 +1573,14 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
                         MC_ALIGN64(mc_ctx->ht_size);
 
 
-    /* for now ALWAYS create a new file on restart */
+    if (adopt) {
+        ret = sss_mc_adopt_file(mc_ctx);
+        if (ret == EOK) {
+            /* refresh the header, clients are already using the file */
+            sss_mc_header_update(mc_ctx, SSS_MC_HEADER_ALIVE);
+            goto done;
+        }
+    }
 
     ret = sss_mc_create_file(mc_ctx);
     if (ret) {
@@ -1298,11 +1606,7 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
         goto done;
     }
 
-    mc_ctx->data_table = MC_PTR_ADD(mc_ctx->mmap_base, MC_HEADER_SIZE);
-    mc_ctx->free_table = MC_PTR_ADD(mc_ctx->data_table,
-                                    MC_ALIGN64(mc_ctx->dt_size));
-    mc_ctx->hash_table = MC_PTR_ADD(mc_ctx->free_table,
-                                    MC_ALIGN64(mc_ctx->ft_size));
+    sss_mc_set_tables(mc_ctx);
 
     memset(mc_ctx->data_table, 0xff, mc_ctx->dt_size);
     memset(mc_ctx->free_table, 0x00, mc_ctx->ft_size);
@@ -1338,6 +1642,15 @@ done:
     return ret;
 }
 
+errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
+                            uint32_t fingerprint,
+                            enum sss_mc_type type, size_t n_elem,
+                            time_t timeout, struct sss_mc_ctx **mcc)
+{
+    return sss_mc_init(mem_ctx, name, fingerprint, true, type, n_elem,
+                       timeout, mcc);
+}
+
 errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
                               time_t timeout, struct sss_mc_ctx **mc_ctx)
 {
@@ -1345,6 +1658,7 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
     TALLOC_CTX* tmp_ctx = NULL;
     char *name;
     enum sss_mc_type type;
+    uint32_t fingerprint;
 
     if (mc_ctx == NULL || (*mc_ctx) == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -1366,6 +1680,7 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
     }
 
     type = (*mc_ctx)->type;
+    fingerprint = (*mc_ctx)->fingerprint;
 
     if (n_elem == (size_t)-1) {
         n_elem = (*mc_ctx)->ft_size * 8;
@@ -1380,7 +1695,9 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
     /* make sure we do not leave a potentially freed pointer around */
     *mc_ctx = NULL;
 
-    ret = sss_mmap_cache_init(mem_ctx, name, type, n_elem, timeout, mc_ctx);
+    /* the caches are being cleared, always start with a new file */
+    ret = sss_mc_init(mem_ctx, name, fingerprint, false, type, n_elem,
+                      timeout, mc_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to re-initialize mmap cache.\n");
         goto done;
@@ -49,6 +49,24 @@ struct pam_ctx {
     bool cert_auth;
     int p11_child_debug_fd;
     char *nss_db;
+    /* idle p11_child processes, see pamsrv_p11.c */
+    struct pam_p11_child *p11_children;
+};
+
+/* A long-lived p11_child process, see pamsrv_p11.c */
+struct pam_p11_child {
+    struct pam_p11_child *prev;
+    struct pam_p11_child *next;
+
+    struct pam_ctx *pctx;
+    /* certificate_verification options the child was started with */
+    char *verify_opts;
+    pid_t pid;
+    struct child_io_fds *io;
+    struct sss_child_ctx_old *child_ctx;
+    bool idle;
+    bool exited;
+    int num_requests;
 };
 
 struct pam_auth_dp_req {
@@ -90,8 +108,7 @@ errno_t p11_child_init(struct pam_ctx *pctx);
 
 struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
                                        struct tevent_context *ev,
-                                       int child_debug_fd,
-                                       const char *nss_db,
+                                       struct pam_ctx *pctx,
                                        time_t timeout,
                                        const char *verify_opts,
                                        struct pam_data *pd);
@@ -20,12 +20,14 @@
 */
 
 #include <time.h>
+#include <signal.h>
 
 #include "util/util.h"
 #include "providers/data_provider.h"
 #include "util/child_common.h"
 #include "util/strtonum.h"
 #include "responder/pam/pamsrv.h"
+#include "p11_child/p11_child.h"
 
 
 #ifndef SSSD_LIBEXEC_PATH
@@ -266,208 +268,551 @@ done:
     return ret;
 }
 
-struct pam_check_cert_state {
-    int child_status;
-    struct sss_child_ctx_old *child_ctx;
-    struct tevent_timer *timeout_handler;
-    struct tevent_context *ev;
+/* == long-lived p11_child processes ======================================= */
 
-    struct child_io_fds *io;
-    char *cert;
-    char *token_name;
-    char *module_name;
-    char *key_id;
-};
+/*
+ * The p11_child is started with --persistent and serves requests until its
+ * stdin is closed, so the NSS database and the PKCS#11 modules are only
+ * loaded once. Each child processes only one request at a time; idle
+ * children are kept in pctx->p11_children and concurrent requests simply
+ * start an additional child.
+ */
 
-static void p11_child_write_done(struct tevent_req *subreq);
-static void p11_child_done(struct tevent_req *subreq);
-static void p11_child_timeout(struct tevent_context *ev,
-                              struct tevent_timer *te,
-                              struct timeval tv, void *pvt);
+/* Maximum number of idle p11_child processes */
+#define P11_CHILD_MAX_IDLE 1
 
-struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
-                                       struct tevent_context *ev,
-                                       int child_debug_fd,
-                                       const char *nss_db,
-                                       time_t timeout,
-                                       const char *verify_opts,
-                                       struct pam_data *pd)
+static int pam_p11_child_destructor(struct pam_p11_child *child)
+{
+    if (child->idle) {
+        DLIST_REMOVE(child->pctx->p11_children, child);
+        child->idle = false;
+    }
+
+    if (child->child_ctx != NULL) {
+        /* the child is still running, make sure it terminates */
+        child_handler_destroy(child->child_ctx);
+        child->child_ctx = NULL;
+    }
+
+    return 0;
+}
+
+static void pam_p11_child_exited(int child_status,
+                                 struct tevent_signal *sige,
+                                 void *pvt)
+{
+    struct pam_p11_child *child = talloc_get_type(pvt, struct pam_p11_child);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "p11_child [%d] exited\n", child->pid);
+
+    /* the signal handler context is freed by the caller */
+    child->child_ctx = NULL;
+    child->exited = true;
+
+    /* a busy child is freed by the request using it, which will see the
+     * closed pipe */
+    if (child->idle) {
+        talloc_free(child);
+    }
+}
+
+static errno_t pam_p11_child_fork(struct tevent_context *ev,
+                                  struct pam_ctx *pctx,
+                                  const char *verify_opts,
+                                  struct pam_p11_child **_child)
 {
-    errno_t ret;
-    struct tevent_req *req;
-    struct tevent_req *subreq;
-    struct pam_check_cert_state *state;
-    pid_t child_pid;
-    struct timeval tv;
     int pipefd_to_child[2] = PIPE_INIT;
     int pipefd_from_child[2] = PIPE_INIT;
-    const char *extra_args[7] = { NULL };
-    uint8_t *write_buf = NULL;
-    size_t write_buf_len = 0;
+    const char *extra_args[6] = { NULL };
+    struct pam_p11_child *child;
+    int child_debug_fd;
     size_t arg_c;
+    pid_t pid;
+    errno_t ret;
 
-    req = tevent_req_create(mem_ctx, &state, struct pam_check_cert_state);
-    if (req == NULL) {
-        return NULL;
+    if (pctx->nss_db == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Missing NSS DB.\n");
+        return EINVAL;
     }
 
-    if (nss_db == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Missing NSS DB.\n");
-        ret = EINVAL;
-        goto done;
+    child = talloc_zero(pctx, struct pam_p11_child);
+    if (child == NULL) {
+        return ENOMEM;
+    }
+    child->pctx = pctx;
+
+    if (verify_opts != NULL) {
+        child->verify_opts = talloc_strdup(child, verify_opts);
+        if (child->verify_opts == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
     }
 
     /* extra_args are added in revers order */
     arg_c = 0;
-    extra_args[arg_c++] = nss_db;
+    extra_args[arg_c++] = "--persistent";
+    extra_args[arg_c++] = pctx->nss_db;
     extra_args[arg_c++] = "--nssdb";
-    if (verify_opts != NULL) {
-        extra_args[arg_c++] = verify_opts;
+    if (child->verify_opts != NULL) {
+        extra_args[arg_c++] = child->verify_opts;
         extra_args[arg_c++] = "--verify";
     }
-    if (pd->cmd == SSS_PAM_AUTHENTICATE) {
-        extra_args[arg_c++] = "--auth";
-        switch (sss_authtok_get_type(pd->authtok)) {
-        case SSS_AUTHTOK_TYPE_SC_PIN:
-            extra_args[arg_c++] = "--pin";
-            break;
-        case SSS_AUTHTOK_TYPE_SC_KEYPAD:
-            extra_args[arg_c++] = "--keypad";
-            break;
-        default:
-            DEBUG(SSSDBG_OP_FAILURE, "Unsupported authtok type.\n");
-            ret = EINVAL;
-            goto done;
-        }
-    } else if (pd->cmd == SSS_PAM_PREAUTH) {
-        extra_args[arg_c++] = "--pre";
-    } else {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unexpected PAM command [%d}.\n", pd->cmd);
-        ret = EINVAL;
-        goto done;
-    }
 
-    state->ev = ev;
-    state->child_status = EFAULT;
-    state->cert = NULL;
-    state->token_name = NULL;
-    state->module_name = NULL;
-    state->io = talloc(state, struct child_io_fds);
-    if (state->io == NULL) {
+    child->io = talloc(child, struct child_io_fds);
+    if (child->io == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
         ret = ENOMEM;
-        goto done;
+        goto fail;
     }
-    state->io->write_to_child_fd = -1;
-    state->io->read_from_child_fd = -1;
-    talloc_set_destructor((void *) state->io, child_io_destructor);
+    child->io->write_to_child_fd = -1;
+    child->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) child->io, child_io_destructor);
 
     ret = pipe(pipefd_from_child);
     if (ret == -1) {
         ret = errno;
         DEBUG(SSSDBG_CRIT_FAILURE,
               "pipe failed [%d][%s].\n", ret, strerror(ret));
-        goto done;
+        goto fail;
     }
     ret = pipe(pipefd_to_child);
     if (ret == -1) {
         ret = errno;
         DEBUG(SSSDBG_CRIT_FAILURE,
               "pipe failed [%d][%s].\n", ret, strerror(ret));
-        goto done;
+        goto fail;
     }
 
+    child_debug_fd = pctx->p11_child_debug_fd;
     if (child_debug_fd == -1) {
         child_debug_fd = STDERR_FILENO;
     }
 
-    child_pid = fork();
-    if (child_pid == 0) { /* child */
-        exec_child_ex(state, pipefd_to_child, pipefd_from_child,
+    pid = fork();
+    if (pid == 0) { /* child */
+        exec_child_ex(child, pipefd_to_child, pipefd_from_child,
                       P11_CHILD_PATH, child_debug_fd, extra_args, false,
                       STDIN_FILENO, STDOUT_FILENO);
 
         /* We should never get here */
         DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec p11 child\n");
-    } else if (child_pid > 0) { /* parent */
-
-        state->io->read_from_child_fd = pipefd_from_child[0];
+    } else if (pid > 0) { /* parent */
+        child->pid = pid;
+        child->io->read_from_child_fd = pipefd_from_child[0];
         PIPE_FD_CLOSE(pipefd_from_child[1]);
-        sss_fd_nonblocking(state->io->read_from_child_fd);
-
-        state->io->write_to_child_fd = pipefd_to_child[1];
+        child->io->write_to_child_fd = pipefd_to_child[1];
         PIPE_FD_CLOSE(pipefd_to_child[0]);
-        sss_fd_nonblocking(state->io->write_to_child_fd);
+        sss_fd_nonblocking(child->io->read_from_child_fd);
+        sss_fd_nonblocking(child->io->write_to_child_fd);
 
-        /* Set up SIGCHLD handler */
-        ret = child_handler_setup(ev, child_pid, NULL, NULL, &state->child_ctx);
+        ret = child_handler_setup(ev, pid, pam_p11_child_exited, child,
+                                  &child->child_ctx);
         if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE, "Could not set up child handlers [%d]: %s\n",
-                ret, sss_strerror(ret));
-            ret = ERR_P11_CHILD;
-            goto done;
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Could not set up child handlers [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            /* the pipes are closed by the io destructor */
+            kill(pid, SIGKILL);
+            talloc_free(child);
+            return ERR_P11_CHILD;
+        }
+        talloc_set_destructor(child, pam_p11_child_destructor);
+    } else { /* error */
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "fork failed [%d][%s].\n",
+                                   ret, sss_strerror(ret));
+        goto fail;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started p11_child [%d]\n", child->pid);
+    *_child = child;
+    return EOK;
+
+fail:
+    PIPE_CLOSE(pipefd_from_child);
+    PIPE_CLOSE(pipefd_to_child);
+    talloc_free(child);
+    return ret;
+}
+
+/*
+ * This function returns an idle p11_child started with the given options or
+ * starts a new one.
+ */
+static errno_t pam_p11_child_get(struct tevent_context *ev,
+                                 struct pam_ctx *pctx,
+                                 const char *verify_opts,
+                                 struct pam_p11_child **_child)
+{
+    struct pam_p11_child *child;
+
+    while ((child = pctx->p11_children) != NULL) {
+        DLIST_REMOVE(pctx->p11_children, child);
+        child->idle = false;
+
+        if ((child->verify_opts == NULL) != (verify_opts == NULL)
+                || (verify_opts != NULL
+                        && strcmp(child->verify_opts, verify_opts) != 0)) {
+            /* the configuration changed */
+            talloc_free(child);
+            continue;
         }
 
-        /* Set up timeout handler */
-        tv = tevent_timeval_current_ofs(timeout, 0);
-        state->timeout_handler = tevent_add_timer(ev, req, tv,
-                                                  p11_child_timeout, req);
-        if(state->timeout_handler == NULL) {
-            ret = ERR_P11_CHILD;
-            goto done;
+        DEBUG(SSSDBG_TRACE_FUNC, "Reusing p11_child [%d]\n", child->pid);
+        *_child = child;
+        return EOK;
+    }
+
+    return pam_p11_child_fork(ev, pctx, verify_opts, _child);
+}
+
+/*
+ * This function returns a p11_child after a request. Children which failed
+ * or which are not needed any longer are terminated.
+ */
+static void pam_p11_child_put(struct pam_p11_child *child, bool reusable)
+{
+    struct pam_p11_child *c;
+    int num_idle = 0;
+
+    DLIST_FOR_EACH(c, child->pctx->p11_children) {
+        num_idle++;
+    }
+
+    if (!reusable || child->exited || num_idle >= P11_CHILD_MAX_IDLE) {
+        talloc_free(child);
+        return;
+    }
+
+    child->idle = true;
+    DLIST_ADD(child->pctx->p11_children, child);
+}
+
+/* Read a length-prefixed response from the p11_child */
+
+struct p11_child_read_state {
+    int fd;
+    uint8_t hdr[sizeof(uint32_t)];
+    uint8_t *buf;
+    size_t size;
+    size_t nread;
+};
+
+static void p11_child_read_handler(struct tevent_context *ev,
+                                   struct tevent_fd *fde,
+                                   uint16_t flags, void *pvt);
+
+static struct tevent_req *p11_child_read_send(TALLOC_CTX *mem_ctx,
+                                              struct tevent_context *ev,
+                                              int fd)
+{
+    struct tevent_req *req;
+    struct p11_child_read_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state, struct p11_child_read_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->fd = fd;
+    state->buf = NULL;
+    state->size = 0;
+    state->nread = 0;
+
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        p11_child_read_handler, req);
+    if (fde == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_fd failed.\n");
+        talloc_zfree(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+static void p11_child_read_handler(struct tevent_context *ev,
+                                   struct tevent_fd *fde,
+                                   uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct p11_child_read_state *state =
+            tevent_req_data(req, struct p11_child_read_state);
+    uint32_t len;
+    uint8_t *dst;
+    size_t size;
+    ssize_t nread;
+    errno_t ret;
+
+    /* The header is read first, then the announced amount of data. */
+    if (state->buf == NULL) {
+        dst = state->hdr + state->nread;
+        size = sizeof(state->hdr) - state->nread;
+    } else {
+        dst = state->buf + state->nread;
+        size = state->size - state->nread;
+    }
+
+    errno = 0;
+    nread = read(state->fd, dst, size);
+    if (nread == -1) {
+        ret = errno;
+        if (ret == EAGAIN || ret == EINTR) {
+            return;
         }
 
-        if (pd->cmd == SSS_PAM_AUTHENTICATE) {
-            ret = get_p11_child_write_buffer(state, pd, &write_buf,
-                                             &write_buf_len);
-            if (ret != EOK) {
-                DEBUG(SSSDBG_OP_FAILURE,
-                      "get_p11_child_write_buffer failed.\n");
-                goto done;
-            }
+        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+              ret, strerror(ret));
+        tevent_req_error(req, ret);
+        return;
+    } else if (nread == 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "p11_child closed the pipe.\n");
+        tevent_req_error(req, EPIPE);
+        return;
+    }
+
+    state->nread += nread;
+
+    if (state->buf == NULL) {
+        if (state->nread < sizeof(state->hdr)) {
+            return;
         }
 
-        if (write_buf_len != 0) {
-            subreq = write_pipe_send(state, ev, write_buf, write_buf_len,
-                                     state->io->write_to_child_fd);
-            if (subreq == NULL) {
-                DEBUG(SSSDBG_OP_FAILURE, "write_pipe_send failed.\n");
-                ret = ERR_P11_CHILD;
-                goto done;
-            }
-            tevent_req_set_callback(subreq, p11_child_write_done, req);
-        } else {
-            subreq = read_pipe_send(state, ev, state->io->read_from_child_fd);
-            if (subreq == NULL) {
-                DEBUG(SSSDBG_OP_FAILURE, "read_pipe_send failed.\n");
-                ret = ERR_P11_CHILD;
-                goto done;
-            }
-            tevent_req_set_callback(subreq, p11_child_done, req);
+        SAFEALIGN_COPY_UINT32(&len, state->hdr, NULL);
+        if (len < sizeof(uint32_t) || len > P11_CHILD_MAX_RESPONSE_SIZE) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Invalid response length [%"PRIu32"].\n", len);
+            tevent_req_error(req, EINVAL);
+            return;
         }
 
-        /* Now either wait for the timeout to fire or the child
-         * to finish
-         */
-    } else { /* error */
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE, "fork failed [%d][%s].\n",
-                                   ret, sss_strerror(ret));
+        state->buf = talloc_size(state, len);
+        if (state->buf == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+        state->size = len;
+        state->nread = 0;
+        return;
+    }
+
+    if (state->nread == state->size) {
+        tevent_req_done(req);
+    }
+}
+
+static errno_t p11_child_read_recv(struct tevent_req *req,
+                                   TALLOC_CTX *mem_ctx,
+                                   uint8_t **_buf,
+                                   size_t *_len)
+{
+    struct p11_child_read_state *state =
+            tevent_req_data(req, struct p11_child_read_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_buf = talloc_steal(mem_ctx, state->buf);
+    *_len = state->size;
+    return EOK;
+}
+
+/* == pam_check_cert_send/recv implementation ============================== */
+
+struct pam_check_cert_state {
+    struct tevent_context *ev;
+    struct pam_ctx *pctx;
+    const char *verify_opts;
+    struct tevent_timer *timeout_handler;
+
+    uint8_t *send_buf;
+    size_t send_len;
+    struct pam_p11_child *child;
+    struct tevent_req *io_req;
+    bool retried;
+
+    char *cert;
+    char *token_name;
+    char *module_name;
+    char *key_id;
+};
+
+static errno_t p11_child_send_request(struct tevent_req *req);
+static void p11_child_write_done(struct tevent_req *subreq);
+static void p11_child_done(struct tevent_req *subreq);
+static void p11_child_failed(struct tevent_req *req, errno_t ret);
+static void p11_child_timeout(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt);
+
+static int pam_check_cert_state_destructor(struct pam_check_cert_state *state)
+{
+    /* the request might contain the PIN */
+    if (state->send_buf != NULL) {
+        safezero(state->send_buf, state->send_len);
+    }
+
+    /* the request was interrupted, the state of the child is unknown */
+    if (state->child != NULL) {
+        talloc_zfree(state->io_req);
+        pam_p11_child_put(state->child, false);
+        state->child = NULL;
+    }
+
+    return 0;
+}
+
+static errno_t get_p11_child_request(TALLOC_CTX *mem_ctx,
+                                     struct pam_data *pd,
+                                     uint8_t **_buf, size_t *_len)
+{
+    uint8_t *pin_buf = NULL;
+    size_t pin_len = 0;
+    uint32_t op;
+    uint32_t pin_mode;
+    uint8_t *buf;
+    size_t len;
+    size_t rp = 0;
+    errno_t ret;
+
+    if (pd->cmd == SSS_PAM_AUTHENTICATE) {
+        op = P11_CHILD_OP_AUTH;
+        switch (sss_authtok_get_type(pd->authtok)) {
+        case SSS_AUTHTOK_TYPE_SC_PIN:
+            pin_mode = P11_CHILD_PIN_VALUE;
+            break;
+        case SSS_AUTHTOK_TYPE_SC_KEYPAD:
+            pin_mode = P11_CHILD_PIN_KEYPAD;
+            break;
+        default:
+            DEBUG(SSSDBG_OP_FAILURE, "Unsupported authtok type.\n");
+            return EINVAL;
+        }
+
+        ret = get_p11_child_write_buffer(mem_ctx, pd, &pin_buf, &pin_len);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "get_p11_child_write_buffer failed.\n");
+            return ret;
+        }
+    } else if (pd->cmd == SSS_PAM_PREAUTH) {
+        op = P11_CHILD_OP_PREAUTH;
+        pin_mode = P11_CHILD_PIN_NONE;
+    } else {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unexpected PAM command [%d].\n", pd->cmd);
+        return EINVAL;
+    }
+
+    len = 3 * sizeof(uint32_t) + pin_len;
+    if (len - sizeof(uint32_t) > P11_CHILD_MAX_REQUEST_SIZE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "PIN is too long.\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    buf = talloc_size(mem_ctx, len);
+    if (buf == NULL) {
+        ret = ENOMEM;
         goto done;
     }
 
+    SAFEALIGN_SET_UINT32(buf + rp, len - sizeof(uint32_t), &rp);
+    SAFEALIGN_SET_UINT32(buf + rp, op, &rp);
+    SAFEALIGN_SET_UINT32(buf + rp, pin_mode, &rp);
+    if (pin_len != 0) {
+        safealign_memcpy(buf + rp, pin_buf, pin_len, &rp);
+    }
+
+    *_buf = buf;
+    *_len = len;
     ret = EOK;
 
+done:
+    if (pin_buf != NULL) {
+        safezero(pin_buf, pin_len);
+        talloc_free(pin_buf);
+    }
+
+    return ret;
+}
+
+struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
+                                       struct tevent_context *ev,
+                                       struct pam_ctx *pctx,
+                                       time_t timeout,
+                                       const char *verify_opts,
+                                       struct pam_data *pd)
+{
+    errno_t ret;
+    struct tevent_req *req;
+    struct pam_check_cert_state *state;
+    struct timeval tv;
+
+    req = tevent_req_create(mem_ctx, &state, struct pam_check_cert_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->pctx = pctx;
+    state->verify_opts = verify_opts;
+    state->cert = NULL;
+    state->token_name = NULL;
+    state->module_name = NULL;
+    state->key_id = NULL;
+    talloc_set_destructor(state, pam_check_cert_state_destructor);
+
+    ret = get_p11_child_request(state, pd, &state->send_buf,
+                                &state->send_len);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* Set up timeout handler */
+    tv = tevent_timeval_current_ofs(timeout, 0);
+    state->timeout_handler = tevent_add_timer(ev, state, tv,
+                                              p11_child_timeout, req);
+    if (state->timeout_handler == NULL) {
+        ret = ERR_P11_CHILD;
+        goto done;
+    }
+
+    ret = p11_child_send_request(req);
+
 done:
     if (ret != EOK) {
-        PIPE_CLOSE(pipefd_from_child);
-        PIPE_CLOSE(pipefd_to_child);
         tevent_req_error(req, ret);
         tevent_req_post(req, ev);
     }
     return req;
 }
 
+static errno_t p11_child_send_request(struct tevent_req *req)
+{
+    struct pam_check_cert_state *state;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct pam_check_cert_state);
+
+    ret = pam_p11_child_get(state->ev, state->pctx, state->verify_opts,
+                            &state->child);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to start p11_child.\n");
+        return ret;
+    }
+    state->child->num_requests++;
+
+    state->io_req = write_pipe_send(state, state->ev, state->send_buf,
+                                    state->send_len,
+                                    state->child->io->write_to_child_fd);
+    if (state->io_req == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "write_pipe_send failed.\n");
+        return ENOMEM;
+    }
+    tevent_req_set_callback(state->io_req, p11_child_write_done, req);
+
+    return EOK;
+}
+
 static void p11_child_write_done(struct tevent_req *subreq)
 {
     struct tevent_req *req = tevent_req_callback_data(subreq,
@@ -478,45 +823,93 @@ static void p11_child_write_done(struct tevent_req *subreq)
 
     ret = write_pipe_recv(subreq);
     talloc_zfree(subreq);
+    state->io_req = NULL;
     if (ret != EOK) {
-        tevent_req_error(req, ret);
+        p11_child_failed(req, ret);
         return;
     }
 
-    PIPE_FD_CLOSE(state->io->write_to_child_fd);
-
-    subreq = read_pipe_send(state, state->ev, state->io->read_from_child_fd);
-    if (subreq == NULL) {
-        tevent_req_error(req, ENOMEM);
+    state->io_req = p11_child_read_send(state, state->ev,
+                                        state->child->io->read_from_child_fd);
+    if (state->io_req == NULL) {
+        p11_child_failed(req, ENOMEM);
         return;
     }
-    tevent_req_set_callback(subreq, p11_child_done, req);
+    tevent_req_set_callback(state->io_req, p11_child_done, req);
+}
+
+/*
+ * A child which was already used before might have exited because it was
+ * idle for too long, in this case the request is sent once more to a new
+ * child.
+ */
+static void p11_child_failed(struct tevent_req *req, errno_t ret)
+{
+    struct pam_check_cert_state *state;
+    bool reused;
+    errno_t sret;
+
+    state = tevent_req_data(req, struct pam_check_cert_state);
+
+    reused = state->child->num_requests > 1;
+    pam_p11_child_put(state->child, false);
+    state->child = NULL;
+
+    if (reused && !state->retried && ret != ENOMEM) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Communication with p11_child failed [%d][%s], retrying.\n",
+              ret, sss_strerror(ret));
+        state->retried = true;
+
+        sret = p11_child_send_request(req);
+        if (sret == EOK) {
+            return;
+        }
+        ret = sret;
+    }
+
+    tevent_req_error(req, ret);
 }
 
 static void p11_child_done(struct tevent_req *subreq)
 {
     uint8_t *buf;
-    ssize_t buf_len;
+    size_t buf_len;
+    uint32_t result;
+    size_t rp = 0;
     struct tevent_req *req = tevent_req_callback_data(subreq,
                                                       struct tevent_req);
     struct pam_check_cert_state *state = tevent_req_data(req,
                                                    struct pam_check_cert_state);
     int ret;
 
-    talloc_zfree(state->timeout_handler);
-
-    ret = read_pipe_recv(subreq, state, &buf, &buf_len);
+    ret = p11_child_read_recv(subreq, state, &buf, &buf_len);
     talloc_zfree(subreq);
+    state->io_req = NULL;
     if (ret != EOK) {
-        tevent_req_error(req, ret);
+        p11_child_failed(req, ret);
         return;
     }
 
-    PIPE_FD_CLOSE(state->io->read_from_child_fd);
+    talloc_zfree(state->timeout_handler);
+
+    /* the child is ready for the next request */
+    pam_p11_child_put(state->child, true);
+    state->child = NULL;
+
+    SAFEALIGN_COPY_UINT32(&result, buf, &rp);
+    if (result != EOK) {
+        /* Like a failing one-shot p11_child, which does not return a
+         * certificate. */
+        DEBUG(SSSDBG_OP_FAILURE, "p11_child failed [%"PRIu32"][%s].\n",
+              result, sss_strerror(result));
+        tevent_req_done(req);
+        return;
+    }
 
-    ret = parse_p11_child_response(state, buf, buf_len, &state->cert,
-                                   &state->token_name, &state->module_name,
-                                   &state->key_id);
+    ret = parse_p11_child_response(state, buf + rp, buf_len - rp,
+                                   &state->cert, &state->token_name,
+                                   &state->module_name, &state->key_id);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "parse_p11_child_respose failed.\n");
         tevent_req_error(req, ret);
@@ -536,9 +929,14 @@ static void p11_child_timeout(struct tevent_context *ev,
                               tevent_req_data(req, struct pam_check_cert_state);
 
     DEBUG(SSSDBG_CRIT_FAILURE, "Timeout reached for p11_child.\n");
-    child_handler_destroy(state->child_ctx);
-    state->child_ctx = NULL;
-    state->child_status = ETIMEDOUT;
+    state->timeout_handler = NULL;
+
+    talloc_zfree(state->io_req);
+    if (state->child != NULL) {
+        pam_p11_child_put(state->child, false);
+        state->child = NULL;
+    }
+
     tevent_req_error(req, ERR_P11_CHILD);
 }
 
@@ -417,10 +417,15 @@ static int sec_on_message_complete(http_parser *parser)
     }
 
     req->method = parser->method;
+    req->keep_alive = http_should_keep_alive(parser);
 
     req->complete = true;
     DEBUG(SSSDBG_TRACE_INTERNAL, "parsing complete\n");
 
+    /* Stop parsing here, any following data belongs to the next
+     * pipelined request and will be processed once we replied */
+    http_parser_pause(parser, 1);
+
     return 0;
 }
 
@@ -456,11 +461,16 @@ int sec_send_data(int fd, struct sec_data *data)
     return EOK;
 }
 
+static void sec_recv_pending(struct cli_ctx *cctx);
+
 static void sec_send(struct cli_ctx *cctx)
 {
+    struct sec_proto_ctx *prctx;
     struct sec_req_ctx *req;
+    bool keep_alive;
     int ret;
 
+    prctx = talloc_get_type(cctx->protocol_ctx, struct sec_proto_ctx);
     req = talloc_get_type(cctx->state_ctx, struct sec_req_ctx);
 
     ret = sec_send_data(cctx->cfd, &req->reply);
@@ -475,9 +485,21 @@ static void sec_send(struct cli_ctx *cctx)
     }
 
     /* ok all sent */
+    keep_alive = req->keep_alive;
     TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
-    TEVENT_FD_READABLE(cctx->cfde);
     talloc_zfree(cctx->state_ctx);
+
+    if (!keep_alive) {
+        DEBUG(SSSDBG_TRACE_ALL, "Connection is not persistent, closing\n");
+        talloc_free(cctx);
+        return;
+    }
+
+    TEVENT_FD_READABLE(cctx->cfde);
+
+    if (prctx->pending.length > 0) {
+        sec_recv_pending(cctx);
+    }
     return;
 }
 
@@ -509,6 +531,106 @@ int sec_recv_data(int fd, struct sec_data *data)
     return EOK;
 }
 
+static struct sec_req_ctx *sec_req_new(struct cli_ctx *cctx,
+                                       struct sec_proto_ctx *prctx)
+{
+    struct sec_req_ctx *req;
+
+    req = talloc_zero(cctx, struct sec_req_ctx);
+    if (!req) {
+        return NULL;
+    }
+    req->cctx = cctx;
+    cctx->state_ctx = req;
+    http_parser_init(&prctx->parser, HTTP_REQUEST);
+    prctx->parser.data = req;
+
+    return req;
+}
+
+static errno_t sec_set_pending(struct sec_proto_ctx *prctx,
+                               const char *data, size_t length)
+{
+    char *pending = NULL;
+
+    /* data may point into the current pending buffer, copy it first */
+    if (length > 0) {
+        pending = talloc_memdup(prctx, data, length);
+        if (!pending) {
+            return ENOMEM;
+        }
+    }
+
+    talloc_free(prctx->pending.data);
+    prctx->pending.data = pending;
+    prctx->pending.length = length;
+
+    return EOK;
+}
+
+static void sec_parse_data(struct cli_ctx *cctx,
+                           struct sec_proto_ctx *prctx,
+                           struct sec_req_ctx *req,
+                           const char *data, size_t length)
+{
+    size_t len;
+    int ret;
+
+    len = http_parser_execute(&prctx->parser, &prctx->callbacks,
+                              data, length);
+    if (HTTP_PARSER_ERRNO(&prctx->parser) == HPE_PAUSED) {
+        /* a complete request was parsed, keep what follows it */
+        http_parser_pause(&prctx->parser, 0);
+    } else if (len != length) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to parse request, aborting client!\n");
+        talloc_free(cctx);
+        return;
+    }
+
+    ret = sec_set_pending(prctx, data + len, length - len);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to store pipelined data, aborting client!\n");
+        talloc_free(cctx);
+        return;
+    }
+
+    if (!req->complete) {
+        return;
+    }
+
+    if (prctx->pending.length > 0) {
+        DEBUG(SSSDBG_TRACE_INTERNAL,
+              "%zu bytes of pipelined data pending\n", prctx->pending.length);
+    }
+
+    /* do not read anymore until we replied, pipelined requests are
+     * served in order */
+    TEVENT_FD_NOT_READABLE(cctx->cfde);
+
+    sec_cmd_execute(cctx);
+}
+
+static void sec_recv_pending(struct cli_ctx *cctx)
+{
+    struct sec_proto_ctx *prctx;
+    struct sec_req_ctx *req;
+
+    prctx = talloc_get_type(cctx->protocol_ctx, struct sec_proto_ctx);
+
+    req = sec_req_new(cctx, prctx);
+    if (!req) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              "Failed to setup request handlers, aborting client\n");
+        talloc_free(cctx);
+        return;
+    }
+
+    sec_parse_data(cctx, prctx, req,
+                   prctx->pending.data, prctx->pending.length);
+}
+
 static void sec_recv(struct cli_ctx *cctx)
 {
     struct sec_proto_ctx *prctx;
@@ -516,24 +638,19 @@ static void sec_recv(struct cli_ctx *cctx)
     char buffer[SEC_PACKET_MAX_RECV_SIZE];
     struct sec_data data = { buffer,
                              SEC_PACKET_MAX_RECV_SIZE };
-    size_t len;
     int ret;
 
     prctx = talloc_get_type(cctx->protocol_ctx, struct sec_proto_ctx);
     req = talloc_get_type(cctx->state_ctx, struct sec_req_ctx);
     if (!req) {
         /* A new request comes in, setup data structures */
-        req = talloc_zero(cctx, struct sec_req_ctx);
+        req = sec_req_new(cctx, prctx);
         if (!req) {
             DEBUG(SSSDBG_FATAL_FAILURE,
                   "Failed to setup request handlers, aborting client\n");
             talloc_free(cctx);
             return;
         }
-        req->cctx = cctx;
-        cctx->state_ctx = req;
-        http_parser_init(&prctx->parser, HTTP_REQUEST);
-        prctx->parser.data = req;
     }
 
     ret = sec_recv_data(cctx->cfd, &data);
@@ -558,23 +675,7 @@ static void sec_recv(struct cli_ctx *cctx)
         return;
     }
 
-    len = http_parser_execute(&prctx->parser, &prctx->callbacks,
-                              data.data, data.length);
-    if (len != data.length) {
-        DEBUG(SSSDBG_FATAL_FAILURE,
-              "Failed to parse request, aborting client!\n");
-        talloc_free(cctx);
-        return;
-    }
-
-    if (!req->complete) {
-        return;
-    }
-
-    /* do not read anymore, client is done sending */
-    TEVENT_FD_NOT_READABLE(cctx->cfde);
-
-    sec_cmd_execute(cctx);
+    sec_parse_data(cctx, prctx, req, data.data, data.length);
 }
 
 static void sec_fd_handler(struct tevent_context *ev,
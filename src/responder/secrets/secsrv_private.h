@@ -56,6 +56,10 @@ enum sec_http_status_codes {
 struct sec_proto_ctx {
     http_parser_settings callbacks;
     http_parser parser;
+
+    /* data received after the end of the request being processed,
+     * this is the beginning of the next pipelined request */
+    struct sec_data pending;
 };
 
 struct sec_url {
@@ -73,6 +77,7 @@ struct sec_req_ctx {
     const char *base_path;
     const char *cfg_section;
     bool complete;
+    bool keep_alive;
 
     size_t total_size;
 
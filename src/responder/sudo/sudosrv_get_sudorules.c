@@ -32,87 +32,6 @@
 #include "responder/sudo/sudosrv_private.h"
 #include "providers/data_provider.h"
 
-static int
-sudo_order_cmp(const void *a, const void *b, bool lower_wins)
-{
-    struct sysdb_attrs *r1, *r2;
-    uint32_t o1, o2;
-    int ret;
-
-    r1 = * (struct sysdb_attrs * const *) a;
-    r2 = * (struct sysdb_attrs * const *) b;
-    if (!r1 || !r2) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Wrong data?\n");
-        return 0;
-    }
-
-    ret = sysdb_attrs_get_uint32_t(r1, SYSDB_SUDO_CACHE_AT_ORDER, &o1);
-    if (ret == ENOENT) {
-        /* man sudoers-ldap: If the sudoOrder attribute is not present,
-         * a value of 0 is assumed */
-        o1 = 0;
-    } else if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Cannot get sudoOrder value\n");
-        return 0;
-    }
-
-    ret = sysdb_attrs_get_uint32_t(r2, SYSDB_SUDO_CACHE_AT_ORDER, &o2);
-    if (ret == ENOENT) {
-        /* man sudoers-ldap: If the sudoOrder attribute is not present,
-         * a value of 0 is assumed */
-        o2 = 0;
-    } else if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Cannot get sudoOrder value\n");
-        return 0;
-    }
-
-    if (lower_wins) {
-        /* The lowest value takes priority. Original wrong SSSD behaviour. */
-        if (o1 > o2) {
-            return 1;
-        } else if (o1 < o2) {
-            return -1;
-        }
-    } else {
-        /* The higher value takes priority. Standard LDAP behaviour. */
-        if (o1 < o2) {
-            return 1;
-        } else if (o1 > o2) {
-            return -1;
-        }
-    }
-
-    return 0;
-}
-
-static int
-sudo_order_low_cmp_fn(const void *a, const void *b)
-{
-    return sudo_order_cmp(a, b, true);
-}
-
-static int
-sudo_order_high_cmp_fn(const void *a, const void *b)
-{
-    return sudo_order_cmp(a, b, false);
-}
-
-static errno_t
-sort_sudo_rules(struct sysdb_attrs **rules, size_t count, bool lower_wins)
-{
-    if (lower_wins) {
-        DEBUG(SSSDBG_TRACE_FUNC, "Sorting rules with lower-wins logic\n");
-        qsort(rules, count, sizeof(struct sysdb_attrs *),
-              sudo_order_low_cmp_fn);
-    } else {
-        DEBUG(SSSDBG_TRACE_FUNC, "Sorting rules with higher-wins logic\n");
-        qsort(rules, count, sizeof(struct sysdb_attrs *),
-              sudo_order_high_cmp_fn);
-    }
-
-    return EOK;
-}
-
 static errno_t sudosrv_query_cache(TALLOC_CTX *mem_ctx,
                                    struct sss_domain_info *domain,
                                    const char **attrs,
@@ -167,213 +86,6 @@ done:
     return ret;
 }
 
-static errno_t sudosrv_expired_rules(TALLOC_CTX *mem_ctx,
-                                     struct sss_domain_info *domain,
-                                     uid_t uid,
-                                     const char *username,
-                                     char **groups,
-                                     struct sysdb_attrs ***_rules,
-                                     uint32_t *_num_rules)
-{
-    const char *attrs[] = { SYSDB_NAME, NULL };
-    char *filter;
-    errno_t ret;
-
-    filter = sysdb_sudo_filter_expired(NULL, username, groups, uid);
-    if (filter == NULL) {
-        return ENOMEM;
-    }
-
-    ret = sudosrv_query_cache(mem_ctx, domain, attrs, filter,
-                              _rules, _num_rules);
-    talloc_free(filter);
-
-    return ret;
-}
-
-static errno_t sudosrv_cached_rules_by_user(TALLOC_CTX *mem_ctx,
-                                            struct sss_domain_info *domain,
-                                            uid_t uid,
-                                            const char *username,
-                                            char **groupnames,
-                                            struct sysdb_attrs ***_rules,
-                                            uint32_t *_num_rules)
-{
-    TALLOC_CTX *tmp_ctx;
-    struct sysdb_attrs **rules;
-    uint32_t num_rules;
-    uint32_t i;
-    const char *filter;
-    const char *val;
-    errno_t ret;
-    const char *attrs[] = { SYSDB_OBJECTCLASS,
-                            SYSDB_SUDO_CACHE_AT_CN,
-                            SYSDB_SUDO_CACHE_AT_HOST,
-                            SYSDB_SUDO_CACHE_AT_COMMAND,
-                            SYSDB_SUDO_CACHE_AT_OPTION,
-                            SYSDB_SUDO_CACHE_AT_RUNAS,
-                            SYSDB_SUDO_CACHE_AT_RUNASUSER,
-                            SYSDB_SUDO_CACHE_AT_RUNASGROUP,
-                            SYSDB_SUDO_CACHE_AT_NOTBEFORE,
-                            SYSDB_SUDO_CACHE_AT_NOTAFTER,
-                            SYSDB_SUDO_CACHE_AT_ORDER,
-                            NULL };
-
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
-        return ENOMEM;
-    }
-
-    filter = sysdb_sudo_filter_user(tmp_ctx, username, groupnames, uid);
-    if (filter == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    ret = sudosrv_query_cache(tmp_ctx, domain, attrs, filter,
-                              &rules, &num_rules);
-    if (ret != EOK) {
-        goto done;
-    }
-
-    val = talloc_asprintf(tmp_ctx, "#%"SPRIuid, uid);
-    if (val == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    /* Add sudoUser: #uid to prevent conflicts with fqnames. */
-    DEBUG(SSSDBG_TRACE_FUNC, "Replacing sudoUser attribute with "
-          "sudoUser: %s\n", val);
-    for (i = 0; i < num_rules; i++) {
-        ret = sysdb_attrs_add_string(rules[i], SYSDB_SUDO_CACHE_AT_USER, val);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to alter sudoUser attribute "
-                  "[%d]: %s\n", ret, sss_strerror(ret));
-        }
-    }
-
-    *_rules = talloc_steal(mem_ctx, rules);
-    *_num_rules = num_rules;
-
-    ret = EOK;
-
-done:
-    talloc_free(tmp_ctx);
-    return ret;
-}
-
-static errno_t sudosrv_cached_rules_by_ng(TALLOC_CTX *mem_ctx,
-                                          struct sss_domain_info *domain,
-                                          uid_t uid,
-                                          const char *username,
-                                          char **groupnames,
-                                          struct sysdb_attrs ***_rules,
-                                          uint32_t *_num_rules)
-{
-    char *filter;
-    errno_t ret;
-    const char *attrs[] = { SYSDB_OBJECTCLASS,
-                            SYSDB_SUDO_CACHE_AT_CN,
-                            SYSDB_SUDO_CACHE_AT_USER,
-                            SYSDB_SUDO_CACHE_AT_HOST,
-                            SYSDB_SUDO_CACHE_AT_COMMAND,
-                            SYSDB_SUDO_CACHE_AT_OPTION,
-                            SYSDB_SUDO_CACHE_AT_RUNAS,
-                            SYSDB_SUDO_CACHE_AT_RUNASUSER,
-                            SYSDB_SUDO_CACHE_AT_RUNASGROUP,
-                            SYSDB_SUDO_CACHE_AT_NOTBEFORE,
-                            SYSDB_SUDO_CACHE_AT_NOTAFTER,
-                            SYSDB_SUDO_CACHE_AT_ORDER,
-                            NULL };
-
-    filter = sysdb_sudo_filter_netgroups(NULL, username, groupnames, uid);
-    if (filter == NULL) {
-        return ENOMEM;
-    }
-
-    ret = sudosrv_query_cache(mem_ctx, domain, attrs, filter,
-                              _rules, _num_rules);
-    talloc_free(filter);
-
-    return ret;
-}
-
-static errno_t sudosrv_cached_rules(TALLOC_CTX *mem_ctx,
-                                    struct sss_domain_info *domain,
-                                    uid_t uid,
-                                    const char *username,
-                                    char **groups,
-                                    bool inverse_order,
-                                    struct sysdb_attrs ***_rules,
-                                    uint32_t *_num_rules)
-{
-    TALLOC_CTX *tmp_ctx;
-    struct sysdb_attrs **user_rules;
-    struct sysdb_attrs **ng_rules;
-    struct sysdb_attrs **rules;
-    uint32_t num_user_rules;
-    uint32_t num_ng_rules;
-    uint32_t num_rules;
-    uint32_t rule_iter, i;
-    errno_t ret;
-
-    tmp_ctx = talloc_new(NULL);
-    if (tmp_ctx == NULL) {
-        return ENOMEM;
-    }
-
-    ret = sudosrv_cached_rules_by_user(tmp_ctx, domain, uid, username, groups,
-                                       &user_rules, &num_user_rules);
-    if (ret != EOK) {
-        goto done;
-    }
-
-    ret = sudosrv_cached_rules_by_ng(tmp_ctx, domain, uid, username, groups,
-                                     &ng_rules, &num_ng_rules);
-    if (ret != EOK) {
-        goto done;
-    }
-
-    num_rules = num_user_rules + num_ng_rules;
-    if (num_rules == 0) {
-        *_rules = NULL;
-        *_num_rules = 0;
-        ret = EOK;
-        goto done;
-    }
-
-    rules = talloc_array(tmp_ctx, struct sysdb_attrs *, num_rules);
-    if (rules == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    rule_iter = 0;
-    for (i = 0; i < num_user_rules; rule_iter++, i++) {
-        rules[rule_iter] = talloc_steal(rules, user_rules[i]);
-    }
-
-    for (i = 0; i < num_ng_rules; rule_iter++, i++) {
-        rules[rule_iter] = talloc_steal(rules, ng_rules[i]);
-    }
-
-    ret = sort_sudo_rules(rules, num_rules, inverse_order);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Could not sort rules by sudoOrder\n");
-        goto done;
-    }
-
-    *_rules = talloc_steal(mem_ctx, rules);
-    *_num_rules = num_rules;
-
-    ret = EOK;
-
-done:
-    talloc_free(tmp_ctx);
-    return ret;
-}
-
 static errno_t sudosrv_cached_defaults(TALLOC_CTX *mem_ctx,
                                        struct sss_domain_info *domain,
                                        struct sysdb_attrs ***_rules,
@@ -408,12 +120,12 @@ static errno_t sudosrv_cached_defaults(TALLOC_CTX *mem_ctx,
 }
 
 static errno_t sudosrv_fetch_rules(TALLOC_CTX *mem_ctx,
+                                   struct sudo_ctx *sudo_ctx,
                                    enum sss_sudo_type type,
                                    struct sss_domain_info *domain,
                                    uid_t uid,
                                    const char *username,
                                    char **groups,
-                                   bool inverse_order,
                                    struct sysdb_attrs ***_rules,
                                    uint32_t *_num_rules)
 {
@@ -428,8 +140,8 @@ static errno_t sudosrv_fetch_rules(TALLOC_CTX *mem_ctx,
               username, domain->name);
         debug_name = "rules";
 
-        ret = sudosrv_cached_rules(mem_ctx, domain, uid, username, groups,
-                                   inverse_order, &rules, &num_rules);
+        ret = sudosrv_index_user_rules(mem_ctx, sudo_ctx, domain, uid,
+                                       username, groups, &rules, &num_rules);
 
         break;
     case SSS_SUDO_DEFAULTS:
@@ -477,7 +189,7 @@ static void sudosrv_refresh_rules_done(struct tevent_req *subreq);
 static struct tevent_req *
 sudosrv_refresh_rules_send(TALLOC_CTX *mem_ctx,
                            struct tevent_context *ev,
-                           struct resp_ctx *rctx,
+                           struct sudo_ctx *sudo_ctx,
                            struct sss_domain_info *domain,
                            uid_t uid,
                            const char *username,
@@ -497,12 +209,12 @@ sudosrv_refresh_rules_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    state->rctx = rctx;
+    state->rctx = sudo_ctx->rctx;
     state->domain = domain;
     state->username = username;
 
-    ret = sudosrv_expired_rules(state, domain, uid, username, groups,
-                                &rules, &num_rules);
+    ret = sudosrv_index_expired_rules(state, sudo_ctx, domain, uid, username,
+                                      groups, &rules, &num_rules);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Unable to retrieve expired sudo rules [%d]: %s\n",
@@ -520,7 +232,7 @@ sudosrv_refresh_rules_send(TALLOC_CTX *mem_ctx,
     DEBUG(SSSDBG_TRACE_INTERNAL, "Refreshing %d expired rules of [%s@%s]\n",
           num_rules, username, domain->name);
 
-    subreq = sss_dp_get_sudoers_send(state, rctx, domain, false,
+    subreq = sss_dp_get_sudoers_send(state, state->rctx, domain, false,
                                      SSS_DP_SUDO_REFRESH_RULES,
                                      username, num_rules, rules);
     if (subreq == NULL) {
@@ -602,13 +314,12 @@ static errno_t sudosrv_refresh_rules_recv(struct tevent_req *req)
 
 struct sudosrv_get_rules_state {
     struct tevent_context *ev;
-    struct resp_ctx *rctx;
+    struct sudo_ctx *sudo_ctx;
     enum sss_sudo_type type;
     uid_t uid;
     const char *username;
     struct sss_domain_info *domain;
     char **groups;
-    bool inverse_order;
 
     struct sysdb_attrs **rules;
     uint32_t num_rules;
@@ -636,10 +347,9 @@ struct tevent_req *sudosrv_get_rules_send(TALLOC_CTX *mem_ctx,
     }
 
     state->ev = ev;
-    state->rctx = sudo_ctx->rctx;
+    state->sudo_ctx = sudo_ctx;
     state->type = type;
     state->uid = uid;
-    state->inverse_order = sudo_ctx->inverse_order;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Running initgroups for [%s]\n", username);
 
@@ -695,7 +405,7 @@ static void sudosrv_get_rules_initgr_done(struct tevent_req *subreq)
         goto done;
     }
 
-    subreq = sudosrv_refresh_rules_send(state, state->ev, state->rctx,
+    subreq = sudosrv_refresh_rules_send(state, state->ev, state->sudo_ctx,
                                         state->domain, state->uid,
                                         state->username, state->groups);
     if (subreq == NULL) {
@@ -733,9 +443,9 @@ static void sudosrv_get_rules_done(struct tevent_req *subreq)
               "in cache.\n");
     }
 
-    ret = sudosrv_fetch_rules(state, state->type, state->domain, state->uid,
+    ret = sudosrv_fetch_rules(state, state->sudo_ctx, state->type,
+                              state->domain, state->uid,
                               state->username, state->groups,
-                              state->inverse_order,
                               &state->rules, &state->num_rules);
 
     if (ret != EOK) {
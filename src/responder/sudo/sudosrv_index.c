@@ -0,0 +1,1119 @@
+/*
+    SUDO responder: in-memory index of cached sudo rules
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <talloc.h>
+#include <dhash.h>
+
+#include "util/util.h"
+#include "db/sysdb_sudo.h"
+#include "responder/sudo/sudosrv_private.h"
+
+/*
+ * The index keeps all sudo rules of a domain in memory, ordered by
+ * sudoOrder, together with a hash table that maps every sudoUser value
+ * (user name, #uid, %group, ALL) to the positions of the rules that
+ * contain it. A lookup therefore only marks the matching positions and
+ * walks them in order, without any ldb search or sort.
+ *
+ * The index is validated against the sequence number of the cache file
+ * that stores the sudo rules, which is increased by every write. When the
+ * rules are kept in a separate cache file, writes of other objects do not
+ * invalidate the index. When it changes, only the names, content hashes
+ * and expiration timestamps of the rules are read; rules whose content
+ * hash did not change since the last build are reused and only new or
+ * modified rules are fetched from the cache.
+ */
+
+/* Maximum number of rules fetched by a single OR-filter */
+#define SUDOSRV_INDEX_FETCH_CHUNK 100
+
+#define SUDOSRV_INDEX_USER_MATCH 1
+#define SUDOSRV_INDEX_NETGROUP_MATCH 2
+
+/* Attributes returned for rules matched by user, group or uid. The sudoUser
+ * attribute is replaced by #uid in the reply. */
+static const char *sudosrv_user_attrs[] = { SYSDB_OBJECTCLASS,
+                                            SYSDB_SUDO_CACHE_AT_CN,
+                                            SYSDB_SUDO_CACHE_AT_HOST,
+                                            SYSDB_SUDO_CACHE_AT_COMMAND,
+                                            SYSDB_SUDO_CACHE_AT_OPTION,
+                                            SYSDB_SUDO_CACHE_AT_RUNAS,
+                                            SYSDB_SUDO_CACHE_AT_RUNASUSER,
+                                            SYSDB_SUDO_CACHE_AT_RUNASGROUP,
+                                            SYSDB_SUDO_CACHE_AT_NOTBEFORE,
+                                            SYSDB_SUDO_CACHE_AT_NOTAFTER,
+                                            SYSDB_SUDO_CACHE_AT_ORDER,
+                                            NULL };
+
+/* Attributes returned for rules matched by netgroup */
+static const char *sudosrv_netgroup_attrs[] = { SYSDB_OBJECTCLASS,
+                                                SYSDB_SUDO_CACHE_AT_CN,
+                                                SYSDB_SUDO_CACHE_AT_USER,
+                                                SYSDB_SUDO_CACHE_AT_HOST,
+                                                SYSDB_SUDO_CACHE_AT_COMMAND,
+                                                SYSDB_SUDO_CACHE_AT_OPTION,
+                                                SYSDB_SUDO_CACHE_AT_RUNAS,
+                                                SYSDB_SUDO_CACHE_AT_RUNASUSER,
+                                                SYSDB_SUDO_CACHE_AT_RUNASGROUP,
+                                                SYSDB_SUDO_CACHE_AT_NOTBEFORE,
+                                                SYSDB_SUDO_CACHE_AT_NOTAFTER,
+                                                SYSDB_SUDO_CACHE_AT_ORDER,
+                                                NULL };
+
+/* Attributes kept in the index */
+static const char *sudosrv_index_attrs[] = { SYSDB_OBJECTCLASS,
+                                             SYSDB_NAME,
+                                             SYSDB_CACHE_EXPIRE,
+                                             SYSDB_SUDO_CACHE_AT_HASH,
+                                             SYSDB_SUDO_CACHE_AT_CN,
+                                             SYSDB_SUDO_CACHE_AT_USER,
+                                             SYSDB_SUDO_CACHE_AT_HOST,
+                                             SYSDB_SUDO_CACHE_AT_COMMAND,
+                                             SYSDB_SUDO_CACHE_AT_OPTION,
+                                             SYSDB_SUDO_CACHE_AT_RUNAS,
+                                             SYSDB_SUDO_CACHE_AT_RUNASUSER,
+                                             SYSDB_SUDO_CACHE_AT_RUNASGROUP,
+                                             SYSDB_SUDO_CACHE_AT_NOTBEFORE,
+                                             SYSDB_SUDO_CACHE_AT_NOTAFTER,
+                                             SYSDB_SUDO_CACHE_AT_ORDER,
+                                             NULL };
+
+struct sudosrv_index_rule {
+    const char *name;
+    time_t expire;
+    /* rules stored by older versions have no hash */
+    bool has_hash;
+    uint32_t hash;
+    uint32_t order;
+    bool netgroup;
+    struct sysdb_attrs *attrs;
+};
+
+struct sudosrv_index_posting {
+    uint32_t *pos;
+    size_t count;
+};
+
+/* Everything that is rebuilt when the cache changes */
+struct sudosrv_index_data {
+    struct sudosrv_index_rule **rules;   /* ordered by sudoOrder */
+    size_t num_rules;
+
+    hash_table_t *by_name;               /* name -> rule */
+    hash_table_t *by_user;               /* sudoUser value -> posting */
+
+    uint32_t *netgroups;                 /* positions of +netgroup rules */
+    size_t num_netgroups;
+
+    /* position of the defaults entry or -1 */
+    int64_t defaults;
+};
+
+struct sudosrv_index {
+    struct sudosrv_index *prev;
+    struct sudosrv_index *next;
+
+    const char *domain;
+    bool valid;
+    uint64_t seq;
+
+    struct sudosrv_index_data *data;
+};
+
+static int
+sudosrv_index_rule_cmp(const void *a, const void *b, bool lower_wins)
+{
+    const struct sudosrv_index_rule *r1;
+    const struct sudosrv_index_rule *r2;
+
+    r1 = * (struct sudosrv_index_rule * const *) a;
+    r2 = * (struct sudosrv_index_rule * const *) b;
+
+    if (r1->order != r2->order) {
+        if (lower_wins) {
+            /* The lowest value takes priority. Original wrong SSSD
+             * behaviour. */
+            return r1->order > r2->order ? 1 : -1;
+        }
+
+        /* The higher value takes priority. Standard LDAP behaviour. */
+        return r1->order < r2->order ? 1 : -1;
+    }
+
+    /* Make the order deterministic among rules with the same sudoOrder */
+    return strcmp(r1->name, r2->name);
+}
+
+static int sudosrv_index_rule_low_cmp_fn(const void *a, const void *b)
+{
+    return sudosrv_index_rule_cmp(a, b, true);
+}
+
+static int sudosrv_index_rule_high_cmp_fn(const void *a, const void *b)
+{
+    return sudosrv_index_rule_cmp(a, b, false);
+}
+
+static errno_t
+sudosrv_index_rule_from_attrs(TALLOC_CTX *mem_ctx,
+                              struct sysdb_attrs *attrs,
+                              struct sudosrv_index_rule **_rule)
+{
+    struct sudosrv_index_rule *rule;
+    struct ldb_message_element *el;
+    unsigned int i;
+    errno_t ret;
+
+    rule = talloc_zero(mem_ctx, struct sudosrv_index_rule);
+    if (rule == NULL) {
+        return ENOMEM;
+    }
+
+    rule->attrs = talloc_steal(rule, attrs);
+
+    ret = sysdb_attrs_get_string(attrs, SYSDB_NAME, &rule->name);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Skipping a sudo rule without name\n");
+        goto done;
+    }
+
+    ret = sysdb_attrs_get_uint32_t(attrs, SYSDB_SUDO_CACHE_AT_ORDER,
+                                   &rule->order);
+    if (ret == ENOENT) {
+        /* man sudoers-ldap: If the sudoOrder attribute is not present,
+         * a value of 0 is assumed */
+        rule->order = 0;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot get sudoOrder value\n");
+        goto done;
+    }
+
+    ret = sysdb_attrs_get_time_t(attrs, SYSDB_CACHE_EXPIRE, &rule->expire);
+    if (ret == ENOENT) {
+        rule->expire = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_attrs_get_uint32_t(attrs, SYSDB_SUDO_CACHE_AT_HASH,
+                                   &rule->hash);
+    if (ret == EOK) {
+        rule->has_hash = true;
+    } else if (ret != ENOENT) {
+        goto done;
+    }
+
+    ret = sysdb_attrs_get_el_ext(attrs, SYSDB_SUDO_CACHE_AT_USER, false, &el);
+    if (ret == EOK) {
+        for (i = 0; i < el->num_values; i++) {
+            if (el->values[i].length > 0 && el->values[i].data[0] == '+') {
+                rule->netgroup = true;
+                break;
+            }
+        }
+    }
+
+    *_rule = rule;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(rule);
+    }
+    return ret;
+}
+
+static errno_t
+sudosrv_index_search(TALLOC_CTX *mem_ctx,
+                     struct sss_domain_info *domain,
+                     const char *filter,
+                     const char **attrs,
+                     struct sysdb_attrs ***_rules,
+                     size_t *_count)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_message **msgs;
+    struct sysdb_attrs **rules;
+    size_t count;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_search_custom(tmp_ctx, domain, filter, SUDORULE_SUBDIR,
+                              attrs, &count, &msgs);
+    if (ret == ENOENT) {
+        *_rules = NULL;
+        *_count = 0;
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Error looking up SUDO rules\n");
+        goto done;
+    }
+
+    ret = sysdb_msg2attrs(tmp_ctx, count, msgs, &rules);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Could not convert ldb message to sysdb_attrs\n");
+        goto done;
+    }
+
+    *_rules = talloc_steal(mem_ctx, rules);
+    *_count = count;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Fetches full rules by name, SUDOSRV_INDEX_FETCH_CHUNK rules at a time */
+static errno_t
+sudosrv_index_fetch(TALLOC_CTX *mem_ctx,
+                    struct sss_domain_info *domain,
+                    const char **names,
+                    size_t num_names,
+                    struct sudosrv_index_data *data)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sudosrv_index_rule *rule;
+    struct sysdb_attrs **rules;
+    char *sanitized;
+    char *filter;
+    size_t count;
+    size_t i, j;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_names; i += SUDOSRV_INDEX_FETCH_CHUNK) {
+        filter = talloc_asprintf(tmp_ctx, "(&(%s=%s)(|",
+                                 SYSDB_OBJECTCLASS, SYSDB_SUDO_CACHE_OC);
+        for (j = i; j < num_names && j < i + SUDOSRV_INDEX_FETCH_CHUNK; j++) {
+            if (filter == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            ret = sss_filter_sanitize(tmp_ctx, names[j], &sanitized);
+            if (ret != EOK) {
+                goto done;
+            }
+
+            filter = talloc_asprintf_append(filter, "(%s=%s)",
+                                            SYSDB_NAME, sanitized);
+            talloc_free(sanitized);
+        }
+
+        if (filter != NULL) {
+            filter = talloc_asprintf_append(filter, "))");
+        }
+        if (filter == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sudosrv_index_search(tmp_ctx, domain, filter,
+                                   sudosrv_index_attrs, &rules, &count);
+        talloc_free(filter);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        for (j = 0; j < count; j++) {
+            if (data->num_rules == talloc_array_length(data->rules)) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "Sudo rules changed during index rebuild\n");
+                break;
+            }
+
+            ret = sudosrv_index_rule_from_attrs(mem_ctx, rules[j], &rule);
+            if (ret != EOK) {
+                continue;
+            }
+
+            data->rules[data->num_rules] = rule;
+            data->num_rules++;
+        }
+        talloc_free(rules);
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t
+sudosrv_index_add_posting(struct sudosrv_index_data *data,
+                          const char *value,
+                          uint32_t pos)
+{
+    struct sudosrv_index_posting *posting;
+    hash_key_t key;
+    hash_value_t hval;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(value);
+
+    hret = hash_lookup(data->by_user, &key, &hval);
+    if (hret == HASH_SUCCESS) {
+        posting = talloc_get_type(hval.ptr, struct sudosrv_index_posting);
+    } else if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+        posting = talloc_zero(data, struct sudosrv_index_posting);
+        if (posting == NULL) {
+            return ENOMEM;
+        }
+
+        hval.type = HASH_VALUE_PTR;
+        hval.ptr = posting;
+        hret = hash_enter(data->by_user, &key, &hval);
+        if (hret != HASH_SUCCESS) {
+            return EIO;
+        }
+    } else {
+        return EIO;
+    }
+
+    /* Rules are processed in order, so the same rule can only be the last
+     * one if sudoUser contains duplicate values. */
+    if (posting->count > 0 && posting->pos[posting->count - 1] == pos) {
+        return EOK;
+    }
+
+    posting->pos = talloc_realloc(posting, posting->pos, uint32_t,
+                                  posting->count + 1);
+    if (posting->pos == NULL) {
+        return ENOMEM;
+    }
+    posting->pos[posting->count] = pos;
+    posting->count++;
+
+    return EOK;
+}
+
+/* Sorts the rules and builds the lookup tables */
+static errno_t
+sudosrv_index_build_tables(struct sudosrv_index_data *data,
+                           bool inverse_order)
+{
+    struct sudosrv_index_rule *rule;
+    struct ldb_message_element *el;
+    hash_key_t key;
+    hash_value_t hval;
+    char *value;
+    unsigned int j;
+    uint32_t i;
+    errno_t ret;
+    int hret;
+
+    qsort(data->rules, data->num_rules, sizeof(struct sudosrv_index_rule *),
+          inverse_order ? sudosrv_index_rule_low_cmp_fn
+                        : sudosrv_index_rule_high_cmp_fn);
+
+    ret = sss_hash_create(data, data->num_rules, &data->by_name);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sss_hash_create(data, data->num_rules, &data->by_user);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    data->netgroups = talloc_array(data, uint32_t, data->num_rules);
+    if (data->netgroups == NULL) {
+        return ENOMEM;
+    }
+    data->num_netgroups = 0;
+    data->defaults = -1;
+
+    for (i = 0; i < data->num_rules; i++) {
+        rule = data->rules[i];
+
+        key.type = HASH_KEY_STRING;
+        key.str = discard_const(rule->name);
+        hval.type = HASH_VALUE_PTR;
+        hval.ptr = rule;
+        hret = hash_enter(data->by_name, &key, &hval);
+        if (hret != HASH_SUCCESS) {
+            return EIO;
+        }
+
+        if (strcmp(rule->name, "defaults") == 0) {
+            data->defaults = i;
+        }
+
+        if (rule->netgroup) {
+            data->netgroups[data->num_netgroups] = i;
+            data->num_netgroups++;
+        }
+
+        ret = sysdb_attrs_get_el_ext(rule->attrs, SYSDB_SUDO_CACHE_AT_USER,
+                                     false, &el);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            return ret;
+        }
+
+        for (j = 0; j < el->num_values; j++) {
+            value = talloc_strndup(NULL, (const char *) el->values[j].data,
+                                   el->values[j].length);
+            if (value == NULL) {
+                return ENOMEM;
+            }
+
+            ret = sudosrv_index_add_posting(data, value, i);
+            talloc_free(value);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    return EOK;
+}
+
+static errno_t
+sudosrv_index_rebuild(struct sudosrv_index *idx,
+                      struct sss_domain_info *domain,
+                      bool inverse_order)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sudosrv_index_data *data;
+    struct sudosrv_index_rule *rule;
+    struct sysdb_attrs **stamps;
+    const char *stamp_attrs[] = { SYSDB_NAME, SYSDB_CACHE_EXPIRE,
+                                  SYSDB_SUDO_CACHE_AT_HASH, NULL };
+    const char **changed;
+    size_t num_changed;
+    size_t num_stamps;
+    const char *name;
+    time_t expire;
+    uint32_t hash;
+    hash_key_t key;
+    hash_value_t hval;
+    char *filter;
+    size_t i;
+    errno_t ret;
+    int hret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    filter = talloc_asprintf(tmp_ctx, "(%s=%s)",
+                             SYSDB_OBJECTCLASS, SYSDB_SUDO_CACHE_OC);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sudosrv_index_search(tmp_ctx, domain, filter, stamp_attrs,
+                               &stamps, &num_stamps);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    data = talloc_zero(tmp_ctx, struct sudosrv_index_data);
+    if (data == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    data->rules = talloc_zero_array(data, struct sudosrv_index_rule *,
+                                    num_stamps);
+    changed = talloc_zero_array(tmp_ctx, const char *, num_stamps);
+    if (data->rules == NULL || changed == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* Reuse the rules that did not change since the last build */
+    num_changed = 0;
+    for (i = 0; i < num_stamps; i++) {
+        ret = sysdb_attrs_get_string(stamps[i], SYSDB_NAME, &name);
+        if (ret != EOK) {
+            continue;
+        }
+
+        ret = sysdb_attrs_get_time_t(stamps[i], SYSDB_CACHE_EXPIRE, &expire);
+        if (ret == ENOENT) {
+            expire = 0;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        ret = sysdb_attrs_get_uint32_t(stamps[i], SYSDB_SUDO_CACHE_AT_HASH,
+                                       &hash);
+        if (ret == ENOENT) {
+            changed[num_changed] = name;
+            num_changed++;
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        rule = NULL;
+        if (idx->data != NULL) {
+            key.type = HASH_KEY_STRING;
+            key.str = discard_const(name);
+            hret = hash_lookup(idx->data->by_name, &key, &hval);
+            if (hret == HASH_SUCCESS) {
+                rule = talloc_get_type(hval.ptr, struct sudosrv_index_rule);
+            }
+        }
+
+        /* The expiration changes with every refresh, the hash only when the
+         * content of the rule does */
+        if (rule != NULL && rule->has_hash && rule->hash == hash) {
+            rule->expire = expire;
+            data->rules[data->num_rules] = talloc_steal(data, rule);
+            data->num_rules++;
+        } else {
+            changed[num_changed] = name;
+            num_changed++;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Rebuilding sudo rule index of [%s]: "
+          "%zu rules reused, %zu rules fetched\n",
+          domain->name, data->num_rules, num_changed);
+
+    ret = sudosrv_index_fetch(data, domain, changed, num_changed, data);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sudosrv_index_build_tables(data, inverse_order);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    talloc_free(idx->data);
+    idx->data = talloc_steal(idx, data);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Returns an up-to-date index of the domain where rules are stored */
+static errno_t
+sudosrv_index_get(struct sudo_ctx *sudo_ctx,
+                  struct sss_domain_info *domain,
+                  struct sudosrv_index **_index)
+{
+    struct sudosrv_index *idx;
+    uint64_t seq;
+    errno_t ret;
+
+    if (IS_SUBDOMAIN(domain)) {
+        /* rules are stored inside parent domain tree */
+        domain = domain->parent;
+    }
+
+    DLIST_FOR_EACH(idx, sudo_ctx->indexes) {
+        if (strcmp(idx->domain, domain->name) == 0) {
+            break;
+        }
+    }
+
+    if (idx == NULL) {
+        idx = talloc_zero(sudo_ctx, struct sudosrv_index);
+        if (idx == NULL) {
+            return ENOMEM;
+        }
+
+        idx->domain = talloc_strdup(idx, domain->name);
+        if (idx->domain == NULL) {
+            talloc_free(idx);
+            return ENOMEM;
+        }
+
+        DLIST_ADD(sudo_ctx->indexes, idx);
+    }
+
+    ret = sysdb_get_subtree_sequence_number(domain, SUDORULE_SUBDIR, &seq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Unable to read cache sequence number [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    if (!idx->valid || idx->seq != seq) {
+        idx->valid = false;
+
+        ret = sudosrv_index_rebuild(idx, domain, sudo_ctx->inverse_order);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Unable to rebuild sudo rule index [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
+
+        idx->seq = seq;
+        idx->valid = true;
+    }
+
+    *_index = idx;
+    return EOK;
+}
+
+static void
+sudosrv_index_mark(struct sudosrv_index_data *data,
+                   uint8_t *matches,
+                   const char *value)
+{
+    struct sudosrv_index_posting *posting;
+    hash_key_t key;
+    hash_value_t hval;
+    size_t i;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(value);
+
+    hret = hash_lookup(data->by_user, &key, &hval);
+    if (hret != HASH_SUCCESS) {
+        return;
+    }
+
+    posting = talloc_get_type(hval.ptr, struct sudosrv_index_posting);
+    for (i = 0; i < posting->count; i++) {
+        matches[posting->pos[i]] = SUDOSRV_INDEX_USER_MATCH;
+    }
+}
+
+/* Marks rules that apply to the user by name, uid or group membership and,
+ * if netgroups is true, rules that contain any netgroup. */
+static errno_t
+sudosrv_index_match(TALLOC_CTX *mem_ctx,
+                    struct sudosrv_index_data *data,
+                    uid_t uid,
+                    const char *username,
+                    char **groups,
+                    bool netgroups,
+                    uint8_t **_matches)
+{
+    uint8_t *matches;
+    char *value;
+    size_t i;
+
+    matches = talloc_zero_array(mem_ctx, uint8_t, data->num_rules + 1);
+    if (matches == NULL) {
+        return ENOMEM;
+    }
+
+    sudosrv_index_mark(data, matches, "ALL");
+    sudosrv_index_mark(data, matches, username);
+
+    if (uid != 0) {
+        value = talloc_asprintf(matches, "#%"SPRIuid, uid);
+        if (value == NULL) {
+            talloc_free(matches);
+            return ENOMEM;
+        }
+        sudosrv_index_mark(data, matches, value);
+        talloc_free(value);
+    }
+
+    for (i = 0; groups != NULL && groups[i] != NULL; i++) {
+        value = talloc_asprintf(matches, "%%%s", groups[i]);
+        if (value == NULL) {
+            talloc_free(matches);
+            return ENOMEM;
+        }
+        sudosrv_index_mark(data, matches, value);
+        talloc_free(value);
+    }
+
+    if (netgroups) {
+        for (i = 0; i < data->num_netgroups; i++) {
+            if (matches[data->netgroups[i]] == 0) {
+                matches[data->netgroups[i]] = SUDOSRV_INDEX_NETGROUP_MATCH;
+            }
+        }
+    }
+
+    *_matches = matches;
+    return EOK;
+}
+
+static struct sysdb_attrs *
+sudosrv_index_copy_rule(TALLOC_CTX *mem_ctx,
+                        struct sudosrv_index_rule *rule,
+                        const char **attrs)
+{
+    struct sysdb_attrs *copy;
+    struct ldb_message_element *el;
+    unsigned int i;
+    errno_t ret;
+
+    copy = sysdb_new_attrs(mem_ctx);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; attrs[i] != NULL; i++) {
+        ret = sysdb_attrs_get_el_ext(rule->attrs, attrs[i], false, &el);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            goto fail;
+        }
+
+        ret = sysdb_attrs_copy_values(rule->attrs, copy, attrs[i]);
+        if (ret != EOK) {
+            goto fail;
+        }
+    }
+
+    return copy;
+
+fail:
+    talloc_free(copy);
+    return NULL;
+}
+
+errno_t sudosrv_index_user_rules(TALLOC_CTX *mem_ctx,
+                                 struct sudo_ctx *sudo_ctx,
+                                 struct sss_domain_info *domain,
+                                 uid_t uid,
+                                 const char *username,
+                                 char **groups,
+                                 struct sysdb_attrs ***_rules,
+                                 uint32_t *_num_rules)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sudosrv_index *idx;
+    struct sudosrv_index_data *data;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    uint8_t *matches;
+    const char *uid_value;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sudosrv_index_get(sudo_ctx, domain, &idx);
+    if (ret != EOK) {
+        goto done;
+    }
+    data = idx->data;
+
+    ret = sudosrv_index_match(tmp_ctx, data, uid, username, groups, true,
+                              &matches);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    num_rules = 0;
+    for (i = 0; i < data->num_rules; i++) {
+        if (matches[i] != 0) {
+            num_rules++;
+        }
+    }
+
+    if (num_rules == 0) {
+        *_rules = NULL;
+        *_num_rules = 0;
+        ret = EOK;
+        goto done;
+    }
+
+    rules = talloc_zero_array(tmp_ctx, struct sysdb_attrs *, num_rules);
+    if (rules == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    uid_value = talloc_asprintf(tmp_ctx, "#%"SPRIuid, uid);
+    if (uid_value == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* Rules are already in the right order */
+    num_rules = 0;
+    for (i = 0; i < data->num_rules; i++) {
+        switch (matches[i]) {
+        case SUDOSRV_INDEX_USER_MATCH:
+            rules[num_rules] = sudosrv_index_copy_rule(rules, data->rules[i],
+                                                       sudosrv_user_attrs);
+            if (rules[num_rules] == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            /* Add sudoUser: #uid to prevent conflicts with fqnames. */
+            ret = sysdb_attrs_add_string(rules[num_rules],
+                                         SYSDB_SUDO_CACHE_AT_USER, uid_value);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "Unable to alter sudoUser "
+                      "attribute [%d]: %s\n", ret, sss_strerror(ret));
+            }
+            num_rules++;
+            break;
+        case SUDOSRV_INDEX_NETGROUP_MATCH:
+            rules[num_rules] = sudosrv_index_copy_rule(rules, data->rules[i],
+                                                       sudosrv_netgroup_attrs);
+            if (rules[num_rules] == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+            num_rules++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    *_rules = talloc_steal(mem_ctx, rules);
+    *_num_rules = num_rules;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static bool sudosrv_index_rule_expired(struct sudosrv_index_rule *rule,
+                                       time_t now)
+{
+    return rule->expire <= now;
+}
+
+/* Refreshing a rule that did not change only updates its timestamps in the
+ * timestamp cache, which does not change the sequence number the index is
+ * validated against. Read the current expiration of the matched rules that
+ * look expired, so they are not refreshed over and over again. */
+static errno_t
+sudosrv_index_update_expire(struct sss_domain_info *domain,
+                            struct sudosrv_index_data *data,
+                            uint8_t *matches,
+                            time_t now)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_NAME, SYSDB_CACHE_EXPIRE, NULL };
+    struct sudosrv_index_rule *rule;
+    struct sysdb_attrs **stamps;
+    const char *name;
+    char *sanitized;
+    char *filter;
+    time_t expire;
+    size_t num_stamps;
+    size_t num_names;
+    size_t i, j;
+    hash_key_t key;
+    hash_value_t hval;
+    errno_t ret;
+    int hret;
+
+    if (IS_SUBDOMAIN(domain)) {
+        /* rules are stored inside parent domain tree */
+        domain = domain->parent;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    i = 0;
+    while (i < data->num_rules) {
+        filter = talloc_asprintf(tmp_ctx, "(&(%s=%s)(|",
+                                 SYSDB_OBJECTCLASS, SYSDB_SUDO_CACHE_OC);
+        num_names = 0;
+        for (; i < data->num_rules
+                    && num_names < SUDOSRV_INDEX_FETCH_CHUNK; i++) {
+            if (matches[i] == 0
+                    || !sudosrv_index_rule_expired(data->rules[i], now)) {
+                continue;
+            }
+
+            if (filter == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+
+            ret = sss_filter_sanitize(tmp_ctx, data->rules[i]->name,
+                                      &sanitized);
+            if (ret != EOK) {
+                goto done;
+            }
+
+            filter = talloc_asprintf_append(filter, "(%s=%s)",
+                                            SYSDB_NAME, sanitized);
+            talloc_free(sanitized);
+            num_names++;
+        }
+
+        if (num_names == 0) {
+            talloc_free(filter);
+            break;
+        }
+
+        if (filter != NULL) {
+            filter = talloc_asprintf_append(filter, "))");
+        }
+        if (filter == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sudosrv_index_search(tmp_ctx, domain, filter, attrs,
+                                   &stamps, &num_stamps);
+        talloc_free(filter);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        for (j = 0; j < num_stamps; j++) {
+            ret = sysdb_attrs_get_string(stamps[j], SYSDB_NAME, &name);
+            if (ret != EOK) {
+                continue;
+            }
+
+            ret = sysdb_attrs_get_time_t(stamps[j], SYSDB_CACHE_EXPIRE,
+                                         &expire);
+            if (ret != EOK) {
+                continue;
+            }
+
+            key.type = HASH_KEY_STRING;
+            key.str = discard_const(name);
+            hret = hash_lookup(data->by_name, &key, &hval);
+            if (hret != HASH_SUCCESS) {
+                continue;
+            }
+
+            rule = talloc_get_type(hval.ptr, struct sudosrv_index_rule);
+            rule->expire = expire;
+        }
+        talloc_free(stamps);
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t sudosrv_index_expired_rules(TALLOC_CTX *mem_ctx,
+                                    struct sudo_ctx *sudo_ctx,
+                                    struct sss_domain_info *domain,
+                                    uid_t uid,
+                                    const char *username,
+                                    char **groups,
+                                    struct sysdb_attrs ***_rules,
+                                    uint32_t *_num_rules)
+{
+    static const char *attrs[] = { SYSDB_NAME, NULL };
+    TALLOC_CTX *tmp_ctx;
+    struct sudosrv_index *idx;
+    struct sudosrv_index_data *data;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    uint8_t *matches;
+    time_t now;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sudosrv_index_get(sudo_ctx, domain, &idx);
+    if (ret != EOK) {
+        goto done;
+    }
+    data = idx->data;
+
+    ret = sudosrv_index_match(tmp_ctx, data, uid, username, groups, true,
+                              &matches);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (data->defaults >= 0) {
+        matches[data->defaults] = SUDOSRV_INDEX_USER_MATCH;
+    }
+
+    rules = talloc_zero_array(tmp_ctx, struct sysdb_attrs *, data->num_rules);
+    if (rules == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    now = time(NULL);
+    ret = sudosrv_index_update_expire(domain, data, matches, now);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Unable to read expiration of sudo rules [%d]: %s\n",
+              ret, sss_strerror(ret));
+        /* Not fatal, the rules are refreshed */
+    }
+
+    num_rules = 0;
+    for (i = 0; i < data->num_rules; i++) {
+        if (matches[i] == 0
+                || !sudosrv_index_rule_expired(data->rules[i], now)) {
+            continue;
+        }
+
+        rules[num_rules] = sudosrv_index_copy_rule(rules, data->rules[i],
+                                                   attrs);
+        if (rules[num_rules] == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        num_rules++;
+    }
+
+    *_rules = num_rules == 0 ? NULL : talloc_steal(mem_ctx, rules);
+    *_num_rules = num_rules;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
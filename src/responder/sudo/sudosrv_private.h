@@ -40,6 +40,8 @@ enum sss_sudo_type {
     SSS_SUDO_USER
 };
 
+struct sudosrv_index;
+
 struct sudo_ctx {
     struct resp_ctx *rctx;
 
@@ -48,6 +50,9 @@ struct sudo_ctx {
      */
     bool timed;
     bool inverse_order;
+
+    /* per-domain in-memory rule indexes, see sudosrv_index.c */
+    struct sudosrv_index *indexes;
 };
 
 struct sudo_cmd_ctx {
@@ -78,6 +83,24 @@ errno_t sudosrv_get_rules_recv(TALLOC_CTX *mem_ctx,
                                struct sysdb_attrs ***_rules,
                                uint32_t *_num_rules);
 
+errno_t sudosrv_index_user_rules(TALLOC_CTX *mem_ctx,
+                                 struct sudo_ctx *sudo_ctx,
+                                 struct sss_domain_info *domain,
+                                 uid_t uid,
+                                 const char *username,
+                                 char **groups,
+                                 struct sysdb_attrs ***_rules,
+                                 uint32_t *_num_rules);
+
+errno_t sudosrv_index_expired_rules(TALLOC_CTX *mem_ctx,
+                                    struct sudo_ctx *sudo_ctx,
+                                    struct sss_domain_info *domain,
+                                    uid_t uid,
+                                    const char *username,
+                                    char **groups,
+                                    struct sysdb_attrs ***_rules,
+                                    uint32_t *_num_rules);
+
 errno_t sudosrv_parse_query(TALLOC_CTX *mem_ctx,
                             uint8_t *query_body,
                             size_t query_len,
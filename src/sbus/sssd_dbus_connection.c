@@ -27,21 +27,50 @@
 #include "sbus/sssd_dbus_private.h"
 #include "sbus/sssd_dbus_meta.h"
 
+/* Maximum number of messages dispatched in one pass through the mainloop */
+#define SBUS_DISPATCH_BATCH 16
+
 static int sbus_auto_reconnect(struct sbus_connection *conn);
 
+static void sbus_dispatch(struct tevent_context *ev,
+                          struct tevent_timer *te,
+                          struct timeval tv, void *data);
+
+/* Only one dispatch is scheduled at a time, D-BUS may ask for a wakeup
+ * several times before the dispatch takes place. */
+static errno_t sbus_conn_schedule_dispatch(struct sbus_connection *conn,
+                                           struct timeval tv)
+{
+    if (conn->dispatch_te != NULL) {
+        return EOK;
+    }
+
+    conn->dispatch_te = tevent_add_timer(conn->ev, conn, tv,
+                                         sbus_dispatch, conn);
+    if (conn->dispatch_te == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
 static void sbus_dispatch(struct tevent_context *ev,
                           struct tevent_timer *te,
                           struct timeval tv, void *data)
 {
-    struct tevent_timer *new_event;
     struct sbus_connection *conn;
     DBusConnection *dbus_conn;
+    bool conn_freed = false;
     int ret;
+    int i;
 
     if (data == NULL) return;
 
     conn = talloc_get_type(data, struct sbus_connection);
 
+    /* the timer is freed by tevent once this handler returns */
+    conn->dispatch_te = NULL;
+
     dbus_conn = conn->dbus.conn;
     DEBUG(SSSDBG_TRACE_ALL, "dbus conn: %p\n", dbus_conn);
 
@@ -49,8 +78,8 @@ static void sbus_dispatch(struct tevent_context *ev,
         DEBUG(SSSDBG_TRACE_FUNC, "SBUS is reconnecting. Deferring.\n");
         /* Currently trying to reconnect, defer dispatch for 30ms */
         tv = tevent_timeval_current_ofs(0, 30);
-        new_event = tevent_add_timer(ev, conn, tv, sbus_dispatch, conn);
-        if (new_event == NULL) {
+        ret = sbus_conn_schedule_dispatch(conn, tv);
+        if (ret != EOK) {
             DEBUG(SSSDBG_FATAL_FAILURE,"Could not defer dispatch!\n");
         }
         return;
@@ -84,13 +113,46 @@ static void sbus_dispatch(struct tevent_context *ev,
         return;
     }
 
-    /* Dispatch only once each time through the mainloop to avoid
-     * starving other features
+    /* Dispatch a limited batch of messages each time through the mainloop
+     * so that a busy connection does not pay a full mainloop iteration for
+     * every single message but also does not starve other features.
+     *
+     * Handlers run synchronously from dbus_connection_dispatch() and may
+     * disconnect or even free the connection, so keep our own reference
+     * to the D-Bus connection and stop as soon as either happens.
      */
-    ret = dbus_connection_get_dispatch_status(dbus_conn);
-    if (ret != DBUS_DISPATCH_COMPLETE) {
+    dbus_connection_ref(dbus_conn);
+    conn->dispatch_freed = &conn_freed;
+
+    for (i = 0; i < SBUS_DISPATCH_BATCH; i++) {
+        ret = dbus_connection_get_dispatch_status(dbus_conn);
+        if (ret != DBUS_DISPATCH_DATA_REMAINS) {
+            break;
+        }
+
         DEBUG(SSSDBG_TRACE_ALL,"Dispatching.\n");
-        dbus_connection_dispatch(dbus_conn);
+        ret = dbus_connection_dispatch(dbus_conn);
+        if (conn_freed || conn->disconnect) {
+            break;
+        }
+
+        if (ret != DBUS_DISPATCH_DATA_REMAINS) {
+            break;
+        }
+    }
+
+    if (conn_freed) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Connection was freed while dispatching.\n");
+        goto done;
+    }
+
+    conn->dispatch_freed = NULL;
+
+    if (conn->disconnect) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Connection was closed while dispatching.\n");
+        goto done;
     }
 
     /* If other dispatches are waiting, queue up the dispatch function
@@ -98,14 +160,27 @@ static void sbus_dispatch(struct tevent_context *ev,
      */
     ret = dbus_connection_get_dispatch_status(dbus_conn);
     if (ret != DBUS_DISPATCH_COMPLETE) {
-        new_event = tevent_add_timer(ev, conn, tv, sbus_dispatch, conn);
-        if (new_event == NULL) {
+        ret = sbus_conn_schedule_dispatch(conn, tv);
+        if (ret != EOK) {
             DEBUG(SSSDBG_OP_FAILURE,"Could not add dispatch event!\n");
 
             /* TODO: Calling exit here is bad */
             exit(1);
         }
     }
+
+done:
+    dbus_connection_unref(dbus_conn);
+}
+
+/* Lets sbus_dispatch() notice that a handler freed the connection */
+static int sbus_conn_talloc_destructor(struct sbus_connection *conn)
+{
+    if (conn->dispatch_freed != NULL) {
+        *conn->dispatch_freed = true;
+    }
+
+    return 0;
 }
 
 /* dbus_connection_wakeup_main
@@ -119,15 +194,15 @@ static void sbus_conn_wakeup_main(void *data)
 {
     struct sbus_connection *conn;
     struct timeval tv;
-    struct tevent_timer *te;
+    errno_t ret;
 
     conn = talloc_get_type(data, struct sbus_connection);
 
     tv = tevent_timeval_current();
 
     /* D-BUS calls this function when it is time to do a dispatch */
-    te = tevent_add_timer(conn->ev, conn, tv, sbus_dispatch, conn);
-    if (te == NULL) {
+    ret = sbus_conn_schedule_dispatch(conn, tv);
+    if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,"Could not add dispatch event!\n");
         /* TODO: Calling exit here is bad */
         exit(1);
@@ -155,6 +230,10 @@ int sbus_init_connection(TALLOC_CTX *ctx,
 
     DEBUG(SSSDBG_TRACE_FUNC,"Adding connection %p\n", dbus_conn);
     conn = talloc_zero(ctx, struct sbus_connection);
+    if (conn == NULL) {
+        return ENOMEM;
+    }
+    talloc_set_destructor(conn, sbus_conn_talloc_destructor);
 
     conn->ev = ev;
     conn->type = SBUS_CONNECTION;
@@ -599,16 +599,22 @@ sbus_opath_hash_lookup_iface(hash_table_t *table,
     struct sbus_interface *iface = NULL;
     char *lookup_path = NULL;
 
+    /* Most messages are sent to an exactly registered object path,
+     * try it first without any allocation. */
+    list = sss_ptr_hash_lookup(table, object_path, struct sbus_interface_list);
+    if (list != NULL) {
+        iface = sbus_iface_list_lookup(list, iface_name);
+        if (iface != NULL) {
+            return iface;
+        }
+    }
+
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
         return NULL;
     }
 
-    lookup_path = talloc_strdup(tmp_ctx, object_path);
-    if (lookup_path == NULL) {
-        goto done;
-    }
-
+    lookup_path = sbus_opath_parent_subtree(tmp_ctx, object_path);
     while (lookup_path != NULL) {
         list = sss_ptr_hash_lookup(table, lookup_path,
                                    struct sbus_interface_list);
@@ -947,6 +953,21 @@ done:
 static void
 sbus_message_handler_got_caller_id(struct tevent_req *req);
 
+static void
+sbus_message_handler_invoke(struct sbus_request *sbus_req)
+{
+    sbus_msg_handler_fn handler;
+    sbus_method_invoker_fn invoker;
+    void *pvt;
+
+    handler = VTABLE_FUNC(sbus_req->intf->vtable,
+                          sbus_req->method->vtable_offset);
+    invoker = sbus_req->method->invoker;
+    pvt = sbus_req->intf->handler_data;
+
+    sbus_request_invoke_or_finish(sbus_req, handler, pvt, invoker);
+}
+
 static DBusHandlerResult
 sbus_message_handler(DBusConnection *dbus_conn,
                      DBusMessage *message,
@@ -993,6 +1014,19 @@ sbus_message_handler(DBusConnection *dbus_conn,
 
     sbus_req->method = method;
 
+    if (conn->last_request_time != NULL) {
+        *conn->last_request_time = time(NULL);
+    }
+
+    /* The caller ID is resolved only on the system bus. On private
+     * connections there is nothing to resolve so we invoke the handler
+     * right away instead of waiting for another mainloop iteration. */
+    if (conn->connection_type != SBUS_CONN_TYPE_SYSBUS) {
+        sbus_req->client = -1;
+        sbus_message_handler_invoke(sbus_req);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
     /* now get the sender ID */
     req = sbus_get_sender_id_send(sbus_req, conn->ev, conn, sender);
     if (req == NULL) {
@@ -1001,10 +1035,6 @@ sbus_message_handler(DBusConnection *dbus_conn,
     }
     tevent_req_set_callback(req, sbus_message_handler_got_caller_id, sbus_req);
 
-    if (conn->last_request_time != NULL) {
-        *conn->last_request_time = time(NULL);
-    }
-
     return DBUS_HANDLER_RESULT_HANDLED;
 
 fail: ;
@@ -1023,15 +1053,10 @@ static void
 sbus_message_handler_got_caller_id(struct tevent_req *req)
 {
     struct sbus_request *sbus_req;
-    const struct sbus_method_meta *method;
-    sbus_msg_handler_fn handler;
-    sbus_method_invoker_fn invoker;
-    void *pvt;
     DBusError *error;
     errno_t ret;
 
     sbus_req = tevent_req_callback_data(req, struct sbus_request);
-    method = sbus_req->method;
 
     ret = sbus_get_sender_id_recv(req, &sbus_req->client);
     if (ret != EOK) {
@@ -1041,10 +1066,5 @@ sbus_message_handler_got_caller_id(struct tevent_req *req)
         return;
     }
 
-    handler = VTABLE_FUNC(sbus_req->intf->vtable, method->vtable_offset);
-    invoker = method->invoker;
-    pvt = sbus_req->intf->handler_data;
-
-    sbus_request_invoke_or_finish(sbus_req, handler, pvt, invoker);
-    return;
+    sbus_message_handler_invoke(sbus_req);
 }
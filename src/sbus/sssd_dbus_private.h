@@ -67,6 +67,11 @@ struct sbus_connection {
     /* watches list */
     struct sbus_watch_ctx *watch_list;
 
+    /* pending dispatch of incoming messages */
+    struct tevent_timer *dispatch_te;
+    /* set to true if the connection is freed during sbus_dispatch() */
+    bool *dispatch_freed;
+
     /* responder related stuff */
     time_t *last_request_time;
 
@@ -23,10 +23,13 @@
 */
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <nss.h>
 
 #include "sss_client/sss_cli.h"
+#include "sss_client/nss_mc.h"
 #include "sss_client/idmap/sss_nss_idmap.h"
 #include "util/strtonum.h"
 
@@ -198,6 +201,84 @@ done:
     return ret;
 }
 
+/* Try to answer SID requests from the memory cache, any error means the
+ * request has to be sent to the responder. */
+static int sss_nss_mc_getyyybyxxx(union input inp, enum sss_cli_command cmd,
+                                  struct output *out)
+{
+    char *key;
+    char *sid = NULL;
+    char *name = NULL;
+    uint32_t id;
+    uint32_t type;
+    int len;
+    int ret;
+
+    switch (cmd) {
+    case SSS_NSS_GETSIDBYNAME:
+        len = asprintf(&key, MC_SID_KEY_NAME"%s", inp.str);
+        break;
+    case SSS_NSS_GETSIDBYID:
+        len = asprintf(&key, MC_SID_KEY_ID"%"PRIu32, inp.id);
+        break;
+    case SSS_NSS_GETNAMEBYSID:
+    case SSS_NSS_GETIDBYSID:
+        len = asprintf(&key, MC_SID_KEY_SID"%s", inp.str);
+        break;
+    default:
+        return EINVAL;
+    }
+    if (len == -1) {
+        return ENOMEM;
+    }
+
+    switch (cmd) {
+    case SSS_NSS_GETSIDBYNAME:
+    case SSS_NSS_GETSIDBYID:
+        ret = sss_nss_mc_getsid(key, len, &sid, NULL, NULL, &type);
+        if (ret == EOK && *sid == '\0') {
+            ret = ENOENT;
+        }
+        if (ret == EOK) {
+            out->d.str = sid;
+            sid = NULL;
+        }
+        break;
+    case SSS_NSS_GETNAMEBYSID:
+        ret = sss_nss_mc_getsid(key, len, NULL, &name, NULL, &type);
+        if (ret == EOK && *name == '\0') {
+            ret = ENOENT;
+        }
+        if (ret == EOK) {
+            out->d.str = name;
+            name = NULL;
+        }
+        break;
+    case SSS_NSS_GETIDBYSID:
+        ret = sss_nss_mc_getsid(key, len, NULL, NULL, &id, &type);
+        if (ret == EOK && id == 0) {
+            /* e.g. well known SIDs, let the responder report the error */
+            ret = ENOENT;
+        }
+        if (ret == EOK) {
+            out->d.id = id;
+        }
+        break;
+    default:
+        ret = EINVAL;
+        break;
+    }
+
+    if (ret == EOK) {
+        out->type = type;
+    }
+
+    free(sid);
+    free(name);
+    free(key);
+    return ret;
+}
+
 static int sss_nss_getyyybyxxx(union input inp, enum sss_cli_command cmd ,
                                struct output *out)
 {
@@ -250,6 +331,11 @@ static int sss_nss_getyyybyxxx(union input inp, enum sss_cli_command cmd ,
         return EINVAL;
     }
 
+    ret = sss_nss_mc_getyyybyxxx(inp, cmd, out);
+    if (ret == EOK) {
+        return EOK;
+    }
+
     sss_nss_lock();
 
     nret = sss_nss_make_request(cmd, &rd, &repbuf, &replen, &errnop);
@@ -498,3 +584,282 @@ int sss_nss_getlistbycert(const char *cert, char ***fq_name,
 
     return ret;
 }
+
+/* Batched lookups. Elements which can be answered from the memory cache are
+ * resolved locally, the remaining ones are sent to the responder in chunks
+ * of at most SSS_NSS_MAX_BATCH elements and SSS_NSS_MAX_BATCH_SIZE bytes.
+ * A chunk which fails only fails its own elements. */
+struct batch_output {
+    uint32_t *ids;
+    char **strs;
+    enum sss_id_type *types;
+    int *errors;
+};
+
+static size_t sss_nss_batch_elem_len(const char *const *sids, size_t c)
+{
+    if (sids != NULL) {
+        return strlen(sids[c]) + 1;
+    }
+
+    return sizeof(uint32_t);
+}
+
+static int sss_nss_batch_request(enum sss_cli_command cmd,
+                                 const char *const *sids, const uint32_t *ids,
+                                 const size_t *idx, size_t num,
+                                 struct batch_output *out)
+{
+    struct sss_cli_req_data rd;
+    uint8_t *reqbuf = NULL;
+    uint8_t *repbuf = NULL;
+    size_t reqlen;
+    size_t replen;
+    size_t rp;
+    size_t len;
+    size_t c;
+    uint32_t num_results;
+    uint32_t err;
+    uint32_t type;
+    uint32_t id;
+    uint8_t *end;
+    char *str;
+    int errnop;
+    enum nss_status nret;
+    int ret;
+
+    reqlen = sizeof(uint32_t);
+    for (c = 0; c < num; c++) {
+        reqlen += sss_nss_batch_elem_len(sids, idx[c]);
+    }
+
+    reqbuf = malloc(reqlen);
+    if (reqbuf == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    rp = 0;
+    SAFEALIGN_SET_UINT32(reqbuf + rp, num, &rp);
+    for (c = 0; c < num; c++) {
+        if (sids != NULL) {
+            len = strlen(sids[idx[c]]) + 1;
+            SAFEALIGN_SET_STRING(reqbuf + rp, sids[idx[c]], len, &rp);
+        } else {
+            SAFEALIGN_SET_UINT32(reqbuf + rp, ids[idx[c]], &rp);
+        }
+    }
+
+    rd.len = reqlen;
+    rd.data = reqbuf;
+
+    sss_nss_lock();
+    nret = sss_nss_make_request(cmd, &rd, &repbuf, &replen, &errnop);
+    sss_nss_unlock();
+    if (nret != NSS_STATUS_SUCCESS) {
+        ret = nss_status_to_errno(nret);
+        goto done;
+    }
+
+    if (replen < LIST_START) {
+        ret = EBADMSG;
+        goto done;
+    }
+
+    SAFEALIGN_COPY_UINT32(&num_results, repbuf, NULL);
+    if (num_results != num) {
+        ret = EBADMSG;
+        goto done;
+    }
+
+    rp = LIST_START;
+    for (c = 0; c < num; c++) {
+        if (replen - rp < 2 * sizeof(uint32_t)) {
+            ret = EBADMSG;
+            goto done;
+        }
+        SAFEALIGN_COPY_UINT32(&err, repbuf + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&type, repbuf + rp, &rp);
+
+        if (cmd == SSS_NSS_GETIDSBYSIDS) {
+            if (replen - rp < sizeof(uint32_t)) {
+                ret = EBADMSG;
+                goto done;
+            }
+            SAFEALIGN_COPY_UINT32(&id, repbuf + rp, &rp);
+            str = NULL;
+        } else {
+            end = memchr(repbuf + rp, '\0', replen - rp);
+            if (end == NULL) {
+                ret = EBADMSG;
+                goto done;
+            }
+            str = (char *) repbuf + rp;
+            rp = end - repbuf + 1;
+            id = 0;
+        }
+
+        if (err != EOK) {
+            out->errors[idx[c]] = err;
+            continue;
+        }
+
+        if (str != NULL) {
+            if (*str == '\0') {
+                ret = EBADMSG;
+                goto done;
+            }
+
+            out->strs[idx[c]] = strdup(str);
+            if (out->strs[idx[c]] == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+        } else {
+            out->ids[idx[c]] = id;
+        }
+
+        out->types[idx[c]] = type;
+        out->errors[idx[c]] = EOK;
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        /* A broken reply cannot be trusted for any element of the chunk. */
+        for (c = 0; c < num; c++) {
+            if (out->strs != NULL) {
+                free(out->strs[idx[c]]);
+                out->strs[idx[c]] = NULL;
+            }
+            out->types[idx[c]] = SSS_ID_TYPE_NOT_SPECIFIED;
+            out->errors[idx[c]] = ret;
+        }
+    }
+    free(reqbuf);
+    free(repbuf);
+    return ret;
+}
+
+static int sss_nss_getbatch(enum sss_cli_command cmd,
+                            enum sss_cli_command single_cmd,
+                            const char *const *sids, const uint32_t *ids,
+                            size_t num, struct batch_output *out)
+{
+    union input inp;
+    struct output mc_out;
+    size_t *idx;
+    size_t pending = 0;
+    size_t chunk;
+    size_t reqlen;
+    size_t len;
+    size_t c;
+    int ret;
+
+    idx = malloc(num * sizeof(size_t));
+    if (idx == NULL) {
+        return ENOMEM;
+    }
+
+    for (c = 0; c < num; c++) {
+        if (out->strs != NULL) {
+            out->strs[c] = NULL;
+        }
+        out->types[c] = SSS_ID_TYPE_NOT_SPECIFIED;
+
+        if (sids != NULL) {
+            if (sids[c] == NULL || *sids[c] == '\0') {
+                out->errors[c] = EINVAL;
+                continue;
+            }
+
+            /* Keeps every single SID well below SSS_NSS_MAX_BATCH_SIZE. */
+            ret = sss_strnlen(sids[c], 2048, &len);
+            if (ret != EOK) {
+                out->errors[c] = EINVAL;
+                continue;
+            }
+            inp.str = sids[c];
+        } else {
+            inp.id = ids[c];
+        }
+
+        ret = sss_nss_mc_getyyybyxxx(inp, single_cmd, &mc_out);
+        if (ret == EOK) {
+            if (out->strs != NULL) {
+                out->strs[c] = mc_out.d.str;
+            } else {
+                out->ids[c] = mc_out.d.id;
+            }
+            out->types[c] = mc_out.type;
+            out->errors[c] = EOK;
+            continue;
+        }
+
+        idx[pending] = c;
+        pending++;
+    }
+
+    for (c = 0; c < pending; c += chunk) {
+        reqlen = sizeof(uint32_t);
+        for (chunk = 0; c + chunk < pending && chunk < SSS_NSS_MAX_BATCH;
+                                                                    chunk++) {
+            len = sss_nss_batch_elem_len(sids, idx[c + chunk]);
+            if (reqlen + len > SSS_NSS_MAX_BATCH_SIZE) {
+                break;
+            }
+            reqlen += len;
+        }
+
+        /* Errors are recorded for the elements of the chunk. */
+        sss_nss_batch_request(cmd, sids, ids, idx + c, chunk, out);
+    }
+
+    free(idx);
+
+    return EOK;
+}
+
+int sss_nss_getidsbysids(const char *const *sids, size_t num,
+                         uint32_t *ids, enum sss_id_type *types, int *errors)
+{
+    struct batch_output out = { ids, NULL, types, errors };
+
+    if (sids == NULL || num == 0 || ids == NULL || types == NULL
+            || errors == NULL) {
+        return EINVAL;
+    }
+
+    return sss_nss_getbatch(SSS_NSS_GETIDSBYSIDS, SSS_NSS_GETIDBYSID,
+                            sids, NULL, num, &out);
+}
+
+int sss_nss_getsidsbyids(const uint32_t *ids, size_t num,
+                         char **sids, enum sss_id_type *types, int *errors)
+{
+    struct batch_output out = { NULL, sids, types, errors };
+
+    if (ids == NULL || num == 0 || sids == NULL || types == NULL
+            || errors == NULL) {
+        return EINVAL;
+    }
+
+    return sss_nss_getbatch(SSS_NSS_GETSIDSBYIDS, SSS_NSS_GETSIDBYID,
+                            NULL, ids, num, &out);
+}
+
+int sss_nss_getnamesbysids(const char *const *sids, size_t num,
+                           char **fq_names, enum sss_id_type *types,
+                           int *errors)
+{
+    struct batch_output out = { NULL, fq_names, types, errors };
+
+    if (sids == NULL || num == 0 || fq_names == NULL || types == NULL
+            || errors == NULL) {
+        return EINVAL;
+    }
+
+    return sss_nss_getbatch(SSS_NSS_GETNAMESBYSIDS, SSS_NSS_GETNAMEBYSID,
+                            sids, NULL, num, &out);
+}
@@ -25,6 +25,7 @@
 #ifndef SSS_NSS_IDMAP_H_
 #define SSS_NSS_IDMAP_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -153,6 +154,66 @@ int sss_nss_getnamebycert(const char *cert, char **fq_name,
 int sss_nss_getlistbycert(const char *cert, char ***fq_name,
                           enum sss_id_type **type);
 
+/**
+ * @brief Find the POSIX IDs of a list of SIDs
+ *
+ * All SIDs are translated with as few round trips to SSSD as possible. The
+ * result of each SID is reported separately in the output arrays which must
+ * have room for num elements.
+ *
+ * @param[in] sids     List of string representations of SIDs
+ * @param[in] num      Number of SIDs in the list
+ * @param[out] ids     POSIX IDs of the given SIDs
+ * @param[out] types   Types of the objects related to the given SIDs
+ * @param[out] errors  Result of each lookup, see #sss_nss_getsidbyname for
+ *                     the possible values, ids[i] and types[i] are only
+ *                     valid if errors[i] is 0. If the communication with
+ *                     SSSD fails, only the elements sent in the failed
+ *                     request get the error.
+ *
+ * @return
+ *  - 0 (EOK): all lookups were done, check errors for the single results
+ *  - EINVAL: invalid input
+ *  - ENOMEM: no lookup was done because memory is exhausted
+ */
+int sss_nss_getidsbysids(const char *const *sids, size_t num,
+                         uint32_t *ids, enum sss_id_type *types, int *errors);
+
+/**
+ * @brief Find the SIDs of a list of POSIX IDs
+ *
+ * @param[in] ids      List of POSIX IDs
+ * @param[in] num      Number of IDs in the list
+ * @param[out] sids    String representations of the SIDs of the given IDs,
+ *                     each element must be freed by the caller
+ * @param[out] types   Types of the objects related to the given IDs
+ * @param[out] errors  Result of each lookup, sids[i] is NULL if errors[i]
+ *                     is not 0
+ *
+ * @return
+ *  - see #sss_nss_getidsbysids
+ */
+int sss_nss_getsidsbyids(const uint32_t *ids, size_t num,
+                         char **sids, enum sss_id_type *types, int *errors);
+
+/**
+ * @brief Find the fully qualified names of a list of SIDs
+ *
+ * @param[in] sids     List of string representations of SIDs
+ * @param[in] num      Number of SIDs in the list
+ * @param[out] fq_names Fully qualified names of the given SIDs, each element
+ *                     must be freed by the caller
+ * @param[out] types   Types of the objects related to the given SIDs
+ * @param[out] errors  Result of each lookup, fq_names[i] is NULL if
+ *                     errors[i] is not 0
+ *
+ * @return
+ *  - see #sss_nss_getidsbysids
+ */
+int sss_nss_getnamesbysids(const char *const *sids, size_t num,
+                           char **fq_names, enum sss_id_type *types,
+                           int *errors);
+
 /**
  * @brief Free key-value list returned by sss_nss_getorigbyname()
  *
@@ -165,60 +165,147 @@ wbcErr wbcSidsToUnixIds(const struct wbcDomainSid *sids, uint32_t num_sids,
             struct wbcUnixId *ids)
 {
     int ret;
-    char *sid_str;
-    uint32_t id;
-    enum sss_id_type type;
+    char **sid_strs = NULL;
+    uint32_t *id_list = NULL;
+    enum sss_id_type *types = NULL;
+    int *errors = NULL;
     size_t c;
     wbcErr wbc_status;
 
+    if (num_sids == 0) {
+        return WBC_ERR_SUCCESS;
+    }
+
+    sid_strs = calloc(num_sids, sizeof(char *));
+    id_list = calloc(num_sids, sizeof(uint32_t));
+    types = calloc(num_sids, sizeof(enum sss_id_type));
+    errors = calloc(num_sids, sizeof(int));
+    if (sid_strs == NULL || id_list == NULL || types == NULL
+            || errors == NULL) {
+        wbc_status = WBC_ERR_NO_MEMORY;
+        goto done;
+    }
+
+    /* SIDs which cannot be converted are left NULL and reported as
+     * invalid by sss_nss_getidsbysids() */
     for (c = 0; c < num_sids; c++) {
-        type = SSS_ID_TYPE_NOT_SPECIFIED;
-        wbc_status = wbcSidToString(&sids[c], &sid_str);
-        if (WBC_ERROR_IS_OK(wbc_status)) {
-            ret = sss_nss_getidbysid(sid_str, &id, &type);
-            wbcFreeMemory(sid_str);
-            if (ret != 0) {
-                type = SSS_ID_TYPE_NOT_SPECIFIED;
-            }
+        wbc_status = wbcSidToString(&sids[c], &sid_strs[c]);
+        if (!WBC_ERROR_IS_OK(wbc_status)) {
+            sid_strs[c] = NULL;
         }
+    }
 
-        switch (type) {
+    ret = sss_nss_getidsbysids((const char *const *) sid_strs, num_sids,
+                               id_list, types, errors);
+    if (ret != 0) {
+        /* Nothing was looked up, failed requests to SSSD are reported in
+         * errors for the affected elements only. */
+        wbc_status = WBC_ERR_UNKNOWN_FAILURE;
+        goto done;
+    }
+
+    for (c = 0; c < num_sids; c++) {
+        switch (errors[c] == 0 ? types[c] : SSS_ID_TYPE_NOT_SPECIFIED) {
         case SSS_ID_TYPE_UID:
             ids[c].type = WBC_ID_TYPE_UID;
-            ids[c].id.uid = (uid_t) id;
+            ids[c].id.uid = (uid_t) id_list[c];
             break;
         case SSS_ID_TYPE_GID:
             ids[c].type = WBC_ID_TYPE_GID;
-            ids[c].id.gid = (gid_t) id;
+            ids[c].id.gid = (gid_t) id_list[c];
             break;
         case SSS_ID_TYPE_BOTH:
             ids[c].type = WBC_ID_TYPE_BOTH;
-            ids[c].id.uid = (uid_t) id;
+            ids[c].id.uid = (uid_t) id_list[c];
             break;
         default:
             ids[c].type = WBC_ID_TYPE_NOT_SPECIFIED;
         }
     }
 
-    return WBC_ERR_SUCCESS;
+    wbc_status = WBC_ERR_SUCCESS;
+
+done:
+    if (sid_strs != NULL) {
+        for (c = 0; c < num_sids; c++) {
+            wbcFreeMemory(sid_strs[c]);
+        }
+    }
+    free(sid_strs);
+    free(id_list);
+    free(types);
+    free(errors);
+
+    return wbc_status;
 }
 
 wbcErr wbcUnixIdsToSids(const struct wbcUnixId *ids, uint32_t num_ids,
                         struct wbcDomainSid *sids)
 {
+    int ret;
+    uint32_t *id_list = NULL;
+    char **sid_strs = NULL;
+    enum sss_id_type *types = NULL;
+    int *errors = NULL;
     size_t c;
     wbcErr wbc_status;
 
+    if (num_ids == 0) {
+        return WBC_ERR_SUCCESS;
+    }
+
+    id_list = calloc(num_ids, sizeof(uint32_t));
+    sid_strs = calloc(num_ids, sizeof(char *));
+    types = calloc(num_ids, sizeof(enum sss_id_type));
+    errors = calloc(num_ids, sizeof(int));
+    if (id_list == NULL || sid_strs == NULL || types == NULL
+            || errors == NULL) {
+        wbc_status = WBC_ERR_NO_MEMORY;
+        goto done;
+    }
+
     for (c = 0; c < num_ids; c++) {
         switch (ids[c].type) {
         case WBC_ID_TYPE_UID:
-            wbc_status = wbcUidToSid(ids[c].id.uid, &sids[c]);
+            id_list[c] = ids[c].id.uid;
             break;
         case WBC_ID_TYPE_GID:
-            wbc_status = wbcGidToSid(ids[c].id.gid, &sids[c]);
+            id_list[c] = ids[c].id.gid;
             break;
         default:
-            wbc_status = WBC_ERR_INVALID_PARAM;
+            /* will not be looked up, see below */
+            id_list[c] = 0;
+        }
+    }
+
+    ret = sss_nss_getsidsbyids(id_list, num_ids, sid_strs, types, errors);
+    if (ret != 0) {
+        /* Nothing was looked up, failed requests to SSSD are reported in
+         * errors for the affected elements only. */
+        wbc_status = WBC_ERR_UNKNOWN_FAILURE;
+        goto done;
+    }
+
+    for (c = 0; c < num_ids; c++) {
+        wbc_status = WBC_ERR_UNKNOWN_FAILURE;
+
+        if (errors[c] == 0) {
+            switch (ids[c].type) {
+            case WBC_ID_TYPE_UID:
+                if (types[c] == SSS_ID_TYPE_UID
+                        || types[c] == SSS_ID_TYPE_BOTH) {
+                    wbc_status = wbcStringToSid(sid_strs[c], &sids[c]);
+                }
+                break;
+            case WBC_ID_TYPE_GID:
+                if (types[c] == SSS_ID_TYPE_GID
+                        || types[c] == SSS_ID_TYPE_BOTH) {
+                    wbc_status = wbcStringToSid(sid_strs[c], &sids[c]);
+                }
+                break;
+            default:
+                wbc_status = WBC_ERR_INVALID_PARAM;
+            }
         }
 
         if (!WBC_ERROR_IS_OK(wbc_status)) {
@@ -226,5 +313,18 @@ wbcErr wbcUnixIdsToSids(const struct wbcUnixId *ids, uint32_t num_ids,
         };
     }
 
-    return WBC_ERR_SUCCESS;
+    wbc_status = WBC_ERR_SUCCESS;
+
+done:
+    if (sid_strs != NULL) {
+        for (c = 0; c < num_ids; c++) {
+            free(sid_strs[c]);
+        }
+    }
+    free(id_list);
+    free(sid_strs);
+    free(types);
+    free(errors);
+
+    return wbc_status;
 }
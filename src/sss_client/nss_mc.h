@@ -90,4 +90,9 @@ errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
                                   gid_t group, long int *start, long int *size,
                                   gid_t **groups, long int limit);
 
+/* SID db, key is built from one of the MC_SID_KEY_* prefixes */
+errno_t sss_nss_mc_getsid(const char *key, size_t key_len,
+                          char **sid, char **name,
+                          uint32_t *id, uint32_t *type);
+
 #endif /* _NSS_MC_H_ */
@@ -0,0 +1,169 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) 2026 Red Hat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* SID mappings using mmap cache */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "nss_mc.h"
+
+struct sss_cli_mc_ctx sid_mc_ctx = { UNINITIALIZED, -1, 0, NULL, 0, NULL, 0,
+                                     NULL, 0, 0 };
+
+static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
+                                       char **_sid, char **_name,
+                                       uint32_t *_id, uint32_t *_type)
+{
+    struct sss_mc_sid_data *data;
+    char *sid = NULL;
+    char *name = NULL;
+    time_t expire;
+
+    /* additional checks before filling result*/
+    expire = rec->expire;
+    if (expire < time(NULL)) {
+        /* entry is now invalid */
+        return EINVAL;
+    }
+
+    data = (struct sss_mc_sid_data *)rec->data;
+
+    if (_sid != NULL) {
+        sid = strdup((char *)data + data->sid);
+        if (sid == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    if (_name != NULL) {
+        name = strdup((char *)data + data->name);
+        if (name == NULL) {
+            free(sid);
+            return ENOMEM;
+        }
+    }
+
+    if (_sid != NULL) {
+        *_sid = sid;
+    }
+    if (_name != NULL) {
+        *_name = name;
+    }
+    if (_id != NULL) {
+        *_id = data->id;
+    }
+    if (_type != NULL) {
+        *_type = data->type;
+    }
+
+    return 0;
+}
+
+errno_t sss_nss_mc_getsid(const char *key, size_t key_len,
+                          char **sid, char **name,
+                          uint32_t *id, uint32_t *type)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_sid_data *data;
+    char *rec_key;
+    uint32_t hash;
+    uint32_t slot;
+    int ret;
+    const size_t strs_offset = offsetof(struct sss_mc_sid_data, strs);
+    size_t data_size;
+
+    ret = sss_nss_mc_get_ctx("sid", &sid_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* Get max size of data table. */
+    data_size = sid_mc_ctx.dt_size;
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&sid_mc_ctx, key, key_len + 1);
+    slot = sid_mc_ctx.hash_table[hash];
+
+    /* If slot is not within the bounds of mmaped region and
+     * it's value is not MC_INVALID_VAL, then the cache is
+     * probbably corrupted. */
+    while (MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        /* free record from previous iteration */
+        free(rec);
+        rec = NULL;
+
+        ret = sss_nss_mc_get_record(&sid_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash1) {
+            /* if key hash does not match we can skip this immediately */
+            slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_sid_data *)rec->data;
+        rec_key = (char *)data + data->key;
+        /* Integrity check
+         * - key_len cannot be longer than all strings
+         * - all strings must be within the record and zero terminated
+         * - all pointers must point into the strings
+         * - size of record must be lower that data table size */
+        if (key_len > data->strs_len
+            || data->strs_len == 0
+            || (strs_offset + data->strs_len + sizeof(struct sss_mc_rec))
+                    > rec->len
+            || rec->len > data_size
+            || data->strs[data->strs_len - 1] != '\0'
+            || data->key < strs_offset
+            || data->sid < strs_offset
+            || data->name < strs_offset
+            || (data->key + key_len) > (strs_offset + data->strs_len)
+            || data->sid >= (strs_offset + data->strs_len)
+            || data->name >= (strs_offset + data->strs_len)) {
+            ret = ENOENT;
+            goto done;
+        }
+
+        if (strcmp(key, rec_key) == 0) {
+            break;
+        }
+
+        slot = sss_nss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (!MC_SLOT_WITHIN_BOUNDS(slot, data_size)) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = sss_nss_mc_parse_result(rec, sid, name, id, type);
+
+done:
+    free(rec);
+    __sync_sub_and_fetch(&sid_mc_ctx.active_threads, 1);
+    return ret;
+}
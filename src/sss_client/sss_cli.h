@@ -265,8 +265,34 @@ SSS_NSS_GETLISTBYCERT = 0x0117, /**< Takes the zero terminated string
                                      of a X509 certificate and returns a list
                                      of zero terminated fully qualified names
                                      of the related objects. */
+SSS_NSS_GETIDSBYSIDS = 0x0118, /**< Takes an unsigned 32bit integer with the
+                                    number of SIDs followed by the zero
+                                    terminated string representations of
+                                    the SIDs and returns for each of them an
+                                    unsigned 32bit error code, the type and
+                                    the POSIX ID of the related object. */
+SSS_NSS_GETSIDSBYIDS = 0x0119, /**< Takes an unsigned 32bit integer with the
+                                    number of POSIX IDs followed by the IDs
+                                    as unsigned 32bit integers and returns
+                                    for each of them an unsigned 32bit error
+                                    code, the type and the zero terminated
+                                    string representation of the SID of the
+                                    related object. */
+SSS_NSS_GETNAMESBYSIDS = 0x011A, /**< Takes the same input as
+                                      SSS_NSS_GETIDSBYSIDS and returns for
+                                      each SID an unsigned 32bit error code,
+                                      the type and the zero terminated fully
+                                      qualified name of the related
+                                      object. */
 };
 
+/** Maximal number of elements in a single SSS_NSS_GET*BY*S request. */
+#define SSS_NSS_MAX_BATCH 1024
+
+/** Maximal size of the body of a single SSS_NSS_GET*BY*S request in bytes,
+ * clients must split larger lists into several requests. */
+#define SSS_NSS_MAX_BATCH_SIZE (64 * 1024)
+
 /**
  * @}
  */ /* end of group sss_cli_command */
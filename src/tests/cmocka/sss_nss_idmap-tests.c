@@ -41,6 +41,13 @@ struct sss_nss_make_request_test_data {
     size_t replen;
     int errnop;
     enum nss_status nss_status;
+
+    /* If set, batched requests are answered with ENOENT for every element
+     * and the requests are recorded below. */
+    bool batch_echo;
+    size_t max_reqlen;
+    size_t num_elements;
+    size_t num_requests;
 };
 
 #if (__BYTE_ORDER == __LITTLE_ENDIAN)
@@ -61,6 +68,40 @@ uint8_t buf_orig1[] = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0
  #error "unknow endianess"
 #endif
 
+static enum nss_status
+batch_echo_reply(struct sss_nss_make_request_test_data *d,
+                 struct sss_cli_req_data *rd,
+                 uint8_t **repbuf, size_t *replen)
+{
+    uint32_t num;
+    size_t rp = 0;
+    size_t c;
+
+    SAFEALIGN_COPY_UINT32(&num, rd->data, NULL);
+    assert_true(num > 0 && num <= SSS_NSS_MAX_BATCH);
+    assert_true(rd->len <= SSS_NSS_MAX_BATCH_SIZE);
+
+    d->num_requests++;
+    d->num_elements += num;
+    if (rd->len > d->max_reqlen) {
+        d->max_reqlen = rd->len;
+    }
+
+    *replen = 2 * sizeof(uint32_t) + num * (2 * sizeof(uint32_t) + 1);
+    *repbuf = malloc(*replen);
+    assert_non_null(*repbuf);
+
+    SAFEALIGN_SET_UINT32(*repbuf + rp, num, &rp);
+    SAFEALIGN_SET_UINT32(*repbuf + rp, 0, &rp);
+    for (c = 0; c < num; c++) {
+        SAFEALIGN_SET_UINT32(*repbuf + rp, ENOENT, &rp);
+        SAFEALIGN_SET_UINT32(*repbuf + rp, SSS_ID_TYPE_NOT_SPECIFIED, &rp);
+        SAFEALIGN_SET_STRING(*repbuf + rp, "", 1, &rp);
+    }
+
+    return NSS_STATUS_SUCCESS;
+}
+
 enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
                       struct sss_cli_req_data *rd,
                       uint8_t **repbuf, size_t *replen,
@@ -70,6 +111,10 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
 
     d = sss_mock_ptr_type(struct sss_nss_make_request_test_data *);
 
+    if (d->batch_echo && d->nss_status == NSS_STATUS_SUCCESS) {
+        return batch_echo_reply(d, rd, repbuf, replen);
+    }
+
     *replen = d->replen;
     *errnop = d->errnop;
 
@@ -146,13 +191,133 @@ void test_getorigbyname(void **state)
     sss_nss_free_kv(kv_list);
 }
 
+void test_getnamesbysids(void **state)
+{
+    int ret;
+    uint8_t repbuf[8 + 2 * 8 + sizeof("test") + 1];
+    size_t rp = 0;
+    const char *sids[] = { "S-1-5-21-1-2-3-1000", "S-1-5-21-1-2-3-1001", "" };
+    char *names[3];
+    enum sss_id_type types[3];
+    int errors[3];
+    struct sss_nss_make_request_test_data d = {repbuf, sizeof(repbuf), 0,
+                                               NSS_STATUS_SUCCESS};
+
+    SAFEALIGN_SET_UINT32(repbuf + rp, 2, &rp);
+    SAFEALIGN_SET_UINT32(repbuf + rp, 0, &rp);
+    SAFEALIGN_SET_UINT32(repbuf + rp, EOK, &rp);
+    SAFEALIGN_SET_UINT32(repbuf + rp, SSS_ID_TYPE_UID, &rp);
+    SAFEALIGN_SET_STRING(repbuf + rp, "test", sizeof("test"), &rp);
+    SAFEALIGN_SET_UINT32(repbuf + rp, ENOENT, &rp);
+    SAFEALIGN_SET_UINT32(repbuf + rp, SSS_ID_TYPE_NOT_SPECIFIED, &rp);
+    SAFEALIGN_SET_STRING(repbuf + rp, "", 1, &rp);
+    assert_int_equal(rp, sizeof(repbuf));
+
+    ret = sss_nss_getnamesbysids(sids, 0, names, types, errors);
+    assert_int_equal(ret, EINVAL);
+
+    /* The empty SID is rejected without asking the responder. */
+    will_return(sss_nss_make_request, &d);
+    ret = sss_nss_getnamesbysids(sids, 3, names, types, errors);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(errors[0], EOK);
+    assert_int_equal(types[0], SSS_ID_TYPE_UID);
+    assert_string_equal(names[0], "test");
+    assert_int_equal(errors[1], ENOENT);
+    assert_null(names[1]);
+    assert_int_equal(errors[2], EINVAL);
+    assert_null(names[2]);
+
+    free(names[0]);
+
+    /* The number of results must match the request, a broken reply fails
+     * the elements of the request only. */
+    rp = 0;
+    SAFEALIGN_SET_UINT32(repbuf + rp, 1, &rp);
+    will_return(sss_nss_make_request, &d);
+    ret = sss_nss_getnamesbysids(sids, 3, names, types, errors);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(errors[0], EBADMSG);
+    assert_null(names[0]);
+    assert_int_equal(errors[1], EBADMSG);
+    assert_null(names[1]);
+    assert_int_equal(errors[2], EINVAL);
+}
+
+void test_getnamesbysids_full(void **state)
+{
+    int ret;
+    char **sids;
+    char *names[SSS_NSS_MAX_BATCH];
+    enum sss_id_type types[SSS_NSS_MAX_BATCH];
+    int errors[SSS_NSS_MAX_BATCH];
+    struct sss_nss_make_request_test_data d = { NULL, 0, 0,
+                                                NSS_STATUS_SUCCESS, true };
+    struct sss_nss_make_request_test_data d_fail = { NULL, 0, 0,
+                                                     NSS_STATUS_TRYAGAIN };
+    size_t failed;
+    size_t c;
+
+    /* SIDs with 15 sub-authorities do not fit into a single request. */
+    sids = calloc(SSS_NSS_MAX_BATCH, sizeof(char *));
+    assert_non_null(sids);
+    for (c = 0; c < SSS_NSS_MAX_BATCH; c++) {
+        ret = asprintf(&sids[c], "S-1-5-21-4294967295-4294967295-4294967295-"
+                       "4294967295-4294967295-4294967295-4294967295-"
+                       "4294967295-4294967295-4294967295-4294967295-"
+                       "4294967295-4294967295-4294967295-%zu", c);
+        assert_true(ret > 0);
+    }
+
+    will_return_always(sss_nss_make_request, &d);
+    ret = sss_nss_getnamesbysids((const char *const *) sids,
+                                 SSS_NSS_MAX_BATCH, names, types, errors);
+    assert_int_equal(ret, EOK);
+
+    assert_true(d.num_requests > 1);
+    assert_int_equal(d.num_elements, SSS_NSS_MAX_BATCH);
+    assert_true(d.max_reqlen <= SSS_NSS_MAX_BATCH_SIZE);
+    for (c = 0; c < SSS_NSS_MAX_BATCH; c++) {
+        assert_int_equal(errors[c], ENOENT);
+        assert_null(names[c]);
+    }
+
+    /* A failed request does not affect the elements of the others. */
+    d.num_requests = 0;
+    d.num_elements = 0;
+    will_return(sss_nss_make_request, &d_fail);
+    will_return_always(sss_nss_make_request, &d);
+    ret = sss_nss_getnamesbysids((const char *const *) sids,
+                                 SSS_NSS_MAX_BATCH, names, types, errors);
+    assert_int_equal(ret, EOK);
+
+    failed = SSS_NSS_MAX_BATCH - d.num_elements;
+    assert_true(failed > 0);
+    for (c = 0; c < SSS_NSS_MAX_BATCH; c++) {
+        assert_int_equal(errors[c], c < failed ? EAGAIN : ENOENT);
+        assert_null(names[c]);
+    }
+
+    for (c = 0; c < SSS_NSS_MAX_BATCH; c++) {
+        free(sids[c]);
+    }
+    free(sids);
+}
+
 int main(int argc, const char *argv[])
 {
 
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_getsidbyname),
         cmocka_unit_test(test_getorigbyname),
+        cmocka_unit_test(test_getnamesbysids),
+        cmocka_unit_test(test_getnamesbysids_full),
     };
 
+    /* Only the mocked responder must be used, not the memory cache of
+     * sssd running on the build host. */
+    setenv("SSS_NSS_USE_MEMCACHE", "NO", 1);
+
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
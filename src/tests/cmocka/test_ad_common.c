@@ -35,6 +35,8 @@
 #include "util/crypto/nss/nss_util.h"
 #endif
 #include "util/util_sss_idmap.h"
+#include "providers/ldap/sdap_idmap.h"
+#include "providers/ldap/sdap_async_ad.h"
 
 /* In order to access opaque types */
 #include "providers/ad/ad_common.c"
@@ -376,6 +378,278 @@ static void test_ad_get_pac_data_from_user_entry(void **state)
     sss_idmap_free(idmap_ctx);
 }
 
+#define PAC_DOM_SID "S-1-5-21-3692237560-1981608775-3610128199"
+#define PAC_USER "pacuser@"TEST_DOM1_NAME
+#define PAC_CACHED_GROUP "cachedgroup@"TEST_DOM1_NAME
+#define PAC_MISSING_GROUP "missinggroup@"TEST_DOM1_NAME
+
+bool __wrap_sdap_idmap_domain_has_algorithmic_mapping(struct sdap_idmap_ctx *ctx,
+                                                      const char *dom_name,
+                                                      const char *dom_sid)
+{
+    /* use the external IDs code path */
+    return false;
+}
+
+static size_t resolve_sids_calls;
+
+static void store_pac_group(struct sss_domain_info *dom, const char *name,
+                            gid_t gid, const char *sid)
+{
+    struct sysdb_attrs *attrs;
+    int ret;
+
+    attrs = sysdb_new_attrs(NULL);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_SID_STR, sid);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_group(dom, name, gid, attrs, 0, time(NULL));
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+struct tevent_req *
+__wrap_sdap_ad_resolve_sids_send(TALLOC_CTX *mem_ctx,
+                                 struct tevent_context *ev,
+                                 struct sdap_id_ctx *id_ctx,
+                                 struct sdap_id_conn_ctx *conn,
+                                 struct sdap_options *opts,
+                                 struct sss_domain_info *domain,
+                                 char **sids)
+{
+    struct tevent_req *req;
+    int *dummy;
+    size_t c;
+    errno_t ret;
+
+    resolve_sids_calls++;
+    ret = sss_mock_type(errno_t);
+
+    req = tevent_req_create(mem_ctx, &dummy, int);
+    assert_non_null(req);
+
+    if (ret == EOK) {
+        /* only one of the missing groups is found by the LDAP search */
+        for (c = 0; sids[c] != NULL; c++) {
+            if (strcmp(sids[c], PAC_DOM_SID"-1116") == 0) {
+                store_pac_group(domain, PAC_MISSING_GROUP, 20002, sids[c]);
+            }
+        }
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+    return req;
+}
+
+errno_t __wrap_sdap_ad_resolve_sids_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+struct ad_pac_initgr_test_ctx {
+    struct sss_test_ctx *tctx;
+
+    struct be_ctx *be_ctx;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_domain *sdom;
+    struct ldb_message *user_msg;
+};
+
+static int test_ad_pac_initgr_setup(void **state)
+{
+    struct ad_pac_initgr_test_ctx *test_ctx;
+    struct sdap_idmap_ctx *idmap_ctx;
+    struct ldb_val val;
+    enum idmap_error_code err;
+    int ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct ad_pac_initgr_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_multidom_test_ctx(test_ctx, TESTS_PATH,
+                                              TEST_CONF_DB, domains,
+                                              TEST_ID_PROVIDER, NULL);
+    assert_non_null(test_ctx->tctx);
+    test_ctx->tctx->dom->domain_id = discard_const(PAC_DOM_SID);
+
+    test_ctx->be_ctx = talloc_zero(test_ctx, struct be_ctx);
+    assert_non_null(test_ctx->be_ctx);
+    test_ctx->be_ctx->ev = test_ctx->tctx->ev;
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->opts = talloc_zero(test_ctx->id_ctx,
+                                         struct sdap_options);
+    assert_non_null(test_ctx->id_ctx->opts);
+    idmap_ctx = talloc_zero(test_ctx->id_ctx->opts, struct sdap_idmap_ctx);
+    assert_non_null(idmap_ctx);
+    err = sss_idmap_init(sss_idmap_talloc, idmap_ctx, sss_idmap_talloc_free,
+                         &idmap_ctx->map);
+    assert_int_equal(err, IDMAP_SUCCESS);
+    test_ctx->id_ctx->opts->idmap_ctx = idmap_ctx;
+
+    test_ctx->sdom = talloc_zero(test_ctx, struct sdap_domain);
+    assert_non_null(test_ctx->sdom);
+    test_ctx->sdom->dom = test_ctx->tctx->dom;
+
+    ret = sysdb_store_user(test_ctx->tctx->dom, PAC_USER, NULL,
+                           10001, 0, NULL, "/home/pacuser", "/bin/sh",
+                           NULL, NULL, NULL, 0, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    /* One group of the PAC is known, the others are not. */
+    store_pac_group(test_ctx->tctx->dom, PAC_CACHED_GROUP, 20001,
+                    PAC_DOM_SID"-1110");
+
+    test_ctx->user_msg = ldb_msg_new(test_ctx);
+    assert_non_null(test_ctx->user_msg);
+    ret = ldb_msg_add_string(test_ctx->user_msg, SYSDB_NAME, PAC_USER);
+    assert_int_equal(ret, EOK);
+    val.data = sss_base64_decode(test_ctx->user_msg, TEST_PAC_BASE64,
+                                 &val.length);
+    assert_non_null(val.data);
+    ret = ldb_msg_add_value(test_ctx->user_msg, SYSDB_PAC_BLOB, &val, NULL);
+    assert_int_equal(ret, EOK);
+
+    resolve_sids_calls = 0;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_ad_pac_initgr_teardown(void **state)
+{
+    struct ad_pac_initgr_test_ctx *test_ctx =
+        talloc_get_type(*state, struct ad_pac_initgr_test_ctx);
+
+    test_multidom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, domains);
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void ad_pac_initgr_done(struct tevent_req *req)
+{
+    struct sss_test_ctx *tctx = tevent_req_callback_data(req,
+                                                         struct sss_test_ctx);
+    errno_t ret;
+
+    ret = ad_handle_pac_initgr_recv(req, NULL, NULL, NULL);
+    talloc_free(req);
+    test_ev_done(tctx, ret);
+}
+
+static void run_pac_initgr(struct ad_pac_initgr_test_ctx *test_ctx)
+{
+    struct tevent_req *req;
+    int ret;
+
+    req = ad_handle_pac_initgr_send(test_ctx, test_ctx->be_ctx, NULL,
+                                    test_ctx->id_ctx, test_ctx->sdom, NULL,
+                                    false, test_ctx->user_msg);
+    assert_non_null(req);
+    tevent_req_set_callback(req, ad_pac_initgr_done, test_ctx->tctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    test_ctx->tctx->done = false;
+}
+
+static void assert_pac_user_groups(struct ad_pac_initgr_test_ctx *test_ctx,
+                                   size_t num_groups,
+                                   uint64_t initgr_expire)
+{
+    const char *attrs[] = { SYSDB_INITGR_EXPIRE, NULL };
+    struct ldb_result *res;
+    int ret;
+
+    ret = sysdb_initgroups(test_ctx, test_ctx->tctx->dom, PAC_USER, &res);
+    assert_int_equal(ret, EOK);
+    /* the first entry is the user */
+    assert_int_equal(res->count, num_groups + 1);
+    talloc_free(res);
+
+    ret = sysdb_get_user_attr(test_ctx, test_ctx->tctx->dom, PAC_USER,
+                              attrs, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                                 SYSDB_INITGR_EXPIRE, 0),
+                     initgr_expire);
+    talloc_free(res);
+}
+
+static void test_ad_pac_initgr_bg_refresh(void **state)
+{
+    struct ad_pac_initgr_test_ctx *test_ctx =
+        talloc_get_type(*state, struct ad_pac_initgr_test_ctx);
+
+    will_return(__wrap_sdap_ad_resolve_sids_send, EOK);
+
+    run_pac_initgr(test_ctx);
+    while (test_ctx->id_ctx->pac_bg_lookups != 0) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+
+    /* the group found in the background is added to the known one */
+    assert_int_equal(resolve_sids_calls, 1);
+    assert_pac_user_groups(test_ctx, 2, 0);
+}
+
+static void test_ad_pac_initgr_bg_failed(void **state)
+{
+    struct ad_pac_initgr_test_ctx *test_ctx =
+        talloc_get_type(*state, struct ad_pac_initgr_test_ctx);
+
+    will_return(__wrap_sdap_ad_resolve_sids_send, EIO);
+
+    run_pac_initgr(test_ctx);
+    while (test_ctx->id_ctx->pac_bg_lookups != 0) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+
+    /* the missing groups are looked up by the next initgroups request */
+    assert_int_equal(resolve_sids_calls, 1);
+    assert_pac_user_groups(test_ctx, 1, 1);
+}
+
+static void test_ad_pac_initgr_bg_limit(void **state)
+{
+    struct ad_pac_initgr_test_ctx *test_ctx =
+        talloc_get_type(*state, struct ad_pac_initgr_test_ctx);
+
+    test_ctx->id_ctx->pac_bg_lookups = AD_PAC_BG_LOOKUPS_MAX;
+
+    run_pac_initgr(test_ctx);
+
+    /* no lookup is started, the missing groups are looked up by the next
+     * initgroups request */
+    assert_int_equal(resolve_sids_calls, 0);
+    assert_int_equal(test_ctx->id_ctx->pac_bg_lookups, AD_PAC_BG_LOOKUPS_MAX);
+    assert_pac_user_groups(test_ctx, 1, 1);
+
+    /* a lookup is started again once one of the running ones finished */
+    test_ctx->id_ctx->pac_bg_lookups = AD_PAC_BG_LOOKUPS_MAX - 1;
+    will_return(__wrap_sdap_ad_resolve_sids_send, EOK);
+
+    run_pac_initgr(test_ctx);
+    assert_int_equal(resolve_sids_calls, 1);
+    while (test_ctx->id_ctx->pac_bg_lookups != AD_PAC_BG_LOOKUPS_MAX - 1) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+    assert_pac_user_groups(test_ctx, 2, 1);
+    test_ctx->id_ctx->pac_bg_lookups = 0;
+}
+
 krb5_error_code __wrap_krb5_kt_default(krb5_context context, krb5_keytab *id)
 {
     return krb5_kt_resolve(context, KEYTAB_PATH, id);
@@ -912,6 +1186,15 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_ad_get_pac_data_from_user_entry,
                                         test_ad_common_setup,
                                         test_ad_common_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_pac_initgr_bg_refresh,
+                                        test_ad_pac_initgr_setup,
+                                        test_ad_pac_initgr_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_pac_initgr_bg_failed,
+                                        test_ad_pac_initgr_setup,
+                                        test_ad_pac_initgr_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_pac_initgr_bg_limit,
+                                        test_ad_pac_initgr_setup,
+                                        test_ad_pac_initgr_teardown),
         cmocka_unit_test_setup_teardown(test_netlogon_get_domain_info,
                                         test_ad_common_setup,
                                         test_ad_common_teardown),
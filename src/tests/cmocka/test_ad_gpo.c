@@ -329,6 +329,112 @@ void test_ad_gpo_ace_includes_client_sid_false(void **state)
                                         ace_dom_sid, false);
 }
 
+/*
+ * Test keys of memoized access decisions
+ */
+void test_ad_gpo_decision_key(void **state)
+{
+    const char *fingerprint = "{31B2F340-016D-11D2-945F-00C04FB984F9}:3;";
+    const char *user_sid = "S-1-5-21-2-3-4-1103";
+    const char *group_sids[] = {"S-1-5-21-2-3-4-513",
+                                "S-1-5-11",
+                                "S-1-5-21-2-3-4-1110"};
+    const char *other_group_sids[] = {"S-1-5-21-2-3-4-1110",
+                                      "S-1-5-21-2-3-4-513",
+                                      "S-1-5-11",
+                                      "S-1-5-21-2-3-4-513"};
+    char *key;
+    char *other_key;
+    TALLOC_CTX *tmp_ctx;
+
+    tmp_ctx = talloc_new(global_talloc_context);
+    assert_non_null(tmp_ctx);
+    check_leaks_push(tmp_ctx);
+
+    key = ad_gpo_decision_key(tmp_ctx, fingerprint, GPO_MAP_INTERACTIVE,
+                              user_sid, group_sids, 3);
+    assert_non_null(key);
+
+    /* order and duplicates of the group SIDs do not matter */
+    other_key = ad_gpo_decision_key(tmp_ctx, fingerprint, GPO_MAP_INTERACTIVE,
+                                    user_sid, other_group_sids, 4);
+    assert_non_null(other_key);
+    assert_string_equal(key, other_key);
+    talloc_free(other_key);
+
+    other_key = ad_gpo_decision_key(tmp_ctx, fingerprint, GPO_MAP_INTERACTIVE,
+                                    user_sid, group_sids, 2);
+    assert_non_null(other_key);
+    assert_string_not_equal(key, other_key);
+    talloc_free(other_key);
+
+    other_key = ad_gpo_decision_key(tmp_ctx, fingerprint, GPO_MAP_NETWORK,
+                                    user_sid, group_sids, 3);
+    assert_non_null(other_key);
+    assert_string_not_equal(key, other_key);
+    talloc_free(other_key);
+
+    other_key = ad_gpo_decision_key(tmp_ctx,
+                                    "{31B2F340-016D-11D2-945F-00C04FB984F9}:4;",
+                                    GPO_MAP_INTERACTIVE,
+                                    user_sid, group_sids, 3);
+    assert_non_null(other_key);
+    assert_string_not_equal(key, other_key);
+    talloc_free(other_key);
+
+    talloc_free(key);
+    assert_true(check_leaks_pop(tmp_ctx) == true);
+    talloc_free(tmp_ctx);
+}
+
+/*
+ * Test merging the policy settings of several GPOs
+ */
+void test_ad_gpo_merge_policy_settings(void **state)
+{
+    struct gpo_policy_settings *result;
+    struct gpo_policy_settings *first;
+    struct gpo_policy_settings *second;
+    errno_t ret;
+
+    result = talloc_zero(test_ctx, struct gpo_policy_settings);
+    assert_non_null(result);
+    first = talloc_zero(test_ctx, struct gpo_policy_settings);
+    assert_non_null(first);
+    second = talloc_zero(test_ctx, struct gpo_policy_settings);
+    assert_non_null(second);
+
+    first->allow[GPO_MAP_INTERACTIVE].present = true;
+    first->allow[GPO_MAP_INTERACTIVE].value = talloc_strdup(first, "*S-1-1");
+    first->deny[GPO_MAP_NETWORK].present = true;
+    first->deny[GPO_MAP_NETWORK].value = talloc_strdup(first, "*S-1-2");
+
+    /* explicitly empty setting */
+    second->allow[GPO_MAP_INTERACTIVE].present = true;
+    second->allow[GPO_MAP_INTERACTIVE].value = NULL;
+    second->allow[GPO_MAP_BATCH].present = true;
+    second->allow[GPO_MAP_BATCH].value = talloc_strdup(second, "*S-1-3");
+
+    ret = ad_gpo_merge_policy_settings(result, first);
+    assert_int_equal(ret, EOK);
+    ret = ad_gpo_merge_policy_settings(result, second);
+    assert_int_equal(ret, EOK);
+    talloc_free(first);
+    talloc_free(second);
+
+    /* the GPO processed later takes precedence */
+    assert_true(result->allow[GPO_MAP_INTERACTIVE].present);
+    assert_null(result->allow[GPO_MAP_INTERACTIVE].value);
+    /* settings which are not present do not override */
+    assert_true(result->deny[GPO_MAP_NETWORK].present);
+    assert_string_equal(result->deny[GPO_MAP_NETWORK].value, "*S-1-2");
+    assert_true(result->allow[GPO_MAP_BATCH].present);
+    assert_string_equal(result->allow[GPO_MAP_BATCH].value, "*S-1-3");
+    assert_false(result->allow[GPO_MAP_SERVICE].present);
+
+    talloc_free(result);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -364,6 +470,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_ad_gpo_ace_includes_client_sid_false,
                                         ad_gpo_test_setup,
                                         ad_gpo_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_gpo_decision_key,
+                                        ad_gpo_test_setup,
+                                        ad_gpo_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_gpo_merge_policy_settings,
+                                        ad_gpo_test_setup,
+                                        ad_gpo_test_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
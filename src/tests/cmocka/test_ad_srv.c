@@ -0,0 +1,679 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests: AD site discovery tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ldap/ldap_opts.h"
+
+/* In order to access the static functions */
+#include "providers/ad/ad_srv.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_ad_srv_conf.ldb"
+#define TEST_DOM_NAME "ad_srv_test"
+#define TEST_ID_PROVIDER "ad"
+
+#define AD_DOMAIN "ad.domain.test"
+#define AD_FOREST "forest.test"
+
+#define TEST_ATTR_SITE "testSite"
+
+/* Behaviour of a fake domain controller */
+struct test_dc {
+    const char *host;
+    /* the connection is established or fails after this time, a negative
+     * value means that the DC never answers */
+    int delay_ms;
+    errno_t connect_ret;
+    /* NULL if the reply does not contain netlogon data */
+    const char *site;
+
+    struct sdap_handle *sh;
+};
+
+static struct test_dc *test_dcs;
+static size_t num_test_dcs;
+static size_t pending_pings;
+static size_t max_pending_pings;
+static size_t connect_calls;
+
+struct mock_connect_state {
+    struct test_dc *dc;
+    struct sdap_handle *sh;
+};
+
+static int mock_connect_state_destructor(struct mock_connect_state *state)
+{
+    pending_pings--;
+    return 0;
+}
+
+static void mock_connect_done(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv,
+                              void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct mock_connect_state *state;
+
+    state = tevent_req_data(req, struct mock_connect_state);
+
+    if (state->dc->connect_ret != EOK) {
+        tevent_req_error(req, state->dc->connect_ret);
+        return;
+    }
+
+    state->sh = talloc_zero(state, struct sdap_handle);
+    assert_non_null(state->sh);
+    state->dc->sh = state->sh;
+
+    tevent_req_done(req);
+}
+
+struct tevent_req *__wrap_sdap_connect_host_send(TALLOC_CTX *mem_ctx,
+                                                 struct tevent_context *ev,
+                                                 struct sdap_options *opts,
+                                                 struct resolv_ctx *resolv_ctx,
+                                                 enum restrict_family family_order,
+                                                 enum host_database *host_db,
+                                                 const char *protocol,
+                                                 const char *host,
+                                                 int port,
+                                                 bool use_start_tls)
+{
+    struct mock_connect_state *state;
+    struct tevent_timer *te;
+    struct tevent_req *req;
+    size_t i;
+
+    req = tevent_req_create(mem_ctx, &state, struct mock_connect_state);
+    assert_non_null(req);
+
+    for (i = 0; i < num_test_dcs; i++) {
+        if (strcmp(test_dcs[i].host, host) == 0) {
+            state->dc = &test_dcs[i];
+            break;
+        }
+    }
+    assert_non_null(state->dc);
+
+    connect_calls++;
+    pending_pings++;
+    if (pending_pings > max_pending_pings) {
+        max_pending_pings = pending_pings;
+    }
+    talloc_set_destructor(state, mock_connect_state_destructor);
+
+    if (state->dc->delay_ms >= 0) {
+        te = tevent_add_timer(ev, state,
+                              tevent_timeval_current_ofs(0,
+                                            state->dc->delay_ms * 1000),
+                              mock_connect_done, req);
+        assert_non_null(te);
+    }
+
+    return req;
+}
+
+errno_t __wrap_sdap_connect_host_recv(TALLOC_CTX *mem_ctx,
+                                      struct tevent_req *req,
+                                      struct sdap_handle **_sh)
+{
+    struct mock_connect_state *state;
+
+    state = tevent_req_data(req, struct mock_connect_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_sh = talloc_steal(mem_ctx, state->sh);
+    return EOK;
+}
+
+struct mock_search_state {
+    size_t reply_count;
+    struct sysdb_attrs **reply;
+};
+
+struct tevent_req *__wrap_sdap_get_generic_send(TALLOC_CTX *memctx,
+                                                struct tevent_context *ev,
+                                                struct sdap_options *opts,
+                                                struct sdap_handle *sh,
+                                                const char *search_base,
+                                                int scope,
+                                                const char *filter,
+                                                const char **attrs,
+                                                struct sdap_attr_map *map,
+                                                int map_num_attrs,
+                                                int timeout,
+                                                bool allow_paging)
+{
+    struct mock_search_state *state;
+    struct test_dc *dc = NULL;
+    struct tevent_req *req;
+    size_t i;
+    int ret;
+
+    req = tevent_req_create(memctx, &state, struct mock_search_state);
+    assert_non_null(req);
+
+    for (i = 0; i < num_test_dcs; i++) {
+        if (test_dcs[i].sh == sh) {
+            dc = &test_dcs[i];
+            dc->sh = NULL;
+            break;
+        }
+    }
+    assert_non_null(dc);
+
+    if (dc->site != NULL) {
+        state->reply = talloc_zero_array(state, struct sysdb_attrs *, 1);
+        assert_non_null(state->reply);
+        state->reply[0] = sysdb_new_attrs(state->reply);
+        assert_non_null(state->reply[0]);
+        ret = sysdb_attrs_add_string(state->reply[0], TEST_ATTR_SITE,
+                                     dc->site);
+        assert_int_equal(ret, EOK);
+        state->reply_count = 1;
+    }
+
+    tevent_req_done(req);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+int __wrap_sdap_get_generic_recv(struct tevent_req *req,
+                                 TALLOC_CTX *mem_ctx, size_t *reply_count,
+                                 struct sysdb_attrs ***reply_list)
+{
+    struct mock_search_state *state;
+
+    state = tevent_req_data(req, struct mock_search_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *reply_count = state->reply_count;
+    *reply_list = talloc_steal(mem_ctx, state->reply);
+    return EOK;
+}
+
+errno_t __wrap_netlogon_get_domain_info(TALLOC_CTX *mem_ctx,
+                                        struct sysdb_attrs *reply,
+                                        bool check_next_nearest_site_as_well,
+                                        char **_flat_name,
+                                        char **_site,
+                                        char **_forest)
+{
+    const char *site;
+    errno_t ret;
+
+    ret = sysdb_attrs_get_string(reply, TEST_ATTR_SITE, &site);
+    assert_int_equal(ret, EOK);
+
+    *_site = talloc_strdup(mem_ctx, site);
+    assert_non_null(*_site);
+    *_forest = talloc_strdup(mem_ctx, AD_FOREST);
+    assert_non_null(*_forest);
+
+    return EOK;
+}
+
+static char *discovered_primary_domain;
+
+struct tevent_req *__wrap_fo_discover_servers_send(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_context *ev,
+                                                   struct resolv_ctx *resolv_ctx,
+                                                   const char *service,
+                                                   const char *protocol,
+                                                   const char *primary_domain,
+                                                   const char *backup_domain)
+{
+    struct tevent_req *req;
+    int *dummy;
+
+    discovered_primary_domain = talloc_strdup(global_talloc_context,
+                                              primary_domain);
+    assert_non_null(discovered_primary_domain);
+
+    req = tevent_req_create(mem_ctx, &dummy, int);
+    assert_non_null(req);
+
+    tevent_req_done(req);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+errno_t __wrap_fo_discover_servers_recv(TALLOC_CTX *mem_ctx,
+                                        struct tevent_req *req,
+                                        char **_dns_domain,
+                                        uint32_t *_ttl,
+                                        struct fo_server_info **_primary_servers,
+                                        size_t *_num_primary_servers,
+                                        struct fo_server_info **_backup_servers,
+                                        size_t *_num_backup_servers)
+{
+    struct fo_server_info *primary;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    primary = talloc_zero_array(mem_ctx, struct fo_server_info, 1);
+    assert_non_null(primary);
+    primary[0].host = talloc_strdup(primary, "dc1."AD_DOMAIN);
+    assert_non_null(primary[0].host);
+    primary[0].port = 389;
+
+    *_dns_domain = talloc_strdup(mem_ctx, AD_DOMAIN);
+    *_ttl = 600;
+    *_primary_servers = primary;
+    *_num_primary_servers = 1;
+    *_backup_servers = NULL;
+    *_num_backup_servers = 0;
+
+    return EOK;
+}
+
+struct ad_srv_test_ctx {
+    struct sss_test_ctx *tctx;
+
+    struct be_resolv_ctx *be_res;
+    enum host_database host_db[2];
+    struct sdap_options *opts;
+
+    const char *site;
+    const char *forest;
+    struct ad_dc_latency *latency;
+    size_t num_latency;
+};
+
+static int ad_srv_test_setup(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct ad_srv_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->be_res = talloc_zero(test_ctx, struct be_resolv_ctx);
+    assert_non_null(test_ctx->be_res);
+
+    test_ctx->host_db[0] = DB_DNS;
+    test_ctx->host_db[1] = DB_SENTINEL;
+
+    test_ctx->opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(test_ctx->opts);
+    ret = dp_copy_defaults(test_ctx->opts, default_basic_opts,
+                           SDAP_OPTS_BASIC, &test_ctx->opts->basic);
+    assert_int_equal(ret, EOK);
+
+    test_dcs = NULL;
+    num_test_dcs = 0;
+    pending_pings = 0;
+    max_pending_pings = 0;
+    connect_calls = 0;
+    discovered_primary_domain = NULL;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int ad_srv_test_teardown(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type(*state, struct ad_srv_test_ctx);
+    assert_non_null(test_ctx);
+
+    talloc_zfree(discovered_primary_domain);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void get_client_site_done(struct tevent_req *req)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = tevent_req_callback_data(req, struct ad_srv_test_ctx);
+
+    ret = ad_get_client_site_recv(test_ctx, req,
+                                  &test_ctx->site, &test_ctx->forest,
+                                  &test_ctx->latency,
+                                  &test_ctx->num_latency);
+    talloc_free(req);
+    test_ev_done(test_ctx->tctx, ret);
+}
+
+static errno_t run_get_client_site(struct ad_srv_test_ctx *test_ctx,
+                                   struct test_dc *dcs,
+                                   size_t num_dcs)
+{
+    struct fo_server_info *servers;
+    struct tevent_req *req;
+    size_t i;
+
+    test_dcs = dcs;
+    num_test_dcs = num_dcs;
+
+    servers = talloc_zero_array(test_ctx, struct fo_server_info, num_dcs);
+    assert_non_null(servers);
+    for (i = 0; i < num_dcs; i++) {
+        servers[i].host = discard_const(dcs[i].host);
+        servers[i].port = 389;
+    }
+
+    req = ad_get_client_site_send(test_ctx, test_ctx->tctx->ev,
+                                  test_ctx->be_res, test_ctx->host_db,
+                                  test_ctx->opts, AD_DOMAIN,
+                                  servers, num_dcs);
+    assert_non_null(req);
+    tevent_req_set_callback(req, get_client_site_done, test_ctx);
+
+    return test_ev_loop(test_ctx->tctx);
+}
+
+static void assert_dc_replied(struct ad_dc_latency *latency,
+                              const char *host)
+{
+    assert_string_equal(latency->host, host);
+    assert_true(latency->msecs != AD_DC_LATENCY_UNKNOWN);
+    assert_true(latency->msecs != AD_DC_LATENCY_UNREACHABLE);
+}
+
+static void test_ad_get_client_site_parallel(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    struct test_dc dcs[] = {
+        { "dc1."AD_DOMAIN, 50, ETIMEDOUT, NULL, NULL },
+        { "dc2."AD_DOMAIN, 50, ETIMEDOUT, NULL, NULL },
+        { "dc3."AD_DOMAIN, 50, ETIMEDOUT, NULL, NULL },
+        { "dc4."AD_DOMAIN, 50, ETIMEDOUT, NULL, NULL },
+        { "dc5."AD_DOMAIN, 50, ETIMEDOUT, NULL, NULL },
+        { "dc6."AD_DOMAIN, -1, EOK, NULL, NULL },
+        { "dc7."AD_DOMAIN, 10, EOK, "site7", NULL },
+    };
+    size_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ad_srv_test_ctx);
+
+    ret = run_get_client_site(test_ctx, dcs, 7);
+    assert_int_equal(ret, EOK);
+
+    /* the last two DCs are pinged once the first ones failed */
+    assert_int_equal(max_pending_pings, AD_CLDAP_PING_PARALLEL);
+    assert_int_equal(connect_calls, 7);
+    assert_int_equal(pending_pings, 0);
+
+    assert_string_equal(test_ctx->site, "site7");
+    assert_string_equal(test_ctx->forest, AD_FOREST);
+
+    assert_int_equal(test_ctx->num_latency, 7);
+    for (i = 0; i < 5; i++) {
+        assert_string_equal(test_ctx->latency[i].host, dcs[i].host);
+        assert_int_equal(test_ctx->latency[i].msecs,
+                         AD_DC_LATENCY_UNREACHABLE);
+    }
+    /* the ping was cancelled */
+    assert_int_equal(test_ctx->latency[5].msecs, AD_DC_LATENCY_UNKNOWN);
+    assert_dc_replied(&test_ctx->latency[6], dcs[6].host);
+}
+
+static void test_ad_get_client_site_first_reply(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    struct test_dc dcs[] = {
+        { "dc1."AD_DOMAIN, 500, EOK, "slow", NULL },
+        { "dc2."AD_DOMAIN, 10, EOK, NULL, NULL },
+        { "dc3."AD_DOMAIN, 30, EOK, "fast", NULL },
+        { "dc4."AD_DOMAIN, -1, EOK, NULL, NULL },
+    };
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ad_srv_test_ctx);
+
+    ret = run_get_client_site(test_ctx, dcs, 4);
+    assert_int_equal(ret, EOK);
+
+    /* all DCs are pinged at once, the remaining pings are cancelled */
+    assert_int_equal(max_pending_pings, 4);
+    assert_int_equal(pending_pings, 0);
+
+    assert_string_equal(test_ctx->site, "fast");
+
+    assert_int_equal(test_ctx->num_latency, 4);
+    assert_int_equal(test_ctx->latency[0].msecs, AD_DC_LATENCY_UNKNOWN);
+    /* a reply without netlogon data is treated as a failed ping */
+    assert_int_equal(test_ctx->latency[1].msecs, AD_DC_LATENCY_UNREACHABLE);
+    assert_dc_replied(&test_ctx->latency[2], dcs[2].host);
+    assert_true(test_ctx->latency[2].msecs < 500);
+    assert_int_equal(test_ctx->latency[3].msecs, AD_DC_LATENCY_UNKNOWN);
+}
+
+static void test_ad_get_client_site_no_reply(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    struct test_dc dcs[] = {
+        { "dc1."AD_DOMAIN, 10, ETIMEDOUT, NULL, NULL },
+        { "dc2."AD_DOMAIN, 20, EOK, NULL, NULL },
+    };
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ad_srv_test_ctx);
+
+    ret = run_get_client_site(test_ctx, dcs, 2);
+    assert_int_equal(ret, ENOENT);
+    assert_int_equal(pending_pings, 0);
+}
+
+static void test_ad_srv_store_load_site(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    struct ad_srv_plugin_ctx *ctx;
+    struct sysdb_attrs *attrs;
+    struct ad_dc_latency latency[] = {
+        { "dc1."AD_DOMAIN, 15 },
+        { "dc2."AD_DOMAIN, AD_DC_LATENCY_UNREACHABLE },
+        { "dc3."AD_DOMAIN, AD_DC_LATENCY_UNKNOWN },
+    };
+    struct fo_server_info dcs[] = {
+        { discard_const("dc2."AD_DOMAIN), 389, 0 },
+        { discard_const("dc3."AD_DOMAIN), 389, 0 },
+        { discard_const("dc1."AD_DOMAIN), 389, 0 },
+    };
+    const char *site;
+    const char *forest;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ad_srv_test_ctx);
+
+    ctx = ad_srv_plugin_ctx_init(test_ctx, test_ctx->be_res,
+                                 test_ctx->tctx->dom, test_ctx->host_db,
+                                 test_ctx->opts, "client."AD_DOMAIN,
+                                 AD_DOMAIN, NULL);
+    assert_non_null(ctx);
+
+    ret = ad_srv_update_latency(ctx, latency, 3);
+    assert_int_equal(ret, EOK);
+    /* DCs without a result are not remembered */
+    assert_int_equal(ctx->num_latency, 2);
+
+    ret = ad_srv_store_site(ctx, AD_DOMAIN, "site1", AD_FOREST);
+    assert_int_equal(ret, EOK);
+    talloc_free(ctx);
+
+    /* a new context, e.g. after restart, reads the stored data */
+    ctx = ad_srv_plugin_ctx_init(test_ctx, test_ctx->be_res,
+                                 test_ctx->tctx->dom, test_ctx->host_db,
+                                 test_ctx->opts, "client."AD_DOMAIN,
+                                 AD_DOMAIN, NULL);
+    assert_non_null(ctx);
+
+    ret = ad_srv_load_site(test_ctx, ctx, AD_DOMAIN, &site, &forest);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(site, "site1");
+    assert_string_equal(forest, AD_FOREST);
+    talloc_free(discard_const(site));
+    talloc_free(discard_const(forest));
+
+    assert_int_equal(ctx->num_latency, 2);
+    assert_int_equal(ad_srv_dc_latency(ctx, "dc1."AD_DOMAIN), 15);
+    assert_int_equal(ad_srv_dc_latency(ctx, "dc2."AD_DOMAIN),
+                     AD_DC_LATENCY_UNREACHABLE);
+    assert_int_equal(ad_srv_dc_latency(ctx, "dc3."AD_DOMAIN),
+                     AD_DC_LATENCY_UNKNOWN);
+
+    /* DCs that replied first, unknown ones next, unreachable ones last */
+    ad_srv_rank_dcs(ctx, dcs, 3);
+    assert_string_equal(dcs[0].host, "dc1."AD_DOMAIN);
+    assert_string_equal(dcs[1].host, "dc3."AD_DOMAIN);
+    assert_string_equal(dcs[2].host, "dc2."AD_DOMAIN);
+
+    /* the stored site is not used once it is too old */
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_time_t(attrs, SYSDB_LAST_UPDATE,
+                                 time(NULL) - AD_SITE_MAX_AGE - 1);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_store_custom(test_ctx->tctx->dom, AD_DOMAIN,
+                             AD_SITE_SUBTREE, attrs);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+
+    ret = ad_srv_load_site(test_ctx, ctx, AD_DOMAIN, &site, &forest);
+    assert_int_equal(ret, ENOENT);
+
+    talloc_free(ctx);
+}
+
+static void srv_plugin_done(struct tevent_req *req)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = tevent_req_callback_data(req, struct ad_srv_test_ctx);
+
+    ret = ad_srv_plugin_recv(test_ctx, req, NULL, NULL, NULL, NULL,
+                             NULL, NULL);
+    talloc_free(req);
+    test_ev_done(test_ctx->tctx, ret);
+}
+
+static void test_ad_srv_plugin_stored_site(void **state)
+{
+    struct ad_srv_test_ctx *test_ctx;
+    struct ad_srv_plugin_ctx *ctx;
+    struct tevent_req *req;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ad_srv_test_ctx);
+
+    ctx = ad_srv_plugin_ctx_init(test_ctx, test_ctx->be_res,
+                                 test_ctx->tctx->dom, test_ctx->host_db,
+                                 test_ctx->opts, "client."AD_DOMAIN,
+                                 AD_DOMAIN, NULL);
+    assert_non_null(ctx);
+
+    ret = ad_srv_store_site(ctx, AD_DOMAIN, "site1", AD_FOREST);
+    assert_int_equal(ret, EOK);
+
+    /* the first lookup uses the stored site without pinging any DC */
+    req = ad_srv_plugin_send(test_ctx, test_ctx->tctx->ev, "ldap", "tcp",
+                             NULL, ctx);
+    assert_non_null(req);
+    tevent_req_set_callback(req, srv_plugin_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    assert_true(ctx->site_loaded);
+    assert_int_equal(connect_calls, 0);
+    assert_string_equal(discovered_primary_domain,
+                        "site1._sites."AD_DOMAIN);
+
+    talloc_free(ctx);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_ad_get_client_site_parallel,
+                                        ad_srv_test_setup,
+                                        ad_srv_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_get_client_site_first_reply,
+                                        ad_srv_test_setup,
+                                        ad_srv_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_get_client_site_no_reply,
+                                        ad_srv_test_setup,
+                                        ad_srv_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_srv_store_load_site,
+                                        ad_srv_test_setup,
+                                        ad_srv_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_srv_plugin_stored_site,
+                                        ad_srv_test_setup,
+                                        ad_srv_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    return rv;
+}
@@ -26,7 +26,14 @@
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
 #include "responder/ifp/ifp_private.h"
+#include "responder/ifp/ifp_users.h"
 #include "sbus/sssd_dbus_private.h"
+#include "sbus/sssd_dbus_errors.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_ifp_conf.ldb"
+#define TEST_DOM_NAME "ifp_test"
+#define TEST_ID_PROVIDER "ldap"
 
 /* dbus library checks for valid object paths when unit testing, we don't
  * want that */
@@ -34,14 +41,16 @@
 #define DBUS_TYPE_OBJECT_PATH ((int) 's')
 
 static struct ifp_ctx *
-mock_ifp_ctx(TALLOC_CTX *mem_ctx)
+mock_ifp_ctx(TALLOC_CTX *mem_ctx,
+             struct tevent_context *ev,
+             struct sss_domain_info *domains)
 {
     struct ifp_ctx *ifp_ctx;
 
     ifp_ctx = talloc_zero(mem_ctx, struct ifp_ctx);
     assert_non_null(ifp_ctx);
 
-    ifp_ctx->rctx = mock_rctx(ifp_ctx, NULL, NULL, NULL);
+    ifp_ctx->rctx = mock_rctx(ifp_ctx, ev, domains, NULL);
     assert_non_null(ifp_ctx->rctx);
 
     ifp_ctx->rctx->allowed_uids = talloc_array(ifp_ctx->rctx, uint32_t, 1);
@@ -87,7 +96,7 @@ void ifp_test_req_create(void **state)
 
     assert_true(leak_check_setup());
 
-    ifp_ctx = mock_ifp_ctx(global_talloc_context);
+    ifp_ctx = mock_ifp_ctx(global_talloc_context, NULL, NULL);
     assert_non_null(ifp_ctx);
     check_leaks_push(ifp_ctx);
 
@@ -117,7 +126,7 @@ void ifp_test_req_wrong_uid(void **state)
 
     assert_true(leak_check_setup());
 
-    ifp_ctx = mock_ifp_ctx(global_talloc_context);
+    ifp_ctx = mock_ifp_ctx(global_talloc_context, NULL, NULL);
     assert_non_null(ifp_ctx);
     check_leaks_push(ifp_ctx);
 
@@ -358,6 +367,108 @@ void test_attr_allowed(void **state)
     assert_false(ifp_attr_allowed(NULL, "name"));
 }
 
+void test_list_limit(void **state)
+{
+    struct ifp_ctx ctx = { 0 };
+
+    /* No configured limit */
+    assert_int_equal(ifp_list_limit(&ctx, 0), 0);
+    assert_int_equal(ifp_list_limit(&ctx, 50), 50);
+
+    /* The configured limit caps the client supplied one */
+    ctx.wildcard_limit = 100;
+    assert_int_equal(ifp_list_limit(&ctx, 0), 100);
+    assert_int_equal(ifp_list_limit(&ctx, 50), 50);
+    assert_int_equal(ifp_list_limit(&ctx, 500), 100);
+}
+
+static int ifp_test_sysdb_setup(void **state)
+{
+    struct sss_test_ctx *tctx;
+
+    assert_true(leak_check_setup());
+
+    test_dom_suite_setup(TESTS_PATH);
+    tctx = create_dom_test_ctx(global_talloc_context, TESTS_PATH,
+                               TEST_CONF_DB, TEST_DOM_NAME,
+                               TEST_ID_PROVIDER, NULL);
+    assert_non_null(tctx);
+
+    *state = tctx;
+    return 0;
+}
+
+static int ifp_test_sysdb_teardown(void **state)
+{
+    struct sss_test_ctx *tctx = talloc_get_type_abort(*state,
+                                                      struct sss_test_ctx);
+
+    talloc_free(tctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+void test_dn_filter(void **state)
+{
+    struct sss_test_ctx *tctx = talloc_get_type_abort(*state,
+                                                      struct sss_test_ctx);
+    /* Names with characters that have a special meaning in a filter */
+    const char *names[] = { "foo*", "foo(1)", "foo\\2", "foobar", NULL };
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_message *page[3];
+    struct ldb_message **msgs;
+    const char *name;
+    size_t count;
+    char *filter;
+    size_t i;
+    size_t j;
+    errno_t ret;
+
+    for (i = 0; names[i] != NULL; i++) {
+        ret = sysdb_add_user(tctx->dom, names[i], 1000 + i, 1000 + i,
+                             NULL, NULL, NULL, NULL, NULL, 0, 0);
+        assert_int_equal(ret, EOK);
+    }
+
+    /* The page holds all users but the last one */
+    for (i = 0; i < 3; i++) {
+        ret = sysdb_search_user_by_name(tctx, tctx->dom, names[i],
+                                        NULL, &page[i]);
+        assert_int_equal(ret, EOK);
+    }
+
+    filter = ifp_dn_filter(tctx, page, 3);
+    assert_non_null(filter);
+
+    ret = sysdb_search_users(tctx, tctx->dom, filter, attrs, &count, &msgs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(count, 3);
+
+    for (i = 0; i < count; i++) {
+        name = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
+        assert_non_null(name);
+
+        for (j = 0; j < 3; j++) {
+            if (strcmp(name, names[j]) == 0) {
+                break;
+            }
+        }
+        assert_true(j < 3);
+    }
+
+    /* A page of a single object matches exactly that object */
+    filter = ifp_dn_filter(tctx, &page[0], 1);
+    assert_non_null(filter);
+
+    ret = sysdb_search_users(tctx, tctx->dom, filter, attrs, &count, &msgs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(count, 1);
+    assert_string_equal(ldb_msg_find_attr_as_string(msgs[0], SYSDB_NAME, NULL),
+                        names[0]);
+}
+
 struct ifp_test_req_ctx {
     struct ifp_req *ireq;
     struct sbus_request *sr;
@@ -373,7 +484,7 @@ static int ifp_test_req_setup(void **state)
 
     test_ctx = talloc_zero(global_talloc_context, struct ifp_test_req_ctx);
     assert_non_null(test_ctx);
-    test_ctx->ifp_ctx = mock_ifp_ctx(test_ctx);
+    test_ctx->ifp_ctx = mock_ifp_ctx(test_ctx, NULL, NULL);
     assert_non_null(test_ctx->ifp_ctx);
 
     test_ctx->sr = mock_sbus_request(test_ctx, geteuid());
@@ -402,6 +513,254 @@ static int ifp_test_req_teardown(void **state)
     return 0;
 }
 
+struct ifp_test_list_ctx {
+    struct sss_test_ctx *tctx;
+    struct ifp_ctx *ifp_ctx;
+    DBusMessage *reply;
+};
+
+static struct ifp_test_list_ctx *global_list_ctx;
+
+/* Catch the reply instead of sending it */
+void __wrap_sbus_conn_send_reply(struct sbus_connection *conn,
+                                 DBusMessage *reply)
+{
+    assert_non_null(global_list_ctx);
+    assert_null(global_list_ctx->reply);
+
+    global_list_ctx->reply = dbus_message_ref(reply);
+    global_list_ctx->tctx->done = true;
+}
+
+static int ifp_test_list_setup(void **state)
+{
+    struct ifp_test_list_ctx *test_ctx;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct ifp_test_list_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->ifp_ctx = mock_ifp_ctx(test_ctx, test_ctx->tctx->ev,
+                                     test_ctx->tctx->dom);
+    assert_non_null(test_ctx->ifp_ctx);
+
+    /* The default whitelist */
+    test_ctx->ifp_ctx->user_whitelist = ifp_parse_user_attr_list(
+                                                    test_ctx->ifp_ctx, NULL);
+    assert_non_null(test_ctx->ifp_ctx->user_whitelist);
+
+    global_list_ctx = test_ctx;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int ifp_test_list_teardown(void **state)
+{
+    struct ifp_test_list_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct ifp_test_list_ctx);
+
+    if (test_ctx->reply != NULL) {
+        dbus_message_unref(test_ctx->reply);
+    }
+
+    global_list_ctx = NULL;
+    talloc_free(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+/* Stores the user when the data provider is asked for it, so that it is
+ * found by the filter search which only returns fresh objects */
+static int ifp_test_store_user(void *pvt)
+{
+    struct ifp_test_list_ctx *test_ctx;
+    struct sysdb_attrs *attrs;
+    char *name;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(pvt, struct ifp_test_list_ctx);
+
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_UPN, "foo@IFP.TEST");
+    assert_int_equal(ret, EOK);
+
+    name = sss_create_internal_fqname(test_ctx, "foo",
+                                      test_ctx->tctx->dom->name);
+    assert_non_null(name);
+
+    ret = sysdb_store_user(test_ctx->tctx->dom, name, NULL, 1000, 1000,
+                           NULL, "/home/foo", "/bin/sh", NULL, attrs, NULL,
+                           1000, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    talloc_free(name);
+    talloc_free(attrs);
+    return EOK;
+}
+
+static void ifp_test_list_attrs(struct ifp_test_list_ctx *test_ctx,
+                                const char *domname,
+                                const char *filter,
+                                const char **attrs,
+                                int num_attrs)
+{
+    struct sbus_request *sr;
+    DBusMessage *message;
+    uint32_t offset = 0;
+    uint32_t limit = 0;
+    dbus_bool_t dbret;
+    errno_t ret;
+
+    sr = mock_sbus_request(test_ctx, geteuid());
+    assert_non_null(sr);
+
+    dbret = dbus_message_append_args(sr->message,
+                                     DBUS_TYPE_STRING, &domname,
+                                     DBUS_TYPE_STRING, &filter,
+                                     DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                                     &attrs, num_attrs,
+                                     DBUS_TYPE_UINT32, &offset,
+                                     DBUS_TYPE_UINT32, &limit,
+                                     DBUS_TYPE_INVALID);
+    assert_true(dbret == TRUE);
+
+    /* The request is freed when the reply is sent */
+    message = sr->message;
+
+    ret = ifp_users_list_attrs_by_domain_and_name(sr, test_ctx->ifp_ctx);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_non_null(test_ctx->reply);
+
+    dbus_message_unref(message);
+}
+
+static int list_attrs_num_records(DBusMessage *reply)
+{
+    DBusMessageIter iter;
+    DBusMessageIter iter_records;
+    int count = 0;
+
+    assert_int_equal(dbus_message_get_type(reply),
+                     DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+    dbus_message_iter_init(reply, &iter);
+    assert_int_equal(dbus_message_iter_get_arg_type(&iter),
+                     DBUS_TYPE_ARRAY);
+
+    dbus_message_iter_recurse(&iter, &iter_records);
+    while (dbus_message_iter_get_arg_type(&iter_records) == DBUS_TYPE_ARRAY) {
+        count++;
+        dbus_message_iter_next(&iter_records);
+    }
+
+    return count;
+}
+
+/* Returns the first value of @attr in the first record of the reply or NULL
+ * if the record does not contain the attribute */
+static const char *list_attrs_value(DBusMessage *reply, const char *attr)
+{
+    DBusMessageIter iter;
+    DBusMessageIter iter_record;
+    DBusMessageIter iter_entry;
+    DBusMessageIter iter_value;
+    const char *key;
+    const char *value;
+
+    dbus_message_iter_init(reply, &iter);
+    dbus_message_iter_recurse(&iter, &iter);
+    assert_int_equal(dbus_message_iter_get_arg_type(&iter),
+                     DBUS_TYPE_ARRAY);
+
+    dbus_message_iter_recurse(&iter, &iter_record);
+    while (dbus_message_iter_get_arg_type(&iter_record)
+                == DBUS_TYPE_DICT_ENTRY) {
+        dbus_message_iter_recurse(&iter_record, &iter_entry);
+        dbus_message_iter_get_basic(&iter_entry, &key);
+
+        if (strcmp(key, attr) == 0) {
+            assert_true(dbus_message_iter_next(&iter_entry));
+            assert_int_equal(dbus_message_iter_get_arg_type(&iter_entry),
+                             DBUS_TYPE_VARIANT);
+            dbus_message_iter_recurse(&iter_entry, &iter_value);
+            assert_int_equal(dbus_message_iter_get_arg_type(&iter_value),
+                             DBUS_TYPE_ARRAY);
+            dbus_message_iter_recurse(&iter_value, &iter_value);
+            dbus_message_iter_get_basic(&iter_value, &value);
+            return value;
+        }
+
+        dbus_message_iter_next(&iter_record);
+    }
+
+    return NULL;
+}
+
+void test_list_attrs_unknown_domain(void **state)
+{
+    struct ifp_test_list_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct ifp_test_list_ctx);
+    const char *attrs[] = { SYSDB_NAME, NULL };
+
+    /* Fails before the cache or the data provider are consulted */
+    ifp_test_list_attrs(test_ctx, "nosuchdomain", "foo", attrs, 1);
+
+    assert_int_equal(dbus_message_get_type(test_ctx->reply),
+                     DBUS_MESSAGE_TYPE_ERROR);
+    assert_string_equal(dbus_message_get_error_name(test_ctx->reply),
+                        SBUS_ERROR_UNKNOWN_DOMAIN);
+}
+
+void test_list_attrs_unknown_user(void **state)
+{
+    struct ifp_test_list_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct ifp_test_list_ctx);
+    const char *attrs[] = { SYSDB_NAME, NULL };
+
+    /* The data provider does not find the user either */
+    mock_account_recv_simple();
+
+    ifp_test_list_attrs(test_ctx, TEST_DOM_NAME, "nosuchuser", attrs, 1);
+
+    assert_int_equal(list_attrs_num_records(test_ctx->reply), 0);
+}
+
+void test_list_attrs_filtered_attr(void **state)
+{
+    struct ifp_test_list_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                struct ifp_test_list_ctx);
+    const char *attrs[] = { SYSDB_NAME, SYSDB_HOMEDIR, SYSDB_UPN, NULL };
+
+    mock_account_recv(0, 0, NULL, ifp_test_store_user, test_ctx);
+
+    ifp_test_list_attrs(test_ctx, TEST_DOM_NAME, "foo", attrs, 3);
+
+    assert_int_equal(list_attrs_num_records(test_ctx->reply), 1);
+    assert_non_null(list_attrs_value(test_ctx->reply, "objectPath"));
+    assert_string_equal(list_attrs_value(test_ctx->reply, SYSDB_NAME), "foo");
+    assert_string_equal(list_attrs_value(test_ctx->reply, SYSDB_HOMEDIR),
+                        "/home/foo");
+
+    /* The UPN is not in the whitelist, the UID is needed to build the object
+     * path but was not requested */
+    assert_null(list_attrs_value(test_ctx->reply, SYSDB_UPN));
+    assert_null(list_attrs_value(test_ctx->reply, SYSDB_UIDNUM));
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -421,6 +780,19 @@ int main(int argc, const char *argv[])
         cmocka_unit_test(test_attr_acl),
         cmocka_unit_test(test_attr_acl_ex),
         cmocka_unit_test(test_attr_allowed),
+        cmocka_unit_test(test_list_limit),
+        cmocka_unit_test_setup_teardown(test_dn_filter,
+                                        ifp_test_sysdb_setup,
+                                        ifp_test_sysdb_teardown),
+        cmocka_unit_test_setup_teardown(test_list_attrs_unknown_domain,
+                                        ifp_test_list_setup,
+                                        ifp_test_list_teardown),
+        cmocka_unit_test_setup_teardown(test_list_attrs_unknown_user,
+                                        ifp_test_list_setup,
+                                        ifp_test_list_teardown),
+        cmocka_unit_test_setup_teardown(test_list_attrs_filtered_attr,
+                                        ifp_test_list_setup,
+                                        ifp_test_list_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -443,6 +815,7 @@ int main(int argc, const char *argv[])
     /* Even though normally the tests should clean up after themselves
      * they might not after a failed run. Remove the old db to be sure */
     tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,560 @@
+/*
+    SSSD
+
+    Unit tests for the extdom list lookups of the IPA provider
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+
+/* In order to access the opaque types */
+#include "providers/ipa/ipa_s2n_exop.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_ipa_s2n_exop_conf.ldb"
+#define TEST_DOM_NAME "ipa_s2n_exop_test"
+#define TEST_ID_PROVIDER "ipa"
+
+#define TEST_DOM_SID "S-1-5-21-1-2-3"
+
+/* The GID of a group is its RID plus this offset */
+#define TEST_GID_OFFSET 10000
+
+#define TEST_MAX_OPS 64
+
+struct test_ctx {
+    struct sss_test_ctx *tctx;
+    struct ipa_id_ctx *ipa_ctx;
+    struct sdap_handle *sh;
+
+    /* The extdom operations in the order they were sent, an operation is
+     * set to NULL when it is freed */
+    struct sdap_op *ops[TEST_MAX_OPS];
+    char *op_sids[TEST_MAX_OPS];
+    size_t num_ops;
+
+    size_t num_running;
+    size_t max_running;
+
+    /* SID of the object the next reply is for */
+    const char *reply_sid;
+};
+
+static struct test_ctx *global_test_ctx;
+
+/* Mock the extdom operation, the SID of each request is recorded */
+int __wrap_ldap_extended_operation(LDAP *ld,
+                                   LDAP_CONST char *reqoid,
+                                   struct berval *reqdata,
+                                   LDAPControl **sctrls,
+                                   LDAPControl **cctrls,
+                                   int *msgidp)
+{
+    struct test_ctx *test_ctx = global_test_ctx;
+    BerElement *ber;
+    ber_tag_t tag;
+    ber_int_t input_type;
+    ber_int_t request_type;
+    char *sid;
+
+    assert_true(test_ctx->num_ops < TEST_MAX_OPS);
+    assert_string_equal(reqoid, EXOP_SID2NAME_OID);
+
+    ber = ber_init(reqdata);
+    assert_non_null(ber);
+    tag = ber_scanf(ber, "{eea}", &input_type, &request_type, &sid);
+    assert_int_not_equal(tag, LBER_ERROR);
+    assert_int_equal(input_type, INP_SID);
+    assert_int_equal(request_type, REQ_FULL);
+
+    test_ctx->op_sids[test_ctx->num_ops] = talloc_strdup(test_ctx, sid);
+    assert_non_null(test_ctx->op_sids[test_ctx->num_ops]);
+    ber_memfree(sid);
+    ber_free(ber, 1);
+
+    test_ctx->num_ops++;
+    *msgidp = test_ctx->num_ops;
+
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_parse_result(LDAP *ld,
+                             LDAPMessage *res,
+                             int *errcodep,
+                             char **matcheddnp,
+                             char **errmsgp,
+                             char ***referralsp,
+                             LDAPControl ***serverctrls,
+                             int freeit)
+{
+    *errcodep = LDAP_SUCCESS;
+    if (matcheddnp != NULL) *matcheddnp = NULL;
+    if (errmsgp != NULL) *errmsgp = NULL;
+    if (referralsp != NULL) *referralsp = NULL;
+    if (serverctrls != NULL) *serverctrls = NULL;
+
+    return LDAP_SUCCESS;
+}
+
+/* Reply with the group of test_ctx->reply_sid */
+int __wrap_ldap_parse_extended_result(LDAP *ld,
+                                      LDAPMessage *res,
+                                      char **retoidp,
+                                      struct berval **retdatap,
+                                      int freeit)
+{
+    struct test_ctx *test_ctx = global_test_ctx;
+    BerElement *ber;
+    uint32_t rid;
+    char *name;
+    int ret;
+
+    assert_non_null(test_ctx->reply_sid);
+    rid = strtouint32(strrchr(test_ctx->reply_sid, '-') + 1, NULL, 10);
+
+    name = talloc_asprintf(test_ctx, "group%"PRIu32, rid);
+    assert_non_null(name);
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    assert_non_null(ber);
+    ret = ber_printf(ber, "{e{ssi}}", RESP_GROUP, test_ctx->tctx->dom->name,
+                                      name, rid + TEST_GID_OFFSET);
+    assert_int_not_equal(ret, -1);
+    ret = ber_flatten(ber, retdatap);
+    assert_int_equal(ret, 0);
+    ber_free(ber, 1);
+    talloc_free(name);
+
+    *retoidp = ber_strdup(EXOP_SID2NAME_OID);
+    assert_non_null(*retoidp);
+
+    return LDAP_SUCCESS;
+}
+
+static int test_op_destructor(struct sdap_op *op)
+{
+    struct test_ctx *test_ctx = global_test_ctx;
+
+    test_ctx->ops[op->msgid - 1] = NULL;
+    test_ctx->num_running--;
+
+    return 0;
+}
+
+/* Mock the operation handling, the test replies to the operations itself */
+int sdap_op_add(TALLOC_CTX *memctx, struct tevent_context *ev,
+                struct sdap_handle *sh, int msgid,
+                sdap_op_callback_t *callback, void *data,
+                int timeout, struct sdap_op **_op)
+{
+    struct test_ctx *test_ctx = global_test_ctx;
+    struct sdap_op *op;
+
+    op = talloc_zero(memctx, struct sdap_op);
+    assert_non_null(op);
+
+    op->sh = sh;
+    op->msgid = msgid;
+    op->callback = callback;
+    op->data = data;
+    op->ev = ev;
+    talloc_set_destructor(op, test_op_destructor);
+
+    test_ctx->ops[msgid - 1] = op;
+    test_ctx->num_running++;
+    if (test_ctx->num_running > test_ctx->max_running) {
+        test_ctx->max_running = test_ctx->num_running;
+    }
+
+    *_op = op;
+    return EOK;
+}
+
+static void test_reply_op(struct test_ctx *test_ctx, size_t idx)
+{
+    struct sdap_op *op = test_ctx->ops[idx];
+    struct sdap_msg reply = { 0 };
+
+    assert_non_null(op);
+
+    test_ctx->reply_sid = test_ctx->op_sids[idx];
+    op->callback(op, &reply, EOK, op->data);
+    test_ctx->reply_sid = NULL;
+}
+
+/* Reply to the running operations in the order they were sent until none
+ * is left */
+static void test_reply_all(struct test_ctx *test_ctx)
+{
+    size_t idx = 0;
+
+    while (test_ctx->num_running > 0) {
+        while (idx < test_ctx->num_ops && test_ctx->ops[idx] == NULL) {
+            idx++;
+        }
+        assert_true(idx < test_ctx->num_ops);
+
+        test_reply_op(test_ctx, idx);
+        assert_true(test_ctx->num_running <= IPA_S2N_LIST_MAX_REQS);
+    }
+}
+
+static char **test_sids(TALLOC_CTX *mem_ctx, uint32_t first_rid, size_t count)
+{
+    char **sids;
+    size_t i;
+
+    sids = talloc_zero_array(mem_ctx, char *, count + 1);
+    assert_non_null(sids);
+
+    for (i = 0; i < count; i++) {
+        sids[i] = talloc_asprintf(sids, "%s-%"PRIu32,
+                                  TEST_DOM_SID, first_rid + i);
+        assert_non_null(sids[i]);
+    }
+
+    return sids;
+}
+
+static void assert_sid_cached(struct test_ctx *test_ctx,
+                              const char *sid,
+                              bool cached)
+{
+    struct ldb_result *res;
+    errno_t ret;
+
+    ret = sysdb_search_object_by_sid(test_ctx, test_ctx->tctx->dom, sid,
+                                     NULL, &res);
+    assert_int_equal(ret, cached ? EOK : ENOENT);
+    if (ret == EOK) {
+        talloc_free(res);
+    }
+}
+
+static void assert_ops_sids(struct test_ctx *test_ctx,
+                            size_t first_op,
+                            char **sids)
+{
+    size_t i;
+
+    for (i = 0; sids[i] != NULL; i++) {
+        assert_true(first_op + i < test_ctx->num_ops);
+        assert_string_equal(test_ctx->op_sids[first_op + i], sids[i]);
+    }
+    assert_int_equal(test_ctx->num_ops, first_op + i);
+}
+
+static void test_get_list_done(struct tevent_req *req)
+{
+    struct test_ctx *test_ctx = tevent_req_callback_data(req,
+                                                         struct test_ctx);
+
+    test_ctx->tctx->error = ipa_s2n_get_list_recv(req);
+    test_ctx->tctx->done = true;
+    talloc_free(req);
+}
+
+static void test_get_list_send(struct test_ctx *test_ctx, char **sids)
+{
+    struct tevent_req *req;
+
+    test_ctx->tctx->done = false;
+    test_ctx->tctx->error = EIO;
+
+    req = ipa_s2n_get_list_send(test_ctx, test_ctx->tctx->ev,
+                                test_ctx->ipa_ctx, test_ctx->tctx->dom,
+                                test_ctx->sh, 0, BE_REQ_BY_SECID, REQ_FULL,
+                                REQ_INP_SECID, sids, NULL);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_get_list_done, test_ctx);
+}
+
+/* Look up all @sids and reply to each extdom request */
+static void test_get_list(struct test_ctx *test_ctx, char **sids)
+{
+    errno_t ret;
+
+    test_get_list_send(test_ctx, sids);
+    test_reply_all(test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_expire_sid(struct test_ctx *test_ctx, const char *sid)
+{
+    struct ipa_s2n_sid_cache_entry *entry;
+    hash_key_t hkey;
+    hash_value_t hvalue;
+    int hret;
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const(sid);
+
+    hret = hash_lookup(test_ctx->ipa_ctx->s2n_sid_cache, &hkey, &hvalue);
+    assert_int_equal(hret, HASH_SUCCESS);
+
+    entry = talloc_get_type(hvalue.ptr, struct ipa_s2n_sid_cache_entry);
+    assert_non_null(entry);
+    entry->expire = time(NULL) - 1;
+}
+
+static int test_ipa_s2n_exop_setup(void **state)
+{
+    struct test_ctx *test_ctx;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->tctx->dom->domain_id = talloc_strdup(test_ctx->tctx->dom,
+                                                   TEST_DOM_SID);
+    assert_non_null(test_ctx->tctx->dom->domain_id);
+
+    test_ctx->ipa_ctx = talloc_zero(test_ctx, struct ipa_id_ctx);
+    assert_non_null(test_ctx->ipa_ctx);
+
+    test_ctx->sh = talloc_zero(test_ctx, struct sdap_handle);
+    assert_non_null(test_ctx->sh);
+
+    global_test_ctx = test_ctx;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_ipa_s2n_exop_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+
+    global_test_ctx = NULL;
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+void test_get_list_max_reqs(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    char **sids;
+    size_t i;
+
+    sids = test_sids(test_ctx, 1000, 20);
+
+    /* only the first requests are sent right away */
+    test_get_list_send(test_ctx, sids);
+    assert_int_equal(test_ctx->num_ops, IPA_S2N_LIST_MAX_REQS);
+    assert_int_equal(test_ctx->num_running, IPA_S2N_LIST_MAX_REQS);
+
+    /* every reply starts the lookup of the next list element */
+    test_reply_op(test_ctx, 0);
+    assert_int_equal(test_ctx->num_ops, IPA_S2N_LIST_MAX_REQS + 1);
+    assert_int_equal(test_ctx->num_running, IPA_S2N_LIST_MAX_REQS);
+
+    /* the replies do not have to arrive in order */
+    test_reply_op(test_ctx, 5);
+    assert_int_equal(test_ctx->num_ops, IPA_S2N_LIST_MAX_REQS + 2);
+    assert_int_equal(test_ctx->num_running, IPA_S2N_LIST_MAX_REQS);
+
+    test_reply_all(test_ctx);
+    assert_int_equal(test_ev_loop(test_ctx->tctx), EOK);
+
+    assert_int_equal(test_ctx->max_running, IPA_S2N_LIST_MAX_REQS);
+    assert_int_equal(test_ctx->num_running, 0);
+    assert_ops_sids(test_ctx, 0, sids);
+
+    /* the objects of all replies are saved */
+    for (i = 0; sids[i] != NULL; i++) {
+        assert_sid_cached(test_ctx, sids[i], true);
+    }
+
+    talloc_free(sids);
+}
+
+void test_get_list_max_reqs_error(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    struct sdap_msg reply = { 0 };
+    struct sdap_op *op;
+    char **sids;
+    errno_t ret;
+
+    sids = test_sids(test_ctx, 1000, 20);
+
+    test_get_list_send(test_ctx, sids);
+    assert_int_equal(test_ctx->num_running, IPA_S2N_LIST_MAX_REQS);
+
+    /* a failed lookup cancels the running ones and starts no new one */
+    op = test_ctx->ops[0];
+    op->callback(op, &reply, ETIMEDOUT, op->data);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, ETIMEDOUT);
+    assert_int_equal(test_ctx->num_ops, IPA_S2N_LIST_MAX_REQS);
+    assert_int_equal(test_ctx->num_running, 0);
+
+    talloc_free(sids);
+}
+
+void test_sid_cache_hit_miss(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    char **sids;
+    char **new_sids;
+    char *name;
+    errno_t ret;
+
+    /* nothing is remembered yet */
+    sids = test_sids(test_ctx, 1000, 3);
+    assert_false(ipa_s2n_sid_cache_lookup(test_ctx->ipa_ctx,
+                                          test_ctx->tctx->dom, sids[0]));
+
+    test_get_list(test_ctx, sids);
+    assert_int_equal(test_ctx->num_ops, 3);
+    assert_true(ipa_s2n_sid_cache_lookup(test_ctx->ipa_ctx,
+                                         test_ctx->tctx->dom, sids[0]));
+
+    /* the remembered SIDs are skipped, only the new one is looked up */
+    new_sids = test_sids(test_ctx, 1000, 4);
+    test_get_list(test_ctx, new_sids);
+    assert_int_equal(test_ctx->num_ops, 4);
+    assert_string_equal(test_ctx->op_sids[3], new_sids[3]);
+    assert_sid_cached(test_ctx, new_sids[3], true);
+
+    /* a remembered SID is looked up again if its object was removed from
+     * the cache meanwhile */
+    name = sss_create_internal_fqname(test_ctx, "group1001",
+                                      test_ctx->tctx->dom->name);
+    assert_non_null(name);
+    ret = sysdb_delete_group(test_ctx->tctx->dom, name, 0);
+    assert_int_equal(ret, EOK);
+    talloc_free(name);
+
+    assert_false(ipa_s2n_sid_cache_lookup(test_ctx->ipa_ctx,
+                                          test_ctx->tctx->dom, sids[1]));
+    test_get_list(test_ctx, new_sids);
+    assert_int_equal(test_ctx->num_ops, 5);
+    assert_string_equal(test_ctx->op_sids[4], sids[1]);
+    assert_sid_cached(test_ctx, sids[1], true);
+
+    talloc_free(new_sids);
+    talloc_free(sids);
+}
+
+void test_sid_cache_expire(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    char **sids;
+
+    sids = test_sids(test_ctx, 1000, 3);
+
+    test_get_list(test_ctx, sids);
+    assert_int_equal(test_ctx->num_ops, 3);
+
+    test_get_list(test_ctx, sids);
+    assert_int_equal(test_ctx->num_ops, 3);
+
+    /* the expired SID is looked up again, the others are still skipped */
+    test_expire_sid(test_ctx, sids[2]);
+    assert_false(ipa_s2n_sid_cache_lookup(test_ctx->ipa_ctx,
+                                          test_ctx->tctx->dom, sids[2]));
+    assert_true(ipa_s2n_sid_cache_lookup(test_ctx->ipa_ctx,
+                                         test_ctx->tctx->dom, sids[0]));
+
+    test_get_list(test_ctx, sids);
+    assert_int_equal(test_ctx->num_ops, 4);
+    assert_string_equal(test_ctx->op_sids[3], sids[2]);
+
+    /* saving the object again renews the entry */
+    assert_true(ipa_s2n_sid_cache_lookup(test_ctx->ipa_ctx,
+                                         test_ctx->tctx->dom, sids[2]));
+
+    talloc_free(sids);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_get_list_max_reqs,
+                                        test_ipa_s2n_exop_setup,
+                                        test_ipa_s2n_exop_teardown),
+        cmocka_unit_test_setup_teardown(test_get_list_max_reqs_error,
+                                        test_ipa_s2n_exop_setup,
+                                        test_ipa_s2n_exop_teardown),
+        cmocka_unit_test_setup_teardown(test_sid_cache_hit_miss,
+                                        test_ipa_s2n_exop_setup,
+                                        test_ipa_s2n_exop_teardown),
+        cmocka_unit_test_setup_teardown(test_sid_cache_expire,
+                                        test_ipa_s2n_exop_setup,
+                                        test_ipa_s2n_exop_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+
+    return rv;
+}
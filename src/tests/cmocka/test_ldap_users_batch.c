@@ -0,0 +1,336 @@
+/*
+    SSSD
+
+    Unit tests for the batched lookups of users by UID
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_sysdb_objects.h"
+#include "tests/cmocka/common_mock_sdap.h"
+
+/* In order to access the opaque types */
+#include "providers/ldap/ldap_id.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_ldap_users_batch_conf.ldb"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_DOM1_NAME "domain.test.com"
+#define TEST_DOM2_NAME "another_domain.test.com"
+
+#define OBJECT_BASE_DN1 "dc=domain,dc=test,dc=com,cn=sysdb"
+#define OBJECT_BASE_DN2 "dc=another_domain,dc=test,dc=com,cn=sysdb"
+
+const char *domains[] = { TEST_DOM1_NAME,
+                          TEST_DOM2_NAME,
+                          NULL };
+
+struct test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sdap_id_ctx *id_ctx;
+    struct sss_domain_info *dom;
+};
+
+struct test_waiter {
+    bool done;
+    errno_t ret;
+    int dp_error;
+    int sdap_ret;
+};
+
+static int test_users_batch_setup(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { "ldap_schema", "rfc2307bis" },
+        { "ldap_search_base", OBJECT_BASE_DN1 },
+        { "ldap_user_search_base", "cn=users," OBJECT_BASE_DN1 },
+        { NULL, NULL },
+    };
+    struct sss_test_conf_param *dom_params[] = { params, params, NULL };
+    struct sdap_options *opts;
+    struct sdap_domain *other_sdom;
+    struct test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_multidom_test_ctx(test_ctx, TESTS_PATH,
+                                              TEST_CONF_DB, domains,
+                                              TEST_ID_PROVIDER, dom_params);
+    assert_non_null(test_ctx->tctx);
+    test_ctx->dom = test_ctx->tctx->dom;
+    assert_string_equal(test_ctx->dom->name, TEST_DOM1_NAME);
+
+    opts = mock_sdap_options_ldap(test_ctx, test_ctx->dom,
+                                  test_ctx->tctx->confdb,
+                                  test_ctx->tctx->conf_dom_path);
+    assert_non_null(opts);
+
+    /* entries below the search base of the other domain do not belong to
+     * the batch */
+    ret = sdap_domain_add(opts, test_ctx->dom->next, &other_sdom);
+    assert_int_equal(ret, EOK);
+
+    other_sdom->search_bases = talloc_array(other_sdom,
+                                            struct sdap_search_base *, 2);
+    assert_non_null(other_sdom->search_bases);
+    other_sdom->search_bases[1] = NULL;
+
+    ret = sdap_create_search_base(other_sdom, OBJECT_BASE_DN2,
+                                  LDAP_SCOPE_SUBTREE, NULL,
+                                  &other_sdom->search_bases[0]);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->id_ctx = mock_sdap_id_ctx(test_ctx, NULL, opts);
+    assert_non_null(test_ctx->id_ctx);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_users_batch_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_waiter_done(struct tevent_req *req)
+{
+    struct test_waiter *waiter = tevent_req_callback_data(req,
+                                                          struct test_waiter);
+
+    waiter->ret = users_batch_recv(req, &waiter->dp_error, &waiter->sdap_ret);
+    waiter->done = true;
+    talloc_free(req);
+}
+
+static void test_waiter_send(struct test_ctx *test_ctx,
+                             const char *uid,
+                             struct test_waiter *waiter)
+{
+    struct tevent_req *req;
+
+    req = users_batch_send(test_ctx, test_ctx->tctx->ev, test_ctx->id_ctx,
+                           test_ctx->id_ctx->opts->sdom, NULL, uid);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_waiter_done, waiter);
+}
+
+static struct sysdb_attrs *test_user(TALLOC_CTX *mem_ctx,
+                                     const char *base_dn,
+                                     uid_t uid,
+                                     const char *name)
+{
+    struct sysdb_attrs *user;
+
+    user = mock_sysdb_user(mem_ctx, base_dn, uid, name);
+    assert_non_null(user);
+
+    return user;
+}
+
+void test_batch_disabled_by_default(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    struct dp_id_data data = { 0 };
+
+    data.entry_type = BE_REQ_USER;
+    data.filter_type = BE_FILTER_IDNUM;
+    data.filter_value = discard_const("1001");
+
+    assert_int_equal(dp_opt_get_int(test_ctx->id_ctx->opts->basic,
+                                    SDAP_UID_BATCH_WINDOW), 0);
+    assert_false(users_batch_eligible(test_ctx->id_ctx,
+                                      test_ctx->id_ctx->opts->sdom, &data));
+}
+
+void test_batch_own_entry_or_enoent(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    struct test_waiter waiters[3] = { { 0 } };
+    struct users_batch *batch;
+    struct sysdb_attrs **users;
+    struct sysdb_attrs **matched;
+    size_t num_matched;
+    struct ldb_result *res;
+    errno_t ret;
+
+    dp_opt_set_int(test_ctx->id_ctx->opts->basic, SDAP_UID_BATCH_WINDOW,
+                   1000);
+
+    /* a cached user which was removed from the server */
+    ret = sysdb_store_user(test_ctx->dom, "gone@" TEST_DOM1_NAME, "*",
+                           1003, 1003, NULL, "/home/gone", "/bin/sh",
+                           NULL, NULL, NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    test_waiter_send(test_ctx, "1001", &waiters[0]);
+    test_waiter_send(test_ctx, "1002", &waiters[1]);
+    test_waiter_send(test_ctx, "1003", &waiters[2]);
+
+    batch = test_ctx->id_ctx->users_batch;
+    assert_non_null(batch);
+    assert_int_equal(batch->num_waiters, 3);
+
+    ret = users_batch_build_filter(batch);
+    assert_int_equal(ret, EOK);
+    assert_non_null(strstr(batch->filter, "(uidNumber=1001)"));
+    assert_non_null(strstr(batch->filter, "(uidNumber=1002)"));
+    assert_non_null(strstr(batch->filter, "(uidNumber=1003)"));
+
+    /* 1002 only exists in the other domain and 1004 was not asked for */
+    users = talloc_array(test_ctx, struct sysdb_attrs *, 3);
+    assert_non_null(users);
+    users[0] = test_user(users, OBJECT_BASE_DN1, 1001, "user1001");
+    users[1] = test_user(users, OBJECT_BASE_DN2, 1002, "user1002");
+    users[2] = test_user(users, OBJECT_BASE_DN1, 1004, "user1004");
+
+    ret = users_batch_match(test_ctx, batch, users, 3,
+                            &matched, &num_matched);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_matched, 1);
+    assert_ptr_equal(matched[0], users[0]);
+
+    users_batch_found(batch, matched, num_matched);
+    assert_true(waiters[0].done);
+    assert_int_equal(waiters[0].ret, EOK);
+    assert_int_equal(waiters[0].dp_error, DP_ERR_OK);
+    assert_int_equal(waiters[0].sdap_ret, EOK);
+    assert_false(waiters[1].done);
+    assert_false(waiters[2].done);
+    assert_int_equal(batch->num_waiters, 2);
+
+    /* the next search base is searched only for the missing users */
+    ret = users_batch_build_filter(batch);
+    assert_int_equal(ret, EOK);
+    assert_null(strstr(batch->filter, "(uidNumber=1001)"));
+    assert_non_null(strstr(batch->filter, "(uidNumber=1002)"));
+    assert_non_null(strstr(batch->filter, "(uidNumber=1003)"));
+
+    users_batch_finish(batch, EOK, DP_ERR_OK);
+    assert_null(test_ctx->id_ctx->users_batch);
+
+    for (int i = 1; i < 3; i++) {
+        assert_true(waiters[i].done);
+        assert_int_equal(waiters[i].ret, EOK);
+        assert_int_equal(waiters[i].dp_error, DP_ERR_OK);
+        assert_int_equal(waiters[i].sdap_ret, ENOENT);
+    }
+
+    ret = sysdb_getpwuid(test_ctx, test_ctx->dom, 1003, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 0);
+
+    talloc_free(res);
+    talloc_free(matched);
+    talloc_free(users);
+}
+
+void test_batch_error(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    struct test_waiter waiters[2] = { { 0 } };
+    struct users_batch *batch;
+
+    dp_opt_set_int(test_ctx->id_ctx->opts->basic, SDAP_UID_BATCH_WINDOW,
+                   1000);
+
+    test_waiter_send(test_ctx, "1001", &waiters[0]);
+    test_waiter_send(test_ctx, "1002", &waiters[1]);
+
+    batch = test_ctx->id_ctx->users_batch;
+    assert_non_null(batch);
+
+    users_batch_finish(batch, ETIMEDOUT, DP_ERR_OFFLINE);
+    assert_null(test_ctx->id_ctx->users_batch);
+
+    for (int i = 0; i < 2; i++) {
+        assert_true(waiters[i].done);
+        assert_int_equal(waiters[i].ret, ETIMEDOUT);
+        assert_int_equal(waiters[i].dp_error, DP_ERR_OFFLINE);
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_batch_disabled_by_default,
+                                        test_users_batch_setup,
+                                        test_users_batch_teardown),
+        cmocka_unit_test_setup_teardown(test_batch_own_entry_or_enoent,
+                                        test_users_batch_setup,
+                                        test_users_batch_teardown),
+        cmocka_unit_test_setup_teardown(test_batch_error,
+                                        test_users_batch_setup,
+                                        test_users_batch_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_multidom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, domains);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        test_multidom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, domains);
+    }
+
+    return rv;
+}
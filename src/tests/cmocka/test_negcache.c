@@ -346,6 +346,36 @@ static void test_sss_ncache_user(void **state)
  * sss_ncache_check_group
  * sss_ncache_set_group
  */
+static void test_sss_ncache_user_generation(void **state)
+{
+    int ret;
+    uint32_t gen;
+    char *name;
+    struct test_state *ts;
+    struct sss_domain_info *dom;
+
+    ts = talloc_get_type_abort(*state, struct test_state);
+    dom = talloc(ts, struct sss_domain_info);
+    dom->name = discard_const_p(char, TEST_DOM_NAME);
+    dom->case_sensitive = true;
+
+    name = sss_create_internal_fqname(ts, NAME, dom->name);
+    assert_non_null(name);
+
+    gen = sss_ncache_get_user_generation(ts->ctx);
+
+    /* groups do not change the set of filtered users */
+    ret = sss_ncache_set_group(ts->ctx, false, dom, name);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(sss_ncache_get_user_generation(ts->ctx), gen);
+
+    ret = sss_ncache_set_user(ts->ctx, false, dom, name);
+    assert_int_equal(ret, EOK);
+    assert_int_not_equal(sss_ncache_get_user_generation(ts->ctx), gen);
+
+    talloc_free(name);
+}
+
 static void test_sss_ncache_group(void **state)
 {
     int ret;
@@ -863,6 +893,8 @@ int main(void)
         cmocka_unit_test_setup_teardown(test_sss_ncache_sid, setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_cert, setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_user, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_sss_ncache_user_generation,
+                                        setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_group, setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_netgr, setup, teardown),
         cmocka_unit_test_setup_teardown(test_sss_ncache_service_name, setup,
@@ -0,0 +1,470 @@
+/*
+    SSSD
+
+    NSS Responder - memory cache tests
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <popt.h>
+#include <sys/mman.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "util/mmap_cache.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
+#include "sss_client/nss_mc.h"
+#include "sss_client/idmap/sss_nss_idmap.h"
+
+#define TEST_MC_NAME "passwd"
+#define TEST_MC_FILE SSS_NSS_MCACHE_DIR"/"TEST_MC_NAME
+#define TEST_MC_ELEMS 128
+#define TEST_MC_TIMEOUT 300
+#define TEST_FINGERPRINT 42
+
+#define TEST_MC_SID_NAME "sid"
+#define TEST_MC_SID_FILE SSS_NSS_MCACHE_DIR"/"TEST_MC_SID_NAME
+
+#define TEST_USER_NAME "testuser"
+#define TEST_USER_UID 1000
+#define TEST_USER_SID "S-1-5-21-1-2-3-1000"
+#define TEST_USER_FQNAME TEST_USER_NAME"@test.example"
+
+struct mc_test_ctx {
+    struct sss_mc_ctx *mcc;
+};
+
+static int mc_test_setup(void **state)
+{
+    struct mc_test_ctx *test_ctx;
+    int ret;
+
+    assert_true(leak_check_setup());
+
+    ret = mkdir(SSS_NSS_MCACHE_DIR, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(global_talloc_context, struct mc_test_ctx);
+    assert_non_null(test_ctx);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int mc_test_teardown(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    talloc_zfree(test_ctx->mcc);
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+
+    unlink(TEST_MC_FILE);
+    unlink(TEST_MC_SID_FILE);
+    rmdir(SSS_NSS_MCACHE_DIR);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void mc_test_init(struct mc_test_ctx *test_ctx, uint32_t fingerprint)
+{
+    errno_t ret;
+
+    talloc_zfree(test_ctx->mcc);
+    ret = sss_mmap_cache_init(test_ctx, TEST_MC_NAME, fingerprint,
+                              SSS_MC_PASSWD, TEST_MC_ELEMS, TEST_MC_TIMEOUT,
+                              &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+}
+
+static void mc_test_store_user(struct mc_test_ctx *test_ctx)
+{
+    struct sized_string name;
+    struct sized_string pw;
+    struct sized_string gecos;
+    struct sized_string homedir;
+    struct sized_string shell;
+    errno_t ret;
+
+    to_sized_string(&name, TEST_USER_NAME);
+    to_sized_string(&pw, "*");
+    to_sized_string(&gecos, "Test User");
+    to_sized_string(&homedir, "/home/"TEST_USER_NAME);
+    to_sized_string(&shell, "/bin/sh");
+
+    ret = sss_mmap_cache_pw_store(&test_ctx->mcc, &name, &pw,
+                                  TEST_USER_UID, TEST_USER_UID,
+                                  &gecos, &homedir, &shell);
+    assert_int_equal(ret, EOK);
+}
+
+/* Returns EOK if the user stored by mc_test_store_user() is in the cache */
+static errno_t mc_test_find_user(struct mc_test_ctx *test_ctx)
+{
+    struct sized_string name;
+
+    to_sized_string(&name, TEST_USER_NAME);
+    return sss_mmap_cache_pw_invalidate(test_ctx->mcc, &name);
+}
+
+/* Creates a cache file with the test user in it and leaves it on disk the
+ * same way a stopped responder does */
+static void mc_test_prepare_file(struct mc_test_ctx *test_ctx)
+{
+    mc_test_init(test_ctx, TEST_FINGERPRINT);
+    mc_test_store_user(test_ctx);
+    talloc_zfree(test_ctx->mcc);
+}
+
+typedef void (*mc_test_corrupt_fn)(struct sss_mc_header *h,
+                                   struct sss_mc_rec *rec);
+
+/* Modifies the first record of the cache file left on disk */
+static void mc_test_corrupt_file(mc_test_corrupt_fn corrupt)
+{
+    struct sss_mc_header *h;
+    struct sss_mc_rec *rec;
+    uint32_t *hash_table;
+    uint8_t *data_table;
+    struct stat st;
+    uint8_t *base;
+    uint32_t slot;
+    uint32_t i;
+    int fd;
+    int ret;
+
+    fd = open(TEST_MC_FILE, O_RDWR);
+    assert_true(fd != -1);
+
+    ret = fstat(fd, &st);
+    assert_int_equal(ret, 0);
+
+    base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert_true(base != MAP_FAILED);
+
+    h = (struct sss_mc_header *)base;
+    data_table = MC_PTR_ADD(base, h->data_table);
+    hash_table = MC_PTR_ADD(base, h->hash_table);
+
+    slot = MC_INVALID_VAL32;
+    for (i = 0; i < MC_HT_ELEMS(h->ht_size); i++) {
+        if (hash_table[i] != MC_INVALID_VAL32) {
+            slot = hash_table[i];
+            break;
+        }
+    }
+    assert_int_not_equal(slot, MC_INVALID_VAL32);
+
+    rec = MC_SLOT_TO_PTR(data_table, slot, struct sss_mc_rec);
+    corrupt(h, rec);
+
+    munmap(base, st.st_size);
+    close(fd);
+}
+
+static void test_mc_adopt_valid(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    mc_test_prepare_file(test_ctx);
+
+    mc_test_init(test_ctx, TEST_FINGERPRINT);
+    assert_int_equal(mc_test_find_user(test_ctx), EOK);
+}
+
+static void test_mc_adopt_fingerprint_mismatch(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    mc_test_prepare_file(test_ctx);
+
+    mc_test_init(test_ctx, TEST_FINGERPRINT + 1);
+    assert_int_equal(mc_test_find_user(test_ctx), ENOENT);
+}
+
+static void test_mc_adopt_no_fingerprint(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    mc_test_prepare_file(test_ctx);
+
+    /* zero disables reusing the file */
+    mc_test_init(test_ctx, 0);
+    assert_int_equal(mc_test_find_user(test_ctx), ENOENT);
+}
+
+static void corrupt_next_slot(struct sss_mc_header *h, struct sss_mc_rec *rec)
+{
+    rec->next1 = h->dt_size / MC_SLOT_SIZE + 10;
+}
+
+static void test_mc_adopt_next_out_of_range(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    mc_test_prepare_file(test_ctx);
+    mc_test_corrupt_file(corrupt_next_slot);
+
+    mc_test_init(test_ctx, TEST_FINGERPRINT);
+    assert_int_equal(mc_test_find_user(test_ctx), ENOENT);
+}
+
+static void corrupt_hash(struct sss_mc_header *h, struct sss_mc_rec *rec)
+{
+    rec->hash2 = MC_HT_ELEMS(h->ht_size) + 10;
+}
+
+static void test_mc_adopt_hash_out_of_range(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    mc_test_prepare_file(test_ctx);
+    mc_test_corrupt_file(corrupt_hash);
+
+    mc_test_init(test_ctx, TEST_FINGERPRINT);
+    assert_int_equal(mc_test_find_user(test_ctx), ENOENT);
+}
+
+static void corrupt_cycle(struct sss_mc_header *h, struct sss_mc_rec *rec)
+{
+    uint8_t *data_table = MC_PTR_ADD(h, h->data_table);
+
+    /* the record follows itself in its first chain */
+    rec->next1 = MC_PTR_TO_SLOT(data_table, rec);
+}
+
+static void test_mc_adopt_cyclic_chain(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+
+    mc_test_prepare_file(test_ctx);
+    mc_test_corrupt_file(corrupt_cycle);
+
+    mc_test_init(test_ctx, TEST_FINGERPRINT);
+    assert_int_equal(mc_test_find_user(test_ctx), ENOENT);
+}
+
+static void mc_test_init_sid(struct mc_test_ctx *test_ctx)
+{
+    errno_t ret;
+
+    talloc_zfree(test_ctx->mcc);
+    ret = sss_mmap_cache_init(test_ctx, TEST_MC_SID_NAME, 0,
+                              SSS_MC_SID, TEST_MC_ELEMS, TEST_MC_TIMEOUT,
+                              &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+}
+
+/* Stores the records the responder writes for getsidbyname, getsidbyid and
+ * getnamebysid of the test user */
+static void mc_test_store_sids(struct mc_test_ctx *test_ctx)
+{
+    struct sized_string key;
+    struct sized_string sid;
+    struct sized_string name;
+    struct sized_string empty;
+    errno_t ret;
+
+    to_sized_string(&sid, TEST_USER_SID);
+    to_sized_string(&name, TEST_USER_FQNAME);
+    to_sized_string(&empty, "");
+
+    to_sized_string(&key, MC_SID_KEY_NAME TEST_USER_NAME);
+    ret = sss_mmap_cache_sid_store(&test_ctx->mcc, &key, &sid, &empty,
+                                   0, SSS_ID_TYPE_UID);
+    assert_int_equal(ret, EOK);
+
+    to_sized_string(&key, MC_SID_KEY_ID "1000");
+    ret = sss_mmap_cache_sid_store(&test_ctx->mcc, &key, &sid, &empty,
+                                   TEST_USER_UID, SSS_ID_TYPE_UID);
+    assert_int_equal(ret, EOK);
+
+    to_sized_string(&key, MC_SID_KEY_SID TEST_USER_SID);
+    ret = sss_mmap_cache_sid_store(&test_ctx->mcc, &key, &sid, &name,
+                                   TEST_USER_UID, SSS_ID_TYPE_UID);
+    assert_int_equal(ret, EOK);
+}
+
+static errno_t mc_test_getsid(const char *key,
+                              char **_sid, char **_name,
+                              uint32_t *_id, uint32_t *_type)
+{
+    return sss_nss_mc_getsid(key, strlen(key), _sid, _name, _id, _type);
+}
+
+/* The client library keeps the file mapped, so all lookups through it are
+ * done in a single test. */
+static void test_mc_sid_store_lookup(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+    struct sized_string key;
+    char *sid = NULL;
+    char *name = NULL;
+    uint32_t type;
+    uint32_t id;
+    errno_t ret;
+
+    mc_test_init_sid(test_ctx);
+    mc_test_store_sids(test_ctx);
+
+    ret = mc_test_getsid(MC_SID_KEY_NAME TEST_USER_NAME,
+                         &sid, NULL, NULL, &type);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(sid, TEST_USER_SID);
+    assert_int_equal(type, SSS_ID_TYPE_UID);
+    free(sid);
+
+    ret = mc_test_getsid(MC_SID_KEY_ID "1000", &sid, NULL, &id, NULL);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(sid, TEST_USER_SID);
+    assert_int_equal(id, TEST_USER_UID);
+    free(sid);
+
+    ret = mc_test_getsid(MC_SID_KEY_SID TEST_USER_SID,
+                         NULL, &name, &id, &type);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(name, TEST_USER_FQNAME);
+    assert_int_equal(id, TEST_USER_UID);
+    assert_int_equal(type, SSS_ID_TYPE_UID);
+    free(name);
+
+    /* The prefix is part of the key */
+    ret = mc_test_getsid(MC_SID_KEY_NAME TEST_USER_SID,
+                         &sid, NULL, NULL, NULL);
+    assert_int_equal(ret, ENOENT);
+
+    ret = mc_test_getsid(MC_SID_KEY_ID "1001", &sid, NULL, NULL, NULL);
+    assert_int_equal(ret, ENOENT);
+
+    /* An invalidated record is not returned to the client */
+    to_sized_string(&key, MC_SID_KEY_SID TEST_USER_SID);
+    ret = sss_mmap_cache_sid_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, EOK);
+
+    ret = mc_test_getsid(MC_SID_KEY_SID TEST_USER_SID,
+                         NULL, &name, NULL, NULL);
+    assert_int_equal(ret, ENOENT);
+
+    ret = mc_test_getsid(MC_SID_KEY_NAME TEST_USER_NAME,
+                         &sid, NULL, NULL, NULL);
+    assert_int_equal(ret, EOK);
+    free(sid);
+}
+
+static void test_mc_sid_invalidate(void **state)
+{
+    struct mc_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct mc_test_ctx);
+    struct sized_string key;
+    errno_t ret;
+
+    mc_test_init_sid(test_ctx);
+    mc_test_store_sids(test_ctx);
+
+    to_sized_string(&key, MC_SID_KEY_NAME TEST_USER_NAME);
+    ret = sss_mmap_cache_sid_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, EOK);
+
+    ret = sss_mmap_cache_sid_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, ENOENT);
+
+    /* The other keys of the same object are independent records */
+    to_sized_string(&key, MC_SID_KEY_ID "1000");
+    ret = sss_mmap_cache_sid_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, EOK);
+
+    to_sized_string(&key, MC_SID_KEY_SID TEST_USER_SID);
+    ret = sss_mmap_cache_sid_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, EOK);
+
+    /* A store after invalidation is found again */
+    mc_test_store_sids(test_ctx);
+    to_sized_string(&key, MC_SID_KEY_NAME TEST_USER_NAME);
+    ret = sss_mmap_cache_sid_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, EOK);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_mc_adopt_valid,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_adopt_fingerprint_mismatch,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_adopt_no_fingerprint,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_adopt_next_out_of_range,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_adopt_hash_out_of_range,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_adopt_cyclic_chain,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_sid_store_lookup,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_mc_sid_invalidate,
+                                        mc_test_setup,
+                                        mc_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+
+    /* The client side must read the cache written by the tests */
+    unsetenv("SSS_NSS_USE_MEMCACHE");
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -30,6 +30,8 @@
 #include "responder/common/negcache.h"
 #include "responder/nss/nss_private.h"
 #include "responder/nss/nss_protocol.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
+#include "util/mmap_cache.h"
 #include "sss_client/idmap/sss_nss_idmap.h"
 #include "util/util_sss_idmap.h"
 #include "util/crypto/sss_crypto.h"
@@ -53,6 +55,7 @@ struct nss_test_ctx {
     struct nss_ctx *nctx;
 
     int ncache_hits;
+    int ncache_user_checks;
 };
 
 const char *global_extra_attrs[] = {"phone", "mobile", NULL};
@@ -164,6 +167,7 @@ int __wrap_sss_ncache_check_user(struct sss_nc_ctx *ctx,
 {
     int ret;
 
+    nss_test_ctx->ncache_user_checks++;
     ret = __real_sss_ncache_check_user(ctx, dom, name);
     if (ret == EEXIST) {
         nss_test_ctx->ncache_hits++;
@@ -1428,6 +1432,224 @@ void test_nss_getgrnam_no_members(void **state)
     assert_int_equal(ret, EOK);
 }
 
+/* Groups large enough to keep their packed member list */
+#define BIGGROUP_NAME "testbiggroup"
+#define BIGGROUP_GID 1124
+#define BIGGROUP2_NAME "testbiggroup2"
+#define BIGGROUP2_GID 1125
+
+static void store_big_group(const char *name, gid_t gid)
+{
+    struct sss_domain_info *dom = nss_test_ctx->tctx->dom;
+    struct sysdb_attrs *attrs;
+    char *fqname;
+    char *member;
+    errno_t ret;
+    int i;
+
+    attrs = sysdb_new_attrs(nss_test_ctx);
+    assert_non_null(attrs);
+
+    for (i = 0; i < NSS_GRENT_BLOB_MIN_MEMBERS; i++) {
+        member = talloc_asprintf(attrs, "%s_member%d", name, i);
+        assert_non_null(member);
+
+        fqname = sss_create_internal_fqname(attrs, member, dom->name);
+        assert_non_null(fqname);
+
+        ret = sysdb_attrs_add_string(attrs, SYSDB_GHOST, fqname);
+        assert_int_equal(ret, EOK);
+    }
+
+    fqname = sss_create_internal_fqname(attrs, name, dom->name);
+    assert_non_null(fqname);
+
+    ret = sysdb_add_group(dom, fqname, gid, attrs, 300, 0);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+}
+
+static int test_nss_getgrnam_big_check(uint32_t status,
+                                       uint8_t *body, size_t blen)
+{
+    uint32_t expected = sss_mock_type(uint32_t);
+    struct group gr;
+    uint32_t nmem;
+    int ret;
+
+    assert_int_equal(status, EOK);
+
+    ret = parse_group_packet(body, blen, &gr, &nmem);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(nmem, expected);
+    talloc_free(gr.gr_mem);
+
+    return EOK;
+}
+
+/* Looks the group up and returns how many members were checked against the
+ * negative cache, i.e. zero when the packed member list was reused. The
+ * input is placed into a real packet so that lookups can be repeated. */
+static int getgrnam_big(const char *name, uint32_t expected_members)
+{
+    struct cli_protocol *pctx;
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    pctx = talloc_get_type(nss_test_ctx->cctx->protocol_ctx,
+                           struct cli_protocol);
+    talloc_zfree(pctx->creq->in);
+    ret = sss_packet_new(pctx->creq, strlen(name) + 1, SSS_NSS_GETGRNAM,
+                         &pctx->creq->in);
+    assert_int_equal(ret, EOK);
+    __real_sss_packet_get_body(pctx->creq->in, &body, &blen);
+    memcpy(body, name, blen);
+
+    mock_parse_inp(name, NULL, EOK);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETGRNAM);
+    will_return(test_nss_getgrnam_big_check, expected_members);
+
+    nss_test_ctx->tctx->done = false;
+    nss_test_ctx->ncache_user_checks = 0;
+
+    set_cmd_cb(test_nss_getgrnam_big_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETGRNAM,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    return nss_test_ctx->ncache_user_checks;
+}
+
+void test_nss_getgrnam_blob_reuse(void **state)
+{
+    store_big_group(BIGGROUP_NAME, BIGGROUP_GID);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+    assert_non_null(nss_test_ctx->nctx->grent_blobs);
+    assert_int_equal(hash_count(nss_test_ctx->nctx->grent_blobs), 1);
+
+    /* Nothing changed, the packed list is sent again */
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     0);
+    assert_int_equal(hash_count(nss_test_ctx->nctx->grent_blobs), 1);
+}
+
+void test_nss_getgrnam_blob_sysdb_change(void **state)
+{
+    errno_t ret;
+
+    store_big_group(BIGGROUP_NAME, BIGGROUP_GID);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+
+    /* Any write bumps the cache sequence number */
+    ret = store_group(nss_test_ctx, nss_test_ctx->tctx->dom,
+                      &getgrnam_no_members, 0);
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+    assert_int_equal(hash_count(nss_test_ctx->nctx->grent_blobs), 1);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     0);
+}
+
+void test_nss_getgrnam_blob_ncache_change(void **state)
+{
+    errno_t ret;
+
+    store_big_group(BIGGROUP_NAME, BIGGROUP_GID);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+
+    /* A new filtered user could be a member, the list is rebuilt */
+    ret = sss_ncache_set_user(nss_test_ctx->rctx->ncache, false,
+                              nss_test_ctx->tctx->dom, "notamember");
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     0);
+}
+
+void test_nss_getgrnam_blob_filtered(void **state)
+{
+    struct sss_domain_info *dom = nss_test_ctx->tctx->dom;
+    char *fqname;
+    errno_t ret;
+
+    store_big_group(BIGGROUP_NAME, BIGGROUP_GID);
+
+    fqname = sss_create_internal_fqname(nss_test_ctx,
+                                        BIGGROUP_NAME"_member0", dom->name);
+    assert_non_null(fqname);
+    ret = sss_ncache_set_user(nss_test_ctx->rctx->ncache, false, dom, fqname);
+    assert_int_equal(ret, EOK);
+
+    /* The filtered member is left out and the list is not kept */
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME,
+                                  NSS_GRENT_BLOB_MIN_MEMBERS - 1),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+    assert_int_equal(nss_test_ctx->ncache_hits, 1);
+    assert_true(nss_test_ctx->nctx->grent_blobs == NULL
+                || hash_count(nss_test_ctx->nctx->grent_blobs) == 0);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME,
+                                  NSS_GRENT_BLOB_MIN_MEMBERS - 1),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+}
+
+void test_nss_getgrnam_blob_flush(void **state)
+{
+    hash_table_t *blobs;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+    int i;
+
+    store_big_group(BIGGROUP_NAME, BIGGROUP_GID);
+    store_big_group(BIGGROUP2_NAME, BIGGROUP2_GID);
+
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+
+    /* Fill the table up with lists of other groups */
+    blobs = nss_test_ctx->nctx->grent_blobs;
+    assert_non_null(blobs);
+    for (i = 1; i < NSS_GRENT_BLOB_MAX; i++) {
+        key.type = HASH_KEY_STRING;
+        key.str = talloc_asprintf(nss_test_ctx, "name=filler%d", i);
+        assert_non_null(key.str);
+        value.type = HASH_VALUE_PTR;
+        value.ptr = talloc_zero(blobs, char);
+        assert_non_null(value.ptr);
+
+        hret = hash_enter(blobs, &key, &value);
+        assert_int_equal(hret, HASH_SUCCESS);
+        talloc_free(key.str);
+    }
+    assert_int_equal(hash_count(blobs), NSS_GRENT_BLOB_MAX);
+
+    /* Storing one more list drops all of them */
+    assert_int_equal(getgrnam_big(BIGGROUP2_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+    assert_int_equal(hash_count(nss_test_ctx->nctx->grent_blobs), 1);
+
+    assert_int_equal(getgrnam_big(BIGGROUP2_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     0);
+    assert_int_equal(getgrnam_big(BIGGROUP_NAME, NSS_GRENT_BLOB_MIN_MEMBERS),
+                     NSS_GRENT_BLOB_MIN_MEMBERS);
+}
+
 struct passwd testmember1 = {
     .pw_name = discard_const("testmember1"),
     .pw_uid = 2001,
@@ -3361,6 +3583,32 @@ static int nss_test_setup(void **state)
     return 0;
 }
 
+static int nss_grent_blob_test_setup(void **state)
+{
+    nss_test_setup(state);
+
+    /* Members are only checked against the negative cache with filtering
+     * enabled, which tells a rebuilt member list from a reused one. */
+    nss_test_ctx->nctx->filter_users_in_groups = true;
+    will_return_always(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+    return 0;
+}
+
+static int nss_sid_mc_test_setup(void **state)
+{
+    errno_t ret;
+
+    nss_test_setup(state);
+
+    ret = mkdir(SSS_NSS_MCACHE_DIR, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    ret = sss_mmap_cache_init(nss_test_ctx->nctx, "sid", 0, SSS_MC_SID,
+                              128, 300, &nss_test_ctx->nctx->sid_mc_ctx);
+    assert_int_equal(ret, EOK);
+    return 0;
+}
+
 static int nss_fqdn_test_setup(void **state)
 {
     struct sss_test_conf_param params[] = {
@@ -3488,6 +3736,15 @@ static int nss_test_teardown(void **state)
     return 0;
 }
 
+static int nss_sid_mc_test_teardown(void **state)
+{
+    nss_test_teardown(state);
+
+    unlink(SSS_NSS_MCACHE_DIR"/sid");
+    rmdir(SSS_NSS_MCACHE_DIR);
+    return 0;
+}
+
 static int nss_subdom_test_teardown(void **state)
 {
     errno_t ret;
@@ -3725,6 +3982,341 @@ void test_nss_getnamebysid_update(void **state)
     assert_string_equal(shell, "/bin/ksh");
 }
 
+struct passwd testbatch = {
+    .pw_name = discard_const("testbatchuser"),
+    .pw_uid = 12346,
+    .pw_gid = 6890,
+    .pw_dir = discard_const("/home/testbatchuser"),
+    .pw_gecos = discard_const("test batch lookup"),
+    .pw_shell = discard_const("/bin/sh"),
+    .pw_passwd = discard_const("*"),
+};
+
+static char *store_batch_user(void)
+{
+    errno_t ret;
+    struct sysdb_attrs *attrs;
+    char *user_sid;
+
+    attrs = sysdb_new_attrs(nss_test_ctx);
+    assert_non_null(attrs);
+
+    user_sid = talloc_asprintf(nss_test_ctx, "%s-600",
+                               nss_test_ctx->tctx->dom->domain_id);
+    assert_non_null(user_sid);
+
+    ret = sysdb_attrs_add_string(attrs, SYSDB_SID_STR, user_sid);
+    assert_int_equal(ret, EOK);
+
+    ret = store_user(nss_test_ctx, nss_test_ctx->tctx->dom,
+                     &testbatch, attrs, 0);
+    assert_int_equal(ret, EOK);
+
+    return user_sid;
+}
+
+/* Sends num SIDs announced as a list of count elements. */
+static void mock_input_sid_list(const char **sids, uint32_t num,
+                                uint32_t count)
+{
+    uint8_t *body;
+    size_t blen;
+    size_t rp;
+    size_t len;
+    uint32_t i;
+
+    blen = sizeof(uint32_t);
+    for (i = 0; i < num; i++) {
+        blen += strlen(sids[i]) + 1;
+    }
+
+    body = talloc_zero_array(nss_test_ctx, uint8_t, blen);
+    assert_non_null(body);
+
+    rp = 0;
+    SAFEALIGN_SETMEM_UINT32(body, count, &rp);
+    for (i = 0; i < num; i++) {
+        len = strlen(sids[i]) + 1;
+        memcpy(body + rp, sids[i], len);
+        rp += len;
+    }
+
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, body);
+    will_return(__wrap_sss_packet_get_body, blen);
+}
+
+static void mock_input_id_list(const uint32_t *ids, uint32_t count)
+{
+    uint8_t *body;
+    size_t rp;
+    uint32_t i;
+
+    body = talloc_zero_array(nss_test_ctx, uint8_t,
+                             (count + 1) * sizeof(uint32_t));
+    assert_non_null(body);
+
+    rp = 0;
+    SAFEALIGN_SETMEM_UINT32(body, count, &rp);
+    for (i = 0; i < count; i++) {
+        SAFEALIGN_SETMEM_UINT32(body + rp, ids[i], &rp);
+    }
+
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, body);
+    will_return(__wrap_sss_packet_get_body, (count + 1) * sizeof(uint32_t));
+}
+
+static int test_nss_getidsbysids_check(uint32_t status,
+                                       uint8_t *body, size_t blen)
+{
+    size_t rp = 0;
+    uint32_t num;
+    uint32_t error;
+    uint32_t id_type;
+    uint32_t id;
+
+    assert_int_equal(status, EOK);
+
+    SAFEALIGN_COPY_UINT32(&num, body+rp, &rp);
+    assert_int_equal(num, 3);
+    rp += sizeof(uint32_t); /* reserved */
+
+    /* The stored user is resolved from the cache */
+    SAFEALIGN_COPY_UINT32(&error, body+rp, &rp);
+    assert_int_equal(error, EOK);
+    SAFEALIGN_COPY_UINT32(&id_type, body+rp, &rp);
+    assert_int_equal(id_type, SSS_ID_TYPE_UID);
+    SAFEALIGN_COPY_UINT32(&id, body+rp, &rp);
+    assert_int_equal(id, testbatch.pw_uid);
+
+    /* The unknown SID fails on its own without failing the request */
+    SAFEALIGN_COPY_UINT32(&error, body+rp, &rp);
+    assert_int_equal(error, ENOENT);
+    SAFEALIGN_COPY_UINT32(&id_type, body+rp, &rp);
+    assert_int_equal(id_type, SSS_ID_TYPE_NOT_SPECIFIED);
+    SAFEALIGN_COPY_UINT32(&id, body+rp, &rp);
+    assert_int_equal(id, 0);
+
+    /* So does the malformed SID */
+    SAFEALIGN_COPY_UINT32(&error, body+rp, &rp);
+    assert_int_equal(error, EINVAL);
+    SAFEALIGN_COPY_UINT32(&id_type, body+rp, &rp);
+    assert_int_equal(id_type, SSS_ID_TYPE_NOT_SPECIFIED);
+    SAFEALIGN_COPY_UINT32(&id, body+rp, &rp);
+    assert_int_equal(id, 0);
+
+    assert_int_equal(rp, blen);
+
+    return EOK;
+}
+
+void test_nss_getidsbysids(void **state)
+{
+    errno_t ret;
+    const char *sids[3];
+
+    sids[0] = store_batch_user();
+    sids[1] = talloc_asprintf(nss_test_ctx, "%s-601",
+                              nss_test_ctx->tctx->dom->domain_id);
+    assert_non_null(sids[1]);
+    sids[2] = "not-a-sid";
+
+    mock_input_sid_list(sids, 3, 3);
+    /* Only the unknown SID is looked up in the back end */
+    mock_account_recv_simple();
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETIDSBYSIDS);
+    mock_fill_bysid();
+
+    set_cmd_cb(test_nss_getidsbysids_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETIDSBYSIDS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static int test_nss_getsidsbyids_check(uint32_t status,
+                                       uint8_t *body, size_t blen)
+{
+    size_t rp = 0;
+    uint32_t num;
+    uint32_t error;
+    uint32_t id_type;
+    const char *sid;
+    const char *expected_sid = sss_mock_ptr_type(const char *);
+
+    assert_int_equal(status, EOK);
+
+    SAFEALIGN_COPY_UINT32(&num, body+rp, &rp);
+    assert_int_equal(num, 1);
+    rp += sizeof(uint32_t); /* reserved */
+
+    SAFEALIGN_COPY_UINT32(&error, body+rp, &rp);
+    assert_int_equal(error, EOK);
+    SAFEALIGN_COPY_UINT32(&id_type, body+rp, &rp);
+    assert_int_equal(id_type, SSS_ID_TYPE_UID);
+
+    sid = (const char *) body + rp;
+    assert_string_equal(sid, expected_sid);
+    rp += strlen(sid) + 1;
+
+    assert_int_equal(rp, blen);
+
+    return EOK;
+}
+
+void test_nss_getsidsbyids(void **state)
+{
+    errno_t ret;
+    uint32_t ids[] = { testbatch.pw_uid };
+    char *user_sid;
+
+    user_sid = store_batch_user();
+
+    mock_input_id_list(ids, 1);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETSIDSBYIDS);
+    mock_fill_bysid();
+    will_return(test_nss_getsidsbyids_check, user_sid);
+
+    set_cmd_cb(test_nss_getsidsbyids_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETSIDSBYIDS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static int test_nss_batch_invalid_check(uint32_t status,
+                                        uint8_t *body, size_t blen)
+{
+    assert_int_equal(status, EINVAL);
+    assert_int_equal(blen, 0);
+
+    return EOK;
+}
+
+static int test_nss_getsidsbyids_full_check(uint32_t status,
+                                            uint8_t *body, size_t blen)
+{
+    size_t rp = 0;
+    uint32_t num;
+    uint32_t error;
+    uint32_t id_type;
+    const char *sid;
+    const char *expected_sid = sss_mock_ptr_type(const char *);
+    size_t c;
+
+    assert_int_equal(status, EOK);
+
+    SAFEALIGN_COPY_UINT32(&num, body+rp, &rp);
+    assert_int_equal(num, SSS_NSS_MAX_BATCH);
+    rp += sizeof(uint32_t); /* reserved */
+
+    for (c = 0; c < SSS_NSS_MAX_BATCH; c++) {
+        SAFEALIGN_COPY_UINT32(&error, body+rp, &rp);
+        assert_int_equal(error, EOK);
+        SAFEALIGN_COPY_UINT32(&id_type, body+rp, &rp);
+        assert_int_equal(id_type, SSS_ID_TYPE_UID);
+
+        sid = (const char *) body + rp;
+        assert_string_equal(sid, expected_sid);
+        rp += strlen(sid) + 1;
+    }
+
+    assert_int_equal(rp, blen);
+
+    return EOK;
+}
+
+void test_nss_getsidsbyids_full(void **state)
+{
+    errno_t ret;
+    uint32_t ids[SSS_NSS_MAX_BATCH];
+    char *user_sid;
+    size_t c;
+
+    user_sid = store_batch_user();
+
+    for (c = 0; c < SSS_NSS_MAX_BATCH; c++) {
+        ids[c] = testbatch.pw_uid;
+    }
+
+    mock_input_id_list(ids, SSS_NSS_MAX_BATCH);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETSIDSBYIDS);
+    mock_fill_bysid();
+    will_return(test_nss_getsidsbyids_full_check, user_sid);
+
+    set_cmd_cb(test_nss_getsidsbyids_full_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETSIDSBYIDS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static int test_nss_batch_invalid_check(uint32_t status,
+                                        uint8_t *body, size_t blen)
+{
+    assert_int_equal(status, EINVAL);
+    assert_int_equal(blen, 0);
+
+    return EOK;
+}
+
+void test_nss_getidsbysids_invalid(void **state)
+{
+    errno_t ret;
+    const char *sids[] = { "S-1-5-21-1-2-3-600" };
+    uint32_t ids[SSS_NSS_MAX_BATCH + 1] = { 0 };
+
+    /* An empty list is rejected */
+    mock_input_id_list(ids, 0);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETIDSBYSIDS);
+
+    set_cmd_cb(test_nss_batch_invalid_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETIDSBYSIDS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    /* So is a list longer than SSS_NSS_MAX_BATCH */
+    nss_test_ctx->tctx->done = false;
+
+    mock_input_id_list(ids, SSS_NSS_MAX_BATCH + 1);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETSIDSBYIDS);
+
+    set_cmd_cb(test_nss_batch_invalid_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETSIDSBYIDS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    /* And a list which announces more SIDs than it carries */
+    nss_test_ctx->tctx->done = false;
+
+    mock_input_sid_list(sids, 1, 2);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETIDSBYSIDS);
+
+    set_cmd_cb(test_nss_batch_invalid_check);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETIDSBYSIDS,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
 struct passwd testbycert = {
     .pw_name = discard_const("testcertuser"),
     .pw_uid = 23456,
@@ -4143,6 +4735,47 @@ void test_nss_getsidbyname_neg(void **state)
     assert_int_equal(ret, ENOENT);
 }
 
+static errno_t nss_sid_mc_invalidate(const char *key)
+{
+    struct sized_string sz_key;
+
+    to_sized_string(&sz_key, key);
+    return sss_mmap_cache_sid_invalidate(nss_test_ctx->nctx->sid_mc_ctx,
+                                         &sz_key);
+}
+
+void test_nss_getsidbyname_mc(void **state)
+{
+    errno_t ret;
+
+    test_nss_getsidbyname(state);
+
+    /* The answer was stored under the name from the request */
+    ret = nss_sid_mc_invalidate(MC_SID_KEY_NAME "testusersid");
+    assert_int_equal(ret, EOK);
+}
+
+void test_nss_getsidbyname_neg_mc(void **state)
+{
+    struct sized_string key;
+    struct sized_string sid;
+    struct sized_string name;
+    errno_t ret;
+
+    to_sized_string(&key, MC_SID_KEY_NAME "testnosuchsid");
+    to_sized_string(&sid, "S-1-2-3-5");
+    to_sized_string(&name, "");
+    ret = sss_mmap_cache_sid_store(&nss_test_ctx->nctx->sid_mc_ctx,
+                                   &key, &sid, &name, 0, SSS_ID_TYPE_UID);
+    assert_int_equal(ret, EOK);
+
+    test_nss_getsidbyname_neg(state);
+
+    /* The stale record was removed when the name was not found */
+    ret = nss_sid_mc_invalidate(MC_SID_KEY_NAME "testnosuchsid");
+    assert_int_equal(ret, ENOENT);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -4189,6 +4822,21 @@ int main(int argc, const char *argv[])
                                         nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getgrnam_no_members,
                                         nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getgrnam_blob_reuse,
+                                        nss_grent_blob_test_setup,
+                                        nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getgrnam_blob_sysdb_change,
+                                        nss_grent_blob_test_setup,
+                                        nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getgrnam_blob_ncache_change,
+                                        nss_grent_blob_test_setup,
+                                        nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getgrnam_blob_filtered,
+                                        nss_grent_blob_test_setup,
+                                        nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getgrnam_blob_flush,
+                                        nss_grent_blob_test_setup,
+                                        nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getgrnam_members,
                                         nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getgrnam_members_fqdn,
@@ -4273,6 +4921,14 @@ int main(int argc, const char *argv[])
                                         nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getnamebysid_update,
                                         nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getidsbysids,
+                                        nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getsidsbyids,
+                                        nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getsidsbyids_full,
+                                        nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getidsbysids_invalid,
+                                        nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getnamebycert_neg,
                                         nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getnamebycert,
@@ -4288,6 +4944,12 @@ int main(int argc, const char *argv[])
                                         nss_test_setup, nss_test_teardown),
         cmocka_unit_test_setup_teardown(test_nss_getsidbyname_neg,
                                         nss_test_setup, nss_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getsidbyname_mc,
+                                        nss_sid_mc_test_setup,
+                                        nss_sid_mc_test_teardown),
+        cmocka_unit_test_setup_teardown(test_nss_getsidbyname_neg_mc,
+                                        nss_sid_mc_test_setup,
+                                        nss_sid_mc_test_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
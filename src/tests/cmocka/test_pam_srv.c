@@ -34,6 +34,8 @@
 #include "confdb/confdb.h"
 
 #include "util/crypto/sss_crypto.h"
+#include "util/child_common.h"
+#include "p11_child/p11_child.h"
 #ifdef HAVE_NSS
 #include "util/crypto/nss/nss_util.h"
 #endif
@@ -2094,6 +2096,200 @@ void test_pam_cert_auth_double_cert(void **state)
     assert_int_equal(ret, EOK);
 }
 
+static void pam_test_preauth_cert_round(void)
+{
+    int ret;
+
+    pam_test_ctx->tctx->done = false;
+
+    mock_input_pam_cert(pam_test_ctx, "pamuser", NULL, NULL,
+                        test_lookup_by_cert_cb, NULL, false);
+
+    will_return(__wrap_sss_packet_get_cmd, SSS_PAM_PREAUTH);
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+
+    set_cmd_cb(test_pam_simple_check);
+    ret = sss_cmd_execute(pam_test_ctx->cctx, SSS_PAM_PREAUTH,
+                          pam_test_ctx->pam_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(pam_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+void test_pam_preauth_cert_reuse_child(void **state)
+{
+    struct pam_p11_child *child;
+    pid_t pid;
+
+    set_cert_auth_param(pam_test_ctx->pctx, NSS_DB);
+
+    pam_test_preauth_cert_round();
+
+    /* the child is kept for the next request */
+    child = pam_test_ctx->pctx->p11_children;
+    assert_non_null(child);
+    assert_int_equal(child->num_requests, 1);
+    pid = child->pid;
+
+    pam_test_preauth_cert_round();
+
+    child = pam_test_ctx->pctx->p11_children;
+    assert_non_null(child);
+    assert_null(child->next);
+    assert_int_equal(child->pid, pid);
+    assert_int_equal(child->num_requests, 2);
+}
+
+void test_pam_preauth_cert_retry_dead_child(void **state)
+{
+    struct pam_p11_child *child;
+    int pipefd[2];
+    pid_t pid;
+    int ret;
+
+    set_cert_auth_param(pam_test_ctx->pctx, NSS_DB);
+
+    pam_test_preauth_cert_round();
+
+    child = pam_test_ctx->pctx->p11_children;
+    assert_non_null(child);
+    pid = child->pid;
+
+    /* The idle child now looks like it died, its response never arrives
+     * and the responder only sees a closed pipe. */
+    ret = pipe(pipefd);
+    assert_int_equal(ret, 0);
+    close(child->io->read_from_child_fd);
+    child->io->read_from_child_fd = pipefd[0];
+    close(pipefd[1]);
+
+    /* The request is retried once on a new child and succeeds */
+    pam_test_preauth_cert_round();
+
+    child = pam_test_ctx->pctx->p11_children;
+    assert_non_null(child);
+    assert_int_not_equal(child->pid, pid);
+    assert_int_equal(child->num_requests, 1);
+}
+
+static pid_t p11_child_start(int *_to_child, int *_from_child)
+{
+    int to_child[2];
+    int from_child[2];
+    pid_t pid;
+    int ret;
+
+    ret = pipe(to_child);
+    assert_int_equal(ret, 0);
+    ret = pipe(from_child);
+    assert_int_equal(ret, 0);
+
+    pid = fork();
+    assert_int_not_equal(pid, -1);
+
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[1]);
+        close(from_child[0]);
+
+        execl(SSSD_LIBEXEC_PATH"/p11_child", "p11_child", "--persistent",
+              "--nssdb", NSS_DB, "--verify", "no_verification", NULL);
+        _exit(127);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+
+    *_to_child = to_child[1];
+    *_from_child = from_child[0];
+    return pid;
+}
+
+static void p11_child_send_frame(int fd, uint32_t op, uint32_t pin_mode)
+{
+    uint8_t buf[3 * sizeof(uint32_t)];
+    size_t p = 0;
+    ssize_t written;
+
+    SAFEALIGN_SET_UINT32(buf + p, 2 * sizeof(uint32_t), &p);
+    SAFEALIGN_SET_UINT32(buf + p, op, &p);
+    SAFEALIGN_SET_UINT32(buf + p, pin_mode, &p);
+
+    written = sss_atomic_write_s(fd, buf, sizeof(buf));
+    assert_int_equal(written, sizeof(buf));
+}
+
+static char *p11_child_recv_frame(TALLOC_CTX *mem_ctx, int fd,
+                                  uint32_t *_result)
+{
+    uint8_t hdr[sizeof(uint32_t)];
+    uint32_t len;
+    uint8_t *buf;
+    ssize_t nread;
+    size_t p = 0;
+
+    nread = sss_atomic_read_s(fd, hdr, sizeof(hdr));
+    assert_int_equal(nread, sizeof(hdr));
+    SAFEALIGN_COPY_UINT32(&len, hdr, NULL);
+    assert_true(len >= sizeof(uint32_t));
+
+    buf = talloc_zero_size(mem_ctx, len + 1);
+    assert_non_null(buf);
+    nread = sss_atomic_read_s(fd, buf, len);
+    assert_int_equal(nread, len);
+
+    SAFEALIGN_COPY_UINT32(_result, buf, &p);
+    return (char *) buf + p;
+}
+
+void test_p11_child_persistent_framing(void **state)
+{
+    const char *exp_data = TEST_TOKEN_NAME"\n"TEST_MODULE_NAME"\n"
+                           TEST_KEY_ID"\n"TEST_TOKEN_CERT"\n";
+    int to_child;
+    int from_child;
+    uint32_t result;
+    char *data;
+    uint8_t dummy;
+    int status;
+    pid_t pid;
+    int i;
+
+    /* Several requests are answered by the same child, which exits
+     * cleanly once its stdin is closed */
+    pid = p11_child_start(&to_child, &from_child);
+
+    for (i = 0; i < 2; i++) {
+        p11_child_send_frame(to_child, P11_CHILD_OP_PREAUTH,
+                             P11_CHILD_PIN_NONE);
+        data = p11_child_recv_frame(pam_test_ctx, from_child, &result);
+        assert_int_equal(result, EOK);
+        assert_string_equal(data, exp_data);
+    }
+
+    close(to_child);
+    assert_int_equal(sss_atomic_read_s(from_child, &dummy, 1), 0);
+    close(from_child);
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), EXIT_SUCCESS);
+
+    /* A malformed request terminates the child without a response */
+    pid = p11_child_start(&to_child, &from_child);
+
+    p11_child_send_frame(to_child, 99, P11_CHILD_PIN_NONE);
+    assert_int_equal(sss_atomic_read_s(from_child, &dummy, 1), 0);
+
+    close(to_child);
+    close(from_child);
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_not_equal(WEXITSTATUS(status), EXIT_SUCCESS);
+}
+
 void test_filter_response(void **state)
 {
     int ret;
@@ -2523,6 +2719,13 @@ int main(int argc, const char *argv[])
                                         pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_cert_auth_double_cert,
                                         pam_test_setup, pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_preauth_cert_reuse_child,
+                                        pam_test_setup, pam_test_teardown),
+        cmocka_unit_test_setup_teardown(
+                                  test_pam_preauth_cert_retry_dead_child,
+                                  pam_test_setup, pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_p11_child_persistent_framing,
+                                        pam_test_setup, pam_test_teardown),
 #endif /* HAVE_NSS */
 
         cmocka_unit_test_setup_teardown(test_filter_response,
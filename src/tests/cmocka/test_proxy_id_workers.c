@@ -0,0 +1,737 @@
+/*
+    SSSD
+
+    Unit tests for the proxy_id_child processes of the proxy provider
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <signal.h>
+
+/* In order to access the opaque types */
+#include "providers/proxy/proxy_id_workers.c"
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_proxy_id_workers_conf.ldb"
+#define TEST_DOM_NAME "proxy_id_workers_test"
+#define TEST_ID_PROVIDER "proxy"
+
+#define TEST_USER "alice"
+#define TEST_UID 10001
+#define TEST_GROUP "alicegrp"
+#define TEST_GID 20001
+/* this group only fits into the second buffer the lookup tries */
+#define TEST_BIG_GROUP "biggrp"
+#define TEST_BIG_GID 20002
+
+/* == NSS module used by the tests ========================================= */
+
+static int test_nss_calls;
+
+static enum nss_status test_fill_pwd(struct passwd *result,
+                                     char *buffer, size_t buflen,
+                                     int *errnop)
+{
+    result->pw_uid = TEST_UID;
+    result->pw_gid = TEST_GID;
+    result->pw_name = proxy_id_replay_strcpy(&buffer, &buflen, TEST_USER);
+    result->pw_passwd = proxy_id_replay_strcpy(&buffer, &buflen, "*");
+    result->pw_gecos = proxy_id_replay_strcpy(&buffer, &buflen, "Alice");
+    result->pw_dir = proxy_id_replay_strcpy(&buffer, &buflen, "/home/alice");
+    result->pw_shell = proxy_id_replay_strcpy(&buffer, &buflen, "/bin/sh");
+    if (result->pw_name == NULL || result->pw_passwd == NULL
+            || result->pw_gecos == NULL || result->pw_dir == NULL
+            || result->pw_shell == NULL) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    return NSS_STATUS_SUCCESS;
+}
+
+/* the lookups pass talloc buffers, which are aligned for the member array */
+static enum nss_status test_fill_grp(const char *name, gid_t gid,
+                                     struct group *result,
+                                     char *buffer, size_t buflen,
+                                     int *errnop)
+{
+    char **mem;
+
+    if (gid == TEST_BIG_GID && buflen < 4 * DEFAULT_BUFSIZE) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    if (2 * sizeof(char *) > buflen) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+    mem = (char **) buffer;
+    buffer += 2 * sizeof(char *);
+    buflen -= 2 * sizeof(char *);
+
+    mem[0] = proxy_id_replay_strcpy(&buffer, &buflen, TEST_USER);
+    mem[1] = NULL;
+
+    result->gr_gid = gid;
+    result->gr_mem = mem;
+    result->gr_name = proxy_id_replay_strcpy(&buffer, &buflen, name);
+    result->gr_passwd = proxy_id_replay_strcpy(&buffer, &buflen, "*");
+    if (mem[0] == NULL || result->gr_name == NULL
+            || result->gr_passwd == NULL) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    return NSS_STATUS_SUCCESS;
+}
+
+static enum nss_status test_getpwnam_r(const char *name,
+                                       struct passwd *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    test_nss_calls++;
+
+    if (strcmp(name, TEST_USER) != 0) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    return test_fill_pwd(result, buffer, buflen, errnop);
+}
+
+static enum nss_status test_getpwuid_r(uid_t uid,
+                                       struct passwd *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    test_nss_calls++;
+
+    if (uid != TEST_UID) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    return test_fill_pwd(result, buffer, buflen, errnop);
+}
+
+static enum nss_status test_getgrnam_r(const char *name,
+                                       struct group *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    test_nss_calls++;
+
+    if (strcmp(name, TEST_GROUP) == 0) {
+        return test_fill_grp(TEST_GROUP, TEST_GID, result,
+                             buffer, buflen, errnop);
+    } else if (strcmp(name, TEST_BIG_GROUP) == 0) {
+        return test_fill_grp(TEST_BIG_GROUP, TEST_BIG_GID, result,
+                             buffer, buflen, errnop);
+    }
+
+    *errnop = ENOENT;
+    return NSS_STATUS_NOTFOUND;
+}
+
+static enum nss_status test_getgrgid_r(gid_t gid,
+                                       struct group *result,
+                                       char *buffer, size_t buflen,
+                                       int *errnop)
+{
+    test_nss_calls++;
+
+    if (gid == TEST_GID) {
+        return test_fill_grp(TEST_GROUP, TEST_GID, result,
+                             buffer, buflen, errnop);
+    } else if (gid == TEST_BIG_GID) {
+        return test_fill_grp(TEST_BIG_GROUP, TEST_BIG_GID, result,
+                             buffer, buflen, errnop);
+    }
+
+    *errnop = ENOENT;
+    return NSS_STATUS_NOTFOUND;
+}
+
+static enum nss_status test_initgroups_dyn(const char *user, gid_t group,
+                                           long int *start, long int *size,
+                                           gid_t **groups, long int limit,
+                                           int *errnop)
+{
+    test_nss_calls++;
+
+    if (strcmp(user, TEST_USER) != 0) {
+        *errnop = ENOENT;
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    if (*start >= *size) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    (*groups)[*start] = TEST_BIG_GID;
+    (*start)++;
+
+    return NSS_STATUS_SUCCESS;
+}
+
+/* == fixture ============================================================== */
+
+struct proxy_id_workers_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct proxy_id_ctx *id_ctx;
+    struct proxy_id_workers *workers;
+
+    int num_done;
+};
+
+static int proxy_id_workers_test_setup(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct proxy_id_workers_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+    assert_non_null(test_ctx->be_ctx);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct proxy_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->be = test_ctx->be_ctx;
+    test_ctx->id_ctx->ops.getpwnam_r = test_getpwnam_r;
+    test_ctx->id_ctx->ops.getpwuid_r = test_getpwuid_r;
+    test_ctx->id_ctx->ops.getgrnam_r = test_getgrnam_r;
+    test_ctx->id_ctx->ops.getgrgid_r = test_getgrgid_r;
+    test_ctx->id_ctx->ops.initgroups_dyn = test_initgroups_dyn;
+
+    ret = proxy_id_workers_init(test_ctx, test_ctx->id_ctx, "test", 1,
+                                &test_ctx->workers);
+    assert_int_equal(ret, EOK);
+
+    test_nss_calls = 0;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int proxy_id_workers_test_teardown(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct proxy_id_workers_test_ctx);
+
+    talloc_free(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static struct dp_id_data *test_id_data(TALLOC_CTX *mem_ctx,
+                                       struct sss_domain_info *dom,
+                                       int entry_type,
+                                       int filter_type,
+                                       const char *value)
+{
+    struct dp_id_data *data;
+
+    data = talloc_zero(mem_ctx, struct dp_id_data);
+    assert_non_null(data);
+
+    data->entry_type = entry_type;
+    data->filter_type = filter_type;
+    if (filter_type == BE_FILTER_NAME) {
+        data->filter_value = sss_create_internal_fqname(data, value,
+                                                        dom->name);
+    } else {
+        data->filter_value = talloc_strdup(data, value);
+    }
+    assert_non_null(data->filter_value);
+
+    return data;
+}
+
+/* Runs the request through proxy_id_child's recording and returns the
+ * parsed response. */
+static struct proxy_id_recording *
+test_record(TALLOC_CTX *mem_ctx,
+            struct proxy_id_workers_test_ctx *test_ctx,
+            struct dp_id_data *data)
+{
+    struct proxy_id_recording *rec;
+    uint8_t *req;
+    size_t req_len;
+    uint8_t *resp;
+    size_t resp_len;
+    uint32_t len;
+    errno_t ret;
+
+    ret = proxy_id_job_request(mem_ctx, data, &req, &req_len);
+    assert_int_equal(ret, EOK);
+
+    ret = proxy_id_record(mem_ctx, &test_ctx->id_ctx->ops,
+                          req + sizeof(uint32_t), req_len - sizeof(uint32_t),
+                          &resp, &resp_len);
+    assert_int_equal(ret, EOK);
+
+    SAFEALIGN_COPY_UINT32(&len, resp, NULL);
+    assert_int_equal(len, resp_len - sizeof(uint32_t));
+
+    ret = proxy_id_parse_recording(mem_ctx, resp + sizeof(uint32_t), len,
+                                   &rec);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(req);
+    return rec;
+}
+
+/* == tests ================================================================ */
+
+void test_request_encoding(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct proxy_id_workers_test_ctx);
+    struct dp_id_data *data;
+    uint8_t *buf;
+    size_t len;
+    size_t p = 0;
+    uint32_t val;
+    errno_t ret;
+
+    data = test_id_data(test_ctx, test_ctx->tctx->dom, BE_REQ_USER,
+                        BE_FILTER_NAME, TEST_USER);
+    ret = proxy_id_job_request(test_ctx, data, &buf, &len);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(len, 3 * sizeof(uint32_t) + sizeof(TEST_USER));
+
+    SAFEALIGN_COPY_UINT32(&val, buf + p, &p);
+    assert_int_equal(val, len - sizeof(uint32_t));
+    SAFEALIGN_COPY_UINT32(&val, buf + p, &p);
+    assert_int_equal(val, PROXY_ID_CHILD_USER_BY_NAME);
+    SAFEALIGN_COPY_UINT32(&val, buf + p, &p);
+    assert_int_equal(val, 0);
+    assert_string_equal((char *) buf + p, TEST_USER);
+    talloc_free(buf);
+    talloc_free(data);
+
+    data = test_id_data(test_ctx, test_ctx->tctx->dom, BE_REQ_GROUP,
+                        BE_FILTER_IDNUM, "20001");
+    ret = proxy_id_job_request(test_ctx, data, &buf, &len);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(len, 3 * sizeof(uint32_t) + 1);
+
+    p = sizeof(uint32_t);
+    SAFEALIGN_COPY_UINT32(&val, buf + p, &p);
+    assert_int_equal(val, PROXY_ID_CHILD_GROUP_BY_ID);
+    SAFEALIGN_COPY_UINT32(&val, buf + p, &p);
+    assert_int_equal(val, TEST_GID);
+    assert_string_equal((char *) buf + p, "");
+    talloc_free(buf);
+    talloc_free(data);
+
+    data = test_id_data(test_ctx, test_ctx->tctx->dom, BE_REQ_GROUP,
+                        BE_FILTER_IDNUM, "200x1");
+    ret = proxy_id_job_request(test_ctx, data, &buf, &len);
+    assert_int_equal(ret, EINVAL);
+    talloc_free(data);
+}
+
+void test_reply_encoding(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct proxy_id_workers_test_ctx);
+    struct proxy_id_recording *rec;
+    struct dp_id_data *data;
+    uint8_t bad_req[2 * sizeof(uint32_t) + 2];
+    uint8_t *resp;
+    size_t resp_len;
+    size_t p;
+    errno_t ret;
+
+    data = test_id_data(test_ctx, test_ctx->tctx->dom, BE_REQ_INITGROUPS,
+                        BE_FILTER_NAME, TEST_USER);
+    rec = test_record(test_ctx, test_ctx, data);
+
+    /* getpwnam, getpwuid, initgroups, getgrgid of both groups and the
+     * retry of the big group with a larger buffer */
+    assert_int_equal(test_nss_calls, 6);
+    assert_int_equal(rec->num_records, 6);
+
+    assert_int_equal(rec->records[0].call, PROXY_ID_CHILD_GETPWNAM);
+    assert_string_equal(rec->records[0].name, TEST_USER);
+    assert_int_equal(rec->records[0].status, NSS_STATUS_SUCCESS);
+    assert_int_equal(rec->records[0].pwd.pw_uid, TEST_UID);
+    assert_string_equal(rec->records[0].pwd.pw_dir, "/home/alice");
+
+    assert_int_equal(rec->records[1].call, PROXY_ID_CHILD_GETPWUID);
+    assert_int_equal(rec->records[1].id, TEST_UID);
+    assert_string_equal(rec->records[1].pwd.pw_name, TEST_USER);
+
+    assert_int_equal(rec->records[2].call, PROXY_ID_CHILD_INITGROUPS_DYN);
+    assert_int_equal(rec->records[2].id, TEST_GID);
+    assert_int_equal(rec->records[2].num_gids, 2);
+    assert_int_equal(rec->records[2].gids[0], TEST_GID);
+    assert_int_equal(rec->records[2].gids[1], TEST_BIG_GID);
+
+    assert_int_equal(rec->records[3].call, PROXY_ID_CHILD_GETGRGID);
+    assert_int_equal(rec->records[3].id, TEST_GID);
+    assert_string_equal(rec->records[3].grp.gr_name, TEST_GROUP);
+    assert_string_equal(rec->records[3].grp.gr_mem[0], TEST_USER);
+    assert_null(rec->records[3].grp.gr_mem[1]);
+
+    assert_int_equal(rec->records[4].call, PROXY_ID_CHILD_GETGRGID);
+    assert_int_equal(rec->records[4].status, NSS_STATUS_TRYAGAIN);
+    assert_int_equal(rec->records[4].err, ERANGE);
+    assert_int_equal(rec->records[5].call, PROXY_ID_CHILD_GETGRGID);
+    assert_int_equal(rec->records[5].status, NSS_STATUS_SUCCESS);
+    assert_string_equal(rec->records[5].grp.gr_name, TEST_BIG_GROUP);
+    talloc_free(rec);
+    talloc_free(data);
+
+    /* a missing user is recorded as well */
+    data = test_id_data(test_ctx, test_ctx->tctx->dom, BE_REQ_USER,
+                        BE_FILTER_NAME, "bob");
+    rec = test_record(test_ctx, test_ctx, data);
+    assert_int_equal(rec->num_records, 1);
+    assert_int_equal(rec->records[0].status, NSS_STATUS_NOTFOUND);
+    assert_int_equal(rec->records[0].err, ENOENT);
+    talloc_free(rec);
+    talloc_free(data);
+
+    /* unknown operation */
+    p = 0;
+    SAFEALIGN_SET_UINT32(bad_req + p, 99, &p);
+    SAFEALIGN_SET_UINT32(bad_req + p, 0, &p);
+    memcpy(bad_req + p, "a", 2);
+    ret = proxy_id_record(test_ctx, &test_ctx->id_ctx->ops,
+                          bad_req, sizeof(bad_req), &resp, &resp_len);
+    assert_int_equal(ret, EINVAL);
+
+    /* name which is not terminated */
+    p = 0;
+    SAFEALIGN_SET_UINT32(bad_req + p, PROXY_ID_CHILD_USER_BY_NAME, &p);
+    SAFEALIGN_SET_UINT32(bad_req + p, 0, &p);
+    memcpy(bad_req + p, "ab", 2);
+    ret = proxy_id_record(test_ctx, &test_ctx->id_ctx->ops,
+                          bad_req, sizeof(bad_req), &resp, &resp_len);
+    assert_int_equal(ret, EINVAL);
+}
+
+void test_reply_malformed(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct proxy_id_workers_test_ctx);
+    struct proxy_id_recording *rec;
+    struct dp_id_data *data;
+    uint8_t *req;
+    size_t req_len;
+    uint8_t *resp;
+    size_t resp_len;
+    size_t len;
+    errno_t ret;
+
+    data = test_id_data(test_ctx, test_ctx->tctx->dom, BE_REQ_GROUP,
+                        BE_FILTER_NAME, TEST_GROUP);
+    ret = proxy_id_job_request(test_ctx, data, &req, &req_len);
+    assert_int_equal(ret, EOK);
+    ret = proxy_id_record(test_ctx, &test_ctx->id_ctx->ops,
+                          req + sizeof(uint32_t), req_len - sizeof(uint32_t),
+                          &resp, &resp_len);
+    assert_int_equal(ret, EOK);
+
+    /* every truncation of the response must be rejected */
+    len = resp_len - sizeof(uint32_t);
+    for (size_t i = 0; i < len; i++) {
+        ret = proxy_id_parse_recording(test_ctx, resp + sizeof(uint32_t), i,
+                                       &rec);
+        assert_int_not_equal(ret, EOK);
+    }
+
+    ret = proxy_id_parse_recording(test_ctx, resp + sizeof(uint32_t), len,
+                                   &rec);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(rec->num_records, 2);
+
+    talloc_free(rec);
+    talloc_free(resp);
+    talloc_free(req);
+    talloc_free(data);
+}
+
+void test_replay(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct proxy_id_workers_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct proxy_id_recording *rec;
+    struct dp_id_data *data;
+    struct dp_reply_std reply;
+    struct ldb_result *res;
+    char *fqname;
+    errno_t ret;
+
+    data = test_id_data(test_ctx, dom, BE_REQ_INITGROUPS,
+                        BE_FILTER_NAME, TEST_USER);
+    rec = test_record(test_ctx, test_ctx, data);
+
+    /* the backend must not call the module again */
+    test_nss_calls = 0;
+    reply = proxy_id_replay(test_ctx, test_ctx->workers, data, rec);
+    assert_int_equal(reply.dp_error, DP_ERR_OK);
+    assert_int_equal(reply.error, EOK);
+    assert_int_equal(test_nss_calls, 0);
+
+    fqname = sss_create_internal_fqname(test_ctx, TEST_USER, dom->name);
+    assert_non_null(fqname);
+    ret = sysdb_getpwnam(test_ctx, dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                                 SYSDB_UIDNUM, 0),
+                     TEST_UID);
+    talloc_free(res);
+
+    ret = sysdb_getgrgid(test_ctx, dom, TEST_BIG_GID, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    talloc_free(res);
+    talloc_free(rec);
+    talloc_free(data);
+
+    /* a recorded missing user is removed from the cache */
+    data = test_id_data(test_ctx, dom, BE_REQ_USER, BE_FILTER_IDNUM, "10001");
+    rec = test_record(test_ctx, test_ctx, data);
+    rec->records[0].status = NSS_STATUS_NOTFOUND;
+
+    test_nss_calls = 0;
+    reply = proxy_id_replay(test_ctx, test_ctx->workers, data, rec);
+    assert_int_equal(reply.dp_error, DP_ERR_OK);
+    assert_int_equal(test_nss_calls, 0);
+
+    ret = sysdb_getpwnam(test_ctx, dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 0);
+    talloc_free(res);
+    talloc_free(rec);
+
+    /* calls which were not recorded go to the module */
+    rec = talloc_zero(test_ctx, struct proxy_id_recording);
+    assert_non_null(rec);
+
+    reply = proxy_id_replay(test_ctx, test_ctx->workers, data, rec);
+    assert_int_equal(reply.dp_error, DP_ERR_OK);
+    assert_int_equal(test_nss_calls, 1);
+
+    ret = sysdb_getpwnam(test_ctx, dom, fqname, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    talloc_free(res);
+    talloc_free(rec);
+    talloc_free(data);
+    talloc_free(fqname);
+}
+
+struct test_lookup {
+    struct proxy_id_workers_test_ctx *test_ctx;
+    bool done;
+    int order;
+    errno_t ret;
+    struct dp_reply_std reply;
+};
+
+static void test_lookup_done(struct tevent_req *req)
+{
+    struct test_lookup *lookup = tevent_req_callback_data(req,
+                                                          struct test_lookup);
+
+    lookup->ret = proxy_id_workers_lookup_recv(req, &lookup->reply);
+    talloc_free(req);
+
+    lookup->done = true;
+    lookup->order = ++lookup->test_ctx->num_done;
+}
+
+static struct proxy_id_job *
+test_lookup_send(struct proxy_id_workers_test_ctx *test_ctx,
+                 struct dp_id_data *data,
+                 struct test_lookup *lookup)
+{
+    struct proxy_id_lookup_state *state;
+    struct tevent_req *req;
+
+    lookup->test_ctx = test_ctx;
+
+    req = proxy_id_workers_lookup_send(test_ctx, test_ctx->tctx->ev,
+                                       test_ctx->workers, data);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_lookup_done, lookup);
+
+    state = tevent_req_data(req, struct proxy_id_lookup_state);
+    return state->job;
+}
+
+static void test_wait_for_exit(struct proxy_id_workers_test_ctx *test_ctx,
+                               pid_t pid)
+{
+    /* the SIGCHLD handler reaps the killed child */
+    while (kill(pid, 0) == 0) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+    assert_int_equal(errno, ESRCH);
+}
+
+void test_dedupe_queue_timeout(void **state)
+{
+    struct proxy_id_workers_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct proxy_id_workers_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct test_lookup lookups[3] = { { 0 } };
+    struct proxy_id_job *jobs[3];
+    struct dp_id_data *user;
+    struct dp_id_data *group;
+    pid_t pids[2];
+
+    /* the children never answer in time */
+    test_ctx->workers->timeout = 0;
+
+    user = test_id_data(test_ctx, dom, BE_REQ_USER, BE_FILTER_NAME,
+                        TEST_USER);
+    group = test_id_data(test_ctx, dom, BE_REQ_GROUP, BE_FILTER_NAME,
+                         TEST_GROUP);
+
+    jobs[0] = test_lookup_send(test_ctx, user, &lookups[0]);
+    jobs[1] = test_lookup_send(test_ctx, user, &lookups[1]);
+    jobs[2] = test_lookup_send(test_ctx, group, &lookups[2]);
+
+    /* identical requests share the job */
+    assert_ptr_equal(jobs[0], jobs[1]);
+    assert_ptr_not_equal(jobs[0], jobs[2]);
+    assert_int_equal(hash_count(test_ctx->workers->jobs), 2);
+
+    /* only one child is allowed, the other request waits in the queue */
+    assert_int_equal(test_ctx->workers->num_children, 1);
+    assert_non_null(jobs[0]->child);
+    assert_null(jobs[2]->child);
+    assert_ptr_equal(test_ctx->workers->queue, jobs[2]);
+    pids[0] = jobs[0]->child->pid;
+
+    /* the first job times out for both waiters, then the queued one runs
+     * on a new child */
+    while (!lookups[0].done || !lookups[1].done) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+    assert_false(lookups[2].done);
+    assert_null(test_ctx->workers->queue);
+    assert_non_null(jobs[2]->child);
+    pids[1] = jobs[2]->child->pid;
+    assert_int_not_equal(pids[0], pids[1]);
+
+    while (!lookups[2].done) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        assert_int_equal(lookups[i].ret, EOK);
+        assert_int_equal(lookups[i].reply.dp_error, DP_ERR_DECIDE);
+        assert_int_equal(lookups[i].reply.error, ETIMEDOUT);
+    }
+    assert_int_equal(lookups[2].order, 3);
+
+    /* the hung children are killed and no lookup is left */
+    assert_int_equal(test_ctx->workers->num_children, 0);
+    assert_null(test_ctx->workers->idle);
+    assert_int_equal(hash_count(test_ctx->workers->jobs), 0);
+    test_wait_for_exit(test_ctx, pids[0]);
+    test_wait_for_exit(test_ctx, pids[1]);
+
+    /* the module was never called in the backend */
+    assert_int_equal(test_nss_calls, 0);
+
+    talloc_free(user);
+    talloc_free(group);
+}
+
+int main(int argc, const char *argv[])
+{
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_request_encoding,
+                                        proxy_id_workers_test_setup,
+                                        proxy_id_workers_test_teardown),
+        cmocka_unit_test_setup_teardown(test_reply_encoding,
+                                        proxy_id_workers_test_setup,
+                                        proxy_id_workers_test_teardown),
+        cmocka_unit_test_setup_teardown(test_reply_malformed,
+                                        proxy_id_workers_test_setup,
+                                        proxy_id_workers_test_teardown),
+        cmocka_unit_test_setup_teardown(test_replay,
+                                        proxy_id_workers_test_setup,
+                                        proxy_id_workers_test_teardown),
+        cmocka_unit_test_setup_teardown(test_dedupe_queue_timeout,
+                                        proxy_id_workers_test_setup,
+                                        proxy_id_workers_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
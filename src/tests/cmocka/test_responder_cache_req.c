@@ -22,11 +22,13 @@
 #include <tevent.h>
 #include <errno.h>
 #include <popt.h>
+#include <time.h>
 
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
 #include "db/sysdb.h"
 #include "responder/common/cache_req/cache_req.h"
+#include "responder/common/cache_req/cache_req_private.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
 #define TEST_CONF_DB "test_responder_cache_req_conf.ldb"
@@ -653,6 +655,148 @@ void test_user_by_name_multiple_domains_parse(void **state)
     talloc_free(input_fqn);
 }
 
+void test_user_by_name_multiple_domains_parse_cached(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain = NULL;
+    char *input_fqn;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+
+    domain = find_domain_by_name(test_ctx->tctx->dom,
+                                 "responder_cache_req_test_d", true);
+    assert_non_null(domain);
+
+    prepare_user(domain, &users[0], 1000, time(NULL));
+
+    input_fqn = talloc_asprintf(test_ctx, "%s@%s", users[0].short_name,
+                                "responder_cache_req_test_d");
+    assert_non_null(input_fqn);
+
+    /* With a known list of domains the name is parsed without
+     * sss_parse_inp_send(), so nothing is mocked here. The second
+     * request is served from the name cache. */
+    gettimeofday(&test_ctx->rctx->get_domains_last_call, NULL);
+
+    for (i = 0; i < 2; i++) {
+        run_cache_req_domtype(test_ctx, cache_req_user_by_name_send,
+                              cache_req_user_by_name_test_done, NULL,
+                              0, CACHE_REQ_POSIX_DOM, input_fqn, ERR_OK);
+        assert_false(test_ctx->dp_called);
+        check_user(test_ctx, &users[0], domain);
+        assert_non_null(test_ctx->rctx->cr_name_cache);
+        talloc_zfree(test_ctx->result);
+    }
+
+    talloc_zfree(test_ctx->rctx->cr_name_cache);
+    talloc_free(input_fqn);
+}
+
+#define TEST_BENCH_NAMES 100
+#define TEST_BENCH_ROUNDS 200
+
+static double test_elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    int ret;
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &now);
+    assert_int_equal(ret, 0);
+
+    return (now.tv_sec - start->tv_sec)
+                + (now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+/* Compare parsing every input name with the cached parsing done by
+ * cache_req and report the cost of a whole cached lookup. The timings are
+ * only reported since they depend on the machine running the test. */
+void test_user_by_name_parse_bench(void **state)
+{
+    struct cache_req_test_ctx *test_ctx = NULL;
+    struct sss_domain_info *domain = NULL;
+    const char *cached_name;
+    const char *cached_domain;
+    struct timespec start;
+    double parsed;
+    double cached;
+    double lookup;
+    char **inputs;
+    char *domname;
+    char *name;
+    errno_t ret;
+    int r;
+    int i;
+
+    test_ctx = talloc_get_type_abort(*state, struct cache_req_test_ctx);
+
+    domain = find_domain_by_name(test_ctx->tctx->dom,
+                                 "responder_cache_req_test_d", true);
+    assert_non_null(domain);
+
+    prepare_user(domain, &users[0], 1000, time(NULL));
+
+    inputs = talloc_array(test_ctx, char *, TEST_BENCH_NAMES);
+    assert_non_null(inputs);
+    for (i = 0; i < TEST_BENCH_NAMES; i++) {
+        inputs[i] = talloc_asprintf(inputs, "bench-user%d@%s", i,
+                                    domains[i % 4]);
+        assert_non_null(inputs[i]);
+    }
+
+    gettimeofday(&test_ctx->rctx->get_domains_last_call, NULL);
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int_equal(ret, 0);
+    for (r = 0; r < TEST_BENCH_ROUNDS; r++) {
+        for (i = 0; i < TEST_BENCH_NAMES; i++) {
+            ret = sss_parse_name_for_domains(test_ctx, test_ctx->rctx->domains,
+                                             NULL, inputs[i], &domname, &name);
+            assert_int_equal(ret, EOK);
+            talloc_free(domname);
+            talloc_free(name);
+        }
+    }
+    parsed = test_elapsed(&start);
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int_equal(ret, 0);
+    for (r = 0; r < TEST_BENCH_ROUNDS; r++) {
+        for (i = 0; i < TEST_BENCH_NAMES; i++) {
+            ret = cache_req_name_cache_parse(test_ctx->rctx, false, inputs[i],
+                                             &cached_name, &cached_domain);
+            assert_int_equal(ret, EOK);
+            assert_string_equal(cached_domain, domains[i % 4]);
+        }
+    }
+    cached = test_elapsed(&start);
+
+    name = talloc_asprintf(test_ctx, "%s@%s", users[0].short_name,
+                           domain->name);
+    assert_non_null(name);
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int_equal(ret, 0);
+    for (r = 0; r < TEST_BENCH_ROUNDS; r++) {
+        run_cache_req_domtype(test_ctx, cache_req_user_by_name_send,
+                              cache_req_user_by_name_test_done, NULL,
+                              0, CACHE_REQ_POSIX_DOM, name, ERR_OK);
+        assert_false(test_ctx->dp_called);
+        talloc_zfree(test_ctx->result);
+    }
+    lookup = test_elapsed(&start);
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "%d names parsed %d times: parsed %.3fs, cached %.3fs; "
+          "%d cached lookups by name: %.3fs\n",
+          TEST_BENCH_NAMES, TEST_BENCH_ROUNDS, parsed, cached,
+          TEST_BENCH_ROUNDS, lookup);
+
+    talloc_zfree(test_ctx->rctx->cr_name_cache);
+    talloc_free(name);
+    talloc_free(inputs);
+}
+
 void test_user_by_name_cache_valid(void **state)
 {
     struct cache_req_test_ctx *test_ctx = NULL;
@@ -2152,6 +2296,8 @@ int main(int argc, const char *argv[])
         new_multi_domain_test(user_by_name_multiple_domains_found),
         new_multi_domain_test(user_by_name_multiple_domains_notfound),
         new_multi_domain_test(user_by_name_multiple_domains_parse),
+        new_multi_domain_test(user_by_name_multiple_domains_parse_cached),
+        new_multi_domain_test(user_by_name_parse_bench),
 
         new_single_domain_test(user_by_upn_cache_valid),
         new_single_domain_test(user_by_upn_cache_expired),
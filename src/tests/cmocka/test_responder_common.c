@@ -24,9 +24,11 @@
 #include <tevent.h>
 #include <errno.h>
 #include <popt.h>
+#include <sys/socket.h>
 
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
+#include "responder/common/responder_packet.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
 #define TEST_CONF_DB "test_responder_conf.ldb"
@@ -316,6 +318,74 @@ void test_schedule_get_domains_task(void **state)
     talloc_free(dummy_ncache_ptr);
 }
 
+/* Writes a request of the given body size to fd and reads it back as the
+ * responder does. */
+static errno_t packet_recv_request(enum sss_cli_command cmd, size_t body_len)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_packet *packet;
+    uint8_t *buf;
+    size_t len = SSS_NSS_HEADER_SIZE + body_len;
+    size_t rp = 0;
+    ssize_t wb;
+    int fds[2];
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert_int_equal(ret, 0);
+
+    buf = talloc_zero_array(tmp_ctx, uint8_t, len);
+    assert_non_null(buf);
+    SAFEALIGN_SET_UINT32(buf + rp, len, &rp);
+    SAFEALIGN_SET_UINT32(buf + rp, cmd, &rp);
+
+    wb = sss_atomic_write_s(fds[1], buf, len);
+    assert_int_equal(wb, len);
+
+    ret = sss_packet_new(tmp_ctx, SSS_PACKET_MAX_RECV_SIZE, 0, &packet);
+    assert_int_equal(ret, EOK);
+
+    do {
+        ret = sss_packet_recv(packet, fds[0]);
+    } while (ret == EAGAIN);
+
+    if (ret == EOK) {
+        sss_packet_get_body(packet, &buf, &len);
+        assert_int_equal(len, body_len);
+        assert_int_equal(sss_packet_get_cmd(packet), cmd);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+void test_packet_recv_batch(void **state)
+{
+    errno_t ret;
+
+    /* A full-size batch is accepted... */
+    ret = packet_recv_request(SSS_NSS_GETIDSBYSIDS, SSS_NSS_MAX_BATCH_SIZE);
+    assert_int_equal(ret, EOK);
+
+    ret = packet_recv_request(SSS_NSS_GETSIDSBYIDS,
+                              (SSS_NSS_MAX_BATCH + 1) * sizeof(uint32_t));
+    assert_int_equal(ret, EOK);
+
+    /* ...but not a larger one */
+    ret = packet_recv_request(SSS_NSS_GETNAMESBYSIDS,
+                              SSS_NSS_MAX_BATCH_SIZE + 1);
+    assert_int_equal(ret, EINVAL);
+
+    /* Other requests keep the default limit */
+    ret = packet_recv_request(SSS_NSS_GETPWNAM, SSS_PACKET_MAX_RECV_SIZE);
+    assert_int_equal(ret, EINVAL);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -346,6 +416,7 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_schedule_get_domains_task,
                                         parse_inp_test_setup,
                                         parse_inp_test_teardown),
+        cmocka_unit_test(test_packet_recv_batch),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
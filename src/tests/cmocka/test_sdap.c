@@ -22,6 +22,7 @@
 #include <tevent.h>
 #include <errno.h>
 #include <popt.h>
+#include <time.h>
 
 #include "tests/cmocka/common_mock.h"
 #include "providers/ldap/ldap_opts.h"
@@ -475,6 +476,192 @@ void test_parse_dups(void **state)
     talloc_free(attrs);
 }
 
+#define TEST_WIDE_EXTRA_ATTRS 64
+#define TEST_WIDE_BENCH_LOOPS 500
+
+/* Build an entry that contains every attribute of @map plus @extra attributes
+ * the map does not know about, each of them with two values. */
+static struct mock_ldap_entry *mock_wide_entry(TALLOC_CTX *mem_ctx,
+                                               struct sdap_attr_map *map,
+                                               int attrs_num,
+                                               size_t extra)
+{
+    struct mock_ldap_entry *entry;
+    struct mock_ldap_attr *attrs;
+    const char **values;
+    size_t n = 0;
+    size_t j;
+    int i;
+
+    entry = talloc_zero(mem_ctx, struct mock_ldap_entry);
+    assert_non_null(entry);
+    entry->dn = "cn=wideuser,dc=example,dc=com";
+
+    attrs = talloc_zero_array(entry, struct mock_ldap_attr,
+                              attrs_num + extra + 1);
+    assert_non_null(attrs);
+
+    values = talloc_zero_array(attrs, const char *, 2);
+    assert_non_null(values);
+    values[0] = map[0].name;
+    attrs[n].name = "objectClass";
+    attrs[n].values = values;
+    n++;
+
+    for (i = 1; i < attrs_num; i++) {
+        if (map[i].name == NULL) continue;
+
+        /* The same LDAP attribute may be mapped more than once */
+        for (j = 0; j < n; j++) {
+            if (strcasecmp(attrs[j].name, map[i].name) == 0) break;
+        }
+        if (j < n) continue;
+
+        attrs[n].name = map[i].name;
+        n++;
+    }
+
+    for (j = 0; j < extra; j++) {
+        attrs[n].name = talloc_asprintf(attrs, "wideExtra%zu", j);
+        assert_non_null(attrs[n].name);
+        n++;
+    }
+
+    for (j = 1; j < n; j++) {
+        values = talloc_zero_array(attrs, const char *, 3);
+        assert_non_null(values);
+        values[0] = talloc_asprintf(values, "%s-1", attrs[j].name);
+        assert_non_null(values[0]);
+        values[1] = talloc_asprintf(values, "%s-2", attrs[j].name);
+        assert_non_null(values[1]);
+        attrs[j].values = values;
+    }
+
+    entry->attrs = attrs;
+    return entry;
+}
+
+static double test_elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    int ret;
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &now);
+    assert_int_equal(ret, 0);
+
+    return (now.tv_sec - start->tv_sec)
+                + (now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+void test_parse_wide_entry(void **state)
+{
+    int ret;
+    struct sysdb_attrs *attrs;
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    struct mock_ldap_entry *entry;
+    struct sdap_attr_map *map;
+    struct ldb_message_element *el;
+    size_t nattrs;
+    size_t j;
+    int i;
+
+    ret = sdap_copy_map(test_ctx, ipa_user_map, SDAP_OPTS_USER, &map);
+    assert_int_equal(ret, ERR_OK);
+
+    entry = mock_wide_entry(test_ctx, map, SDAP_OPTS_USER,
+                            TEST_WIDE_EXTRA_ATTRS);
+    set_entry_parse(entry);
+
+    ret = sdap_parse_entry(test_ctx, &test_ctx->sh, &test_ctx->sm,
+                           map, SDAP_OPTS_USER,
+                           &attrs, false);
+    assert_int_equal(ret, ERR_OK);
+
+    assert_entry_has_attr(attrs, SYSDB_ORIG_DN, entry->dn);
+    /* Every mapped attribute gets all the values */
+    for (i = 1; i < SDAP_OPTS_USER; i++) {
+        if (map[i].name == NULL) continue;
+
+        ret = sysdb_attrs_get_el_ext(attrs, map[i].sys_name, false, &el);
+        assert_int_equal(ret, ERR_OK);
+        assert_true(el->num_values >= 2);
+    }
+    assert_entry_has_no_attr(attrs, "wideExtra0");
+    talloc_free(attrs);
+
+    /* Without a map all attributes are stored as they are */
+    ret = sdap_parse_entry(test_ctx, &test_ctx->sh, &test_ctx->sm,
+                           NULL, 0, &attrs, false);
+    assert_int_equal(ret, ERR_OK);
+
+    for (nattrs = 0; entry->attrs[nattrs].name != NULL; nattrs++);
+    assert_int_equal(attrs->num, nattrs + 1);
+
+    for (j = 0; j < nattrs; j++) {
+        ret = sysdb_attrs_get_el_ext(attrs, entry->attrs[j].name, false, &el);
+        assert_int_equal(ret, ERR_OK);
+        assert_string_equal(el->name, entry->attrs[j].name);
+        if (j == 0) continue; /* objectClass */
+
+        assert_int_equal(el->num_values, 2);
+        assert_string_equal((const char *)el->values[0].data,
+                            entry->attrs[j].values[0]);
+        assert_string_equal((const char *)el->values[1].data,
+                            entry->attrs[j].values[1]);
+    }
+
+    /* Lookups are case insensitive */
+    ret = sysdb_attrs_get_el_ext(attrs, "WIDEEXTRA1", false, &el);
+    assert_int_equal(ret, ERR_OK);
+    assert_string_equal(el->name, "wideExtra1");
+
+    talloc_free(attrs);
+    talloc_free(entry);
+    talloc_free(map);
+}
+
+/* Parse a large entry over and over, the timing is only reported since it
+ * depends on the machine running the test. */
+void test_parse_wide_entry_bench(void **state)
+{
+    int ret;
+    struct sysdb_attrs *attrs;
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    struct mock_ldap_entry *entry;
+    struct sdap_attr_map *map;
+    struct timespec start;
+    double elapsed;
+    int i;
+
+    ret = sdap_copy_map(test_ctx, ipa_user_map, SDAP_OPTS_USER, &map);
+    assert_int_equal(ret, ERR_OK);
+
+    entry = mock_wide_entry(test_ctx, map, SDAP_OPTS_USER,
+                            TEST_WIDE_EXTRA_ATTRS);
+    set_entry_parse(entry);
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int_equal(ret, 0);
+    for (i = 0; i < TEST_WIDE_BENCH_LOOPS; i++) {
+        ret = sdap_parse_entry(test_ctx, &test_ctx->sh, &test_ctx->sm,
+                               map, SDAP_OPTS_USER,
+                               &attrs, false);
+        assert_int_equal(ret, ERR_OK);
+        talloc_free(attrs);
+    }
+    elapsed = test_elapsed(&start);
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "%d entries with %d map and %d extra attributes parsed in %.3fs\n",
+          TEST_WIDE_BENCH_LOOPS, SDAP_OPTS_USER, TEST_WIDE_EXTRA_ATTRS,
+          elapsed);
+
+    talloc_free(entry);
+    talloc_free(map);
+}
+
 void test_parse_deref(void **state)
 {
     errno_t ret;
@@ -1142,6 +1329,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_parse_dups,
                                         parse_entry_test_setup,
                                         parse_entry_test_teardown),
+        cmocka_unit_test_setup_teardown(test_parse_wide_entry,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
+        cmocka_unit_test_setup_teardown(test_parse_wide_entry_bench,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
         cmocka_unit_test_setup_teardown(test_parse_deref,
                                         parse_entry_test_setup,
                                         parse_entry_test_teardown),
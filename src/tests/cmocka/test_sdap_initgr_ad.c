@@ -0,0 +1,528 @@
+/*
+    SSSD
+
+    Unit tests for the batched resolution of tokenGroups SIDs
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+#include "tests/cmocka/common_mock_sysdb_objects.h"
+
+/* In order to access the opaque types */
+#include "providers/ldap/sdap_async_initgroups_ad.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_sdap_initgr_ad_conf.ldb"
+#define TEST_ID_PROVIDER "ad"
+
+#define TEST_DOM1_NAME "dom1.test"
+#define TEST_DOM2_NAME "dom2.test"
+
+#define TEST_DOM1_SID "S-1-5-21-1-2-3"
+#define TEST_DOM2_SID "S-1-5-21-4-5-6"
+
+#define OBJECT_BASE_DN1 "dc=dom1,dc=test"
+#define OBJECT_BASE_DN2 "dc=dom2,dc=test"
+#define GROUP_BASE_DN1 "cn=groups," OBJECT_BASE_DN1
+#define GROUP_BASE_DN2 "cn=groups," OBJECT_BASE_DN2
+
+/* global security group */
+#define TEST_GROUP_TYPE "-2147483646"
+
+#define TEST_MAX_SEARCHES 10
+
+const char *domains[] = { TEST_DOM1_NAME,
+                          TEST_DOM2_NAME,
+                          NULL };
+
+struct test_search {
+    const char *search_base;
+    const char *filter;
+};
+
+struct test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct sdap_options *opts;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_id_conn_ctx *conn;
+    struct sss_domain_info *dom2;
+
+    struct test_search searches[TEST_MAX_SEARCHES];
+    size_t num_searches;
+};
+
+static struct test_ctx *global_test_ctx;
+
+/* Mock the connection handling */
+struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx,
+                                     struct sdap_id_conn_cache *cache)
+{
+    return (struct sdap_id_op *) talloc_new(memctx);
+}
+
+struct tevent_req *sdap_id_op_connect_send(struct sdap_id_op *op,
+                                           TALLOC_CTX *memctx,
+                                           int *ret_out)
+{
+    return test_req_succeed_send(memctx, global_test_ctx->tctx->ev);
+}
+
+int sdap_id_op_connect_recv(struct tevent_req *req, int *dp_error)
+{
+    *dp_error = DP_ERR_OK;
+    return test_request_recv(req);
+}
+
+struct sdap_handle *sdap_id_op_handle(struct sdap_id_op *op)
+{
+    return NULL;
+}
+
+int sdap_id_op_done(struct sdap_id_op *op, int retval, int *dp_error)
+{
+    /* no reconnection is attempted */
+    *dp_error = retval == EOK ? DP_ERR_OK : DP_ERR_FATAL;
+    return retval;
+}
+
+/* Mock the search, the filters are recorded for the test to inspect */
+struct tevent_req *sdap_get_generic_send(TALLOC_CTX *memctx,
+                                         struct tevent_context *ev,
+                                         struct sdap_options *opts,
+                                         struct sdap_handle *sh,
+                                         const char *search_base,
+                                         int scope,
+                                         const char *filter,
+                                         const char **attrs,
+                                         struct sdap_attr_map *map,
+                                         int map_num_attrs,
+                                         int timeout,
+                                         bool allow_paging)
+{
+    struct test_search *search;
+
+    assert_true(global_test_ctx->num_searches < TEST_MAX_SEARCHES);
+    search = &global_test_ctx->searches[global_test_ctx->num_searches];
+    global_test_ctx->num_searches++;
+
+    search->search_base = talloc_strdup(global_test_ctx, search_base);
+    assert_non_null(search->search_base);
+    search->filter = talloc_strdup(global_test_ctx, filter);
+    assert_non_null(search->filter);
+
+    return test_req_succeed_send(memctx, ev);
+}
+
+int sdap_get_generic_recv(struct tevent_req *req,
+                          TALLOC_CTX *mem_ctx,
+                          size_t *reply_count,
+                          struct sysdb_attrs ***reply)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *reply_count = sss_mock_type(size_t);
+    *reply = talloc_steal(mem_ctx,
+                          sss_mock_ptr_type(struct sysdb_attrs **));
+
+    return sss_mock_type(int);
+}
+
+static void will_return_search(size_t count,
+                               struct sysdb_attrs **reply,
+                               errno_t ret)
+{
+    will_return(sdap_get_generic_recv, count);
+    will_return(sdap_get_generic_recv, reply);
+    will_return(sdap_get_generic_recv, ret);
+}
+
+static char **test_sids(TALLOC_CTX *mem_ctx,
+                        const char *dom_sid,
+                        uint32_t first_rid,
+                        size_t count,
+                        char **sids,
+                        size_t *_num_sids)
+{
+    size_t num_sids = *_num_sids;
+    size_t i;
+
+    sids = talloc_realloc(mem_ctx, sids, char *, num_sids + count + 1);
+    assert_non_null(sids);
+
+    for (i = 0; i < count; i++) {
+        sids[num_sids + i] = talloc_asprintf(sids, "%s-%"PRIu32,
+                                             dom_sid, first_rid + i);
+        assert_non_null(sids[num_sids + i]);
+    }
+
+    *_num_sids = num_sids + count;
+    sids[*_num_sids] = NULL;
+
+    return sids;
+}
+
+static struct sysdb_attrs *test_group(TALLOC_CTX *mem_ctx,
+                                      const char *sid,
+                                      gid_t gid)
+{
+    struct sysdb_attrs *group;
+    char *name;
+
+    name = talloc_asprintf(mem_ctx, "group%"SPRIgid, gid);
+    assert_non_null(name);
+
+    group = mock_sysdb_object(mem_ctx, GROUP_BASE_DN1, name,
+                              SYSDB_GIDNUM, gid,
+                              SYSDB_SID, sid,
+                              SYSDB_GROUP_TYPE, TEST_GROUP_TYPE);
+    assert_non_null(group);
+    talloc_free(name);
+
+    return group;
+}
+
+static size_t count_sids(const char *filter)
+{
+    const char *p;
+    size_t count = 0;
+
+    for (p = strstr(filter, "(objectSID="); p != NULL;
+         p = strstr(p + 1, "(objectSID=")) {
+        count++;
+    }
+
+    return count;
+}
+
+static bool filter_has_sid(const char *filter, const char *sid)
+{
+    char *needle;
+    bool found;
+
+    needle = talloc_asprintf(NULL, "(objectSID=%s)", sid);
+    assert_non_null(needle);
+    found = strstr(filter, needle) != NULL;
+    talloc_free(needle);
+
+    return found;
+}
+
+/* The SIDs with the indexes from @from up to @to are looked up by the
+ * search with @filter */
+static void assert_filter_has_sids(const char *filter,
+                                   char **sids,
+                                   size_t from,
+                                   size_t to)
+{
+    size_t i;
+
+    for (i = from; i <= to; i++) {
+        assert_true(filter_has_sid(filter, sids[i]));
+    }
+}
+
+static void assert_group_cached(struct test_ctx *test_ctx,
+                                gid_t gid,
+                                bool cached)
+{
+    struct ldb_result *res;
+    errno_t ret;
+
+    ret = sysdb_getgrgid(test_ctx, test_ctx->tctx->dom, gid, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, cached ? 1 : 0);
+    talloc_free(res);
+}
+
+static void test_resolve_sids_done(struct tevent_req *req)
+{
+    struct test_ctx *test_ctx = tevent_req_callback_data(req,
+                                                         struct test_ctx);
+
+    test_ctx->tctx->error = sdap_ad_resolve_sids_recv(req);
+    test_ctx->tctx->done = true;
+    talloc_free(req);
+}
+
+static struct tevent_req *test_resolve_sids_send(struct test_ctx *test_ctx,
+                                                 char **sids)
+{
+    struct tevent_req *req;
+
+    req = sdap_ad_resolve_sids_send(test_ctx, test_ctx->tctx->ev,
+                                    test_ctx->id_ctx, test_ctx->conn,
+                                    test_ctx->opts, test_ctx->tctx->dom,
+                                    sids);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_resolve_sids_done, test_ctx);
+
+    return req;
+}
+
+static int test_sdap_initgr_ad_setup(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { "ldap_schema", "ad" },
+        { "ldap_search_base", OBJECT_BASE_DN1 },
+        { "ldap_group_search_base", GROUP_BASE_DN1 },
+        { NULL, NULL },
+    };
+    struct sss_test_conf_param *dom_params[] = { params, params, NULL };
+    struct sdap_idmap_ctx *idmap_ctx;
+    struct sdap_domain *sdom2;
+    struct test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_multidom_test_ctx(test_ctx, TESTS_PATH,
+                                              TEST_CONF_DB, domains,
+                                              TEST_ID_PROVIDER, dom_params);
+    assert_non_null(test_ctx->tctx);
+    test_ctx->dom2 = test_ctx->tctx->dom->next;
+    assert_non_null(test_ctx->dom2);
+
+    ret = ldap_get_options(test_ctx, test_ctx->tctx->dom,
+                           test_ctx->tctx->confdb,
+                           test_ctx->tctx->conf_dom_path,
+                           &test_ctx->opts);
+    assert_int_equal(ret, EOK);
+
+    /* the groups of the second domain live below its own search base */
+    ret = sdap_domain_add(test_ctx->opts, test_ctx->dom2, &sdom2);
+    assert_int_equal(ret, EOK);
+
+    sdom2->search_bases = talloc_zero_array(sdom2,
+                                            struct sdap_search_base *, 2);
+    assert_non_null(sdom2->search_bases);
+    ret = sdap_create_search_base(sdom2, OBJECT_BASE_DN2,
+                                  LDAP_SCOPE_SUBTREE, NULL,
+                                  &sdom2->search_bases[0]);
+    assert_int_equal(ret, EOK);
+
+    sdom2->group_search_bases = talloc_zero_array(sdom2,
+                                                  struct sdap_search_base *,
+                                                  2);
+    assert_non_null(sdom2->group_search_bases);
+    ret = sdap_create_search_base(sdom2, GROUP_BASE_DN2,
+                                  LDAP_SCOPE_SUBTREE, NULL,
+                                  &sdom2->group_search_bases[0]);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+    assert_non_null(test_ctx->be_ctx);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->be = test_ctx->be_ctx;
+    test_ctx->id_ctx->opts = test_ctx->opts;
+
+    test_ctx->conn = talloc_zero(test_ctx, struct sdap_id_conn_ctx);
+    assert_non_null(test_ctx->conn);
+
+    ret = sdap_idmap_init(test_ctx, test_ctx->id_ctx, &idmap_ctx);
+    assert_int_equal(ret, EOK);
+    test_ctx->opts->idmap_ctx = idmap_ctx;
+
+    test_ctx->tctx->dom->domain_id = talloc_strdup(test_ctx->tctx->dom,
+                                                   TEST_DOM1_SID);
+    assert_non_null(test_ctx->tctx->dom->domain_id);
+    test_ctx->dom2->domain_id = talloc_strdup(test_ctx->dom2, TEST_DOM2_SID);
+    assert_non_null(test_ctx->dom2->domain_id);
+
+    global_test_ctx = test_ctx;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_sdap_initgr_ad_teardown(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+
+    global_test_ctx = NULL;
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+void test_resolve_sids_batches(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    struct sdap_ad_resolve_sids_state *sids_state;
+    struct sdap_ad_resolve_sids_batch *batches;
+    struct tevent_req *req;
+    char **sids = NULL;
+    size_t num_sids = 0;
+    size_t expected[] = { 50, 50, 10, 50, 5 };
+    size_t i;
+    errno_t ret;
+
+    /* 60 SIDs of the first domain, 10 of the second one, one of an
+     * unknown domain and another 95 of the first domain */
+    sids = test_sids(test_ctx, TEST_DOM1_SID, 1000, 60, sids, &num_sids);
+    sids = test_sids(test_ctx, TEST_DOM2_SID, 1000, 10, sids, &num_sids);
+    sids = test_sids(test_ctx, "S-1-5-21-7-8-9", 1000, 1, sids, &num_sids);
+    sids = test_sids(test_ctx, TEST_DOM1_SID, 2000, 95, sids, &num_sids);
+
+    req = test_resolve_sids_send(test_ctx, sids);
+    sids_state = tevent_req_data(req, struct sdap_ad_resolve_sids_state);
+    batches = sids_state->batches;
+
+    /* the second batch of the first domain is filled up before a new one
+     * is started, the SID of the unknown domain is skipped */
+    assert_int_equal(sids_state->num_batches, 5);
+    for (i = 0; i < 5; i++) {
+        assert_int_equal(batches[i].num_sids, expected[i]);
+        assert_ptr_equal(batches[i].sdom->dom,
+                         i == 2 ? test_ctx->dom2 : test_ctx->tctx->dom);
+    }
+    assert_ptr_equal(batches[0].sids[0], sids[0]);
+    assert_ptr_equal(batches[1].sids[0], sids[50]);
+    assert_ptr_equal(batches[1].sids[10], sids[71]);
+    assert_ptr_equal(batches[2].sids[0], sids[60]);
+    assert_ptr_equal(batches[3].sids[0], sids[111]);
+    assert_ptr_equal(batches[4].sids[4], sids[165]);
+
+    /* only a limited number of batches is searched at the same time */
+    assert_int_equal(sids_state->num_reqs, SDAP_AD_RESOLVE_SIDS_MAX_REQS);
+    assert_int_equal(sids_state->next_batch, SDAP_AD_RESOLVE_SIDS_MAX_REQS);
+
+    /* none of the groups is found */
+    for (i = 0; i < 5; i++) {
+        will_return_search(0, NULL, EOK);
+    }
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    /* one search with an OR-ed filter per batch */
+    assert_int_equal(test_ctx->num_searches, 5);
+    for (i = 0; i < 5; i++) {
+        assert_string_equal(test_ctx->searches[i].search_base,
+                            i == 2 ? GROUP_BASE_DN2 : GROUP_BASE_DN1);
+        assert_int_equal(count_sids(test_ctx->searches[i].filter),
+                         expected[i]);
+    }
+
+    assert_filter_has_sids(test_ctx->searches[0].filter, sids, 0, 49);
+    assert_filter_has_sids(test_ctx->searches[1].filter, sids, 50, 59);
+    assert_filter_has_sids(test_ctx->searches[1].filter, sids, 71, 110);
+    assert_filter_has_sids(test_ctx->searches[2].filter, sids, 60, 69);
+    assert_filter_has_sids(test_ctx->searches[3].filter, sids, 111, 160);
+    assert_filter_has_sids(test_ctx->searches[4].filter, sids, 161, 165);
+
+    talloc_free(sids);
+}
+
+void test_resolve_sids_batch_fails(void **state)
+{
+    struct test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct test_ctx);
+    struct sysdb_attrs **groups;
+    char **sids = NULL;
+    size_t num_sids = 0;
+    errno_t ret;
+
+    sids = test_sids(test_ctx, TEST_DOM1_SID, 1000, 120, sids, &num_sids);
+
+    /* only two groups of the first batch are found */
+    groups = talloc_array(test_ctx, struct sysdb_attrs *, 2);
+    assert_non_null(groups);
+    groups[0] = test_group(groups, sids[0], 5000);
+    groups[1] = test_group(groups, sids[1], 5001);
+    will_return_search(2, groups, EOK);
+
+    /* the second batch fails, the third one is not waited for */
+    will_return_search(0, NULL, EIO);
+
+    test_resolve_sids_send(test_ctx, sids);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EIO);
+    assert_int_equal(test_ctx->num_searches, 3);
+
+    /* the groups of the batch which succeeded are kept */
+    assert_group_cached(test_ctx, 5000, true);
+    assert_group_cached(test_ctx, 5001, true);
+    assert_group_cached(test_ctx, 5002, false);
+
+    talloc_free(sids);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_resolve_sids_batches,
+                                        test_sdap_initgr_ad_setup,
+                                        test_sdap_initgr_ad_teardown),
+        cmocka_unit_test_setup_teardown(test_resolve_sids_batch_fails,
+                                        test_sdap_initgr_ad_setup,
+                                        test_sdap_initgr_ad_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_multidom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, domains);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        test_multidom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, domains);
+    }
+
+    return rv;
+}
@@ -0,0 +1,778 @@
+/*
+    SSSD
+
+    Unit tests for streaming of paged LDAP search results
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_idmap.h"
+
+/* In order to access the opaque types and to feed the replies directly to
+ * the operation */
+#include "providers/ldap/sdap_async.c"
+#include "providers/ldap/sdap_async_users.c"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_sdap_stream_conf.ldb"
+#define TEST_DOM_NAME "sdap_stream_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define OBJECT_BASE_DN "dc=example,dc=com"
+#define USER_BASE_DN "cn=users," OBJECT_BASE_DN
+
+#define TEST_PAGE_SIZE 2
+
+/* mock an LDAP reply, the wrappers below read it instead of a real
+ * LDAPMessage */
+struct mock_ldap_attr {
+    const char *name;
+    const char **values;
+};
+
+struct mock_ldap_msg {
+    int msgid;
+    int msgtype;
+
+    /* LDAP_RES_SEARCH_ENTRY */
+    const char *dn;
+    struct mock_ldap_attr *attrs;
+    int attr_iter;
+
+    /* LDAP_RES_SEARCH_RESULT */
+    LDAPControl **controls;
+};
+
+struct sdap_stream_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct sdap_options *opts;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_handle *sh;
+
+    size_t num_chunks;
+    size_t chunk_sizes[10];
+    uid_t uids[20];
+    size_t num_uids;
+    errno_t cb_ret;
+    size_t fail_chunk;
+
+    bool done;
+    errno_t ret;
+    size_t total_count;
+};
+
+static int test_abandoned;
+
+/* libldap wrappers */
+int __wrap_ldap_search_ext(LDAP *ld,
+                           LDAP_CONST char *base,
+                           int scope,
+                           LDAP_CONST char *filter,
+                           char **attrs,
+                           int attrsonly,
+                           LDAPControl **serverctrls,
+                           LDAPControl **clientctrls,
+                           struct timeval *timeout,
+                           int sizelimit,
+                           int *msgidp)
+{
+    *msgidp = sss_mock_type(int);
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_create_page_control(LDAP *ld,
+                                    ber_int_t pagesize,
+                                    struct berval *cookie,
+                                    int iscritical,
+                                    LDAPControl **ctrlp)
+{
+    assert_int_equal(pagesize, TEST_PAGE_SIZE);
+    *ctrlp = NULL;
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_parse_pageresponse_control(LDAP *ld,
+                                           LDAPControl *ctrl,
+                                           ber_int_t *count,
+                                           struct berval *cookie)
+{
+    *count = 0;
+    cookie->bv_len = ctrl->ldctl_value.bv_len;
+    cookie->bv_val = NULL;
+    if (cookie->bv_len > 0) {
+        cookie->bv_val = ber_strdup(ctrl->ldctl_value.bv_val);
+        assert_non_null(cookie->bv_val);
+    }
+
+    return LDAP_SUCCESS;
+}
+
+void __wrap_ldap_controls_free(LDAPControl **ctrls)
+{
+    /* owned by the mocked reply */
+    return;
+}
+
+int __wrap_ldap_abandon_ext(LDAP *ld,
+                            int msgid,
+                            LDAPControl **serverctrls,
+                            LDAPControl **clientctrls)
+{
+    test_abandoned++;
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_msgid(LDAPMessage *lm)
+{
+    return ((struct mock_ldap_msg *) lm)->msgid;
+}
+
+int __wrap_ldap_msgtype(LDAPMessage *lm)
+{
+    return ((struct mock_ldap_msg *) lm)->msgtype;
+}
+
+int __wrap_ldap_msgfree(LDAPMessage *lm)
+{
+    /* owned by the test */
+    return ((struct mock_ldap_msg *) lm)->msgtype;
+}
+
+int __wrap_ldap_parse_result(LDAP *ld,
+                             LDAPMessage *res,
+                             int *errcodep,
+                             char **matcheddnp,
+                             char **errmsgp,
+                             char ***referralsp,
+                             LDAPControl ***serverctrls,
+                             int freeit)
+{
+    struct mock_ldap_msg *msg = (struct mock_ldap_msg *) res;
+
+    *errcodep = LDAP_SUCCESS;
+    if (matcheddnp != NULL) *matcheddnp = NULL;
+    if (errmsgp != NULL) *errmsgp = NULL;
+    if (referralsp != NULL) *referralsp = NULL;
+    if (serverctrls != NULL) *serverctrls = msg->controls;
+
+    return LDAP_SUCCESS;
+}
+
+int __wrap_ldap_get_option(LDAP *ld, int option, void *outvalue)
+{
+    if (option == LDAP_OPT_RESULT_CODE) {
+        *(int *) outvalue = LDAP_SUCCESS;
+        return LDAP_OPT_SUCCESS;
+    }
+
+    return LDAP_OPT_ERROR;
+}
+
+int __wrap_ldap_set_option(LDAP *ld, int option, void *invalue)
+{
+    return LDAP_OPT_SUCCESS;
+}
+
+char *__wrap_ldap_get_dn(LDAP *ld, LDAPMessage *entry)
+{
+    return discard_const(((struct mock_ldap_msg *) entry)->dn);
+}
+
+void __wrap_ldap_memfree(void *p)
+{
+    return;
+}
+
+struct berval **__wrap_ldap_get_values_len(LDAP *ld,
+                                           LDAPMessage *entry,
+                                           LDAP_CONST char *target)
+{
+    struct mock_ldap_msg *msg = (struct mock_ldap_msg *) entry;
+    struct berval **vals;
+    const char **attrvals = NULL;
+    size_t count;
+    size_t i;
+
+    for (i = 0; msg->attrs[i].name != NULL; i++) {
+        if (strcmp(msg->attrs[i].name, target) == 0) {
+            attrvals = msg->attrs[i].values;
+            break;
+        }
+    }
+
+    if (attrvals == NULL) {
+        return NULL;
+    }
+
+    for (count = 0; attrvals[count]; count++);
+
+    vals = talloc_zero_array(global_talloc_context, struct berval *,
+                             count + 1);
+    assert_non_null(vals);
+
+    for (i = 0; i < count; i++) {
+        vals[i] = talloc_zero(vals, struct berval);
+        assert_non_null(vals[i]);
+
+        vals[i]->bv_val = talloc_strdup(vals[i], attrvals[i]);
+        assert_non_null(vals[i]->bv_val);
+        vals[i]->bv_len = strlen(attrvals[i]);
+    }
+
+    return vals;
+}
+
+void __wrap_ldap_value_free_len(struct berval **vals)
+{
+    talloc_free(vals);  /* Allocated on global_talloc_context */
+}
+
+char *__wrap_ldap_first_attribute(LDAP *ld,
+                                  LDAPMessage *entry,
+                                  BerElement **berout)
+{
+    struct mock_ldap_msg *msg = (struct mock_ldap_msg *) entry;
+
+    msg->attr_iter = 0;
+    return discard_const(msg->attrs[0].name);
+}
+
+char *__wrap_ldap_next_attribute(LDAP *ld,
+                                 LDAPMessage *entry,
+                                 BerElement *ber)
+{
+    struct mock_ldap_msg *msg = (struct mock_ldap_msg *) entry;
+
+    if (msg->attrs[msg->attr_iter].name == NULL) {
+        return NULL;
+    }
+
+    msg->attr_iter++;
+    return discard_const(msg->attrs[msg->attr_iter].name);
+}
+
+static const char **mock_values(TALLOC_CTX *mem_ctx, const char *value)
+{
+    const char **values;
+
+    values = talloc_zero_array(mem_ctx, const char *, 2);
+    assert_non_null(values);
+    values[0] = talloc_strdup(values, value);
+    assert_non_null(values[0]);
+
+    return values;
+}
+
+static struct mock_ldap_msg *mock_user_entry(TALLOC_CTX *mem_ctx,
+                                             int msgid,
+                                             uid_t uid)
+{
+    struct mock_ldap_msg *msg;
+    char *name;
+    char *id;
+
+    msg = talloc_zero(mem_ctx, struct mock_ldap_msg);
+    assert_non_null(msg);
+
+    name = talloc_asprintf(msg, "user%"SPRIuid, uid);
+    assert_non_null(name);
+    id = talloc_asprintf(msg, "%"SPRIuid, uid);
+    assert_non_null(id);
+
+    msg->msgid = msgid;
+    msg->msgtype = LDAP_RES_SEARCH_ENTRY;
+    msg->dn = talloc_asprintf(msg, "uid=%s,%s", name, USER_BASE_DN);
+    assert_non_null(msg->dn);
+
+    msg->attrs = talloc_zero_array(msg, struct mock_ldap_attr, 5);
+    assert_non_null(msg->attrs);
+    msg->attrs[0].name = "objectClass";
+    msg->attrs[0].values = mock_values(msg, "posixAccount");
+    msg->attrs[1].name = "uid";
+    msg->attrs[1].values = mock_values(msg, name);
+    msg->attrs[2].name = "uidNumber";
+    msg->attrs[2].values = mock_values(msg, id);
+    msg->attrs[3].name = "gidNumber";
+    msg->attrs[3].values = mock_values(msg, id);
+
+    return msg;
+}
+
+/* An empty cookie marks the last page */
+static struct mock_ldap_msg *mock_search_result(TALLOC_CTX *mem_ctx,
+                                                int msgid,
+                                                const char *cookie)
+{
+    struct mock_ldap_msg *msg;
+    LDAPControl *ctrl;
+
+    msg = talloc_zero(mem_ctx, struct mock_ldap_msg);
+    assert_non_null(msg);
+
+    msg->msgid = msgid;
+    msg->msgtype = LDAP_RES_SEARCH_RESULT;
+
+    msg->controls = talloc_zero_array(msg, LDAPControl *, 2);
+    assert_non_null(msg->controls);
+
+    ctrl = talloc_zero(msg->controls, LDAPControl);
+    assert_non_null(ctrl);
+    ctrl->ldctl_oid = discard_const(LDAP_CONTROL_PAGEDRESULTS);
+    ctrl->ldctl_value.bv_val = talloc_strdup(ctrl, cookie);
+    assert_non_null(ctrl->ldctl_value.bv_val);
+    ctrl->ldctl_value.bv_len = strlen(cookie);
+    msg->controls[0] = ctrl;
+
+    return msg;
+}
+
+/* Hand the reply over as if it was read from the connection */
+static void test_reply(struct sdap_stream_test_ctx *test_ctx,
+                       struct mock_ldap_msg *msg)
+{
+    sdap_process_message(test_ctx->tctx->ev, test_ctx->sh,
+                         (LDAPMessage *) msg);
+}
+
+static void test_reply_entries(struct sdap_stream_test_ctx *test_ctx,
+                               int msgid,
+                               uid_t first_uid,
+                               size_t count)
+{
+    struct mock_ldap_msg *msg;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        msg = mock_user_entry(test_ctx, msgid, first_uid + i);
+        test_reply(test_ctx, msg);
+        talloc_free(msg);
+    }
+}
+
+static void test_reply_result(struct sdap_stream_test_ctx *test_ctx,
+                              int msgid,
+                              const char *cookie)
+{
+    struct mock_ldap_msg *msg;
+
+    msg = mock_search_result(test_ctx, msgid, cookie);
+    test_reply(test_ctx, msg);
+    talloc_free(msg);
+}
+
+static void assert_user_cached(struct sdap_stream_test_ctx *test_ctx,
+                               uid_t uid,
+                               bool cached)
+{
+    struct ldb_result *res;
+    errno_t ret;
+
+    ret = sysdb_getpwuid(test_ctx, test_ctx->tctx->dom, uid, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, cached ? 1 : 0);
+    talloc_free(res);
+}
+
+static errno_t test_entries_cb(struct sysdb_attrs **entries,
+                               size_t count,
+                               void *pvt)
+{
+    struct sdap_stream_test_ctx *test_ctx;
+    const char *uid_str;
+    size_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(pvt, struct sdap_stream_test_ctx);
+
+    assert_true(test_ctx->num_chunks < sizeof(test_ctx->chunk_sizes)
+                                        / sizeof(test_ctx->chunk_sizes[0]));
+    assert_null(entries[count]);
+
+    for (i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_string(entries[i], SYSDB_UIDNUM, &uid_str);
+        assert_int_equal(ret, EOK);
+        test_ctx->uids[test_ctx->num_uids++] = strtouint32(uid_str, NULL, 10);
+    }
+
+    test_ctx->chunk_sizes[test_ctx->num_chunks] = count;
+    test_ctx->num_chunks++;
+
+    if (test_ctx->num_chunks == test_ctx->fail_chunk) {
+        return test_ctx->cb_ret;
+    }
+
+    return EOK;
+}
+
+static void test_stream_generic_done(struct tevent_req *req)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            tevent_req_callback_data(req, struct sdap_stream_test_ctx);
+
+    test_ctx->ret = sdap_get_and_stream_generic_recv(req,
+                                                     &test_ctx->total_count);
+    test_ctx->done = true;
+    talloc_free(req);
+}
+
+static void test_stream_users_done(struct tevent_req *req)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            tevent_req_callback_data(req, struct sdap_stream_test_ctx);
+
+    test_ctx->ret = sdap_stream_users_recv(test_ctx, req, NULL,
+                                           &test_ctx->total_count);
+    test_ctx->done = true;
+    talloc_free(req);
+}
+
+static struct tevent_req *
+test_stream_generic_send(TALLOC_CTX *mem_ctx,
+                         struct sdap_stream_test_ctx *test_ctx,
+                         size_t chunk_size)
+{
+    struct tevent_req *req;
+
+    req = sdap_get_and_stream_generic_send(mem_ctx, test_ctx->tctx->ev,
+                                           test_ctx->opts, test_ctx->sh,
+                                           USER_BASE_DN, LDAP_SCOPE_SUBTREE,
+                                           "(objectClass=posixAccount)",
+                                           NULL,
+                                           test_ctx->opts->user_map,
+                                           test_ctx->opts->user_map_cnt,
+                                           0, 0, true, chunk_size,
+                                           test_entries_cb, test_ctx);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_stream_generic_done, test_ctx);
+
+    return req;
+}
+
+static int test_sdap_stream_setup(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { "ldap_search_base", OBJECT_BASE_DN },
+        { "ldap_user_search_base", USER_BASE_DN },
+        { NULL, NULL }
+    };
+    struct sdap_stream_test_ctx *test_ctx;
+    struct sdap_idmap_ctx *idmap_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct sdap_stream_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         params);
+    assert_non_null(test_ctx->tctx);
+
+    ret = ldap_get_options(test_ctx, test_ctx->tctx->dom,
+                           test_ctx->tctx->confdb,
+                           test_ctx->tctx->conf_dom_path,
+                           &test_ctx->opts);
+    assert_int_equal(ret, EOK);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+    assert_non_null(test_ctx->be_ctx);
+
+    test_ctx->id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(test_ctx->id_ctx);
+    test_ctx->id_ctx->be = test_ctx->be_ctx;
+    test_ctx->id_ctx->opts = test_ctx->opts;
+
+    ret = sdap_idmap_init(test_ctx, test_ctx->id_ctx, &idmap_ctx);
+    assert_int_equal(ret, EOK);
+    test_ctx->opts->idmap_ctx = idmap_ctx;
+
+    /* a connected handle of a server which supports paging, nothing is
+     * ever sent over the LDAP handle */
+    test_ctx->sh = talloc_zero(test_ctx, struct sdap_handle);
+    assert_non_null(test_ctx->sh);
+    ret = ldap_initialize(&test_ctx->sh->ldap, "ldap://localhost");
+    assert_int_equal(ret, LDAP_SUCCESS);
+    test_ctx->sh->connected = true;
+    test_ctx->sh->page_size = TEST_PAGE_SIZE;
+    test_ctx->sh->supported_controls.num_vals = 1;
+    test_ctx->sh->supported_controls.vals = talloc_array(test_ctx->sh,
+                                                         char *, 1);
+    assert_non_null(test_ctx->sh->supported_controls.vals);
+    test_ctx->sh->supported_controls.vals[0] =
+            talloc_strdup(test_ctx->sh, LDAP_CONTROL_PAGEDRESULTS);
+    assert_non_null(test_ctx->sh->supported_controls.vals[0]);
+
+    test_abandoned = 0;
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_sdap_stream_teardown(void **state)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            talloc_get_type_abort(*state, struct sdap_stream_test_ctx);
+
+    ldap_unbind_ext_s(test_ctx->sh->ldap, NULL, NULL);
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+void test_stream_generic_chunks(void **state)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            talloc_get_type_abort(*state, struct sdap_stream_test_ctx);
+    TALLOC_CTX *req_mem_ctx;
+    size_t i;
+
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    will_return(__wrap_ldap_search_ext, 1);
+    test_stream_generic_send(req_mem_ctx, test_ctx, 2);
+
+    /* three entries on the first page, the third one waits for the next
+     * page to fill its chunk */
+    test_reply_entries(test_ctx, 1, 1001, 3);
+    assert_int_equal(test_ctx->num_chunks, 1);
+    assert_int_equal(test_ctx->chunk_sizes[0], 2);
+
+    will_return(__wrap_ldap_search_ext, 2);
+    test_reply_result(test_ctx, 1, "page2");
+    assert_false(test_ctx->done);
+    assert_int_equal(test_ctx->num_chunks, 1);
+
+    /* the incomplete chunk is passed when the search is finished */
+    test_reply_entries(test_ctx, 2, 1004, 2);
+    assert_int_equal(test_ctx->num_chunks, 2);
+    test_reply_result(test_ctx, 2, "");
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->ret, EOK);
+    assert_int_equal(test_ctx->total_count, 5);
+    assert_int_equal(test_ctx->num_chunks, 3);
+    assert_int_equal(test_ctx->chunk_sizes[1], 2);
+    assert_int_equal(test_ctx->chunk_sizes[2], 1);
+
+    assert_int_equal(test_ctx->num_uids, 5);
+    for (i = 0; i < 5; i++) {
+        assert_int_equal(test_ctx->uids[i], 1001 + i);
+    }
+
+    assert_int_equal(test_abandoned, 0);
+    assert_null(test_ctx->sh->ops);
+
+    /* no chunk is kept after it was handed over */
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_free(req_mem_ctx);
+}
+
+void test_stream_generic_cb_error(void **state)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            talloc_get_type_abort(*state, struct sdap_stream_test_ctx);
+    TALLOC_CTX *req_mem_ctx;
+
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    test_ctx->fail_chunk = 2;
+    test_ctx->cb_ret = EIO;
+
+    will_return(__wrap_ldap_search_ext, 1);
+    test_stream_generic_send(req_mem_ctx, test_ctx, 2);
+
+    test_reply_entries(test_ctx, 1, 1001, 3);
+    assert_false(test_ctx->done);
+
+    /* the second chunk fails, the search is abandoned */
+    test_reply_entries(test_ctx, 1, 1004, 1);
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->ret, EIO);
+    assert_int_equal(test_ctx->num_chunks, 2);
+    assert_int_equal(test_abandoned, 1);
+    assert_null(test_ctx->sh->ops);
+
+    /* the rest of the result is discarded */
+    test_reply_entries(test_ctx, 1, 1005, 1);
+    test_reply_result(test_ctx, 1, "");
+    assert_int_equal(test_ctx->num_chunks, 2);
+    assert_int_equal(test_ctx->num_uids, 4);
+
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_free(req_mem_ctx);
+}
+
+void test_stream_users(void **state)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            talloc_get_type_abort(*state, struct sdap_stream_test_ctx);
+    struct tevent_req *req;
+    TALLOC_CTX *req_mem_ctx;
+    uid_t uid;
+
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    will_return(__wrap_ldap_search_ext, 1);
+    req = sdap_stream_users_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->tctx->dom, test_ctx->tctx->sysdb,
+                                 test_ctx->opts,
+                                 test_ctx->opts->sdom->user_search_bases,
+                                 test_ctx->sh, NULL, "(objectClass=*)", 0,
+                                 NULL);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_stream_users_done, test_ctx);
+
+    /* each chunk of a page size is saved as soon as it is complete */
+    test_reply_entries(test_ctx, 1, 1001, 3);
+    assert_user_cached(test_ctx, 1001, true);
+    assert_user_cached(test_ctx, 1002, true);
+    assert_user_cached(test_ctx, 1003, false);
+
+    will_return(__wrap_ldap_search_ext, 2);
+    test_reply_result(test_ctx, 1, "page2");
+    test_reply_entries(test_ctx, 2, 1004, 1);
+    assert_user_cached(test_ctx, 1004, true);
+    test_reply_result(test_ctx, 2, "");
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->ret, EOK);
+    assert_int_equal(test_ctx->total_count, 4);
+    for (uid = 1001; uid <= 1004; uid++) {
+        assert_user_cached(test_ctx, uid, true);
+    }
+
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_free(req_mem_ctx);
+}
+
+void test_stream_users_cancel(void **state)
+{
+    struct sdap_stream_test_ctx *test_ctx =
+            talloc_get_type_abort(*state, struct sdap_stream_test_ctx);
+    struct tevent_req *req;
+    TALLOC_CTX *req_mem_ctx;
+
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    will_return(__wrap_ldap_search_ext, 1);
+    req = sdap_stream_users_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->tctx->dom, test_ctx->tctx->sysdb,
+                                 test_ctx->opts,
+                                 test_ctx->opts->sdom->user_search_bases,
+                                 test_ctx->sh, NULL, "(objectClass=*)", 0,
+                                 NULL);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_stream_users_done, test_ctx);
+
+    test_reply_entries(test_ctx, 1, 1001, 3);
+    assert_user_cached(test_ctx, 1001, true);
+    assert_user_cached(test_ctx, 1002, true);
+
+    /* the caller goes away while the search is running */
+    talloc_free(req);
+    assert_false(test_ctx->done);
+    assert_int_equal(test_abandoned, 1);
+    assert_null(test_ctx->sh->ops);
+
+    /* late replies are discarded, the saved users are kept and the
+     * pending entry is dropped */
+    test_reply_entries(test_ctx, 1, 1004, 1);
+    test_reply_result(test_ctx, 1, "");
+    assert_false(test_ctx->done);
+
+    assert_user_cached(test_ctx, 1001, true);
+    assert_user_cached(test_ctx, 1002, true);
+    assert_user_cached(test_ctx, 1003, false);
+    assert_user_cached(test_ctx, 1004, false);
+
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_free(req_mem_ctx);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_stream_generic_chunks,
+                                        test_sdap_stream_setup,
+                                        test_sdap_stream_teardown),
+        cmocka_unit_test_setup_teardown(test_stream_generic_cb_error,
+                                        test_sdap_stream_setup,
+                                        test_sdap_stream_teardown),
+        cmocka_unit_test_setup_teardown(test_stream_users,
+                                        test_sdap_stream_setup,
+                                        test_sdap_stream_teardown),
+        cmocka_unit_test_setup_teardown(test_stream_users_cancel,
+                                        test_sdap_stream_setup,
+                                        test_sdap_stream_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+
+    return rv;
+}
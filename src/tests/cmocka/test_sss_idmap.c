@@ -674,6 +674,161 @@ void test_sss_idmap_check_collision_ex(void **state)
     assert_int_equal(err, IDMAP_SUCCESS);
 }
 
+void test_map_ids(void **state)
+{
+    struct test_ctx *test_ctx;
+    enum idmap_error_code err;
+    const char *sids[] = { TEST_DOM_SID"-0",
+                           TEST_DOM_SID"-"TEST_OFFSET_STR,
+                           TEST_DOM_SID"-400000",
+                           TEST_2_DOM_SID"-0",
+                           TEST_DOM_SID"1-1",
+                           "S-1-5-32-544",
+                           TEST_DOM_SID"-1" };
+    size_t count = sizeof(sids) / sizeof(sids[0]);
+    uint32_t ids[sizeof(sids) / sizeof(sids[0])];
+    enum idmap_error_code errs[sizeof(sids) / sizeof(sids[0])];
+    uint32_t id;
+    size_t c;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    assert_non_null(test_ctx);
+
+    err = sss_idmap_sids_to_unix(test_ctx->idmap_ctx, sids, count, ids, errs);
+    assert_int_equal(err, IDMAP_NO_RANGE);
+
+    assert_int_equal(errs[0], IDMAP_SUCCESS);
+    assert_int_equal(ids[0], TEST_RANGE_MIN);
+    assert_int_equal(errs[1], IDMAP_SUCCESS);
+    assert_int_equal(ids[1], TEST_RANGE_MIN + TEST_OFFSET);
+    assert_int_equal(errs[2], IDMAP_NO_RANGE);
+    assert_int_equal(errs[3], IDMAP_EXTERNAL);
+    assert_int_equal(errs[4], IDMAP_NO_DOMAIN);
+    assert_int_equal(errs[5], IDMAP_BUILTIN_SID);
+    assert_int_equal(errs[6], IDMAP_SUCCESS);
+    assert_int_equal(ids[6], TEST_RANGE_MIN + 1);
+
+    /* The result must not differ from the single SID lookup */
+    for (c = 0; c < count; c++) {
+        err = sss_idmap_sid_to_unix(test_ctx->idmap_ctx, sids[c], &id);
+        assert_int_equal(err, errs[c]);
+        if (err == IDMAP_SUCCESS) {
+            assert_int_equal(id, ids[c]);
+        }
+    }
+
+    err = sss_idmap_sids_to_unix(test_ctx->idmap_ctx, sids, 2, ids, errs);
+    assert_int_equal(err, IDMAP_SUCCESS);
+
+    err = sss_idmap_sids_to_unix(test_ctx->idmap_ctx, NULL, 2, ids, errs);
+    assert_int_equal(err, IDMAP_ERROR);
+}
+
+#define TEST_BENCH_DOMS 64
+#define TEST_BENCH_RIDS 1500
+
+static double test_elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    int ret;
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &now);
+    assert_int_equal(ret, 0);
+
+    return (now.tv_sec - start->tv_sec)
+                + (now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+/* Compare single and batched lookups with many domains, the timings are
+ * only reported since they depend on the machine running the test. */
+void test_map_ids_bench(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct sss_idmap_range range;
+    enum idmap_error_code err;
+    size_t count = TEST_BENCH_DOMS * TEST_BENCH_RIDS;
+    const char **sids;
+    uint32_t *ids;
+    enum idmap_error_code *errs;
+    struct timespec start;
+    double single;
+    double batch;
+    uint32_t id;
+    char *name;
+    char *sid;
+    size_t c;
+    size_t d;
+    int ret;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+
+    assert_non_null(test_ctx);
+
+    for (d = 0; d < TEST_BENCH_DOMS; d++) {
+        name = talloc_asprintf(test_ctx, "bench%zu.dom", d);
+        assert_non_null(name);
+        sid = talloc_asprintf(test_ctx, "S-1-5-21-%zu-1000-2000", d);
+        assert_non_null(sid);
+
+        range.min = TEST_RANGE_MIN + d * TEST_OFFSET;
+        range.max = range.min + TEST_RANGE_MAX - TEST_RANGE_MIN;
+
+        err = sss_idmap_add_domain_ex(test_ctx->idmap_ctx, name, sid, &range,
+                                      NULL, 0, false);
+        assert_int_equal(err, IDMAP_SUCCESS);
+
+        talloc_free(name);
+        talloc_free(sid);
+    }
+
+    sids = talloc_array(test_ctx, const char *, count);
+    assert_non_null(sids);
+    ids = talloc_array(test_ctx, uint32_t, count);
+    assert_non_null(ids);
+    errs = talloc_array(test_ctx, enum idmap_error_code, count);
+    assert_non_null(errs);
+
+    for (c = 0; c < count; c++) {
+        sids[c] = talloc_asprintf(sids, "S-1-5-21-%zu-1000-2000-%zu",
+                                  c / TEST_BENCH_RIDS,
+                                  c % TEST_BENCH_RIDS);
+        assert_non_null(sids[c]);
+    }
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int_equal(ret, 0);
+    for (c = 0; c < count; c++) {
+        err = sss_idmap_sid_to_unix(test_ctx->idmap_ctx, sids[c], &id);
+        assert_int_equal(err, IDMAP_SUCCESS);
+        assert_int_equal(id, TEST_RANGE_MIN
+                                + (c / TEST_BENCH_RIDS) * TEST_OFFSET
+                                + c % TEST_BENCH_RIDS);
+    }
+    single = test_elapsed(&start);
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int_equal(ret, 0);
+    err = sss_idmap_sids_to_unix(test_ctx->idmap_ctx, sids, count, ids, errs);
+    batch = test_elapsed(&start);
+    assert_int_equal(err, IDMAP_SUCCESS);
+
+    for (c = 0; c < count; c++) {
+        assert_int_equal(errs[c], IDMAP_SUCCESS);
+        assert_int_equal(ids[c], TEST_RANGE_MIN
+                                    + (c / TEST_BENCH_RIDS) * TEST_OFFSET
+                                    + c % TEST_BENCH_RIDS);
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "%zu lookups in %d domains: single %.3fs, batch %.3fs\n",
+          count, TEST_BENCH_DOMS, single, batch);
+
+    talloc_free(errs);
+    talloc_free(ids);
+    talloc_free(sids);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -712,6 +867,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_has_algorithmic_by_name,
                                         test_sss_idmap_setup_with_both,
                                         test_sss_idmap_teardown),
+        cmocka_unit_test_setup_teardown(test_map_ids,
+                                        test_sss_idmap_setup_with_both,
+                                        test_sss_idmap_teardown),
+        cmocka_unit_test_setup_teardown(test_map_ids_bench,
+                                        test_sss_idmap_setup,
+                                        test_sss_idmap_teardown),
         cmocka_unit_test(test_sss_idmap_check_collision_ex),
     };
 
@@ -0,0 +1,608 @@
+/*
+    SSSD
+
+    sudosrv_index - Tests for the in-memory sudo rule index
+
+    Copyright (C) 2017 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "db/sysdb_sudo.h"
+#include "responder/sudo/sudosrv_private.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_sudosrv_index.ldb"
+#define TEST_DOM_NAME "sudosrv_index_test"
+
+#define TEST_USER_NAME "test_user"
+#define TEST_USER_UID 1001
+#define TEST_GROUP_NAME "test_group"
+
+/* The index must return the same rules in the same order as the sysdb
+ * filters it replaced, so every test compares both. */
+struct test_rule {
+    const char *name;
+    const char *users[3];
+    uint32_t order;
+} test_rules[] = {
+    { "rule_user", { TEST_USER_NAME, NULL }, 10 },
+    { "rule_uid", { "#1001", NULL }, 20 },
+    { "rule_group", { "%"TEST_GROUP_NAME, NULL }, 5 },
+    { "rule_all", { "ALL", NULL }, 30 },
+    { "rule_netgroup", { "+test_netgroup", NULL }, 15 },
+    { "rule_other", { "other_user", NULL }, 25 },
+    { "rule_other_netgroup", { "other_user", "+test_netgroup", NULL }, 1 },
+    { "rule_user_netgroup", { TEST_USER_NAME, "+test_netgroup", NULL }, 40 },
+    { "rule_same_order", { "%"TEST_GROUP_NAME, NULL }, 20 },
+    { NULL, { NULL }, 0 }
+};
+
+struct sudosrv_index_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sudo_ctx *sudo_ctx;
+};
+
+static void store_rules(struct sss_domain_info *domain)
+{
+    struct sysdb_attrs **rules;
+    size_t num_rules;
+    errno_t ret;
+    int i, j;
+
+    for (num_rules = 0; test_rules[num_rules].name != NULL; num_rules++);
+
+    rules = talloc_array(NULL, struct sysdb_attrs *, num_rules);
+    assert_non_null(rules);
+
+    for (i = 0; test_rules[i].name != NULL; i++) {
+        rules[i] = sysdb_new_attrs(rules);
+        assert_non_null(rules[i]);
+
+        ret = sysdb_attrs_add_string(rules[i], SYSDB_SUDO_CACHE_AT_CN,
+                                     test_rules[i].name);
+        assert_int_equal(ret, EOK);
+
+        ret = sysdb_attrs_add_string(rules[i], SYSDB_SUDO_CACHE_AT_HOST,
+                                     "ALL");
+        assert_int_equal(ret, EOK);
+
+        ret = sysdb_attrs_add_uint32(rules[i], SYSDB_SUDO_CACHE_AT_ORDER,
+                                     test_rules[i].order);
+        assert_int_equal(ret, EOK);
+
+        for (j = 0; test_rules[i].users[j] != NULL; j++) {
+            ret = sysdb_attrs_add_string(rules[i], SYSDB_SUDO_CACHE_AT_USER,
+                                         test_rules[i].users[j]);
+            assert_int_equal(ret, EOK);
+        }
+    }
+
+    ret = sysdb_sudo_store(domain, rules, num_rules);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(rules);
+}
+
+static int test_sudosrv_index_setup_params(void **state,
+                                           struct sss_test_conf_param *params,
+                                           int sudo_timeout)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct sudosrv_index_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, "ldap", params);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->tctx->dom->sudo_timeout = sudo_timeout;
+    store_rules(test_ctx->tctx->dom);
+
+    check_leaks_push(test_ctx);
+
+    /* The indexes are kept in sudo_ctx, it is freed before checking leaks */
+    test_ctx->sudo_ctx = talloc_zero(test_ctx, struct sudo_ctx);
+    assert_non_null(test_ctx->sudo_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int test_sudosrv_index_setup(void **state)
+{
+    return test_sudosrv_index_setup_params(state, NULL, 1000);
+}
+
+/* Rules stored without a timeout are always expired */
+static int test_sudosrv_index_expired_setup(void **state)
+{
+    return test_sudosrv_index_setup_params(state, NULL, 0);
+}
+
+static int test_sudosrv_index_shards_setup(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { "cache_shards", "true" },
+        { NULL, NULL },             /* Sentinel */
+    };
+
+    return test_sudosrv_index_setup_params(state, params, 1000);
+}
+
+static int test_sudosrv_index_teardown(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    talloc_zfree(test_ctx->sudo_ctx);
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_zfree(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+struct test_result {
+    const char *name;
+    uint32_t order;
+};
+
+static bool test_lower_wins;
+
+static int test_result_cmp(const void *a, const void *b)
+{
+    const struct test_result *r1 = a;
+    const struct test_result *r2 = b;
+
+    if (r1->order != r2->order) {
+        if (test_lower_wins) {
+            return r1->order > r2->order ? 1 : -1;
+        }
+        return r1->order < r2->order ? 1 : -1;
+    }
+
+    return strcmp(r1->name, r2->name);
+}
+
+static int test_result_name_cmp(const void *a, const void *b)
+{
+    const struct test_result *r1 = a;
+    const struct test_result *r2 = b;
+
+    return strcmp(r1->name, r2->name);
+}
+
+/* Appends the rules matching filter to results, the way the responder used
+ * to look them up before the index */
+static void search_reference(struct sss_domain_info *domain,
+                             const char *filter,
+                             struct test_result *results,
+                             size_t *_count)
+{
+    const char *attrs[] = { SYSDB_NAME, SYSDB_SUDO_CACHE_AT_ORDER, NULL };
+    struct ldb_message **msgs = NULL;
+    size_t msgs_count;
+    size_t i;
+    errno_t ret;
+
+    assert_non_null(filter);
+
+    ret = sysdb_search_sudo_rules(results, domain, filter, attrs,
+                                  &msgs_count, &msgs);
+    if (ret == ENOENT) {
+        return;
+    }
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; i < msgs_count; i++) {
+        results[*_count].name = ldb_msg_find_attr_as_string(msgs[i],
+                                                            SYSDB_NAME, NULL);
+        assert_non_null(results[*_count].name);
+        results[*_count].order = ldb_msg_find_attr_as_uint(msgs[i],
+                                                 SYSDB_SUDO_CACHE_AT_ORDER, 0);
+        (*_count)++;
+    }
+}
+
+static void rules_to_results(struct sysdb_attrs **rules,
+                             uint32_t num_rules,
+                             const char *name_attr,
+                             struct test_result *results)
+{
+    uint32_t i;
+    errno_t ret;
+
+    for (i = 0; i < num_rules; i++) {
+        ret = sysdb_attrs_get_string(rules[i], name_attr, &results[i].name);
+        assert_int_equal(ret, EOK);
+
+        ret = sysdb_attrs_get_uint32_t(rules[i], SYSDB_SUDO_CACHE_AT_ORDER,
+                                       &results[i].order);
+        if (ret == ENOENT) {
+            results[i].order = 0;
+        } else {
+            assert_int_equal(ret, EOK);
+        }
+    }
+}
+
+static void assert_results_equal(struct test_result *expected,
+                                 size_t num_expected,
+                                 struct test_result *results,
+                                 size_t num_results)
+{
+    size_t i;
+
+    assert_int_equal(num_results, num_expected);
+    for (i = 0; i < num_results; i++) {
+        assert_string_equal(results[i].name, expected[i].name);
+        assert_int_equal(results[i].order, expected[i].order);
+    }
+}
+
+static void check_user_rules(struct sudosrv_index_test_ctx *test_ctx,
+                             const char *username,
+                             uid_t uid,
+                             char **groups,
+                             size_t num_expected)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct test_result *expected;
+    struct test_result *results;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    size_t count = 0;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    expected = talloc_zero_array(tmp_ctx, struct test_result,
+                                 sizeof(test_rules) / sizeof(test_rules[0]));
+    assert_non_null(expected);
+
+    search_reference(dom, sysdb_sudo_filter_user(tmp_ctx, username,
+                                                 groups, uid),
+                     expected, &count);
+    search_reference(dom, sysdb_sudo_filter_netgroups(tmp_ctx, username,
+                                                      groups, uid),
+                     expected, &count);
+    test_lower_wins = test_ctx->sudo_ctx->inverse_order;
+    qsort(expected, count, sizeof(struct test_result), test_result_cmp);
+    assert_int_equal(count, num_expected);
+
+    ret = sudosrv_index_user_rules(tmp_ctx, test_ctx->sudo_ctx, dom, uid,
+                                   username, groups, &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+
+    results = talloc_zero_array(tmp_ctx, struct test_result, num_rules + 1);
+    assert_non_null(results);
+    rules_to_results(rules, num_rules, SYSDB_SUDO_CACHE_AT_CN, results);
+
+    assert_results_equal(expected, count, results, num_rules);
+
+    talloc_free(tmp_ctx);
+}
+
+static void test_sudosrv_index_user(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    /* rule_user, rule_user_netgroup, rule_all and the two netgroup rules */
+    check_user_rules(test_ctx, TEST_USER_NAME, 0, NULL, 5);
+}
+
+static void test_sudosrv_index_uid(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    check_user_rules(test_ctx, TEST_USER_NAME, TEST_USER_UID, NULL, 6);
+}
+
+static void test_sudosrv_index_group(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+    char *groups[] = { discard_const(TEST_GROUP_NAME), NULL };
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    check_user_rules(test_ctx, TEST_USER_NAME, TEST_USER_UID, groups, 8);
+}
+
+static void test_sudosrv_index_netgroup(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    /* other_user matches rule_other by name, rule_other_netgroup must not
+     * be returned twice */
+    check_user_rules(test_ctx, "other_user", 0, NULL, 5);
+}
+
+static void test_sudosrv_index_all(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    /* An unknown user only gets rule_all and the netgroup rules */
+    check_user_rules(test_ctx, "unknown_user", 0, NULL, 4);
+}
+
+static void test_sudosrv_index_inverse_order(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+    char *groups[] = { discard_const(TEST_GROUP_NAME), NULL };
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+
+    test_ctx->sudo_ctx->inverse_order = true;
+    check_user_rules(test_ctx, TEST_USER_NAME, TEST_USER_UID, groups, 8);
+}
+
+static void test_sudosrv_index_expired(void **state)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sudosrv_index_test_ctx *test_ctx;
+    struct sss_domain_info *dom;
+    char *groups[] = { discard_const(TEST_GROUP_NAME), NULL };
+    struct test_result *expected;
+    struct test_result *results;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    size_t count = 0;
+    size_t i;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+    dom = test_ctx->tctx->dom;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    expected = talloc_zero_array(tmp_ctx, struct test_result,
+                                 sizeof(test_rules) / sizeof(test_rules[0]));
+    assert_non_null(expected);
+
+    search_reference(dom, sysdb_sudo_filter_expired(tmp_ctx, TEST_USER_NAME,
+                                                    groups, TEST_USER_UID),
+                     expected, &count);
+    qsort(expected, count, sizeof(struct test_result), test_result_name_cmp);
+    assert_int_equal(count, 8);
+
+    ret = sudosrv_index_expired_rules(tmp_ctx, test_ctx->sudo_ctx, dom,
+                                      TEST_USER_UID, TEST_USER_NAME, groups,
+                                      &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+
+    results = talloc_zero_array(tmp_ctx, struct test_result, num_rules + 1);
+    assert_non_null(results);
+    rules_to_results(rules, num_rules, SYSDB_NAME, results);
+    qsort(results, num_rules, sizeof(struct test_result),
+          test_result_name_cmp);
+
+    /* Only the names are returned */
+    for (i = 0; i < count; i++) {
+        expected[i].order = 0;
+    }
+    assert_results_equal(expected, count, results, num_rules);
+
+    talloc_free(tmp_ctx);
+}
+
+static void test_sudosrv_index_refreshed(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+    struct sss_domain_info *dom;
+    char *groups[] = { discard_const(TEST_GROUP_NAME), NULL };
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    uint64_t seq1;
+    uint64_t seq2;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+    dom = test_ctx->tctx->dom;
+
+    ret = sudosrv_index_expired_rules(test_ctx, test_ctx->sudo_ctx, dom,
+                                      TEST_USER_UID, TEST_USER_NAME, groups,
+                                      &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_rules, 8);
+    talloc_free(rules);
+
+    ret = sysdb_get_subtree_sequence_number(dom, SUDORULE_SUBDIR, &seq1);
+    assert_int_equal(ret, EOK);
+
+    /* Refreshing unchanged rules only updates the timestamp cache... */
+    dom->sudo_timeout = 1000;
+    store_rules(dom);
+
+    ret = sysdb_get_subtree_sequence_number(dom, SUDORULE_SUBDIR, &seq2);
+    assert_int_equal(ret, EOK);
+    assert_true(seq1 == seq2);
+
+    /* ...but the rules must not be reported as expired anymore */
+    ret = sudosrv_index_expired_rules(test_ctx, test_ctx->sudo_ctx, dom,
+                                      TEST_USER_UID, TEST_USER_NAME, groups,
+                                      &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_rules, 0);
+    assert_null(rules);
+}
+
+static void test_sudosrv_index_content_changed(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+    struct sss_domain_info *dom;
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+    dom = test_ctx->tctx->dom;
+
+    /* rule_other, rule_all and the three netgroup rules */
+    check_user_rules(test_ctx, "other_user", 0, NULL, 5);
+
+    /* A refresh in the same second stores the same expiration, the rule
+     * must be fetched again because its content changed */
+    test_rules[5].users[0] = "another_user";
+    store_rules(dom);
+    test_rules[5].users[0] = "other_user";
+
+    check_user_rules(test_ctx, "other_user", 0, NULL, 4);
+
+    /* Modifying the rule in place does not touch the expiration at all */
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_USER,
+                                 "other_user");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_set_sudo_rule_attr(dom, "rule_other", attrs, SYSDB_MOD_REP);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+
+    check_user_rules(test_ctx, "other_user", 0, NULL, 5);
+}
+
+static void test_sudosrv_index_shards(void **state)
+{
+    struct sudosrv_index_test_ctx *test_ctx;
+    struct sss_domain_info *dom;
+    struct sysdb_attrs *attrs;
+    uint64_t seq1;
+    uint64_t seq2;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudosrv_index_test_ctx);
+    dom = test_ctx->tctx->dom;
+
+    ret = sysdb_get_subtree_sequence_number(dom, SUDORULE_SUBDIR, &seq1);
+    assert_int_equal(ret, EOK);
+
+    /* Writes of other objects do not invalidate the index */
+    ret = sysdb_add_user(dom, TEST_USER_NAME, TEST_USER_UID, TEST_USER_UID,
+                         TEST_USER_NAME, NULL, "/bin/bash", NULL, NULL,
+                         30, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_get_subtree_sequence_number(dom, SUDORULE_SUBDIR, &seq2);
+    assert_int_equal(ret, EOK);
+    assert_true(seq1 == seq2);
+
+    check_user_rules(test_ctx, TEST_USER_NAME, TEST_USER_UID, NULL, 6);
+
+    /* Writes of the rules do */
+    attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_HOST, "host");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_set_sudo_rule_attr(dom, "rule_uid", attrs, SYSDB_MOD_ADD);
+    assert_int_equal(ret, EOK);
+    talloc_free(attrs);
+
+    ret = sysdb_get_subtree_sequence_number(dom, SUDORULE_SUBDIR, &seq2);
+    assert_int_equal(ret, EOK);
+    assert_true(seq1 != seq2);
+
+    check_user_rules(test_ctx, TEST_USER_NAME, TEST_USER_UID, NULL, 6);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_user,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_uid,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_group,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_netgroup,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_all,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_inverse_order,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_expired,
+                                        test_sudosrv_index_expired_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_refreshed,
+                                        test_sudosrv_index_expired_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_content_changed,
+                                        test_sudosrv_index_setup,
+                                        test_sudosrv_index_teardown),
+        cmocka_unit_test_setup_teardown(test_sudosrv_index_shards,
+                                        test_sudosrv_index_shards_setup,
+                                        test_sudosrv_index_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        switch (opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
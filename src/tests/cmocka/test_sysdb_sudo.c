@@ -145,7 +145,8 @@ static int get_stored_rules_count(struct sysdb_test_ctx *test_ctx)
     return msgs_count;
 }
 
-static int test_sysdb_setup(void **state)
+static int test_sysdb_setup_params(void **state,
+                                   struct sss_test_conf_param *params)
 {
     struct sysdb_test_ctx *test_ctx;
 
@@ -157,7 +158,7 @@ static int test_sysdb_setup(void **state)
     test_dom_suite_setup(TESTS_PATH);
 
     test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
-                                         TEST_DOM_NAME, "ipa", NULL);
+                                         TEST_DOM_NAME, "ipa", params);
     assert_non_null(test_ctx->tctx);
 
     create_groups(test_ctx->tctx->dom);
@@ -170,6 +171,21 @@ static int test_sysdb_setup(void **state)
     return 0;
 }
 
+static int test_sysdb_setup(void **state)
+{
+    return test_sysdb_setup_params(state, NULL);
+}
+
+static int test_sysdb_shards_setup(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { "cache_shards", "true" },
+        { NULL, NULL },             /* Sentinel */
+    };
+
+    return test_sysdb_setup_params(state, params);
+}
+
 static int test_sysdb_teardown(void **state)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -431,6 +447,118 @@ void test_sudo_purge_by_rules(void **state)
     talloc_zfree(rule);
 }
 
+static int count_sudo_rules_in_ldb(struct sysdb_test_ctx *test_ctx,
+                                   struct ldb_context *ldb)
+{
+    struct ldb_result *res;
+    struct ldb_dn *base_dn;
+    int count;
+    int ret;
+
+    base_dn = ldb_dn_new_fmt(test_ctx, ldb, SYSDB_TMPL_CUSTOM_SUBTREE,
+                             SUDORULE_SUBDIR, test_ctx->tctx->dom->name);
+    assert_non_null(base_dn);
+
+    ret = ldb_search(ldb, test_ctx, &res, base_dn, LDB_SCOPE_SUBTREE,
+                     NULL, "(objectClass=sudoRule)");
+    talloc_free(base_dn);
+    if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+        return 0;
+    }
+    assert_int_equal(ret, LDB_SUCCESS);
+
+    count = res->count;
+    talloc_free(res);
+    return count;
+}
+
+void test_store_sudo_sharded(void **state)
+{
+    errno_t ret;
+    time_t now;
+    time_t loaded_time;
+    struct sysdb_attrs *rule;
+    struct sysdb_ctx *sysdb;
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+
+    sysdb = test_ctx->tctx->dom->sysdb;
+    assert_non_null(sysdb->ldb_shards[SYSDB_SHARD_SUDO]);
+
+    rule = sysdb_new_attrs(test_ctx);
+    assert_non_null(rule);
+    create_rule_attrs(rule, 0);
+
+    ret = sysdb_sudo_store(test_ctx->tctx->dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(get_stored_rules_count(test_ctx), 1);
+
+    /* The rule must only be stored in the sudo shard */
+    assert_int_equal(count_sudo_rules_in_ldb(test_ctx,
+                                     sysdb->ldb_shards[SYSDB_SHARD_SUDO]), 1);
+    assert_int_equal(count_sudo_rules_in_ldb(test_ctx, sysdb->ldb), 0);
+
+    now = time(NULL);
+    ret = sysdb_sudo_set_last_full_refresh(test_ctx->tctx->dom, now);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_sudo_get_last_full_refresh(test_ctx->tctx->dom, &loaded_time);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(now, loaded_time);
+
+    ret = sysdb_sudo_purge(test_ctx->tctx->dom, NULL, &rule, 1);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(get_stored_rules_count(test_ctx), 0);
+
+    talloc_zfree(rule);
+}
+
+void test_sudo_shard_sequence_number(void **state)
+{
+    errno_t ret;
+    uint64_t seq_before;
+    uint64_t seq_after;
+    struct sysdb_attrs *rule;
+    struct sysdb_ctx *sysdb;
+    struct sysdb_ctx *new_sysdb;
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+
+    sysdb = test_ctx->tctx->dom->sysdb;
+
+    rule = sysdb_new_attrs(test_ctx);
+    assert_non_null(rule);
+    create_rule_attrs(rule, 0);
+
+    ret = sysdb_sudo_store(test_ctx->tctx->dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_get_sequence_number(sysdb, &seq_before);
+    assert_int_equal(ret, EOK);
+
+    /* A recreated shard starts with a lower sequence number of its own */
+    ret = unlink(sysdb->ldb_shard_files[SYSDB_SHARD_SUDO]);
+    assert_int_equal(ret, 0);
+
+    ret = sysdb_domain_init(test_ctx, test_ctx->tctx->dom, TESTS_PATH,
+                            &new_sysdb);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(count_sudo_rules_in_ldb(test_ctx,
+                                  new_sysdb->ldb_shards[SYSDB_SHARD_SUDO]), 0);
+
+    ret = sysdb_get_sequence_number(new_sysdb, &seq_after);
+    assert_int_equal(ret, EOK);
+    assert_true(seq_after > seq_before);
+
+    /* Also for processes that still have the old file open */
+    ret = sysdb_get_sequence_number(sysdb, &seq_after);
+    assert_int_equal(ret, EOK);
+    assert_true(seq_after > seq_before);
+
+    talloc_free(new_sysdb);
+    talloc_zfree(rule);
+}
+
 void test_sudo_set_get_last_full_refresh(void **state)
 {
     errno_t ret;
@@ -819,6 +947,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_store_sudo_case_insensitive,
                                         test_sysdb_setup,
                                         test_sysdb_teardown),
+        cmocka_unit_test_setup_teardown(test_store_sudo_sharded,
+                                        test_sysdb_shards_setup,
+                                        test_sysdb_teardown),
+        cmocka_unit_test_setup_teardown(test_sudo_shard_sequence_number,
+                                        test_sysdb_shards_setup,
+                                        test_sysdb_teardown),
 
         /* sysdb_sudo_purge() */
         cmocka_unit_test_setup_teardown(test_sudo_purge_by_filter,
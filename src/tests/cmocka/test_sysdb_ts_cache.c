@@ -27,6 +27,9 @@
 
 #include "tests/cmocka/common_mock.h"
 #include "db/sysdb_private.h"
+#include "db/sysdb_autofs.h"
+#include "db/sysdb_services.h"
+#include "db/sysdb_sudo.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
 #define TEST_CONF_DB "tests_conf.ldb"
@@ -49,6 +52,12 @@
 #define TEST_USER_SID           "S-1-5-21-123-456-789-222"
 #define TEST_USER_UPN           "test_user@TEST_REALM"
 
+#define TEST_NETGROUP_NAME      "test_netgroup"
+#define TEST_SERVICE_NAME       "test_service"
+#define TEST_SERVICE_PORT       1234
+#define TEST_SUDO_RULE_NAME     "test_sudo_rule"
+#define TEST_AUTOFS_MAP_NAME    "auto.test"
+
 #define TEST_MODSTAMP_1   "20160408132553Z"
 #define TEST_MODSTAMP_2   "20160408142553Z"
 #define TEST_MODSTAMP_3   "20160408152553Z"
@@ -229,8 +238,8 @@ static uint64_t get_dn_cache_timestamp(struct sysdb_ts_test_ctx *test_ctx,
                             NULL,
     };
 
-    ret = ldb_search(test_ctx->tctx->sysdb->ldb, test_ctx, &res,
-                     dn, LDB_SCOPE_BASE, attrs, NULL);
+    ret = ldb_search(sysdb_ldb_for_dn(test_ctx->tctx->sysdb, dn), test_ctx,
+                     &res, dn, LDB_SCOPE_BASE, attrs, NULL);
     if (ret != EOK || res == NULL || res->count != 1) {
         talloc_free(res);
         return 0;
@@ -353,6 +362,30 @@ static void get_pw_timestamp_attrs(struct sysdb_ts_test_ctx *test_ctx,
     *cache_expire_ts = get_pw_ts_cache_timestamp(test_ctx, name);
 }
 
+static void get_dn_timestamp_attrs(struct sysdb_ts_test_ctx *test_ctx,
+                                   struct ldb_dn *dn,
+                                   uint64_t *cache_expire_sysdb,
+                                   uint64_t *cache_expire_ts)
+{
+    assert_non_null(dn);
+
+    *cache_expire_sysdb = get_dn_cache_timestamp(test_ctx, dn);
+    *cache_expire_ts = get_dn_ts_cache_timestamp(test_ctx, dn);
+    talloc_free(dn);
+}
+
+static void get_custom_timestamp_attrs(struct sysdb_ts_test_ctx *test_ctx,
+                                       const char *name,
+                                       const char *subtree,
+                                       uint64_t *cache_expire_sysdb,
+                                       uint64_t *cache_expire_ts)
+{
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_custom_dn(test_ctx, test_ctx->tctx->dom,
+                                           name, subtree),
+                           cache_expire_sysdb, cache_expire_ts);
+}
+
 static void test_sysdb_group_update(void **state)
 {
     int ret;
@@ -1411,6 +1444,330 @@ static void test_sysdb_zero_now(void **state)
     assert_true(cache_expire_ts > TEST_CACHE_TIMEOUT);
 }
 
+static void test_sysdb_netgroup_update(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct ldb_result *res = NULL;
+    struct sysdb_attrs *netgroup_attrs = NULL;
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+
+    ret = sysdb_add_netgroup(test_ctx->tctx->dom, TEST_NETGROUP_NAME, NULL,
+                             NULL, NULL, TEST_CACHE_TIMEOUT, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_netgroup_dn(test_ctx, test_ctx->tctx->dom,
+                                             TEST_NETGROUP_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+
+    /* Only the timestamps differ, only the timestamp cache is bumped */
+    ret = sysdb_add_netgroup(test_ctx->tctx->dom, TEST_NETGROUP_NAME, NULL,
+                             NULL, NULL, TEST_CACHE_TIMEOUT, TEST_NOW_2);
+    assert_int_equal(ret, EOK);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_netgroup_dn(test_ctx, test_ctx->tctx->dom,
+                                             TEST_NETGROUP_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_2);
+
+    /* The lookup returns the timestamps from the timestamp cache */
+    ret = sysdb_getnetgr(test_ctx, test_ctx->tctx->dom,
+                         TEST_NETGROUP_NAME, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                                 SYSDB_CACHE_EXPIRE, 0),
+                     TEST_CACHE_TIMEOUT + TEST_NOW_2);
+    talloc_free(res);
+
+    /* A new triple is a real change, both caches must be updated */
+    netgroup_attrs = create_str_attrs(test_ctx, SYSDB_NETGROUP_TRIPLE,
+                                      "(host,"TEST_USER_NAME",domain)");
+    assert_non_null(netgroup_attrs);
+
+    ret = sysdb_add_netgroup(test_ctx->tctx->dom, TEST_NETGROUP_NAME, NULL,
+                             netgroup_attrs, NULL, TEST_CACHE_TIMEOUT,
+                             TEST_NOW_3);
+    assert_int_equal(ret, EOK);
+    talloc_free(netgroup_attrs);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_netgroup_dn(test_ctx, test_ctx->tctx->dom,
+                                             TEST_NETGROUP_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_3);
+
+    /* Deleting the netgroup removes it from both caches */
+    ret = sysdb_delete_netgroup(test_ctx->tctx->dom, TEST_NETGROUP_NAME);
+    assert_int_equal(ret, EOK);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_netgroup_dn(test_ctx, test_ctx->tctx->dom,
+                                             TEST_NETGROUP_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, 0);
+    assert_int_equal(cache_expire_ts, 0);
+}
+
+static void test_sysdb_service_update(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct sysdb_ctx *sysdb = test_ctx->tctx->sysdb;
+    struct ldb_result *res = NULL;
+    const char *protocols[] = { "tcp", NULL };
+    const char *protocols_2[] = { "tcp", "udp", NULL };
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+
+    ret = sysdb_store_service(test_ctx->tctx->dom, TEST_SERVICE_NAME,
+                              TEST_SERVICE_PORT, NULL, protocols,
+                              NULL, NULL, TEST_CACHE_TIMEOUT, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_svc_dn(sysdb, test_ctx,
+                                        test_ctx->tctx->dom->name,
+                                        TEST_SERVICE_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+
+    /* Only the timestamps differ, only the timestamp cache is bumped */
+    ret = sysdb_store_service(test_ctx->tctx->dom, TEST_SERVICE_NAME,
+                              TEST_SERVICE_PORT, NULL, protocols,
+                              NULL, NULL, TEST_CACHE_TIMEOUT, TEST_NOW_2);
+    assert_int_equal(ret, EOK);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_svc_dn(sysdb, test_ctx,
+                                        test_ctx->tctx->dom->name,
+                                        TEST_SERVICE_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_2);
+
+    /* The lookup returns the timestamps from the timestamp cache */
+    ret = sysdb_getservbyname(test_ctx, test_ctx->tctx->dom,
+                              TEST_SERVICE_NAME, NULL, &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                                 SYSDB_CACHE_EXPIRE, 0),
+                     TEST_CACHE_TIMEOUT + TEST_NOW_2);
+    talloc_free(res);
+
+    /* A new protocol is a real change and must reach the sysdb cache */
+    ret = sysdb_store_service(test_ctx->tctx->dom, TEST_SERVICE_NAME,
+                              TEST_SERVICE_PORT, NULL, protocols_2,
+                              NULL, NULL, TEST_CACHE_TIMEOUT, TEST_NOW_3);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_getservbyname(test_ctx, test_ctx->tctx->dom,
+                              TEST_SERVICE_NAME, "udp", &res);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(res->count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                                 SYSDB_CACHE_EXPIRE, 0),
+                     TEST_CACHE_TIMEOUT + TEST_NOW_3);
+    talloc_free(res);
+
+    /* Deleting the service removes it from both caches */
+    ret = sysdb_svc_delete(test_ctx->tctx->dom, TEST_SERVICE_NAME, 0, NULL);
+    assert_int_equal(ret, EOK);
+
+    get_dn_timestamp_attrs(test_ctx,
+                           sysdb_svc_dn(sysdb, test_ctx,
+                                        test_ctx->tctx->dom->name,
+                                        TEST_SERVICE_NAME),
+                           &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, 0);
+    assert_int_equal(cache_expire_ts, 0);
+}
+
+#ifdef BUILD_SUDO
+static struct sysdb_attrs *create_sudo_rule_attrs(TALLOC_CTX *mem_ctx,
+                                                  const char *host,
+                                                  const char *command)
+{
+    struct sysdb_attrs *rule;
+    int ret;
+
+    rule = create_str_attrs(mem_ctx, SYSDB_SUDO_CACHE_AT_CN,
+                            TEST_SUDO_RULE_NAME);
+    assert_non_null(rule);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_USER,
+                                 TEST_USER_NAME);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_HOST, host);
+    assert_int_equal(ret, EOK);
+
+    if (command != NULL) {
+        ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_COMMAND,
+                                     command);
+        assert_int_equal(ret, EOK);
+    }
+
+    return rule;
+}
+
+static void test_sysdb_sudo_rule_update(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct sss_domain_info *dom = test_ctx->tctx->dom;
+    struct sysdb_attrs *rule;
+    struct ldb_message **msgs;
+    size_t msgs_count;
+    const char *attrs[] = { SYSDB_CACHE_EXPIRE,
+                            SYSDB_SUDO_CACHE_AT_COMMAND,
+                            NULL };
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+    uint64_t cache_expire_first;
+
+    dom->sudo_timeout = TEST_CACHE_TIMEOUT;
+    rule = create_sudo_rule_attrs(test_ctx, "ALL", "/bin/ls");
+    ret = sysdb_sudo_store(dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+    talloc_free(rule);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_SUDO_RULE_NAME, SUDORULE_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_true(cache_expire_sysdb > TEST_CACHE_TIMEOUT);
+    assert_int_equal(cache_expire_ts, cache_expire_sysdb);
+    cache_expire_first = cache_expire_sysdb;
+
+    /* Storing the same rule again only bumps the timestamp cache */
+    dom->sudo_timeout = TEST_CACHE_TIMEOUT * 1000;
+    rule = create_sudo_rule_attrs(test_ctx, "ALL", "/bin/ls");
+    ret = sysdb_sudo_store(dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+    talloc_free(rule);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_SUDO_RULE_NAME, SUDORULE_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, cache_expire_first);
+    assert_true(cache_expire_ts > cache_expire_first);
+
+    /* The lookup returns the timestamps from the timestamp cache */
+    ret = sysdb_search_custom_by_name(test_ctx, dom, TEST_SUDO_RULE_NAME,
+                                      SUDORULE_SUBDIR, attrs,
+                                      &msgs_count, &msgs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(msgs_count, 1);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(msgs[0],
+                                                 SYSDB_CACHE_EXPIRE, 0),
+                     cache_expire_ts);
+    talloc_free(msgs);
+
+    /* A changed rule replaces the cached one including attributes it no
+     * longer has, both caches must be updated */
+    dom->sudo_timeout = TEST_CACHE_TIMEOUT * 2000;
+    rule = create_sudo_rule_attrs(test_ctx, "test.host", NULL);
+    ret = sysdb_sudo_store(dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_SUDO_RULE_NAME, SUDORULE_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_true(cache_expire_sysdb > cache_expire_first);
+    assert_int_equal(cache_expire_ts, cache_expire_sysdb);
+
+    ret = sysdb_search_custom_by_name(test_ctx, dom, TEST_SUDO_RULE_NAME,
+                                      SUDORULE_SUBDIR, attrs,
+                                      &msgs_count, &msgs);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(msgs_count, 1);
+    assert_null(ldb_msg_find_element(msgs[0], SYSDB_SUDO_CACHE_AT_COMMAND));
+    talloc_free(msgs);
+
+    /* A full refresh keeps the rules it is about to store again... */
+    ret = sysdb_sudo_purge(dom, "("SYSDB_OBJECTCLASS"="SYSDB_SUDO_CACHE_OC")",
+                           &rule, 1);
+    assert_int_equal(ret, EOK);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_SUDO_RULE_NAME, SUDORULE_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_not_equal(cache_expire_sysdb, 0);
+    assert_int_not_equal(cache_expire_ts, 0);
+    talloc_free(rule);
+
+    /* ...and removes the others from both caches */
+    ret = sysdb_sudo_purge(dom, "("SYSDB_OBJECTCLASS"="SYSDB_SUDO_CACHE_OC")",
+                           NULL, 0);
+    assert_int_equal(ret, EOK);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_SUDO_RULE_NAME, SUDORULE_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, 0);
+    assert_int_equal(cache_expire_ts, 0);
+}
+#endif /* BUILD_SUDO */
+
+static void test_sysdb_autofs_map_update(void **state)
+{
+    int ret;
+    struct sysdb_ts_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                     struct sysdb_ts_test_ctx);
+    struct ldb_message *map = NULL;
+    uint64_t cache_expire_sysdb;
+    uint64_t cache_expire_ts;
+
+    ret = sysdb_save_autofsmap(test_ctx->tctx->dom, TEST_AUTOFS_MAP_NAME,
+                               TEST_AUTOFS_MAP_NAME, NULL,
+                               TEST_CACHE_TIMEOUT, TEST_NOW_1);
+    assert_int_equal(ret, EOK);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_AUTOFS_MAP_NAME,
+                               AUTOFS_MAP_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+
+    /* Only the timestamps differ, only the timestamp cache is bumped */
+    ret = sysdb_save_autofsmap(test_ctx->tctx->dom, TEST_AUTOFS_MAP_NAME,
+                               TEST_AUTOFS_MAP_NAME, NULL,
+                               TEST_CACHE_TIMEOUT, TEST_NOW_2);
+    assert_int_equal(ret, EOK);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_AUTOFS_MAP_NAME,
+                               AUTOFS_MAP_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, TEST_CACHE_TIMEOUT + TEST_NOW_1);
+    assert_int_equal(cache_expire_ts, TEST_CACHE_TIMEOUT + TEST_NOW_2);
+
+    /* The lookup returns the timestamps from the timestamp cache */
+    ret = sysdb_get_map_byname(test_ctx, test_ctx->tctx->dom,
+                               TEST_AUTOFS_MAP_NAME, &map);
+    assert_int_equal(ret, EOK);
+    assert_non_null(map);
+    assert_int_equal(ldb_msg_find_attr_as_uint64(map, SYSDB_CACHE_EXPIRE, 0),
+                     TEST_CACHE_TIMEOUT + TEST_NOW_2);
+    talloc_free(map);
+
+    /* Deleting the map removes it from both caches */
+    ret = sysdb_delete_autofsmap(test_ctx->tctx->dom, TEST_AUTOFS_MAP_NAME);
+    assert_int_equal(ret, EOK);
+
+    get_custom_timestamp_attrs(test_ctx, TEST_AUTOFS_MAP_NAME,
+                               AUTOFS_MAP_SUBDIR,
+                               &cache_expire_sysdb, &cache_expire_ts);
+    assert_int_equal(cache_expire_sysdb, 0);
+    assert_int_equal(cache_expire_ts, 0);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -1462,6 +1819,20 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sysdb_zero_now,
                                         test_sysdb_ts_setup,
                                         test_sysdb_ts_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_netgroup_update,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_service_update,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
+#ifdef BUILD_SUDO
+        cmocka_unit_test_setup_teardown(test_sysdb_sudo_rule_update,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
+#endif /* BUILD_SUDO */
+        cmocka_unit_test_setup_teardown(test_sysdb_autofs_map_update,
+                                        test_sysdb_ts_setup,
+                                        test_sysdb_ts_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -138,6 +138,64 @@ static void test_sysdb_attrs_add_base64_blob(void **state)
     assert_memory_equal(el->values[0].data, zero, 3);
 }
 
+#define TEST_MANY_ATTRS 40
+static void test_sysdb_attrs_get_el_many(void **state)
+{
+    struct sysdb_attrs *attrs;
+    struct ldb_message_element *el;
+    char *name;
+    int ret;
+    int i;
+
+    attrs = sysdb_new_attrs(NULL);
+    assert_non_null(attrs);
+
+    /* Large enough to be looked up through the name index */
+    for (i = 0; i < TEST_MANY_ATTRS; i++) {
+        name = talloc_asprintf(attrs, "testAttr%d", i);
+        assert_non_null(name);
+        ret = sysdb_attrs_add_string(attrs, name, name);
+        assert_int_equal(ret, EOK);
+        ret = sysdb_attrs_add_string(attrs, name, "second");
+        assert_int_equal(ret, EOK);
+        talloc_free(name);
+    }
+    assert_int_equal(attrs->num, TEST_MANY_ATTRS);
+
+    for (i = 0; i < TEST_MANY_ATTRS; i++) {
+        name = talloc_asprintf(attrs, "TESTATTR%d", i);
+        assert_non_null(name);
+        ret = sysdb_attrs_get_el(attrs, name, &el);
+        assert_int_equal(ret, EOK);
+        assert_ptr_equal(el, &attrs->a[i]);
+        assert_int_equal(el->num_values, 2);
+        talloc_free(name);
+    }
+
+    ret = sysdb_attrs_get_el_ext(attrs, "missingAttr", false, &el);
+    assert_int_equal(ret, ENOENT);
+
+    /* Renamed elements must be found under the new name only */
+    ret = sysdb_attrs_replace_name(attrs, "testAttr7", "renamedAttr");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_get_el_ext(attrs, "testAttr7", false, &el);
+    assert_int_equal(ret, ENOENT);
+    ret = sysdb_attrs_get_el_ext(attrs, "renamedAttr", false, &el);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(el, &attrs->a[7]);
+
+    /* Elements changed directly are picked up as well */
+    attrs->num--;
+    ret = sysdb_attrs_get_el_ext(attrs, "testAttr39", false, &el);
+    assert_int_equal(ret, ENOENT);
+    attrs->num++;
+    ret = sysdb_attrs_get_el_ext(attrs, "testAttr39", false, &el);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(el, &attrs->a[39]);
+
+    talloc_free(attrs);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -152,6 +210,7 @@ int main(int argc, const char *argv[])
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_sysdb_handle_original_uuid),
         cmocka_unit_test(test_sysdb_attrs_add_base64_blob),
+        cmocka_unit_test(test_sysdb_attrs_get_el_many),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -1603,6 +1603,19 @@ static void test_parse_cert_verify_opts(void **state)
     assert_null(cv_opts->ocsp_default_responder_signing_cert);
     talloc_free(cv_opts);
 
+    ret = parse_cert_verify_opts(global_talloc_context, NULL, &cv_opts);
+    assert_int_equal(ret, EOK);
+    assert_false(cv_opts->cache_verification);
+    talloc_free(cv_opts);
+
+    ret = parse_cert_verify_opts(global_talloc_context, "cache_verification",
+                                 &cv_opts);
+    assert_int_equal(ret, EOK);
+    assert_true(cv_opts->do_verification);
+    assert_true(cv_opts->do_ocsp);
+    assert_true(cv_opts->cache_verification);
+    talloc_free(cv_opts);
+
     ret = parse_cert_verify_opts(global_talloc_context,
                                  "ocsp_default_responder=", &cv_opts);
     assert_int_equal(ret, EINVAL);
@@ -1849,6 +1862,121 @@ static void test_sss_get_domain_mappings_content(void **state)
      * capaths might not be as expected. */
 }
 
+static void test_sss_req_pool(void **state)
+{
+    struct sss_req_pool_stats before;
+    struct sss_req_pool_stats after;
+    struct sss_req_pool_stats other;
+    TALLOC_CTX *tmp_ctx;
+    TALLOC_CTX *pool;
+    char *bufs[64];
+    char *buf;
+    int *obj;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    /* Disabled pools allocate directly from the parent */
+    sss_req_pool_set_size(0);
+    pool = sss_req_pool_new(tmp_ctx, SSS_REQ_POOL_CACHE_REQ);
+    assert_ptr_equal(pool, tmp_ctx);
+
+    sss_req_pool_set_size(4096);
+    sss_req_pool_get_stats(SSS_REQ_POOL_CACHE_REQ, &before);
+    sss_req_pool_get_stats(SSS_REQ_POOL_DP_REQ, &other);
+
+    pool = sss_req_pool_new(tmp_ctx, SSS_REQ_POOL_CACHE_REQ);
+    assert_non_null(pool);
+    assert_ptr_not_equal(pool, tmp_ctx);
+    assert_ptr_equal(talloc_parent(pool), tmp_ctx);
+
+    for (i = 0; i < 4; i++) {
+        buf = talloc_zero_size(pool, 100);
+        assert_non_null(buf);
+    }
+    talloc_free(pool);
+
+    sss_req_pool_get_stats(SSS_REQ_POOL_CACHE_REQ, &after);
+    assert_int_equal(after.requests, before.requests + 1);
+    assert_true(after.bytes - before.bytes >= 400);
+    assert_true(after.max_bytes >= 400);
+    assert_int_equal(after.overflows, before.overflows);
+
+    /* Other kinds are not affected */
+    sss_req_pool_get_stats(SSS_REQ_POOL_DP_REQ, &after);
+    assert_int_equal(after.requests, other.requests);
+    assert_int_equal(after.bytes, other.bytes);
+
+    /* Children freed or stolen before the release still count */
+    sss_req_pool_get_stats(SSS_REQ_POOL_DP_REQ, &before);
+    pool = sss_req_pool_new(tmp_ctx, SSS_REQ_POOL_DP_REQ);
+    assert_non_null(pool);
+    for (i = 0; i < 4; i++) {
+        bufs[i] = talloc_zero_size(pool, 100);
+        assert_non_null(bufs[i]);
+    }
+    talloc_free(bufs[0]);
+    talloc_free(bufs[3]);
+    buf = talloc_steal(tmp_ctx, bufs[1]);
+    talloc_free(bufs[2]);
+    talloc_free(pool);
+
+    sss_req_pool_get_stats(SSS_REQ_POOL_DP_REQ, &after);
+    assert_int_equal(after.requests, before.requests + 1);
+    assert_true(after.bytes - before.bytes >= 400);
+    assert_int_equal(after.overflows, before.overflows);
+    assert_int_equal(buf[0], 0);
+    talloc_free(buf);
+
+    /* A request that does not fit into the pool is still served */
+    pool = sss_req_pool_new(tmp_ctx, SSS_REQ_POOL_DP_REQ);
+    assert_non_null(pool);
+    buf = talloc_zero_size(pool, 8192);
+    assert_non_null(buf);
+    talloc_free(pool);
+
+    sss_req_pool_get_stats(SSS_REQ_POOL_DP_REQ, &after);
+    assert_int_equal(after.requests, before.requests + 2);
+    assert_int_equal(after.overflows, before.overflows + 1);
+    assert_true(after.max_bytes >= 8192);
+
+    /* A pool that was used up is counted even if the children that went
+     * to the heap are gone by the time it is released */
+    pool = sss_req_pool_new(tmp_ctx, SSS_REQ_POOL_DP_REQ);
+    assert_non_null(pool);
+    for (i = 0; i < 64; i++) {
+        bufs[i] = talloc_zero_size(pool, 100);
+        assert_non_null(bufs[i]);
+    }
+    for (i = 0; i < 64; i++) {
+        talloc_free(bufs[i]);
+    }
+    talloc_free(pool);
+
+    sss_req_pool_get_stats(SSS_REQ_POOL_DP_REQ, &after);
+    assert_int_equal(after.requests, before.requests + 3);
+    assert_int_equal(after.overflows, before.overflows + 2);
+
+    /* Pooled objects are zeroed */
+    sss_req_pool_get_stats(SSS_REQ_POOL_SDAP_OP, &before);
+    obj = sss_req_pool_zero(tmp_ctx, int);
+    assert_non_null(obj);
+    assert_int_equal(*obj, 0);
+    buf = talloc_zero_size(obj, 100);
+    assert_non_null(buf);
+    talloc_free(buf);
+    sss_req_pool_account(obj, SSS_REQ_POOL_SDAP_OP);
+
+    sss_req_pool_get_stats(SSS_REQ_POOL_SDAP_OP, &after);
+    assert_int_equal(after.requests, before.requests + 1);
+    assert_true(after.bytes - before.bytes >= 100);
+    assert_int_equal(after.overflows, before.overflows);
+
+    sss_req_pool_set_size(0);
+    talloc_free(tmp_ctx);
+}
+
 static void test_is_email_from_domain(void **state)
 {
     struct dom_list_test_ctx *test_ctx = talloc_get_type(*state,
@@ -1966,6 +2094,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sss_get_domain_mappings_content,
                                         setup_dom_list_with_subdomains,
                                         teardown_dom_list),
+        cmocka_unit_test_setup_teardown(test_sss_req_pool,
+                                        setup_leak_tests,
+                                        teardown_leak_tests),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
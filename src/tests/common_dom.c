@@ -305,6 +305,23 @@ create_dom_test_ctx(TALLOC_CTX *mem_ctx,
                                     id_provider, &params);
 }
 
+static void test_unlink_shard_file(const char *path)
+{
+    errno_t ret;
+
+    if (path == NULL) {
+        return;
+    }
+
+    errno = 0;
+    ret = unlink(path);
+    if (ret != 0 && errno != ENOENT) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not delete the test domain "
+              "ldb shard file [%d]: (%s)\n", ret, sss_strerror(ret));
+    }
+}
+
 void test_multidom_suite_cleanup(const char *tests_path,
                                  const char *cdb_file,
                                  const char **domains)
@@ -378,6 +395,14 @@ void test_multidom_suite_cleanup(const char *tests_path,
                     DEBUG(SSSDBG_CRIT_FAILURE, "Could not delete the test domain "
                         "ldb timestamp file [%d]: (%s)\n", ret, sss_strerror(ret));
                 }
+
+                /* Shard caches exist only if the test enabled cache_shards */
+                test_unlink_shard_file(talloc_asprintf(tmp_ctx,
+                                                       "%s/"CACHE_SUDO_FILE,
+                                                       tests_path, domains[i]));
+                test_unlink_shard_file(talloc_asprintf(tmp_ctx,
+                                                       "%s/"CACHE_MISC_FILE,
+                                                       tests_path, domains[i]));
             }
 
             talloc_zfree(sysdb_path);
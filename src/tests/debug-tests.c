@@ -651,6 +651,146 @@ START_TEST(test_debug_is_set_false)
 }
 END_TEST
 
+START_TEST(test_debug_flight_recorder)
+{
+    char filename[24] = {'\0'};
+    char buf[1024];
+    const char *trace;
+    const char *failure;
+    FILE *file;
+    size_t len;
+    mode_t old_umask;
+    int fd;
+    int ret;
+
+    debug_timestamps = 0;
+    debug_microseconds = 0;
+    debug_to_file = 1;
+    debug_prg_name = "sssd";
+    debug_level = SSSDBG_OP_FAILURE;
+    debug_flight_recorder = 1;
+
+    strncpy(filename, "sssd_debug_tests.XXXXXX", 24);
+
+    old_umask = umask(SSS_DFL_UMASK);
+    fd = mkstemp(filename);
+    umask(old_umask);
+    fail_if(fd == -1, "mkstemp failed");
+
+    file = fdopen(fd, "r");
+    fail_if(file == NULL, "fdopen failed");
+
+    ret = set_debug_file_from_fd(fd);
+    fail_unless(ret == EOK, "set_debug_file_from_fd failed");
+
+    /* Messages that are not enabled are kept in memory only */
+    DEBUG(SSSDBG_TRACE_FUNC, "recorded message\n");
+
+    len = fread(buf, 1, sizeof(buf) - 1, file);
+    fail_unless(len == 0, "Recorded message was written to the log");
+
+    /* and written out with the next failure */
+    DEBUG(SSSDBG_OP_FAILURE, "failure message\n");
+
+    rewind(file);
+    len = fread(buf, 1, sizeof(buf) - 1, file);
+    buf[len] = '\0';
+
+    trace = strstr(buf, "recorded message\n");
+    failure = strstr(buf, "failure message\n");
+    fail_if(trace == NULL, "Recorded message is missing");
+    fail_if(failure == NULL, "Failure message is missing");
+    fail_unless(trace < failure, "Recorded message must precede the failure");
+
+    debug_flight_recorder = 0;
+    fclose(file);
+    remove(filename);
+}
+END_TEST
+
+START_TEST(test_debug_buffered)
+{
+    char filename[24] = {'\0'};
+    char buf[1024];
+    const char *first;
+    const char *second;
+    const char *failure;
+    FILE *file;
+    size_t len;
+    mode_t old_umask;
+    int fd;
+    int ret;
+
+    debug_timestamps = 0;
+    debug_microseconds = 0;
+    debug_to_file = 1;
+    debug_prg_name = "sssd";
+    debug_level = SSSDBG_TRACE_FUNC | SSSDBG_OP_FAILURE;
+    debug_buffered = 1;
+
+    strncpy(filename, "sssd_debug_tests.XXXXXX", 24);
+
+    old_umask = umask(SSS_DFL_UMASK);
+    fd = mkstemp(filename);
+    umask(old_umask);
+    fail_if(fd == -1, "mkstemp failed");
+
+    file = fdopen(fd, "r");
+    fail_if(file == NULL, "fdopen failed");
+
+    ret = set_debug_file_from_fd(fd);
+    fail_unless(ret == EOK, "set_debug_file_from_fd failed");
+
+    /* Messages are kept in memory until the buffer is written out */
+    DEBUG(SSSDBG_TRACE_FUNC, "first message\n");
+
+    len = fread(buf, 1, sizeof(buf) - 1, file);
+    fail_unless(len == 0, "Buffered message was written to the log");
+
+    /* as it is before _exit() */
+    sss_debug_flush_sigsafe();
+
+    rewind(file);
+    len = fread(buf, 1, sizeof(buf) - 1, file);
+    buf[len] = '\0';
+    fail_if(strstr(buf, "first message\n") == NULL,
+            "Buffered message is missing after the flush");
+
+    /* Failures are written out immediately, after the pending messages */
+    DEBUG(SSSDBG_TRACE_FUNC, "second message\n");
+    DEBUG(SSSDBG_OP_FAILURE, "failure message\n");
+
+    rewind(file);
+    len = fread(buf, 1, sizeof(buf) - 1, file);
+    buf[len] = '\0';
+
+    first = strstr(buf, "first message\n");
+    second = strstr(buf, "second message\n");
+    failure = strstr(buf, "failure message\n");
+    fail_if(second == NULL, "Buffered message is missing");
+    fail_if(failure == NULL, "Failure message is missing");
+    fail_unless(first < second && second < failure,
+                "Messages are out of order");
+
+    /* The flight recorder is written out as well */
+    debug_level = SSSDBG_OP_FAILURE;
+    debug_flight_recorder = 1;
+    DEBUG(SSSDBG_TRACE_FUNC, "recorded message\n");
+    sss_debug_flush_sigsafe();
+
+    rewind(file);
+    len = fread(buf, 1, sizeof(buf) - 1, file);
+    buf[len] = '\0';
+    fail_if(strstr(buf, "recorded message\n") == NULL,
+            "Recorded message is missing after the flush");
+
+    debug_flight_recorder = 0;
+    debug_buffered = 0;
+    fclose(file);
+    remove(filename);
+}
+END_TEST
+
 Suite *debug_suite(void)
 {
     Suite *s = suite_create("debug");
@@ -667,6 +807,8 @@ Suite *debug_suite(void)
     tcase_add_test(tc_debug, test_debug_is_notset_timestamp_microseconds);
     tcase_add_test(tc_debug, test_debug_is_set_true);
     tcase_add_test(tc_debug, test_debug_is_set_false);
+    tcase_add_test(tc_debug, test_debug_flight_recorder);
+    tcase_add_test(tc_debug, test_debug_buffered);
     tcase_set_timeout(tc_debug, 60);
 
     suite_add_tcase(s, tc_debug);
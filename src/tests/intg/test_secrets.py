@@ -385,3 +385,66 @@ def test_containers(setup_for_secrets, secrets_cli):
     with pytest.raises(HTTPError) as err406:
         cli.create_container(container)
     assert str(err406.value).startswith("406")
+
+
+def read_http_replies(sock, count):
+    """Read count HTTP replies from sock, return their status lines"""
+    data = b""
+    statuses = []
+    while len(statuses) < count:
+        while b"\r\n\r\n" not in data:
+            chunk = sock.recv(4096)
+            assert chunk
+            data += chunk
+        head, data = data.split(b"\r\n\r\n", 1)
+        lines = head.split(b"\r\n")
+        length = 0
+        for line in lines[1:]:
+            name, value = line.split(b":", 1)
+            if name.strip().lower() == b"content-length":
+                length = int(value.strip())
+        while len(data) < length:
+            chunk = sock.recv(4096)
+            assert chunk
+            data += chunk
+        data = data[length:]
+        statuses.append(lines[0])
+    return statuses
+
+
+def test_keepalive_pipelining(setup_for_secrets, secrets_cli):
+    """
+    Test that several requests can be sent over a single connection,
+    including pipelined ones, and that Connection: close is honoured
+    """
+    cli = secrets_cli
+    cli.set_secret("foo", "bar")
+
+    get_req = (b"GET /secrets/foo HTTP/1.1\r\n"
+               b"Host: localhost\r\n"
+               b"Content-Type: application/json\r\n"
+               b"\r\n")
+    close_req = (b"GET /secrets/foo HTTP/1.1\r\n"
+                 b"Host: localhost\r\n"
+                 b"Content-Type: application/json\r\n"
+                 b"Connection: close\r\n"
+                 b"\r\n")
+
+    sock = socket.socket(family=socket.AF_UNIX)
+    sock.settimeout(10)
+    sock.connect(get_secrets_socket())
+
+    # Two sequential requests on the same connection
+    for _ in range(2):
+        sock.sendall(get_req)
+        statuses = read_http_replies(sock, 1)
+        assert statuses[0].startswith(b"HTTP/1.1 200")
+
+    # Three pipelined requests sent at once, the last one closes
+    sock.sendall(get_req + get_req + close_req)
+    statuses = read_http_replies(sock, 3)
+    for status in statuses:
+        assert status.startswith(b"HTTP/1.1 200")
+
+    assert sock.recv(4096) == b""
+    sock.close()
@@ -20,6 +20,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -820,6 +821,115 @@ START_TEST(ipa_hbac_test_allow_srchostgroup)
 }
 END_TEST
 
+START_TEST(ipa_hbac_test_ruleset)
+{
+    enum hbac_eval_result result;
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_ruleset *ruleset = NULL;
+    struct hbac_info *info = NULL;
+    enum hbac_error_code code;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL);
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+
+    /* Create the rules to evaluate against */
+    rules = talloc_array(test_ctx, struct hbac_rule *, 4);
+    fail_if (rules == NULL);
+
+    /* A disabled rule never matches */
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->name = talloc_strdup(rules[0], "Disabled");
+    fail_if(rules[0]->name == NULL);
+    rules[0]->enabled = false;
+
+    /* A rule for a different service */
+    get_allow_all_rule(rules, &rules[1]);
+    rules[1]->name = talloc_strdup(rules[1], "Allow other service");
+    fail_if(rules[1]->name == NULL);
+    rules[1]->services->category = HBAC_CATEGORY_NULL;
+    rules[1]->services->names = talloc_array(rules[1], const char *, 2);
+    fail_if(rules[1]->services->names == NULL);
+    rules[1]->services->names[0] = HBAC_TEST_INVALID_SERVICE;
+    rules[1]->services->names[1] = NULL;
+
+    /* A rule for the requested service and a group of the user, the names
+     * differ in case from the ones in the request */
+    get_allow_all_rule(rules, &rules[2]);
+    rules[2]->name = talloc_strdup(rules[2], "Allow service");
+    fail_if(rules[2]->name == NULL);
+    rules[2]->services->category = HBAC_CATEGORY_NULL;
+    rules[2]->services->names = talloc_array(rules[2], const char *, 2);
+    fail_if(rules[2]->services->names == NULL);
+    rules[2]->services->names[0] = "TestService";
+    rules[2]->services->names[1] = NULL;
+    rules[2]->users->category = HBAC_CATEGORY_NULL;
+    rules[2]->users->groups = talloc_array(rules[2], const char *, 2);
+    fail_if(rules[2]->users->groups == NULL);
+    rules[2]->users->groups[0] = "TESTGROUP2";
+    rules[2]->users->groups[1] = NULL;
+
+    rules[3] = NULL;
+
+    code = hbac_ruleset_compile(rules, &ruleset);
+    fail_unless(code == HBAC_SUCCESS,
+                "Compilation failed: [%s]", hbac_error_string(code));
+
+    /* The compiled ruleset does not reference the rules */
+    talloc_free(rules);
+
+    result = hbac_ruleset_evaluate(ruleset, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_ALLOW,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(HBAC_EVAL_ALLOW),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    fail_unless(strcmp(info->rule_name, "Allow service") == 0,
+                "Expected rule [Allow service], got [%s]", info->rule_name);
+    hbac_free_info(info);
+    info = NULL;
+
+    /* Negative test, the user is not a member of the group */
+    eval_req->user->groups[1] = HBAC_TEST_INVALID_GROUP;
+
+    result = hbac_ruleset_evaluate(ruleset, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_DENY,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(HBAC_EVAL_DENY),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    hbac_free_info(info);
+    info = NULL;
+
+    /* Negative test, no rule for this service */
+    eval_req->user->groups[1] = HBAC_TEST_GROUP2;
+    eval_req->service->name = HBAC_TEST_INVALID_SERVICEGROUP;
+
+    result = hbac_ruleset_evaluate(ruleset, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_DENY,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(HBAC_EVAL_DENY),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    hbac_free_info(info);
+    info = NULL;
+
+    hbac_ruleset_free(ruleset);
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST(ipa_hbac_test_incomplete)
 {
     TALLOC_CTX *test_ctx;
@@ -861,6 +971,7 @@ Suite *hbac_test_suite (void)
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_srchostgroup);
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_utf8);
     tcase_add_test(tc_hbac, ipa_hbac_test_incomplete);
+    tcase_add_test(tc_hbac, ipa_hbac_test_ruleset);
 
     suite_add_tcase(s, tc_hbac);
     return s;
@@ -212,6 +212,78 @@ static int pilot_test_server_init(struct sbus_connection *server, void *unused)
     return EOK;
 }
 
+#define EJECTOR_IFACE "test.Ejector"
+#define EJECTOR_PING "Ping"
+#define EJECTOR_EJECT "Eject"
+
+struct ejector_vtable {
+    struct sbus_vtable vtable;
+    sbus_msg_handler_fn Ping;
+    sbus_msg_handler_fn Eject;
+};
+
+const struct sbus_method_meta ejector_methods[] = {
+    {
+        EJECTOR_PING, /* method name */
+        NULL, /* in args: manually parsed */
+        NULL, /* out args: manually parsed */
+        offsetof(struct ejector_vtable, Ping),
+        NULL
+    },
+    {
+        EJECTOR_EJECT, /* method name */
+        NULL, /* in args: manually parsed */
+        NULL, /* out args: manually parsed */
+        offsetof(struct ejector_vtable, Eject),
+        NULL
+    },
+    { NULL, }
+};
+
+const struct sbus_interface_meta ejector_meta = {
+    EJECTOR_IFACE, /* name */
+    ejector_methods,
+    NULL, /* no signals */
+    NULL, /* no properties */
+    NULL, /* no GetAll invoker */
+};
+
+static int ping_handler(struct sbus_request *req, void *data)
+{
+    return sbus_request_return_and_finish(req, DBUS_TYPE_INVALID);
+}
+
+static int eject_handler(struct sbus_request *req, void *data)
+{
+    struct sbus_connection *conn = req->conn;
+    int ret;
+
+    /* Disconnect from within the handler while more messages are still
+     * waiting in the same dispatch batch */
+    ret = sbus_request_return_and_finish(req, DBUS_TYPE_INVALID);
+    sbus_disconnect(conn);
+
+    return ret;
+}
+
+struct ejector_vtable ejector_impl = {
+    { &ejector_meta, 0 },
+    .Ping = ping_handler,
+    .Eject = eject_handler,
+};
+
+static int ejector_test_server_init(struct sbus_connection *server,
+                                    void *unused)
+{
+    int ret;
+
+    ret = sbus_conn_register_iface(server, &ejector_impl.vtable,
+                                   "/test/bender", NULL);
+    ck_assert_int_eq(ret, EOK);
+
+    return EOK;
+}
+
 START_TEST(test_raw_handler)
 {
     TALLOC_CTX *ctx;
@@ -383,6 +455,74 @@ START_TEST(test_introspection)
 }
 END_TEST
 
+static DBusPendingCall *ejector_send(DBusConnection *client,
+                                     const char *method)
+{
+    DBusPendingCall *pending;
+    DBusMessage *message;
+
+    message = dbus_message_new_method_call(NULL, "/test/bender",
+                                           EJECTOR_IFACE, method);
+    ck_assert(message != NULL);
+
+    ck_assert(dbus_connection_send_with_reply(client, message,
+                                              &pending, -1));
+    ck_assert(pending != NULL);
+    dbus_message_unref(message);
+
+    return pending;
+}
+
+static int ejector_reply_type(DBusPendingCall *pending)
+{
+    DBusMessage *reply;
+    int type;
+
+    dbus_pending_call_block(pending);
+    reply = dbus_pending_call_steal_reply(pending);
+    ck_assert(reply != NULL);
+    type = dbus_message_get_type(reply);
+
+    dbus_message_unref(reply);
+    dbus_pending_call_unref(pending);
+
+    return type;
+}
+
+START_TEST(test_disconnect_in_batch)
+{
+    TALLOC_CTX *ctx;
+    DBusConnection *client;
+    DBusPendingCall *pending[4];
+
+    ctx = talloc_new(NULL);
+    client = test_dbus_setup_mock(ctx, NULL, ejector_test_server_init, NULL);
+
+    /* Queue all the calls at once so that the server dispatches them in
+     * a single batch and the connection goes away in the middle of it */
+    pending[0] = ejector_send(client, EJECTOR_PING);
+    pending[1] = ejector_send(client, EJECTOR_EJECT);
+    pending[2] = ejector_send(client, EJECTOR_PING);
+    pending[3] = ejector_send(client, EJECTOR_PING);
+    dbus_connection_flush(client);
+
+    ck_assert_int_eq(ejector_reply_type(pending[0]),
+                     DBUS_MESSAGE_TYPE_METHOD_RETURN);
+    ck_assert_int_eq(ejector_reply_type(pending[1]),
+                     DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+    /* Nothing is dispatched once the server has disconnected */
+    ck_assert_int_eq(ejector_reply_type(pending[2]),
+                     DBUS_MESSAGE_TYPE_ERROR);
+    ck_assert_int_eq(ejector_reply_type(pending[3]),
+                     DBUS_MESSAGE_TYPE_ERROR);
+
+    /* The server child must have survived the disconnect, this is
+     * verified when the mock server is torn down */
+    talloc_free(ctx);
+}
+END_TEST
+
 START_TEST(test_sbus_new_error)
 {
     TALLOC_CTX *ctx;
@@ -423,6 +563,7 @@ TCase *create_sbus_tests(void)
     tcase_add_test(tc, test_request_parse_bad_args);
     tcase_add_test(tc, test_request_dontcrash);
     tcase_add_test(tc, test_introspection);
+    tcase_add_test(tc, test_disconnect_in_batch);
     tcase_add_test(tc, test_sbus_new_error);
 
     return tc;
@@ -25,6 +25,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -43,9 +44,37 @@ int debug_timestamps = SSSDBG_TIMESTAMP_UNRESOLVED;
 int debug_microseconds = SSSDBG_MICROSECONDS_UNRESOLVED;
 int debug_to_file = 0;
 int debug_to_stderr = 0;
+int debug_buffered = 0;
+int debug_flight_recorder = 0;
 const char *debug_log_file = "sssd";
 FILE *debug_file = NULL;
 
+/* Messages at these levels are written out immediately even if the output
+ * is buffered, and they dump the flight recorder. */
+#define DEBUG_FAILURE_LEVELS (SSSDBG_FATAL_FAILURE | \
+                              SSSDBG_CRIT_FAILURE | \
+                              SSSDBG_OP_FAILURE)
+
+#define DEBUG_BUFFER_SIZE (64 * 1024)
+#define DEBUG_PREFIX_SIZE 256
+#define DEBUG_RECORDER_SIZE (1024 * 1024)
+#define DEBUG_RECORDER_LINE_SIZE 1024
+
+struct debug_recorder {
+    char *buf;
+    size_t pos;
+    bool wrapped;
+};
+
+static struct debug_recorder debug_recorder;
+
+/* Buffered output is kept here rather than in a stdio buffer, so that it
+ * can be written out with write() alone, also from a signal handler. */
+static char debug_buffer[DEBUG_BUFFER_SIZE];
+static size_t debug_buffer_pos;
+
+static void debug_fflush(void);
+
 errno_t set_debug_file_from_fd(const int fd)
 {
     FILE *dummy;
@@ -65,6 +94,7 @@ errno_t set_debug_file_from_fd(const int fd)
         return ret;
     }
 
+    debug_fflush();
     debug_file = dummy;
 
     return EOK;
@@ -119,13 +149,92 @@ int debug_convert_old_level(int old_level)
     return new_level;
 }
 
+/* Only uses write(), so it is safe to call from a signal handler. */
+static void debug_write(const char *buf, size_t len)
+{
+    int fd = get_fd_from_debug_file();
+    ssize_t ret;
+
+    while (len > 0) {
+        ret = write(fd, buf, len);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        buf += ret;
+        len -= ret;
+    }
+}
+
+/* If a signal handler flushes while this runs, the output is written
+ * twice rather than lost. */
+static void debug_buffer_write(void)
+{
+    debug_write(debug_buffer, debug_buffer_pos);
+    debug_buffer_pos = 0;
+}
+
 static void debug_fflush(void)
 {
+    debug_buffer_write();
+    fflush(debug_file ? debug_file : stderr);
+}
+
+void sss_debug_flush(void)
+{
+    debug_fflush();
+}
+
+static void debug_buffer_vprintf(const char *format, va_list ap)
+{
+    static bool atexit_set;
+    size_t avail;
+    va_list ap_copy;
+    int ret;
+
+    if (!atexit_set) {
+        /* write out the tail on exit(), _exit() callers flush themselves */
+        atexit(sss_debug_flush);
+        atexit_set = true;
+    }
+
+    avail = sizeof(debug_buffer) - debug_buffer_pos;
+    va_copy(ap_copy, ap);
+    ret = vsnprintf(debug_buffer + debug_buffer_pos, avail, format, ap_copy);
+    va_end(ap_copy);
+    if (ret < 0) {
+        return;
+    }
+
+    if ((size_t)ret < avail) {
+        debug_buffer_pos += ret;
+        return;
+    }
+
+    /* does not fit, write out what we have and try again */
+    debug_buffer_write();
+
+    if ((size_t)ret < sizeof(debug_buffer)) {
+        vsnprintf(debug_buffer, sizeof(debug_buffer), format, ap);
+        debug_buffer_pos = ret;
+        return;
+    }
+
+    /* larger than the whole buffer */
+    vfprintf(debug_file ? debug_file : stderr, format, ap);
     fflush(debug_file ? debug_file : stderr);
 }
 
 static void debug_vprintf(const char *format, va_list ap)
 {
+    if (debug_buffered) {
+        debug_buffer_vprintf(format, ap);
+        return;
+    }
+
     vfprintf(debug_file ? debug_file : stderr, format, ap);
 }
 
@@ -143,6 +252,165 @@ static void debug_printf(const char *format, ...)
     va_end(ap);
 }
 
+/* Formatting the date is expensive, so it is only done once per second. */
+static void debug_format_prefix(char *buf, size_t size,
+                                const struct timeval *tv,
+                                const char *function,
+                                int level)
+{
+    static time_t cached_sec = -1;
+    static char datetime[20];
+    static int year;
+    char timestr[26];
+    struct tm tm;
+
+    if (!debug_timestamps) {
+        snprintf(buf, size, "[%s] [%s] (%#.4x): ",
+                 debug_prg_name, function, level);
+        return;
+    }
+
+    if (tv->tv_sec != cached_sec) {
+        localtime_r(&tv->tv_sec, &tm);
+        year = tm.tm_year + 1900;
+        /* get date time without year */
+        asctime_r(&tm, timestr);
+        memcpy(datetime, timestr, 19);
+        datetime[19] = '\0';
+        cached_sec = tv->tv_sec;
+    }
+
+    if (debug_microseconds) {
+        snprintf(buf, size, "(%s:%.6ld %d) [%s] [%s] (%#.4x): ",
+                 datetime, tv->tv_usec, year,
+                 debug_prg_name, function, level);
+    } else {
+        snprintf(buf, size, "(%s %d) [%s] [%s] (%#.4x): ",
+                 datetime, year, debug_prg_name, function, level);
+    }
+}
+
+/* When buffering is enabled, failures are written out immediately and
+ * everything else when the buffer is full. The rest relies on
+ * sss_debug_flush() being called periodically. */
+static void debug_flush(int level)
+{
+    if (debug_buffered && !(level & DEBUG_FAILURE_LEVELS)) {
+        return;
+    }
+
+    debug_fflush();
+}
+
+/* The flight recorder keeps the most recent messages that are not enabled
+ * by debug_level in memory and writes them out when a failure is logged. */
+static void debug_recorder_add(const char *prefix,
+                               int flags,
+                               const char *format,
+                               va_list ap)
+{
+    struct debug_recorder *rec = &debug_recorder;
+    char line[DEBUG_RECORDER_LINE_SIZE];
+    size_t len;
+    size_t off;
+    size_t chunk;
+    int ret;
+
+    if (rec->buf == NULL) {
+        rec->buf = malloc(DEBUG_RECORDER_SIZE);
+        if (rec->buf == NULL) {
+            debug_flight_recorder = 0;
+            return;
+        }
+    }
+
+    len = strlen(prefix);
+    if (len >= sizeof(line)) {
+        return;
+    }
+    memcpy(line, prefix, len);
+
+    ret = vsnprintf(line + len, sizeof(line) - len, format, ap);
+    if (ret < 0) {
+        return;
+    }
+
+    len += ret;
+    if (len > sizeof(line) - 2) {
+        /* truncated */
+        len = sizeof(line) - 2;
+    }
+    if (flags & APPEND_LINE_FEED || line[len - 1] != '\n') {
+        line[len++] = '\n';
+    }
+
+    for (off = 0; off < len; off += chunk) {
+        chunk = DEBUG_RECORDER_SIZE - rec->pos;
+        if (chunk > len - off) {
+            chunk = len - off;
+        }
+        memcpy(rec->buf + rec->pos, line + off, chunk);
+        rec->pos += chunk;
+
+        if (rec->pos == DEBUG_RECORDER_SIZE) {
+            rec->pos = 0;
+            rec->wrapped = true;
+        }
+    }
+}
+
+static void debug_recorder_banner(const char *text)
+{
+    debug_write("[", 1);
+    debug_write(debug_prg_name, strlen(debug_prg_name));
+    debug_write("] ", 2);
+    debug_write(text, strlen(text));
+}
+
+/* Writes the ring directly to the log, so any buffered output has to be
+ * written out first. Only uses write() and can run in a signal handler. */
+static void debug_recorder_dump(void)
+{
+    struct debug_recorder *rec = &debug_recorder;
+    const char *start;
+    const char *end;
+    size_t pos = rec->pos;
+
+    if (rec->buf == NULL || (pos == 0 && !rec->wrapped)) {
+        return;
+    }
+
+    debug_recorder_banner("********** Flight recorder: messages preceding "
+                          "the failure **********\n");
+
+    if (rec->wrapped) {
+        /* skip the partially overwritten line */
+        start = rec->buf + pos;
+        end = rec->buf + DEBUG_RECORDER_SIZE;
+        start = memchr(start, '\n', end - start);
+        if (start != NULL) {
+            start++;
+            debug_write(start, end - start);
+        }
+    }
+
+    debug_write(rec->buf, pos);
+
+    debug_recorder_banner("********** End of flight recorder **********\n");
+
+    rec->pos = 0;
+    rec->wrapped = false;
+}
+
+void sss_debug_flush_sigsafe(void)
+{
+    debug_buffer_write();
+
+    if (debug_flight_recorder) {
+        debug_recorder_dump();
+    }
+}
+
 #ifdef WITH_JOURNALD
 errno_t journal_send(const char *file,
         long line,
@@ -214,16 +482,19 @@ void sss_vdebug_fn(const char *file,
                    const char *format,
                    va_list ap)
 {
+    char prefix[DEBUG_PREFIX_SIZE];
     struct timeval tv;
-    struct tm *tm;
-    char datetime[20];
-    int year;
 
 #ifdef WITH_JOURNALD
     errno_t ret;
     va_list ap_fallback;
 
     if (!debug_file && !debug_to_stderr) {
+        /* The flight recorder is not used with journald. */
+        if (debug_flight_recorder && !DEBUG_IS_SET(level)) {
+            return;
+        }
+
         /* If we are not outputting logs to files, we should be sending them
          * to journald.
          * NOTE: on modern systems, this is where stdout/stderr will end up
@@ -243,33 +514,27 @@ void sss_vdebug_fn(const char *file,
     }
 #endif
 
-    if (debug_timestamps) {
-        gettimeofday(&tv, NULL);
-        tm = localtime(&tv.tv_sec);
-        year = tm->tm_year + 1900;
-        /* get date time without year */
-        memcpy(datetime, ctime(&tv.tv_sec), 19);
-        datetime[19] = '\0';
-        if (debug_microseconds) {
-            debug_printf("(%s:%.6ld %d) [%s] [%s] (%#.4x): ",
-                         datetime, tv.tv_usec,
-                         year, debug_prg_name,
-                         function, level);
-        } else {
-            debug_printf("(%s %d) [%s] [%s] (%#.4x): ",
-                         datetime, year,
-                         debug_prg_name, function, level);
+    gettimeofday(&tv, NULL);
+    debug_format_prefix(prefix, sizeof(prefix), &tv, function, level);
+
+    if (debug_flight_recorder) {
+        if (!DEBUG_IS_SET(level)) {
+            debug_recorder_add(prefix, flags, format, ap);
+            return;
+        }
+
+        if (level & DEBUG_FAILURE_LEVELS) {
+            debug_fflush();
+            debug_recorder_dump();
         }
-    } else {
-        debug_printf("[%s] [%s] (%#.4x): ",
-                     debug_prg_name, function, level);
     }
 
+    debug_printf("%s", prefix);
     debug_vprintf(format, ap);
     if (flags & APPEND_LINE_FEED) {
         debug_printf("\n");
     }
-    debug_fflush();
+    debug_flush(level);
 }
 
 void sss_debug_fn(const char *file,
@@ -305,7 +570,7 @@ void ldb_debug_messages(void *context, enum ldb_debug_level level,
         break;
     }
 
-    if (DEBUG_IS_SET(loglevel)) {
+    if (DEBUG_IS_SET(loglevel) || debug_flight_recorder) {
         sss_vdebug_fn(__FILE__, __LINE__, "ldb", loglevel, APPEND_LINE_FEED,
                       fmt, ap);
     }
@@ -372,7 +637,10 @@ int open_debug_file_ex(const char *filename, FILE **filep, bool want_cloexec)
         return ENOMEM;
     }
 
-    if (debug_file && !filep) fclose(debug_file);
+    if (debug_file && !filep) {
+        debug_fflush();
+        fclose(debug_file);
+    }
 
     old_umask = umask(SSS_DFL_UMASK);
     errno = 0;
@@ -418,6 +686,8 @@ int rotate_debug_files(void)
 
     if (!debug_to_file) return EOK;
 
+    debug_fflush();
+
     do {
         error = 0;
         ret = fclose(debug_file);
@@ -37,6 +37,8 @@ extern int debug_timestamps;
 extern int debug_microseconds;
 extern int debug_to_file;
 extern int debug_to_stderr;
+extern int debug_buffered;
+extern int debug_flight_recorder;
 extern const char *debug_log_file;
 void sss_vdebug_fn(const char *file,
                    long line,
@@ -50,6 +52,10 @@ void sss_debug_fn(const char *file,
                   const char *function,
                   int level,
                   const char *format, ...) SSS_ATTRIBUTE_PRINTF(5, 6);
+void sss_debug_flush(void);
+/* Writes out buffered debug output and the flight recorder with write()
+ * only. Meant for signal handlers and other callers of _exit(). */
+void sss_debug_flush_sigsafe(void);
 int debug_convert_old_level(int old_level);
 errno_t set_debug_file_from_fd(const int fd);
 int get_fd_from_debug_file(void);
@@ -102,7 +108,7 @@ int get_fd_from_debug_file(void);
 */
 #define DEBUG(level, format, ...) do { \
     int __debug_macro_level = level; \
-    if (DEBUG_IS_SET(__debug_macro_level)) { \
+    if (DEBUG_IS_SET(__debug_macro_level) || debug_flight_recorder) { \
         sss_debug_fn(__FILE__, __LINE__, __FUNCTION__, \
                      __debug_macro_level, \
                      format, ##__VA_ARGS__); \
@@ -18,6 +18,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
 #include <talloc.h>
 
 #include "util/util.h"
@@ -66,3 +67,236 @@ void *sss_mem_attach(TALLOC_CTX *mem_ctx,
 
     return h;
 }
+
+/*
+ * Request pools
+ * When enabled, each request allocates its whole talloc hierarchy from a
+ * single talloc pool instead of calling malloc() for every small object.
+ * This keeps the short-lived request data together and returns it to the
+ * system in one piece. Anything stolen out of the pool keeps the pool
+ * memory allocated until it is freed, so this is only enabled on demand.
+ */
+
+#define SSS_REQ_POOL_STATS_INTERVAL 1000
+
+/* Pool memory that was never handed out keeps this value, so the highest
+ * byte that differs from it marks the most the pool was ever used. This
+ * also covers children that were freed or stolen before the release. */
+#define SSS_REQ_POOL_FILL 0xa5
+
+/* A pool with less room left than this can no longer serve a typical
+ * allocation and later children go to the heap. */
+#define SSS_REQ_POOL_SLACK 256
+
+/* talloc places the pool memory of a pooled object after the object,
+ * aligned to 16 bytes. A plain talloc_pool has a size of zero. */
+#define SSS_REQ_POOL_ALIGN(size) (((size) + 15) & ~((size_t)15))
+
+static size_t sss_req_pool_size;
+static struct sss_req_pool_stats sss_req_pool_stats[SSS_REQ_POOL_KIND_NUM];
+
+static const char *sss_req_pool_kind_str(enum sss_req_pool_kind kind)
+{
+    switch (kind) {
+    case SSS_REQ_POOL_CACHE_REQ:
+        return "cache_req";
+    case SSS_REQ_POOL_DP_REQ:
+        return "dp_req";
+    case SSS_REQ_POOL_SDAP_OP:
+        return "sdap_op";
+    case SSS_REQ_POOL_KIND_NUM:
+        break;
+    }
+
+    return "unknown";
+}
+
+void sss_req_pool_set_size(size_t size)
+{
+    sss_req_pool_size = size;
+}
+
+errno_t sss_req_pool_init(struct confdb_ctx *cdb, const char *conf_path)
+{
+    int size_kb;
+    errno_t ret;
+
+    ret = confdb_get_int(cdb, conf_path, CONFDB_SERVICE_REQUEST_POOL_SIZE,
+                         0, &size_kb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Cannot get the request pool size [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    if (size_kb < 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS,
+              "Invalid request pool size %d, disabling request pools\n",
+              size_kb);
+        size_kb = 0;
+    }
+
+    if (size_kb > 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Using %d KiB request pools\n", size_kb);
+    }
+
+    sss_req_pool_set_size((size_t)size_kb * 1024);
+    return EOK;
+}
+
+size_t sss_req_pool_get_size(void)
+{
+    return sss_req_pool_size;
+}
+
+void sss_req_pool_get_stats(enum sss_req_pool_kind kind,
+                            struct sss_req_pool_stats *stats)
+{
+    if (kind >= SSS_REQ_POOL_KIND_NUM) {
+        memset(stats, 0, sizeof(struct sss_req_pool_stats));
+        return;
+    }
+
+    *stats = sss_req_pool_stats[kind];
+}
+
+static uint8_t *sss_req_pool_mem(const void *ptr)
+{
+    return (uint8_t *)discard_const(ptr)
+                + SSS_REQ_POOL_ALIGN(talloc_get_size(ptr));
+}
+
+static void sss_req_pool_fill(const void *ptr)
+{
+    memset(sss_req_pool_mem(ptr), SSS_REQ_POOL_FILL, sss_req_pool_size);
+}
+
+static size_t sss_req_pool_used(const void *ptr)
+{
+    const uint8_t *mem = sss_req_pool_mem(ptr);
+    size_t used;
+
+    for (used = sss_req_pool_size; used > 0; used--) {
+        if (mem[used - 1] != SSS_REQ_POOL_FILL) {
+            break;
+        }
+    }
+
+    return used;
+}
+
+void sss_req_pool_account(const void *ptr, enum sss_req_pool_kind kind)
+{
+    struct sss_req_pool_stats *stats;
+    size_t children;
+    size_t bytes;
+
+    if (sss_req_pool_size == 0 || ptr == NULL
+            || kind >= SSS_REQ_POOL_KIND_NUM) {
+        return;
+    }
+    stats = &sss_req_pool_stats[kind];
+
+    /* The pool itself shows what the request used, including children
+     * that are already gone. Children that did not fit went to the heap
+     * instead and are only seen while they are still attached. */
+    bytes = sss_req_pool_used(ptr);
+    children = talloc_total_size(ptr) - talloc_get_size(ptr);
+
+    stats->requests++;
+    if (bytes + SSS_REQ_POOL_SLACK > sss_req_pool_size
+            || children > sss_req_pool_size) {
+        stats->overflows++;
+    }
+    if (children > bytes) {
+        bytes = children;
+    }
+    stats->bytes += bytes;
+    if (bytes > stats->max_bytes) {
+        stats->max_bytes = bytes;
+    }
+
+    if (stats->requests % SSS_REQ_POOL_STATS_INTERVAL == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "Request pools [%s]: %"PRIu64" requests, %"PRIu64" bytes per "
+              "request on average, %zu bytes at most, %"PRIu64" requests "
+              "did not fit into %zu bytes\n",
+              sss_req_pool_kind_str(kind), stats->requests,
+              stats->bytes / stats->requests, stats->max_bytes,
+              stats->overflows, sss_req_pool_size);
+    }
+}
+
+/* Children are still attached when a destructor runs. */
+static int sss_req_pool_cache_req_destructor(TALLOC_CTX *pool)
+{
+    sss_req_pool_account(pool, SSS_REQ_POOL_CACHE_REQ);
+    return 0;
+}
+
+static int sss_req_pool_dp_req_destructor(TALLOC_CTX *pool)
+{
+    sss_req_pool_account(pool, SSS_REQ_POOL_DP_REQ);
+    return 0;
+}
+
+static int sss_req_pool_sdap_op_destructor(TALLOC_CTX *pool)
+{
+    sss_req_pool_account(pool, SSS_REQ_POOL_SDAP_OP);
+    return 0;
+}
+
+TALLOC_CTX *sss_req_pool_new(TALLOC_CTX *mem_ctx, enum sss_req_pool_kind kind)
+{
+    TALLOC_CTX *pool;
+
+    if (sss_req_pool_size == 0) {
+        return mem_ctx;
+    }
+
+    pool = talloc_pool(mem_ctx, sss_req_pool_size);
+    if (pool == NULL) {
+        /* Fall back to allocating directly from mem_ctx */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to create request pool\n");
+        return mem_ctx;
+    }
+
+    talloc_set_name_const(pool, "sss_req_pool");
+    sss_req_pool_fill(pool);
+
+    switch (kind) {
+    case SSS_REQ_POOL_CACHE_REQ:
+        talloc_set_destructor(pool, sss_req_pool_cache_req_destructor);
+        break;
+    case SSS_REQ_POOL_DP_REQ:
+        talloc_set_destructor(pool, sss_req_pool_dp_req_destructor);
+        break;
+    case SSS_REQ_POOL_SDAP_OP:
+        talloc_set_destructor(pool, sss_req_pool_sdap_op_destructor);
+        break;
+    case SSS_REQ_POOL_KIND_NUM:
+        break;
+    }
+
+    return pool;
+}
+
+void *_sss_req_pool_zero(TALLOC_CTX *mem_ctx, size_t size, const char *name)
+{
+    void *ptr;
+
+    if (sss_req_pool_size == 0) {
+        return _talloc_zero(mem_ctx, size, name);
+    }
+
+    ptr = _talloc_pooled_object(mem_ctx, size, name,
+                                SSS_REQ_POOL_OBJECTS, sss_req_pool_size);
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    memset(ptr, 0, size);
+    sss_req_pool_fill(ptr);
+    return ptr;
+}
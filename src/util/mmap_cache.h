@@ -98,7 +98,7 @@ struct sss_mc_header {
     rel_ptr_t data_table;   /* data table pointer relative to mmap base */
     rel_ptr_t free_table;   /* free table pointer relative to mmap base */
     rel_ptr_t hash_table;   /* hash table pointer relative to mmap base */
-    rel_ptr_t reserved;     /* reserved for future changes */
+    uint32_t fingerprint;   /* configuration the cache was built with */
     uint32_t b2;            /* barrier 2 */
 };
 
@@ -149,6 +149,25 @@ struct sss_mc_initgr_data {
                              * after gids */
 };
 
+/* Records in the SID table are keyed by the input of the request they
+ * answer, the key is one of the prefixes below followed by the name, the
+ * decimal POSIX ID or the SID string. */
+#define MC_SID_KEY_NAME "name:"
+#define MC_SID_KEY_ID   "id:"
+#define MC_SID_KEY_SID  "sid:"
+
+struct sss_mc_sid_data {
+    rel_ptr_t key;          /* ptr to key string, rel. to struct base addr */
+    rel_ptr_t sid;          /* ptr to SID string, rel. to struct base addr */
+    rel_ptr_t name;         /* ptr to name string, empty if not known */
+    uint32_t id;            /* POSIX ID, 0 if not known */
+    uint32_t type;          /* enum sss_id_type of the object */
+    uint32_t strs_len;      /* length of strs */
+    char strs[0];           /* concatenation of all strings, each string is
+                             * zero terminated ordered as follows:
+                             * key, sid, name */
+};
+
 #pragma pack()
 
 
@@ -71,6 +71,7 @@ static void close_low_fds(void)
 
 static void deamon_parent_sigterm(int sig)
 {
+    sss_debug_flush_sigsafe();
     _exit(0);
 }
 
@@ -120,6 +121,7 @@ void become_daemon(bool Fork)
                 }
             } while (error == EINTR);
 
+            sss_debug_flush_sigsafe();
             _exit(ret);
         }
     }
@@ -418,6 +420,41 @@ errno_t server_common_rotate_logs(struct confdb_ctx *confdb,
     return EOK;
 }
 
+/* Buffered debug output is written out periodically so that the log
+ * is complete even when the process is idle. */
+#define DEBUG_FLUSH_INTERVAL 1
+
+static void server_debug_flush_handler(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval current_time,
+                                       void *pvt);
+
+static errno_t server_schedule_debug_flush(struct tevent_context *ev,
+                                           TALLOC_CTX *mem_ctx)
+{
+    struct tevent_timer *te;
+    struct timeval tv;
+
+    tv = tevent_timeval_current_ofs(DEBUG_FLUSH_INTERVAL, 0);
+    te = tevent_add_timer(ev, mem_ctx, tv, server_debug_flush_handler,
+                          mem_ctx);
+    if (te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to schedule debug flush\n");
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static void server_debug_flush_handler(struct tevent_context *ev,
+                                       struct tevent_timer *te,
+                                       struct timeval current_time,
+                                       void *pvt)
+{
+    sss_debug_flush();
+    server_schedule_debug_flush(ev, pvt);
+}
+
 static const char *get_db_path(void)
 {
 #ifdef UNIT_TESTING
@@ -457,6 +494,8 @@ int server_setup(const char *name, int flags,
     bool dt;
     bool dl;
     bool dm;
+    bool db;
+    bool dfr;
     struct tevent_signal *tes;
     struct logrotate_ctx *lctx;
     char *locale;
@@ -648,6 +687,27 @@ int server_setup(const char *name, int flags,
     }
     if (dl) debug_to_file = 1;
 
+    /* buffering must be known before the log file is opened */
+    ret = confdb_get_bool(ctx->confdb_ctx, conf_entry,
+                          CONFDB_SERVICE_DEBUG_BUFFERED,
+                          false, &db);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Error reading from confdb (%d) [%s]\n",
+                                     ret, strerror(ret));
+        return ret;
+    }
+    debug_buffered = db ? 1 : 0;
+
+    ret = confdb_get_bool(ctx->confdb_ctx, conf_entry,
+                          CONFDB_SERVICE_DEBUG_FLIGHT_RECORDER,
+                          false, &dfr);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Error reading from confdb (%d) [%s]\n",
+                                     ret, strerror(ret));
+        return ret;
+    }
+    debug_flight_recorder = dfr ? 1 : 0;
+
     /* before opening the log file set up log rotation */
     lctx = talloc_zero(ctx, struct logrotate_ctx);
     if (!lctx) return ENOMEM;
@@ -671,6 +731,13 @@ int server_setup(const char *name, int flags,
         }
     }
 
+    if (debug_buffered) {
+        ret = server_schedule_debug_flush(ctx->event_ctx, ctx);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
     /* Setup the internal watchdog */
     ret = confdb_get_int(ctx->confdb_ctx, conf_entry,
                          CONFDB_DOMAIN_TIMEOUT,
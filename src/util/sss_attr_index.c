@@ -0,0 +1,311 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <strings.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "util/sss_attr_index.h"
+
+#define SSS_ATTR_INDEX_NONE SIZE_MAX
+#define SSS_ATTR_INDEX_MIN_SLOTS 16
+
+/* Every distinct name occupies one slot of an open addressing table, the
+ * positions sharing the name are chained through the entries array. */
+struct sss_attr_index_slot {
+    uint32_t hash;
+    size_t head;
+    size_t tail;
+};
+
+struct sss_attr_index_entry {
+    const char *name;
+    size_t next;
+};
+
+struct sss_attr_index {
+    struct sss_attr_index_slot *slots;
+    size_t num_slots;
+    size_t num_used;
+
+    struct sss_attr_index_entry *entries;
+    size_t num_entries;
+    size_t count;
+};
+
+/* FNV-1a of the ASCII lower-cased name, attribute names are compared with
+ * strcasecmp() so they have to hash the same regardless of the case. */
+static uint32_t sss_attr_index_hash(const char *name)
+{
+    uint32_t hash = 2166136261U;
+    const unsigned char *p;
+    unsigned char c;
+
+    for (p = (const unsigned char *)name; *p != '\0'; p++) {
+        c = *p;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        hash ^= c;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static struct sss_attr_index_slot *
+sss_attr_index_slot(struct sss_attr_index_slot *slots,
+                    size_t num_slots,
+                    struct sss_attr_index_entry *entries,
+                    const char *name,
+                    uint32_t hash)
+{
+    struct sss_attr_index_slot *slot;
+    size_t mask = num_slots - 1;
+    size_t i;
+
+    for (i = hash & mask; ; i = (i + 1) & mask) {
+        slot = &slots[i];
+        if (slot->head == SSS_ATTR_INDEX_NONE) {
+            return slot;
+        }
+
+        if (slot->hash == hash
+                && strcasecmp(entries[slot->head].name, name) == 0) {
+            return slot;
+        }
+    }
+}
+
+static errno_t sss_attr_index_rehash(struct sss_attr_index *idx,
+                                     size_t num_slots)
+{
+    struct sss_attr_index_slot *slots;
+    struct sss_attr_index_slot *old;
+    struct sss_attr_index_slot *slot;
+    size_t i;
+
+    slots = talloc_array(idx, struct sss_attr_index_slot, num_slots);
+    if (slots == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_slots; i++) {
+        slots[i].head = SSS_ATTR_INDEX_NONE;
+    }
+
+    old = idx->slots;
+    for (i = 0; old != NULL && i < idx->num_slots; i++) {
+        if (old[i].head == SSS_ATTR_INDEX_NONE) {
+            continue;
+        }
+
+        slot = sss_attr_index_slot(slots, num_slots, idx->entries,
+                                   idx->entries[old[i].head].name,
+                                   old[i].hash);
+        *slot = old[i];
+    }
+
+    talloc_free(old);
+    idx->slots = slots;
+    idx->num_slots = num_slots;
+
+    return EOK;
+}
+
+static errno_t sss_attr_index_grow_entries(struct sss_attr_index *idx,
+                                           size_t pos)
+{
+    struct sss_attr_index_entry *entries;
+    size_t num_entries;
+    size_t i;
+
+    num_entries = idx->num_entries == 0 ? SSS_ATTR_INDEX_MIN_SLOTS
+                                        : idx->num_entries;
+    while (num_entries <= pos) {
+        num_entries *= 2;
+    }
+
+    entries = talloc_realloc(idx, idx->entries, struct sss_attr_index_entry,
+                             num_entries);
+    if (entries == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = idx->num_entries; i < num_entries; i++) {
+        entries[i].name = NULL;
+        entries[i].next = SSS_ATTR_INDEX_NONE;
+    }
+
+    idx->entries = entries;
+    idx->num_entries = num_entries;
+
+    return EOK;
+}
+
+struct sss_attr_index *sss_attr_index_new(TALLOC_CTX *mem_ctx, size_t hint)
+{
+    struct sss_attr_index *idx;
+    size_t num_slots;
+    errno_t ret;
+
+    idx = talloc_zero(mem_ctx, struct sss_attr_index);
+    if (idx == NULL) {
+        return NULL;
+    }
+
+    /* Keep the load factor under one half. */
+    num_slots = SSS_ATTR_INDEX_MIN_SLOTS;
+    while (num_slots < hint * 2) {
+        num_slots *= 2;
+    }
+
+    ret = sss_attr_index_rehash(idx, num_slots);
+    if (ret != EOK) {
+        talloc_free(idx);
+        return NULL;
+    }
+
+    if (hint > 0) {
+        ret = sss_attr_index_grow_entries(idx, hint - 1);
+        if (ret != EOK) {
+            talloc_free(idx);
+            return NULL;
+        }
+    }
+
+    return idx;
+}
+
+errno_t sss_attr_index_add(struct sss_attr_index *idx,
+                           const char *name,
+                           size_t pos)
+{
+    struct sss_attr_index_slot *slot;
+    uint32_t hash;
+    errno_t ret;
+
+    if (idx == NULL || name == NULL || pos == SSS_ATTR_INDEX_NONE) {
+        return EINVAL;
+    }
+
+    if (pos < idx->num_entries && idx->entries[pos].name != NULL) {
+        return EINVAL;
+    }
+
+    if (pos >= idx->num_entries) {
+        ret = sss_attr_index_grow_entries(idx, pos);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    if ((idx->num_used + 1) * 2 > idx->num_slots) {
+        ret = sss_attr_index_rehash(idx, idx->num_slots * 2);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    hash = sss_attr_index_hash(name);
+    slot = sss_attr_index_slot(idx->slots, idx->num_slots, idx->entries,
+                               name, hash);
+    if (slot->head == SSS_ATTR_INDEX_NONE) {
+        slot->hash = hash;
+        slot->head = pos;
+        idx->num_used++;
+    } else {
+        if (pos < slot->tail) {
+            return EINVAL;
+        }
+        idx->entries[slot->tail].next = pos;
+    }
+
+    slot->tail = pos;
+    idx->entries[pos].name = name;
+    idx->entries[pos].next = SSS_ATTR_INDEX_NONE;
+    idx->count++;
+
+    return EOK;
+}
+
+size_t sss_attr_index_count(struct sss_attr_index *idx)
+{
+    return idx == NULL ? 0 : idx->count;
+}
+
+static struct sss_attr_index_slot *
+sss_attr_index_find(struct sss_attr_index *idx, const char *name)
+{
+    struct sss_attr_index_slot *slot;
+
+    if (idx == NULL || name == NULL || idx->count == 0) {
+        return NULL;
+    }
+
+    slot = sss_attr_index_slot(idx->slots, idx->num_slots, idx->entries,
+                               name, sss_attr_index_hash(name));
+    if (slot->head == SSS_ATTR_INDEX_NONE) {
+        return NULL;
+    }
+
+    return slot;
+}
+
+bool sss_attr_index_first(struct sss_attr_index *idx,
+                          const char *name,
+                          size_t *_pos)
+{
+    struct sss_attr_index_slot *slot;
+
+    slot = sss_attr_index_find(idx, name);
+    if (slot == NULL) {
+        return false;
+    }
+
+    *_pos = slot->head;
+    return true;
+}
+
+bool sss_attr_index_last(struct sss_attr_index *idx,
+                         const char *name,
+                         size_t *_pos)
+{
+    struct sss_attr_index_slot *slot;
+
+    slot = sss_attr_index_find(idx, name);
+    if (slot == NULL) {
+        return false;
+    }
+
+    *_pos = slot->tail;
+    return true;
+}
+
+bool sss_attr_index_next(struct sss_attr_index *idx,
+                         size_t pos,
+                         size_t *_next)
+{
+    if (idx == NULL || pos >= idx->num_entries
+            || idx->entries[pos].next == SSS_ATTR_INDEX_NONE) {
+        return false;
+    }
+
+    *_next = idx->entries[pos].next;
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SSS_ATTR_INDEX_H_
+#define _SSS_ATTR_INDEX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <talloc.h>
+
+#include "util/util_errors.h"
+
+/**
+ * Case-insensitive index of attribute names to their positions in an
+ * external array (elements of sysdb_attrs, entries of an attribute map...).
+ *
+ * The index does not copy the names, it only keeps the pointers, so the
+ * names must stay valid and unchanged for the life time of the index.
+ * Several positions may share the same name, they are kept in the order
+ * they were added in.
+ */
+struct sss_attr_index;
+
+/**
+ * Create a new empty index. @hint is the expected number of names.
+ */
+struct sss_attr_index *sss_attr_index_new(TALLOC_CTX *mem_ctx, size_t hint);
+
+/**
+ * Add @name found at position @pos. Positions of the same name must be
+ * added in ascending order.
+ *
+ * @return EOK If the name was added.
+ * @return EINVAL If @pos was already added or is lower than a position
+ *                previously added for the same name.
+ * @return ENOMEM If memory could not be allocated.
+ */
+errno_t sss_attr_index_add(struct sss_attr_index *idx,
+                           const char *name,
+                           size_t pos);
+
+/**
+ * Number of names stored in the index.
+ */
+size_t sss_attr_index_count(struct sss_attr_index *idx);
+
+/**
+ * Find the first position of @name.
+ *
+ * @return true If @name was found, @_pos is set.
+ */
+bool sss_attr_index_first(struct sss_attr_index *idx,
+                          const char *name,
+                          size_t *_pos);
+
+/**
+ * Find the last position of @name.
+ *
+ * @return true If @name was found, @_pos is set.
+ */
+bool sss_attr_index_last(struct sss_attr_index *idx,
+                         const char *name,
+                         size_t *_pos);
+
+/**
+ * Find the next position that has the same name as @pos, which was
+ * returned by one of the functions above.
+ *
+ * @return true If there is such position, @_next is set.
+ */
+bool sss_attr_index_next(struct sss_attr_index *idx,
+                         size_t pos,
+                         size_t *_next);
+
+#endif /* _SSS_ATTR_INDEX_H_ */
@@ -89,6 +89,44 @@ uint8_t *sss_utf8_tolower(const uint8_t *s, size_t len, size_t *_nlen)
 #error No unicode library
 #endif
 
+#ifdef HAVE_LIBUNISTRING
+uint8_t *sss_utf8_casefold(const uint8_t *s, size_t len, size_t *_nlen)
+{
+    size_t flen;
+    uint8_t *folded;
+    uint8_t *terminated;
+
+    folded = u8_casefold(s, len, NULL, NULL, NULL, &flen);
+    if (!folded) return NULL;
+
+    /* u8_casefold() does not terminate the result */
+    terminated = realloc(folded, flen + 1);
+    if (!terminated) {
+        free(folded);
+        return NULL;
+    }
+    terminated[flen] = '\0';
+
+    if (_nlen) *_nlen = flen;
+    return terminated;
+}
+#elif defined(HAVE_GLIB2)
+uint8_t *sss_utf8_casefold(const uint8_t *s, size_t len, size_t *_nlen)
+{
+    gchar *gfolded;
+
+    gfolded = g_utf8_casefold((const gchar *) s, len);
+    if (!gfolded) return NULL;
+
+    /* strlen() is safe here because g_utf8_casefold() always
+     * null-terminates */
+    if (_nlen) *_nlen = strlen(gfolded);
+    return (uint8_t *) gfolded;
+}
+#else
+#error No unicode library
+#endif
+
 #ifdef HAVE_LIBUNISTRING
 bool sss_utf8_check(const uint8_t *s, size_t n)
 {
@@ -37,6 +37,9 @@
 #define TCURL_IOBUF_CHUNK   1024
 #define TCURL_IOBUF_MAX     4096
 
+/* Number of idle connections the multi handle keeps open for reuse */
+#define TCURL_MAX_CONNECTS  16
+
 static bool global_is_curl_initialized;
 
 /**
@@ -535,6 +538,18 @@ struct tcurl_ctx *tcurl_init(TALLOC_CTX *mem_ctx,
               cmret, curl_multi_strerror(cmret));
     }
 
+    /* Connections are cached in the multi handle once a transfer is
+     * finished, so subsequent requests to the same backend can reuse
+     * them instead of reconnecting. */
+    cmret = curl_multi_setopt(tctx->multi_handle, CURLMOPT_MAXCONNECTS,
+                              (long)TCURL_MAX_CONNECTS);
+    if (cmret != CURLM_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot set CURLMOPT_MAXCONNECTS [%d]: %s\n",
+              cmret, curl_multi_strerror(cmret));
+        /* Non-fatal, libcurl uses its default cache size */
+    }
+
     return tctx;
 
 fail:
@@ -909,6 +924,14 @@ tcurl_request_create(TALLOC_CTX *mem_ctx,
         if (ret != EOK) {
             goto done;
         }
+    } else {
+        /* Keep idle cached TCP connections alive so they can be reused.
+         * This is only an optimization, the request works without it. */
+        ret = tcurl_set_option(tcurl_req, CURLOPT_TCP_KEEPALIVE, 1L);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "TCP keep-alive is not supported by "
+                  "libcurl, idle connections may be closed by the peer\n");
+        }
     }
 
     if (body != NULL) {
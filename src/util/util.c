@@ -1022,6 +1022,7 @@ static struct cert_verify_opts *init_cert_verify_opts(TALLOC_CTX *mem_ctx)
 
     cert_verify_opts->do_ocsp = true;
     cert_verify_opts->do_verification = true;
+    cert_verify_opts->cache_verification = false;
     cert_verify_opts->ocsp_default_responder = NULL;
     cert_verify_opts->ocsp_default_responder_signing_cert = NULL;
 
@@ -1081,6 +1082,11 @@ errno_t parse_cert_verify_opts(TALLOC_CTX *mem_ctx, const char *verify_opts,
                   "disabling verification completely. "
                   "This should not be used in production.\n");
             cert_verify_opts->do_verification = false;
+        } else if (strcasecmp(opts[c], "cache_verification") == 0) {
+            DEBUG(SSSDBG_TRACE_ALL,
+                  "Found 'cache_verification' option, "
+                  "reusing successful verifications for a short time.\n");
+            cert_verify_opts->cache_verification = true;
         } else if (strncasecmp(opts[c], OCSP_DEFAUL_RESPONDER,
                                OCSP_DEFAUL_RESPONDER_LEN) == 0) {
             cert_verify_opts->ocsp_default_responder =
@@ -201,6 +201,47 @@ void *sss_mem_attach(TALLOC_CTX *mem_ctx,
 
 int password_destructor(void *memctx);
 
+/* Opt-in talloc pools for per-request memory. The size is set once at
+ * process start-up, zero disables the pools. */
+#define SSS_REQ_POOL_OBJECTS 16
+
+/* Statistics are kept separately for each kind of request. */
+enum sss_req_pool_kind {
+    SSS_REQ_POOL_CACHE_REQ,
+    SSS_REQ_POOL_DP_REQ,
+    SSS_REQ_POOL_SDAP_OP,
+
+    SSS_REQ_POOL_KIND_NUM
+};
+
+struct sss_req_pool_stats {
+    uint64_t requests;
+    uint64_t bytes;
+    size_t max_bytes;
+    uint64_t overflows;
+};
+
+void sss_req_pool_set_size(size_t size);
+errno_t sss_req_pool_init(struct confdb_ctx *cdb, const char *conf_path);
+size_t sss_req_pool_get_size(void);
+void sss_req_pool_get_stats(enum sss_req_pool_kind kind,
+                            struct sss_req_pool_stats *stats);
+
+/* Returns a new pool allocated on mem_ctx that records statistics of the
+ * given kind when it is freed, or mem_ctx itself if pools are disabled. */
+TALLOC_CTX *sss_req_pool_new(TALLOC_CTX *mem_ctx, enum sss_req_pool_kind kind);
+
+/* Records the memory used by a request pool or a pooled object in the
+ * statistics of the given kind. Children that are still attached and did
+ * not fit into the pool are counted as well. */
+void sss_req_pool_account(const void *ptr, enum sss_req_pool_kind kind);
+
+/* Allocates a zeroed object that is itself a pool for its children. The
+ * caller accounts for it with sss_req_pool_account() in its destructor. */
+void *_sss_req_pool_zero(TALLOC_CTX *mem_ctx, size_t size, const char *name);
+#define sss_req_pool_zero(mem_ctx, type) \
+    (type *)_sss_req_pool_zero(mem_ctx, sizeof(type), #type)
+
 /* from usertools.c */
 char *get_uppercase_realm(TALLOC_CTX *memctx, const char *name);
 
@@ -368,6 +409,7 @@ char **parse_args(const char *str);
 struct cert_verify_opts {
     bool do_ocsp;
     bool do_verification;
+    bool cache_verification;
     char *ocsp_default_responder;
     char *ocsp_default_responder_signing_cert;
 };
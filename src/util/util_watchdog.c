@@ -55,6 +55,7 @@ static void watchdog_detect_timeshift(void)
             if (getpid() == getpgrp()) {
                 kill(-getpgrp(), SIGTERM);
             } else {
+                sss_debug_flush_sigsafe();
                 _exit(1);
             }
         }
@@ -76,6 +77,7 @@ static void watchdog_handler(int sig)
         if (getpid() == getpgrp()) {
             kill(-getpgrp(), SIGTERM);
         } else {
+            sss_debug_flush_sigsafe();
             _exit(1);
         }
     }